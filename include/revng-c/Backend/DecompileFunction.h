@@ -4,19 +4,60 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <set>
+#include <string>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
 #include "llvm/IR/Module.h"
 
 #include "revng/EarlyFunctionAnalysis/FunctionMetadataCache.h"
 #include "revng/Model/Binary.h"
 #include "revng/Pipes/StringMap.h"
+#include "revng/Support/MetaAddress.h"
 
 #include "revng-c/Backend/DecompilePipe.h"
+#include "revng-c/Backend/DecompiledFunctionsCache.h"
 
 namespace detail {
 using Container = revng::pipes::DecompileStringMap;
 }
 
+/// Invoked with the entry address and the C code of each decompiled function
+using DecompiledFunctionCallback = llvm::function_ref<void(const MetaAddress &,
+                                                           std::string &&)>;
+
+/// Decompile all the isolated functions in \p M that have a body.
+///
+/// \param OnDecompiled is invoked on the calling thread, once per function, in
+///        increasing order of entry address.
+/// \param Previous if not null, functions whose IR and model dependencies did
+///        not change since they were recorded in \p Previous are not
+///        decompiled again, and \p Previous is updated with the new results.
+void decompile(FunctionMetadataCache &Cache,
+               llvm::Module &M,
+               const model::Binary &Model,
+               DecompiledFunctionCallback OnDecompiled,
+               DecompiledFunctionsCache *Previous = nullptr);
+
+/// Decompile only the isolated functions in \p M whose entry address is in
+/// \p Entries. See the overload above for the meaning of the other parameters.
+///
+/// \param Priority if not empty, the functions it lists are decompiled first,
+///        then the others in order of distance from them in the call graph,
+///        and \p OnDecompiled is invoked in this order instead.
+void decompile(FunctionMetadataCache &Cache,
+               llvm::Module &M,
+               const model::Binary &Model,
+               const std::set<MetaAddress> &Entries,
+               DecompiledFunctionCallback OnDecompiled,
+               DecompiledFunctionsCache *Previous = nullptr,
+               llvm::ArrayRef<MetaAddress> Priority = {});
+
+/// Decompile all the isolated functions in \p M that have a body, and store
+/// the results in \p DecompiledFunctions.
 void decompile(FunctionMetadataCache &Cache,
                llvm::Module &M,
                const model::Binary &Model,
-               detail::Container &DecompiledFunctions);
+               detail::Container &DecompiledFunctions,
+               DecompiledFunctionsCache *Previous = nullptr);
@@ -16,6 +16,7 @@
 #include "revng/Pipes/Kinds.h"
 #include "revng/Pipes/StringMap.h"
 
+#include "revng-c/Backend/DecompiledFunctionsCache.h"
 #include "revng-c/Pipes/Kinds.h"
 
 namespace revng::pipes {
@@ -32,6 +33,13 @@ class Decompile {
 public:
   static constexpr auto Name = "decompile";
 
+private:
+  /// C code emitted in previous runs of this pipe. When the pipeline reruns us
+  /// after a model change, only the functions that actually depend on the
+  /// changed parts of the model are decompiled again.
+  DecompiledFunctionsCache PreviousRuns;
+
+public:
   std::array<pipeline::ContractGroup, 1> getContract() const {
     using namespace pipeline;
     using namespace revng::kinds;
@@ -4,13 +4,20 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <set>
+
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/Support/Error.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "revng/Pipes/StringMap.h"
 #include "revng/Support/MetaAddress.h"
 
+#include "revng-c/Backend/DecompileFunction.h"
 #include "revng-c/Backend/DecompilePipe.h"
+#include "revng-c/Backend/PackDecompiledPipe.h"
 #include "revng-c/Support/PTMLC.h"
+#include "revng-c/Support/SeekableArchive.h"
 
 namespace detail {
 using DecompiledStringMap = revng::pipes::DecompileStringMap;
@@ -20,3 +27,30 @@ void printSingleCFile(llvm::raw_ostream &Out,
                       ptml::PTMLCBuilder &B,
                       const detail::DecompiledStringMap &Functions,
                       const std::set<MetaAddress> &Targets);
+
+/// Same as above, reading the functions out of decompiled.pack.
+///
+/// Only the functions in \p Targets are looked up and decompressed, unless it
+/// is empty.
+///
+/// \return an error for each member that could not be extracted. Such members
+///         are skipped, and all the others are printed anyway.
+llvm::Error printSingleCFile(llvm::raw_ostream &Out,
+                             ptml::PTMLCBuilder &B,
+                             const revng::SeekableArchive &Functions,
+                             const std::set<MetaAddress> &Targets);
+
+using DecompiledFunctionsProducer = llvm::function_ref<void(
+  DecompiledFunctionCallback)>;
+
+/// Print a single C file containing the functions in \p Expected, writing each
+/// of them to \p Out as soon as the \p Producer hands it out, rather than
+/// waiting to have all of them in memory.
+///
+/// Functions are printed in MetaAddress order. The \p Producer is expected to
+/// hand out functions in that same order, but functions arriving out of order
+/// are buffered until all the ones preceding them have been printed.
+void printSingleCFile(llvm::raw_ostream &Out,
+                      ptml::PTMLCBuilder &B,
+                      const std::set<MetaAddress> &Expected,
+                      DecompiledFunctionsProducer Producer);
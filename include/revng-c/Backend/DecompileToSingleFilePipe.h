@@ -12,6 +12,7 @@
 
 #include "revng/Pipeline/Context.h"
 #include "revng/Pipeline/Contract.h"
+#include "revng/Pipeline/LLVMContainer.h"
 #include "revng/Pipes/Kinds.h"
 #include "revng/Pipes/StringBufferContainer.h"
 #include "revng/Pipes/StringMap.h"
@@ -53,4 +54,30 @@ public:
              llvm::ArrayRef<std::string> ContainerNames) const;
 };
 
+/// Decompile all the functions and print them in a single C file directly,
+/// without ever holding the C code of all of them in memory at once
+class StreamingDecompileToSingleFile {
+public:
+  static constexpr auto Name = "streaming-decompile-to-single-file";
+
+  std::array<pipeline::ContractGroup, 1> getContract() const {
+    using namespace pipeline;
+    using namespace revng::kinds;
+
+    return { ContractGroup({ Contract(StackAccessesSegregated,
+                                      0,
+                                      DecompiledToC,
+                                      1,
+                                      InputPreservation::Preserve) }) };
+  }
+
+  void run(const pipeline::ExecutionContext &Ctx,
+           pipeline::LLVMContainer &IRContainer,
+           DecompiledFileContainer &OutCFile);
+
+  void print(const pipeline::Context &Ctx,
+             llvm::raw_ostream &OS,
+             llvm::ArrayRef<std::string> ContainerNames) const;
+};
+
 } // end namespace revng::pipes
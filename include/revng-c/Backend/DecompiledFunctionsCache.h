@@ -0,0 +1,32 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "revng/Support/MetaAddress.h"
+
+class RestructuredGHAST;
+
+/// C code emitted by previous invocations of decompile(), indexed by function
+/// entry. Each entry is tagged with a hash of the IR of the function and a hash
+/// of the parts of the model it depends on: as long as neither of them changes,
+/// the function is not decompiled again.
+struct DecompiledFunctionsCache {
+  struct Entry {
+    uint64_t IRHash = 0;
+    uint64_t ModelHash = 0;
+    std::string CCode;
+
+    /// The GHAST the C code has been emitted from, if it can be reused when
+    /// only the model changes
+    std::shared_ptr<RestructuredGHAST> GHAST;
+  };
+
+  std::map<MetaAddress, Entry> Entries;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <array>
+#include <string>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/Contract.h"
+#include "revng/Pipes/StringBufferContainer.h"
+#include "revng/Support/MetaAddress.h"
+
+#include "revng-c/Backend/DecompilePipe.h"
+#include "revng-c/Pipes/Kinds.h"
+
+namespace revng::pipes {
+
+inline constexpr char DecompiledPackMIMEType[] = "application/"
+                                                 "x.c+ptml+pack";
+inline constexpr char DecompiledPackSuffix[] = ".pack";
+inline constexpr char DecompiledPackName[] = "decompiled-pack";
+/// The name of the member of decompiled.pack holding the function at \p Entry
+inline std::string getPackMemberName(const MetaAddress &Entry) {
+  return Entry.toString() + DecompileExtension;
+}
+
+using DecompiledPackContainer = StringBufferContainer<&kinds::DecompiledPack,
+                                                      DecompiledPackName,
+                                                      DecompiledPackMIMEType,
+                                                      DecompiledPackSuffix>;
+
+/// Pack the PTML of all the decompiled functions in a revng::SeekableArchive,
+/// so that clients can extract a single function without decompressing the
+/// others
+class PackDecompiled {
+public:
+  static constexpr auto Name = "pack-decompiled";
+
+  std::array<pipeline::ContractGroup, 1> getContract() const {
+    using namespace pipeline;
+    using namespace revng::kinds;
+
+    return { ContractGroup({ Contract(Decompiled,
+                                      0,
+                                      DecompiledPack,
+                                      1,
+                                      InputPreservation::Preserve) }) };
+  }
+
+  void run(const pipeline::ExecutionContext &Ctx,
+           const DecompileStringMap &DecompiledFunctions,
+           DecompiledPackContainer &Output);
+
+  void print(const pipeline::Context &Ctx,
+             llvm::raw_ostream &OS,
+             llvm::ArrayRef<std::string> ContainerNames) const;
+};
+
+} // end namespace revng::pipes
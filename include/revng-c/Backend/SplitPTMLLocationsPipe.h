@@ -0,0 +1,58 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <array>
+#include <string>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/Contract.h"
+#include "revng/Pipes/StringMap.h"
+
+#include "revng-c/Backend/DecompilePipe.h"
+#include "revng-c/Pipes/Kinds.h"
+
+namespace revng::pipes {
+
+inline constexpr char DecompiledLocationsMime[] = "application/"
+                                                  "x.c+ptml-locations+tar+gz";
+inline constexpr char DecompiledLocationsName[] = "decompiled-locations";
+inline constexpr char DecompiledLocationsExtension[] = ".c.locations";
+using DecompiledLocationsStringMap = FunctionStringMap<
+  &kinds::DecompiledLocations,
+  DecompiledLocationsName,
+  DecompiledLocationsMime,
+  DecompiledLocationsExtension>;
+
+/// Turn the PTML of each decompiled function into plain C plus a binary table
+/// of its locations, see ptml::LocationTable::serialize for the format
+class SplitPTMLLocations {
+public:
+  static constexpr auto Name = "split-ptml-locations";
+
+  std::array<pipeline::ContractGroup, 1> getContract() const {
+    using namespace pipeline;
+    using namespace revng::kinds;
+
+    return { ContractGroup({ Contract(Decompiled,
+                                      0,
+                                      DecompiledLocations,
+                                      1,
+                                      InputPreservation::Preserve) }) };
+  }
+
+  void run(const pipeline::ExecutionContext &Ctx,
+           const DecompileStringMap &DecompiledFunctions,
+           DecompiledLocationsStringMap &Output);
+
+  void print(const pipeline::Context &Ctx,
+             llvm::raw_ostream &OS,
+             llvm::ArrayRef<std::string> ContainerNames) const;
+};
+
+} // end namespace revng::pipes
@@ -0,0 +1,56 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <array>
+#include <string>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/Contract.h"
+#include "revng/Pipes/StringMap.h"
+
+#include "revng-c/Backend/DecompilePipe.h"
+#include "revng-c/Pipes/Kinds.h"
+
+namespace revng::pipes {
+
+inline constexpr char DecompiledPlainMime[] = "text/x.c+tar+gz";
+inline constexpr char DecompiledPlainName[] = "decompiled-plain";
+inline constexpr char DecompiledPlainExtension[] = ".c";
+using DecompiledPlainStringMap = FunctionStringMap<&kinds::DecompiledPlainC,
+                                                   DecompiledPlainName,
+                                                   DecompiledPlainMime,
+                                                   DecompiledPlainExtension>;
+
+/// Turn the PTML of each decompiled function into plain C, without
+/// decompiling it again
+class StripPTML {
+public:
+  static constexpr auto Name = "strip-ptml";
+
+  std::array<pipeline::ContractGroup, 1> getContract() const {
+    using namespace pipeline;
+    using namespace revng::kinds;
+
+    return { ContractGroup({ Contract(Decompiled,
+                                      0,
+                                      DecompiledPlainC,
+                                      1,
+                                      InputPreservation::Preserve) }) };
+  }
+
+  void run(const pipeline::ExecutionContext &Ctx,
+           const DecompileStringMap &DecompiledFunctions,
+           DecompiledPlainStringMap &Output);
+
+  void print(const pipeline::Context &Ctx,
+             llvm::raw_ostream &OS,
+             llvm::ArrayRef<std::string> ContainerNames) const;
+};
+
+} // end namespace revng::pipes
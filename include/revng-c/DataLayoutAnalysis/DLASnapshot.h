@@ -0,0 +1,91 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng-c/DataLayoutAnalysis/DLALayouts.h"
+#include "revng-c/DataLayoutAnalysis/DLATypeSystem.h"
+
+namespace dla {
+
+/// A compact binary copy of a LayoutTypeSystem, and of the mapping between its
+/// nodes and the LayoutTypePtrs they have been created for.
+///
+/// Writing a snapshot is much cheaper than dumping the LayoutTypeSystem as a
+/// DOT graph and the mapping as CSV, so it can be afforded on full binaries.
+/// Snapshots can then be inspected offline with revng-dla-snapshot.
+struct DLASnapshot {
+  struct Node {
+    uint64_t ID = 0;
+    uint64_t Size = 0;
+    InterferingChildrenInfo InterferingInfo = Unknown;
+    bool NonScalar = false;
+
+    /// The equivalence class of the node, or std::nullopt if it has been
+    /// removed. Before the equivalence classes are compressed, this is the ID
+    /// of the leader of the class.
+    std::optional<uint64_t> EqClass;
+  };
+
+  struct Edge {
+    uint64_t Source = 0;
+    uint64_t Target = 0;
+    TypeLinkTag::LinkKind Kind = TypeLinkTag::LK_All;
+
+    /// Only meaningful for instance edges
+    OffsetExpression OE;
+  };
+
+  struct Value {
+    uint64_t NodeID = 0;
+    std::string Description;
+  };
+
+  /// The number of middle-end steps that had already run on the snapshot.
+  /// Running the same schedule on the restored LayoutTypeSystem can resume
+  /// from the step with this index.
+  uint32_t StepIndex = 0;
+
+  /// True if the snapshot was taken after compressing the equivalence classes
+  bool Compressed = false;
+
+  std::vector<Node> Nodes;
+  std::vector<Edge> Edges;
+  std::vector<Value> Values;
+
+  /// The equivalence class of each ID ever assigned to a node, including the
+  /// ones of the nodes that have been merged or removed
+  std::vector<std::optional<uint64_t>> EqClasses;
+
+  /// Write to \p OS the snapshot of \p TS, streaming it node by node.
+  ///
+  /// \p Values maps the ID of each node to its LayoutTypePtr, as
+  /// DLATypeSystemLLVMBuilder::getValues does.
+  static void write(const LayoutTypeSystem &TS,
+                    const LayoutTypePtrVect &Values,
+                    llvm::raw_ostream &OS,
+                    uint32_t StepIndex = 0);
+
+  /// Parse a snapshot produced by write
+  static llvm::Expected<DLASnapshot> read(llvm::StringRef Buffer);
+
+  /// Rebuild the nodes, the edges and the equivalence classes of the snapshot
+  /// in \p TS, which must be empty.
+  ///
+  /// The nodes get back their original IDs, so the LayoutTypePtrs of the
+  /// module the snapshot was taken on still map to the right nodes. The
+  /// equivalence classes must not be compressed.
+  void restore(LayoutTypeSystem &TS) const;
+};
+
+} // end namespace dla
@@ -4,7 +4,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <compare>
+#include <concepts>
 #include <cstddef>
 #include <functional>
 #include <limits>
@@ -13,10 +15,13 @@
 #include <optional>
 #include <set>
 #include <type_traits>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/GraphTraits.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/IntEqClasses.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SmallVector.h"
@@ -27,13 +32,64 @@
 #include "revng/Support/Assert.h"
 #include "revng/Support/Debug.h"
 
+#include "revng-c/Support/CountingAllocator.h"
+
 namespace dla {
 
+/// Accounts the allocations of the neighbors of all the LayoutTypeSystemNodes
+extern trace::AllocationCounters NeighborsAllocations;
+
 /// Class used to mark InstanceLinkTags between LayoutTypes
+///
+/// Most of the instance edges have at most one stride, so only that case is
+/// stored inline. Deeper nests of arrays spill Strides and TripCounts out of
+/// line.
 struct OffsetExpression {
+  /// The trip count of a level of array, if known.
+  ///
+  /// This behaves like std::optional<uint64_t>, but it takes half of the space,
+  /// since it uses the largest uint64_t to mean that the trip count is unknown.
+  class TripCountT {
+  private:
+    static constexpr uint64_t Unknown = std::numeric_limits<uint64_t>::max();
+    uint64_t Value = Unknown;
+
+  public:
+    TripCountT() = default;
+    TripCountT(std::nullopt_t) {}
+    TripCountT(uint64_t V) : Value(V) { revng_assert(V != Unknown); }
+
+    template<std::integral T>
+    TripCountT(const std::optional<T> &V) : TripCountT() {
+      if (V.has_value())
+        *this = TripCountT(static_cast<uint64_t>(V.value()));
+    }
+
+    bool has_value() const { return Value != Unknown; }
+    explicit operator bool() const { return has_value(); }
+
+    uint64_t value() const {
+      revng_assert(has_value());
+      return Value;
+    }
+    uint64_t operator*() const { return value(); }
+    uint64_t value_or(uint64_t Default) const {
+      return has_value() ? Value : Default;
+    }
+
+    bool operator==(const TripCountT &Other) const = default;
+
+    /// Unknown trip counts come first, like std::nullopt does
+    std::strong_ordering operator<=>(const TripCountT &Other) const {
+      if (auto Cmp = has_value() <=> Other.has_value(); Cmp != 0)
+        return Cmp;
+      return Value <=> Other.Value;
+    }
+  };
+
   uint64_t Offset;
-  llvm::SmallVector<uint64_t, 4> Strides;
-  llvm::SmallVector<std::optional<uint64_t>, 4> TripCounts;
+  llvm::SmallVector<uint64_t, 1> Strides;
+  llvm::SmallVector<TripCountT, 1> TripCounts;
 
   explicit OffsetExpression() : OffsetExpression(0ULL){};
   explicit OffsetExpression(uint64_t Off) :
@@ -45,8 +101,26 @@ struct OffsetExpression {
   OffsetExpression(OffsetExpression &&) = default;
   OffsetExpression &operator=(OffsetExpression &&) = default;
 
-  std::strong_ordering
-  operator<=>(const OffsetExpression &Other) const = default;
+  bool operator==(const OffsetExpression &Other) const = default;
+
+  /// The same order the defaulted operator would give. SmallVector only has
+  /// operator<, hence that would walk Strides and TripCounts up to twice.
+  std::strong_ordering operator<=>(const OffsetExpression &Other) const {
+    if (auto Cmp = Offset <=> Other.Offset; Cmp != 0)
+      return Cmp;
+
+    auto Cmp = std::lexicographical_compare_three_way(Strides.begin(),
+                                                      Strides.end(),
+                                                      Other.Strides.begin(),
+                                                      Other.Strides.end());
+    if (Cmp != 0)
+      return Cmp;
+
+    return std::lexicographical_compare_three_way(TripCounts.begin(),
+                                                  TripCounts.end(),
+                                                  Other.TripCounts.begin(),
+                                                  Other.TripCounts.end());
+  }
 
   void print(llvm::raw_ostream &OS) const;
 
@@ -114,11 +188,28 @@ public:
   }
 
 protected:
+  /// Cheap prefix of the ordering between TypeLinkTags, computed once at
+  /// construction from Kind and OE.Offset.
+  ///
+  /// operator<=> compares it before anything else, and only walks the
+  /// OffsetExpression when the keys are equal.
+  const uint64_t OrderingKey;
   const LinkKind Kind;
   OffsetExpression OE;
 
+  /// Dense ID, assigned by LayoutTypeSystem when the tag is interned
+  uint32_t ID = InvalidID;
+
   explicit TypeLinkTag(LinkKind K, OffsetExpression &&O) :
-    Kind(K), OE(std::move(O)) {}
+    OrderingKey(computeOrderingKey(K, O)), Kind(K), OE(std::move(O)) {}
+
+  /// The ordering key is monotone in (Kind, Offset): the 2 topmost bits hold
+  /// the Kind, the others hold the Offset, saturated.
+  static uint64_t computeOrderingKey(LinkKind K, const OffsetExpression &O) {
+    static_assert(LK_All < 4);
+    constexpr uint64_t MaxOffset = (1ULL << 62) - 1ULL;
+    return (static_cast<uint64_t>(K) << 62) | std::min(O.Offset, MaxOffset);
+  }
 
   // TODO: potentially we are interested in marking TypeLinkTags with some info
   // that allows us to track which step on the type system has created them.
@@ -126,10 +217,15 @@ protected:
   // identified more clearly if we really need it and why.
 
 public:
+  static constexpr uint32_t InvalidID = std::numeric_limits<uint32_t>::max();
+
   TypeLinkTag() = delete;
 
   LinkKind getKind() const { return Kind; }
 
+  /// Returns the dense ID of the tag, or InvalidID if it was not interned
+  uint32_t getID() const { return ID; }
+
   const OffsetExpression &getOffsetExpr() const {
     revng_assert(getKind() == LK_Instance);
     return OE;
@@ -149,7 +245,36 @@ public:
     return TypeLinkTag(LK_Pointer, OffsetExpression{});
   }
 
-  std::strong_ordering operator<=>(const TypeLinkTag &Other) const = default;
+  std::strong_ordering operator<=>(const TypeLinkTag &Other) const {
+    if (auto Cmp = OrderingKey <=> Other.OrderingKey; Cmp != 0)
+      return Cmp;
+    if (auto Cmp = Kind <=> Other.Kind; Cmp != 0)
+      return Cmp;
+    return OE <=> Other.OE;
+  }
+
+  bool operator==(const TypeLinkTag &Other) const {
+    // Interned tags are unique, so their IDs are enough to tell them apart
+    if (ID != InvalidID and Other.ID != InvalidID)
+      return ID == Other.ID;
+    return OrderingKey == Other.OrderingKey and Kind == Other.Kind
+           and OE == Other.OE;
+  }
+
+  struct Hash {
+    size_t operator()(const TypeLinkTag &T) const {
+      llvm::hash_code Result = llvm::hash_combine(T.Kind, T.OE.Offset);
+      for (const auto &[Stride, MaybeTC] :
+           llvm::zip_first(T.OE.Strides, T.OE.TripCounts))
+        Result = llvm::hash_combine(Result,
+                                    Stride,
+                                    MaybeTC.has_value(),
+                                    MaybeTC.value_or(0));
+      return Result;
+    }
+  };
+
+  friend class LayoutTypeSystem;
 
   friend void
   writeToLog(Logger<true> &L, const dla::TypeLinkTag &T, int /* Ignore */);
@@ -188,6 +313,11 @@ struct LayoutTypeSystemNode {
         if (auto Cmp = ID <=> Other.ID; Cmp != 0)
           return Cmp < 0;
 
+        // TypeLinkTags are deduplicated in LayoutTypeSystem, so equal pointers
+        // mean equal tags, and there's no need to look at the tags at all.
+        if (TagPointer == Other.TagPointer)
+          return false;
+
         if (nullptr == TagPointer or nullptr == Other.TagPointer)
           return TagPointer < Other.TagPointer;
 
@@ -200,7 +330,11 @@ struct LayoutTypeSystemNode {
     }
   };
 
-  using NeighborsSet = std::set<Link, NeighborLinkComparison>;
+  using NeighborsAllocator = trace::CountingAllocator<Link,
+                                                      &NeighborsAllocations>;
+  using NeighborsSet = std::set<Link,
+                                NeighborLinkComparison,
+                                NeighborsAllocator>;
   using NeighborIterator = NeighborsSet::iterator;
   NeighborsSet Successors{};
   NeighborsSet Predecessors{};
@@ -208,6 +342,9 @@ struct LayoutTypeSystemNode {
   InterferingChildrenInfo InterferingInfo{ Unknown };
   bool NonScalar{ false };
 
+  /// Epoch of the last LayoutTypeSystem::VisitEpoch that visited this node
+  mutable uint32_t VisitStamp{ 0 };
+
   LayoutTypeSystemNode(uint64_t I) : ID(I) {}
 
 public:
@@ -231,6 +368,9 @@ private:
   // ID of the first removed ID
   std::optional<unsigned> RemovedID = {};
   unsigned NElems = 0;
+  // The members of each class are linked in a circular list: NextMember[ID] is
+  // the next element in the same class of ID.
+  std::vector<unsigned> NextMember;
 
 private:
   /// Used internally, operator[] is removed for this class
@@ -242,6 +382,9 @@ public:
   /// Add 1 element with its own equivalence class
   unsigned growBy1();
 
+  /// Join the classes of \a A and \a B, returning the new leader
+  unsigned join(unsigned A, unsigned B);
+
   /// Remove the whole equivalence class of \a ID
   void remove(const unsigned ID);
 
@@ -259,8 +402,8 @@ public:
   ///\return empty if the element is out-of-bounds or has been removed
   std::optional<unsigned> getEqClassID(const unsigned ID) const;
 
-  /// Get all the elements that are in the same equivalence class of \a ID
-  ///\note Expensive: performs a linear scan of all the elements
+  /// Get all the elements that are in the same equivalence class of \a ID,
+  /// sorted by increasing ID
   std::vector<unsigned> computeEqClass(const unsigned ID) const;
 
   /// Check if \a ID1 and \a ID2 have the same equivalence class
@@ -310,14 +453,26 @@ protected:
       return std::make_pair(nullptr, false);
     revng_assert(Layouts.contains(Src));
     revng_assert(Layouts.contains(Tgt));
-    auto It = LinkTags.insert(std::forward<TagT>(Tag)).first;
-    revng_assert(It != LinkTags.end());
-    const TypeLinkTag *T = &*It;
+    const TypeLinkTag *T = internTag(std::forward<TagT>(Tag));
     bool New = Src->Successors.insert(std::make_pair(Tgt, T)).second;
     New |= Tgt->Predecessors.insert(std::make_pair(Src, T)).second;
     return std::make_pair(T, New);
   }
 
+  // This method is templated only to enable perfect forwarding.
+  template<typename TagT>
+  const TypeLinkTag *internTag(TagT &&Tag) {
+    auto It = LinkTags.find(Tag);
+    if (It != LinkTags.end())
+      return &*It;
+
+    TypeLinkTag New(std::forward<TagT>(Tag));
+    revng_assert(LinkTags.size() < TypeLinkTag::InvalidID);
+    New.ID = LinkTags.size();
+    It = LinkTags.insert(std::move(New)).first;
+    return &*It;
+  }
+
 public:
   std::pair<const TypeLinkTag *, bool>
   addEqualityLink(LayoutTypeSystemNode *Src, LayoutTypeSystemNode *Tgt) {
@@ -367,6 +522,54 @@ public:
   }
 
 public:
+  /// The set of nodes visited by a traversal of a LayoutTypeSystem, suitable
+  /// as external storage for llvm::post_order_ext and llvm::depth_first_ext.
+  ///
+  /// Nodes are not stored anywhere: visiting a node stamps it with the epoch
+  /// of the traversal, so marking and checking nodes never allocates. Since
+  /// the stamps live in the nodes, starting a new VisitEpoch on a
+  /// LayoutTypeSystem invalidates the previous one.
+  class VisitEpoch {
+  private:
+    const LayoutTypeSystem &TS;
+    uint32_t Epoch = 0;
+
+  public:
+    explicit VisitEpoch(const LayoutTypeSystem &TS);
+
+    VisitEpoch(const VisitEpoch &) = delete;
+    VisitEpoch &operator=(const VisitEpoch &) = delete;
+
+  public:
+    bool contains(const LayoutTypeSystemNode *N) const {
+      revng_assert(Epoch == TS.LastVisitEpoch);
+      return N->VisitStamp == Epoch;
+    }
+
+    size_t count(const LayoutTypeSystemNode *N) const { return contains(N); }
+
+    std::pair<const LayoutTypeSystemNode *, bool>
+    insert(const LayoutTypeSystemNode *N) {
+      bool New = not contains(N);
+      N->VisitStamp = Epoch;
+      return { N, New };
+    }
+
+    template<typename IteratorT>
+    void insert(IteratorT Begin, IteratorT End) {
+      for (; Begin != End; ++Begin)
+        insert(*Begin);
+    }
+  };
+
+  /// Start a new traversal, with no node visited yet
+  VisitEpoch startVisit() const { return VisitEpoch(*this); }
+
+public:
+  /// Merge all the nodes in \a ToMerge into the first one.
+  ///
+  /// The links of all the merged nodes are rewired at once, so merging many
+  /// nodes in a single call is cheaper than merging them one pair at a time.
   void mergeNodes(llvm::ArrayRef<LayoutTypeSystemNode *> ToMerge);
 
   void removeNode(LayoutTypeSystemNode *N);
@@ -389,13 +592,17 @@ public:
 private:
   uint64_t NID = 0ULL;
 
+  // The epoch of the last VisitEpoch, the only one that can be used
+  mutable uint32_t LastVisitEpoch = 0;
+
   // Holds all the LayoutTypeSystemNode
   llvm::BumpPtrAllocator NodeAllocator = {};
   std::set<LayoutTypeSystemNode *> Layouts = {};
 
   // Holds the link tags, so that they can be deduplicated and referred to using
-  // TypeLinkTag * in the links inside LayoutTypeSystemNode
-  std::set<TypeLinkTag> LinkTags = {};
+  // TypeLinkTag * in the links inside LayoutTypeSystemNode. Elements of an
+  // unordered_set are never moved, so the pointers stay valid.
+  std::unordered_set<TypeLinkTag, TypeLinkTag::Hash> LinkTags = {};
 
 public:
   // Checks that is valid, and returns true if it is, false otherwise
@@ -421,6 +628,30 @@ private:
   // Object that defines how the content of each node should be printed
   std::unique_ptr<TSDebugPrinter> DebugPrinter;
 
+public:
+  /// Estimate of the memory taken by a LayoutTypeSystem, in bytes
+  struct MemoryUsage {
+    /// The nodes, as allocated by NodeAllocator
+    size_t Nodes = 0;
+    /// The entries of the Successors and Predecessors of all the nodes
+    size_t Edges = 0;
+    /// The interned TypeLinkTags, with the OffsetExpressions stored out of line
+    size_t Tags = 0;
+
+    size_t total() const { return Nodes + Edges + Tags; }
+  };
+
+  /// Walks all the nodes, so it's linear in the size of the graph
+  MemoryUsage computeMemoryUsage() const;
+
+  /// Steps creating lots of new nodes and edges can check this to trade
+  /// precision for memory, see StepManager::run
+  bool isMemoryConstrained() const { return MemoryConstrained; }
+  void setMemoryConstrained() { MemoryConstrained = true; }
+
+private:
+  bool MemoryConstrained = false;
+
 public:
   unsigned getNID() const { return NID; }
 
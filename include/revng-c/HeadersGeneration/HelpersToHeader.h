@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <string>
+
 namespace llvm {
 
 class raw_ostream;
@@ -11,8 +13,20 @@ class Module;
 
 } // end namespace llvm
 
+/// The header printed by the last call to dumpHelpersToHeader, along with the
+/// names and the types of the helpers it was printed from
+struct HelpersHeaderCache {
+  std::string Signature;
+  std::string Header;
+};
+
 /// Generate a C header containing the declaration of each non-isolated
 /// function in a given LLVM IR module, i.e. QEMU helpers and revng helpers,
 /// whose prototype is not in the model. For helpers that return a struct, a
 /// new struct type will be defined and serialized on-the-fly.
-bool dumpHelpersToHeader(const llvm::Module &M, llvm::raw_ostream &Out);
+///
+/// If \p Cache is not null, the header it holds is reused as long as the set
+/// of helpers to print doesn't change.
+bool dumpHelpersToHeader(const llvm::Module &M,
+                         llvm::raw_ostream &Out,
+                         HelpersHeaderCache *Cache = nullptr);
@@ -15,6 +15,7 @@
 #include "revng/Pipes/FileContainer.h"
 #include "revng/Pipes/Kinds.h"
 
+#include "revng-c/HeadersGeneration/HelpersToHeader.h"
 #include "revng-c/Pipes/Kinds.h"
 
 namespace revng::pipes {
@@ -31,6 +32,12 @@ class HelpersToHeader {
 public:
   static constexpr auto Name = "helpers-to-header";
 
+private:
+  /// The header printed in the previous run of this pipe. It's printed again
+  /// only if the helpers in the module have changed since then.
+  HelpersHeaderCache PreviousRun;
+
+public:
   std::array<pipeline::ContractGroup, 1> getContract() const {
     using namespace pipeline;
     using namespace revng::kinds;
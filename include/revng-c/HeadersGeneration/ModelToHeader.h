@@ -35,6 +35,17 @@ struct ModelToHeaderOptions {
 /// Generate a C header containing a serialization of the type system,
 /// i.e. function prototypes, structs, unions, typedefs, and anything that
 /// resides in the model.
+///
+/// The header is streamed to \p Out as it's generated, a definition at a time.
+/// Besides the model, the memory used grows with the number of types: two
+/// nodes per type in the dependency graph, which is needed until the last
+/// post-order visit is over, the names of the array wrappers emitted so far,
+/// which must not be emitted twice, and the type inlining decisions.
 bool dumpModelToHeader(const model::Binary &Model,
                        llvm::raw_ostream &Out,
                        const ModelToHeaderOptions &Options);
+
+/// A rough estimate of the size of the header dumpModelToHeader emits for
+/// \p Model with \p Options, to reserve the buffer it is emitted to
+size_t estimateModelHeaderSize(const model::Binary &Model,
+                               const ModelToHeaderOptions &Options);
@@ -4,7 +4,23 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstdint>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+
 #include "revng/Model/Binary.h"
 
 std::string dumpModelTypeDefinition(const model::Binary &Model,
                                     model::Type::Key Key);
+
+/// Emit the definition of each of the types in \a Keys, possibly in parallel.
+/// The results are in the same order as \a Keys.
+std::vector<std::string>
+dumpModelTypeDefinitions(const model::Binary &Model,
+                         llvm::ArrayRef<model::Type::Key> Keys);
+
+/// Hash of what the definition of the type \a Key depends upon: the type
+/// itself, and the types it refers to, since their names appear in it.
+uint64_t fingerprintModelTypeDefinition(const model::Binary &Model,
+                                        model::Type::Key Key);
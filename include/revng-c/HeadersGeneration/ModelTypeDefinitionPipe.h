@@ -5,6 +5,8 @@
 //
 
 #include <array>
+#include <cstdint>
+#include <map>
 #include <string>
 
 #include "llvm/ADT/ArrayRef.h"
@@ -38,6 +40,21 @@ class GenerateModelTypeDefinition {
 public:
   static constexpr auto Name = "generate-model-type-definition";
 
+private:
+  using KeyType = ModelTypeDefinitionStringMap::KeyType;
+
+  struct CachedDefinition {
+    /// See fingerprintModelTypeDefinition
+    uint64_t Fingerprint = 0;
+    std::string Definition;
+  };
+
+  /// The definitions printed by the previous runs of this pipe. Each one is
+  /// valid as long as the fingerprint of its type doesn't change, so editing
+  /// a type only invalidates it and the types referring to it.
+  std::map<KeyType, CachedDefinition> PreviousDefinitions;
+
+public:
   std::array<pipeline::ContractGroup, 1> getContract() const {
     using namespace pipeline;
     using namespace revng::kinds;
@@ -0,0 +1,24 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+/// The clang arguments to compile the decompiled C code with: the flags in
+/// share/revng-c/compile-flags.cfg, and the include paths of the compiler
+/// headers and of the revng-c headers (revng-primitive-types.h and
+/// revng-attributes.h)
+llvm::Expected<std::vector<std::string>> getDecompiledCCompilation();
+
+/// Precompile the plain C headers at \p HeaderPaths, included in this order,
+/// to a clang precompiled header in \p PCHPath
+llvm::Error precompileHeaders(llvm::ArrayRef<std::string> HeaderPaths,
+                              llvm::StringRef PCHPath,
+                              const std::vector<std::string> &Compilation);
@@ -0,0 +1,70 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <array>
+#include <string>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/Contract.h"
+#include "revng/Pipes/FileContainer.h"
+
+#include "revng-c/HeadersGeneration/HelpersToHeaderPipe.h"
+#include "revng-c/HeadersGeneration/ModelToHeaderPipe.h"
+#include "revng-c/Pipes/Kinds.h"
+
+namespace revng::pipes {
+
+inline constexpr char PrecompiledHeadersMIMEType[] = "application/x.clang-pch";
+inline constexpr char PrecompiledHeadersSuffix[] = ".h.pch";
+inline constexpr char PrecompiledHeadersName[] = "precompiled-headers";
+using PrecompiledHeadersFileContainer = FileContainer<
+  &kinds::PrecompiledHeaders,
+  PrecompiledHeadersName,
+  PrecompiledHeadersMIMEType,
+  PrecompiledHeadersSuffix>;
+
+/// Precompile the model header and the helpers header, in the order the
+/// decompiled C code includes them, for the architecture of the binary.
+///
+/// The PCH can be passed to clang with `-include-pch` when compiling the
+/// decompiled C code with the flags in compile-flags.cfg. The headers are
+/// embedded in it, and their include guards make clang skip them when the
+/// decompiled C code includes them again.
+class PrecompileHeaders {
+public:
+  static constexpr auto Name = "precompile-headers";
+
+  std::array<pipeline::ContractGroup, 1> getContract() const {
+    using namespace pipeline;
+    using namespace revng::kinds;
+
+    Contract FromModelHeader(ModelHeader,
+                             0,
+                             PrecompiledHeaders,
+                             2,
+                             InputPreservation::Preserve);
+    Contract FromHelpersHeader(HelpersHeader,
+                               1,
+                               PrecompiledHeaders,
+                               2,
+                               InputPreservation::Preserve);
+    return { ContractGroup({ FromModelHeader, FromHelpersHeader }) };
+  }
+
+  void run(const pipeline::ExecutionContext &Ctx,
+           const ModelHeaderFileContainer &ModelHeaderFile,
+           const HelpersHeaderFileContainer &HelpersHeaderFile,
+           PrecompiledHeadersFileContainer &PCHFile);
+
+  void print(const pipeline::Context &Ctx,
+             llvm::raw_ostream &OS,
+             llvm::ArrayRef<std::string> ContainerNames) const;
+};
+
+} // end namespace revng::pipes
@@ -6,7 +6,11 @@
 
 #include <map>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+
 #include "revng/EarlyFunctionAnalysis/FunctionMetadataCache.h"
+#include "revng/Model/QualifiedType.h"
 
 namespace llvm {
 class Value;
@@ -15,10 +19,20 @@ class Function;
 
 namespace model {
 class Function;
-class QualifiedType;
 class Binary;
+class Type;
 } // namespace model
 
+/// Maps each llvm::Value to its QualifiedType, see initModelTypes
+using ModelTypesMap = llvm::DenseMap<const llvm::Value *, model::QualifiedType>;
+
+/// Maps each prototype to the QualifiedTypes returned by the calls to it, so
+/// that they are computed once and not at each call site. It can be shared by
+/// the calls to initModelTypes on different functions, as long as the model
+/// doesn't change.
+using PrototypeReturnTypesMap
+  = std::map<const model::Type *, llvm::SmallVector<model::QualifiedType>>;
+
 /// Associate a QualifiedType to each llvm::Instruction. This is done
 /// in 3 ways:
 /// 1. If the Value has a well defined type in the model (e.g. the stack), use
@@ -28,9 +42,16 @@ class Binary;
 /// 3. In all other cases, derive the QualifiedType from the LLVM Type
 /// \note If the `PointersOnly` flag is set, only pointer types will be added to
 /// the map
-extern std::map<const llvm::Value *, const model::QualifiedType>
-initModelTypes(FunctionMetadataCache &Cache,
-               const llvm::Function &F,
-               const model::Function *ModelF,
-               const model::Binary &Model,
-               bool PointersOnly);
+extern ModelTypesMap initModelTypes(FunctionMetadataCache &Cache,
+                                    const llvm::Function &F,
+                                    const model::Function *ModelF,
+                                    const model::Binary &Model,
+                                    bool PointersOnly);
+
+/// Same as the above, reusing and populating \p ReturnTypes
+extern ModelTypesMap initModelTypes(FunctionMetadataCache &Cache,
+                                    const llvm::Function &F,
+                                    const model::Function *ModelF,
+                                    const model::Binary &Model,
+                                    bool PointersOnly,
+                                    PrototypeReturnTypesMap &ReturnTypes);
@@ -0,0 +1,62 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <optional>
+
+#include "llvm/Pass.h"
+
+#include "revng/EarlyFunctionAnalysis/FunctionMetadataCache.h"
+#include "revng/Model/Binary.h"
+#include "revng/Model/QualifiedType.h"
+
+#include "revng-c/InitModelTypes/InitModelTypes.h"
+
+/// Caches the result of initModelTypes on a function, so that the passes that
+/// need it can share it.
+///
+/// The passes using it should also preserve it, and call invalidate() if they
+/// changed the IR: in this way the types are computed again only if the IR has
+/// actually changed in the meantime. Passes that don't preserve it make the
+/// pass manager schedule a new instance anyway.
+class ModelTypesAnalysis : public llvm::FunctionPass {
+public:
+  static char ID;
+
+private:
+  const llvm::Function *F = nullptr;
+  FunctionMetadataCache *Cache = nullptr;
+  const model::Binary *Model = nullptr;
+  std::optional<ModelTypesMap> AllTypes;
+  std::optional<ModelTypesMap> PointerTypes;
+
+  /// Shared by all the functions, as long as the model stays the same
+  PrototypeReturnTypesMap ReturnTypes;
+
+public:
+  ModelTypesAnalysis() : llvm::FunctionPass(ID) {}
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+
+  bool runOnFunction(llvm::Function &F) override;
+
+  bool doFinalization(llvm::Module &M) override {
+    ReturnTypes.clear();
+    Model = nullptr;
+    return false;
+  }
+
+  void releaseMemory() override {
+    AllTypes.reset();
+    PointerTypes.reset();
+  }
+
+  /// Drop the cached types, to be called by the passes that changed the IR
+  void invalidate() { releaseMemory(); }
+
+  /// Get the types that initModelTypes associates to the values of the last
+  /// function this ran on, computing them the first time they're requested.
+  const ModelTypesMap &getModelTypes(bool PointersOnly);
+};
@@ -47,6 +47,18 @@ inline FunctionKind Decompiled("decompiled",
                                fat(ranks::Function),
                                { &ModelHeader });
 
+inline FunctionKind DecompiledLocations("decompiled-locations",
+                                        ModelHeader,
+                                        ranks::Function,
+                                        fat(ranks::Function),
+                                        { &ModelHeader });
+
+inline FunctionKind DecompiledPlainC("decompiled-plain-c",
+                                     ModelHeader,
+                                     ranks::Function,
+                                     fat(ranks::Function),
+                                     { &ModelHeader });
+
 inline TypeKind ModelTypeDefinition("model-type-definition",
                                     ModelHeader,
                                     ranks::Type,
@@ -56,6 +68,9 @@ inline TypeKind ModelTypeDefinition("model-type-definition",
 inline pipeline::SingleElementKind
   HelpersHeader("helpers-header", Binary, ranks::Binary, {}, {});
 
+inline pipeline::SingleElementKind
+  PrecompiledHeaders("precompiled-headers", Binary, ranks::Binary, {}, {});
+
 inline pipeline::SingleElementKind
   MLIRLLVMModule("mlir-llvm-module", Binary, ranks::Binary, {}, {});
 
@@ -65,4 +80,10 @@ inline pipeline::SingleElementKind DecompiledToC("decompiled-to-c",
                                                  fat(ranks::Function),
                                                  { &ModelHeader });
 
+inline pipeline::SingleElementKind DecompiledPack("decompiled-pack",
+                                                  Binary,
+                                                  ranks::Binary,
+                                                  fat(ranks::Function),
+                                                  { &ModelHeader });
+
 } // namespace revng::kinds
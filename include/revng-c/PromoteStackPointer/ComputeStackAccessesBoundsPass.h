@@ -6,6 +6,11 @@
 
 #include "llvm/Pass.h"
 
+namespace llvm {
+class CallInst;
+class LazyValueInfo;
+} // namespace llvm
+
 /// Enrich StackOffsetMarker-tagged calls with LazyValueInfo boundaries info
 struct ComputeStackAccessesBoundsPass : public llvm::ModulePass {
 public:
@@ -17,3 +22,7 @@ public:
 
   bool runOnModule(llvm::Module &M) override;
 };
+
+/// Replace the bounds of the StackOffsetMarker-tagged call \p Call with the
+/// constant ranges \p LVI finds for them, or undef if there are none
+void computeStackAccessBounds(llvm::LazyValueInfo &LVI, llvm::CallInst *Call);
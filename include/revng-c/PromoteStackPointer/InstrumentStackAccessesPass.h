@@ -4,9 +4,41 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <set>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
 
 #include "revng/Support/FunctionTags.h"
+#include "revng/Support/OpaqueFunctionsPool.h"
+
+/// Wraps the stack accesses of one function at a time, see
+/// InstrumentStackAccessesPass
+class InstrumentStackAccesses {
+private:
+  OpaqueFunctionsPool<llvm::Type *> StackOffsetPool;
+  llvm::CallInst *SP0 = nullptr;
+  llvm::Type *SPType = nullptr;
+
+public:
+  InstrumentStackAccesses(llvm::Module &M);
+
+public:
+  /// \return the StackOffsetMarker-tagged calls wrapping the stack accesses
+  ///         of \p F
+  llvm::SmallVector<llvm::CallInst *, 16> run(llvm::Function &F);
+
+private:
+  void reset() {
+    SP0 = nullptr;
+    SPType = nullptr;
+  }
+
+  std::set<llvm::Instruction *> findStackAccesses(llvm::Function &F);
+  llvm::CallInst *instrumentStackAccess(llvm::Instruction *I);
+};
 
 /// Wrap stack accesses into StackOffsetMarker-tagged calls
 ///
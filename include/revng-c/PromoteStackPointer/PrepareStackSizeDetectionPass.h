@@ -0,0 +1,22 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Pass.h"
+
+/// Prepare the functions for DetectStackSizePass in a single pass, doing the
+/// job of RemoveStackAlignmentPass, InstrumentStackAccessesPass, instcombine,
+/// RemoveExtractValuesPass and ComputeStackAccessesBoundsPass, one function at
+/// a time.
+struct PrepareStackSizeDetectionPass : public llvm::ModulePass {
+public:
+  static char ID;
+
+  PrepareStackSizeDetectionPass() : llvm::ModulePass(ID) {}
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+
+  bool runOnModule(llvm::Module &M) override;
+};
@@ -22,3 +22,7 @@ public:
 
   bool runOnModule(llvm::Module &M) override;
 };
+
+/// Drop the stack alignment code from all the functions in \p M, the same as
+/// RemoveStackAlignmentPass
+bool removeStackAlignment(llvm::Module &M);
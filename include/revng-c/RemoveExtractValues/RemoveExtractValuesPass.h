@@ -6,13 +6,22 @@
 
 #include "llvm/Pass.h"
 
+#include "revng-c/Support/FunctionTags.h"
+
 class RemoveExtractValues : public llvm::FunctionPass {
 public:
   static char ID;
 
+private:
+  /// Only valid between doInitialization and doFinalization: it refers to the
+  /// functions of the module being run on
+  SharedOpaqueFunctionsPool<TypePair> OpaqueEVPool{ initOpaqueEVPool };
+
 public:
   RemoveExtractValues() : llvm::FunctionPass(ID) {}
 
+  bool doInitialization(llvm::Module &) override;
   bool runOnFunction(llvm::Function &) override;
+  bool doFinalization(llvm::Module &) override;
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
 };
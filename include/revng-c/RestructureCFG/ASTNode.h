@@ -6,6 +6,8 @@
 
 #include <cstdlib>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SmallVector.h"
@@ -85,6 +87,10 @@ public:
 public:
   static void deleteASTNode(ASTNode *A);
 
+  // All the nodes are allocated from a pool, see GHASTNodePool.
+  static void *operator new(size_t Size);
+  static void operator delete(void *Pointer, size_t Size);
+
 protected:
   ASTNode(const ASTNode &) = default;
   ~ASTNode() = default;
@@ -104,6 +110,10 @@ public:
 
   llvm::BasicBlock *getBB() const { return BB; }
 
+  /// Make the node refer to \p NewBB, the counterpart of BB in another copy
+  /// of the same function
+  void setBB(llvm::BasicBlock *NewBB) { BB = NewBB; }
+
   ASTNode *getSuccessor() const { return Successor; }
 
   ASTNode *consumeSuccessor() {
@@ -647,6 +657,8 @@ public:
 
   llvm::Value *getCondition() const { return Condition; }
 
+  void setCondition(llvm::Value *NewCondition) { Condition = NewCondition; }
+
   bool isWeaved() const { return IsWeaved; }
 
   DispatcherKind getDispatcherKind() const {
@@ -801,3 +813,32 @@ inline bool ASTNode::isEqual(const ASTNode *Node) const {
     revng_abort();
   }
 }
+
+/// Memoized structural hash of GHAST subtrees, used to quickly tell apart
+/// subtrees that can't be equal according to ASTNode::isEqual.
+///
+/// Two subtrees for which isEqual returns true always have the same hash.
+/// Since isEqual does not look at the condition of an IfNode, and only looks at
+/// its branches in some cases, the hash of an IfNode does not depend on either.
+///
+/// Nodes don't know their parents, so the cached hashes can't be invalidated
+/// automatically when a subtree changes: users have to call invalidate() after
+/// any change that can affect the hash of a node, i.e. anything that is not a
+/// change of the branches or of the condition of an IfNode.
+class ASTStructuralHashes {
+private:
+  llvm::DenseMap<const ASTNode *, llvm::hash_code> Hashes;
+
+public:
+  llvm::hash_code get(const ASTNode *Node);
+
+  /// Same as \p A->isEqual(\p B), but skips the comparison of the subtrees
+  /// when their hashes differ.
+  bool isEqual(const ASTNode *A, const ASTNode *B) {
+    if (B != nullptr and get(A) != get(B))
+      return false;
+    return A->isEqual(B);
+  }
+
+  void invalidate() { Hashes.clear(); }
+};
@@ -7,7 +7,10 @@
 #include <cstdlib>
 #include <type_traits>
 
+#include "llvm/ADT/DenseMap.h"
+
 #include "revng-c/RestructureCFG/ASTNode.h"
+#include "revng-c/Support/CountingAllocator.h"
 
 // Forward declarations.
 class ASTNode;
@@ -17,6 +20,9 @@ class BasicBlockNode;
 
 class SequenceNode;
 
+/// Accounts the allocations of the node lists of all the ASTTrees
+extern trace::AllocationCounters ASTAllocations;
+
 class ASTTree {
 
 public:
@@ -32,7 +38,9 @@ public:
 
   static_assert(std::is_same_v<decltype(&getPointer), getPointerT>);
 
-  using links_container = std::vector<ast_unique_ptr>;
+  using links_allocator = trace::CountingAllocator<ast_unique_ptr,
+                                                   &ASTAllocations>;
+  using links_container = std::vector<ast_unique_ptr, links_allocator>;
   using internal_iterator = typename links_container::iterator;
   using links_iterator = llvm::mapped_iterator<internal_iterator, getPointerT>;
   using links_range = llvm::iterator_range<links_iterator>;
@@ -42,7 +50,10 @@ public:
                                                  &ExprNode::deleteExprNode>;
   using expr_unique_ptr = std::unique_ptr<ExprNode, expr_destructor>;
 
-  using links_container_expr = std::vector<expr_unique_ptr>;
+  using links_allocator_expr = trace::CountingAllocator<expr_unique_ptr,
+                                                        &ASTAllocations>;
+  using links_container_expr = std::vector<expr_unique_ptr,
+                                           links_allocator_expr>;
   using links_iterator_expr = typename links_container_expr::iterator;
   using links_range_expr = llvm::iterator_range<links_iterator_expr>;
 
@@ -62,8 +73,8 @@ public:
 
 private:
   links_container ASTNodeList = {};
-  std::map<BasicBlockNodeBB *, ASTNode *> BBASTMap = {};
-  std::map<ASTNode *, BasicBlockNodeBB *> ASTBBMap = {};
+  llvm::DenseMap<BasicBlockNodeBB *, ASTNode *> BBASTMap = {};
+  llvm::DenseMap<ASTNode *, BasicBlockNodeBB *> ASTBBMap = {};
   ASTNode *RootNode = nullptr;
   unsigned IDCounter = 0;
   links_container_expr CondExprList = {};
@@ -126,5 +137,11 @@ public:
                                     const std::string &FolderName,
                                     const std::string &FileName) const;
 
+  /// Take ownership of \p Expr, returning a pointer to it
+  ///
+  /// Expressions are not hash-consed: the beautification passes rewrite them
+  /// in place (e.g., flipping a `CompareNode`, or replacing the operands of a
+  /// `NotNode` or a `BinaryNode` through their addresses), so structurally
+  /// identical conditions must not share storage.
   ExprNode *addCondExpr(expr_unique_ptr &&Expr);
 };
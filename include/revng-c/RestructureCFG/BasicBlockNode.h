@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstdint>
 #include <cstdlib>
 #include <map>
 #include <set>
@@ -27,7 +28,7 @@ protected:
   using BasicBlockNodeMap = std::map<BasicBlockNode *, BasicBlockNode *>;
 
 public:
-  enum class Type {
+  enum class Type : uint8_t {
     Code,
     Empty,
     Break,
@@ -91,9 +92,30 @@ public:
   using child_const_range = llvm::iterator_range<child_const_iterator>;
 
 protected:
+  // The fields used while visiting the graph come first, followed by the small
+  // ones packed together, while the name, which is only used for debugging, is
+  // last.
+
+  /// List of successors
+  links_container Successors;
+
+  /// List of predecessors
+  links_container Predecessors;
+
   /// Unique Node Id inside a RegionCFG<NodeT>, useful for printing to graphviz
   unsigned ID;
 
+  unsigned StateVariableValue;
+
+  /// Flag to identify the exit type of a block
+  Type NodeType;
+
+  // Flag for nodes that were created by weaving switches
+  bool Weaved;
+
+  // Original object pointer
+  NodeT OriginalNode;
+
   /// Pointer to the parent RegionCFG<NodeT>
   RegionCFGT *Parent;
 
@@ -103,26 +125,9 @@ protected:
   // RegionCFG<NodeT>
   RegionCFGT *CollapsedRegion;
 
-  /// Flag to identify the exit type of a block
-  Type NodeType;
-
   /// Name of the basic block.
   llvm::SmallString<32> Name;
 
-  unsigned StateVariableValue;
-
-  /// List of successors
-  links_container Successors;
-
-  /// List of predecessors
-  links_container Predecessors;
-
-  // Original object pointer
-  NodeT OriginalNode;
-
-  // Flag for nodes that were created by weaving switches
-  bool Weaved;
-
   explicit BasicBlockNode(RegionCFGT *Parent,
                           NodeT OriginalNode,
                           RegionCFGT *Collapsed,
@@ -45,13 +45,13 @@ inline BasicBlockNode<NodeT>::BasicBlockNode(RegionCFGT *Parent,
                                              Type T,
                                              unsigned Value) :
   ID(Parent->getNewID()),
-  Parent(Parent),
-  CollapsedRegion(Collapsed),
-  NodeType(T),
-  Name(Name),
   StateVariableValue(Value),
+  NodeType(T),
+  Weaved(false),
   OriginalNode(OriginalNode),
-  Weaved(false) {
+  Parent(Parent),
+  CollapsedRegion(Collapsed),
+  Name(Name) {
 }
 
 // Needed by `DomTreeBuilder`.
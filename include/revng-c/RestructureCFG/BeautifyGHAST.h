@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstdint>
+
 namespace llvm {
 
 class Function;
@@ -12,5 +14,25 @@ class Function;
 
 class ASTTree;
 
-extern void
-beautifyAST(const model::Binary &Model, llvm::Function &F, ASTTree &CombedAST);
+/// Statistics about a single invocation of beautifyAST
+struct BeautifyStatistics {
+  /// Number of nested `if`s merged in a short-circuit condition
+  unsigned ShortCircuits = 0;
+
+  /// Number of `if`s without `else` merged in a short-circuit condition with
+  /// the `if` without `else` that was their `then`
+  unsigned TrivialShortCircuits = 0;
+};
+
+extern void beautifyAST(const model::Binary &Model,
+                        llvm::Function &F,
+                        ASTTree &CombedAST,
+                        BeautifyStatistics *Statistics = nullptr);
+
+/// Hash of the parts of \p Model beautifyAST depends on when run on \p F,
+/// i.e., which of the functions called by \p F are `noreturn`.
+///
+/// As long as this and the IR of \p F don't change, neither does the GHAST
+/// beautifyAST produces.
+extern uint64_t hashBeautifyModelDependencies(const model::Binary &Model,
+                                              const llvm::Function &F);
@@ -40,6 +40,10 @@ public:
 
   static void deleteExprNode(ExprNode *E);
 
+  // All the nodes are allocated from a pool, see GHASTNodePool.
+  static void *operator new(size_t Size);
+  static void operator delete(void *Pointer, size_t Size);
+
 protected:
   ExprNode(NodeKind K) : Kind(K) {}
   ~ExprNode() = default;
@@ -143,6 +147,11 @@ public:
     revng_assert(BB);
     return BB;
   }
+
+  void setBasicBlock(llvm::BasicBlock *NewBB) {
+    revng_assert(NewBB != nullptr);
+    BB = NewBB;
+  }
 };
 
 class LoopStateCompareNode : public CompareNode {
@@ -184,6 +193,8 @@ protected:
 
 public:
   llvm::BasicBlock *getConditionalBasicBlock() const { return ConditionBB; }
+
+  void setConditionalBasicBlock(llvm::BasicBlock *BB) { ConditionBB = BB; }
 };
 
 class NotNode : public ExprNode {
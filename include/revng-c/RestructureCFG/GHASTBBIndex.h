@@ -0,0 +1,44 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+
+class ASTNode;
+class ASTTree;
+namespace llvm {
+class BasicBlock;
+}
+
+/// Index of the GHAST nodes that cover each `llvm::BasicBlock` of a function,
+/// i.e. the nodes emitting its code or using it as a condition.
+///
+/// It is computed with a single visit of the final (beautified) GHAST, which
+/// also collects the other facts the backend needs about the whole tree.
+class GHASTBBIndex {
+public:
+  using NodeList = llvm::SmallVector<const ASTNode *, 2>;
+
+private:
+  llvm::DenseMap<const llvm::BasicBlock *, NodeList> CoveringNodes;
+  bool NeedsLoopStateVar = false;
+
+public:
+  explicit GHASTBBIndex(const ASTTree &GHAST);
+
+public:
+  llvm::ArrayRef<const ASTNode *>
+  coveringNodes(const llvm::BasicBlock *BB) const {
+    auto It = CoveringNodes.find(BB);
+    if (It == CoveringNodes.end())
+      return {};
+    return It->second;
+  }
+
+  /// Equivalent to `needsLoopVar` on the root of the GHAST
+  bool needsLoopStateVar() const { return NeedsLoopStateVar; }
+};
@@ -9,6 +9,7 @@
 #include <fstream>
 #include <iterator>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/ADT/GraphTraits.h"
 #include "llvm/ADT/PostOrderIterator.h"
@@ -173,6 +174,11 @@ inline void simplifyDummies(ASTTree &AST, ASTNode *RootNode) {
   }
 }
 
+/// Map from each tile to the node that was the head of the region it collapsed
+template<class NodeT>
+using TileMap = llvm::DenseMap<BasicBlockNode<NodeT> *,
+                               BasicBlockNode<NodeT> *>;
+
 template<class NodeT>
 inline BasicBlockNode<NodeT> *getDirectSuccessor(BasicBlockNode<NodeT> *Node) {
   BasicBlockNode<NodeT> *Successor = nullptr;
@@ -250,7 +256,7 @@ findCommonPostDom(BasicBlockNode<NodeT> *Succ1, BasicBlockNode<NodeT> *Succ2) {
 
 template<class NodeT>
 inline ASTNode *findASTNode(ASTTree &AST,
-                            typename RegionCFG<NodeT>::BBNodeMap &TileToNodeMap,
+                            TileMap<NodeT> &TileToNodeMap,
                             BasicBlockNode<NodeT> *Node) {
   if (auto It = TileToNodeMap.find(Node); It != TileToNodeMap.end())
     Node = It->second;
@@ -292,7 +298,7 @@ template<class NodeT>
 inline BasicBlockNode<NodeT> *
 createTileImpl(RegionCFG<NodeT> &Graph,
                llvm::DominatorTreeBase<BasicBlockNode<NodeT>, false> &ASTDT,
-               typename RegionCFG<NodeT>::BBNodeMap &TileToNodeMap,
+               TileMap<NodeT> &TileToNodeMap,
                BasicBlockNode<NodeT> *Node,
                BasicBlockNode<NodeT> *End,
                bool EndIsPartOfTile) {
@@ -336,7 +342,7 @@ template<class NodeT>
 inline BasicBlockNode<NodeT> *
 createTile(RegionCFG<NodeT> &Graph,
            llvm::DominatorTreeBase<BasicBlockNode<NodeT>, false> &ASTDT,
-           typename RegionCFG<NodeT>::BBNodeMap &TileToNodeMap,
+           TileMap<NodeT> &TileToNodeMap,
            BasicBlockNode<NodeT> *Node,
            BasicBlockNode<NodeT> *End,
            bool EndIsPartOfTile) {
@@ -368,7 +374,7 @@ template<class NodeT>
 inline BasicBlockNode<NodeT> *
 createSwitchTile(RegionCFG<NodeT> &Graph,
                  llvm::DominatorTreeBase<BasicBlockNode<NodeT>, false> &ASTDT,
-                 typename RegionCFG<NodeT>::BBNodeMap &TileToNodeMap,
+                 TileMap<NodeT> &TileToNodeMap,
                  BasicBlockNode<NodeT> *Node,
                  BasicBlockNode<NodeT> *End,
                  bool EndIsPartOfTile,
@@ -444,17 +450,18 @@ createSwitchTile(RegionCFG<NodeT> &Graph,
   return Tile;
 }
 
-inline void
-generateAst(RegionCFG<llvm::BasicBlock *> &Region,
-            ASTTree &AST,
-            std::map<RegionCFG<llvm::BasicBlock *> *, ASTTree> &CollapsedMap) {
-  // Define some using used in all the function body.
-  using NodeT = llvm::BasicBlock *;
-  using BasicBlockNodeT = typename RegionCFG<NodeT>::BasicBlockNodeT;
-
-  // Get some fields of `RegionCFG`.
-  std::string RegionName = Region.getRegionName();
-  std::string FunctionName = Region.getFunctionName();
+/// Apply weave and inflate to \p Region, unless it has already been combed.
+///
+/// Combing a RegionCFG only reads the untangle weight of the RegionCFGs it
+/// contains as collapsed nodes, hence, once those weights are computed,
+/// different RegionCFGs can be combed concurrently.
+///
+/// \return false if the comb has been abandoned since it needed more than
+///         \p MaxDuplications duplications (0 means no limit).
+inline bool combRegion(RegionCFG<llvm::BasicBlock *> &Region,
+                       size_t MaxDuplications = 0) {
+  if (Region.isCombed())
+    return true;
 
   Region.markUnreachableAsInlined();
 
@@ -462,7 +469,9 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
   Region.weave();
 
   // Invoke the inflate function.
-  Region.inflate();
+  if (not Region.inflate(MaxDuplications))
+    return false;
+  InflatedNodesCounter += Region.size();
 
   // After we are done with the combing, we need to pre-compute the weight of
   // the current RegionCFG, so that during the untangle phase of other
@@ -472,13 +481,32 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
   // where we can compute it is here.
   Region.computeUntangleWeight();
 
+  Region.setCombed();
+  return true;
+}
+
+inline void
+generateAst(RegionCFG<llvm::BasicBlock *> &Region,
+            ASTTree &AST,
+            std::map<RegionCFG<llvm::BasicBlock *> *, ASTTree> &CollapsedMap) {
+  // Define some using used in all the function body.
+  using NodeT = llvm::BasicBlock *;
+  using BasicBlockNodeT = typename RegionCFG<NodeT>::BasicBlockNodeT;
+
+  // Get some fields of `RegionCFG`.
+  std::string RegionName = Region.getRegionName();
+  std::string FunctionName = Region.getFunctionName();
+
+  bool Combed = combRegion(Region);
+  revng_assert(Combed);
+
   // TODO: factorize out the AST generation phase.
   llvm::DominatorTreeBase<BasicBlockNode<NodeT>, false> ASTDT;
   ASTDT.recalculate(Region);
 
   CombLogger << DoLog;
 
-  std::map<BasicBlockNode<NodeT> *, BasicBlockNode<NodeT> *> TileToNodeMap;
+  TileMap<NodeT> TileToNodeMap;
 
   using BasicBlockNodeTVect = typename RegionCFG<NodeT>::BasicBlockNodeTVect;
   BasicBlockNodeTVect PONodes;
@@ -637,13 +665,18 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
           SuccOfCases.push_back(SuccOfCase);
         }
 
+        // Count how many cases each node is the successor of, so that both the
+        // criteria below do not need to scan `SuccOfCases` for each case
+        llvm::SmallDenseMap<BasicBlockNodeT *, unsigned, 16> SuccCounterMap;
+        for (BasicBlockNodeT *Elem : SuccOfCases) {
+          SuccCounterMap[Elem]++;
+        }
+
         // Criterion 1:
         // For each successor, check if a certain one is successor of all the
         // other cases
         for (BasicBlockNodeT *Case : NotInlinedSuccessors) {
-          unsigned Count = std::count(SuccOfCases.begin(),
-                                      SuccOfCases.end(),
-                                      Case);
+          unsigned Count = SuccCounterMap.lookup(Case);
           if (Count > 0) {
             if ((getUniqueSuccessorOrNull(Case)
                  and Count == SuccOfCases.size() - 1)
@@ -657,11 +690,8 @@ generateAst(RegionCFG<llvm::BasicBlock *> &Region,
 
         // Criterion 2:
         // Search for node which is the successor for all the cases (excluding
-        // the inlined ones), even if not a successor of `Node` itself
-        std::map<BasicBlockNodeT *, unsigned> SuccCounterMap;
-        for (BasicBlockNodeT *Elem : SuccOfCases) {
-          SuccCounterMap[Elem]++;
-        }
+        // the inlined ones), even if not a successor of `Node` itself. At most
+        // one node can be, hence the iteration order does not matter.
         for (const auto &[Key, Value] : SuccCounterMap) {
           if (Value == SuccOfCases.size()) {
 
@@ -9,6 +9,7 @@
 #include <utility>
 #include <vector>
 
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/iterator_range.h"
 
@@ -18,6 +19,11 @@ template<class NodeT>
 class BasicBlockNode;
 
 /// The MetaRegion class, a wrapper for a set of nodes.
+///
+/// Besides the ordered set, used for iteration, membership is also tracked as
+/// a bitvector indexed by node ID, so that the region algebra does not have to
+/// walk the sets. Node IDs are only unique within a RegionCFG: as soon as a
+/// region holds nodes of different RegionCFGs, it falls back to the set.
 template<class NodeT>
 class MetaRegion {
 
@@ -25,7 +31,6 @@ public:
   using BasicBlockNodeT = typename BasicBlockNode<NodeT>::BasicBlockNodeT;
   using BasicBlockNodeTSet = std::set<BasicBlockNodeT *>;
   using BasicBlockNodeTVect = std::vector<BasicBlockNodeT *>;
-  using BasicBlockNodeTUPVect = std::vector<std::unique_ptr<BasicBlockNodeT>>;
   using EdgeDescriptor = typename BasicBlockNode<NodeT>::EdgeDescriptor;
 
   using links_container = std::set<BasicBlockNodeT *>;
@@ -44,16 +49,27 @@ public:
 private:
   int Index;
   links_container Nodes;
+  llvm::BitVector Members;
+  const RegionCFG<NodeT> *IDSpace;
+  bool MixedIDSpaces;
   MetaRegion<NodeT> *ParentRegion;
   bool IsSCS;
 
 public:
   MetaRegion(int Index, BasicBlockNodeTSet &Nodes, bool IsSCS = false) :
-    Index(Index), Nodes(Nodes), ParentRegion(nullptr), IsSCS(IsSCS) {}
+    Index(Index),
+    Nodes(Nodes),
+    IDSpace(nullptr),
+    MixedIDSpaces(false),
+    ParentRegion(nullptr),
+    IsSCS(IsSCS) {
+    for (BasicBlockNodeT *Node : Nodes)
+      addMember(Node);
+  }
 
   int getIndex() const { return Index; }
 
-  void replaceNodes(BasicBlockNodeTUPVect &NewNodes);
+  void replaceNodes(const BasicBlockNodeTVect &NewNodes);
 
   void updateNodes(const BasicBlockNodeTSet &Removal,
                    BasicBlockNodeT *Collapsed,
@@ -64,8 +80,6 @@ public:
 
   MetaRegion *getParent() const { return ParentRegion; }
 
-  std::set<BasicBlockNode<NodeT> *> &getNodes() { return Nodes; }
-
   const std::set<BasicBlockNode<NodeT> *> &getNodes() const { return Nodes; }
 
   size_t nodes_size() const { return Nodes.size(); }
@@ -91,17 +105,83 @@ public:
   bool nodesEquality(MetaRegion<NodeT> &Other) const;
 
   void mergeWith(MetaRegion<NodeT> &Other) {
-    BasicBlockNodeTSet &OtherNodes = Other.getNodes();
+    const BasicBlockNodeTSet &OtherNodes = Other.getNodes();
     Nodes.insert(OtherNodes.begin(), OtherNodes.end());
+
+    if (comparableWith(Other)) {
+      Members |= Other.Members;
+      if (IDSpace == nullptr)
+        IDSpace = Other.IDSpace;
+    } else {
+      for (BasicBlockNodeT *Node : OtherNodes)
+        addMember(Node);
+    }
   }
 
   bool isSCS() const { return IsSCS; }
 
   bool containsNode(BasicBlockNodeT *Node) const {
-    return Nodes.contains(Node);
+    if (MixedIDSpaces or Node->getParent() != IDSpace)
+      return Nodes.contains(Node);
+
+    unsigned ID = Node->getID();
+    return ID < Members.size() and Members.test(ID);
+  }
+
+  void insertNode(BasicBlockNodeT *NewNode) {
+    Nodes.insert(NewNode);
+    addMember(NewNode);
+  }
+
+  void removeNode(BasicBlockNodeT *Node) {
+    Nodes.erase(Node);
+    removeMember(Node);
+  }
+
+private:
+  /// Whether the bitvectors of this region and \p Other index the same nodes
+  bool comparableWith(const MetaRegion<NodeT> &Other) const {
+    if (MixedIDSpaces or Other.MixedIDSpaces)
+      return false;
+
+    return IDSpace == nullptr or Other.IDSpace == nullptr
+           or IDSpace == Other.IDSpace;
+  }
+
+  void addMember(BasicBlockNodeT *Node) {
+    if (MixedIDSpaces)
+      return;
+
+    if (IDSpace == nullptr)
+      IDSpace = Node->getParent();
+
+    if (Node->getParent() != IDSpace) {
+      MixedIDSpaces = true;
+      Members.clear();
+      return;
+    }
+
+    unsigned ID = Node->getID();
+    if (ID >= Members.size())
+      Members.resize(ID + 1);
+    Members.set(ID);
   }
 
-  void insertNode(BasicBlockNodeT *NewNode) { Nodes.insert(NewNode); }
+  void removeMember(BasicBlockNodeT *Node) {
+    if (MixedIDSpaces or Node->getParent() != IDSpace)
+      return;
 
-  void removeNode(BasicBlockNodeT *Node) { Nodes.erase(Node); }
+    unsigned ID = Node->getID();
+    if (ID < Members.size())
+      Members.reset(ID);
+  }
+
+  /// Rebuild the bitvector from scratch, possibly leaving the fallback mode
+  void recomputeMembers() {
+    Members.clear();
+    IDSpace = nullptr;
+    MixedIDSpaces = false;
+    for (BasicBlockNodeT *Node : Nodes)
+      addMember(Node);
+  }
 };
@@ -15,10 +15,10 @@
 #include "revng-c/RestructureCFG/MetaRegion.h"
 
 template<class NodeT>
-void MetaRegion<NodeT>::replaceNodes(BasicBlockNodeTUPVect &N) {
+void MetaRegion<NodeT>::replaceNodes(const BasicBlockNodeTVect &N) {
   Nodes.erase(Nodes.begin(), Nodes.end());
-  for (std::unique_ptr<BasicBlockNodeT> &Node : N)
-    Nodes.insert(Node.get());
+  Nodes.insert(N.begin(), N.end());
+  recomputeMembers();
 }
 
 template<class NodeT>
@@ -29,21 +29,22 @@ void MetaRegion<NodeT>::updateNodes(const BasicBlockNodeTSet &ToRemove,
                                       &DefaultEntrySet) {
   // Remove the old SCS nodes
   for (BasicBlockNodeT *Node : ToRemove)
-    Nodes.erase(Node);
+    removeNode(Node);
 
   // Add the collapsed node.
   revng_assert(nullptr != Collapsed);
-  Nodes.insert(Collapsed);
+  insertNode(Collapsed);
 
   // Add the exit dispatcher if present
   if (ExitDispatcher)
-    Nodes.insert(ExitDispatcher);
+    insertNode(ExitDispatcher);
 
   // Add the set nodes that come from outside if present
   revng_assert(not llvm::any_of(DefaultEntrySet, [this](BasicBlockNodeT *B) {
     return this->containsNode(B);
   }));
-  Nodes.insert(DefaultEntrySet.begin(), DefaultEntrySet.end());
+  for (BasicBlockNodeT *Node : DefaultEntrySet)
+    insertNode(Node);
 }
 
 template<class NodeT>
@@ -96,7 +97,10 @@ std::set<EdgeDescriptor<NodeT>> MetaRegion<NodeT>::getInEdges() {
 
 template<class NodeT>
 bool MetaRegion<NodeT>::intersectsWith(MetaRegion<NodeT> &Other) const {
-  BasicBlockNodeTSet &OtherNodes = Other.getNodes();
+  if (comparableWith(Other))
+    return Members.anyCommon(Other.Members);
+
+  const BasicBlockNodeTSet &OtherNodes = Other.getNodes();
 
   auto NodesIt = Nodes.begin();
   auto NodesEnd = Nodes.end();
@@ -120,7 +124,12 @@ bool MetaRegion<NodeT>::intersectsWith(MetaRegion<NodeT> &Other) const {
 
 template<class NodeT>
 bool MetaRegion<NodeT>::isSubSet(MetaRegion<NodeT> &Other) const {
-  BasicBlockNodeTSet &OtherNodes = Other.getNodes();
+  // BitVector::test(RHS) checks whether there are bits set in *this that are
+  // not set in RHS
+  if (comparableWith(Other))
+    return not Members.test(Other.Members);
+
+  const BasicBlockNodeTSet &OtherNodes = Other.getNodes();
   return std::includes(OtherNodes.begin(),
                        OtherNodes.end(),
                        Nodes.begin(),
@@ -129,7 +138,10 @@ bool MetaRegion<NodeT>::isSubSet(MetaRegion<NodeT> &Other) const {
 
 template<class NodeT>
 bool MetaRegion<NodeT>::isSuperSet(MetaRegion<NodeT> &Other) const {
-  BasicBlockNodeTSet &OtherNodes = Other.getNodes();
+  if (comparableWith(Other))
+    return not Other.Members.test(Members);
+
+  const BasicBlockNodeTSet &OtherNodes = Other.getNodes();
   return std::includes(Nodes.begin(),
                        Nodes.end(),
                        OtherNodes.begin(),
@@ -138,6 +150,10 @@ bool MetaRegion<NodeT>::isSuperSet(MetaRegion<NodeT> &Other) const {
 
 template<class NodeT>
 bool MetaRegion<NodeT>::nodesEquality(MetaRegion<NodeT> &Other) const {
-  BasicBlockNodeTSet &OtherNodes = Other.getNodes();
+  if (comparableWith(Other))
+    return Nodes.size() == Other.Nodes.size()
+           and not Members.test(Other.Members);
+
+  const BasicBlockNodeTSet &OtherNodes = Other.getNodes();
   return Nodes == OtherNodes;
 }
@@ -4,13 +4,16 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
 #include <cstdlib>
 #include <set>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/GenericDomTreeConstruction.h"
 
@@ -47,18 +50,15 @@ template<class NodeT = llvm::BasicBlock *>
 class RegionCFG {
 
   using BBNodeT = BasicBlockNode<NodeT>;
-  using BBNodeTUniquePtr = typename std::unique_ptr<BBNodeT>;
-  using getPointerT = BBNodeT *(*) (BBNodeTUniquePtr &);
-  using getConstPointerT = const BBNodeT *(*) (const BBNodeTUniquePtr &);
+  using getPointerT = BBNodeT *(*) (BBNodeT *const &);
+  using getConstPointerT = const BBNodeT *(*) (BBNodeT *const &);
 
-  static BBNodeT *getPointer(BBNodeTUniquePtr &Original) {
-    return Original.get();
-  }
+  static BBNodeT *getPointer(BBNodeT *const &Original) { return Original; }
 
   static_assert(std::is_same_v<decltype(&getPointer), getPointerT>);
 
-  static const BBNodeT *getConstPointer(const BBNodeTUniquePtr &Original) {
-    return Original.get();
+  static const BBNodeT *getConstPointer(BBNodeT *const &Original) {
+    return Original;
   }
 
   static_assert(std::is_same_v<decltype(&getConstPointer), getConstPointerT>);
@@ -68,13 +68,14 @@ public:
   using BasicBlockNodeType = typename BasicBlockNodeT::Type;
   using BasicBlockNodeTSet = std::set<BasicBlockNodeT *>;
   using BasicBlockNodeTVect = std::vector<BasicBlockNodeT *>;
-  using BasicBlockNodeTUPVect = std::vector<std::unique_ptr<BasicBlockNodeT>>;
   using BBNodeMap = typename BBNodeT::BBNodeMap;
+  /// For lookup-only maps, which never need to be iterated in order
+  using BBNodeDenseMap = llvm::DenseMap<BasicBlockNodeT *, BasicBlockNodeT *>;
   using RegionCFGT = typename BBNodeT::RegionCFGT;
 
   using EdgeDescriptor = typename BBNodeT::EdgeDescriptor;
 
-  using links_container = std::vector<BBNodeTUniquePtr>;
+  using links_container = std::vector<BBNodeT *>;
   using internal_iterator = typename links_container::iterator;
   using internal_const_iterator = typename links_container::const_iterator;
   using links_iterator = llvm::mapped_iterator<internal_iterator, getPointerT>;
@@ -97,42 +98,24 @@ public:
     WeightNotComputed = std::numeric_limits<size_t>::max();
 
 private:
-  /// Storage for basic block nodes, associated to their original counterpart
+  /// Arena where all the basic block nodes of this RegionCFG are allocated.
+  //  Nodes are never freed one by one, not even when they are removed from the
+  //  RegionCFG: the CFG restructuring algorithm uses maps and sets (e.g.
+  //  Backedges) that are indexed using a BasicBlockNodeT *, and reusing the
+  //  address of a removed node would cause false-positive hits in them.
+  //  All the nodes are destroyed at once, together with the RegionCFG.
+  llvm::SpecificBumpPtrAllocator<BBNodeT> NodeAllocator;
+
+  /// The basic block nodes currently part of this RegionCFG
   links_container BlockNodes;
 
-  /// Quarantine for dead nodes.
-  //  When nodes are removed from RegionCFG, they are not really freed, but they
-  //  are held here until the RegionCFG itself goes out of scope.
-  //  This is unfortunately necessary now, since the CFG restructuring algorithm
-  //  uses maps and sets (e.g. Backedges.) that are indexed using a
-  //  BasicBlockNodeT *.
-  //  If we don't hold the removed nodes in quarantine, the system allocator can
-  //  reuse the blocks, allocating new nodes at the same address, and causing
-  //  false-positive hits in some of the mentioned maps. This was the most
-  //  straightforward solution for now.
-  //
-  //  Other solutions we have considered:
-  //    - use a special monotonic allocator for BasicBlockNodes
-  //      - this should work, but in principle it gives the same results as the
-  //        current solution, with more boilerplate. Also, at the moment
-  //        std::unique_ptr is not allocator aware, so we would need to change
-  //        BlockNodes to not use them, and this would require even more
-  //        boilerplate.
-  //    - change the API for RegionCFG::removeNode, to take as arguments the
-  //      reference to the data structure and maps that must be updated, so that
-  //      when we remove the node from RegionCFG we also clear it from the maps.
-  //      However, this is very invasive, it requires changing the public facing
-  //      API, it requirese coupling the RegionCFG API with internal details,
-  //      and in the future it would need to be updated for every new map that
-  //      must be updated on removal of a node.
-  links_container DeadNodesQuarantine;
-
   /// Pointer to the entry basic block of this function
   BasicBlockNodeT *EntryNode;
   unsigned IDCounter = 0;
   std::string FunctionName;
   std::string RegionName;
   bool ToInflate = true;
+  bool Combed = false;
   size_t UntangleWeight = WeightNotComputed;
   llvm::DominatorTreeBase<BasicBlockNodeT, false> DT;
   FPostDomTree IFPDT;
@@ -193,10 +176,22 @@ private:
 
 public:
   RegionCFG() = default;
-  RegionCFG(const RegionCFG &) = default;
+  RegionCFG(const RegionCFG &) = delete;
   RegionCFG(RegionCFG &&) = default;
-  RegionCFG &operator=(const RegionCFG &) = default;
-  RegionCFG &operator=(RegionCFG &&) = default;
+  RegionCFG &operator=(const RegionCFG &) = delete;
+  RegionCFG &operator=(RegionCFG &&) = delete;
+
+private:
+  /// Allocate a new node in the arena and add it to this RegionCFG
+  template<typename... ArgsT>
+  BBNodeT *createNode(ArgsT &&...Args) {
+    auto *New = new (NodeAllocator.Allocate())
+      BBNodeT(std::forward<ArgsT>(Args)...);
+    BlockNodes.push_back(New);
+    return New;
+  }
+
+public:
 
   template<class GraphT>
   void initialize(GraphT Graph) {
@@ -238,6 +233,12 @@ public:
 
   std::string getRegionName() const;
 
+  /// Returns true if weave and inflate have already been applied to this
+  /// RegionCFG, i.e. it only needs to be tiled to produce its AST.
+  bool isCombed() const { return Combed; }
+
+  void setCombed() { Combed = true; }
+
   links_iterator begin() {
     return llvm::map_iterator(BlockNodes.begin(), getPointer);
   }
@@ -261,8 +262,7 @@ public:
   BBNodeT *addNode(NodeT Node) { return addNode(Node, Node->getName()); }
 
   BBNodeT *createCollapsedNode(RegionCFG *Collapsed) {
-    BlockNodes.emplace_back(std::make_unique<BasicBlockNodeT>(this, Collapsed));
-    return BlockNodes.back().get();
+    return createNode(this, Collapsed);
   }
 
   BBNodeT *addArtificialNode(llvm::StringRef Name = "dummy",
@@ -270,8 +270,7 @@ public:
     revng_assert(T == BasicBlockNodeType::Empty
                  or T == BasicBlockNodeType::Break
                  or T == BasicBlockNodeType::Continue);
-    BlockNodes.emplace_back(std::make_unique<BasicBlockNodeT>(this, Name, T));
-    return BlockNodes.back().get();
+    return createNode(this, Name, T);
   }
 
   BBNodeT *addContinue() {
@@ -283,9 +282,7 @@ public:
   }
 
   BBNodeT *addDispatcher(llvm::StringRef Name, BasicBlockNodeT::Type T) {
-    using BBNodeT = BasicBlockNodeT;
-    auto D = std::make_unique<BBNodeT>(this, Name, T);
-    return BlockNodes.emplace_back(std::move(D)).get();
+    return createNode(this, Name, T);
   }
 
   BBNodeT *addEntryDispatcher() {
@@ -301,13 +298,10 @@ public:
   BBNodeT *addSetStateNode(unsigned StateVariableValue,
                            llvm::StringRef TargetName,
                            BasicBlockNodeT::Type T) {
-    using BBNodeT = BasicBlockNodeT;
     std::string IdStr = std::to_string(StateVariableValue);
     std::string Name = "set idx " + IdStr + " (desired target) "
                        + TargetName.str();
-    auto Tmp = std::make_unique<BBNodeT>(this, Name, T, StateVariableValue);
-    BlockNodes.emplace_back(std::move(Tmp));
-    return BlockNodes.back().get();
+    return createNode(this, Name, T, StateVariableValue);
   }
 
   BBNodeT *addEntrySetStateNode(unsigned StateVariableValue,
@@ -324,16 +318,14 @@ public:
 
   BBNodeT *addTile() {
     using Type = typename BasicBlockNodeT::Type;
-    auto Tmp = std::make_unique<BBNodeT>(this, "tile", Type::Tile);
-    BlockNodes.emplace_back(std::move(Tmp));
-    return BlockNodes.back().get();
+    return createNode(this, "tile", Type::Tile);
   }
 
   BBNodeT *cloneNode(BasicBlockNodeT &OriginalNode);
 
   void removeNode(BasicBlockNodeT *Node);
 
-  void insertBulkNodes(BasicBlockNodeTSet &Nodes,
+  void insertBulkNodes(const BasicBlockNodeTSet &Nodes,
                        BasicBlockNodeT *Head,
                        BBNodeMap &SubstitutionMap,
                        std::set<EdgeDescriptor> &Out,
@@ -343,7 +335,7 @@ public:
 
   BBNodeT &front() const { return *EntryNode; }
 
-  std::vector<BBNodeTUniquePtr> &getNodes() { return BlockNodes; }
+  links_container &getNodes() { return BlockNodes; }
 
 public:
   /// Dump a GraphViz representing this function on any stream
@@ -375,7 +367,11 @@ public:
   void untangle();
 
   /// Apply comb to the region.
-  void inflate();
+  ///
+  /// If \p MaxDuplications is not 0 and the comb would need to duplicate more
+  /// than \p MaxDuplications nodes, the comb is abandoned half-way, leaving the
+  /// region in an inconsistent state, and false is returned.
+  bool inflate(size_t MaxDuplications = 0);
 
   void removeNotReachables();
 
@@ -444,7 +440,13 @@ struct GraphTraits<Inverse<RegionCFG<NodeT> *>>
 
 } // namespace llvm
 
-extern unsigned DuplicationCounter;
+// The following counters are atomic since the RegionCFGs of a single function
+// can be combed concurrently (see `restructure-threads`).
+
+extern std::atomic<unsigned> DuplicationCounter;
+
+extern std::atomic<unsigned> UntangleTentativeCounter;
+extern std::atomic<unsigned> UntanglePerformedCounter;
 
-extern unsigned UntangleTentativeCounter;
-extern unsigned UntanglePerformedCounter;
+/// Number of nodes in all the RegionCFGs of a function, after inflation
+extern std::atomic<unsigned> InflatedNodesCounter;
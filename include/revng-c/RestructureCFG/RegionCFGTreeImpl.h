@@ -91,9 +91,7 @@ inline std::string RegionCFG<NodeT>::getRegionName() const {
 template<class NodeT>
 inline BasicBlockNode<NodeT> *
 RegionCFG<NodeT>::addNode(NodeT Node, llvm::StringRef Name) {
-  using BBNodeT = BasicBlockNodeT;
-  BlockNodes.emplace_back(std::make_unique<BBNodeT>(this, Node, Name));
-  BasicBlockNodeT *Result = BlockNodes.back().get();
+  BasicBlockNodeT *Result = createNode(this, Node, Name);
   revng_log(CombLogger,
             "Building " << Name << " at address: " << Result << "\n");
   return Result;
@@ -102,9 +100,7 @@ RegionCFG<NodeT>::addNode(NodeT Node, llvm::StringRef Name) {
 template<class NodeT>
 inline BasicBlockNode<NodeT> *
 RegionCFG<NodeT>::cloneNode(BasicBlockNodeT &OriginalNode) {
-  using BBNodeT = BasicBlockNodeT;
-  BlockNodes.emplace_back(std::make_unique<BBNodeT>(OriginalNode, this));
-  BasicBlockNodeT *New = BlockNodes.back().get();
+  BasicBlockNodeT *New = createNode(OriginalNode, this);
   New->setName(OriginalNode.getName().str() + " cloned");
   New->setWeaved(OriginalNode.isWeaved());
   return New;
@@ -121,13 +117,10 @@ inline void RegionCFG<NodeT>::removeNode(BasicBlockNodeT *Node) {
   for (BasicBlockNodeT *Successor : Node->successors())
     Successor->removePredecessor(Node);
 
-  for (auto It = BlockNodes.begin(); It != BlockNodes.end(); It++) {
-    if ((*It).get() == Node) {
-      DeadNodesQuarantine.push_back(std::move(*It));
-      BlockNodes.erase(It);
-      break;
-    }
-  }
+  // The node stays allocated in NodeAllocator until the RegionCFG is destroyed
+  auto It = llvm::find(BlockNodes, Node);
+  if (It != BlockNodes.end())
+    BlockNodes.erase(It);
 }
 
 template<class NodeT>
@@ -142,7 +135,7 @@ inline void copyNeighbors(BBNodeT<NodeT> *Dst, BBNodeT<NodeT> *Src) {
 }
 
 template<class NodeT>
-inline void RegionCFG<NodeT>::insertBulkNodes(BasicBlockNodeTSet &Nodes,
+inline void RegionCFG<NodeT>::insertBulkNodes(const BasicBlockNodeTSet &Nodes,
                                               BasicBlockNodeT *Head,
                                               BBNodeMap &SubMap,
                                               std::set<EdgeDescriptor> &Out,
@@ -151,8 +144,7 @@ inline void RegionCFG<NodeT>::insertBulkNodes(BasicBlockNodeTSet &Nodes,
   revng_assert(BlockNodes.empty());
 
   for (BasicBlockNodeT *Node : Nodes) {
-    BlockNodes.emplace_back(std::make_unique<BasicBlockNodeT>(*Node, this));
-    BasicBlockNodeT *New = BlockNodes.back().get();
+    BasicBlockNodeT *New = createNode(*Node, this);
     SubMap[Node] = New;
 
     // The copy constructor used above does not bring along the successors and
@@ -171,7 +163,7 @@ inline void RegionCFG<NodeT>::insertBulkNodes(BasicBlockNodeTSet &Nodes,
   // successors (e.g., then and else, if then goes to a break).
   // In addition, since multiple break can go to the same successors, we keep a
   // mapping of successor -> corresponding break, so that we can reuse it.
-  BBNodeMap BreakMap;
+  BBNodeDenseMap BreakMap;
   for (EdgeDescriptor Edge : Out) {
 
     // Check if we already have a break for each outgoing edge, or create it.
@@ -203,7 +195,7 @@ inline void RegionCFG<NodeT>::insertBulkNodes(BasicBlockNodeTSet &Nodes,
   EntryNode = SubMap[Head];
   revng_assert(EntryNode != nullptr);
   // Fix the hack above
-  for (BBNodeTUniquePtr &Node : BlockNodes)
+  for (BasicBlockNodeT *Node : BlockNodes)
     Node->updatePointers(SubMap);
 
   // Connect all the `ContinueBackedges` to `continue` nodes
@@ -246,8 +238,8 @@ template<typename StreamT>
 inline void RegionCFG<NodeT>::dumpDot(StreamT &S) const {
   S << "digraph CFGFunction {\n";
 
-  for (const std::unique_ptr<BasicBlockNode<NodeT>> &BB : BlockNodes) {
-    streamNode(S, BB.get());
+  for (const BasicBlockNode<NodeT> *BB : BlockNodes) {
+    streamNode(S, BB);
     unsigned Counter = 0;
     for (const auto &[Successor, EdgeInfo] : BB->labeled_successors()) {
       unsigned PredID = BB->getID();
@@ -374,7 +366,7 @@ RegionCFG<NodeT>::cloneUntilExit(BasicBlockNode<NodeT> *Node,
                                  BasicBlockNode<NodeT> *Sink) {
 
   // Clone the postdominator node.
-  BBNodeMap CloneMap;
+  BBNodeDenseMap CloneMap;
   BasicBlockNode<NodeT> *Clone = cloneNode(*Node);
 
   // Insert the postdominator clone in the map.
@@ -384,7 +376,7 @@ RegionCFG<NodeT>::cloneUntilExit(BasicBlockNode<NodeT> *Node,
   WorkList.push_back(Node);
 
   // Set of nodes which have been already processed.
-  BasicBlockNodeTSet AlreadyProcessed;
+  SmallPtrSet<NodeT> AlreadyProcessed;
 
   while (!WorkList.empty()) {
     BasicBlockNode<NodeT> *CurrentNode = WorkList.back();
@@ -455,7 +447,7 @@ inline void RegionCFG<NodeT>::untangle() {
   // case of a code node the weight will be equal to the number of instruction
   // in the original basic block; in case of a collapsed node the weight will be
   // the sum of the weights of all the nodes contained in the collapsed graph.
-  std::map<BasicBlockNode<NodeT> *, size_t> WeightMap;
+  llvm::DenseMap<BasicBlockNode<NodeT> *, size_t> WeightMap;
   for (BasicBlockNode<NodeT> *Node : Graph.nodes()) {
     WeightMap[Node] = Node->getWeight();
   }
@@ -464,7 +456,7 @@ inline void RegionCFG<NodeT>::untangle() {
   // Reverse Post-Order.
   BasicBlockNodeTVect ConditionalNodes;
   {
-    BasicBlockNodeTSet ConditionalNodesSet;
+    SmallPtrSet<NodeT> ConditionalNodesSet;
     for (auto *Node : Graph)
       if (Node->successor_size() == 2)
         ConditionalNodesSet.insert(Node);
@@ -478,14 +470,22 @@ inline void RegionCFG<NodeT>::untangle() {
     }
   }
 
+  // The dominator and postdominator trees only need to be rebuilt when the
+  // previous iteration actually untangled something, since looking at a
+  // conditional node does not change the graph otherwise.
+  bool TreesAreStale = true;
+
   while (not ConditionalNodes.empty()) {
 
     BasicBlockNode<NodeT> *Conditional = ConditionalNodes.back();
     ConditionalNodes.pop_back();
 
     // Update the information of the dominator and postdominator trees.
-    DT.recalculate(Graph);
-    IFPDT.recalculate(Graph);
+    if (TreesAreStale) {
+      DT.recalculate(Graph);
+      IFPDT.recalculate(Graph);
+      TreesAreStale = false;
+    }
 
     // Update the postdominator
     BasicBlockNodeT *PostDominator = IFPDT[Conditional]->getIDom()->getBlock();
@@ -659,6 +659,8 @@ inline void RegionCFG<NodeT>::untangle() {
           }
         }
       }
+
+      TreesAreStale = true;
     }
   }
 
@@ -703,8 +705,52 @@ struct ReachableExitsAnalysis
   }
 };
 
+/// A SmallPtrSet that can be emptied without giving back its buckets, which
+/// clear() does whenever they're many more than the elements
 template<class NodeT>
-inline void RegionCFG<NodeT>::inflate() {
+class ScratchPtrSet : public SmallPtrSet<NodeT> {
+public:
+  void clearKeepingStorage() {
+    this->incrementEpoch();
+    if (this->CurArray != this->SmallArray)
+      std::fill_n(this->CurArray, this->CurArraySize, this->getEmptyMarker());
+    this->NumNonEmpty = 0;
+    this->NumTombstones = 0;
+  }
+};
+
+/// A DenseMap that can be emptied without giving back its buckets, which
+/// clear() does whenever they're many more than the entries
+template<class KeyT, class ValueT>
+class ScratchDenseMap : public llvm::DenseMap<KeyT, ValueT> {
+public:
+  void clearKeepingStorage() {
+    this->incrementEpoch();
+    this->destroyAll();
+    this->initEmpty();
+  }
+};
+
+/// Containers used by RegionCFG::inflate. Each thread keeps a single instance
+/// alive across all the regions it combs, and inflate empties them instead of
+/// building new ones, so that their storage gets reused.
+template<class NodeT>
+struct InflateScratch {
+  using BBNodeT = BasicBlockNode<NodeT>;
+
+  std::vector<BBNodeT *> Exits;
+  std::vector<BBNodeT *> Switches;
+  std::vector<BBNodeT *> ConditionalNodes;
+  std::vector<BBNodeT *> NotVisitedPredecessors;
+  ScratchPtrSet<NodeT> ConditionalNodesSet;
+  ScratchPtrSet<NodeT> WorkList;
+  ScratchPtrSet<NodeT> Visited;
+  ScratchDenseMap<BBNodeT *, BBNodeT *> ConditionalToCombEnd;
+  ScratchDenseMap<BBNodeT *, BBNodeT *> CloneToOriginalMap;
+};
+
+template<class NodeT>
+inline bool RegionCFG<NodeT>::inflate(size_t MaxDuplications) {
 
   // Call the untangle preprocessing.
   untangle();
@@ -716,6 +762,8 @@ inline void RegionCFG<NodeT>::inflate() {
 
   BasicBlockNode<NodeT> *Entry = &Graph.getEntryNode();
 
+  thread_local InflateScratch<NodeT> Scratch;
+
   if (CombLogger.isEnabled()) {
     revng_log(CombLogger, "Entry node is: " << Entry->getNameStr());
     Graph.dumpCFGOnFile(FunctionName,
@@ -723,9 +771,13 @@ inline void RegionCFG<NodeT>::inflate() {
                         "region-" + RegionName + "-before-inflate");
   }
 
+  // Number of nodes duplicated so far in this region.
+  size_t RegionDuplications = 0;
+
   // Collect the sets of reachable exits from each node that is a successor of a
   // node that induces duplication.
-  std::vector<BasicBlockNode<NodeT> *> Exits;
+  std::vector<BasicBlockNode<NodeT> *> &Exits = Scratch.Exits;
+  Exits.clear();
   for (auto *Exit : Graph)
     if (llvm::all_of(Exit->labeled_successors(),
                      [](const auto &Pair) { return Pair.second.Inlined; }))
@@ -749,14 +801,17 @@ inline void RegionCFG<NodeT>::inflate() {
   // that will be used to detect the point where combing needs to stop
   // duplicating node. This is the immediate post dominator for most nodes, but
   // we have a special case for the case nodes of switches.
-  BBNodeMap ConditionalToCombEnd;
+  auto &ConditionalToCombEnd = Scratch.ConditionalToCombEnd;
+  ConditionalToCombEnd.clearKeepingStorage();
 
   // Collect all the conditional nodes in the graph.
   // This is the working list of conditional nodes on which we will operate and
   // will contain only the filtered conditionals.
-  BasicBlockNodeTSet ConditionalNodesSet;
+  auto &ConditionalNodesSet = Scratch.ConditionalNodesSet;
+  ConditionalNodesSet.clearKeepingStorage();
 
-  std::vector<BasicBlockNode<NodeT> *> Switches;
+  std::vector<BasicBlockNode<NodeT> *> &Switches = Scratch.Switches;
+  Switches.clear();
 
   for (BBNodeT *Node : Graph) {
     switch (Node->successor_size()) {
@@ -767,10 +822,12 @@ inline void RegionCFG<NodeT>::inflate() {
       break;
 
     case 2: {
-      BasicBlockNodeTSet ThenExits = ReachableExits.at(Node->getSuccessorI(0))
-                                       .OutValue;
-      BasicBlockNodeTSet ElseExits = ReachableExits.at(Node->getSuccessorI(1))
-                                       .OutValue;
+      const BasicBlockNodeTSet &ThenExits = ReachableExits
+                                              .at(Node->getSuccessorI(0))
+                                              .OutValue;
+      const BasicBlockNodeTSet &ElseExits = ReachableExits
+                                              .at(Node->getSuccessorI(1))
+                                              .OutValue;
 
       // Add the conditional node to the set of nodes processed by the inflate.
       ConditionalNodesSet.insert(Node);
@@ -870,14 +927,16 @@ inline void RegionCFG<NodeT>::inflate() {
   std::map<BasicBlockNode<NodeT> *, SmallPtrSet<NodeT>> NodesEquivalenceClass;
 
   // Map to keep track of the cloning relationship.
-  BBNodeMap CloneToOriginalMap;
+  auto &CloneToOriginalMap = Scratch.CloneToOriginalMap;
+  CloneToOriginalMap.clearKeepingStorage();
 
   // Initialize a list containing the reverse post order of the nodes of the
   // graph.
   std::list<BasicBlockNode<NodeT> *> RevPostOrderList;
 
   // Vector of conditional nodes, to be filled in reverse post order.
-  BasicBlockNodeTVect ConditionalNodes;
+  BasicBlockNodeTVect &ConditionalNodes = Scratch.ConditionalNodes;
+  ConditionalNodes.clear();
 
   llvm::ReversePostOrderTraversal<BasicBlockNode<NodeT> *> RPOT(Entry);
   for (BasicBlockNode<NodeT> *RPOTBB : RPOT) {
@@ -914,14 +973,17 @@ inline void RegionCFG<NodeT>::inflate() {
     }
 
     // List to keep track of the nodes that we still need to analyze.
-    SmallPtrSet<NodeT> WorkList;
+    auto &WorkList = Scratch.WorkList;
+    WorkList.clearKeepingStorage();
     // Enqueue in the worklist the successors of the contional node.
     for (auto &[Successor, EdgeLabel] : Conditional->labeled_successors())
       if (not EdgeLabel.Inlined)
         WorkList.insert(Successor);
 
     // Keep a set of the visited nodes for the current conditional node.
-    SmallPtrSet<NodeT> Visited = { Conditional };
+    auto &Visited = Scratch.Visited;
+    Visited.clearKeepingStorage();
+    Visited.insert(Conditional);
 
     // Get an iterator from the reverse post order list in the position of the
     // conditional node.
@@ -1035,7 +1097,15 @@ inline void RegionCFG<NodeT>::inflate() {
 
       } else {
 
-        // Duplicate node.
+        // Duplicate node, unless we have already exceeded the budget.
+        if (MaxDuplications != 0 and RegionDuplications == MaxDuplications) {
+          revng_log(CombLogger,
+                    "Abandoning comb of region " << RegionName << " after "
+                                                 << RegionDuplications
+                                                 << " duplications");
+          return false;
+        }
+        ++RegionDuplications;
         DuplicationCounter++;
         revng_log(CombLogger, "Duplicating node " << Candidate->getNameStr());
 
@@ -1052,7 +1122,9 @@ inline void RegionCFG<NodeT>::inflate() {
 
         // Move Candidate's predecessors that have not been visited yet, so that
         // they become predecessors of Duplicated
-        BasicBlockNodeTVect NotVisitedPredecessors;
+        BasicBlockNodeTVect &NotVisitedPredecessors = Scratch
+                                                        .NotVisitedPredecessors;
+        NotVisitedPredecessors.clear();
         for (BasicBlockNode<NodeT> *Predecessor : Candidate->predecessors())
           if (not Visited.contains(Predecessor))
             NotVisitedPredecessors.push_back(Predecessor);
@@ -1178,6 +1250,7 @@ inline void RegionCFG<NodeT>::inflate() {
   }
 
   revng_log(CombLogger, "Region Final Size: " << Graph.size());
+  return true;
 }
 
 template<class NodeT>
@@ -1404,8 +1477,6 @@ inline void RegionCFG<NodeT>::weave() {
     }
   }
 
-  DT.recalculate(Graph);
-
   if (CombLogger.isEnabled()) {
     Graph.dumpCFGOnFile(FunctionName,
                         "weave",
@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstdint>
+
 #include "llvm/IR/Function.h"
 #include "llvm/Pass.h"
 
@@ -22,4 +24,38 @@ public:
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
 };
 
-bool restructureCFG(llvm::Function &F, ASTTree &AST);
+/// Statistics about a single invocation of restructureCFG
+struct RestructureCFGStatistics {
+  /// Number of nodes in all the RegionCFGs, after inflation
+  unsigned InflatedNodes = 0;
+
+  /// Number of nodes duplicated by the combing
+  unsigned Duplications = 0;
+
+  /// Number of conditional nodes considered for untangling
+  unsigned UntangleTentatives = 0;
+
+  /// Number of conditional nodes actually untangled
+  unsigned UntanglesPerformed = 0;
+
+  /// Weight of the root RegionCFG, after the collapse of the SCSs and before
+  /// the comb
+  unsigned InitialWeight = 0;
+
+  /// True if the restructuring has been abandoned since the comb of a region
+  /// exceeded -restructure-max-duplication-factor
+  bool DuplicationCeilingExceeded = false;
+};
+
+/// Build in \p AST the GHAST of \p F.
+///
+/// \return false if \p F has not been restructured, either because it's not
+///         an isolated function or because its restructuring has been
+///         abandoned. In that case \p AST must not be used.
+bool restructureCFG(llvm::Function &F,
+                    ASTTree &AST,
+                    RestructureCFGStatistics *Statistics = nullptr);
+
+/// Hash of the command line options that can change what restructureCFG
+/// produces for a given function, for the caches of its results.
+uint64_t hashRestructureOptions();
@@ -0,0 +1,62 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstddef>
+#include <memory>
+
+#include "revng-c/Support/Trace.h"
+
+namespace trace {
+
+/// The number of allocations, and of bytes allocated, by the containers of a
+/// subsystem using a CountingAllocator. To be declared as a global variable.
+struct AllocationCounters {
+  Counter Allocations;
+  Counter Bytes;
+
+  constexpr AllocationCounters(const char *Category,
+                               const char *AllocationsName,
+                               const char *BytesName) :
+    Allocations(Category, AllocationsName), Bytes(Category, BytesName) {}
+};
+
+/// A std::allocator that accounts what it allocates in \p Counters, when
+/// tracing is enabled. Deallocations are not tracked: the counters measure
+/// the allocator traffic, not the memory in use.
+template<typename T, AllocationCounters *Counters>
+class CountingAllocator {
+public:
+  using value_type = T;
+
+  template<typename U>
+  struct rebind {
+    using other = CountingAllocator<U, Counters>;
+  };
+
+public:
+  CountingAllocator() = default;
+
+  template<typename U>
+  CountingAllocator(const CountingAllocator<U, Counters> &) {}
+
+public:
+  T *allocate(size_t N) {
+    Counters->Allocations += 1;
+    Counters->Bytes += N * sizeof(T);
+    return std::allocator<T>().allocate(N);
+  }
+
+  void deallocate(T *Pointer, size_t N) {
+    std::allocator<T>().deallocate(Pointer, N);
+  }
+
+  template<typename U>
+  bool operator==(const CountingAllocator<U, Counters> &) const {
+    return true;
+  }
+};
+
+} // namespace trace
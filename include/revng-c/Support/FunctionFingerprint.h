@@ -0,0 +1,35 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <optional>
+
+#include "llvm/ADT/StringRef.h"
+
+namespace llvm {
+class Function;
+} // namespace llvm
+
+/// Prefix of the names of the metadata recording the fingerprints of a function
+inline constexpr llvm::StringRef FingerprintMDPrefix = "revng.fingerprint.";
+
+/// Compute a hash of the IR of \p F that is stable across modules, i.e., it
+/// does not depend on the numbering of unnamed values, metadata or globals,
+/// nor on the other functions of the module, except for the attributes of its
+/// callees.
+///
+/// Passes reaching a fixed point record the hash of the functions they
+/// processed, and skip them as long as they are given back unchanged. The
+/// attachments of \p F, hence the recorded fingerprints, are not hashed.
+extern uint64_t hashFunctionIR(const llvm::Function &F);
+
+/// The fingerprint recorded as the metadata FingerprintMDPrefix + \p Name
+std::optional<uint64_t> getRecordedFingerprint(const llvm::Function &F,
+                                               llvm::StringRef Name);
+
+void recordFingerprint(llvm::Function &F,
+                       llvm::StringRef Name,
+                       uint64_t Fingerprint);
@@ -5,6 +5,10 @@
 //
 
 #include <compare>
+#include <memory>
+#include <set>
+#include <utility>
+
 namespace llvm {
 class Function;
 class LLVMContext;
@@ -13,6 +17,7 @@ class Type;
 class ExtractValueInst;
 } // end namespace llvm
 
+#include "revng/Support/Assert.h"
 #include "revng/Support/FunctionTags.h"
 #include "revng/Support/OpaqueFunctionsPool.h"
 
@@ -177,3 +182,79 @@ llvm::FunctionType *getCopyType(llvm::Type *ReturnedType);
 /// Initializes a pool of Copy functions, initializing it its internal
 /// Module.
 void initCopyPool(OpaqueFunctionsPool<llvm::Type *> &Pool);
+
+/// An OpaqueFunctionsPool shared by all the functions a FunctionPass runs on,
+/// so that the module is not scanned to initialize a new pool for each of
+/// them.
+///
+/// Between two functions, the other passes in the same pass manager, and the
+/// other instances of the same pass, might create functions of the same kind.
+/// For this reason, the pool is initialized again from the module when a key
+/// that has not been requested yet is requested, but only if functions have
+/// been added to the module by someone else since the last initialization. All
+/// the keys are served by a single scan of the module otherwise.
+template<typename KeyT>
+class SharedOpaqueFunctionsPool {
+public:
+  using PoolType = OpaqueFunctionsPool<KeyT>;
+  using InitializerType = void (*)(PoolType &, llvm::Module *);
+  using PoolInitializerType = void (*)(PoolType &);
+
+private:
+  InitializerType Initialize = nullptr;
+  PoolInitializerType InitializePool = nullptr;
+  llvm::Module *M = nullptr;
+  std::unique_ptr<PoolType> Pool;
+
+  /// The keys requested since the pool was initialized for M
+  std::set<KeyT> Requested;
+
+  /// The number of functions in M, the last time we looked at it
+  size_t KnownFunctions = 0;
+
+public:
+  explicit SharedOpaqueFunctionsPool(InitializerType Initialize) :
+    Initialize(Initialize) {}
+
+  explicit SharedOpaqueFunctionsPool(PoolInitializerType InitializePool) :
+    InitializePool(InitializePool) {}
+
+public:
+  /// Forward to OpaqueFunctionsPool::get, on a pool of the functions of \p M
+  template<typename... ArgsT>
+  llvm::Function *get(llvm::Module *M, const KeyT &Key, ArgsT &&...Args) {
+    if (M != this->M) {
+      Requested.clear();
+      this->M = M;
+      Pool.reset();
+    }
+
+    // Keys requested already are in the pool, whatever happened to the module
+    // in the meantime. Others might have been created by someone else.
+    bool IsNewKey = not Requested.contains(Key);
+    if (Pool == nullptr or (IsNewKey and M->size() != KnownFunctions)) {
+      Pool = std::make_unique<PoolType>(M, /* PurgeOnDestruction */ false);
+      if (Initialize != nullptr)
+        Initialize(*Pool, M);
+      else
+        InitializePool(*Pool);
+    }
+
+    Requested.insert(Key);
+    llvm::Function *Result = Pool->get(Key, std::forward<ArgsT>(Args)...);
+    revng_assert(Result->getParent() == M);
+
+    // The pool knows about the function it might have just created
+    KnownFunctions = M->size();
+    return Result;
+  }
+
+  /// To be called in doFinalization, the module might change before the next
+  /// run of the pass
+  void clear() {
+    Requested.clear();
+    Pool.reset();
+    M = nullptr;
+    KnownFunctions = 0;
+  }
+};
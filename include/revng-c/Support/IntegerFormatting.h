@@ -0,0 +1,78 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+
+#include "llvm/ADT/StringRef.h"
+
+/// The textual representation of an integer that fits in 64 bits, built in
+/// place without any allocation.
+///
+/// Digits are written from the end of the buffer backwards, so no reversal or
+/// length computation is needed.
+class FormattedInteger {
+private:
+  /// "-" and the 19 digits of INT64_MIN, or "0x" and 16 hex digits
+  static constexpr uint8_t Capacity = 24;
+
+private:
+  char Buffer[Capacity];
+  uint8_t Begin = Capacity;
+
+public:
+  static FormattedInteger decimal(uint64_t Value) {
+    FormattedInteger Result;
+    Result.pushDecimal(Value);
+    return Result;
+  }
+
+  static FormattedInteger signedDecimal(int64_t Value) {
+    FormattedInteger Result;
+    if (Value >= 0) {
+      Result.pushDecimal(Value);
+    } else {
+      // Negate in unsigned arithmetic, INT64_MIN has no positive counterpart
+      Result.pushDecimal(uint64_t(0) - static_cast<uint64_t>(Value));
+      Result.push('-');
+    }
+    return Result;
+  }
+
+  /// Format \p Value in base 16, optionally with the "0x" C prefix. Digits
+  /// above 9 are lowercase unless \p Uppercase is set.
+  static FormattedInteger
+  hex(uint64_t Value, bool WithPrefix = false, bool Uppercase = false) {
+    const char *Digits = Uppercase ? "0123456789ABCDEF" : "0123456789abcdef";
+    FormattedInteger Result;
+    do {
+      Result.push(Digits[Value & 0xF]);
+      Value >>= 4;
+    } while (Value != 0);
+
+    if (WithPrefix) {
+      Result.push('x');
+      Result.push('0');
+    }
+    return Result;
+  }
+
+public:
+  llvm::StringRef str() const {
+    return llvm::StringRef(Buffer + Begin, Capacity - Begin);
+  }
+
+  operator llvm::StringRef() const { return str(); }
+
+private:
+  void push(char C) { Buffer[--Begin] = C; }
+
+  void pushDecimal(uint64_t Value) {
+    do {
+      push(static_cast<char>('0' + Value % 10));
+      Value /= 10;
+    } while (Value != 0);
+  }
+};
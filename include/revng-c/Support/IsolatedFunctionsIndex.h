@@ -0,0 +1,43 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <map>
+#include <memory>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+#include "revng/Support/MetaAddress.h"
+
+/// Lazy loading of bitcode modules, one isolated function at a time.
+///
+/// With lazy loading, the bodies of the functions are parsed on request, along
+/// with their metadata, including the entry address and the FunctionTags. To
+/// find the isolated functions without parsing all of them, the module carries
+/// an index in the revng.isolated-functions named metadata, which is written
+/// by the index-isolated-functions pass.
+
+/// Record the entry address of each isolated function of \p M with a body in
+/// the revng.isolated-functions named metadata
+void writeIsolatedFunctionsIndex(llvm::Module &M);
+
+/// Read the index written by writeIsolatedFunctionsIndex, without
+/// materializing any function.
+///
+/// \return the isolated functions of \p M by entry address, or an empty map if
+///         \p M has no index
+std::map<MetaAddress, llvm::Function *>
+readIsolatedFunctionsIndex(llvm::Module &M);
+
+/// Materialize \p F, and the functions it directly calls, for their metadata
+void materializeWithCallees(llvm::Function &F);
+
+/// Parse the bitcode or textual IR at \p Path, without materializing any
+/// function body
+std::unique_ptr<llvm::Module> loadModuleLazily(llvm::StringRef Path,
+                                               llvm::LLVMContext &Context);
@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/Type.h"
 
@@ -16,6 +17,8 @@
 
 namespace llvm {
 class CallInst;
+class Function;
+class Module;
 class Use;
 } // namespace llvm
 
@@ -46,8 +49,8 @@ llvmIntToModelType(const llvm::Type *LLVMType, const model::Binary &Model);
 extern model::QualifiedType
 deserializeFromLLVMString(llvm::Value *V, const model::Binary &Model);
 
-/// Create a global string in the given LLVM module that contains a
-/// serialization of \a QT.
+/// Create a global string in the given LLVM module that contains a compact
+/// reference to \a QT: the key of its unqualified type and its qualifiers.
 llvm::Constant *serializeToLLVMString(const model::QualifiedType &QT,
                                       llvm::Module &M);
 
@@ -96,6 +99,14 @@ getExpectedModelType(FunctionMetadataCache &Cache,
                      const llvm::Use *U,
                      const model::Binary &Model);
 
+/// Populate \p Cache with the metadata of \p Functions. Afterwards the
+/// metadata of those functions, and of their call sites, is only read from
+/// \p Cache, which can then be safely queried from multiple threads as long as
+/// nothing else is added to it.
+extern void
+prefillFunctionMetadata(FunctionMetadataCache &Cache,
+                        llvm::ArrayRef<const llvm::Function *> Functions);
+
 extern llvm::SmallVector<model::QualifiedType>
 flattenReturnTypes(const abi::FunctionType::Layout &Layout,
                    const model::Binary &Model);
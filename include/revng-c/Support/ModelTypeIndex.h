@@ -0,0 +1,51 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <tuple>
+#include <utility>
+
+#include "llvm/ADT/DenseMap.h"
+
+#include "revng/Model/Binary.h"
+#include "revng/Support/Assert.h"
+
+/// A hash table from the key of each type of a model to the type, so that a
+/// type is found with a single probe instead of a search in Binary::Types.
+///
+/// The index is a snapshot of the model it's built from: it must not be used
+/// after types have been added to or removed from it. Being read only, it can
+/// be shared among threads.
+class ModelTypeIndex {
+private:
+  using IndexKey = std::pair<uint64_t, unsigned>;
+
+private:
+  llvm::DenseMap<IndexKey, const model::Type *> Types;
+
+public:
+  explicit ModelTypeIndex(const model::Binary &Model);
+
+public:
+  /// \return the type with key \p Key, or nullptr if there's none
+  const model::Type *find(const model::Type::Key &Key) const {
+    auto It = Types.find(toIndexKey(Key));
+    return It != Types.end() ? It->second : nullptr;
+  }
+
+  const model::Type &at(const model::Type::Key &Key) const {
+    const model::Type *Result = find(Key);
+    revng_assert(Result != nullptr);
+    return *Result;
+  }
+
+  size_t size() const { return Types.size(); }
+
+private:
+  static IndexKey toIndexKey(const model::Type::Key &Key) {
+    return { std::get<0>(Key), static_cast<unsigned>(std::get<1>(Key)) };
+  }
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+#include <vector>
+
+#include "llvm/IR/Module.h"
+
+/// Split the isolated functions of \p M in \p ShardCount modules.
+///
+/// Functions are assigned to shards so that each shard gets roughly the same
+/// number of instructions. Each shard holds the definitions of its isolated
+/// functions, and only the declarations and the global variables they use.
+/// \p M is not changed.
+std::vector<std::unique_ptr<llvm::Module>>
+splitIsolatedFunctions(const llvm::Module &M, unsigned ShardCount);
+
+/// Replace the bodies of the functions of \p M with the ones defined in
+/// \p Shard, which must have been obtained from splitIsolatedFunctions on \p M
+/// and must live in the same LLVMContext.
+///
+/// References to global values of \p Shard are rewritten to refer to their
+/// counterpart with the same name in \p M. Only the function bodies are merged
+/// back, changes to the global variables of \p Shard are lost.
+void mergeShard(llvm::Module &M, const llvm::Module &Shard);
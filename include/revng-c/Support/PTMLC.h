@@ -5,8 +5,10 @@
 //
 
 #include <type_traits>
+#include <unordered_map>
 
 #include "llvm/ADT/APInt.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/Value.h"
 
@@ -19,6 +21,7 @@
 #include "revng/Pipeline/Location.h"
 
 #include "revng-c/Pipes/Ranks.h"
+#include "revng-c/Support/IntegerFormatting.h"
 #include "revng-c/Support/PTML.h"
 #include "revng-c/Support/TokenDefinitions.h"
 
@@ -69,6 +72,7 @@ public:
     If,
     Else,
     Return,
+    Goto,
     Typedef,
     Struct,
     Union,
@@ -99,10 +103,22 @@ public:
     Attribute,
   };
 
+private:
+  /// The references to types without allowed actions built so far.
+  ///
+  /// A PTMLCBuilder must not be shared among threads, and these refer to the
+  /// model: see clearCaches.
+  mutable std::unordered_map<const model::Type *, std::string> TypeReferences;
+
 public:
   PTMLCBuilder(bool GeneratePlainC = false) :
     ptml::PTMLBuilder(GeneratePlainC) {}
 
+public:
+  /// Forget everything that was computed from the model, must be called before
+  /// reusing this builder on another model, or after the model has changed.
+  void clearCaches() { TypeReferences.clear(); }
+
 private:
   llvm::StringRef toString(Keyword TheKeyword) const {
     switch (TheKeyword) {
@@ -128,6 +144,8 @@ private:
       return "else";
     case Keyword::Return:
       return "return";
+    case Keyword::Goto:
+      return "goto";
     case Keyword::Typedef:
       return "typedef";
     case Keyword::Struct:
@@ -283,12 +301,8 @@ private:
     return tokenTag(Str, ptml::c::tokens::Operator);
   }
 
-  std::string hexHelper(uint64_t Int) const {
-    std::string Result;
-    llvm::raw_string_ostream Out(Result);
-    Out.write_hex(Int);
-    Out.flush();
-    return Result;
+  FormattedInteger hexHelper(uint64_t Int) const {
+    return FormattedInteger::hex(Int);
   }
 
   Tag keywordTagHelper(const llvm::StringRef Str) const {
@@ -325,14 +339,24 @@ public:
   Tag getFalseTag() const { return getConstantTag("false"); }
 
   Tag getHex(uint64_t Int) const {
-    return getConstantTag("0x" + hexHelper(Int) + "U");
+    llvm::SmallString<24> Result("0x");
+    Result += hexHelper(Int).str();
+    Result += 'U';
+    return getConstantTag(Result);
   }
 
   Tag getNumber(const llvm::APInt &I,
                 unsigned int Radix = 10,
                 bool Signed = false) const {
     llvm::SmallString<12> Result;
-    I.toString(Result, Radix, Signed);
+    if (Radix == 10 and I.getBitWidth() <= 64) {
+      if (Signed)
+        Result = FormattedInteger::signedDecimal(I.getSExtValue()).str();
+      else
+        Result = FormattedInteger::decimal(I.getZExtValue()).str();
+    } else {
+      I.toString(Result, Radix, Signed);
+    }
     if (I.getBitWidth() == 64 and I.isNegative())
       Result += 'U';
 
@@ -391,6 +415,19 @@ public:
            + "\n";
   }
 
+  /// The opening of a classic include guard. Unlike `#pragma once`, it also
+  /// works when the header has been precompiled from another path.
+  std::string getIncludeGuardBegin(const llvm::StringRef Macro) const {
+    std::string Result = getDirective(Directive::IfNotDef) + " " + Macro.str()
+                         + "\n";
+    Result += getDirective(Directive::Define) + " " + Macro.str() + "\n";
+    return Result;
+  }
+
+  std::string getIncludeGuardEnd() const {
+    return getDirective(Directive::EndIf) + "\n";
+  }
+
   std::string getIncludeAngle(const llvm::StringRef Str) {
     std::string TheStr;
     if (!isGenerateTagLessPTML())
@@ -465,10 +502,11 @@ public:
   std::string getLocation(bool IsDefinition,
                           const model::Type &T,
                           llvm::ArrayRef<std::string> AllowedActions) const {
-    auto Result = getNameTag(T);
+    // In plain C mode the tags are dropped anyway, so don't even build them
     if (isGenerateTagLessPTML())
-      return Result.serialize();
+      return T.name().str().str();
 
+    auto Result = getNameTag(T);
     std::string Location = serializeLocation(T);
     Result.addAttribute(getLocationAttribute(IsDefinition), Location);
     // non-primitive types are editable
@@ -490,7 +528,13 @@ public:
   std::string
   getLocationReference(const model::Type &T,
                        llvm::ArrayRef<std::string> AllowedActions = {}) const {
-    return getLocation(false, T, AllowedActions);
+    if (not AllowedActions.empty())
+      return getLocation(false, T, AllowedActions);
+
+    auto [It, IsNew] = TypeReferences.try_emplace(&T);
+    if (IsNew)
+      It->second = getLocation(false, T, AllowedActions);
+    return It->second;
   }
 
   std::string serializeLocation(const model::Segment &T) const {
@@ -504,6 +548,9 @@ public:
   }
 
   std::string getLocation(bool IsDefinition, const model::Segment &S) const {
+    if (isGenerateTagLessPTML())
+      return S.name().str().str();
+
     std::string Location = serializeLocation(S);
     return getNameTag(S)
       .addAttribute(getLocationAttribute(IsDefinition), Location)
@@ -558,6 +605,9 @@ public:
   std::string getLocation(bool IsDefinition,
                           const model::EnumType &Enum,
                           const model::EnumEntry &Entry) const {
+    if (isGenerateTagLessPTML())
+      return Enum.entryName(Entry);
+
     std::string Location = serializeLocation(Enum, Entry);
     return getNameTag(Enum, Entry)
       .addAttribute(getLocationAttribute(IsDefinition), Location)
@@ -573,6 +623,9 @@ public:
   template<typename Aggregate, typename Field>
   std::string
   getLocation(bool IsDefinition, const Aggregate &A, const Field &F) const {
+    if (isGenerateTagLessPTML())
+      return F.name().str().str();
+
     std::string Location = serializeLocation(A, F);
     return getNameTag(A, F)
       .addAttribute(getLocationAttribute(IsDefinition), Location)
@@ -0,0 +1,67 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace ptml {
+
+/// The PTML output split in plain text and a table of the locations that the
+/// markup used to attach to ranges of that text.
+///
+/// Clients can look up locations through the table, without having to parse
+/// the markup.
+struct LocationTable {
+  static constexpr uint32_t NoString = UINT32_MAX;
+
+  /// A range of Text that used to be wrapped in a tag carrying locations.
+  /// Begin and End are byte offsets in Text, the others are indices in
+  /// Strings or NoString.
+  struct Record {
+    uint32_t Begin = 0;
+    uint32_t End = 0;
+    uint32_t Definition = NoString;
+    uint32_t References = NoString;
+    uint32_t ActionContextLocation = NoString;
+    uint32_t AllowedActions = NoString;
+
+    bool operator==(const Record &) const = default;
+  };
+
+  std::string Text;
+
+  /// Sorted by Begin. Records starting at the same offset are sorted from the
+  /// outermost to the innermost.
+  std::vector<Record> Records;
+
+  /// The attribute values referenced by Records, each of them stored once
+  std::vector<std::string> Strings;
+
+public:
+  /// Strip all the markup from \p PTML, recording the locations it carries
+  static LocationTable fromPTML(llvm::StringRef PTML);
+
+public:
+  /// Write the table in a compact binary format, suitable to be mmap'd:
+  ///
+  ///     "PTMLLOC1"
+  ///     u32 TextSize, u32 RecordCount, u32 StringCount
+  ///     TextSize bytes of plain text, padded with zeros to a multiple of 4
+  ///     RecordCount x { u32 Begin, End, Definition, References,
+  ///                     ActionContextLocation, AllowedActions }
+  ///     (StringCount + 1) x u32 offsets of the strings, from the first one
+  ///     the bytes of the strings, one after the other
+  ///
+  /// All the integers are little endian, and aligned to 4 bytes from the start
+  /// of the table.
+  void serialize(llvm::raw_ostream &OS) const;
+};
+
+} // namespace ptml
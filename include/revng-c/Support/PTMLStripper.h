@@ -0,0 +1,63 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <string>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace ptml {
+
+/// Decode the PTML entity \p Entity, without the leading '&' and the trailing
+/// ';'. Only the entities of ASCII characters are supported.
+char decodeEntity(llvm::StringRef Entity);
+
+/// Turn PTML into the plain text it marks up, dropping all the tags and
+/// decoding the entities.
+///
+/// The PTML can be fed in chunks of any size, split at any position, and the
+/// plain text is written to the output as soon as it is available: the memory
+/// used doesn't depend on the size of the input.
+class PTMLStripper {
+private:
+  enum StateKind {
+    Text,
+    Tag,
+    AttributeValue,
+    Entity,
+  };
+
+private:
+  llvm::raw_ostream &OS;
+  StateKind State = Text;
+
+  /// The part of the entity being parsed seen so far, without the '&'
+  llvm::SmallString<8> PendingEntity;
+
+public:
+  explicit PTMLStripper(llvm::raw_ostream &OS) : OS(OS) {}
+
+public:
+  void write(llvm::StringRef Chunk);
+
+  /// Check that the PTML didn't end in the middle of a tag or of an entity
+  void finish();
+};
+
+/// Return the plain text marked up by \p PTML
+inline std::string stripPTML(llvm::StringRef PTML) {
+  std::string Result;
+  Result.reserve(PTML.size());
+  llvm::raw_string_ostream OS(Result);
+  PTMLStripper Stripper(OS);
+  Stripper.write(PTML);
+  Stripper.finish();
+  OS.flush();
+  return Result;
+}
+
+} // namespace ptml
@@ -0,0 +1,81 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace revng {
+
+/// An archive of named members, each of them compressed on its own and
+/// preceded by an index sorted by name.
+///
+/// Unlike a .tar.gz, a single member can be extracted by looking it up in the
+/// index and decompressing only its own bytes.
+class SeekableArchive {
+public:
+  enum CodecKind : uint8_t {
+    Store = 0,
+    Zlib = 1,
+  };
+
+  struct Entry {
+    llvm::StringRef Name;
+
+    /// From the first byte after the index
+    uint64_t Offset = 0;
+    uint64_t CompressedSize = 0;
+    uint64_t Size = 0;
+  };
+
+private:
+  CodecKind Codec = Store;
+  llvm::StringRef Data;
+
+  /// Sorted by name, referencing the buffer the archive has been opened on
+  std::vector<Entry> Index;
+
+public:
+  /// Write \p Members to \p OS, compressing each of them with zlib at
+  /// \p Level, or storing them if \p Level is 0 or zlib is not available:
+  ///
+  ///     "RVNGPAK1"
+  ///     u8 Codec, u32 MemberCount
+  ///     MemberCount x { u32 NameSize, the name, u64 Offset,
+  ///                     u64 CompressedSize, u64 Size }
+  ///     the members, one after the other
+  ///
+  /// All the integers are little endian. Names must be unique.
+  static llvm::Error
+  write(llvm::ArrayRef<std::pair<std::string, llvm::StringRef>> Members,
+        int Level,
+        llvm::raw_ostream &OS);
+
+  /// Parse the index of the archive in \p Buffer, which must outlive the
+  /// result. Members are not decompressed.
+  static llvm::Expected<SeekableArchive> open(llvm::StringRef Buffer);
+
+public:
+  CodecKind codec() const { return Codec; }
+  llvm::ArrayRef<Entry> entries() const { return Index; }
+
+  /// Look up the member called \p Name in the index, nullptr if missing
+  const Entry *find(llvm::StringRef Name) const;
+
+  /// Decompress \p Member, which must be one of the entries()
+  llvm::Expected<std::string> extract(const Entry &Member) const;
+
+  /// Decompress the member called \p Name
+  llvm::Expected<std::string> extract(llvm::StringRef Name) const;
+};
+
+} // namespace revng
@@ -0,0 +1,115 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "llvm/ADT/Twine.h"
+
+/// Timers and counters of the hot parts of revng-c, written as a Chrome trace
+/// (to be opened in chrome://tracing or in Perfetto) to the path given with
+/// --trace-output.
+///
+/// When --trace-output is not set, a Scope or a Counter update costs a load
+/// and a branch, so they can be left in place in the hot paths.
+namespace trace {
+
+namespace detail {
+
+extern bool Enabled;
+
+/// Microseconds since the start of the process
+uint64_t now();
+
+void recordScope(const char *Category,
+                 const char *Name,
+                 std::string &&Detail,
+                 uint64_t Start,
+                 uint64_t End);
+
+} // namespace detail
+
+inline bool isEnabled() {
+  return detail::Enabled;
+}
+
+/// Records the time from its construction to its destruction as an event of
+/// the current thread, so that nested Scopes are nested in the trace too.
+///
+/// \p Category and \p Name must be string literals. \p Detail, e.g. the name of
+/// the function being processed, is only rendered if tracing is enabled.
+class Scope {
+private:
+  const char *Category = nullptr;
+  const char *Name = nullptr;
+  std::string Detail;
+  uint64_t Start = 0;
+
+public:
+  Scope(const char *Category,
+        const char *Name,
+        const llvm::Twine &Detail = llvm::Twine()) {
+    if (not isEnabled())
+      return;
+
+    this->Category = Category;
+    this->Name = Name;
+    this->Detail = Detail.str();
+    Start = detail::now();
+  }
+
+  ~Scope() {
+    if (Name != nullptr)
+      detail::recordScope(Category,
+                          Name,
+                          std::move(Detail),
+                          Start,
+                          detail::now());
+  }
+
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+};
+
+/// A named counter, to be declared as a static variable. The counters that
+/// have been updated are reported, with their final value, at the end of the
+/// trace. They can be updated from multiple threads.
+class Counter {
+private:
+  const char *Category;
+  const char *Name;
+  std::atomic<uint64_t> Value = 0;
+  std::atomic<bool> Registered = false;
+
+public:
+  constexpr Counter(const char *Category, const char *Name) :
+    Category(Category), Name(Name) {}
+
+  Counter(const Counter &) = delete;
+  Counter &operator=(const Counter &) = delete;
+
+public:
+  Counter &operator+=(uint64_t Amount) {
+    if (isEnabled()) {
+      if (not Registered.load(std::memory_order_relaxed))
+        registerCounter();
+      Value.fetch_add(Amount, std::memory_order_relaxed);
+    }
+    return *this;
+  }
+
+  Counter &operator++() { return *this += 1; }
+
+  const char *category() const { return Category; }
+  const char *name() const { return Name; }
+  uint64_t value() const { return Value.load(std::memory_order_relaxed); }
+
+private:
+  void registerCounter();
+};
+
+} // namespace trace
@@ -4,7 +4,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include "revng/ADT/GenericGraph.h"
 #include "revng/Model/Binary.h"
@@ -36,6 +38,9 @@ private:
   GraphInfo TypeGraph;
   std::unordered_map<const model::Type *, unsigned> TypeToNumOfRefs;
   std::set<const model::Type *> TypesToInline;
+  /// For each type, the types to inline that are referenced by it
+  std::unordered_map<const model::Type *, std::vector<const model::Type *>>
+    InlinedChildren;
 
 public:
   TypeInlineHelper(const model::Binary &Model);
@@ -69,18 +74,32 @@ private:
 
   std::unordered_map<const model::Type *, unsigned>
   calculateNumOfOccurences(const model::Binary &Model);
+};
 
-  bool isReachableFromRootType(const model::Type *Type,
-                               const model::Type *RootType,
-                               const GraphInfo &TypeGraph);
+/// The type inlining decisions for a model, shared by all the pipes that need
+/// them.
+struct TypeInliningInfo {
+  TypeInlineHelper Helper;
 
-  // Helper function used for finding all nested (into `RootType`) inlinable
-  // types.
-  std::set<const model::Type *>
-  getNestedTypesToInline(const model::Type *RootType,
-                         const UpcastablePointer<model::Type> &NestedTy) const;
+  /// The stack types of each function, and the types to inline into them
+  std::unordered_map<const model::Function *, std::set<const model::Type *>>
+    StackTypesPerFunction;
+
+  /// The union of all the sets in StackTypesPerFunction
+  std::set<const model::Type *> StackTypes;
+
+  TypeInliningInfo(const model::Binary &Model);
 };
 
+/// Return the type inlining decisions for \p Model.
+///
+/// The result of the last invocation is reused as long as the parts of the
+/// model it depends upon (the types, their edges and the stack frame types of
+/// functions) did not change, and are still the same objects, so that all the
+/// pipes working on the same revision of the model compute it only once.
+extern std::shared_ptr<const TypeInliningInfo>
+getTypeInliningInfo(const model::Binary &Model);
+
 extern bool declarationIsDefinition(const model::Type *T);
 
 extern void printForwardDeclaration(const model::Type &T,
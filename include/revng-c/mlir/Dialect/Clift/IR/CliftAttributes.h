@@ -63,12 +63,11 @@ public:
   void setBody(llvm::StringRef Name,
                uint64_t Size,
                llvm::ArrayRef<FieldAttr> fields) {
-    // Call into the base to mutate the type.
-    LogicalResult result = Base::mutate(Name, Size, fields);
-
-    // Most types expect the mutation to always succeed, but types can implement
-    // custom logic for handling mutation failures.
-    revng_assert(succeeded(result)
+    // The body is published without going through Base::mutate, so that
+    // filling in different types from multiple threads does not serialize on
+    // the StorageUniquer lock.
+    bool Published = getImpl()->setBody(Name, Size, fields);
+    revng_assert(Published
                  && "attempting to change the body of an already-initialized "
                     "type");
   }
@@ -135,12 +134,16 @@ public:
   static llvm::StringRef getMnemonic() { return "union"; }
 
   void setBody(llvm::StringRef Name, llvm::ArrayRef<FieldAttr> fields) {
-    // Call into the base to mutate the type.
-    LogicalResult result = Base::mutate(Name, fields);
+    uint64_t Size = 0;
+    for (FieldAttr Field : fields) {
+      mlir::Type FieldType = Field.getType();
+      uint64_t FieldSize = FieldType.cast<ValueType>().getByteSize();
+      Size = FieldSize > Size ? FieldSize : Size;
+    }
 
-    // Most types expect the mutation to always succeed, but types can implement
-    // custom logic for handling mutation failures.
-    revng_assert(succeeded(result)
+    // See StructType::setBody
+    bool Published = getImpl()->setBody(Name, Size, fields);
+    revng_assert(Published
                  && "attempting to change the body of an already-initialized "
                     "type");
   }
@@ -156,17 +159,7 @@ public:
 
   uint64_t getId() const { return getImpl()->getID(); }
 
-  uint64_t getByteSize() {
-    if (not isDefinition())
-      return 0;
-    uint64_t Max = 0;
-    for (auto Field : getFields()) {
-      mlir::Type FieldType = Field.getType();
-      uint64_t Size = FieldType.cast<mlir::clift::ValueType>().getByteSize();
-      Max = Size > Max ? Size : Max;
-    }
-    return Max;
-  }
+  uint64_t getByteSize() { return getImpl()->getSize(); }
 
   static Attribute parse(AsmParser &parser);
   Attribute print(AsmPrinter &p) const;
@@ -4,6 +4,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
+#include <memory>
+#include <string>
+
 #include "mlir/IR/AttributeSupport.h"
 #include "mlir/IR/Attributes.h"
 #include "mlir/IR/TypeSupport.h"
@@ -12,13 +16,61 @@
 
 namespace mlir::clift {
 
+/// The mutable component of struct and union types: it's missing until the
+/// definition of the type is seen, and from then on it never changes.
+struct IdentifiedTypeBody {
+  std::string Name;
+  uint64_t Size = 0;
+  llvm::SmallVector<FieldAttr, 2> Fields;
+
+  bool operator==(const IdentifiedTypeBody &Other) const {
+    return Name == Other.Name and Size == Other.Size and Fields == Other.Fields;
+  }
+};
+
+/// Holds the body of an identified type, which is published at most once.
+///
+/// Publishing is a single compare-and-swap on a pointer, so it does not go
+/// through the StorageUniquer mutation lock and never blocks: threads filling
+/// in the bodies of different types do not contend with each other, and
+/// readers see either no body or a complete one.
+class PublishedTypeBody {
+private:
+  std::atomic<const IdentifiedTypeBody *> Body = nullptr;
+
+public:
+  PublishedTypeBody() = default;
+  PublishedTypeBody(const PublishedTypeBody &) = delete;
+  PublishedTypeBody &operator=(const PublishedTypeBody &) = delete;
+
+  ~PublishedTypeBody() { delete Body.load(std::memory_order_relaxed); }
+
+public:
+  const IdentifiedTypeBody *get() const {
+    return Body.load(std::memory_order_acquire);
+  }
+
+  /// \return true if \p NewBody has been published, or if an identical body
+  ///         had already been published.
+  bool publish(std::unique_ptr<IdentifiedTypeBody> NewBody) {
+    const IdentifiedTypeBody *Expected = nullptr;
+    if (Body.compare_exchange_strong(Expected,
+                                     NewBody.get(),
+                                     std::memory_order_acq_rel,
+                                     std::memory_order_acquire)) {
+      NewBody.release();
+      return true;
+    }
+
+    return *Expected == *NewBody;
+  }
+};
+
 struct StructTypeStorage : public mlir::AttributeStorage {
 public:
-  // Some internal mechanism of mlir have access to the key of the storage
-  // instead of the entire storage or the key using that storage. For that
-  // reason it is best to throw everything related to the type inside the key,
-  // and then override operators to pretend they don't know about the non key
-  // fields. That way when it is needed one can access everything.
+  // The key is only used to look up and construct the storage: the body, if
+  // it's provided, is published right away and it's not part of the
+  // uniquing, which only considers the ID.
   struct Key {
     uint64_t ID;
     uint64_t Size;
@@ -39,12 +91,9 @@ public:
 
   static llvm::hash_code hashKey(const KeyTy &key) { return key.hashValue(); }
 
-  /// Construct the storage from the type name. Explicitly initialize the
-  /// containedType to nullptr, which is used as marker for the mutable
-  /// component being not yet initialized.
-  StructTypeStorage(uint64_t ID) { TheKey.ID = ID; }
+  StructTypeStorage(uint64_t ID) : ID(ID) {}
 
-  bool operator==(const Key &Other) const { return this->TheKey == Other; }
+  bool operator==(const Key &Other) const { return ID == Other.ID; }
 
   /// Define a construction method for creating a new instance of the storage.
   static StructTypeStorage *
@@ -53,51 +102,49 @@ public:
     auto ToReturn = new (allocator.allocate<StructTypeStorage>())
       StructTypeStorage(Key.ID);
     if (Key.isInitialized()) {
-      auto Res = ToReturn->mutate(allocator, Key.name, Key.Size, *Key.fields);
-      revng_assert(Res.succeeded());
+      bool Published = ToReturn->setBody(Key.name, Key.Size, *Key.fields);
+      revng_assert(Published);
     }
 
     return ToReturn;
   }
 
-  /// Define a mutation method for changing the type after it is created. In
-  /// many cases, we only want to set the mutable component once and reject
-  /// any further modification, which can be achieved by returning failure
-  /// from this function.
-  mlir::LogicalResult mutate(mlir::StorageUniquer::StorageAllocator &alloc,
-                             llvm::StringRef name,
+  /// Set the body of the type, after it has been created. The body can be set
+  /// only once, any attempt to change it fails, while setting an identical
+  /// body again succeeds. This is safe to call from multiple threads.
+  [[nodiscard]] bool setBody(llvm::StringRef Name,
                              uint64_t Size,
-                             llvm::ArrayRef<FieldAttr> body) {
-    if (TheKey.fields.has_value() and body == *TheKey.fields
-        and TheKey.name == name and TheKey.Size == Size)
-      return mlir::success();
-
-    if (TheKey.fields.has_value())
-      return mlir::failure();
-
-    TheKey.fields = llvm::SmallVector<FieldAttr, 2>();
-    for (auto field : body)
-      TheKey.fields->push_back(field);
-    TheKey.name = alloc.copyInto(name);
-    TheKey.Size = Size;
-    return mlir::success();
+                             llvm::ArrayRef<FieldAttr> Fields) {
+    auto NewBody = std::make_unique<IdentifiedTypeBody>();
+    NewBody->Name = Name.str();
+    NewBody->Size = Size;
+    NewBody->Fields.assign(Fields.begin(), Fields.end());
+    return Body.publish(std::move(NewBody));
   }
 
-  [[nodiscard]] llvm::StringRef getName() const { return TheKey.name; }
+  [[nodiscard]] llvm::StringRef getName() const {
+    const IdentifiedTypeBody *Current = Body.get();
+    return Current != nullptr ? llvm::StringRef(Current->Name) : "";
+  }
 
-  [[nodiscard]] bool isInitialized() const { return TheKey.isInitialized(); }
+  [[nodiscard]] bool isInitialized() const { return Body.get() != nullptr; }
 
   llvm::ArrayRef<FieldAttr> getFields() const {
-    revng_assert(isInitialized());
-    return *TheKey.fields;
+    const IdentifiedTypeBody *Current = Body.get();
+    revng_assert(Current != nullptr);
+    return Current->Fields;
   }
 
-  uint64_t getSize() const { return TheKey.Size; }
+  uint64_t getSize() const {
+    const IdentifiedTypeBody *Current = Body.get();
+    return Current != nullptr ? Current->Size : 0;
+  }
 
-  uint64_t getID() const { return TheKey.ID; }
+  uint64_t getID() const { return ID; }
 
 private:
-  Key TheKey;
+  uint64_t ID;
+  PublishedTypeBody Body;
 };
 
 struct UnionTypeStorage : public mlir::AttributeStorage {
@@ -105,6 +152,7 @@ public:
   struct Key {
 
     uint64_t ID;
+    uint64_t Size;
     llvm::StringRef name;
     Optional<llvm::SmallVector<FieldAttr, 2>> fields;
 
@@ -119,10 +167,10 @@ public:
 
   static llvm::hash_code hashKey(const KeyTy &key) { return key.hashValue(); }
 
-  UnionTypeStorage(uint64_t ID) { TheKey.ID = ID; }
+  UnionTypeStorage(uint64_t ID) : ID(ID) {}
 
   /// Define the comparison function.
-  bool operator==(const KeyTy &key) const { return key == TheKey; }
+  bool operator==(const KeyTy &key) const { return key.ID == ID; }
 
   /// Define a construction method for creating a new instance of the storage.
   static UnionTypeStorage *
@@ -131,47 +179,48 @@ public:
     auto ToReturn = new (allocator.allocate<UnionTypeStorage>())
       UnionTypeStorage(Key.ID);
     if (Key.isInitialized()) {
-      auto Res = ToReturn->mutate(allocator, Key.name, *Key.fields);
-      revng_assert(Res.succeeded());
+      bool Published = ToReturn->setBody(Key.name, Key.Size, *Key.fields);
+      revng_assert(Published);
     }
 
     return ToReturn;
   }
 
-  /// Define a mutation method for changing the type after it is created. In
-  /// many cases, we only want to set the mutable component once and reject
-  /// any further modification, which can be achieved by returning failure
-  /// from this function.
-  mlir::LogicalResult mutate(mlir::StorageUniquer::StorageAllocator &alloc,
-                             llvm::StringRef name,
-                             llvm::ArrayRef<FieldAttr> body) {
-    if (TheKey.fields.has_value() and body == *TheKey.fields
-        and TheKey.name == name)
-      return mlir::success();
-
-    if (TheKey.fields.has_value())
-      return mlir::failure();
-
-    TheKey.fields = llvm::SmallVector<FieldAttr, 2>();
-    for (auto field : body)
-      TheKey.fields->push_back(field);
-    TheKey.name = alloc.copyInto(name);
-    return mlir::success();
+  /// Set the body of the type, with the same rules of StructTypeStorage.
+  /// \p Size is the size of the largest field, which is computed once here
+  /// rather than every time the size of the union is requested.
+  [[nodiscard]] bool setBody(llvm::StringRef Name,
+                             uint64_t Size,
+                             llvm::ArrayRef<FieldAttr> Fields) {
+    auto NewBody = std::make_unique<IdentifiedTypeBody>();
+    NewBody->Name = Name.str();
+    NewBody->Size = Size;
+    NewBody->Fields.assign(Fields.begin(), Fields.end());
+    return Body.publish(std::move(NewBody));
   }
 
-  [[nodiscard]] llvm::StringRef getName() const { return TheKey.name; }
+  [[nodiscard]] llvm::StringRef getName() const {
+    const IdentifiedTypeBody *Current = Body.get();
+    return Current != nullptr ? llvm::StringRef(Current->Name) : "";
+  }
 
-  [[nodiscard]] bool isInitialized() const { return TheKey.isInitialized(); }
+  [[nodiscard]] bool isInitialized() const { return Body.get() != nullptr; }
 
   llvm::ArrayRef<FieldAttr> getFields() const {
+    const IdentifiedTypeBody *Current = Body.get();
+    revng_assert(Current != nullptr);
+    return Current->Fields;
+  }
 
-    revng_assert(isInitialized());
-    return *TheKey.fields;
+  uint64_t getSize() const {
+    const IdentifiedTypeBody *Current = Body.get();
+    return Current != nullptr ? Current->Size : 0;
   }
 
-  uint64_t getID() const { return TheKey.ID; }
+  uint64_t getID() const { return ID; }
 
 private:
-  Key TheKey;
+  uint64_t ID;
+  PublishedTypeBody Body;
 };
 } // namespace mlir::clift
@@ -0,0 +1,64 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+
+#include "mlir/IR/MLIRContext.h"
+
+#include "revng/Model/Binary.h"
+
+#include "revng-c/mlir/Dialect/Clift/IR/CliftAttributes.h"
+#include "revng-c/mlir/Dialect/Clift/IR/CliftInterfaces.h"
+#include "revng-c/mlir/Dialect/Clift/IR/CliftTypes.h"
+
+namespace mlir::clift {
+
+/// Translates the types of a model::Binary to Clift types.
+///
+/// Each model type is translated once: the result is cached by the ID of the
+/// model type, so that the same object can be used to translate all the types
+/// and all the functions of a binary. Struct and union types are registered in
+/// the cache before their fields are translated, which is what makes recursive
+/// types (through pointers) possible.
+class ModelTypeImporter {
+private:
+  mlir::MLIRContext *Context;
+  const model::Binary &Model;
+
+  /// Non-const Clift type of each model type, by model type ID
+  llvm::DenseMap<uint64_t, ValueType> Cache;
+
+  /// IDs of the types with a translation in progress, other than structs and
+  /// unions, used to detect cycles that should not be there
+  llvm::DenseSet<uint64_t> InProgress;
+
+  /// IDs already used by the model, or handed out for the artificial structs
+  /// returned by RawFunctionTypes
+  llvm::DenseSet<uint64_t> UsedIDs;
+  uint64_t NextFreeID = 0;
+
+public:
+  ModelTypeImporter(mlir::MLIRContext *Context, const model::Binary &Model);
+
+public:
+  /// Translate all the types of the model
+  void importAllTypes();
+
+  ValueType get(const model::Type &Type);
+
+  ValueType get(const model::QualifiedType &Type);
+
+private:
+  ValueType translate(const model::Type &Type);
+  TypeDefinition translateDefinition(const model::Type &Type);
+
+  ValueType makeConst(ValueType Type);
+  ValueType getReturnType(const model::RawFunctionType &Function);
+  uint64_t getFreshID();
+};
+
+} // namespace mlir::clift
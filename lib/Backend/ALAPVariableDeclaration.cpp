@@ -10,7 +10,6 @@
 #include <list>
 #include <type_traits>
 
-#include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Instructions.h"
@@ -21,152 +20,12 @@
 
 #include "revng-c/RestructureCFG/ASTNode.h"
 #include "revng-c/RestructureCFG/ASTTree.h"
+#include "revng-c/RestructureCFG/GHASTBBIndex.h"
 #include "revng-c/Support/DecompilationHelpers.h"
 #include "revng-c/Support/FunctionTags.h"
 
 #include "ALAPVariableDeclaration.h"
 
-using BBGHASTNodeMap = std::multimap<const llvm::BasicBlock *, const ASTNode *>;
-
-static RecursiveCoroutine<void>
-collectExprBB(ExprNode *Expr, const ASTNode *Node, BBGHASTNodeMap &ResultMap) {
-  switch (Expr->getKind()) {
-  case ExprNode::NodeKind::NK_ValueCompare:
-  case ExprNode::NodeKind::NK_LoopStateCompare: {
-    // There is no associated `BasicBlock`
-  } break;
-  case ExprNode::NodeKind::NK_Atomic: {
-    auto *Atomic = llvm::cast<AtomicNode>(Expr);
-    llvm::BasicBlock *BB = Atomic->getConditionalBasicBlock();
-    ResultMap.insert(std::make_pair(BB, Node));
-  } break;
-  case ExprNode::NodeKind::NK_Not: {
-    auto *Not = llvm::cast<NotNode>(Expr);
-    ExprNode *NegatedNode = Not->getNegatedNode();
-    rc_recur collectExprBB(NegatedNode, Node, ResultMap);
-  } break;
-  case ExprNode::NodeKind::NK_And:
-  case ExprNode::NodeKind::NK_Or: {
-    auto *Binary = llvm::cast<BinaryNode>(Expr);
-    const auto &[LHS, RHS] = Binary->getInternalNodes();
-    rc_recur collectExprBB(LHS, Node, ResultMap);
-    rc_recur collectExprBB(RHS, Node, ResultMap);
-  } break;
-  default:
-    revng_unreachable();
-  }
-
-  rc_return;
-}
-
-class BBToASTNodeMapping {
-  BBGHASTNodeMap BBToASTNode;
-  const ASTTree &GHAST;
-
-private:
-  RecursiveCoroutine<void> computeImpl(const ASTNode *Node) {
-    switch (Node->getKind()) {
-    case ASTNode::NK_List: {
-      auto *Seq = llvm::cast<SequenceNode>(Node);
-
-      // A `SequenceNode` should not have an associated `BasicBlock`
-      revng_assert(Seq->getOriginalBB() == nullptr);
-
-      // Recursively visit on each element of the `SequenceNode`
-      for (ASTNode *Child : Seq->nodes()) {
-        rc_recur computeImpl(Child);
-      }
-    } break;
-    case ASTNode::NK_Scs: {
-      auto *Scs = llvm::cast<ScsNode>(Node);
-
-      // An `ScsNode` should not have an associated `BasicBlock`
-      revng_assert(Scs->getOriginalBB() == nullptr);
-
-      // Inspect the related condition containing the `IfNode` associated to the
-      // execution of the loop
-      if (not Scs->isWhileTrue()) {
-        IfNode *If = Scs->getRelatedCondition();
-        ExprNode *IfExpr = If->getCondExpr();
-        collectExprBB(IfExpr, Scs, BBToASTNode);
-      }
-
-      if (Scs->hasBody()) {
-        rc_recur computeImpl(Scs->getBody());
-      }
-    } break;
-    case ASTNode::NK_If: {
-      auto *If = llvm::cast<IfNode>(Node);
-
-      // Add the original `BB` in the `ResultMap`
-      llvm::BasicBlock *BB = If->getOriginalBB();
-      BBToASTNode.insert(std::make_pair(BB, If));
-
-      ExprNode *IfExpr = If->getCondExpr();
-      collectExprBB(IfExpr, If, BBToASTNode);
-
-      if (If->hasThen()) {
-        rc_recur computeImpl(If->getThen());
-      }
-      if (If->hasElse()) {
-        rc_recur computeImpl(If->getElse());
-      }
-    } break;
-    case ASTNode::NK_Switch: {
-      auto *Switch = llvm::cast<SwitchNode>(Node);
-
-      // Add the original `BB` in the `ResultMap`
-      llvm::BasicBlock *BB = Switch->getOriginalBB();
-      BBToASTNode.insert(std::make_pair(BB, Switch));
-
-      for (auto &LabelCasePair : Switch->cases_const_range()) {
-        ASTNode *Case = LabelCasePair.second;
-        rc_recur computeImpl(Case);
-      }
-    } break;
-    case ASTNode::NK_Code: {
-
-      // Add the original `BB` in the `ResultMap`
-      auto *Code = llvm::cast<CodeNode>(Node);
-      llvm::BasicBlock *BB = Code->getOriginalBB();
-      BBToASTNode.insert(std::make_pair(BB, Code));
-    } break;
-    case ASTNode::NK_Continue: {
-      auto *Continue = llvm::cast<ContinueNode>(Node);
-
-      // A `ContinueNode` should not have an associated `BasicBlock`
-      revng_assert(Continue->getOriginalBB() == nullptr);
-
-      if (Continue->hasComputation()) {
-        auto *If = llvm::cast<IfNode>(Continue->getComputationIfNode());
-        ExprNode *IfExpr = If->getCondExpr();
-        collectExprBB(IfExpr, Continue, BBToASTNode);
-      }
-    } break;
-    case ASTNode::NK_Set:
-    case ASTNode::NK_SwitchBreak:
-    case ASTNode::NK_Break: {
-
-      // These nodes should not have an associated `BasicBlock`
-      revng_assert(Node->getOriginalBB() == nullptr);
-    } break;
-    default:
-      revng_unreachable();
-    }
-
-    rc_return;
-  }
-
-public:
-  BBToASTNodeMapping(const ASTTree &GHAST) : GHAST(GHAST) {}
-
-  const BBGHASTNodeMap &compute() {
-    ASTNode *RootNode = GHAST.getRoot();
-    computeImpl(RootNode);
-    return BBToASTNode;
-  }
-};
-
 struct ASTForwardNode {
   ASTForwardNode(const ASTNode *Node) : Node(Node) {}
   const ASTNode *Node;
@@ -277,7 +136,7 @@ collectTransitiveUsers(const llvm::Instruction *I,
 
 static llvm::SmallSet<const ASTNode *, 4>
 collectUsageASTNodes(const llvm::Instruction *Variable,
-                     const BBGHASTNodeMap &BBToASTNode) {
+                     const GHASTBBIndex &Index) {
   // Collect the immediate `User`s of the `Variable`
   llvm::SmallSet<const llvm::Instruction *, 4> UsageInstructions;
   for (const llvm::User *VariableUser : Variable->users()) {
@@ -310,10 +169,8 @@ collectUsageASTNodes(const llvm::Instruction *Variable,
 
     // We retrieve all the `GHASTNode`s which encompass the `BasicBlock`
     // above
-    auto Range = BBToASTNode.equal_range(UserBB);
-    for (auto RangeIt = Range.first; RangeIt != Range.second; ++RangeIt) {
-      UsageASTNodes.insert(RangeIt->second);
-    }
+    for (const ASTNode *Covering : Index.coveringNodes(UserBB))
+      UsageASTNodes.insert(Covering);
   }
 
   // Ensure that we find usages for each `Variable` that we need to assign
@@ -333,24 +190,19 @@ makeGHASTReachabilityGraph(const ASTTree &GHAST) {
 }
 
 static std::map<const llvm::CallInst *, llvm::SmallSet<const ASTNode *, 4>>
-computeVariableUsages(const ASTTree &GHAST,
+computeVariableUsages(const GHASTBBIndex &Index,
                       PendingVariableListType &PendingVariables) {
-
-  // Compute a `BasicBlock * -> GHASTNode *` multimap representing which
-  // `GHASTNode`s covers the usage of a certain `BasicBlock`
-  BBToASTNodeMapping Mapping(GHAST);
-  const BBGHASTNodeMap &BBToASTNode = Mapping.compute();
-
   std::map<const llvm::CallInst *, llvm::SmallSet<const ASTNode *, 4>>
     VariableUsages;
   for (auto *Variable : PendingVariables) {
-    VariableUsages[Variable] = collectUsageASTNodes(Variable, BBToASTNode);
+    VariableUsages[Variable] = collectUsageASTNodes(Variable, Index);
   }
 
   return VariableUsages;
 }
 
 ASTVarDeclMap computeVarDeclMap(const ASTTree &GHAST,
+                                const GHASTBBIndex &Index,
                                 PendingVariableListType &PendingVariables) {
 
   // 1: build a `GenericGraph` over the GHAST, representing the visibility
@@ -371,54 +223,30 @@ ASTVarDeclMap computeVarDeclMap(const ASTTree &GHAST,
 
   // 3: pre-compute, for each variable, all the `ASTNode`s that contain an use
   // of the variable
-  auto VariableUsages = computeVariableUsages(GHAST, PendingVariables);
+  auto VariableUsages = computeVariableUsages(Index, PendingVariables);
 
   // 4: perform the `Variable` assignment operation.
-  // We want to iterate over the nodes of the newly created `GenericGraph`in
-  // post order.
+  // The declaration of each `Variable` goes in the nearest common dominator
+  // of all the `ASTNode`s using it. This is the first node dominating all of
+  // them that a post order visit of the graph would encounter.
   ASTVarDeclMap Result;
-  for (auto *TheNode : llvm::post_order(&ScopeReachabilityGraph.Graph)) {
-
-    // At each iteration, iterate over the list of variables that are still to
-    // assign
-    for (const llvm::CallInst *&Pending : PendingVariables) {
-
-      // We use a `nullptr` in `PendingVariables` as a tombstone to mark the
-      // fact that the variable has already been assigned
-      if (not Pending) {
-        continue;
-      }
-
-      const llvm::SmallSet<const ASTNode *, 4> &UsageASTNodes = VariableUsages
-                                                                  .at(Pending);
-
-      // If, from the current node, we dominate all the `ASTNode`s in
-      // `UsageASTNodes`, we can mark the variable to be emitted in the current
-      // `ASTNode`
-      const auto TheNodeDominatesASTUse = [&](const ASTNode *UsageASTNode) {
-        Node *UsageGraphNode = ScopeReachabilityGraph.ASTToNodeMap
-                                 .at(UsageASTNode);
-        return DT.dominates(TheNode, UsageGraphNode);
-      };
-      bool AllUsesDominated = llvm::all_of(UsageASTNodes,
-                                           TheNodeDominatesASTUse);
-
-      // If we the current TheNode dominates all the uses of the `Variable`,
-      // we mark the current node as the place where to emit the variable
-      // declaration
-      if (AllUsesDominated) {
-        Result[TheNode->getASTNode()].insert(Pending);
-        Pending = nullptr;
-      }
+  for (const llvm::CallInst *Pending : PendingVariables) {
+    const llvm::SmallSet<const ASTNode *, 4> &UsageASTNodes = VariableUsages
+                                                                .at(Pending);
+
+    Node *Dominator = nullptr;
+    for (const ASTNode *UsageASTNode : UsageASTNodes) {
+      Node *UsageGraphNode = ScopeReachabilityGraph.ASTToNodeMap
+                               .at(UsageASTNode);
+      if (Dominator == nullptr)
+        Dominator = UsageGraphNode;
+      else
+        Dominator = DT.findNearestCommonDominator(Dominator, UsageGraphNode);
     }
-  }
 
-  // At the end of the processing, we should have assigned all the pending
-  // variables
-  const auto IsNullPtr = [](const llvm::CallInst *Variable) {
-    return not Variable;
-  };
-  revng_assert(llvm::all_of(PendingVariables, IsNullPtr));
+    revng_assert(Dominator != nullptr);
+    Result[Dominator->getASTNode()].insert(Pending);
+  }
 
   return Result;
 }
@@ -11,6 +11,7 @@
 
 class ASTTree;
 class ASTNode;
+class GHASTBBIndex;
 namespace llvm {
 class CallInst;
 }
@@ -22,4 +23,5 @@ using PendingVariableListType = llvm::SmallVector<const llvm::CallInst *>;
 
 extern ASTVarDeclMap
 computeVarDeclMap(const ASTTree &GHAST,
+                  const GHASTBBIndex &Index,
                   PendingVariableListType &PendingVariables);
@@ -0,0 +1,104 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Debug.h"
+
+#include "DecompileCacheDirectory.h"
+
+static Logger<> Log{ "decompile-cache-directory" };
+
+/// Bump this every time the backend changes the C code it emits, so that stale
+/// entries are not picked up.
+static constexpr unsigned CacheFormatVersion = 2;
+
+DecompileCacheDirectory::DecompileCacheDirectory(llvm::StringRef Directory,
+                                                 uint64_t OptionsHash) :
+  Directory(Directory.str()), OptionsHash(OptionsHash) {
+  if (std::error_code EC = llvm::sys::fs::create_directories(Directory)) {
+    revng_log(Log,
+              "Cannot create " << Directory << ", not caching: "
+                               << EC.message());
+    Usable = false;
+  }
+}
+
+std::string DecompileCacheDirectory::getPath(uint64_t IRHash,
+                                             uint64_t ModelHash) const {
+  std::string FileName;
+  {
+    llvm::raw_string_ostream OS(FileName);
+    OS << "v" << CacheFormatVersion << "-"
+       << llvm::format_hex_no_prefix(OptionsHash, 16) << "-"
+       << llvm::format_hex_no_prefix(IRHash, 16) << "-"
+       << llvm::format_hex_no_prefix(ModelHash, 16) << ".c.ptml";
+  }
+
+  llvm::SmallString<128> Path(Directory);
+  llvm::sys::path::append(Path, FileName);
+  return Path.str().str();
+}
+
+std::optional<std::string>
+DecompileCacheDirectory::lookup(uint64_t IRHash, uint64_t ModelHash) const {
+  if (not Usable)
+    return std::nullopt;
+
+  std::string Path = getPath(IRHash, ModelHash);
+  auto MaybeBuffer = llvm::MemoryBuffer::getFile(Path);
+  if (not MaybeBuffer) {
+    std::error_code EC = MaybeBuffer.getError();
+    if (EC != std::errc::no_such_file_or_directory)
+      revng_log(Log, "Cannot read " << Path << ": " << EC.message());
+    return std::nullopt;
+  }
+
+  return MaybeBuffer.get()->getBuffer().str();
+}
+
+void DecompileCacheDirectory::store(uint64_t IRHash,
+                                    uint64_t ModelHash,
+                                    llvm::StringRef CCode) const {
+  if (not Usable)
+    return;
+
+  std::string Path = getPath(IRHash, ModelHash);
+
+  // Write to a temporary file and then rename it, so that concurrent users of
+  // the same directory never observe a partially written entry.
+  llvm::SmallString<128> TemporaryPath;
+  int FD = -1;
+  std::error_code EC = llvm::sys::fs::createUniqueFile(Path + ".%%%%%%.tmp",
+                                                       FD,
+                                                       TemporaryPath);
+  if (EC) {
+    revng_log(Log, "Cannot create a file for " << Path << ": " << EC.message());
+    return;
+  }
+
+  {
+    llvm::raw_fd_ostream OS(FD, /* shouldClose */ true);
+    OS << CCode;
+    OS.flush();
+    // raw_fd_ostream aborts on destruction if the error is not cleared
+    if (OS.has_error()) {
+      EC = OS.error();
+      OS.clear_error();
+    }
+  }
+
+  if (not EC)
+    EC = llvm::sys::fs::rename(TemporaryPath, Path);
+
+  if (EC) {
+    revng_log(Log, "Cannot store " << Path << ": " << EC.message());
+    llvm::sys::fs::remove(TemporaryPath);
+  }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "llvm/ADT/StringRef.h"
+
+/// Content-addressed store of the C code emitted for functions, persisted on
+/// disk. Entries are addressed by the fingerprints of the IR of a function, of
+/// the parts of the model it depends on and of the decompilation options, so
+/// they never need to be invalidated: a change in any input simply leads to a
+/// different address.
+///
+/// The cache is best-effort: I/O errors are logged, and lead to the C code
+/// being computed again rather than to a failure.
+class DecompileCacheDirectory {
+private:
+  std::string Directory;
+  uint64_t OptionsHash = 0;
+  bool Usable = true;
+
+public:
+  /// \param OptionsHash a hash of the command line options affecting the C
+  ///        code emitted for functions.
+  DecompileCacheDirectory(llvm::StringRef Directory, uint64_t OptionsHash);
+
+public:
+  std::optional<std::string> lookup(uint64_t IRHash, uint64_t ModelHash) const;
+
+  void store(uint64_t IRHash, uint64_t ModelHash, llvm::StringRef CCode) const;
+
+private:
+  std::string getPath(uint64_t IRHash, uint64_t ModelHash) const;
+};
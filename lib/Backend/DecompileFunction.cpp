@@ -2,11 +2,22 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
 #include <utility>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Twine.h"
@@ -14,6 +25,7 @@
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalVariable.h"
@@ -24,8 +36,11 @@
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Value.h"
 #include "llvm/Support/Casting.h"
-#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
 #include "llvm/Support/Progress.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/YAMLTraits.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -57,20 +72,27 @@
 #include "revng-c/InitModelTypes/InitModelTypes.h"
 #include "revng-c/Pipes/Ranks.h"
 #include "revng-c/RestructureCFG/ASTNode.h"
-#include "revng-c/RestructureCFG/ASTNodeUtils.h"
 #include "revng-c/RestructureCFG/ASTTree.h"
 #include "revng-c/RestructureCFG/BeautifyGHAST.h"
+#include "revng-c/RestructureCFG/GHASTBBIndex.h"
 #include "revng-c/RestructureCFG/RestructureCFG.h"
 #include "revng-c/Support/DecompilationHelpers.h"
 #include "revng-c/Support/FunctionTags.h"
 #include "revng-c/Support/IRHelpers.h"
+#include "revng-c/Support/IntegerFormatting.h"
+#include "revng-c/Support/IsolatedFunctionsIndex.h"
 #include "revng-c/Support/ModelHelpers.h"
 #include "revng-c/Support/PTMLC.h"
+#include "revng-c/Support/Trace.h"
 #include "revng-c/TypeNames/LLVMTypeNames.h"
 #include "revng-c/TypeNames/ModelToPTMLTypeHelpers.h"
 #include "revng-c/TypeNames/ModelTypeNames.h"
 
 #include "ALAPVariableDeclaration.h"
+#include "DecompileCacheDirectory.h"
+#include "FunctionFingerprint.h"
+#include "RestructuredGHAST.h"
+#include "TokenPool.h"
 
 using llvm::cast;
 using llvm::dyn_cast;
@@ -97,15 +119,74 @@ namespace tokens = ptml::c::tokens;
 using tokenDefinition::types::StringToken;
 
 using TokenMapT = std::map<const llvm::Value *, std::string>;
-using ModelTypesMap = std::map<const llvm::Value *, const model::QualifiedType>;
 using InlineableTypesMap = std::unordered_map<const model::Function *,
                                               std::set<const model::Type *>>;
 
 static constexpr const char *StackFrameVarName = "_stack";
 
+/// What the callee of a call is, as far as emitting the call is concerned
+enum class CalleeKind : uint8_t {
+  CustomOpcode,
+  NonIsolated,
+  Other,
+};
+
+/// Tokens that only depend on the model, which are interned and shared by all
+/// the functions emitted by a thread while decompiling a model.
+struct ModelTokenCache {
+  TokenPool Pool;
+
+  /// The parenthesized name of each type casts are emitted to
+  std::map<model::QualifiedType, TokenPool::Handle> CastPrefixes;
+
+  /// The reference to each field of a struct or union, by type and index
+  std::map<std::pair<const model::Type *, uint64_t>, TokenPool::Handle>
+    FieldReferences;
+
+  /// The reference emitted at call sites for each isolated and dynamic
+  /// function, by model::Function or model::DynamicFunction
+  llvm::DenseMap<const void *, TokenPool::Handle> CalleeReferences;
+
+  /// The reference to the segment of each SegmentRef function, so that its
+  /// metadata is decoded and the segment is looked up only once
+  llvm::DenseMap<const llvm::Function *, TokenPool::Handle> SegmentReferences;
+
+  /// The reference emitted at call sites for each helper function, which
+  /// would otherwise be sanitized and serialized again at each call
+  llvm::DenseMap<const llvm::Function *, TokenPool::Handle> HelperReferences;
+
+  /// The reference to each field of the struct returned by a helper, by
+  /// helper and index
+  llvm::DenseMap<std::pair<const llvm::Function *, uint64_t>,
+                 TokenPool::Handle>
+    HelperFieldReferences;
+
+  /// The kind of each callee, so that its tags are parsed once and not at
+  /// each call site
+  llvm::DenseMap<const llvm::Function *, CalleeKind> CalleeKinds;
+
+  /// The types returned by the calls to each prototype, see initModelTypes
+  PrototypeReturnTypesMap ReturnTypes;
+
+  void clear() {
+    ReturnTypes.clear();
+    CalleeKinds.clear();
+    SegmentReferences.clear();
+    HelperFieldReferences.clear();
+    HelperReferences.clear();
+    CalleeReferences.clear();
+    FieldReferences.clear();
+    CastPrefixes.clear();
+    Pool.clear();
+  }
+};
+
 static Logger<> Log{ "c-backend" };
 static Logger<> VisitLog{ "c-backend-visit-order" };
 
+static trace::Counter ReusedFunctions("c-backend", "reused functions");
+static trace::Counter ReusedGHASTs("c-backend", "reused GHASTs");
+
 static bool isStackFrameDecl(const llvm::Value *I) {
   auto *Call = dyn_cast_or_null<llvm::CallInst>(I);
   if (not Call)
@@ -118,22 +199,35 @@ static bool isStackFrameDecl(const llvm::Value *I) {
   return Callee->getName().startswith("revng_stack_frame");
 }
 
-static bool isCallToCustomOpcode(const llvm::Instruction *I) {
-  return isCallToTagged(I, FunctionTags::Copy)
-         or isCallToTagged(I, FunctionTags::Assign)
-         or isCallToTagged(I, FunctionTags::ModelCast)
-         or isCallToTagged(I, FunctionTags::ModelGEP)
-         or isCallToTagged(I, FunctionTags::ModelGEPRef)
-         or isCallToTagged(I, FunctionTags::AddressOf)
-         or isCallToTagged(I, FunctionTags::Parentheses)
-         or isCallToTagged(I, FunctionTags::OpaqueCSVValue)
-         or isCallToTagged(I, FunctionTags::OpaqueExtractValue)
-         or isCallToTagged(I, FunctionTags::StructInitializer)
-         or isCallToTagged(I, FunctionTags::SegmentRef)
-         or isCallToTagged(I, FunctionTags::UnaryMinus)
-         or isCallToTagged(I, FunctionTags::BinaryNot)
-         or isCallToTagged(I, FunctionTags::BooleanNot)
-         or isCallToTagged(I, FunctionTags::StringLiteral);
+static bool isCustomOpcode(const llvm::Function *Callee) {
+  return FunctionTags::Copy.isTagOf(Callee)
+         or FunctionTags::Assign.isTagOf(Callee)
+         or FunctionTags::ModelCast.isTagOf(Callee)
+         or FunctionTags::ModelGEP.isTagOf(Callee)
+         or FunctionTags::ModelGEPRef.isTagOf(Callee)
+         or FunctionTags::AddressOf.isTagOf(Callee)
+         or FunctionTags::Parentheses.isTagOf(Callee)
+         or FunctionTags::OpaqueCSVValue.isTagOf(Callee)
+         or FunctionTags::OpaqueExtractValue.isTagOf(Callee)
+         or FunctionTags::StructInitializer.isTagOf(Callee)
+         or FunctionTags::SegmentRef.isTagOf(Callee)
+         or FunctionTags::UnaryMinus.isTagOf(Callee)
+         or FunctionTags::BinaryNot.isTagOf(Callee)
+         or FunctionTags::BooleanNot.isTagOf(Callee)
+         or FunctionTags::StringLiteral.isTagOf(Callee);
+}
+
+/// Same as isCustomOpcode and isCallToNonIsolated, on the callee
+static CalleeKind classifyCallee(const llvm::Function *Callee) {
+  if (isCustomOpcode(Callee))
+    return CalleeKind::CustomOpcode;
+
+  if (Callee->isIntrinsic() or FunctionTags::QEMU.isTagOf(Callee)
+      or FunctionTags::Helper.isTagOf(Callee)
+      or FunctionTags::Exceptional.isTagOf(Callee))
+    return CalleeKind::NonIsolated;
+
+  return CalleeKind::Other;
 }
 
 static bool isCConstant(const llvm::Value *V) {
@@ -142,7 +236,12 @@ static bool isCConstant(const llvm::Value *V) {
 }
 
 static std::string addAlwaysParentheses(llvm::StringRef Expr) {
-  return std::string("(") + Expr.str() + ")";
+  std::string Result;
+  Result.reserve(Expr.size() + 2);
+  Result += '(';
+  Result += Expr;
+  Result += ')';
+  return Result;
 }
 
 static std::string get128BitIntegerHexConstant(llvm::APInt Value,
@@ -169,14 +268,15 @@ static std::string get128BitIntegerHexConstant(llvm::APInt Value,
 
   std::string CompositeConstant = Cast + " ";
 
-  if (not HighBits.isZero()) {
-    StringToken HighBitsString;
-    HighBits.toString(HighBitsString,
-                      /*radix=*/16,
-                      /*signed=*/false,
-                      /*formatAsCLiteral=*/true);
+  // Same as APInt::toString, with the C prefix and uppercase digits
+  const auto FormatHalf = [](const llvm::APInt &Half) {
+    return FormattedInteger::hex(Half.getZExtValue(),
+                                 /*WithPrefix=*/true,
+                                 /*Uppercase=*/true);
+  };
 
-    auto HighConst = B.getConstantTag(HighBitsString) + " "
+  if (not HighBits.isZero()) {
+    auto HighConst = B.getConstantTag(FormatHalf(HighBits)) + " "
                      + B.getOperator(PTMLOperator::LShift) + " "
                      + B.getNumber(64);
 
@@ -186,26 +286,18 @@ static std::string get128BitIntegerHexConstant(llvm::APInt Value,
   if (NeedsOr)
     CompositeConstant += " " + B.getOperator(PTMLOperator::Or) + " ";
 
-  if (not LowBits.isZero()) {
-    StringToken LowBitsString;
-    LowBits.toString(LowBitsString,
-                     /*radix=*/16,
-                     /*signed=*/false,
-                     /*formatAsCLiteral=*/true);
-    CompositeConstant += B.getConstantTag(LowBitsString).serialize();
-  }
+  if (not LowBits.isZero())
+    CompositeConstant += B.getConstantTag(FormatHalf(LowBits)).serialize();
   return addAlwaysParentheses(CompositeConstant);
 }
 
 static std::string hexLiteral(const llvm::ConstantInt *Int,
                               const ptml::PTMLCBuilder &B,
                               const model::Binary &Model) {
-  StringToken Formatted;
   if (Int->getBitWidth() <= 64) {
-    Int->getValue().toString(Formatted,
-                             /*radix*/ 16,
-                             /*signed*/ false,
-                             /*formatAsCLiteral*/ true);
+    auto Formatted = FormattedInteger::hex(Int->getZExtValue(),
+                                           /*WithPrefix=*/true,
+                                           /*Uppercase=*/true);
     return Formatted.str().str();
   }
   return get128BitIntegerHexConstant(Int->getValue(), B, Model);
@@ -216,18 +308,21 @@ static std::string charLiteral(const llvm::ConstantInt *Int) {
   const auto LimitedValue = Int->getLimitedValue(0xffu);
   const auto CharValue = static_cast<char>(LimitedValue);
 
-  std::string EscapedC;
-  llvm::raw_string_ostream EscapeCStream(EscapedC);
-  EscapeCStream.write_escaped(std::string(&CharValue, 1));
+  llvm::SmallString<8> EscapedC;
+  llvm::raw_svector_ostream EscapeCStream(EscapedC);
+  EscapeCStream.write_escaped(llvm::StringRef(&CharValue, 1));
 
-  std::string EscapedHTML;
-  llvm::raw_string_ostream EscapeHTMLStream(EscapedHTML);
+  std::string Result;
+  Result.reserve(EscapedC.size() + 8);
+  llvm::raw_string_ostream EscapeHTMLStream(Result);
+  EscapeHTMLStream << '\'';
   llvm::printHTMLEscaped(EscapedC, EscapeHTMLStream);
-
-  return llvm::formatv("'{0}'", EscapeHTMLStream.str());
+  EscapeHTMLStream << '\'';
+  EscapeHTMLStream.flush();
+  return Result;
 }
 
-static std::string boolLiteral(const llvm::ConstantInt *Int) {
+static llvm::StringRef boolLiteral(const llvm::ConstantInt *Int) {
   revng_assert(Int->getBitWidth() == 1);
   if (Int->isZero()) {
     return "false";
@@ -268,6 +363,9 @@ private:
 
   FunctionMetadataCache &Cache;
 
+  /// Interned tokens reused across functions
+  ModelTokenCache &Tokens;
+
 private:
   class VarNameGenerator {
   private:
@@ -287,11 +385,21 @@ private:
   VarNameGenerator NameGenerator;
 
   /// Keep track of the names associated with function arguments, and local
-  /// variables. In the past it also kept track of intermediate expressions, but
-  /// with the new design all the tokens corresponding to instructions that
-  /// don't represent local variables are recomputed every time.
+  /// variables.
   TokenMapT TokenMap;
 
+  /// The expressions of the instructions that don't represent local variables,
+  /// computed on first use. They only depend on the names in TokenMap, so they
+  /// are dropped whenever a local variable is renamed.
+  mutable llvm::DenseMap<const llvm::Instruction *, std::string>
+    ExpressionTokens;
+
+  /// The opening and the closing tag of the span carrying each debug location,
+  /// serialized the first time the location is emitted
+  mutable llvm::DenseMap<const llvm::DIScope *,
+                         std::pair<std::string, std::string>>
+    DebugInfoSpans;
+
 private:
   /// Name of the local variable used to break out from loops
   std::string LoopStateVar;
@@ -308,7 +416,8 @@ public:
                  const ASTTree &GHAST,
                  const ASTVarDeclMap &VarToDeclare,
                  raw_ostream &Out,
-                 ptml::PTMLCBuilder &B) :
+                 ptml::PTMLCBuilder &B,
+                 ModelTokenCache &Tokens) :
     Model(Model),
     LLVMFunction(LLVMFunction),
     ModelFunction(*llvmToModelFunction(Model, LLVMFunction)),
@@ -319,11 +428,13 @@ public:
                            LLVMFunction,
                            &ModelFunction,
                            Model,
-                           /*PointersOnly=*/false)),
+                           /*PointersOnly=*/false,
+                           Tokens.ReturnTypes)),
     Out(Out, DecompiledCCodeIndentation),
     B(B),
     SwitchStateVars(),
-    Cache(Cache) {
+    Cache(Cache),
+    Tokens(Tokens) {
     // TODO: don't use a global loop state variable
     static const char *LoopStateVarName = "_loop_state_var";
     LoopStateVar = getVariableLocationReference(LoopStateVarName,
@@ -337,7 +448,32 @@ public:
       IsOperatorPrecedenceResolutionPassEnabled = true;
   }
 
-  void emitFunction(bool NeedsLocalStateVar, InlineableTypesMap &StackTypes);
+  void emitFunction(bool NeedsLocalStateVar,
+                    const InlineableTypesMap &StackTypes);
+
+  /// Emit the function as a flat list of labeled basic blocks connected by
+  /// gotos, without looking at the GHAST. This is used for functions that
+  /// exceed the decompilation budget, and \a Reason is reported in a comment
+  /// at the top of the body.
+  void emitUnstructuredFunction(const InlineableTypesMap &StackTypes,
+                                llvm::StringRef Reason);
+
+private:
+  /// Emit the prototype of the function, followed by its body, which starts
+  /// with the declaration of the stack frame and continues with \a EmitBody.
+  void emitFunctionSkeleton(const InlineableTypesMap &StackTypes,
+                            llvm::function_ref<void()> EmitBody);
+
+  /// Emit the declaration of the local variable created by \a VarDeclCall
+  void emitLocalVarDeclaration(const llvm::CallInst *VarDeclCall);
+
+  /// Emit the terminator of \a BB as a (possibly conditional) goto to the
+  /// labels in \a Labels. \a Next is the block emitted right after \a BB, if
+  /// any, which can be reached by falling through.
+  void emitGotoTerminator(const BasicBlock *BB,
+                          const BasicBlock *Next,
+                          const std::map<const BasicBlock *, std::string>
+                            &Labels);
 
 private:
   /// Visit a GHAST node and all its children recursively, emitting BBs
@@ -351,6 +487,12 @@ private:
   RecursiveCoroutine<std::string> buildGHASTCondition(const ExprNode *E,
                                                       bool EmitBB);
 
+  /// Append the condition of \p E to \p Result, so that the subexpressions
+  /// are written in place instead of being copied at each level of nesting.
+  RecursiveCoroutine<void> appendGHASTCondition(std::string &Result,
+                                                const ExprNode *E,
+                                                bool EmitBB);
+
   RecursiveCoroutine<std::string>
   makeLoopCondition(const IfNode *LoopCondition) {
     revng_assert(LoopCondition);
@@ -366,6 +508,18 @@ private:
   void emitBasicBlock(const BasicBlock *BB, bool EmitReturn);
 
 private:
+  /// Classify the callee of \p Call, looking its tags up only the first time
+  CalleeKind getCalleeKind(const llvm::CallInst *Call) const {
+    const llvm::Function *Callee = Call->getCalledFunction();
+    if (Callee == nullptr)
+      return CalleeKind::Other;
+
+    auto [It, New] = Tokens.CalleeKinds.try_emplace(Callee);
+    if (New)
+      It->second = classifyCallee(Callee);
+    return It->second;
+  }
+
   RecursiveCoroutine<std::string> getToken(const llvm::Value *V) const;
 
   RecursiveCoroutine<std::string>
@@ -397,6 +551,99 @@ private:
 
   std::string buildAddressExpr(llvm::StringRef Expr) const;
 
+  /// Return the parenthesized name of \a DestType, interned
+  llvm::StringRef getCastPrefix(const model::QualifiedType &DestType) const;
+
+  /// Wrap \p Str in a span carrying the debug location of \p I, if \p I is
+  /// the last instruction with that location in its basic block
+  std::string addDebugInfo(const llvm::Instruction *I, std::string Str) const;
+
+  /// Return the reference to field \a Index of the struct or union \a Parent,
+  /// interned
+  template<typename ParentT, typename FieldT>
+  llvm::StringRef getFieldReference(const ParentT &Parent,
+                                    const FieldT &Field,
+                                    uint64_t Index) const {
+    auto Key = std::make_pair(static_cast<const model::Type *>(&Parent),
+                              Index);
+    auto It = Tokens.FieldReferences.find(Key);
+    if (It == Tokens.FieldReferences.end()) {
+      std::string Reference = B.getLocationReference(Parent, Field);
+      It = Tokens.FieldReferences.emplace(Key, Tokens.Pool.intern(Reference))
+             .first;
+    }
+    return Tokens.Pool.get(It->second);
+  }
+
+  /// Return the reference to the isolated or dynamic function \a Callee used
+  /// at call sites, interned
+  template<typename CalleeT, typename RankT>
+  llvm::StringRef getCalleeReference(const CalleeT &Callee,
+                                     const RankT &Rank) const {
+    auto It = Tokens.CalleeReferences.find(&Callee);
+    if (It == Tokens.CalleeReferences.end()) {
+      std::string Location = serializedLocation(Rank, Callee.key());
+      std::string Reference = B.getTag(ptml::tags::Span, Callee.name().str())
+                                .addAttribute(attributes::Token,
+                                              tokens::Function)
+                                .addAttribute(attributes::ActionContextLocation,
+                                              Location)
+                                .addAttribute(attributes::LocationReferences,
+                                              Location)
+                                .serialize();
+      It = Tokens.CalleeReferences
+             .try_emplace(&Callee, Tokens.Pool.intern(Reference))
+             .first;
+    }
+    return Tokens.Pool.get(It->second);
+  }
+
+  /// Return the reference to the helper function \a Helper used at call
+  /// sites, interned
+  llvm::StringRef getHelperReference(const llvm::Function *Helper) const {
+    auto It = Tokens.HelperReferences.find(Helper);
+    if (It == Tokens.HelperReferences.end()) {
+      std::string Reference = getHelperFunctionLocationReference(Helper, B);
+      It = Tokens.HelperReferences
+             .try_emplace(Helper, Tokens.Pool.intern(Reference))
+             .first;
+    }
+    return Tokens.Pool.get(It->second);
+  }
+
+  /// Return the reference to the \a Index-th field of the struct returned by
+  /// the helper function \a Helper, interned
+  llvm::StringRef getHelperFieldReference(const llvm::Function *Helper,
+                                          uint64_t Index) const {
+    auto Key = std::make_pair(Helper, Index);
+    auto It = Tokens.HelperFieldReferences.find(Key);
+    if (It == Tokens.HelperFieldReferences.end()) {
+      std::string Reference = getReturnStructFieldLocationReference(Helper,
+                                                                    Index,
+                                                                    B);
+      It = Tokens.HelperFieldReferences
+             .try_emplace(Key, Tokens.Pool.intern(Reference))
+             .first;
+    }
+    return Tokens.Pool.get(It->second);
+  }
+
+  /// Return the reference to the segment accessed by the SegmentRef function
+  /// \a SegmentRef, interned
+  llvm::StringRef getSegmentReference(const llvm::Function *SegmentRef) const {
+    auto It = Tokens.SegmentReferences.find(SegmentRef);
+    if (It == Tokens.SegmentReferences.end()) {
+      const auto &[StartAddress,
+                   VirtualSize] = extractSegmentKeyFromMetadata(*SegmentRef);
+      const auto &Segment = Model.Segments().at({ StartAddress, VirtualSize });
+      std::string Reference = B.getLocationReference(Segment);
+      It = Tokens.SegmentReferences
+             .try_emplace(SegmentRef, Tokens.Pool.intern(Reference))
+             .first;
+    }
+    return Tokens.Pool.get(It->second);
+  }
+
   /// Return a C string that represents a cast of \a ExprToCast to a given
   /// \a DestType. If no casting is needed between the two expression, the
   /// original expression is returned.
@@ -419,8 +666,13 @@ private:
                  or isCallStackArgumentDecl(I));
     std::string VarName = NameGenerator.nextVarName();
     // This may override the entry for I, if I belongs to a "duplicated"
-    // BasicBlock that is reachable from many paths on the GHAST.
-    TokenMap[I] = getVariableLocationReference(VarName, ModelFunction, B);
+    // BasicBlock that is reachable from many paths on the GHAST. In that case
+    // the expressions computed so far might refer to the old name.
+    std::string Reference = getVariableLocationReference(VarName,
+                                                         ModelFunction,
+                                                         B);
+    if (not TokenMap.insert_or_assign(I, std::move(Reference)).second)
+      ExpressionTokens.clear();
     return getVariableLocationDefinition(VarName, ModelFunction, B);
   }
 
@@ -439,14 +691,43 @@ std::string CCodeGenerator::addParentheses(llvm::StringRef Expr) const {
   return addAlwaysParentheses(Expr);
 }
 
+/// Build `<Operator>(<Expr>)` in a single allocation
+static std::string prefixWithOperator(std::string &&Operator,
+                                      llvm::StringRef Expr,
+                                      bool Parentheses) {
+  Operator.reserve(Operator.size() + Expr.size() + 2);
+  if (Parentheses)
+    Operator += '(';
+  Operator += Expr;
+  if (Parentheses)
+    Operator += ')';
+  return std::move(Operator);
+}
+
 std::string CCodeGenerator::buildDerefExpr(llvm::StringRef Expr) const {
   using PTMLOperator = ptml::PTMLCBuilder::Operator;
-  return B.getOperator(PTMLOperator::PointerDereference) + addParentheses(Expr);
+  return prefixWithOperator(B.getOperator(PTMLOperator::PointerDereference)
+                              .serialize(),
+                            Expr,
+                            not IsOperatorPrecedenceResolutionPassEnabled);
 }
 
 std::string CCodeGenerator::buildAddressExpr(llvm::StringRef Expr) const {
-  return B.getOperator(ptml::PTMLCBuilder::Operator::AddressOf)
-         + addParentheses(Expr);
+  using PTMLOperator = ptml::PTMLCBuilder::Operator;
+  return prefixWithOperator(B.getOperator(PTMLOperator::AddressOf).serialize(),
+                            Expr,
+                            not IsOperatorPrecedenceResolutionPassEnabled);
+}
+
+llvm::StringRef
+CCodeGenerator::getCastPrefix(const model::QualifiedType &DestType) const {
+  auto It = Tokens.CastPrefixes.find(DestType);
+  if (It == Tokens.CastPrefixes.end()) {
+    std::string Prefix = addAlwaysParentheses(getTypeName(DestType, B));
+    It = Tokens.CastPrefixes.emplace(DestType, Tokens.Pool.intern(Prefix))
+           .first;
+  }
+  return Tokens.Pool.get(It->second);
 }
 
 std::string
@@ -460,8 +741,17 @@ CCodeGenerator::buildCastExpr(StringRef ExprToCast,
   revng_assert((SrcType.isScalar() or SrcType.isPointer())
                and (DestType.isScalar() or DestType.isPointer()));
 
-  return addAlwaysParentheses(getTypeName(DestType, B)) + " "
-         + addParentheses(ExprToCast);
+  std::string Result = getCastPrefix(DestType).str();
+  Result.reserve(Result.size() + ExprToCast.size() + 3);
+  Result += ' ';
+  if (IsOperatorPrecedenceResolutionPassEnabled) {
+    Result += ExprToCast;
+  } else {
+    Result += '(';
+    Result += ExprToCast;
+    Result += ')';
+  }
+  return Result;
 }
 
 static std::string getUndefToken(model::QualifiedType UndefType,
@@ -749,12 +1039,12 @@ CCodeGenerator::getModelGEPToken(const llvm::CallInst *Call) const {
 
       if (auto *Struct = dyn_cast<model::StructType>(UnqualType)) {
         const model::StructField &Field = Struct->Fields().at(FieldIdx);
-        CurExpr += B.getLocationReference(*Struct, Field);
+        CurExpr += getFieldReference(*Struct, Field, FieldIdx);
         CurType = Struct->Fields().at(FieldIdx).Type();
 
       } else if (auto *Union = dyn_cast<model::UnionType>(UnqualType)) {
         const model::UnionField &Field = Union->Fields().at(FieldIdx);
-        CurExpr += B.getLocationReference(*Union, Field);
+        CurExpr += getFieldReference(*Union, Field, FieldIdx);
         CurType = Union->Fields().at(FieldIdx).Type();
 
       } else {
@@ -858,10 +1148,8 @@ CCodeGenerator::getCustomOpcodeToken(const llvm::CallInst *Call) const {
       // The call returning a struct is a call to a helper function.
       // It must be a direct call.
       revng_assert(Callee);
-      StructFieldRef = getReturnStructFieldLocationReference(Callee,
-                                                             Idx
-                                                               ->getZExtValue(),
-                                                             B);
+      uint64_t Index = Idx->getZExtValue();
+      StructFieldRef = getHelperFieldReference(Callee, Index).str();
     } else {
       const model::Type *CalleeType = CalleePrototype.getConst();
       auto RFT = llvm::cast<const model::RawFunctionType>(CalleeType);
@@ -874,22 +1162,15 @@ CCodeGenerator::getCustomOpcodeToken(const llvm::CallInst *Call) const {
     rc_return rc_recur getToken(AggregateOp) + "." + StructFieldRef;
   }
 
-  if (isCallToTagged(Call, FunctionTags::SegmentRef)) {
-    auto *Callee = Call->getCalledFunction();
-    const auto &[StartAddress,
-                 VirtualSize] = extractSegmentKeyFromMetadata(*Callee);
-    model::Segment Segment = Model.Segments().at({ StartAddress, VirtualSize });
-    auto Name = Segment.name();
-
-    rc_return B.getLocationReference(Segment);
-  }
+  if (isCallToTagged(Call, FunctionTags::SegmentRef))
+    rc_return getSegmentReference(Call->getCalledFunction()).str();
 
   if (isCallToTagged(Call, FunctionTags::Copy))
     rc_return rc_recur getToken(Call->getArgOperand(0));
 
   if (isCallToTagged(Call, FunctionTags::OpaqueCSVValue)) {
     auto *Callee = Call->getCalledFunction();
-    std::string HelperRef = getHelperFunctionLocationReference(Callee, B);
+    llvm::StringRef HelperRef = getHelperReference(Callee);
     rc_return rc_recur getCallToken(Call, HelperRef, /*prototype=*/nullptr);
   }
 
@@ -944,22 +1225,18 @@ CCodeGenerator::getIsolatedCallToken(const llvm::CallInst *Call) const {
 
   // Construct the callee token (can be a function name or a function
   // pointer)
-  std::string CalleeToken;
+  std::string IndirectCallee;
+  llvm::StringRef CalleeToken;
   if (not isa<llvm::Function>(Call->getCalledOperand())) {
     std::string CalledString = rc_recur getToken(Call->getCalledOperand());
-    CalleeToken = addParentheses(CalledString);
+    IndirectCallee = addParentheses(CalledString);
+    CalleeToken = IndirectCallee;
   } else {
     if (not CallEdge->DynamicFunction().empty()) {
       // Dynamic Function
       auto &DynFuncID = CallEdge->DynamicFunction();
       auto &DynamicFunc = Model.ImportedDynamicFunctions().at(DynFuncID);
-      std::string Location = serializedLocation(ranks::DynamicFunction,
-                                                DynamicFunc.key());
-      CalleeToken = B.getTag(ptml::tags::Span, DynamicFunc.name().str())
-                      .addAttribute(attributes::Token, tokens::Function)
-                      .addAttribute(attributes::ActionContextLocation, Location)
-                      .addAttribute(attributes::LocationReferences, Location)
-                      .serialize();
+      CalleeToken = getCalleeReference(DynamicFunc, ranks::DynamicFunction);
     } else {
       // Isolated function
       llvm::Function *CalledFunc = Call->getCalledFunction();
@@ -967,13 +1244,7 @@ CCodeGenerator::getIsolatedCallToken(const llvm::CallInst *Call) const {
       const model::Function *ModelFunc = llvmToModelFunction(Model,
                                                              *CalledFunc);
       revng_assert(ModelFunc);
-      std::string Location = serializedLocation(ranks::Function,
-                                                ModelFunc->key());
-      CalleeToken = B.getTag(ptml::tags::Span, ModelFunc->name().str())
-                      .addAttribute(attributes::Token, tokens::Function)
-                      .addAttribute(attributes::ActionContextLocation, Location)
-                      .addAttribute(attributes::LocationReferences, Location)
-                      .serialize();
+      CalleeToken = getCalleeReference(*ModelFunc, ranks::Function);
     }
   }
 
@@ -990,7 +1261,7 @@ CCodeGenerator::getNonIsolatedCallToken(const llvm::CallInst *Call) const {
   revng_assert(CalledFunc and CalledFunc->hasName(),
                "Special functions should all have a name");
 
-  std::string HelperRef = getHelperFunctionLocationReference(CalledFunc, B);
+  llvm::StringRef HelperRef = getHelperReference(CalledFunc);
   rc_return rc_recur getCallToken(Call, HelperRef, /*prototype=*/nullptr);
 }
 
@@ -1007,17 +1278,92 @@ static bool shouldGenerateDebugInfoAsPTML(const llvm::Instruction &I) {
   return false;
 }
 
-static std::string addDebugInfo(const llvm::Instruction *I,
-                                const std::string &Str,
-                                const ptml::PTMLCBuilder &B) {
-  if (shouldGenerateDebugInfoAsPTML(*I)) {
-    std::string Location = I->getDebugLoc()->getScope()->getName().str();
-    return B.getTag(ptml::tags::Span, Str)
-      .addAttribute(ptml::attributes::LocationReferences, Location)
-      .addAttribute(ptml::attributes::ActionContextLocation, Location)
-      .serialize();
-  }
-  return Str;
+/// Split \p Serialized, a single PTML element, into its opening tag and its
+/// closing tag, dropping what's in between, if anything.
+///
+/// The closing tag is the one matching the opening tag, found by keeping
+/// track of the elements nested in between. Quoted attribute values are
+/// skipped, so they can contain any character. If \p Serialized is not an
+/// element (i.e., it's plain text) both are empty.
+static std::pair<llvm::StringRef, llvm::StringRef>
+splitOutermostElement(llvm::StringRef Serialized) {
+  if (not Serialized.startswith("<") or Serialized.startswith("</"))
+    return {};
+
+  // Find the end of the tag starting at Start, skipping quoted values
+  const auto EndOfTag = [&Serialized](size_t Start) -> size_t {
+    char Quote = '\0';
+    for (size_t I = Start; I < Serialized.size(); ++I) {
+      char C = Serialized[I];
+      if (Quote != '\0') {
+        if (C == Quote)
+          Quote = '\0';
+      } else if (C == '"' or C == '\'') {
+        Quote = C;
+      } else if (C == '>') {
+        return I + 1;
+      }
+    }
+    return llvm::StringRef::npos;
+  };
+
+  size_t OpenEnd = EndOfTag(0);
+  revng_assert(OpenEnd != llvm::StringRef::npos);
+  llvm::StringRef Open = Serialized.take_front(OpenEnd);
+  revng_assert(not Open.endswith("/>"), "Self-closing PTML element");
+
+  unsigned Depth = 0;
+  size_t Position = OpenEnd;
+  while ((Position = Serialized.find('<', Position)) != llvm::StringRef::npos) {
+    size_t End = EndOfTag(Position);
+    revng_assert(End != llvm::StringRef::npos);
+    llvm::StringRef Tag = Serialized.slice(Position, End);
+
+    if (Tag.startswith("</")) {
+      if (Depth == 0)
+        return { Open, Tag };
+      --Depth;
+    } else if (not Tag.endswith("/>")) {
+      ++Depth;
+    }
+
+    Position = End;
+  }
+
+  revng_abort("Unterminated PTML element");
+}
+
+std::string CCodeGenerator::addDebugInfo(const llvm::Instruction *I,
+                                         std::string Str) const {
+  if (not shouldGenerateDebugInfoAsPTML(*I))
+    return Str;
+
+  const llvm::DIScope *Scope = I->getDebugLoc()->getScope();
+  auto [It, IsNew] = DebugInfoSpans.try_emplace(Scope);
+  auto &[Open, Close] = It->second;
+  if (IsNew) {
+    // Serialize an empty span and keep its opening and closing tags
+    llvm::StringRef Location = Scope->getName();
+    std::string Span = B.getTag(ptml::tags::Span, "")
+                         .addAttribute(attributes::LocationReferences,
+                                       Location)
+                         .addAttribute(attributes::ActionContextLocation,
+                                       Location)
+                         .serialize();
+    auto [OpenTag, CloseTag] = splitOutermostElement(Span);
+    Open = OpenTag.str();
+    Close = CloseTag.str();
+  }
+
+  if (Open.empty() and Close.empty())
+    return Str;
+
+  std::string Result;
+  Result.reserve(Open.size() + Str.size() + Close.size());
+  Result += Open;
+  Result += Str;
+  Result += Close;
+  return Result;
 }
 
 /// Return the string that represents the given binary operator in C
@@ -1257,17 +1603,15 @@ CCodeGenerator::getInstructionToken(const llvm::Instruction *I) const {
     // TODO: Integer promotion
     rc_return addDebugInfo(I,
                            addParentheses(Op0Token) + OperatorString
-                             + addParentheses(Op1Token),
-                           B);
+                             + addParentheses(Op1Token));
   }
 
   if (isa<llvm::CastInst>(I) or isa<llvm::FreezeInst>(I)) {
 
     const llvm::Value *Op = I->getOperand(0);
     std::string ToCast = rc_recur getToken(Op);
-    rc_return addDebugInfo(I,
-                           buildCastExpr(ToCast, TypeMap.at(Op), TypeMap.at(I)),
-                           B);
+    const model::QualifiedType &SrcType = TypeMap.at(Op);
+    rc_return addDebugInfo(I, buildCastExpr(ToCast, SrcType, TypeMap.at(I)));
   }
 
   switch (I->getOpcode()) {
@@ -1275,17 +1619,17 @@ CCodeGenerator::getInstructionToken(const llvm::Instruction *I) const {
   case llvm::Instruction::Call: {
     auto *Call = cast<llvm::CallInst>(I);
 
-    revng_assert(isCallToCustomOpcode(Call) or isCallToIsolatedFunction(Call)
-                 or isCallToNonIsolated(Call));
+    CalleeKind Kind = getCalleeKind(Call);
+    revng_assert(Kind != CalleeKind::Other or isCallToIsolatedFunction(Call));
 
-    if (isCallToCustomOpcode(Call))
-      rc_return addDebugInfo(I, rc_recur getCustomOpcodeToken(Call), B);
+    if (Kind == CalleeKind::CustomOpcode)
+      rc_return addDebugInfo(I, rc_recur getCustomOpcodeToken(Call));
 
     if (isCallToIsolatedFunction(Call))
-      rc_return addDebugInfo(I, rc_recur getIsolatedCallToken(Call), B);
+      rc_return addDebugInfo(I, rc_recur getIsolatedCallToken(Call));
 
-    if (isCallToNonIsolated(Call))
-      rc_return addDebugInfo(I, rc_recur getNonIsolatedCallToken(Call), B);
+    if (Kind == CalleeKind::NonIsolated)
+      rc_return addDebugInfo(I, rc_recur getNonIsolatedCallToken(Call));
 
     std::string Error = "Cannot get token for CallInst: " + dumpToString(Call);
     revng_abort(Error.c_str());
@@ -1302,12 +1646,12 @@ CCodeGenerator::getInstructionToken(const llvm::Instruction *I) const {
         llvm::Value *ReturnedVal = Ret->getReturnValue())
       Result += " " + rc_recur getToken(ReturnedVal);
 
-    rc_return addDebugInfo(I, Result, B);
+    rc_return addDebugInfo(I, std::move(Result));
 
   } break;
 
   case llvm::Instruction::Unreachable:
-    rc_return addDebugInfo(I, "__builtin_trap()", B);
+    rc_return addDebugInfo(I, "__builtin_trap()");
 
   case llvm::Instruction::Select: {
 
@@ -1328,8 +1672,7 @@ CCodeGenerator::getInstructionToken(const llvm::Instruction *I) const {
     rc_return addDebugInfo(I,
                            addParentheses(Condition) + " ? "
                              + addParentheses(Op1Token) + " : "
-                             + addParentheses(Op2Token),
-                           B);
+                             + addParentheses(Op2Token));
 
   } break;
 
@@ -1371,8 +1714,16 @@ CCodeGenerator::getToken(const llvm::Value *V) const {
   if (isCConstant(V))
     rc_return rc_recur getConstantToken(V);
 
-  if (auto *I = dyn_cast<llvm::Instruction>(V))
-    rc_return rc_recur getInstructionToken(I);
+  if (auto *I = dyn_cast<llvm::Instruction>(V)) {
+    auto ExpressionIt = ExpressionTokens.find(I);
+    if (ExpressionIt != ExpressionTokens.end())
+      rc_return ExpressionIt->second;
+
+    // The recursion can grow ExpressionTokens, don't keep iterators across it
+    std::string Expression = rc_recur getInstructionToken(I);
+    ExpressionTokens[I] = Expression;
+    rc_return Expression;
+  }
 
   std::string Error = "Cannot get token for llvm::Value: ";
   Error += dumpToString(V).c_str();
@@ -1461,7 +1812,9 @@ void CCodeGenerator::emitBasicBlock(const llvm::BasicBlock *BB,
       // Handle the implicit `return` emission. If the correct parameter is set,
       // avoid the emission of the `Instruction` token.
       if (not(llvm::isa<llvm::ReturnInst>(I) and not EmitReturn)) {
-        Out << getToken(&I) << ";\n";
+        std::string Statement = getToken(&I);
+        Statement += ";\n";
+        Out << Statement;
       }
     } else if (isHelperAggregateLocalVarDecl(Call)
                or isArtificialAggregateLocalVarDecl(Call)) {
@@ -1482,10 +1835,17 @@ void CCodeGenerator::emitBasicBlock(const llvm::BasicBlock *BB,
                                     getIsolatedCallToken(Call) :
                                     getToken(Call);
 
-      // Assign to the local variable
-      Out << VarName << " "
-          << B.getOperator(ptml::PTMLCBuilder::Operator::Assign) << " "
-          << std::move(RHSExpression) << ";\n";
+      // Assign to the local variable. The statement is written to `Out` in a
+      // single piece, since the indented stream is unbuffered and looks for
+      // newlines in each write on its own.
+      std::string Statement = std::move(VarName);
+      Statement += " ";
+      Statement += B.getOperator(ptml::PTMLCBuilder::Operator::Assign)
+                     .serialize();
+      Statement += " ";
+      Statement += RHSExpression;
+      Statement += ";\n";
+      Out << Statement;
     } else {
       std::string Error = "Cannot emit statement: ";
       Error += dumpToString(Call).c_str();
@@ -1502,6 +1862,15 @@ void CCodeGenerator::emitBasicBlock(const llvm::BasicBlock *BB,
 
 RecursiveCoroutine<std::string>
 CCodeGenerator::buildGHASTCondition(const ExprNode *E, bool EmitBB) {
+  std::string Result;
+  rc_recur appendGHASTCondition(Result, E, EmitBB);
+  rc_return Result;
+}
+
+RecursiveCoroutine<void>
+CCodeGenerator::appendGHASTCondition(std::string &Result,
+                                     const ExprNode *E,
+                                     bool EmitBB) {
   LoggerIndent Indent{ VisitLog };
   revng_log(VisitLog, "|__ Visiting Condition " << E);
   LoggerIndent MoreIndent{ VisitLog };
@@ -1520,9 +1889,6 @@ CCodeGenerator::buildGHASTCondition(const ExprNode *E, bool EmitBB) {
     // for the loop state variable.
     const CompareNode *Compare = cast<CompareNode>(E);
 
-    // String that will contain the serialization of the `CompareNode`
-    std::string CompareNodeString;
-
     // Decide whether to emit the LHS in the form of a pre-existing
     // `llvm::Value` or the use of the `LoopStateVar`
     switch (E->getKind()) {
@@ -1549,15 +1915,14 @@ CCodeGenerator::buildGHASTCondition(const ExprNode *E, bool EmitBB) {
       revng_assert(ConditionValue);
 
       // Emit the condition variable
-      std::string ConditionVarString = getToken(ConditionValue);
-      CompareNodeString += ConditionVarString;
+      Result += rc_recur getToken(ConditionValue);
 
     } break;
     case NodeKind::NK_LoopStateCompare: {
       revng_log(VisitLog, "(loop state compare)");
 
       // Insert the loop state variable representing string
-      CompareNodeString += LoopStateVar;
+      Result += LoopStateVar;
 
     } break;
     default: {
@@ -1576,12 +1941,12 @@ CCodeGenerator::buildGHASTCondition(const ExprNode *E, bool EmitBB) {
       using Operator = ptml::PTMLCBuilder::Operator;
       switch (Comparison) {
       case CompareNode::ComparisonKind::Comparison_Equal: {
-        auto CmpString = B.getOperator(Operator::CmpEq);
-        CompareNodeString += " " + CmpString;
+        Result += ' ';
+        Result += B.getOperator(Operator::CmpEq).serialize();
       } break;
       case CompareNode::ComparisonKind::Comparison_NotEqual: {
-        auto CmpString = B.getOperator(Operator::CmpNeq);
-        CompareNodeString += " " + CmpString;
+        Result += ' ';
+        Result += B.getOperator(Operator::CmpNeq).serialize();
       } break;
       default: {
         revng_abort();
@@ -1590,10 +1955,11 @@ CCodeGenerator::buildGHASTCondition(const ExprNode *E, bool EmitBB) {
 
       // Build the RHS comparison constant
       size_t Constant = Compare->getConstant();
-      CompareNodeString += " " + B.getNumber(Constant);
+      Result += ' ';
+      Result += B.getNumber(Constant).serialize();
     }
 
-    rc_return CompareNodeString;
+    rc_return;
 
   } break;
 
@@ -1635,10 +2001,12 @@ CCodeGenerator::buildGHASTCondition(const ExprNode *E, bool EmitBB) {
 
         const llvm::Value *Op0 = I->getOperand(0);
         std::string Op0String = rc_recur getToken(Op0);
-        rc_return addDebugInfo(I, Op0String, B);
+        Result += addDebugInfo(I, std::move(Op0String));
+        rc_return;
       }
     }
-    rc_return rc_recur getToken(Br->getCondition());
+    Result += rc_recur getToken(Br->getCondition());
+    rc_return;
   } break;
 
   case NodeKind::NK_Not: {
@@ -1646,8 +2014,11 @@ CCodeGenerator::buildGHASTCondition(const ExprNode *E, bool EmitBB) {
 
     const NotNode *N = cast<NotNode>(E);
     ExprNode *Negated = N->getNegatedNode();
-    rc_return B.getOperator(ptml::PTMLCBuilder::Operator::BoolNot)
-      + addAlwaysParentheses(rc_recur buildGHASTCondition(Negated, EmitBB));
+    Result += B.getOperator(ptml::PTMLCBuilder::Operator::BoolNot).serialize();
+    Result += '(';
+    rc_recur appendGHASTCondition(Result, Negated, EmitBB);
+    Result += ')';
+    rc_return;
   } break;
 
   case NodeKind::NK_And:
@@ -1657,14 +2028,18 @@ CCodeGenerator::buildGHASTCondition(const ExprNode *E, bool EmitBB) {
     const BinaryNode *Binary = cast<BinaryNode>(E);
 
     const auto &[Child1, Child2] = Binary->getInternalNodes();
-    std::string Child1Token = rc_recur buildGHASTCondition(Child1, EmitBB);
-    std::string Child2Token = rc_recur buildGHASTCondition(Child2, EmitBB);
     using PTMLOperator = ptml::PTMLCBuilder::Operator;
     const Tag &OpToken = E->getKind() == NodeKind::NK_And ?
                            B.getOperator(PTMLOperator::BoolAnd) :
                            B.getOperator(PTMLOperator::BoolOr);
-    rc_return addAlwaysParentheses(Child1Token) + " " + OpToken.serialize()
-      + " " + addAlwaysParentheses(Child2Token);
+    Result += '(';
+    rc_recur appendGHASTCondition(Result, Child1, EmitBB);
+    Result += ") ";
+    Result += OpToken.serialize();
+    Result += " (";
+    rc_recur appendGHASTCondition(Result, Child2, EmitBB);
+    Result += ')';
+    rc_return;
   } break;
 
   default:
@@ -1679,33 +2054,35 @@ static std::string makeWhile(const ptml::PTMLCBuilder &B,
          + CondExpr + ")";
 }
 
+void CCodeGenerator::emitLocalVarDeclaration(const CallInst *VarDeclCall) {
+  // Emit missing local variable declarations
+  if (isLocalVarDecl(VarDeclCall) or isCallStackArgumentDecl(VarDeclCall)) {
+    std::string VarName = createLocalVarDeclName(VarDeclCall);
+    revng_assert(not VarName.empty());
+    Out << getNamedCInstance(TypeMap.at(VarDeclCall), VarName, B) << ";\n";
+  } else if (isHelperAggregateLocalVarDecl(VarDeclCall)
+             or isArtificialAggregateLocalVarDecl(VarDeclCall)) {
+    // Create missing local variable declarations
+    std::string VarName = createLocalVarDeclName(VarDeclCall);
+    revng_assert(not VarName.empty());
+    const auto &Prototype = Cache.getCallSitePrototype(Model, VarDeclCall);
+    revng_assert(Prototype.isValid() and not Prototype.empty());
+    const auto *FunctionType = Prototype.getConst();
+    Out << getNamedInstanceOfReturnType(*FunctionType, VarName, B, false)
+        << ";\n";
+  } else {
+    revng_assert(not VarDeclCall->getType()->isAggregateType());
+  }
+}
+
 RecursiveCoroutine<void> CCodeGenerator::emitGHASTNode(const ASTNode *N) {
   if (N == nullptr)
     rc_return;
 
   auto VarToDeclareIt = VariablesToDeclare.find(N);
-  if (VarToDeclareIt != VariablesToDeclare.end()) {
-    for (const CallInst *VarDeclCall : VarToDeclareIt->second) {
-      // Emit missing local variable declarations
-      if (isLocalVarDecl(VarDeclCall) or isCallStackArgumentDecl(VarDeclCall)) {
-        std::string VarName = createLocalVarDeclName(VarDeclCall);
-        revng_assert(not VarName.empty());
-        Out << getNamedCInstance(TypeMap.at(VarDeclCall), VarName, B) << ";\n";
-      } else if (isHelperAggregateLocalVarDecl(VarDeclCall)
-                 or isArtificialAggregateLocalVarDecl(VarDeclCall)) {
-        // Create missing local variable declarations
-        std::string VarName = createLocalVarDeclName(VarDeclCall);
-        revng_assert(not VarName.empty());
-        const auto &Prototype = Cache.getCallSitePrototype(Model, VarDeclCall);
-        revng_assert(Prototype.isValid() and not Prototype.empty());
-        const auto *FunctionType = Prototype.getConst();
-        Out << getNamedInstanceOfReturnType(*FunctionType, VarName, B, false)
-            << ";\n";
-      } else {
-        revng_assert(not VarDeclCall->getType()->isAggregateType());
-      }
-    }
-  }
+  if (VarToDeclareIt != VariablesToDeclare.end())
+    for (const CallInst *VarDeclCall : VarToDeclareIt->second)
+      emitLocalVarDeclaration(VarDeclCall);
 
   revng_log(VisitLog, "|__ GHAST Node " << N->getID());
   LoggerIndent Indent{ VisitLog };
@@ -1933,10 +2310,13 @@ RecursiveCoroutine<void> CCodeGenerator::emitGHASTNode(const ASTNode *N) {
           if (SwitchVar) {
             llvm::Type *SwitchVarT = SwitchVar->getType();
             auto *IntType = cast<llvm::IntegerType>(SwitchVarT);
-            auto *CaseConst = llvm::ConstantInt::get(IntType, CaseVal);
+            // Build the APInt directly instead of going through
+            // llvm::ConstantInt::get, so that emission never touches the
+            // (non thread-safe) LLVMContext uniquing tables.
+            llvm::APInt CaseConst(IntType->getBitWidth(), CaseVal);
             // TODO: assigned the signedness based on the signedness of the
             // condition
-            Out << B.getNumber(CaseConst->getValue());
+            Out << B.getNumber(CaseConst);
           } else {
             Out << B.getNumber(CaseVal);
           }
@@ -2035,8 +2415,8 @@ static std::string getModelArgIdentifier(const model::Type *ModelFunctionType,
   return "";
 }
 
-void CCodeGenerator::emitFunction(bool NeedsLocalStateVar,
-                                  InlineableTypesMap &StackTypes) {
+void CCodeGenerator::emitFunctionSkeleton(const InlineableTypesMap &StackTypes,
+                                          llvm::function_ref<void()> EmitBody) {
   revng_log(Log, "========= Emitting Function " << LLVMFunction.getName());
   revng_log(VisitLog, "========= Function " << LLVMFunction.getName());
   LoggerIndent Indent{ VisitLog };
@@ -2081,7 +2461,7 @@ void CCodeGenerator::emitFunction(bool NeedsLocalStateVar,
         // This will contain the stack types that we can inline, since
         // there could be a stack type that is being used somewhere else,
         // so we do not want to inline it.
-        auto TheStackTypes = StackTypes.at(&ModelFunction);
+        const auto &TheStackTypes = StackTypes.at(&ModelFunction);
         if (TheStackTypes.contains(TheType) and !IsStackDefined) {
           IsStackDefined = true;
           std::map<model::QualifiedType, std::string> AdditionalTypeNames;
@@ -2111,6 +2491,15 @@ void CCodeGenerator::emitFunction(bool NeedsLocalStateVar,
       }
     }
 
+    EmitBody();
+  }
+
+  Out << "\n";
+}
+
+void CCodeGenerator::emitFunction(bool NeedsLocalStateVar,
+                                  const InlineableTypesMap &StackTypes) {
+  emitFunctionSkeleton(StackTypes, [this, NeedsLocalStateVar]() {
     // Emit a declaration for the loop state variable, which is used to
     // redirect control flow inside loops (e.g. if we want to jump in the
     // middle of a loop during a certain iteration)
@@ -2120,37 +2509,191 @@ void CCodeGenerator::emitFunction(bool NeedsLocalStateVar,
 
     // Recursively print the body of this function
     emitGHASTNode(GHAST.getRoot());
+  });
+}
+
+void CCodeGenerator::emitGotoTerminator(const BasicBlock *BB,
+                                        const BasicBlock *Next,
+                                        const std::map<const BasicBlock *,
+                                                       std::string> &Labels) {
+  auto Goto = [this, &Labels](const BasicBlock *Target) {
+    return B.getKeyword(ptml::PTMLCBuilder::Keyword::Goto) + " "
+           + Labels.at(Target) + ";\n";
+  };
+
+  const Instruction *Terminator = BB->getTerminator();
+  if (auto *Branch = dyn_cast<llvm::BranchInst>(Terminator)) {
+    const BasicBlock *Fallthrough = nullptr;
+    if (Branch->isConditional()) {
+      Out << B.getKeyword(ptml::PTMLCBuilder::Keyword::If) << " ("
+          << getToken(Branch->getCondition()) << ") "
+          << Goto(Branch->getSuccessor(0));
+      Fallthrough = Branch->getSuccessor(1);
+    } else {
+      Fallthrough = Branch->getSuccessor(0);
+    }
+
+    if (Fallthrough != Next)
+      Out << Goto(Fallthrough);
+
+  } else if (auto *Switch = dyn_cast<llvm::SwitchInst>(Terminator)) {
+    Out << B.getKeyword(ptml::PTMLCBuilder::Keyword::Switch) << " ("
+        << getToken(Switch->getCondition()) << ") ";
+    {
+      Scope TheScope(Out);
+      for (const auto &Case : Switch->cases()) {
+        Out << B.getKeyword(ptml::PTMLCBuilder::Keyword::Case) << " "
+            << B.getNumber(Case.getCaseValue()->getValue()) << ": "
+            << Goto(Case.getCaseSuccessor());
+      }
+      Out << B.getKeyword(ptml::PTMLCBuilder::Keyword::Default) << ": "
+          << Goto(Switch->getDefaultDest());
+    }
+    Out << "\n";
+
+  } else if (isa<llvm::UnreachableInst>(Terminator)) {
+    Out << B.getLineComment("unreachable");
+
+  } else {
+    // Returns are emitted by emitBasicBlock
+    revng_assert(isa<llvm::ReturnInst>(Terminator));
   }
+}
 
-  Out << "\n";
+void CCodeGenerator::emitUnstructuredFunction(const InlineableTypesMap
+                                                &StackTypes,
+                                              llvm::StringRef Reason) {
+  emitFunctionSkeleton(StackTypes, [this, Reason]() {
+    Out << B.getLineComment(("Decompilation budget exceeded (" + Reason
+                             + "), emitting unstructured code")
+                              .str());
+
+    // Without a GHAST there are no scopes to attach declarations to, so all
+    // the local variables are declared at the top of the function.
+    for (const Instruction &I : llvm::instructions(LLVMFunction)) {
+      auto *Call = dyn_cast<llvm::CallInst>(&I);
+      if (Call == nullptr or isStackFrameDecl(Call))
+        continue;
+
+      if (isLocalVarDecl(Call) or isCallStackArgumentDecl(Call)
+          or isArtificialAggregateLocalVarDecl(Call)
+          or isHelperAggregateLocalVarDecl(Call))
+        emitLocalVarDeclaration(Call);
+    }
+
+    std::map<const BasicBlock *, std::string> Labels;
+    for (const BasicBlock &BB : LLVMFunction)
+      Labels[&BB] = "bb_" + std::to_string(Labels.size());
+
+    for (auto It = LLVMFunction.begin(); It != LLVMFunction.end(); ++It) {
+      const BasicBlock *BB = &*It;
+      auto NextIt = std::next(It);
+      const BasicBlock *Next = NextIt != LLVMFunction.end() ? &*NextIt :
+                                                              nullptr;
+
+      if (not BB->hasNPredecessors(0))
+        Out << Labels.at(BB) << ":\n";
+
+      emitBasicBlock(BB, /* EmitReturn */ true);
+      emitGotoTerminator(BB, Next, Labels);
+    }
+  });
 }
 
+/// Scratch storage recycled across all the functions emitted by a thread.
+///
+/// Emitting into a fresh string makes it grow (and be reallocated) many times
+/// per function. Instead, we emit into a buffer that keeps the capacity reached
+/// by the largest function seen so far, and only copy out the final result.
+///
+/// The interned tokens, and the caches of the builder, refer to the model, so
+/// they are dropped whenever a new decompile() invocation starts.
+struct EmissionArena {
+  ptml::PTMLCBuilder B;
+  std::string Buffer;
+  ModelTokenCache Tokens;
+  uint64_t Generation = 0;
+
+  /// Incremented by each decompile() invocation
+  static inline std::atomic<uint64_t> CurrentGeneration = 1;
+
+  static EmissionArena &get() {
+    static thread_local EmissionArena Arena;
+    uint64_t Current = CurrentGeneration.load();
+    if (Arena.Generation != Current) {
+      Arena.Tokens.clear();
+      Arena.B.clearCaches();
+      Arena.Generation = Current;
+    }
+    return Arena;
+  }
+
+  /// \p SizeHint is the expected size of the output, reserved up front so
+  /// that the first large function emitted doesn't keep growing the buffer
+  template<typename CallableT>
+  std::string emit(CallableT &&Emit, size_t SizeHint = 0) {
+    Buffer.clear();
+    Buffer.reserve(SizeHint);
+    {
+      llvm::raw_string_ostream Out(Buffer);
+      Emit(Out, B, Tokens);
+      Out.flush();
+    }
+    return std::string(Buffer);
+  }
+};
+
 static std::string decompileFunction(FunctionMetadataCache &Cache,
                                      const llvm::Function &LLVMFunc,
                                      const ASTTree &CombedAST,
                                      const Binary &Model,
                                      const ASTVarDeclMap &VarToDeclare,
                                      bool NeedsLocalStateVar,
-                                     InlineableTypesMap &StackTypes) {
-  std::string Result;
-
-  llvm::raw_string_ostream Out(Result);
-  ptml::PTMLCBuilder B;
-
-  CCodeGenerator
-    Backend(Cache, Model, LLVMFunc, CombedAST, VarToDeclare, Out, B);
-  Backend.emitFunction(NeedsLocalStateVar, StackTypes);
-  Out.flush();
-
-  return Result;
+                                     const InlineableTypesMap &StackTypes,
+                                     size_t SizeHint) {
+  auto Emit = [&](llvm::raw_ostream &Out,
+                  ptml::PTMLCBuilder &B,
+                  ModelTokenCache &Tokens) {
+    CCodeGenerator Backend(Cache,
+                           Model,
+                           LLVMFunc,
+                           CombedAST,
+                           VarToDeclare,
+                           Out,
+                           B,
+                           Tokens);
+    Backend.emitFunction(NeedsLocalStateVar, StackTypes);
+  };
+  return EmissionArena::get().emit(Emit, SizeHint);
 }
 
-static bool hasLoopDispatchers(const ASTTree &GHAST) {
-  return needsLoopVar(GHAST.getRoot());
+static std::string
+decompileUnstructuredFunction(FunctionMetadataCache &Cache,
+                              const llvm::Function &LLVMFunc,
+                              const Binary &Model,
+                              const InlineableTypesMap &StackTypes,
+                              llvm::StringRef Reason) {
+  auto Emit = [&](llvm::raw_ostream &Out,
+                  ptml::PTMLCBuilder &B,
+                  ModelTokenCache &Tokens) {
+    ASTTree EmptyGHAST;
+    ASTVarDeclMap NoVarToDeclare;
+    CCodeGenerator Backend(Cache,
+                           Model,
+                           LLVMFunc,
+                           EmptyGHAST,
+                           NoVarToDeclare,
+                           Out,
+                           B,
+                           Tokens);
+    Backend.emitUnstructuredFunction(StackTypes, Reason);
+  };
+  return EmissionArena::get().emit(Emit);
 }
 
 static ASTVarDeclMap computeVariableDeclarationScope(const llvm::Function &F,
-                                                     const ASTTree &GHAST) {
+                                                     const ASTTree &GHAST,
+                                                     const GHASTBBIndex &Index) {
   PendingVariableListType PendingVariables;
   for (const BasicBlock &BB : F) {
     for (const Instruction &I : BB) {
@@ -2175,70 +2718,611 @@ static ASTVarDeclMap computeVariableDeclarationScope(const llvm::Function &F,
     }
   }
 
-  return computeVarDeclMap(GHAST, PendingVariables);
+  return computeVarDeclMap(GHAST, Index, PendingVariables);
+}
+
+static llvm::cl::opt<unsigned>
+  DecompileThreads("decompile-threads",
+                   llvm::cl::desc("Number of threads emitting C code for "
+                                  "isolated functions"),
+                   llvm::cl::init(1));
+
+static llvm::cl::opt<std::string>
+  DecompileCacheDir("decompile-cache-dir",
+                    llvm::cl::desc("Directory where the C code of each "
+                                   "function is cached, indexed by the hash of "
+                                   "its IR, its model dependencies and the "
+                                   "decompilation options"),
+                    llvm::cl::value_desc("directory"));
+
+static llvm::cl::opt<std::string>
+  TelemetryOutput("decompile-telemetry-output",
+                  llvm::cl::desc("CSV file where per-function decompilation "
+                                 "timings and sizes are written"),
+                  llvm::cl::value_desc("path"));
+
+static llvm::cl::opt<unsigned>
+  MaxBasicBlocks("decompile-max-basic-blocks",
+                 llvm::cl::desc("Functions with more basic blocks than this "
+                                "are not restructured, but emitted as "
+                                "unstructured code. 0 means no limit."),
+                 llvm::cl::init(0));
+
+static llvm::cl::opt<unsigned>
+  MaxGHASTNodes("decompile-max-ghast-nodes",
+                llvm::cl::desc("Functions whose restructured GHAST has more "
+                               "nodes than this are not beautified, but "
+                               "emitted as unstructured code. 0 means no "
+                               "limit."),
+                llvm::cl::init(0));
+
+static llvm::cl::opt<unsigned>
+  TimeBudget("decompile-time-budget-ms",
+             llvm::cl::desc("Functions whose restructuring takes longer than "
+                            "this (in milliseconds) are not beautified, but "
+                            "emitted as unstructured code. 0 means no limit."),
+             llvm::cl::init(0));
+
+/// Returns a description of the budget \a F exceeded before being
+/// restructured, or an empty string if it fits.
+static std::string checkBudgetBeforeRestructuring(const llvm::Function &F) {
+  if (MaxBasicBlocks != 0 and F.size() > MaxBasicBlocks)
+    return std::to_string(F.size()) + " basic blocks";
+  return "";
+}
+
+/// Returns a description of the budget a function exceeded while being
+/// restructured, or an empty string if it fits.
+static std::string
+checkBudgetAfterRestructuring(const ASTTree &GHAST,
+                              const RestructureCFGStatistics &Statistics,
+                              std::chrono::microseconds RestructureTime) {
+  using std::chrono::milliseconds;
+  if (Statistics.DuplicationCeilingExceeded)
+    return std::to_string(Statistics.Duplications) + " duplications";
+  if (MaxGHASTNodes != 0 and GHAST.size() > MaxGHASTNodes)
+    return std::to_string(GHAST.size()) + " GHAST nodes";
+  if (TimeBudget != 0 and RestructureTime > milliseconds(TimeBudget))
+    return std::to_string(RestructureTime.count() / 1000)
+           + " ms restructuring";
+  return "";
+}
+
+/// Hash of the command line options that can change the C code emitted for a
+/// function, part of the key of the on-disk cache
+static uint64_t hashDecompileOptions() {
+  return llvm::hash_combine(MaxBasicBlocks.getValue(),
+                            MaxGHASTNodes.getValue(),
+                            TimeBudget.getValue(),
+                            hashRestructureOptions());
+}
+
+/// Per-function measurements, reported through -decompile-telemetry-output.
+///
+/// This gathers in a single file what -restructure-metrics-output-dir and
+/// -short-circuit-metrics-output-dir write in a file per function.
+struct DecompileTelemetry {
+  std::chrono::microseconds RestructureTime{ 0 };
+  std::chrono::microseconds BeautifyTime{ 0 };
+  std::chrono::microseconds EmissionTime{ 0 };
+  size_t PeakGHASTNodes = 0;
+  RestructureCFGStatistics Restructuring;
+  BeautifyStatistics Beautify;
+
+  /// True if the function exceeded the budget and has been emitted as
+  /// unstructured code
+  bool Unstructured = false;
+
+  static void printHeader(llvm::raw_ostream &OS) {
+    OS << "entry,function,cached,restructure_us,beautify_us,emission_us,"
+          "peak_ghast_nodes,inflated_regioncfg_nodes,duplications,"
+          "untangle_tentatives,untangles_performed,initial_weight,"
+          "short_circuits,trivial_short_circuits,emitted_bytes,"
+          "unstructured\n";
+  }
+
+  void print(llvm::raw_ostream &OS,
+             const MetaAddress &Entry,
+             const llvm::Function &F,
+             bool IsCached,
+             size_t EmittedBytes) const {
+    OS << Entry.toString() << "," << F.getName() << "," << IsCached << ","
+       << RestructureTime.count() << "," << BeautifyTime.count() << ","
+       << EmissionTime.count() << "," << PeakGHASTNodes << ","
+       << Restructuring.InflatedNodes << "," << Restructuring.Duplications
+       << "," << Restructuring.UntangleTentatives << ","
+       << Restructuring.UntanglesPerformed << ","
+       << Restructuring.InitialWeight << "," << Beautify.ShortCircuits << ","
+       << Beautify.TrivialShortCircuits << "," << EmittedBytes << ","
+       << Unstructured << "\n";
+  }
+};
+
+template<typename CallableT>
+static std::chrono::microseconds measure(CallableT &&Callable) {
+  using namespace std::chrono;
+  auto Start = steady_clock::now();
+  Callable();
+  return duration_cast<microseconds>(steady_clock::now() - Start);
+}
+
+/// The restructured and beautified GHAST of a function, ready to be emitted
+struct PendingFunction {
+  const llvm::Function *F = nullptr;
+  MetaAddress Key;
+  ASTTree GHAST;
+  std::string CCode;
+  uint64_t IRHash = 0;
+  uint64_t ModelHash = 0;
+
+  /// True if CCode has been recovered from a previous run
+  bool IsCached = false;
+
+  /// True if CCode is emitted from GHAST, rather than recovered from a
+  /// previous run or emitted as unstructured code
+  bool HasGHAST = false;
+
+  /// See hashBeautifyModelDependencies, only computed if there's a GHAST to
+  /// compare with, or GHAST is going to be kept for the next run
+  std::optional<uint64_t> BeautifyModelHash;
+
+  /// The expected size of CCode, see estimateCCodeSize
+  size_t SizeHint = 0;
+
+  DecompileTelemetry Telemetry;
+};
+
+/// Guess how large the C code of \p F, restructured as \p GHAST, is going to
+/// be. If \p F has already been decompiled, its code is not going to change
+/// much, otherwise use the average PTML emitted for each instruction and node.
+static size_t estimateCCodeSize(const llvm::Function &F,
+                                const ASTTree &GHAST,
+                                const DecompiledFunctionsCache *Previous,
+                                const MetaAddress &Key) {
+  if (Previous != nullptr)
+    if (auto It = Previous->Entries.find(Key); It != Previous->Entries.end())
+      return It->second.CCode.size() + It->second.CCode.size() / 8;
+
+  constexpr size_t BytesPerInstruction = 128;
+  constexpr size_t BytesPerGHASTNode = 64;
+  return F.getInstructionCount() * BytesPerInstruction
+         + GHAST.size() * BytesPerGHASTNode;
+}
+
+using FunctionsToDecompile = std::vector<std::pair<MetaAddress,
+                                                   llvm::Function *>>;
+
+/// Sort \p Functions in MetaAddress order or, if \p Priority is not empty,
+/// put first the functions it lists, then the others in order of distance
+/// from them in the call graph, callers and callees alike, smaller functions
+/// first.
+static void sortByPriority(FunctionsToDecompile &Functions,
+                           llvm::ArrayRef<MetaAddress> Priority) {
+  llvm::sort(Functions, [](const auto &LHS, const auto &RHS) {
+    return LHS.first < RHS.first;
+  });
+
+  if (Priority.empty())
+    return;
+
+  std::set<MetaAddress> Targets(Priority.begin(), Priority.end());
+
+  // Breadth first visit of the call graph, starting from all the targets
+  constexpr unsigned Unreachable = std::numeric_limits<unsigned>::max();
+  llvm::DenseMap<const llvm::Function *, unsigned> Distance;
+  llvm::DenseMap<const llvm::Function *,
+                 llvm::SmallVector<const llvm::Function *, 4>>
+    Neighbors;
+  std::vector<const llvm::Function *> Queue;
+  for (const auto &[Entry, F] : Functions) {
+    Distance[F] = Unreachable;
+    if (Targets.contains(Entry)) {
+      Distance[F] = 0;
+      Queue.push_back(F);
+    }
+  }
+
+  if (Queue.empty()) {
+    revng_log(Log, "None of the priority functions is to be decompiled");
+    return;
+  }
+
+  for (const auto &[Entry, F] : Functions) {
+    for (const llvm::Instruction &I : llvm::instructions(F)) {
+      auto *Call = dyn_cast<llvm::CallInst>(&I);
+      if (Call == nullptr)
+        continue;
+
+      const llvm::Function *Callee = Call->getCalledFunction();
+      if (Callee == nullptr or Callee == F or not Distance.count(Callee))
+        continue;
+
+      Neighbors[F].push_back(Callee);
+      Neighbors[Callee].push_back(F);
+    }
+  }
+
+  for (size_t I = 0; I < Queue.size(); ++I) {
+    const llvm::Function *F = Queue[I];
+    for (const llvm::Function *Neighbor : Neighbors.lookup(F)) {
+      unsigned &NeighborDistance = Distance[Neighbor];
+      if (NeighborDistance == Unreachable) {
+        NeighborDistance = Distance[F] + 1;
+        Queue.push_back(Neighbor);
+      }
+    }
+  }
+
+  // Only the relative order matters, don't count instructions over and over
+  llvm::DenseMap<const llvm::Function *, unsigned> Size;
+  for (const auto &[Entry, F] : Functions)
+    Size[F] = F->getInstructionCount();
+
+  llvm::stable_sort(Functions, [&](const auto &LHS, const auto &RHS) {
+    return std::pair(Distance[LHS.second], Size[LHS.second])
+           < std::pair(Distance[RHS.second], Size[RHS.second]);
+  });
 }
 
 using Container = revng::pipes::DecompileStringMap;
-void decompile(FunctionMetadataCache &Cache,
-               llvm::Module &Module,
-               const model::Binary &Model,
-               Container &DecompiledFunctions) {
-  TypeInlineHelper TheTypeInlineHelper(Model);
+/// Decompile the isolated functions in \p Module whose entry is in
+/// \p Entries, or all of them if \p Entries is null, starting from the ones
+/// in \p Priority
+static void decompileImpl(FunctionMetadataCache &Cache,
+                          llvm::Module &Module,
+                          const model::Binary &Model,
+                          const std::set<MetaAddress> *Entries,
+                          llvm::ArrayRef<MetaAddress> Priority,
+                          DecompiledFunctionCallback OnDecompiled,
+                          DecompiledFunctionsCache *Previous) {
+  trace::Scope Trace("c-backend", "decompile");
+
+  // Interned tokens refer to the model, they can not outlive this invocation
+  ++EmissionArena::CurrentGeneration;
 
   // Get all Stack types and all the inlinable types reachable from it,
   // since we want to emit forward declarations for all of them.
-  auto StackTypes = TheTypeInlineHelper.findStackTypesPerFunction(Model);
+  auto TypeInlining = getTypeInliningInfo(Model);
+  const auto &StackTypes = TypeInlining->StackTypesPerFunction;
+
+  // Logging from multiple threads would interleave the output, so we fall back
+  // to serial emission whenever the backend loggers are enabled.
+  unsigned ThreadCount = DecompileThreads;
+  if (Log.isEnabled() or VisitLog.isEnabled())
+    ThreadCount = 1;
+
+  std::optional<DecompileCacheDirectory> CacheDirectory;
+  if (not DecompileCacheDir.empty())
+    CacheDirectory.emplace(DecompileCacheDir, hashDecompileOptions());
+
+  std::unique_ptr<llvm::raw_fd_ostream> TelemetryStream;
+  if (not TelemetryOutput.empty()) {
+    std::error_code EC;
+    TelemetryStream = std::make_unique<llvm::raw_fd_ostream>(TelemetryOutput,
+                                                             EC);
+    if (EC)
+      revng_abort(EC.message().c_str());
+    DecompileTelemetry::printHeader(*TelemetryStream);
+  }
+
+  // Hand out the C code, and remember it for the next run
+  auto Commit = [&OnDecompiled,
+                 &CacheDirectory,
+                 &TelemetryStream,
+                 &Model,
+                 Previous](PendingFunction &P, bool IsNew) {
+    if (TelemetryStream)
+      P.Telemetry.print(*TelemetryStream,
+                        P.Key,
+                        *P.F,
+                        not IsNew,
+                        P.CCode.size());
+    // Unstructured code depends on the budget, not only on the inputs, so it
+    // goes in neither of the caches. Drop the outdated entry, if any, too.
+    if (P.Telemetry.Unstructured) {
+      if (Previous != nullptr)
+        Previous->Entries.erase(P.Key);
+    } else if (IsNew and CacheDirectory) {
+      CacheDirectory->store(P.IRHash, P.ModelHash, P.CCode);
+    }
+    if (Previous != nullptr and not P.Telemetry.Unstructured) {
+      auto &Entry = Previous->Entries[P.Key];
+      Entry.IRHash = P.IRHash;
+      Entry.ModelHash = P.ModelHash;
+      Entry.CCode = P.CCode;
+      // Functions whose C code has been reused keep the GHAST they had
+      if (P.HasGHAST) {
+        if (not P.BeautifyModelHash)
+          P.BeautifyModelHash = hashBeautifyModelDependencies(Model, *P.F);
+        Entry.GHAST = RestructuredGHAST::capture(std::move(P.GHAST),
+                                                 *P.F,
+                                                 *P.BeautifyModelHash);
+      }
+    }
+    OnDecompiled(P.Key, std::move(P.CCode));
+  };
 
-  auto
-    T = llvm::make_task_on_set(llvm::make_address_range(FunctionTags::Isolated
-                                                          .functions(&Module)),
-                               "decompile");
+  // On lazily loaded modules, only parse the requested functions
+  if (not Module.isMaterialized()) {
+    if (Entries != nullptr) {
+      auto Index = readIsolatedFunctionsIndex(Module);
+      for (const MetaAddress &Entry : *Entries)
+        if (auto It = Index.find(Entry); It != Index.end())
+          materializeWithCallees(*It->second);
+    } else if (llvm::Error E = Module.materializeAll()) {
+      revng_abort(llvm::toString(std::move(E)).c_str());
+    }
+  }
 
+  // Unless the caller asks for some functions first, functions are decompiled
+  // in MetaAddress order, so that consumers can stream the results without
+  // having to reorder them.
+  FunctionsToDecompile Functions;
   for (llvm::Function &F : FunctionTags::Isolated.functions(&Module)) {
-    T.advance(&F,
-              llvm::Twine("decompile Function: ") + llvm::Twine(F.getName()));
-
     if (F.empty())
       continue;
 
-    llvm::Task T2(3,
-                  llvm::Twine("decompile Function: ")
-                    + llvm::Twine(F.getName()));
+    auto Entry = getMetaAddressMetadata(&F, "revng.function.entry");
+    if (Entries == nullptr or Entries->contains(Entry))
+      Functions.emplace_back(Entry, &F);
+  }
+  sortByPriority(Functions, Priority);
+
+  llvm::Task T(Functions.size(), "decompile");
+
+  // restructureCFG and beautifyAST can change the IR (and hence the
+  // LLVMContext), so they always run on this thread. Emission of C code only
+  // reads the IR, the model and the GHAST, so it can be dispatched to a pool of
+  // workers. We do that for a bounded window of functions at a time, so that
+  // memory usage does not grow with the size of the binary. The results of a
+  // window are handed out in order, so the output does not depend on
+  // ThreadCount.
+  std::optional<llvm::ThreadPool> Pool;
+  if (ThreadCount > 1) {
+    // Populate the cache in advance, so that the workers only ever read it
+    std::vector<const llvm::Function *> ToPrefill;
+    for (const auto &[Entry, F] : Functions)
+      ToPrefill.push_back(F);
+    prefillFunctionMetadata(Cache, ToPrefill);
+    Pool.emplace(llvm::hardware_concurrency(ThreadCount));
+  }
+  const size_t WindowSize = 4 * ThreadCount;
+
+  std::vector<PendingFunction> Pending;
+  auto FlushPending = [&]() {
+    for (PendingFunction &P : Pending) {
+      if (P.IsCached or P.Telemetry.Unstructured)
+        continue;
+
+      Pool->async([&Cache, &Model, &StackTypes, &P]() {
+        P.Telemetry.EmissionTime = measure([&]() {
+          trace::Scope Trace("c-backend", "emit C", P.F->getName());
+          GHASTBBIndex Index(P.GHAST);
+          auto VariablesToDeclare = computeVariableDeclarationScope(*P.F,
+                                                                    P.GHAST,
+                                                                    Index);
+          P.CCode = decompileFunction(Cache,
+                                      *P.F,
+                                      P.GHAST,
+                                      Model,
+                                      VariablesToDeclare,
+                                      Index.needsLoopStateVar(),
+                                      StackTypes,
+                                      P.SizeHint);
+        });
+      });
+    }
+    Pool->wait();
+
+    for (PendingFunction &P : Pending)
+      Commit(P, /* IsNew */ not P.IsCached);
+    Pending.clear();
+  };
+
+  // Results must be handed out in order: functions recovered from a previous
+  // run can not overtake the ones still waiting to be emitted by the workers.
+  auto Enqueue = [&](PendingFunction &&P) {
+    if (not Pool) {
+      Commit(P, /* IsNew */ not P.IsCached);
+      return;
+    }
+
+    Pending.push_back(std::move(P));
+    if (Pending.size() >= WindowSize)
+      FlushPending();
+  };
 
-    // TODO: this will eventually become a GHASTContainer for revng pipeline
-    ASTTree GHAST;
+  for (auto &[Key, F] : Functions) {
+    T.advance(llvm::Twine("decompile Function: ") + llvm::Twine(F->getName()));
+
+    PendingFunction P;
+    P.F = F;
+    P.Key = Key;
+
+    // If neither the IR nor the parts of the model F depends upon changed
+    // since the last time it has been decompiled, reuse the old C code.
+    if (Previous != nullptr or CacheDirectory) {
+      P.IRHash = hashFunctionIR(*F);
+      P.ModelHash = hashModelDependencies(Cache, Model, *F);
+    }
+
+    if (Previous != nullptr) {
+      auto It = Previous->Entries.find(P.Key);
+      if (It != Previous->Entries.end() and It->second.IRHash == P.IRHash
+          and It->second.ModelHash == P.ModelHash) {
+        revng_log(Log, "Reusing C code of " << F->getName());
+        P.CCode = It->second.CCode;
+        P.IsCached = true;
+        ++ReusedFunctions;
+        Enqueue(std::move(P));
+        continue;
+      }
+    }
+
+    if (CacheDirectory) {
+      if (auto Cached = CacheDirectory->lookup(P.IRHash, P.ModelHash)) {
+        revng_log(Log, "Found C code of " << F->getName() << " on disk");
+        P.CCode = std::move(*Cached);
+        P.IsCached = true;
+        ++ReusedFunctions;
+        Enqueue(std::move(P));
+        continue;
+      }
+    }
+
+    // Functions exceeding the budget are emitted as a flat list of basic
+    // blocks. This is cheap, so it's always done on this thread.
+    auto EmitUnstructured = [&](llvm::StringRef Reason) {
+      revng_log(Log,
+                "Budget exceeded by " << F->getName() << ": " << Reason);
+      P.Telemetry.Unstructured = true;
+      P.Telemetry.EmissionTime = measure([&]() {
+        trace::Scope Trace("c-backend", "emit unstructured C", F->getName());
+        P.CCode = decompileUnstructuredFunction(Cache,
+                                                *F,
+                                                Model,
+                                                StackTypes,
+                                                Reason);
+      });
+      Enqueue(std::move(P));
+    };
+
+    std::string Exceeded = checkBudgetBeforeRestructuring(*F);
+    if (not Exceeded.empty()) {
+      EmitUnstructured(Exceeded);
+      continue;
+    }
+
+    // If the model changed, but not in ways restructuring and beautification
+    // depend upon, the GHAST of the previous run is still good
+    bool ReusedGHAST = false;
+    if (Previous != nullptr) {
+      auto It = Previous->Entries.find(P.Key);
+      RestructuredGHAST *Old = nullptr;
+      if (It != Previous->Entries.end())
+        Old = It->second.GHAST.get();
+
+      // Only look at the model if the IR is the same
+      if (Old != nullptr and Old->matchesIR(P.IRHash)) {
+        P.BeautifyModelHash = hashBeautifyModelDependencies(Model, *F);
+        if (Old->matches(P.IRHash, *P.BeautifyModelHash)) {
+          revng_log(Log, "Reusing GHAST of " << F->getName());
+          P.GHAST = std::move(*Old).takeFor(*F);
+          It->second.GHAST.reset();
+          P.Telemetry.PeakGHASTNodes = P.GHAST.size();
+          ReusedGHAST = true;
+          ++ReusedGHASTs;
+        }
+      }
+    }
+
+    llvm::Task T2((Pool ? 0 : 1) + (ReusedGHAST ? 0 : 2),
+                  llvm::Twine("decompile Function: ")
+                    + llvm::Twine(F->getName()));
 
     // Generate the GHAST and beautify it.
-    {
+    if (not ReusedGHAST) {
+      DecompileTelemetry &Telemetry = P.Telemetry;
+
+      // restructureCFG can not be interrupted, so its budget is checked once
+      // it's done, before moving on to the (equally expensive) beautification.
       T2.advance("restructureCFG");
-      restructureCFG(F, GHAST);
+      Telemetry.RestructureTime = measure([&]() {
+        trace::Scope Trace("c-backend", "restructureCFG", F->getName());
+        restructureCFG(*F, P.GHAST, &Telemetry.Restructuring);
+      });
+      Telemetry.PeakGHASTNodes = P.GHAST.size();
+
+      Exceeded = checkBudgetAfterRestructuring(P.GHAST,
+                                               Telemetry.Restructuring,
+                                               Telemetry.RestructureTime);
+      if (not Exceeded.empty()) {
+        EmitUnstructured(Exceeded);
+        continue;
+      }
+
       // TODO: beautification should be optional, but at the moment it's not
       // truly so (if disabled, things crash). We should strive to make it
       // optional for real.
       T2.advance("beautifyAST");
-      beautifyAST(Model, F, GHAST);
+      Telemetry.BeautifyTime = measure([&]() {
+        trace::Scope Trace("c-backend", "beautifyAST", F->getName());
+        beautifyAST(Model, *F, P.GHAST, &Telemetry.Beautify);
+      });
+      Telemetry.PeakGHASTNodes = std::max<size_t>(Telemetry.PeakGHASTNodes,
+                                                  P.GHAST.size());
     }
 
-    T2.advance("decompileFunction");
+    P.HasGHAST = true;
+    P.SizeHint = estimateCCodeSize(*F, P.GHAST, Previous, Key);
+
     if (Log.isEnabled()) {
-      GHAST.dumpASTOnFile(F.getName().str(),
-                          "ast-backend",
-                          "AST-during-c-codegen.dot");
+      P.GHAST.dumpASTOnFile(F->getName().str(),
+                            "ast-backend",
+                            "AST-during-c-codegen.dot");
+    }
+
+    if (Pool) {
+      Enqueue(std::move(P));
+      continue;
     }
 
     // Generated C code for F
-    auto VariablesToDeclare = computeVariableDeclarationScope(F, GHAST);
-    auto NeedsLoopStateVar = hasLoopDispatchers(GHAST);
-    std::string CCode = decompileFunction(Cache,
-                                          F,
-                                          GHAST,
-                                          Model,
-                                          VariablesToDeclare,
-                                          NeedsLoopStateVar,
-                                          StackTypes);
-
-    // Push the C code into
-    MetaAddress Key = getMetaAddressMetadata(&F, "revng.function.entry");
-    DecompiledFunctions.insert_or_assign(Key, std::move(CCode));
+    T2.advance("decompileFunction");
+    P.Telemetry.EmissionTime = measure([&]() {
+      trace::Scope Trace("c-backend", "emit C", F->getName());
+      GHASTBBIndex Index(P.GHAST);
+      auto VariablesToDeclare = computeVariableDeclarationScope(*F,
+                                                                P.GHAST,
+                                                                Index);
+      P.CCode = decompileFunction(Cache,
+                                  *F,
+                                  P.GHAST,
+                                  Model,
+                                  VariablesToDeclare,
+                                  Index.needsLoopStateVar(),
+                                  StackTypes,
+                                  P.SizeHint);
+    });
+    Enqueue(std::move(P));
   }
+
+  if (not Pending.empty())
+    FlushPending();
+}
+
+void decompile(FunctionMetadataCache &Cache,
+               llvm::Module &Module,
+               const model::Binary &Model,
+               DecompiledFunctionCallback OnDecompiled,
+               DecompiledFunctionsCache *Previous) {
+  decompileImpl(Cache, Module, Model, nullptr, {}, OnDecompiled, Previous);
+}
+
+void decompile(FunctionMetadataCache &Cache,
+               llvm::Module &Module,
+               const model::Binary &Model,
+               const std::set<MetaAddress> &Entries,
+               DecompiledFunctionCallback OnDecompiled,
+               DecompiledFunctionsCache *Previous,
+               llvm::ArrayRef<MetaAddress> Priority) {
+  decompileImpl(Cache,
+                Module,
+                Model,
+                &Entries,
+                Priority,
+                OnDecompiled,
+                Previous);
+}
+
+void decompile(FunctionMetadataCache &Cache,
+               llvm::Module &Module,
+               const model::Binary &Model,
+               Container &DecompiledFunctions,
+               DecompiledFunctionsCache *Previous) {
+  auto Insert = [&DecompiledFunctions](const MetaAddress &Key,
+                                       std::string &&CCode) {
+    DecompiledFunctions.insert_or_assign(Key, std::move(CCode));
+  };
+  decompile(Cache, Module, Model, Insert, Previous);
 }
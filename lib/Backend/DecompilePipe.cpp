@@ -24,7 +24,7 @@ void Decompile::run(const pipeline::ExecutionContext &Ctx,
   llvm::Module &Module = IRContainer.getModule();
   const model::Binary &Model = *getModelFromContext(Ctx);
   FunctionMetadataCache Cache;
-  decompile(Cache, Module, Model, DecompiledFunctions);
+  decompile(Cache, Module, Model, DecompiledFunctions, &PreviousRuns);
 }
 
 void Decompile::print(const pipeline::Context &Ctx,
@@ -2,20 +2,32 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/Error.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include "revng/Support/Assert.h"
+#include "revng/Support/Debug.h"
+
 #include "revng-c/Backend/DecompileToSingleFile.h"
 
 using namespace revng::pipes;
 
+static Logger<> Log{ "decompile-to-single-file" };
+
+static void printHeaders(llvm::raw_ostream &Out, ptml::PTMLCBuilder &B) {
+  Out << B.getIncludeQuote("types-and-globals.h")
+      << B.getIncludeQuote("helpers.h") << "\n";
+}
+
 void printSingleCFile(llvm::raw_ostream &Out,
                       ptml::PTMLCBuilder &B,
                       const DecompileStringMap &Functions,
                       const std::set<MetaAddress> &Targets) {
   auto Scope = B.getTag(ptml::tags::Div).scope(Out);
-  // Print headers
-  Out << B.getIncludeQuote("types-and-globals.h")
-      << B.getIncludeQuote("helpers.h") << "\n";
+  printHeaders(Out, B);
 
   if (Targets.empty()) {
     // If Targets is empty print all the Functions' bodies
@@ -29,3 +41,99 @@ void printSingleCFile(llvm::raw_ostream &Out,
         Out << It->second << '\n';
   }
 }
+
+static llvm::Error printMember(llvm::raw_ostream &Out,
+                               const revng::SeekableArchive &Functions,
+                               const revng::SeekableArchive::Entry &Member) {
+  auto CFunction = Functions.extract(Member);
+  if (not CFunction)
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Cannot extract " + Member.Name + ": "
+                                     + llvm::toString(CFunction.takeError()));
+  Out << *CFunction << '\n';
+  return llvm::Error::success();
+}
+
+llvm::Error printSingleCFile(llvm::raw_ostream &Out,
+                             ptml::PTMLCBuilder &B,
+                             const revng::SeekableArchive &Functions,
+                             const std::set<MetaAddress> &Targets) {
+  auto Scope = B.getTag(ptml::tags::Div).scope(Out);
+  printHeaders(Out, B);
+
+  // A corrupt member doesn't prevent printing the others
+  llvm::Error Result = llvm::Error::success();
+
+  if (Targets.empty()) {
+    // The index is sorted by name, print the functions in MetaAddress order
+    // as the other overload does
+    std::map<MetaAddress, const revng::SeekableArchive::Entry *> Sorted;
+    for (const revng::SeekableArchive::Entry &Member : Functions.entries()) {
+      llvm::StringRef Name = Member.Name;
+      bool HasExtension = Name.consume_back(DecompileExtension);
+      revng_assert(HasExtension);
+      Sorted.emplace(MetaAddress::fromString(Name), &Member);
+    }
+
+    for (const auto &[Entry, Member] : Sorted)
+      Result = llvm::joinErrors(std::move(Result),
+                                printMember(Out, Functions, *Member));
+  } else {
+    for (const MetaAddress &Entry : Targets)
+      if (const auto *Member = Functions.find(getPackMemberName(Entry)))
+        Result = llvm::joinErrors(std::move(Result),
+                                  printMember(Out, Functions, *Member));
+  }
+
+  return Result;
+}
+
+/// Prints functions in MetaAddress order, buffering those that arrive early
+class OrderedFunctionPrinter {
+private:
+  llvm::raw_ostream &Out;
+  std::set<MetaAddress> Missing;
+  std::map<MetaAddress, std::string> Buffered;
+
+public:
+  OrderedFunctionPrinter(llvm::raw_ostream &Out,
+                         const std::set<MetaAddress> &Expected) :
+    Out(Out), Missing(Expected) {}
+
+  ~OrderedFunctionPrinter() {
+    // Whatever is left is preceded by functions that never showed up
+    for (auto &[Entry, CCode] : Buffered)
+      Out << CCode << '\n';
+  }
+
+public:
+  void print(const MetaAddress &Entry, std::string &&CCode) {
+    if (not Missing.erase(Entry)) {
+      revng_log(Log, "Ignoring unexpected function " << Entry.toString());
+      return;
+    }
+
+    Buffered.emplace(Entry, std::move(CCode));
+
+    // Print everything that is no longer preceded by missing functions
+    while (not Buffered.empty()
+           and (Missing.empty()
+                or Buffered.begin()->first < *Missing.begin())) {
+      Out << Buffered.begin()->second << '\n';
+      Buffered.erase(Buffered.begin());
+    }
+  }
+};
+
+void printSingleCFile(llvm::raw_ostream &Out,
+                      ptml::PTMLCBuilder &B,
+                      const std::set<MetaAddress> &Expected,
+                      DecompiledFunctionsProducer Producer) {
+  auto Scope = B.getTag(ptml::tags::Div).scope(Out);
+  printHeaders(Out, B);
+
+  OrderedFunctionPrinter Printer(Out, Expected);
+  Producer([&Printer](const MetaAddress &Entry, std::string &&CCode) {
+    Printer.print(Entry, std::move(CCode));
+  });
+}
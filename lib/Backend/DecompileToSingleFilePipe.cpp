@@ -6,6 +6,9 @@
 #include "revng/Pipeline/RegisterContainerFactory.h"
 #include "revng/Pipes/FileContainer.h"
 #include "revng/Pipes/Kinds.h"
+#include "revng/Pipes/ModelGlobal.h"
+#include "revng/Support/FunctionTags.h"
+#include "revng/Support/IRHelpers.h"
 
 #include "revng-c/Backend/DecompileToSingleFile.h"
 #include "revng-c/Backend/DecompileToSingleFilePipe.h"
@@ -40,6 +43,39 @@ void DecompileToSingleFile::print(const pipeline::Context &Ctx,
   OS << " decompiled-yaml-to-c -i " << Names[0] << " -o " << Names[1];
 }
 
+void StreamingDecompileToSingleFile::run(const pipeline::ExecutionContext &Ctx,
+                                         pipeline::LLVMContainer &IRContainer,
+                                         DecompiledFileContainer &OutCFile) {
+  llvm::Module &Module = IRContainer.getModule();
+  const model::Binary &Model = *getModelFromContext(Ctx);
+
+  std::set<MetaAddress> Expected;
+  for (llvm::Function &F : FunctionTags::Isolated.functions(&Module))
+    if (not F.empty())
+      Expected.insert(getMetaAddressMetadata(&F, "revng.function.entry"));
+
+  auto Out = OutCFile.asStream();
+  ptml::PTMLCBuilder B;
+
+  FunctionMetadataCache Cache;
+  printSingleCFile(Out,
+                   B,
+                   Expected,
+                   [&](DecompiledFunctionCallback OnDecompiled) {
+                     decompile(Cache, Module, Model, OnDecompiled);
+                   });
+  Out.flush();
+}
+
+void StreamingDecompileToSingleFile::print(const pipeline::Context &Ctx,
+                                           llvm::raw_ostream &OS,
+                                           llvm::ArrayRef<std::string> Names)
+  const {
+  OS << "[CLI tools for pipes are deprecated]\n";
+}
+
 } // end namespace revng::pipes
 
 static pipeline::RegisterPipe<revng::pipes::DecompileToSingleFile> Y;
+using StreamingPipe = revng::pipes::StreamingDecompileToSingleFile;
+static pipeline::RegisterPipe<StreamingPipe> Z;
@@ -0,0 +1,194 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <set>
+#include <string>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include "revng/Model/Binary.h"
+#include "revng/Model/IRHelpers.h"
+#include "revng/Support/Assert.h"
+#include "revng/Support/FunctionTags.h"
+#include "revng/Support/IRHelpers.h"
+#include "revng/Support/YAMLTraits.h"
+
+#include "revng-c/InitModelTypes/InitModelTypes.h"
+#include "revng-c/Support/FunctionTags.h"
+#include "revng-c/Support/IRHelpers.h"
+
+#include "FunctionFingerprint.h"
+
+using namespace llvm;
+
+template<typename T>
+static void serialize(raw_ostream &OS, const T &Object) {
+  yaml::Output YAMLOutput(OS);
+  YAMLOutput << const_cast<T &>(Object);
+}
+
+namespace {
+
+/// The parts of the model the C code of a function depends on
+struct ModelDependencies {
+  const model::Function *Function = nullptr;
+  std::set<const model::Type *> Types;
+  std::set<const model::Function *> Callees;
+  std::set<const model::DynamicFunction *> DynamicFunctions;
+  std::set<std::pair<MetaAddress, uint64_t>> Segments;
+};
+
+} // namespace
+
+/// Add to \p Types \p Root and all the types it refers to, transitively
+static void addReachableTypes(const model::Type *Root,
+                              std::set<const model::Type *> &Types) {
+  SmallVector<const model::Type *, 16> Worklist = { Root };
+  while (not Worklist.empty()) {
+    const model::Type *T = Worklist.pop_back_val();
+    if (not Types.insert(T).second)
+      continue;
+
+    for (const model::QualifiedType &QT : T->edges())
+      Worklist.push_back(QT.UnqualifiedType().getConst());
+  }
+}
+
+/// Serialize to \p OS all of \p Types, in a stable order
+static void serializeTypes(raw_ostream &OS,
+                           const model::Binary &Model,
+                           const std::set<const model::Type *> &Types) {
+  // Sets of pointers do not have a stable iteration order, sort by key
+  SmallVector<const model::Type *> SortedTypes(Types.begin(), Types.end());
+  llvm::sort(SortedTypes, [](const model::Type *LHS, const model::Type *RHS) {
+    return LHS->key() < RHS->key();
+  });
+  for (const model::Type *T : SortedTypes)
+    serialize(OS, Model.Types().at(T->key()));
+}
+
+uint64_t hashReachableTypes(const model::Binary &Model,
+                            ArrayRef<const model::Type *> Roots) {
+  std::set<const model::Type *> Types;
+  for (const model::Type *Root : Roots)
+    addReachableTypes(Root, Types);
+
+  std::string Buffer;
+  {
+    raw_string_ostream OS(Buffer);
+    serializeTypes(OS, Model, Types);
+  }
+
+  return xxHash64(Buffer);
+}
+
+static ModelDependencies collectModelDependencies(FunctionMetadataCache &Cache,
+                                                  const model::Binary &Model,
+                                                  const Function &F) {
+  ModelDependencies Result;
+  Result.Function = llvmToModelFunction(Model, F);
+  revng_assert(Result.Function != nullptr);
+
+  // Types are printed in full, not only by name, as soon as the C code
+  // accesses their fields, and so are prototypes, hence all the types they
+  // refer to are dependencies too.
+  auto &Types = Result.Types;
+  auto AddType = [&Types](const model::Type *T) {
+    addReachableTypes(T, Types);
+  };
+
+  const model::Function *ModelFunction = Result.Function;
+  AddType(ModelFunction->prototype(Model).getConst());
+  if (not ModelFunction->StackFrameType().empty())
+    AddType(ModelFunction->StackFrameType().getConst());
+
+  auto TypeMap = initModelTypes(Cache,
+                                F,
+                                ModelFunction,
+                                Model,
+                                /*PointersOnly=*/false);
+  for (const auto &[Value, QT] : TypeMap)
+    AddType(QT.UnqualifiedType().getConst());
+
+  for (const Instruction &I : instructions(F)) {
+    auto *Call = dyn_cast<CallInst>(&I);
+    if (Call == nullptr)
+      continue;
+
+    if (isCallToIsolatedFunction(Call)) {
+      AddType(Cache.getCallSitePrototype(Model, Call).getConst());
+
+      if (const Function *Callee = Call->getCalledFunction())
+        if (const auto *MF = llvmToModelFunction(Model, *Callee)) {
+          Result.Callees.insert(MF);
+          AddType(MF->prototype(Model).getConst());
+        }
+
+      const auto &[CallEdge, _] = Cache.getCallEdge(Model, Call);
+      if (CallEdge and not CallEdge->DynamicFunction().empty()) {
+        const auto &Name = CallEdge->DynamicFunction();
+        const auto &Callee = Model.ImportedDynamicFunctions().at(Name);
+        Result.DynamicFunctions.insert(&Callee);
+        if (not Callee.Prototype().empty())
+          AddType(Callee.Prototype().getConst());
+      }
+    } else if (isCallToTagged(Call, FunctionTags::SegmentRef)) {
+      const Function *Callee = Call->getCalledFunction();
+      Result.Segments.insert(extractSegmentKeyFromMetadata(*Callee));
+    }
+  }
+
+  return Result;
+}
+
+uint64_t hashModelDependencies(FunctionMetadataCache &Cache,
+                               const model::Binary &Model,
+                               const Function &F) {
+  auto [ModelFunction,
+        Types,
+        Callees,
+        DynamicFunctions,
+        Segments] = collectModelDependencies(Cache, Model, F);
+
+  std::string Buffer;
+  {
+    raw_string_ostream OS(Buffer);
+    OS << static_cast<unsigned>(Model.Architecture()) << "\n";
+    serialize(OS, *ModelFunction);
+
+    serializeTypes(OS, Model, Types);
+
+    SmallVector<const model::Function *> SortedCallees(Callees.begin(),
+                                                       Callees.end());
+    llvm::sort(SortedCallees,
+               [](const model::Function *LHS, const model::Function *RHS) {
+                 return LHS->Entry() < RHS->Entry();
+               });
+    for (const model::Function *Callee : SortedCallees)
+      serialize(OS, *Callee);
+
+    SmallVector<const model::DynamicFunction *>
+      SortedDynamicFunctions(DynamicFunctions.begin(), DynamicFunctions.end());
+    llvm::sort(SortedDynamicFunctions,
+               [](const model::DynamicFunction *LHS,
+                  const model::DynamicFunction *RHS) {
+                 return LHS->key() < RHS->key();
+               });
+    for (const model::DynamicFunction *Callee : SortedDynamicFunctions)
+      serialize(OS, *Callee);
+
+    for (const auto &[StartAddress, VirtualSize] : Segments)
+      serialize(OS, Model.Segments().at({ StartAddress, VirtualSize }));
+  }
+
+  return xxHash64(Buffer);
+}
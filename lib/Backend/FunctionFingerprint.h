@@ -0,0 +1,33 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+
+#include "llvm/ADT/ArrayRef.h"
+
+#include "revng/EarlyFunctionAnalysis/FunctionMetadataCache.h"
+#include "revng/Model/Binary.h"
+
+#include "revng-c/Support/FunctionFingerprint.h"
+
+namespace llvm {
+class Function;
+} // namespace llvm
+
+/// Compute a hash of all the parts of \p Model that can affect the C code
+/// emitted for \p F: the model::Function itself, its prototype and stack frame
+/// type, all the types associated to its values, the prototypes and names of
+/// its callees, and the segments it references.
+///
+/// Types are hashed together with all the types they refer to, transitively,
+/// so that editing a type nested in another one affects the hash.
+extern uint64_t hashModelDependencies(FunctionMetadataCache &Cache,
+                                      const model::Binary &Model,
+                                      const llvm::Function &F);
+
+/// Compute a hash of \p Roots and all the types they refer to, transitively
+extern uint64_t hashReachableTypes(const model::Binary &Model,
+                                   llvm::ArrayRef<const model::Type *> Roots);
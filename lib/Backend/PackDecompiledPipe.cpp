@@ -0,0 +1,53 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Compression.h"
+
+#include "revng/Pipeline/AllRegistries.h"
+#include "revng/Pipeline/RegisterContainerFactory.h"
+#include "revng/Support/Assert.h"
+
+#include "revng-c/Backend/PackDecompiledPipe.h"
+#include "revng-c/Support/SeekableArchive.h"
+
+using namespace llvm;
+
+static cl::opt<int> CompressionLevel("decompiled-pack-compression-level",
+                                     cl::desc("zlib level used to compress "
+                                              "each function in "
+                                              "decompiled.pack, 0 to store "
+                                              "them uncompressed"),
+                                     cl::init(zlib::BestSpeedCompression));
+
+namespace revng::pipes {
+
+static pipeline::RegisterDefaultConstructibleContainer<DecompiledPackContainer>
+  Reg;
+
+void PackDecompiled::run(const pipeline::ExecutionContext &Ctx,
+                         const DecompileStringMap &DecompiledFunctions,
+                         DecompiledPackContainer &Output) {
+  revng_check(CompressionLevel >= zlib::NoCompression
+              and CompressionLevel <= zlib::BestSizeCompression);
+
+  std::vector<std::pair<std::string, StringRef>> Members;
+  for (const auto &[Entry, CCode] : DecompiledFunctions)
+    Members.emplace_back(getPackMemberName(Entry), CCode);
+
+  auto Out = Output.asStream();
+  if (Error E = SeekableArchive::write(Members, CompressionLevel, Out))
+    revng_abort(llvm::toString(std::move(E)).c_str());
+  Out.flush();
+}
+
+void PackDecompiled::print(const pipeline::Context &Ctx,
+                           llvm::raw_ostream &OS,
+                           llvm::ArrayRef<std::string> Names) const {
+  OS << "[CLI tools for pipes are deprecated]\n";
+}
+
+} // end namespace revng::pipes
+
+static pipeline::RegisterPipe<revng::pipes::PackDecompiled> Y;
@@ -0,0 +1,110 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <type_traits>
+#include <vector>
+
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Value.h"
+
+#include "revng/Support/Assert.h"
+
+#include "revng-c/RestructureCFG/ASTNode.h"
+#include "revng-c/RestructureCFG/ExprNode.h"
+
+#include "FunctionFingerprint.h"
+#include "RestructuredGHAST.h"
+
+using namespace llvm;
+
+/// The arguments, basic blocks and instructions of \p F, in order
+template<typename FunctionT>
+static auto numberValues(FunctionT &F) {
+  using ValueT = std::conditional_t<std::is_const_v<FunctionT>,
+                                    const Value,
+                                    Value>;
+  std::vector<ValueT *> Result;
+  for (auto &Arg : F.args())
+    Result.push_back(&Arg);
+  for (auto &BB : F)
+    Result.push_back(&BB);
+  for (auto &I : instructions(F))
+    Result.push_back(&I);
+  return Result;
+}
+
+/// Call \p Remap on the address of each value referred to by \p GHAST
+template<typename RemapT>
+static void forEachValueSlot(ASTTree &GHAST, RemapT &&Remap) {
+  for (ASTNode *Node : GHAST.nodes()) {
+    if (BasicBlock *BB = Node->getBB()) {
+      Value *V = BB;
+      Remap(V);
+      Node->setBB(cast<BasicBlock>(V));
+    }
+
+    if (auto *Switch = dyn_cast<SwitchNode>(Node)) {
+      if (Value *Condition = Switch->getCondition()) {
+        Remap(Condition);
+        Switch->setCondition(Condition);
+      }
+    }
+  }
+
+  // All the conditions are owned by GHAST, whichever node uses them, if any.
+  // Only the leaves refer to values.
+  for (auto &Expr : GHAST.expressions()) {
+    if (auto *Compare = dyn_cast<ValueCompareNode>(Expr.get())) {
+      Value *V = Compare->getBasicBlock();
+      Remap(V);
+      Compare->setBasicBlock(cast<BasicBlock>(V));
+    } else if (auto *Atomic = dyn_cast<AtomicNode>(Expr.get())) {
+      if (BasicBlock *BB = Atomic->getConditionalBasicBlock()) {
+        Value *V = BB;
+        Remap(V);
+        Atomic->setConditionalBasicBlock(cast<BasicBlock>(V));
+      }
+    }
+  }
+}
+
+std::unique_ptr<RestructuredGHAST>
+RestructuredGHAST::capture(ASTTree &&GHAST,
+                           const Function &F,
+                           uint64_t BeautifyModelHash) {
+  auto Result = std::make_unique<RestructuredGHAST>();
+
+  DenseMap<const Value *, unsigned> AllPositions;
+  for (const Value *V : numberValues(F))
+    AllPositions.try_emplace(V, AllPositions.size());
+
+  bool IsMovable = true;
+  forEachValueSlot(GHAST, [&](Value *&V) {
+    auto It = AllPositions.find(V);
+    if (It == AllPositions.end())
+      IsMovable = false;
+    else
+      Result->Positions.insert(*It);
+  });
+  if (not IsMovable)
+    return nullptr;
+
+  Result->GHAST = std::move(GHAST);
+  Result->IRHash = hashFunctionIR(F);
+  Result->BeautifyModelHash = BeautifyModelHash;
+  return Result;
+}
+
+ASTTree RestructuredGHAST::takeFor(Function &F) && {
+  std::vector<Value *> Values = numberValues(F);
+  forEachValueSlot(GHAST, [&](Value *&V) {
+    auto It = Positions.find(V);
+    revng_assert(It != Positions.end() and It->second < Values.size());
+    V = Values[It->second];
+  });
+
+  return std::move(GHAST);
+}
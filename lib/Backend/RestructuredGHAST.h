@@ -0,0 +1,62 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "llvm/ADT/DenseMap.h"
+
+#include "revng-c/RestructureCFG/ASTTree.h"
+
+namespace llvm {
+class Function;
+class Value;
+} // namespace llvm
+
+/// The GHAST a function has been restructured and beautified into, kept
+/// across decompile() invocations so that changes to the model that don't
+/// affect the control flow only re-run the emission of C code.
+///
+/// restructureCFG and beautifyAST change the IR, hence the GHAST can be reused
+/// only on a function whose IR is exactly what they left. The GHAST refers to
+/// basic blocks and values by pointer: those of the function it has been
+/// captured from are only used as keys to find their position in it, so the
+/// GHAST can be moved onto any function with the same IR, even once the
+/// original one is gone.
+class RestructuredGHAST {
+private:
+  ASTTree GHAST;
+
+  /// The hash of the IR after restructuring and beautification
+  uint64_t IRHash = 0;
+
+  /// See hashBeautifyModelDependencies
+  uint64_t BeautifyModelHash = 0;
+
+  /// The position, among the arguments, basic blocks and instructions of the
+  /// function, of each value GHAST refers to
+  llvm::DenseMap<const llvm::Value *, unsigned> Positions;
+
+public:
+  /// Take \p GHAST, built from \p F, which must not change from now on.
+  ///
+  /// \return nullptr if \p GHAST refers to values that are not part of \p F,
+  ///         such as constants, which can't be moved on another function
+  static std::unique_ptr<RestructuredGHAST>
+  capture(ASTTree &&GHAST, const llvm::Function &F, uint64_t BeautifyModelHash);
+
+public:
+  bool matchesIR(uint64_t IRHash) const { return IRHash == this->IRHash; }
+
+  bool matches(uint64_t IRHash, uint64_t BeautifyModelHash) const {
+    return IRHash == this->IRHash
+           and BeautifyModelHash == this->BeautifyModelHash;
+  }
+
+  /// Move the GHAST onto \p F, whose IR must match, and hand it out
+  ASTTree takeFor(llvm::Function &F) &&;
+};
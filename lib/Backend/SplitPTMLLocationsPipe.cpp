@@ -0,0 +1,37 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "revng/Pipeline/AllRegistries.h"
+#include "revng/Pipeline/RegisterContainerFactory.h"
+
+#include "revng-c/Backend/SplitPTMLLocationsPipe.h"
+#include "revng-c/Support/PTMLLocationTable.h"
+
+namespace revng::pipes {
+
+static pipeline::RegisterDefaultConstructibleContainer<
+  DecompiledLocationsStringMap>
+  Reg;
+
+void SplitPTMLLocations::run(const pipeline::ExecutionContext &Ctx,
+                             const DecompileStringMap &DecompiledFunctions,
+                             DecompiledLocationsStringMap &Output) {
+  for (const auto &[Entry, CCode] : DecompiledFunctions) {
+    std::string Serialized;
+    llvm::raw_string_ostream OS(Serialized);
+    ptml::LocationTable::fromPTML(CCode).serialize(OS);
+    OS.flush();
+    Output.insert_or_assign(Entry, std::move(Serialized));
+  }
+}
+
+void SplitPTMLLocations::print(const pipeline::Context &Ctx,
+                               llvm::raw_ostream &OS,
+                               llvm::ArrayRef<std::string> Names) const {
+  OS << "[CLI tools for pipes are deprecated]\n";
+}
+
+} // end namespace revng::pipes
+
+static pipeline::RegisterPipe<revng::pipes::SplitPTMLLocations> Y;
@@ -0,0 +1,32 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "revng/Pipeline/AllRegistries.h"
+#include "revng/Pipeline/RegisterContainerFactory.h"
+
+#include "revng-c/Backend/StripPTMLPipe.h"
+#include "revng-c/Support/PTMLStripper.h"
+
+namespace revng::pipes {
+
+static pipeline::RegisterDefaultConstructibleContainer<
+  DecompiledPlainStringMap>
+  Reg;
+
+void StripPTML::run(const pipeline::ExecutionContext &Ctx,
+                    const DecompileStringMap &DecompiledFunctions,
+                    DecompiledPlainStringMap &Output) {
+  for (const auto &[Entry, CCode] : DecompiledFunctions)
+    Output.insert_or_assign(Entry, ptml::stripPTML(CCode));
+}
+
+void StripPTML::print(const pipeline::Context &Ctx,
+                      llvm::raw_ostream &OS,
+                      llvm::ArrayRef<std::string> Names) const {
+  OS << "[CLI tools for pipes are deprecated]\n";
+}
+
+} // end namespace revng::pipes
+
+static pipeline::RegisterPipe<revng::pipes::StripPTML> Y;
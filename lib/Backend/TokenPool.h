@@ -0,0 +1,41 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <vector>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+/// A pool of interned strings, each identified by a small integer handle.
+///
+/// Each distinct string is stored exactly once, and the StringRefs returned by
+/// get() stay valid until the pool is cleared.
+class TokenPool {
+public:
+  using Handle = uint32_t;
+
+private:
+  llvm::StringMap<Handle> Handles;
+  std::vector<llvm::StringRef> Tokens;
+
+public:
+  Handle intern(llvm::StringRef Token) {
+    auto [It, IsNew] = Handles.try_emplace(Token, Tokens.size());
+    if (IsNew)
+      Tokens.push_back(It->first());
+    return It->second;
+  }
+
+  llvm::StringRef get(Handle H) const { return Tokens.at(H); }
+
+  size_t size() const { return Tokens.size(); }
+
+  void clear() {
+    Tokens.clear();
+    Handles.clear();
+  }
+};
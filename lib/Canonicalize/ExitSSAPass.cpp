@@ -4,12 +4,11 @@
 
 #include <algorithm>
 #include <compare>
-#include <limits>
 #include <map>
 #include <set>
-#include <unordered_map>
 #include <vector>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/EquivalenceClasses.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/PostOrderIterator.h"
@@ -47,25 +46,23 @@ public:
   }
 };
 
-struct IncomingInfo {
-  BasicBlock *PHIBlock;
-  BasicBlock *IncomingBlock;
-  Value *IncomingValue;
-  bool operator==(const IncomingInfo &) const = default;
-  std::strong_ordering operator<=>(const IncomingInfo &) const = default;
-};
-
-static bool haveIncompatibleIncomings(const std::set<IncomingInfo> &LHS,
-                                      const std::set<IncomingInfo> &RHS) {
-  for (const auto &[PHIBlock, IncomingBlock, IncomingValue] : LHS) {
-    auto It = RHS.lower_bound(IncomingInfo{ PHIBlock, IncomingBlock, nullptr });
-    auto End = RHS.upper_bound(IncomingInfo{
-      PHIBlock, IncomingBlock, std::numeric_limits<Value *>::max() });
-    // If RHS contains a PHI that is in the same block as PHIBlock, and has a
-    // different incoming value on the same incoming block, the two are
-    // incompatible, because they would assign two different values to the same
-    // local variable along the same edge.
-    if (It != End and IncomingValue != It->IncomingValue)
+// For each PHIBlock where a class of PHINodes has a PHINode, and for each
+// IncomingBlock of such PHINode, the value that the variable associated with
+// the class has to hold when coming from IncomingBlock.
+using IncomingKey = std::pair<BasicBlock *, BasicBlock *>;
+using ClassIncomings = llvm::DenseMap<IncomingKey, Value *>;
+
+static bool haveCompatibleIncomings(const ClassIncomings &LHS,
+                                    const ClassIncomings &RHS) {
+  const ClassIncomings &Smaller = LHS.size() <= RHS.size() ? LHS : RHS;
+  const ClassIncomings &Larger = LHS.size() <= RHS.size() ? RHS : LHS;
+  for (const auto &[PHIAndIncomingBlock, IncomingValue] : Smaller) {
+    // If the two classes have PHINodes in the same PHIBlock, with a different
+    // incoming value on the same incoming block, the two are incompatible,
+    // because they would assign two different values to the same local
+    // variable along the same edge.
+    auto It = Larger.find(PHIAndIncomingBlock);
+    if (It != Larger.end() and It->second != IncomingValue)
       return false;
   }
   return true;
@@ -76,7 +73,8 @@ static std::vector<std::set<PHINode *>> getPHIEquivalenceClasses(Function &F) {
   // PHINodes in the same class are mapped onto the same local variable.
   llvm::EquivalenceClasses<PHINode *> PHISameVariableClasses;
 
-  std::unordered_map<PHINode *, std::set<IncomingInfo>> PerClassIncomings;
+  // The incomings of each class, indexed by the leader of the class.
+  llvm::DenseMap<PHINode *, ClassIncomings> PerClassIncomings;
 
   const auto InitVariableClass = [&PHISameVariableClasses,
                                   &PerClassIncomings](PHINode *PHI) {
@@ -85,16 +83,13 @@ static std::vector<std::set<PHINode *>> getPHIEquivalenceClasses(Function &F) {
 
     PHISameVariableClasses.insert(PHI);
 
-    auto &CurrentIncomingInfo = PerClassIncomings[PHI];
+    auto &CurrentIncomings = PerClassIncomings[PHI];
     unsigned NumIncomings = PHI->getNumIncomingValues();
     BasicBlock *PHIBlock = PHI->getParent();
     for (unsigned I = 0U; I < NumIncomings; ++I) {
       Value *IncomingValue = PHI->getIncomingValue(I);
       BasicBlock *IncomingBlock = PHI->getIncomingBlock(I);
-      auto NewIncomingInfo = IncomingInfo{ PHIBlock,
-                                           IncomingBlock,
-                                           IncomingValue };
-      CurrentIncomingInfo.insert(std::move(NewIncomingInfo));
+      CurrentIncomings.insert({ { PHIBlock, IncomingBlock }, IncomingValue });
     }
     return;
   };
@@ -105,6 +100,12 @@ static std::vector<std::set<PHINode *>> getPHIEquivalenceClasses(Function &F) {
       // Set up an equivalence class for PHI, if necessary
       InitVariableClass(&PHI);
 
+      // If the PHI has a user that is not another PHI, it cannot be put in
+      // the same equivalence class as any of its users.
+      bool HasNonPHIUsers = llvm::any_of(PHI.users(), [](const User *U) {
+        return not isa<PHINode>(U);
+      });
+
       // Then, for each user, if it's a PHINode, try to see if we can insert it
       // in the same equivalence class as PHI.
       for (User *U : PHI.users()) {
@@ -120,39 +121,45 @@ static std::vector<std::set<PHINode *>> getPHIEquivalenceClasses(Function &F) {
         // call might fail.
         InitVariableClass(PHIUser);
 
+        if (HasNonPHIUsers)
+          continue;
+
         // If PHI and PHIUser are already in the same equivalence class, there's
         // nothing to do.
         if (PHISameVariableClasses.isEquivalent(&PHI, PHIUser))
           continue;
 
-        // If the PHI has a user that is not another PHI, it cannot be put in
-        // the same equivalence class as the PHIUser, so we bail out.
-        if (llvm::any_of(PHI.users(),
-                         [](const User *U) { return not isa<PHINode>(U); }))
-          continue;
-
         PHINode *PHILeader = PHISameVariableClasses.getLeaderValue(&PHI);
         PHINode *UserLeader = PHISameVariableClasses.getLeaderValue(PHIUser);
 
         // Now let's see if there are conflicting live sets.
-        auto PHIIncomingInfo = PerClassIncomings.find(PHILeader);
-        revng_assert(PHIIncomingInfo != PerClassIncomings.end());
-        auto UserIncomingInfo = PerClassIncomings.find(UserLeader);
-        revng_assert(UserIncomingInfo != PerClassIncomings.end());
+        auto PHIIncomingsIt = PerClassIncomings.find(PHILeader);
+        revng_assert(PHIIncomingsIt != PerClassIncomings.end());
+        auto UserIncomingsIt = PerClassIncomings.find(UserLeader);
+        revng_assert(UserIncomingsIt != PerClassIncomings.end());
 
         // If there are conflicting incoming it means that the two sets of PHIs
         // hold different values that must be kept alive at the same time,
         // otherwise we'll lose one of them. In this case we have to bail out.
-        if (haveIncompatibleIncomings(PHIIncomingInfo->second,
-                                      UserIncomingInfo->second))
+        if (not haveCompatibleIncomings(PHIIncomingsIt->second,
+                                        UserIncomingsIt->second))
           continue;
 
         // Here the two are compatible so we join the equivalence classes.
-        PHISameVariableClasses.unionSets(&PHI, PHIUser);
+        // Then we do the same with the incomings, always merging the smaller
+        // set into the larger one, so that each incoming is moved at most a
+        // logarithmic number of times.
+        ClassIncomings Merged = std::move(PHIIncomingsIt->second);
+        ClassIncomings Other = std::move(UserIncomingsIt->second);
+        PerClassIncomings.erase(PHILeader);
+        PerClassIncomings.erase(UserLeader);
+        if (Merged.size() < Other.size())
+          std::swap(Merged, Other);
+        Merged.insert(Other.begin(), Other.end());
 
-        // Finally we do the same with the IncomingInfo
-        auto Handle = PerClassIncomings.extract(UserIncomingInfo);
-        PHIIncomingInfo->second.merge(std::move(Handle.mapped()));
+        PHISameVariableClasses.unionSets(&PHI, PHIUser);
+        PHINode *NewLeader = PHISameVariableClasses.getLeaderValue(&PHI);
+        PerClassIncomings[NewLeader] = std::move(Merged);
       }
     }
   }
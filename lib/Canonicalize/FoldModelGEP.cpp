@@ -66,14 +66,6 @@ static llvm::Value *getValueToSubstitute(llvm::Instruction &I,
     // such as `*&` and `(&base)->` in the decompiled code, which are
     // redundant.
 
-    // First argument is the model type of the base pointer
-    llvm::Value *GEPFirstArg = Call->getArgOperand(0);
-    QualifiedType GEPBaseType = deserializeFromLLVMString(GEPFirstArg, Model);
-
-    // Second argument is the base pointer
-    llvm::Value *SecondArg = Call->getArgOperand(1);
-    SecondArg = traverseTransparentInstructions(SecondArg);
-
     // Skip if the ModelGEP is doing an array access. If it's doing an array
     // access, we'd lose that by folding, so we only traverse if it's constant
     // and it's zero.
@@ -84,6 +76,10 @@ static llvm::Value *getValueToSubstitute(llvm::Instruction &I,
     if (HasInitialArrayAccess)
       return nullptr;
 
+    // Second argument is the base pointer
+    llvm::Value *SecondArg = Call->getArgOperand(1);
+    SecondArg = traverseTransparentInstructions(SecondArg);
+
     // Skip if the second argument (after traversing casts) is not an
     // AddressOf call
     llvm::CallInst *AddrOfCall = getCallToTagged(SecondArg,
@@ -93,15 +89,22 @@ static llvm::Value *getValueToSubstitute(llvm::Instruction &I,
 
     revng_log(Log, "Second arg is an addressOf ");
 
-    // First argument of the AddressOf is the pointer's base type
+    // The first argument of both the ModelGEP and the AddressOf is the
+    // serialized base type. The checks above are much cheaper than
+    // deserializing them, so we only do it now, and only if they are not the
+    // very same string.
+    llvm::Value *GEPFirstArg = Call->getArgOperand(0);
     llvm::Value *AddrOfFirstArg = AddrOfCall->getArgOperand(0);
-    QualifiedType AddrOfBaseType = deserializeFromLLVMString(AddrOfFirstArg,
-                                                             Model);
-
-    // Skip if the ModelGEP is dereferencing the AddressOf with a
-    // different type
-    if (AddrOfBaseType != GEPBaseType)
-      return nullptr;
+    if (GEPFirstArg != AddrOfFirstArg) {
+      QualifiedType GEPBaseType = deserializeFromLLVMString(GEPFirstArg, Model);
+      QualifiedType AddrOfBaseType = deserializeFromLLVMString(AddrOfFirstArg,
+                                                               Model);
+
+      // Skip if the ModelGEP is dereferencing the AddressOf with a
+      // different type
+      if (AddrOfBaseType != GEPBaseType)
+        return nullptr;
+    }
 
     revng_log(Log, "Types are the same ");
     revng_log(Log, "Adding " << dumpToString(Call) << " to the map");
@@ -27,12 +27,13 @@ public:
 
     llvm::SmallVector<PHINode *, 16> ToFix;
 
-    // Collect phis that need fixing
+    // Collect phis that need fixing. Phis are always at the start of their
+    // block, so there's no need to look at the rest of the instructions: this
+    // keeps the runs of the pass on functions without struct phis cheap.
     for (BasicBlock &BB : F)
-      for (Instruction &I : BB)
-        if (auto *Phi = dyn_cast<PHINode>(&I))
-          if (isa<StructType>(I.getType()))
-            ToFix.push_back(Phi);
+      for (PHINode &Phi : BB.phis())
+        if (isa<StructType>(Phi.getType()))
+          ToFix.push_back(&Phi);
 
     if (ToFix.size() == 0)
       return false;
@@ -54,6 +54,13 @@ bool LoopRewriteIV::run(Loop &L,
                         DominatorTree *DT) {
   bool Changed = false;
 
+  // A single expander for all the users in the loop, so that the expressions
+  // they share, such as the induction variables, are expanded only once.
+  const DataLayout &DL = L.getHeader()->getModule()->getDataLayout();
+  SCEVExpander Rewriter(*SE,
+                        DL,
+                        "loop-rewrite-with-canonical-induction-variable");
+
   for (auto &UI : *IU) {
     // Compute the final addrec to expand into code.
     const SCEV *AR = IU->getReplacementExpr(UI);
@@ -90,11 +97,6 @@ bool LoopRewriteIV::run(Loop &L,
     Instruction *InsertPt = getInsertPointForUses(User, Op, DT, &LI);
 
     // Now expand it into actual Instructions and patch it into place.
-    const DataLayout &DL = L.getHeader()->getModule()->getDataLayout();
-    SCEVExpander Rewriter(*SE,
-                          DL,
-                          "loop-rewrite-with-canonical-induction-variable");
-
     if (!Rewriter.isSafeToExpandAt(AR, InsertPt)) {
       revng_log(Log, "Not safe expression: " << dumpToString(AR));
       continue;
@@ -16,7 +16,7 @@
 #include "revng/Model/LoadModelPass.h"
 #include "revng/Support/OpaqueFunctionsPool.h"
 
-#include "revng-c/InitModelTypes/InitModelTypes.h"
+#include "revng-c/InitModelTypes/ModelTypesAnalysis.h"
 #include "revng-c/Support/FunctionTags.h"
 #include "revng-c/Support/ModelHelpers.h"
 
@@ -26,15 +26,28 @@ struct MakeLocalVariables : public llvm::FunctionPass {
 public:
   static char ID;
 
+private:
+  SharedOpaqueFunctionsPool<TypePair> AddressOfPool{ initAddressOfPool };
+  SharedOpaqueFunctionsPool<llvm::Type *> LocalVarPool{ initLocalVarPool };
+
+public:
   MakeLocalVariables() : FunctionPass(ID) {}
 
   /// Transform allocas and alloca-like function calls into calls to
   /// `LocalVariable(AddressOf())`
   bool runOnFunction(llvm::Function &F) override;
 
+  bool doFinalization(llvm::Module &) override {
+    AddressOfPool.clear();
+    LocalVarPool.clear();
+    return false;
+  }
+
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
     AU.addRequired<LoadModelWrapperPass>();
     AU.addRequired<FunctionMetadataCachePass>();
+    AU.addRequired<ModelTypesAnalysis>();
+    AU.addPreserved<ModelTypesAnalysis>();
     AU.setPreservesCFG();
   }
 };
@@ -60,35 +73,22 @@ bool MakeLocalVariables::runOnFunction(llvm::Function &F) {
   if (ToReplace.empty())
     return false;
 
-  // Get the model and the function metadata cache
+  // Get the model
   const auto
     &Model = getAnalysis<LoadModelWrapperPass>().get().getReadOnlyModel().get();
-  auto &Cache = getAnalysis<FunctionMetadataCachePass>().get();
 
   llvm::LLVMContext &LLVMCtx = F.getContext();
   llvm::Module &M = *F.getParent();
   llvm::IRBuilder<> Builder(LLVMCtx);
   llvm::Type *PtrSizedInteger = getPointerSizedInteger(LLVMCtx, *Model);
 
-  // Initialize function pools
-  OpaqueFunctionsPool<TypePair> AddressOfPool(&M, false);
-  initAddressOfPool(AddressOfPool, &M);
-  OpaqueFunctionsPool<llvm::Type *> LocalVarPool(&M, false);
-  initLocalVarPool(LocalVarPool);
-
   // Try to initialize a map for the known model types of llvm::Values
   // that are reachable from F. If this fails, we just bail out because we
   // cannot infer any modelGEP in F, if we have no type information to rely
   // on.
-  const model::Function *ModelF = llvmToModelFunction(*Model, F);
-  revng_assert(ModelF);
-  using ModelTypesMap = std::map<const llvm::Value *,
-                                 const model::QualifiedType>;
-  ModelTypesMap KnownTypes = initModelTypes(Cache,
-                                            F,
-                                            ModelF,
-                                            *Model,
-                                            /*PointersOnly=*/false);
+  revng_assert(llvmToModelFunction(*Model, F));
+  auto &ModelTypes = getAnalysis<ModelTypesAnalysis>();
+  const auto &KnownTypes = ModelTypes.getModelTypes(/*PointersOnly=*/false);
 
   for (auto *Alloca : ToReplace) {
     Builder.SetInsertPoint(Alloca);
@@ -124,7 +124,8 @@ bool MakeLocalVariables::runOnFunction(llvm::Function &F) {
 
     // Inject call to LocalVariable
     auto *LocalVarFunctionType = getLocalVarType(LocalVarLLVMType);
-    auto *LocalVarFunction = LocalVarPool.get(LocalVarLLVMType,
+    auto *LocalVarFunction = LocalVarPool.get(&M,
+                                              LocalVarLLVMType,
                                               LocalVarFunctionType,
                                               "LocalVariable");
     auto *LocalVarCall = Builder.CreateCall(LocalVarFunction,
@@ -134,7 +135,8 @@ bool MakeLocalVariables::runOnFunction(llvm::Function &F) {
     auto LocalVarType = LocalVarCall->getType();
     auto *AddressOfFunctionType = getAddressOfType(PtrSizedInteger,
                                                    LocalVarType);
-    auto *AddressOfFunction = AddressOfPool.get({ PtrSizedInteger,
+    auto *AddressOfFunction = AddressOfPool.get(&M,
+                                                { PtrSizedInteger,
                                                   LocalVarType },
                                                 AddressOfFunctionType,
                                                 "AddressOf");
@@ -158,6 +160,7 @@ bool MakeLocalVariables::runOnFunction(llvm::Function &F) {
     Alloca->eraseFromParent();
   }
 
+  ModelTypes.invalidate();
   return true;
 }
 
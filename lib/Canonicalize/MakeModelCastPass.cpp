@@ -2,6 +2,11 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+#include <optional>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
@@ -19,14 +24,13 @@
 #include "revng/Support/FunctionTags.h"
 #include "revng/Support/YAMLTraits.h"
 
-#include "revng-c/InitModelTypes/InitModelTypes.h"
+#include "revng-c/InitModelTypes/ModelTypesAnalysis.h"
 #include "revng-c/Support/FunctionTags.h"
 #include "revng-c/Support/IRHelpers.h"
 #include "revng-c/Support/ModelHelpers.h"
 #include "revng-c/TypeNames/LLVMTypeNames.h"
 
 using namespace llvm;
-using ModelTypesMap = std::map<const llvm::Value *, const model::QualifiedType>;
 
 struct SerializedType {
   Constant *StringType;
@@ -38,9 +42,24 @@ struct SerializedType {
 
 struct MakeModelCastPass : public llvm::FunctionPass {
 private:
-  ModelTypesMap TypeMap;
+  using QualifiedTypes = llvm::SmallVector<model::QualifiedType, 4>;
+
+private:
+  const ModelTypesMap *TypeMap = nullptr;
   const model::Function *ModelFunction = nullptr;
 
+  /// The expected types of the return values of the current function, the same
+  /// for all of its return instructions
+  std::optional<llvm::SmallVector<model::QualifiedType>> ReturnTypes;
+
+  /// The expected types of the arguments at the call sites of each prototype,
+  /// shared by all the call sites in the module
+  std::map<const model::Type *, QualifiedTypes> ArgumentTypes;
+
+  /// The QualifiedType serialized in each of the strings passed to ModelGEP and
+  /// AddressOf, which are shared by all the calls with the same base type
+  std::map<const llvm::Value *, model::QualifiedType> DeserializedTypes;
+
 public:
   static char ID;
 
@@ -48,10 +67,18 @@ public:
 
   bool runOnFunction(llvm::Function &F) override;
 
+  bool doFinalization(llvm::Module &) override {
+    ArgumentTypes.clear();
+    DeserializedTypes.clear();
+    return false;
+  }
+
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
     AU.setPreservesCFG();
     AU.addRequired<LoadModelWrapperPass>();
     AU.addRequired<FunctionMetadataCachePass>();
+    AU.addRequired<ModelTypesAnalysis>();
+    AU.addPreserved<ModelTypesAnalysis>();
   }
 
 private:
@@ -62,10 +89,39 @@ private:
   void createAndInjectModelCast(Instruction *,
                                 const SerializedType &,
                                 OpaqueFunctionsPool<Type *> &);
+
+  const QualifiedTypes &getArgumentTypes(const model::TypePath &Prototype);
+  const model::QualifiedType &getDeserializedType(llvm::Value *String,
+                                                  const model::Binary &);
 };
 
 using MMCP = MakeModelCastPass;
 
+const MMCP::QualifiedTypes &
+MMCP::getArgumentTypes(const model::TypePath &Prototype) {
+  auto [It, New] = ArgumentTypes.try_emplace(Prototype.getConst());
+  if (New) {
+    // Shadow pointers to the returned aggregate have no corresponding
+    // argument at call sites
+    using namespace abi::FunctionType;
+    const auto Layout = Layout::make(Prototype);
+    for (const Layout::Argument &Argument : Layout.Arguments)
+      if (Argument.Kind != ArgumentKind::ShadowPointerToAggregateReturnValue)
+        It->second.push_back(Argument.Type);
+  }
+  return It->second;
+}
+
+const model::QualifiedType &
+MMCP::getDeserializedType(llvm::Value *String, const model::Binary &Model) {
+  auto It = DeserializedTypes.find(String);
+  if (It == DeserializedTypes.end()) {
+    auto Type = deserializeFromLLVMString(String, Model);
+    It = DeserializedTypes.emplace(String, std::move(Type)).first;
+  }
+  return It->second;
+}
+
 std::vector<SerializedType>
 MMCP::serializeTypesForModelCast(FunctionMetadataCache &Cache,
                                  Instruction *I,
@@ -76,29 +132,34 @@ MMCP::serializeTypesForModelCast(FunctionMetadataCache &Cache,
   std::vector<SerializedType> Result;
   Module *M = I->getModule();
 
-  auto SerializeTypeFor =
-    [this, &Model, &Result, &M, &Cache](const llvm::Use &Op) {
-      // Check if we have strong model information about this operand
-      auto ModelTypes = getExpectedModelType(Cache, &Op, Model);
-
-      // Aggregates that do not correspond to model structs (e.g. return types
-      // of RawFunctionTypes that return more than one value) cannot be handled
-      // with casts, since we don't have a model::Type to cast them to.
-      if (ModelTypes.size() == 1) {
-        QualifiedType ExpectedType = ModelTypes.back();
-        revng_assert(ExpectedType.UnqualifiedType().isValid());
-
-        const QualifiedType &OperandType = TypeMap.at(Op.get());
-        if (ExpectedType != OperandType) {
-          revng_assert(ExpectedType.isScalar() and OperandType.isScalar());
-          // Create a cast only if the expected type is different from the
-          // actual type propagated until here
-          auto Type = SerializedType(serializeToLLVMString(ExpectedType, *M),
-                                     Op.getOperandNo());
-          Result.emplace_back(std::move(Type));
-        }
-      }
-    };
+  auto CastTo = [this, &Result, &M](const llvm::Use &Op,
+                                     const QualifiedType &ExpectedType) {
+    revng_assert(ExpectedType.UnqualifiedType().isValid());
+
+    const QualifiedType &OperandType = TypeMap->at(Op.get());
+    if (ExpectedType != OperandType) {
+      revng_assert(ExpectedType.isScalar() and OperandType.isScalar());
+      // Create a cast only if the expected type is different from the
+      // actual type propagated until here
+      auto Type = SerializedType(serializeToLLVMString(ExpectedType, *M),
+                                 Op.getOperandNo());
+      Result.emplace_back(std::move(Type));
+    }
+  };
+
+  // Aggregates that do not correspond to model structs (e.g. return types of
+  // RawFunctionTypes that return more than one value) cannot be handled with
+  // casts, since we don't have a model::Type to cast them to.
+  auto CastToAny = [&CastTo](const llvm::Use &Op,
+                             llvm::ArrayRef<QualifiedType> ModelTypes) {
+    if (ModelTypes.size() == 1)
+      CastTo(Op, ModelTypes.back());
+  };
+
+  auto SerializeTypeFor = [&Model, &Cache, &CastToAny](const llvm::Use &Op) {
+    // Check if we have strong model information about this operand
+    CastToAny(Op, getExpectedModelType(Cache, &Op, Model));
+  };
 
   if (auto *Call = dyn_cast<CallInst>(I)) {
     // Lifted functions have their prototype on the model
@@ -110,14 +171,24 @@ MMCP::serializeTypesForModelCast(FunctionMetadataCache &Cache,
         SerializeTypeFor(Call->getCalledOperandUse());
 
       // For all calls, check the formal arguments types
-      for (llvm::Use &Op : Call->args())
-        SerializeTypeFor(Op);
+      auto Prototype = Cache.getCallSitePrototype(Model, Call);
+      revng_assert(Prototype.isValid());
+      const QualifiedTypes &Arguments = getArgumentTypes(Prototype);
+      for (llvm::Use &Op : Call->args()) {
+        unsigned ArgNo = Call->getArgOperandNo(&Op);
+        revng_assert(ArgNo < Arguments.size());
+        CastTo(Op, Arguments[ArgNo]);
+      }
 
     } else if (FunctionTags::ModelGEP.isTagOf(Callee)
                or FunctionTags::ModelGEPRef.isTagOf(Callee)
                or FunctionTags::AddressOf.isTagOf(Callee)) {
-      // Check the type of the base operand
-      SerializeTypeFor(Call->getArgOperandUse(1));
+      // Check the type of the base operand, which is serialized in the first
+      // one
+      QualifiedType Base = getDeserializedType(Call->getArgOperand(0), Model);
+      if (FunctionTags::ModelGEP.isTagOf(Callee))
+        Base = Base.getPointerTo(Model.Architecture());
+      CastTo(Call->getArgOperandUse(1), Base);
     } else if (FunctionTags::BinaryNot.isTagOf(Callee)) {
       SerializeTypeFor(Call->getArgOperandUse(0));
     } else if (FunctionTags::StructInitializer.isTagOf(Callee)) {
@@ -128,12 +199,16 @@ MMCP::serializeTypesForModelCast(FunctionMetadataCache &Cache,
     }
   } else if (auto *Ret = dyn_cast<ReturnInst>(I)) {
     // Check the formal return type
-    if (Ret->getNumOperands() > 0)
-      SerializeTypeFor(Ret->getOperandUse(0));
+    if (Ret->getNumOperands() > 0) {
+      const llvm::Use &Op = Ret->getOperandUse(0);
+      if (not ReturnTypes)
+        ReturnTypes = getExpectedModelType(Cache, &Op, Model);
+      CastToAny(Op, *ReturnTypes);
+    }
 
   } else if (auto *SI = dyn_cast<StoreInst>(I)) {
-    auto &PtrOperandPtrType = TypeMap.at(SI->getPointerOperand());
-    auto &ValOperandType = TypeMap.at(SI->getValueOperand());
+    auto &PtrOperandPtrType = TypeMap->at(SI->getPointerOperand());
+    auto &ValOperandType = TypeMap->at(SI->getValueOperand());
 
     const model::Architecture::Values &Arch = Model.Architecture();
     QualifiedType ValOperandPtrType = ValOperandType.getPointerTo(Arch);
@@ -190,32 +265,40 @@ void MMCP::createAndInjectModelCast(Instruction *Ins,
 }
 
 bool MMCP::runOnFunction(Function &F) {
-  bool Changed = false;
-
-  OpaqueFunctionsPool<Type *> ModelCastPool(F.getParent(), false);
-  initModelCastPool(ModelCastPool);
-
   auto &ModelWrapper = getAnalysis<LoadModelWrapperPass>().get();
   const TupleTree<model::Binary> &Model = ModelWrapper.getReadOnlyModel();
 
   ModelFunction = llvmToModelFunction(*Model, F);
   revng_assert(ModelFunction != nullptr);
+  ReturnTypes.reset();
   auto &Cache = getAnalysis<FunctionMetadataCachePass>().get();
 
-  TypeMap = initModelTypes(Cache, F, ModelFunction, *Model, false);
+  auto &ModelTypes = getAnalysis<ModelTypesAnalysis>();
+  TypeMap = &ModelTypes.getModelTypes(/*PointersOnly=*/false);
 
+  std::vector<std::pair<Instruction *, std::vector<SerializedType>>> Casts;
   for (BasicBlock &BB : F) {
     for (Instruction &I : BB) {
       auto SerializedTypes = serializeTypesForModelCast(Cache, &I, *Model);
+      if (not SerializedTypes.empty())
+        Casts.emplace_back(&I, std::move(SerializedTypes));
+    }
+  }
 
-      if (SerializedTypes.empty())
-        continue;
+  TypeMap = nullptr;
 
-      Changed = true;
+  bool Changed = not Casts.empty();
+  if (Changed) {
+    // Initializing the pool scans the whole module, so only do it when there
+    // are casts to inject.
+    OpaqueFunctionsPool<Type *> ModelCastPool(F.getParent(), false);
+    initModelCastPool(ModelCastPool);
 
-      for (unsigned Idx = 0; Idx < SerializedTypes.size(); ++Idx)
-        createAndInjectModelCast(&I, SerializedTypes[Idx], ModelCastPool);
-    }
+    for (auto &[I, SerializedTypes] : Casts)
+      for (const SerializedType &ST : SerializedTypes)
+        createAndInjectModelCast(I, ST, ModelCastPool);
+
+    ModelTypes.invalidate();
   }
 
   return Changed;
@@ -4,11 +4,14 @@
 
 #include <compare>
 #include <limits>
+#include <map>
 #include <optional>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 
 #include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/STLExtras.h"
@@ -48,9 +51,10 @@
 #include "revng/Support/IRHelpers.h"
 #include "revng/Support/YAMLTraits.h"
 
-#include "revng-c/InitModelTypes/InitModelTypes.h"
+#include "revng-c/InitModelTypes/ModelTypesAnalysis.h"
 #include "revng-c/Support/FunctionTags.h"
 #include "revng-c/Support/IRHelpers.h"
+#include "revng-c/Support/IntegerFormatting.h"
 #include "revng-c/Support/ModelHelpers.h"
 
 using llvm::AnalysisUsage;
@@ -159,6 +163,9 @@ struct tuple_element<I, ModelTypedIRAddress> {
 } // end namespace std
 
 static std::string toDecimal(const APInt &Number) {
+  if (Number.getMinSignedBits() <= 64)
+    return FormattedInteger::signedDecimal(Number.getSExtValue()).str().str();
+
   llvm::SmallString<16> Result;
   Number.toString(Result, 10, true);
   return Result.str().str();
@@ -503,8 +510,6 @@ public:
   void dump() const debug_function { dump(llvm::dbgs()); }
 };
 
-using ModelTypesMap = std::map<const Value *, const model::QualifiedType>;
-
 static RecursiveCoroutine<std::optional<IRArithmetic>>
 getIRArithmetic(Use &AddressUse, const ModelTypesMap &PointerTypes) {
   revng_log(ModelGEPLog,
@@ -943,6 +948,77 @@ struct ModelGEPReplacementInfo {
 
 using QualifiedTypeOrNone = std::optional<model::QualifiedType>;
 
+// Memoizes the results of computeBest.
+//
+// The same (BaseType, IRSum, AccessedTypeOnIR) queries show up over and over
+// while traversing the model types, e.g. for each access to the same field of
+// a struct, and for the elements of all the arrays of the same type.
+// computeBest only depends on its arguments and on the model, which is
+// read-only in this pass, so its results can be reused.
+// The results of queries whose IRSum is a constant don't refer to any
+// llvm::Value, so they're valid for the whole module. All the others must be
+// dropped by forgetFunctionLocal() when we're done with a function.
+class BestMatchCache {
+private:
+  using Addends = SmallVector<std::pair<const ConstantInt *, const Value *>>;
+  using Key = std::tuple<model::QualifiedType,
+                         QualifiedTypeOrNone,
+                         unsigned,
+                         uint64_t,
+                         Addends>;
+
+  std::map<Key, ModelGEPReplacementInfo> ModuleWide;
+  std::map<Key, ModelGEPReplacementInfo> FunctionLocal;
+
+public:
+  const ModelGEPReplacementInfo *
+  find(const model::QualifiedType &BaseType,
+       const IRSummation &IRSum,
+       const QualifiedTypeOrNone &Accessed) const {
+    const auto &Map = mapFor(IRSum);
+    auto It = Map.find(makeKey(BaseType, IRSum, Accessed));
+    return It != Map.end() ? &It->second : nullptr;
+  }
+
+  void insert(const model::QualifiedType &BaseType,
+              const IRSummation &IRSum,
+              const QualifiedTypeOrNone &Accessed,
+              const ModelGEPReplacementInfo &Result) {
+    mapFor(IRSum).insert({ makeKey(BaseType, IRSum, Accessed), Result });
+  }
+
+  void forgetFunctionLocal() { FunctionLocal.clear(); }
+
+  void clear() {
+    ModuleWide.clear();
+    FunctionLocal.clear();
+  }
+
+private:
+  static Key makeKey(const model::QualifiedType &BaseType,
+                     const IRSummation &IRSum,
+                     const QualifiedTypeOrNone &Accessed) {
+    const auto &[Constant, Indices] = IRSum;
+    Addends IndexKey;
+    for (const auto &[Coefficient, Index] : Indices)
+      IndexKey.push_back({ Coefficient, Index });
+    return Key{ BaseType,
+                Accessed,
+                Constant.getBitWidth(),
+                Constant.getZExtValue(),
+                std::move(IndexKey) };
+  }
+
+  const std::map<Key, ModelGEPReplacementInfo> &
+  mapFor(const IRSummation &IRSum) const {
+    return IRSum.getIndices().empty() ? ModuleWide : FunctionLocal;
+  }
+
+  std::map<Key, ModelGEPReplacementInfo> &mapFor(const IRSummation &IRSum) {
+    return IRSum.getIndices().empty() ? ModuleWide : FunctionLocal;
+  }
+};
+
 // Compute the lower bound of DifferenceScore if we can try to match more things
 // in the GEPReplacementInfo
 static DifferenceScore lowerBound(const ModelGEPReplacementInfo &GEPInfo,
@@ -1063,13 +1139,15 @@ static RecursiveCoroutine<ModelGEPReplacementInfo>
 computeBest(const model::QualifiedType &BaseType,
             const IRSummation &IRSum,
             const std::optional<model::QualifiedType> &AccessedTypeOnIR,
-            model::VerifyHelper &VH);
+            model::VerifyHelper &VH,
+            BestMatchCache &BestMatches);
 
 static RecursiveCoroutine<ModelGEPReplacementInfo>
 computeBestInArray(const model::QualifiedType &BaseType,
                    const IRSummation &IRSum,
                    const std::optional<model::QualifiedType> &AccessedTypeOnIR,
-                   model::VerifyHelper &VH) {
+                   model::VerifyHelper &VH,
+                   BestMatchCache &BestMatches) {
 
   revng_log(ModelGEPLog, "computeBestInArray for IRSum: " << IRSum);
   auto ArrayIndent = LoggerIndent{ ModelGEPLog };
@@ -1242,7 +1320,8 @@ computeBestInArray(const model::QualifiedType &BaseType,
   auto ElementResult = rc_recur computeBest(ElementType,
                                             SummationInElement,
                                             AccessedTypeOnIR,
-                                            VH);
+                                            VH,
+                                            BestMatches);
   // Fixup the ElementResult to be comparable with BestInArray
   ElementResult.BaseType = BaseArray;
   ElementResult.IndexVector.insert(ElementResult.IndexVector.begin(),
@@ -1267,7 +1346,8 @@ static RecursiveCoroutine<ModelGEPReplacementInfo>
 computeBestInStruct(const model::QualifiedType &BaseStruct,
                     const IRSummation &IRSum,
                     const std::optional<model::QualifiedType> &AccessedTypeOnIR,
-                    model::VerifyHelper &VH) {
+                    model::VerifyHelper &VH,
+                    BestMatchCache &BestMatches) {
   revng_log(ModelGEPLog, "computeBestInStruct for IRSum: " << IRSum);
   auto StructIndent = LoggerIndent{ ModelGEPLog };
 
@@ -1356,10 +1436,31 @@ computeBestInStruct(const model::QualifiedType &BaseStruct,
       continue;
     }
 
+    // If the access doesn't fit in Field, computeBest on FieldType bails out
+    // right away, leaving all of SumInField as mismatch.
+    // Fields in a struct never overlap, so all the fields before this one end
+    // before it starts, and the access doesn't fit in them either. Their
+    // mismatch only grows the farther we go back, so as soon as one of them
+    // cannot improve on BestScore, none of the following ones can.
+    // Without an access size on the IR, an access starting right at the end of
+    // a field is considered in bound, so we can't stop early in that case.
+    uint64_t FieldSize = *FieldType.size(VH);
+    if (AccessedSizeOnIR != 0 and not SumInField.isZero()
+        and (SumInField.getConstant() + AccessedSizeOnIR).ugt(FieldSize)) {
+      auto OutOfField = DifferenceScore::nestedOutOfBound(SumInField, 1);
+      if (OutOfField >= BestScore) {
+        revng_log(ModelGEPLog,
+                  "Access does not fit in this Field nor in the previous "
+                  "ones: stop");
+        break;
+      }
+    }
+
     auto FieldResult = rc_recur computeBest(FieldType,
                                             SumInField,
                                             AccessedTypeOnIR,
-                                            VH);
+                                            VH,
+                                            BestMatches);
     // Fixup the FieldResult to be comparable with BestInStruct
     FieldResult.BaseType = BaseStruct;
     FieldResult.IndexVector.insert(FieldResult.IndexVector.begin(),
@@ -1384,7 +1485,8 @@ static RecursiveCoroutine<ModelGEPReplacementInfo>
 computeBestInUnion(const model::QualifiedType &BaseUnion,
                    const IRSummation &IRSum,
                    const std::optional<model::QualifiedType> &AccessedTypeOnIR,
-                   model::VerifyHelper &VH) {
+                   model::VerifyHelper &VH,
+                   BestMatchCache &BestMatches) {
 
   revng_log(ModelGEPLog, "computeBestInUnion for IRSum: " << IRSum);
   auto UnionIndent = LoggerIndent{ ModelGEPLog };
@@ -1457,7 +1559,8 @@ computeBestInUnion(const model::QualifiedType &BaseUnion,
     auto FieldResult = rc_recur computeBest(FieldType,
                                             IRSum,
                                             AccessedTypeOnIR,
-                                            VH);
+                                            VH,
+                                            BestMatches);
     // Fixup the FieldResult to be comparable with BestInUnion
     FieldResult.BaseType = BaseUnion;
     FieldResult.IndexVector.insert(FieldResult.IndexVector.begin(),
@@ -1479,10 +1582,11 @@ computeBestInUnion(const model::QualifiedType &BaseUnion,
 }
 
 static RecursiveCoroutine<ModelGEPReplacementInfo>
-computeBest(const model::QualifiedType &BaseType,
-            const IRSummation &IRSum,
-            const std::optional<model::QualifiedType> &AccessedTypeOnIR,
-            model::VerifyHelper &VH) {
+computeBestUncached(const model::QualifiedType &BaseType,
+                    const IRSummation &IRSum,
+                    const std::optional<model::QualifiedType> &AccessedTypeOnIR,
+                    model::VerifyHelper &VH,
+                    BestMatchCache &BestMatches) {
   revng_log(ModelGEPLog, "Computing Best ModelGEP for IRSum: " << IRSum);
   revng_assert(not BaseType.isVoid()
                and not BaseType.is(model::TypeKind::RawFunctionType)
@@ -1522,7 +1626,11 @@ computeBest(const model::QualifiedType &BaseType,
   if (UnwrappedBaseType.isArray()) {
     revng_log(ModelGEPLog, "Array");
     ModelGEPReplacementInfo ArrayResult = rc_recur
-      computeBestInArray(UnwrappedBaseType, IRSum, AccessedTypeOnIR, VH);
+      computeBestInArray(UnwrappedBaseType,
+                         IRSum,
+                         AccessedTypeOnIR,
+                         VH,
+                         BestMatches);
     revng_log(ModelGEPLog, "ArrayResult: " << ArrayResult);
 
     DifferenceScore ArrayBestScore = difference(ArrayResult,
@@ -1549,14 +1657,16 @@ computeBest(const model::QualifiedType &BaseType,
     Result = rc_recur computeBestInStruct(UnwrappedBaseType,
                                           IRSum,
                                           AccessedTypeOnIR,
-                                          VH);
+                                          VH,
+                                          BestMatches);
   } break;
 
   case model::TypeKind::UnionType: {
     Result = rc_recur computeBestInUnion(UnwrappedBaseType,
                                          IRSum,
                                          AccessedTypeOnIR,
-                                         VH);
+                                         VH,
+                                         BestMatches);
   } break;
 
   default:
@@ -1566,6 +1676,27 @@ computeBest(const model::QualifiedType &BaseType,
   rc_return Result;
 }
 
+static RecursiveCoroutine<ModelGEPReplacementInfo>
+computeBest(const model::QualifiedType &BaseType,
+            const IRSummation &IRSum,
+            const std::optional<model::QualifiedType> &AccessedTypeOnIR,
+            model::VerifyHelper &VH,
+            BestMatchCache &BestMatches) {
+  const auto *Cached = BestMatches.find(BaseType, IRSum, AccessedTypeOnIR);
+  if (Cached != nullptr) {
+    revng_log(ModelGEPLog, "Cached Best ModelGEP: " << *Cached);
+    rc_return *Cached;
+  }
+
+  auto Result = rc_recur computeBestUncached(BaseType,
+                                             IRSum,
+                                             AccessedTypeOnIR,
+                                             VH,
+                                             BestMatches);
+  BestMatches.insert(BaseType, IRSum, AccessedTypeOnIR, Result);
+  rc_return Result;
+}
+
 static model::QualifiedType getType(const model::QualifiedType &BaseType,
                                     const ChildIndexVector &IndexVector,
                                     model::VerifyHelper &VH) {
@@ -1923,22 +2054,21 @@ static std::vector<UseReplacementWithModelGEP>
 makeGEPReplacements(llvm::Function &F,
                     const model::Binary &Model,
                     model::VerifyHelper &VH,
-                    FunctionMetadataCache &Cache) {
+                    FunctionMetadataCache &Cache,
+                    BestMatchCache &BestMatches,
+                    ModelTypesMap PointerTypes) {
 
   std::vector<UseReplacementWithModelGEP> Result;
 
-  const model::Function *ModelF = llvmToModelFunction(Model, F);
-  revng_assert(ModelF);
-
-  // First, try to initialize a map for the known model types of llvm::Values
-  // that are reachable from F. If this fails, we just bail out because we
-  // cannot infer any modelGEP in F, if we have no type information to rely
-  // on.
-  ModelTypesMap PointerTypes = initModelTypes(Cache,
-                                              F,
-                                              ModelF,
-                                              Model,
-                                              /*PointersOnly=*/true);
+  revng_assert(llvmToModelFunction(Model, F));
+
+  // PointerTypes is taken by copy, since the types of the pointers we load
+  // through ModelGEPs are added to it below, and the results of
+  // ModelTypesAnalysis must not be affected by that.
+  //
+  // If there's no known model type for the llvm::Values that are reachable
+  // from F, we just bail out because we cannot infer any modelGEP in F, if we
+  // have no type information to rely on.
   if (PointerTypes.empty()) {
     revng_log(ModelGEPLog, "Model Types not found for " << F.getName());
     return Result;
@@ -2055,7 +2185,8 @@ makeGEPReplacements(llvm::Function &F,
         ModelGEPReplacementInfo GEPArgs = computeBest(FakeArray,
                                                       IRSum,
                                                       AccessedTypeOnIR,
-                                                      VH);
+                                                      VH,
+                                                      BestMatches);
 
         // Fix up the BaseType. This needs to contain the base type as per the
         // ModelGEP specification, not the fake array.
@@ -2157,11 +2288,25 @@ public:
 
   bool runOnFunction(llvm::Function &F) override;
 
+  bool doFinalization(llvm::Module &M) override {
+    BestMatches.clear();
+    VH.reset();
+    return false;
+  }
+
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.setPreservesCFG();
     AU.addRequired<LoadModelWrapperPass>();
     AU.addRequired<FunctionMetadataCachePass>();
+    AU.addRequired<ModelTypesAnalysis>();
+    AU.addPreserved<ModelTypesAnalysis>();
   }
+
+private:
+  BestMatchCache BestMatches;
+  /// The model is not changed while this pass runs, so the type sizes can be
+  /// cached across functions
+  std::optional<model::VerifyHelper> VH;
 };
 
 bool MakeModelGEPPass::runOnFunction(llvm::Function &F) {
@@ -2177,8 +2322,20 @@ bool MakeModelGEPPass::runOnFunction(llvm::Function &F) {
   auto &Model = getAnalysis<LoadModelWrapperPass>().get().getReadOnlyModel();
   auto &Cache = getAnalysis<FunctionMetadataCachePass>().get();
 
-  model::VerifyHelper VH;
-  auto GEPReplacements = makeGEPReplacements(F, *Model, VH, Cache);
+  // Initialize a map for the known model types of llvm::Values that are
+  // reachable from F.
+  auto &ModelTypes = getAnalysis<ModelTypesAnalysis>();
+  const auto &PointerTypes = ModelTypes.getModelTypes(/*PointersOnly=*/true);
+
+  if (not VH.has_value())
+    VH.emplace();
+  auto GEPReplacements = makeGEPReplacements(F,
+                                             *Model,
+                                             *VH,
+                                             Cache,
+                                             BestMatches,
+                                             PointerTypes);
+  BestMatches.forgetFunctionLocal();
 
   llvm::Module &M = *F.getParent();
   LLVMContext &Ctxt = M.getContext();
@@ -2193,7 +2350,7 @@ bool MakeModelGEPPass::runOnFunction(llvm::Function &F) {
 
   llvm::IntegerType *PtrSizedInteger = getPointerSizedInteger(Ctxt, *Model);
 
-  std::map<std::pair<Instruction *, Value *>, Value *> PhiIncomingsMaps;
+  llvm::DenseMap<std::pair<Instruction *, Value *>, Value *> PhiIncomingsMaps;
 
   for (auto &[TheUseToGEPify, BaseAddress, GEPArgs] : GEPReplacements) {
 
@@ -2238,7 +2395,7 @@ bool MakeModelGEPPass::runOnFunction(llvm::Function &F) {
     llvm::IntegerType *ModelGEPReturnedType;
 
     if (Mismatched.isZero()) {
-      uint64_t PointeeSize = *AccessedType.size(VH);
+      uint64_t PointeeSize = *AccessedType.size(*VH);
       ModelGEPReturnedType = llvm::IntegerType::get(Ctxt, PointeeSize * 8);
     } else {
       // Calculate the size of the GEPPed field
@@ -2384,6 +2541,8 @@ bool MakeModelGEPPass::runOnFunction(llvm::Function &F) {
 
   revng::verify(F.getParent());
 
+  if (Changed)
+    ModelTypes.invalidate();
   return Changed;
 }
 
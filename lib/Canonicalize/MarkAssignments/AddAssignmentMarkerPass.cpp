@@ -24,7 +24,7 @@
 #include "revng/Support/FunctionTags.h"
 #include "revng/Support/IRHelpers.h"
 
-#include "revng-c/InitModelTypes/InitModelTypes.h"
+#include "revng-c/InitModelTypes/ModelTypesAnalysis.h"
 #include "revng-c/Support/DecompilationHelpers.h"
 #include "revng-c/Support/FunctionTags.h"
 #include "revng-c/Support/Mangling.h"
@@ -38,15 +38,30 @@ struct AddAssignmentMarkersPass : public FunctionPass {
 public:
   static char ID;
 
+private:
+  SharedOpaqueFunctionsPool<Type *> LocalVarPool{ initLocalVarPool };
+  SharedOpaqueFunctionsPool<Type *> AssignPool{ initAssignPool };
+  SharedOpaqueFunctionsPool<Type *> CopyPool{ initCopyPool };
+
+public:
   AddAssignmentMarkersPass() : FunctionPass(ID) {}
 
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.setPreservesCFG();
     AU.addRequired<LoadModelWrapperPass>();
     AU.addRequired<FunctionMetadataCachePass>();
+    AU.addRequired<ModelTypesAnalysis>();
+    AU.addPreserved<ModelTypesAnalysis>();
   }
 
   bool runOnFunction(Function &F) override;
+
+  bool doFinalization(Module &) override {
+    LocalVarPool.clear();
+    AssignPool.clear();
+    CopyPool.clear();
+    return false;
+  }
 };
 
 static bool
@@ -108,23 +123,13 @@ bool AddAssignmentMarkersPass::runOnFunction(Function &F) {
   revng_assert(ModelFunction != nullptr);
   auto &Cache = getAnalysis<FunctionMetadataCachePass>().get();
 
-  auto TypeMap = initModelTypes(Cache,
-                                F,
-                                ModelFunction,
-                                *Model,
-                                /*PointerOnly*/ false);
+  auto &ModelTypes = getAnalysis<ModelTypesAnalysis>();
+  const auto &TypeMap = ModelTypes.getModelTypes(/*PointerOnly*/ false);
 
   Module *M = F.getParent();
   IRBuilder<> Builder(M->getContext());
   bool Changed = false;
 
-  OpaqueFunctionsPool<Type *> LocalVarPool(M, false);
-  initLocalVarPool(LocalVarPool);
-  OpaqueFunctionsPool<Type *> AssignPool(M, false);
-  initAssignPool(AssignPool);
-  OpaqueFunctionsPool<Type *> CopyPool(M, false);
-  initCopyPool(CopyPool);
-
   for (auto &[I, Flag] : Assignments) {
     auto *IType = I->getType();
 
@@ -162,7 +167,8 @@ bool AddAssignmentMarkersPass::runOnFunction(Function &F) {
       Builder.SetInsertPoint(&F.getEntryBlock().front());
 
       auto *LocalVarFunctionType = getLocalVarType(IType);
-      auto *LocalVarFunction = LocalVarPool.get(IType,
+      auto *LocalVarFunction = LocalVarPool.get(M,
+                                                IType,
                                                 LocalVarFunctionType,
                                                 "LocalVariable");
 
@@ -213,7 +219,8 @@ bool AddAssignmentMarkersPass::runOnFunction(Function &F) {
         if (DoCopy) {
           // Create a Copy to dereference the LocalVariable
           auto *CopyFnType = getCopyType(LocalVarCall->getType());
-          auto *CopyFunction = CopyPool.get(LocalVarCall->getType(),
+          auto *CopyFunction = CopyPool.get(M,
+                                            LocalVarCall->getType(),
                                             CopyFnType,
                                             "Copy");
           ValueToUse = Builder.CreateCall(CopyFunction, { LocalVarCall });
@@ -228,7 +235,7 @@ bool AddAssignmentMarkersPass::runOnFunction(Function &F) {
       // Inject Assign() function
       auto *AssignFnType = getAssignFunctionType(IType,
                                                  LocalVarCall->getType());
-      auto *AssignFunction = AssignPool.get(IType, AssignFnType, "Assign");
+      auto *AssignFunction = AssignPool.get(M, IType, AssignFnType, "Assign");
 
       Builder.CreateCall(AssignFunction, { I, LocalVarCall });
 
@@ -236,6 +243,8 @@ bool AddAssignmentMarkersPass::runOnFunction(Function &F) {
     }
   }
 
+  if (Changed)
+    ModelTypes.invalidate();
   return Changed;
 }
 
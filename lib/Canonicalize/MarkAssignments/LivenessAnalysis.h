@@ -4,19 +4,47 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SparseBitVector.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instruction.h"
 
-#include "revng/Support/MonotoneFramework.h"
-
 namespace LivenessAnalysis {
 
-using LiveSet = UnionMonotoneSet<const llvm::Instruction *>;
-using LivenessMap = std::map<const llvm::BasicBlock *, LiveSet>;
+/// The live-in sets of all the BasicBlocks of a Function.
+///
+/// Instructions are numbered densely, and each BasicBlock holds a sparse
+/// bitvector over such numbering.
+///
+/// NOTE: we only track Instructions, because anything that is not an
+///       Instruction is always live.
+/// NOTE: the incoming values of a PHINode are live at the end of the
+///       respective incoming BasicBlock, not at the start of the BasicBlock
+///       holding the PHINode.
+class LiveInSets {
+private:
+  friend LiveInSets computeLiveness(const llvm::Function &F);
 
-} // end namespace LivenessAnalysis
+  llvm::DenseMap<const llvm::Instruction *, unsigned> InstructionIDs;
+  llvm::DenseMap<const llvm::BasicBlock *, llvm::SparseBitVector<>> LiveIn;
+
+public:
+  bool isLiveIn(const llvm::Instruction *I, const llvm::BasicBlock *BB) const {
+    auto LiveInIt = LiveIn.find(BB);
+    if (LiveInIt == LiveIn.end())
+      return false;
 
-/// Performs liveness analysis on F. Returns a map with a BasicBlock as key, and
-/// the live-in set for that BasicBlock as mapped value.
-LivenessAnalysis::LivenessMap computeLiveness(const llvm::Function &F);
+    auto IDIt = InstructionIDs.find(I);
+    return IDIt != InstructionIDs.end() and LiveInIt->second.test(IDIt->second);
+  }
+};
+
+/// Performs liveness analysis on F.
+///
+/// Instead of iterating data-flow equations on all the BasicBlocks, each
+/// Instruction is walked backwards from its uses until its definition, so the
+/// cost is proportional to the size of the live ranges.
+LiveInSets computeLiveness(const llvm::Function &F);
+
+} // end namespace LivenessAnalysis
@@ -7,6 +7,8 @@
 
 #include <map>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
 
 #include "revng/ADT/ZipMapIterator.h"
@@ -33,87 +35,109 @@ Logger<> MarkLog{ "mark-assignments" };
 
 namespace MarkAssignments {
 
-using TaintSetT = std::set<const llvm::Instruction *>;
+/// How an Instruction accesses memory, as far as interference with
+/// side-effectful Instructions is concerned
+struct Access {
+  enum KindType {
+    // AddressOf, or anything that neither reads nor writes memory
+    None,
+    // Copies and Assigns of LocalVariables, which can only interfere with the
+    // accesses to the same LocalVariable
+    LocalVariable,
+    // Everything else that reads or writes memory
+    Memory,
+  };
 
-static bool haveInterferingSideEffects(const llvm::Instruction *SideEffectful,
-                                       const llvm::Instruction &Other,
-                                       const TaintSetT &TaintSet) {
-  // Branch instructions never have side effects, so no Other could possibly
-  // interfere with them.
-  if (isa<llvm::BranchInst>(SideEffectful)
-      or isa<llvm::SwitchInst>(SideEffectful))
-    return false;
+  KindType Kind = None;
+  const llvm::CallInst *Variable = nullptr;
+  bool IsWrite = false;
 
-  const auto MightInterfere = [SideEffectful](const llvm::Instruction *I) {
-    // AddressOf never has side effects.
-    if (auto *CallToAddressOf = getCallToTagged(I, FunctionTags::AddressOf)) {
-      return false;
-    }
+  static Access of(const llvm::Instruction &I) {
+    if (isCallToTagged(&I, FunctionTags::AddressOf))
+      return {};
 
-    // Copies from local variables never alias anyone else, except other
-    // instructions that copy or assign the same local variable
     llvm::CallInst *LocalVar = nullptr;
     bool IsWrite = false;
-    if (auto *CallToCopy = getCallToTagged(I, FunctionTags::Copy)) {
+    if (auto *CallToCopy = getCallToTagged(&I, FunctionTags::Copy)) {
       LocalVar = getCallToTagged(CallToCopy->getArgOperand(0),
                                  FunctionTags::LocalVariable);
-    } else if (auto *CallToAssign = getCallToTagged(I, FunctionTags::Assign)) {
+    } else if (auto *CallToAssign = getCallToTagged(&I, FunctionTags::Assign)) {
       LocalVar = getCallToTagged(CallToAssign->getArgOperand(1),
                                  FunctionTags::LocalVariable);
       IsWrite = true;
     }
 
-    llvm::CallInst *OtherLocalVar = nullptr;
-    if (auto *OtherCallToCopy = getCallToTagged(SideEffectful,
-                                                FunctionTags::Copy)) {
-      OtherLocalVar = getCallToTagged(OtherCallToCopy->getArgOperand(0),
-                                      FunctionTags::LocalVariable);
-    } else if (auto
-                 *OtherCallToAssign = getCallToTagged(SideEffectful,
-                                                      FunctionTags::Assign)) {
-      OtherLocalVar = getCallToTagged(OtherCallToAssign->getArgOperand(1),
-                                      FunctionTags::LocalVariable);
-      IsWrite = true;
-    }
+    if (LocalVar)
+      return { LocalVariable, LocalVar, IsWrite };
 
-    // If either of the instruction is an access to a local variable, we know
-    // that only other accesses to the same local variable can have interfering
-    // side effects
-    if (LocalVar or OtherLocalVar) {
-      // If only one accesses a local variable, then the other does not have
-      // interfering side effect for sure.
-      if (not LocalVar or not OtherLocalVar)
-        return false;
-      // If both access the same local variable and at least one is writing,
-      // they have interfering side effects
-      return IsWrite and (LocalVar == OtherLocalVar);
-    }
+    // TODO: we could check for aliasing between the side-effectful
+    // instructions and loads or other memory reads, but it's costly and
+    // complicated. We should do that only if necessary.
+    if (hasSideEffects(I) or isa<llvm::LoadInst>(&I)
+        or isCallToTagged(&I, FunctionTags::ReadsMemory))
+      return { Memory, nullptr, IsWrite };
 
-    if (hasSideEffects(*I))
-      return true;
+    return {};
+  }
+};
 
-    // TODO: we could check for aliasing between SideEffectful and I
-    // here, but it's costly and complicated. We should do that only if
-    // necessary.
-    if (isa<llvm::LoadInst>(I))
-      return true;
+using TaintSetT = std::set<const llvm::Instruction *>;
 
-    // TODO: we could check for aliasing between SideEffectful and I
-    // here, but it's costly and complicated. We should do that only if
-    // necessary.
-    if (isCallToTagged(I, FunctionTags::ReadsMemory))
-      return true;
+/// The set of Instructions tainting a pending Instruction, along with the
+/// union of their Accesses, so that checking for interference does not need to
+/// look at each of them.
+struct Taint {
+  TaintSetT Instructions;
 
+  bool AccessesMemory = false;
+
+  /// LocalVariables accessed by Instructions, and whether any of the accesses
+  /// is a write
+  llvm::SmallDenseMap<const llvm::CallInst *, bool, 2> LocalVariables;
+
+  void insert(const llvm::Instruction *I, const Access &A) {
+    Instructions.insert(I);
+    if (A.Kind == Access::Memory)
+      AccessesMemory = true;
+    else if (A.Kind == Access::LocalVariable)
+      LocalVariables[A.Variable] |= A.IsWrite;
+  }
+
+  void merge(Taint &&Other) {
+    Instructions.merge(std::move(Other.Instructions));
+    AccessesMemory |= Other.AccessesMemory;
+    for (const auto &[Variable, IsWritten] : Other.LocalVariables)
+      LocalVariables[Variable] |= IsWritten;
+  }
+};
+
+static bool haveInterferingSideEffects(const llvm::Instruction *SideEffectful,
+                                       const Access &SideEffectfulAccess,
+                                       const Taint &PendingTaint) {
+  // Branch instructions never have side effects, so no Other could possibly
+  // interfere with them.
+  if (isa<llvm::BranchInst>(SideEffectful)
+      or isa<llvm::SwitchInst>(SideEffectful))
     return false;
-  };
 
-  return MightInterfere(&Other) or llvm::any_of(TaintSet, MightInterfere);
+  // If SideEffectful accesses a local variable, only other accesses to the
+  // same local variable can interfere with it, and only if at least one of
+  // them is writing.
+  if (SideEffectfulAccess.Kind == Access::LocalVariable) {
+    auto It = PendingTaint.LocalVariables.find(SideEffectfulAccess.Variable);
+    if (It == PendingTaint.LocalVariables.end())
+      return false;
+    return It->second or SideEffectfulAccess.IsWrite;
+  }
+
+  // Otherwise, accesses to local variables never interfere with it
+  return PendingTaint.AccessesMemory;
 }
 
 class MonotoneTaintMap {
 public:
   using Instruction = llvm::Instruction;
-  using TaintMap = std::map<Instruction *, std::set<const Instruction *>>;
+  using TaintMap = std::map<Instruction *, Taint>;
   using const_iterator = typename TaintMap::const_iterator;
   using iterator = typename TaintMap::iterator;
   using size_type = typename TaintMap::size_type;
@@ -155,11 +179,11 @@ public:
     return TaintedPending.size();
   }
 
-  void insertWithTaint(Instruction *Key, TaintSetT &&Taint) {
+  void insertWithTaint(Instruction *Key, const Access &A, Taint &&T) {
     revng_assert(not IsBottom);
-    auto &TaintSet = TaintedPending[Key];
-    TaintSet.insert(Key);
-    TaintSet.merge(std::move(Taint));
+    auto &KeyTaint = TaintedPending[Key];
+    KeyTaint.insert(Key, A);
+    KeyTaint.merge(std::move(T));
   }
 
   const_iterator erase(const_iterator It) {
@@ -236,8 +260,8 @@ public:
         continue;
 
       revng_assert(PtrPair.first->first == PtrPair.second->first);
-      const auto &ThisTaintSet = PtrPair.first->second;
-      const auto &OtherTaintSet = PtrPair.second->second;
+      const auto &ThisTaintSet = PtrPair.first->second.Instructions;
+      const auto &OtherTaintSet = PtrPair.second->second.Instructions;
 
       if (not std::includes(OtherTaintSet.begin(),
                             OtherTaintSet.end(),
@@ -262,7 +286,11 @@ class Analysis : public MonotoneFramework<Analysis,
 private:
   llvm::Function &F;
   AssignmentMap Assignments;
-  LivenessAnalysis::LivenessMap LiveIn;
+  LivenessAnalysis::LiveInSets LiveIn;
+
+  /// The Access of each Instruction in F, computed once since transfer can
+  /// visit each BasicBlock many times
+  llvm::DenseMap<const llvm::Instruction *, Access> Accesses;
 
 public:
   using Base = MonotoneFramework<Analysis,
@@ -275,13 +303,15 @@ public:
 
 public:
   Analysis(llvm::Function &F) :
-    Base(&F.getEntryBlock()), F(F), Assignments(), LiveIn() {
+    Base(&F.getEntryBlock()), F(F), Assignments(), LiveIn(), Accesses() {
     Base::registerExtremal(&F.getEntryBlock());
   }
 
   void initialize() {
     Base::initialize();
-    LiveIn = computeLiveness(F);
+    LiveIn = LivenessAnalysis::computeLiveness(F);
+    for (llvm::Instruction &I : llvm::instructions(F))
+      Accesses[&I] = Access::of(I);
   }
 
   AssignmentMap &&takeAssignments() { return std::move(Assignments); }
@@ -306,16 +336,10 @@ public:
              const llvm::BasicBlock * /*Source*/,
              const llvm::BasicBlock *Destination) const {
 
-    auto LiveInIt = LiveIn.find(Destination);
-    if (LiveInIt == LiveIn.end())
-      return std::nullopt;
-
-    const auto &LiveInSet = LiveInIt->second;
-
     LatticeElement Result = Original.copy();
 
-    const auto IsDead = [&LiveInSet](const llvm::Instruction *I) {
-      return not LiveInSet.contains(I);
+    const auto IsDead = [this, Destination](const llvm::Instruction *I) {
+      return not LiveIn.isLiveIn(I, Destination);
     };
 
     for (auto ResultsIt = Result.begin(); ResultsIt != Result.end();) {
@@ -350,7 +374,7 @@ public:
       revng_log(MarkLog,
                 "Analyzing Instr: '" << &I << "': " << dumpToString(&I));
 
-      TaintSetT OperandTaintSet;
+      Taint OperandTaintSet;
       {
         // Look at the operands of I.
         // If some of them is still pending, we want to remove them from
@@ -396,7 +420,7 @@ public:
         // The OperandTaintSet is discarded here. This is not a problem,
         // because it should always be empty.
         revng_assert(not hasSideEffects(I));
-        revng_assert(OperandTaintSet.empty());
+        revng_assert(OperandTaintSet.Instructions.empty());
         continue;
       }
 
@@ -438,13 +462,14 @@ public:
           // all the instructions that are still pending and have interfering
           // side effects.
           revng_log(MarkLog, "Assign Pending");
+          Access IAccess = Accesses.lookup(&I);
 
           for (auto PendingIt = Pending.begin(); PendingIt != Pending.end();) {
-            const auto [PendingInstr, TaintSet] = *PendingIt;
+            const auto &[PendingInstr, PendingTaint] = *PendingIt;
             revng_log(MarkLog,
                       "Pending: '" << PendingInstr
                                    << "': " << dumpToString(PendingInstr));
-            if (haveInterferingSideEffects(&I, *PendingInstr, TaintSet)) {
+            if (haveInterferingSideEffects(&I, IAccess, PendingTaint)) {
               Assignments[PendingInstr].set(Reasons::HasInterferingSideEffects);
               revng_log(MarkLog, "HasInterferingSideEffects");
               PendingIt = Pending.erase(PendingIt);
@@ -457,7 +482,9 @@ public:
         // I is not assigned and it's not void (which are always emitted),
         // so we have to track that it's pending.
         if (not I.getType()->isVoidTy()) {
-          Pending.insertWithTaint(&I, std::move(OperandTaintSet));
+          Pending.insertWithTaint(&I,
+                                  Accesses.lookup(&I),
+                                  std::move(OperandTaintSet));
           revng_log(MarkLog,
                     "Add to pending: '" << &I << "': " << dumpToString(&I));
         } else {
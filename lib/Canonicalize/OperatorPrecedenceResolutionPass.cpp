@@ -4,6 +4,7 @@
 
 #include <array>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
@@ -131,139 +132,204 @@ static constexpr std::array<const OperatorInfo, 37>
     OperatorInfo{ Instruction::Call, 0, LeftToRight, NAry },
   };
 
-static OperatorInfo
-getPrecedence(const std::array<const OperatorInfo, 37> *Table,
-              unsigned Opcode) {
-  auto It = llvm::find_if(*Table, [&](const auto &Elem) {
-    return Elem.Opcode == Opcode;
-  });
-  revng_assert(It != Table->end());
-  return *It;
+// Tables indexed by opcode, so that looking up the OperatorInfo of an opcode is
+// a single access.
+static constexpr unsigned MaxOpcode = CustomInstruction::BooleanNot;
+using PrecedenceTable = std::array<OperatorInfo, MaxOpcode + 1>;
+
+static constexpr PrecedenceTable
+indexByOpcode(const std::array<const OperatorInfo, 37> &Infos) {
+  // Opcode 0 is not a valid opcode, so we use it to mark the missing entries
+  PrecedenceTable Result{};
+  for (const OperatorInfo &Info : Infos)
+    Result[Info.Opcode] = Info;
+  return Result;
 }
 
-static bool isCustomOpcode(const Value *I) {
-  const auto *Call = dyn_cast<CallInst>(I);
-  if (nullptr == Call)
-    return false;
+static constexpr PrecedenceTable
+  COpPrecedenceTable = indexByOpcode(LLVMOpcodeToCOpPrecedenceArray);
 
-  const auto *CalledFunc = Call->getCalledFunction();
-  if (nullptr == CalledFunc)
-    return false;
+static constexpr PrecedenceTable
+  NopOpPrecedenceTable = indexByOpcode(LLVMOpcodeToNopOpPrecedenceArray);
 
-  if (FunctionTags::AddressOf.isTagOf(CalledFunc)
-      or FunctionTags::AllocatesLocalVariable.isTagOf(CalledFunc)
-      or FunctionTags::Assign.isTagOf(CalledFunc)
-      or FunctionTags::BinaryNot.isTagOf(CalledFunc)
-      or FunctionTags::BooleanNot.isTagOf(CalledFunc)
-      or FunctionTags::Copy.isTagOf(CalledFunc)
-      or FunctionTags::ModelCast.isTagOf(CalledFunc)
-      or FunctionTags::ModelGEP.isTagOf(CalledFunc)
-      or FunctionTags::ModelGEPRef.isTagOf(CalledFunc)
-      or FunctionTags::OpaqueExtractValue.isTagOf(CalledFunc)
-      or FunctionTags::SegmentRef.isTagOf(CalledFunc)
-      or FunctionTags::UnaryMinus.isTagOf(CalledFunc))
-    return true;
-
-  return false;
+static OperatorInfo getPrecedence(const PrecedenceTable *Table,
+                                  unsigned Opcode) {
+  revng_assert(Opcode < Table->size());
+  const OperatorInfo &Info = (*Table)[Opcode];
+  revng_assert(Info.Opcode == Opcode);
+  return Info;
 }
 
-static unsigned getCustomOpcode(const Instruction *I) {
-  revng_assert(isCustomOpcode(I));
-
-  auto *CalledFunc = cast<CallInst>(I)->getCalledFunction();
-  revng_assert(CalledFunc);
-
-  if (FunctionTags::AddressOf.isTagOf(CalledFunc))
-    return CustomInstruction::AddressOf;
-  else if (FunctionTags::Assign.isTagOf(CalledFunc))
-    return CustomInstruction::Assignment;
-  else if (FunctionTags::AllocatesLocalVariable.isTagOf(CalledFunc))
-    return CustomInstruction::LocalVariable;
-  else if (FunctionTags::ModelCast.isTagOf(CalledFunc))
-    return CustomInstruction::Cast;
-  else if (FunctionTags::ModelGEP.isTagOf(CalledFunc)) {
+namespace {
+
+/// Tells which custom opcode, if any, a call represents.
+///
+/// Custom opcodes are identified by the FunctionTags of the called function.
+/// Looking them up is not cheap, and the same few functions are called all over
+/// the module, so the classification of each callee is memoized.
+class CustomOpcodeClassifier {
+private:
+  enum CalleeKind : uint8_t {
+    NotCustom,
+    // The custom opcode only depends on the callee
+    Fixed,
+    // The custom opcode also depends on the arguments of the call
+    ModelGEP,
+    ModelGEPRef,
+  };
+
+  struct CalleeInfo {
+    CalleeKind Kind;
+    unsigned Opcode;
+  };
+
+  llvm::DenseMap<const llvm::Function *, CalleeInfo> Callees;
+
+public:
+  void clear() { Callees.clear(); }
+
+  bool isCustomOpcode(const Value *I) {
+    const auto *Call = dyn_cast<CallInst>(I);
+    if (nullptr == Call)
+      return false;
+
+    const auto *CalledFunc = Call->getCalledFunction();
+    if (nullptr == CalledFunc)
+      return false;
+
+    return classify(CalledFunc).Kind != NotCustom;
+  }
+
+  unsigned getCustomOpcode(const Instruction *I) {
+    revng_assert(isCustomOpcode(I));
+
     auto *Call = cast<CallInst>(I);
-    if (Call->arg_size() > 3)
-      return CustomInstruction::MemberAccess;
-    auto *ConstantArrayIndex = dyn_cast<ConstantInt>(Call->getArgOperand(2));
-    if (ConstantArrayIndex and ConstantArrayIndex->isZero())
-      return CustomInstruction::Indirection;
-    return CustomInstruction::MemberAccess;
-  } else if (FunctionTags::ModelGEPRef.isTagOf(CalledFunc)) {
-    if (cast<CallInst>(I)->arg_size() > 2)
+    auto [Kind, Opcode] = classify(Call->getCalledFunction());
+
+    switch (Kind) {
+    case Fixed:
+      return Opcode;
+
+    case ModelGEP: {
+      if (Call->arg_size() > 3)
+        return CustomInstruction::MemberAccess;
+      auto *ConstantArrayIndex = dyn_cast<ConstantInt>(Call->getArgOperand(2));
+      if (ConstantArrayIndex and ConstantArrayIndex->isZero())
+        return CustomInstruction::Indirection;
       return CustomInstruction::MemberAccess;
-    return CustomInstruction::Transparent;
-  } else if (FunctionTags::OpaqueExtractValue.isTagOf(CalledFunc)) {
-    return CustomInstruction::MemberAccess;
-  } else if (FunctionTags::Copy.isTagOf(CalledFunc)) {
-    return CustomInstruction::Transparent;
-  } else if (FunctionTags::SegmentRef.isTagOf(CalledFunc)) {
-    return CustomInstruction::SegmentRef;
-  } else if (FunctionTags::UnaryMinus.isTagOf(CalledFunc)) {
-    return CustomInstruction::UnaryMinus;
-  } else if (FunctionTags::BinaryNot.isTagOf(CalledFunc)) {
-    return CustomInstruction::BinaryNot;
-  } else if (FunctionTags::BooleanNot.isTagOf(CalledFunc)) {
-    return CustomInstruction::BooleanNot;
+    }
+
+    case ModelGEPRef: {
+      if (Call->arg_size() > 2)
+        return CustomInstruction::MemberAccess;
+      return CustomInstruction::Transparent;
+    }
+
+    case NotCustom:
+    default:
+      revng_abort("unhandled custom opcode");
+    }
   }
 
-  revng_abort("unhandled custom opcode");
-}
+  unsigned getOpcode(const Instruction *I) {
+    if (isa<CallInst>(I))
+      if (isCustomOpcode(I))
+        return getCustomOpcode(I);
 
-static unsigned getOpcode(const Instruction *I) {
-  if (isa<CallInst>(I))
-    if (isCustomOpcode(I))
-      return getCustomOpcode(I);
+    return I->getOpcode();
+  }
 
-  return I->getOpcode();
-}
+  bool isTransparentOpCode(const Value *V) {
+    if (isa<IntToPtrInst>(V) or isa<PtrToIntInst>(V) or isa<BitCastInst>(V)
+        or isa<FreezeInst>(V))
+      return true;
 
-static bool isTransparentOpCode(const Value *V) {
-  if (isa<IntToPtrInst>(V) or isa<PtrToIntInst>(V) or isa<BitCastInst>(V)
-      or isa<FreezeInst>(V))
-    return true;
+    const auto *I = dyn_cast<Instruction>(V);
+    if (nullptr == I)
+      return false;
 
-  const auto *I = dyn_cast<Instruction>(V);
-  if (nullptr == I)
-    return false;
+    return isCustomOpcode(I)
+           and getCustomOpcode(I) == CustomInstruction::Transparent;
+  }
 
-  return isCustomOpcode(I)
-         and getCustomOpcode(I) == CustomInstruction::Transparent;
-}
+  Value *traverseTransparentOpcodes(Value *I) {
+    while (isa<Instruction>(I) and isTransparentOpCode(I)) {
+      if (isa<IntToPtrInst>(I) or isa<PtrToIntInst>(I) or isa<BitCastInst>(I)
+          or isa<FreezeInst>(I))
+        I = cast<Instruction>(I)->getOperand(0);
+      else if (auto *CallToCopy = getCallToTagged(I, FunctionTags::Copy))
+        I = CallToCopy->getArgOperand(0);
+      else if (auto *CallToMGR = getCallToTagged(I, FunctionTags::ModelGEPRef))
+        I = CallToMGR->getArgOperand(1);
+      else
+        revng_abort("unexpected transparent opcode");
+    }
+    return I;
+  }
 
-static Value *traverseTransparentOpcodes(Value *I) {
-  while (isa<Instruction>(I) and isTransparentOpCode(I)) {
-    if (isa<IntToPtrInst>(I) or isa<PtrToIntInst>(I) or isa<BitCastInst>(I)
-        or isa<FreezeInst>(I))
-      I = cast<Instruction>(I)->getOperand(0);
-    else if (auto *CallToCopy = getCallToTagged(I, FunctionTags::Copy))
-      I = CallToCopy->getArgOperand(0);
-    else if (auto *CallToMGR = getCallToTagged(I, FunctionTags::ModelGEPRef))
-      I = CallToMGR->getArgOperand(1);
-    else
-      revng_abort("unexpected transparent opcode");
+private:
+  CalleeInfo classify(const llvm::Function *CalledFunc) {
+    auto [It, New] = Callees.try_emplace(CalledFunc);
+    if (New)
+      It->second = computeCalleeInfo(CalledFunc);
+    return It->second;
   }
-  return I;
-}
+
+  static CalleeInfo computeCalleeInfo(const llvm::Function *CalledFunc) {
+    if (FunctionTags::AddressOf.isTagOf(CalledFunc))
+      return { Fixed, CustomInstruction::AddressOf };
+    else if (FunctionTags::Assign.isTagOf(CalledFunc))
+      return { Fixed, CustomInstruction::Assignment };
+    else if (FunctionTags::AllocatesLocalVariable.isTagOf(CalledFunc))
+      return { Fixed, CustomInstruction::LocalVariable };
+    else if (FunctionTags::ModelCast.isTagOf(CalledFunc))
+      return { Fixed, CustomInstruction::Cast };
+    else if (FunctionTags::ModelGEP.isTagOf(CalledFunc))
+      return { ModelGEP, 0 };
+    else if (FunctionTags::ModelGEPRef.isTagOf(CalledFunc))
+      return { ModelGEPRef, 0 };
+    else if (FunctionTags::OpaqueExtractValue.isTagOf(CalledFunc))
+      return { Fixed, CustomInstruction::MemberAccess };
+    else if (FunctionTags::Copy.isTagOf(CalledFunc))
+      return { Fixed, CustomInstruction::Transparent };
+    else if (FunctionTags::SegmentRef.isTagOf(CalledFunc))
+      return { Fixed, CustomInstruction::SegmentRef };
+    else if (FunctionTags::UnaryMinus.isTagOf(CalledFunc))
+      return { Fixed, CustomInstruction::UnaryMinus };
+    else if (FunctionTags::BinaryNot.isTagOf(CalledFunc))
+      return { Fixed, CustomInstruction::BinaryNot };
+    else if (FunctionTags::BooleanNot.isTagOf(CalledFunc))
+      return { Fixed, CustomInstruction::BooleanNot };
+
+    return { NotCustom, 0 };
+  }
+};
+
+} // namespace
 
 struct OperatorPrecedenceResolutionPass : public FunctionPass {
 private:
-  const std::array<const OperatorInfo, 37>
-    *LLVMOpcodeToLangOpPrecedenceArray = nullptr;
+  const PrecedenceTable *LLVMOpcodeToLangOpPrecedenceArray = nullptr;
+  CustomOpcodeClassifier Classifier;
 
 public:
   static char ID;
 
   OperatorPrecedenceResolutionPass() : FunctionPass(ID) {
     if (LanguageName == "C" || LanguageName == "c")
-      LLVMOpcodeToLangOpPrecedenceArray = &LLVMOpcodeToCOpPrecedenceArray;
+      LLVMOpcodeToLangOpPrecedenceArray = &COpPrecedenceTable;
     else if (LanguageName == "NOP" || LanguageName == "nop")
-      LLVMOpcodeToLangOpPrecedenceArray = &LLVMOpcodeToNopOpPrecedenceArray;
+      LLVMOpcodeToLangOpPrecedenceArray = &NopOpPrecedenceTable;
     revng_assert(LLVMOpcodeToLangOpPrecedenceArray);
   }
 
   bool runOnFunction(Function &F) override;
 
+  bool doFinalization(Module &M) override {
+    Classifier.clear();
+    return false;
+  }
+
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.setPreservesCFG();
   }
@@ -281,7 +347,7 @@ bool OPRP::needsParentheses(Instruction *I, Use &U) {
 
   // The following are transparent in C as we emit it, so we never put
   // parentheses around their operands.
-  if (isTransparentOpCode(I))
+  if (Classifier.isTransparentOpCode(I))
     return false;
 
   // The remaining instructions can be divided in 2 categories:
@@ -296,8 +362,8 @@ bool OPRP::needsParentheses(Instruction *I, Use &U) {
   // it's necessary, leaving the evaluation of operator precedence and
   // associativity only for later when really necessary.
 
-  if (isa<CallInst>(I) and isCustomOpcode(I)) {
-    switch (getCustomOpcode(I)) {
+  if (isa<CallInst>(I) and Classifier.isCustomOpcode(I)) {
+    switch (Classifier.getCustomOpcode(I)) {
     // These instructions never need parentheses around their operands as well.
     case CustomInstruction::Assignment:
     case CustomInstruction::LocalVariable:
@@ -356,7 +422,8 @@ bool OPRP::needsParentheses(Instruction *I, Use &U) {
 
   // Traverse all the transparent opcodes around the operand, until we can
   // really see the operand itself.
-  Instruction *Op = dyn_cast<Instruction>(traverseTransparentOpcodes(U.get()));
+  Value *Operand = Classifier.traverseTransparentOpcodes(U.get());
+  Instruction *Op = dyn_cast<Instruction>(Operand);
 
   // If the operand is not an instruction (e.g. constant, arguments), don't emit
   // parentheses, because in C we always emit it as an identifiers, which never
@@ -374,15 +441,18 @@ bool OPRP::needsParentheses(Instruction *I, Use &U) {
 
   // If the operand is one of the following custom opcode, there's no need of
   // parentheses around it.
-  if (isCustomOpcode(Op)
-      and (getCustomOpcode(Op) == CustomInstruction::Assignment
-           or getCustomOpcode(Op) == CustomInstruction::LocalVariable
-           or getCustomOpcode(Op) == CustomInstruction::SegmentRef))
-    return false;
+  if (Classifier.isCustomOpcode(Op)) {
+    unsigned OpCustomOpcode = Classifier.getCustomOpcode(Op);
+    if (OpCustomOpcode == CustomInstruction::Assignment
+        or OpCustomOpcode == CustomInstruction::LocalVariable
+        or OpCustomOpcode == CustomInstruction::SegmentRef)
+      return false;
+  }
 
   // For calls that are not custom opcodes, we only have to check the operator
   // precedence for the called operand, not for the arguments.
-  if (auto *Call = dyn_cast<CallInst>(I); Call and not isCustomOpcode(Call))
+  if (auto *Call = dyn_cast<CallInst>(I);
+      Call and not Classifier.isCustomOpcode(Call))
     if (&U != &Call->getCalledOperandUse())
       return false;
 
@@ -390,13 +460,13 @@ bool OPRP::needsParentheses(Instruction *I, Use &U) {
         InstructionPrecedence,
         InstructionAssociativity,
         InstructionArity] = getPrecedence(LLVMOpcodeToLangOpPrecedenceArray,
-                                          getOpcode(I));
+                                          Classifier.getOpcode(I));
 
   auto [OperandOpcode,
         OperandPrecedence,
         OperandAssociativity,
         OperandArity] = getPrecedence(LLVMOpcodeToLangOpPrecedenceArray,
-                                      getOpcode(Op));
+                                      Classifier.getOpcode(Op));
 
   auto Cmp = InstructionPrecedence <=> OperandPrecedence;
   // If the precedence of the instruction and the operand is the same, we have
@@ -464,9 +534,6 @@ bool OPRP::needsParentheses(Instruction *I, Use &U) {
 }
 
 bool OPRP::runOnFunction(Function &F) {
-  OpaqueFunctionsPool<Type *> ParenthesesPool(F.getParent(), false);
-  initParenthesesPool(ParenthesesPool);
-
   std::vector<std::pair<Instruction *, Use *>> InstructionsToBeParenthesized;
   for (BasicBlock &BB : F)
     for (Instruction &I : BB)
@@ -480,6 +547,11 @@ bool OPRP::runOnFunction(Function &F) {
     return false;
   }
 
+  // Initializing the pool scans the whole module, so only do it when there is
+  // something to parenthesize.
+  OpaqueFunctionsPool<Type *> ParenthesesPool(F.getParent(), false);
+  initParenthesesPool(ParenthesesPool);
+
   IRBuilder<> Builder(F.getContext());
   for (const auto &[I, Op] : InstructionsToBeParenthesized) {
     Builder.SetInsertPoint(I);
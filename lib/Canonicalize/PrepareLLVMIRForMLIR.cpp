@@ -84,53 +84,45 @@ static void handleFunctionEntryPoint(llvm::Function &F) {
   }
 }
 
-static void saveFunctionEntryPointInDISubprogram(Module &M) {
-  for (llvm::Function &F : M)
-    handleFunctionEntryPoint(F);
-}
+static void adjustRevngMetadata(llvm::Function &F) {
+  // revng abuses debug info in order to keep mapping between addresses of
+  // instructions and decompiled C code. revng generates LLVM IR that is good
+  // enough, by attaching !dbg/DILocation attachments to llvm::Instructions
+  // only, and by avoiding to create/attach different !dbg/DISubprogram
+  // attachment to each llvm::Function. By avoiding the later, we are 1) able
+  // to use just one DISubprogram from root function (please note that
+  // DIlocation needs a DISubprogram); 2) we have generated away less
+  // DISubprograms, since if we chose to attach to each LLVM Function we need to
+  // create a new DISubprogram for each of them, so it is away more debug info
+  // to carry along the pipeline; 3) by avoiding the attachment on LLVM Function
+  // we avoid verifying of debug info inside functions, such as the one we are
+  // fixing very late - this could be annoying for LLVM Passes in the pipeline,
+  // since some fixes like this one we are applying here very late, when
+  // producing MLIR could be needed at several places/passes earlier, e.g. if a
+  // Pass creates a call to a function that could be inlined, it needs to have
+  // a !dbg/DILocation attachment (at least an artificial one -
+  // DILocation(line: 0)), since calls to inlinable functions must have a !dbg
+  // attachment.
+  //
+  // The location is the same for all the calls in the function, it's uniqued
+  // only once.
+  DILocation *CallLocation = nullptr;
+  if (DISubprogram *SP = F.getSubprogram())
+    CallLocation = DILocation::get(F.getContext(), 0, 0, SP, nullptr);
+
+  for (llvm::Instruction &I : llvm::instructions(F)) {
+    // Clean up metadata we don't need. Also, we abused this metadata by
+    // attaching some non standard register state metadata to stores and
+    // loads, and we don't want it preserved in the LLVM Dialect.
+    if (I.hasMetadata(llvm::LLVMContext::MD_noalias))
+      I.setMetadata(llvm::LLVMContext::MD_noalias, nullptr);
+
+    if (CallLocation == nullptr)
+      continue;
 
-static void adjustRevngMetadata(Module &M) {
-  for (llvm::Function &F : M) {
-    for (llvm::BasicBlock &BB : F) {
-      for (llvm::Instruction &I : BB) {
-        // Clean up metadata we don't need. Also, we abused this metadata by
-        // attaching some non standard register state metadata to stores and
-        // loads, and we don't want it preserved in the LLVM Dialect.
-        if (MDNode *Node = I.getMetadata(llvm::LLVMContext::MD_noalias))
-          I.setMetadata(llvm::LLVMContext::MD_noalias, nullptr);
-
-        if (auto *Call = dyn_cast<CallBase>(&I)) {
-          // revng abuses debug info in order to keep mapping between addresses
-          // of instructions and decompiled C code. revng generates LLVM IR that
-          // is good enough, by attaching !dbg/DILocation attachments to
-          // llvm::Instructions only, and by avoiding to create/attach different
-          // !dbg/DISubprogram attachment to each llvm::Function. By avoiding
-          // the later, we are 1) able to use just one DISubprogram from root
-          // function (please note that DIlocation needs a DISubprogram); 2) we
-          // have generated away less DISubprograms, since if we chose to attach
-          // to each LLVM Function we need to create a new DISubprogram for each
-          // of them, so it is away more debug info to carry along the pipeline;
-          // 3) by avoiding the attachment on LLVM Function we avoid verifying
-          // of debug info inside functions, such as the one we are fixing very
-          // late - this could be annoying for LLVM Passes in the pipeline,
-          // since some fixes like this one we are applying here very late, when
-          // producing MLIR could be needed at several places/passes earlier,
-          // e.g. if a Pass creates a call to a function that could be inlined,
-          // it needs to have a !dbg/DILocation attachment (at least an
-          // artificial one - DILocation(line: 0)), since calls to inlinable
-          // functions must have a !dbg attachment.
-          if (Call->getFunction()->getSubprogram()
-              and Call->getCalledFunction()) {
-            auto Location = DILocation::get(M.getContext(),
-                                            0,
-                                            0,
-                                            F.getSubprogram(),
-                                            nullptr);
-            Call->setDebugLoc(Location);
-          }
-        }
-      }
-    }
+    if (auto *Call = dyn_cast<CallBase>(&I))
+      if (Call->getCalledFunction())
+        Call->setDebugLoc(CallLocation);
   }
 }
 
@@ -279,11 +271,6 @@ static void tagFunction(Function &F) {
   }
 }
 
-static void saveFunctionTags(Module &M) {
-  for (llvm::Function &F : M)
-    tagFunction(F);
-}
-
 struct PrepareLLVMIRForMLIRPass : public ModulePass {
 public:
   static char ID;
@@ -293,9 +280,15 @@ public:
   bool runOnModule(Module &M) override {
     auto &Model = getAnalysis<LoadModelWrapperPass>().get().getReadOnlyModel();
     adjustAnonymousStructs(M, *Model);
-    saveFunctionTags(M);
-    saveFunctionEntryPointInDISubprogram(M);
-    adjustRevngMetadata(M);
+
+    // All the other changes only involve the function they are made on, do
+    // them one function at a time, so that each function is visited while it
+    // is still in cache
+    for (llvm::Function &F : M) {
+      tagFunction(F);
+      handleFunctionEntryPoint(F);
+      adjustRevngMetadata(F);
+    }
 
     return true;
   }
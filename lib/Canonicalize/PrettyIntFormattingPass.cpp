@@ -63,6 +63,21 @@ bool PrettyIntFormatting::runOnFunction(llvm::Function &F) {
   const model::Binary
     &Model = *getAnalysis<LoadModelWrapperPass>().get().getReadOnlyModel();
 
+  std::vector<FormatInt> IntsToBeFormatted;
+
+  for (llvm::Instruction &I : llvm::instructions(F)) {
+    for (llvm::Use &U : I.operands()) {
+      if (auto formatting = getIntFormat(I, U, Model); formatting) {
+        IntsToBeFormatted.push_back(*formatting);
+      }
+    }
+  }
+
+  if (IntsToBeFormatted.empty())
+    return false;
+
+  // Initializing the pools scans the whole module, so only do it when there is
+  // something to format.
   OpaqueFunctionsPool<llvm::Type *> HexIntegerPool(F.getParent(), false);
   initHexPrintPool(HexIntegerPool);
 
@@ -75,16 +90,6 @@ bool PrettyIntFormatting::runOnFunction(llvm::Function &F) {
   OpaqueFunctionsPool<llvm::Type *> NullPtrPool(F.getParent(), false);
   initNullPtrPrintPool(NullPtrPool);
 
-  std::vector<FormatInt> IntsToBeFormatted;
-
-  for (llvm::Instruction &I : llvm::instructions(F)) {
-    for (llvm::Use &U : I.operands()) {
-      if (auto formatting = getIntFormat(I, U, Model); formatting) {
-        IntsToBeFormatted.push_back(*formatting);
-      }
-    }
-  }
-
   llvm::IRBuilder<> Builder(F.getContext());
   for (const auto &[Format, Operand] : IntsToBeFormatted) {
     auto *Val = llvm::cast<llvm::ConstantInt>(Operand->get());
@@ -15,7 +15,7 @@
 #include "revng/Support/Assert.h"
 #include "revng/Support/OpaqueFunctionsPool.h"
 
-#include "revng-c/InitModelTypes/InitModelTypes.h"
+#include "revng-c/InitModelTypes/ModelTypesAnalysis.h"
 #include "revng-c/Support/DecompilationHelpers.h"
 #include "revng-c/Support/FunctionTags.h"
 #include "revng-c/Support/ModelHelpers.h"
@@ -24,15 +24,28 @@ struct RemoveLoadStore : public llvm::FunctionPass {
 public:
   static char ID;
 
+private:
+  SharedOpaqueFunctionsPool<llvm::Type *> AssignPool{ initAssignPool };
+  SharedOpaqueFunctionsPool<llvm::Type *> CopyPool{ initCopyPool };
+
+public:
   RemoveLoadStore() : FunctionPass(ID) {}
 
   /// Replace all `load` instructions with calls to `Copy(ModelGEP())` and all
   /// `store` instructions with calls to `Assign(ModelGEP())`.
   bool runOnFunction(llvm::Function &F) override;
 
+  bool doFinalization(llvm::Module &) override {
+    AssignPool.clear();
+    CopyPool.clear();
+    return false;
+  }
+
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
     AU.addRequired<LoadModelWrapperPass>();
     AU.addRequired<FunctionMetadataCachePass>();
+    AU.addRequired<ModelTypesAnalysis>();
+    AU.addPreserved<ModelTypesAnalysis>();
     AU.setPreservesCFG();
   }
 };
@@ -78,24 +91,16 @@ bool RemoveLoadStore::runOnFunction(llvm::Function &F) {
   const auto
     &Model = getAnalysis<LoadModelWrapperPass>().get().getReadOnlyModel().get();
 
-  // Collect model types
-  auto TypeMap = initModelTypes(getAnalysis<FunctionMetadataCachePass>().get(),
-                                F,
-                                llvmToModelFunction(*Model, F),
-                                *Model,
-                                /*PointersOnly=*/false);
+  // Collect model types. Take a copy, since we add the types of the calls we
+  // inject.
+  auto &ModelTypes = getAnalysis<ModelTypesAnalysis>();
+  auto TypeMap = ModelTypes.getModelTypes(/*PointersOnly=*/false);
 
   // Initialize the IR builder to inject functions
   llvm::LLVMContext &LLVMCtx = F.getContext();
   llvm::Module &M = *F.getParent();
   llvm::IRBuilder<> Builder(LLVMCtx);
 
-  // Initialize function pool
-  OpaqueFunctionsPool<llvm::Type *> AssignPool(&M, false);
-  initAssignPool(AssignPool);
-  OpaqueFunctionsPool<llvm::Type *> CopyPool(&M, false);
-  initCopyPool(CopyPool);
-
   llvm::SmallVector<llvm::Instruction *, 32> ToRemove;
 
   // Make replacements
@@ -132,7 +137,8 @@ bool RemoveLoadStore::runOnFunction(llvm::Function &F) {
 
         // Create a Copy to dereference the ModelGEP
         auto *CopyFnType = getCopyType(DerefCall->getType());
-        auto *CopyFunction = CopyPool.get(DerefCall->getType(),
+        auto *CopyFunction = CopyPool.get(&M,
+                                          DerefCall->getType(),
                                           CopyFnType,
                                           "Copy");
         InjectedCall = Builder.CreateCall(CopyFunction, { DerefCall });
@@ -183,7 +189,8 @@ bool RemoveLoadStore::runOnFunction(llvm::Function &F) {
         // Inject Assign() function
         auto *AssignFnType = getAssignFunctionType(ValueOp->getType(),
                                                    DerefCall->getType());
-        auto *AssignFunction = AssignPool.get(ValueOp->getType(),
+        auto *AssignFunction = AssignPool.get(&M,
+                                              ValueOp->getType(),
                                               AssignFnType,
                                               "Assign");
         InjectedCall = Builder.CreateCall(AssignFunction,
@@ -205,6 +212,7 @@ bool RemoveLoadStore::runOnFunction(llvm::Function &F) {
   for (auto *InstToRemove : ToRemove)
     InstToRemove->eraseFromParent();
 
+  ModelTypes.invalidate();
   return true;
 }
 
@@ -4,6 +4,7 @@
 
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/PatternMatch.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Transforms/Utils/Local.h"
 
@@ -69,6 +70,38 @@ public:
   }
 };
 
+/// Emit \p Operation on \p LHS and \p RHS. Additions and subtractions of
+/// negative constants are emitted as subtractions and additions of their
+/// opposite, which is the form twoscomplement-normalization would turn them
+/// into anyway.
+static Value *createArithmetic(IRBuilder<> &Builder,
+                               Operation Operation,
+                               Value *LHS,
+                               Value *RHS) {
+  const APInt *Constant = nullptr;
+  bool NegativeConstant = PatternMatch::match(RHS,
+                                              PatternMatch::m_APInt(Constant))
+                          and Constant->isNegative();
+
+  switch (Operation) {
+  case Add:
+    if (NegativeConstant)
+      return Builder.CreateSub(LHS, Builder.getInt(-*Constant));
+    return Builder.CreateAdd(LHS, RHS);
+
+  case Sub:
+    if (NegativeConstant)
+      return Builder.CreateAdd(LHS, Builder.getInt(-*Constant));
+    return Builder.CreateSub(LHS, RHS);
+
+  case Mul:
+    return Builder.CreateMul(LHS, RHS);
+
+  default:
+    revng_abort();
+  }
+}
+
 class SplitOverflowIntrinsicsPass : public llvm::FunctionPass {
 public:
   static char ID;
@@ -87,6 +120,9 @@ public:
         if (auto *Call = dyn_cast<WithOverflowInst>(&I))
           Calls.push_back(Call);
 
+    if (Calls.empty())
+      return false;
+
     // Create the function pool computing whether the operation overflows or not
     OpaqueFunctionsPool<std::string> OverflowPool(F.getParent(), false);
     OverflowPool.addFnAttribute(llvm::Attribute::NoUnwind);
@@ -107,7 +143,6 @@ public:
 
       Value *Operand1 = Call->getArgOperand(0);
       Value *Operand2 = Call->getArgOperand(1);
-      Value *Result = nullptr;
       Signedness Signedness = Unsigned;
       Operation Operation;
 
@@ -131,19 +166,16 @@ public:
       switch (Call->getIntrinsicID()) {
       case Intrinsic::uadd_with_overflow:
       case Intrinsic::sadd_with_overflow:
-        Result = Builder.CreateAdd(Operand1, Operand2);
         Operation = Add;
         break;
 
       case Intrinsic::usub_with_overflow:
       case Intrinsic::ssub_with_overflow:
-        Result = Builder.CreateSub(Operand1, Operand2);
         Operation = Sub;
         break;
 
       case Intrinsic::umul_with_overflow:
       case Intrinsic::smul_with_overflow:
-        Result = Builder.CreateMul(Operand1, Operand2);
         Operation = Mul;
         break;
 
@@ -151,17 +183,32 @@ public:
         revng_abort("Unexpected intrinsic");
       }
 
-      auto *OperandType = cast<IntegerType>(Operand1->getType());
-      revng_assert(Operand2->getType() == OperandType);
-      auto *FT = FunctionType::get(Builder.getInt1Ty(),
-                                   { OperandType, OperandType },
-                                   false);
-      OverflowFunctionKey Key = { Signedness,
-                                  Operation,
-                                  OperandType->getBitWidth() };
-      std::string Name = Key.name();
-      auto *Overflow = Builder.CreateCall(OverflowPool.get(Name, FT, Name),
-                                          { Operand1, Operand2 });
+      // Only emit the halves of the result that are actually extracted, so
+      // that no dead code is left behind
+      Value *Result = nullptr;
+      auto GetResult = [&]() {
+        if (Result == nullptr)
+          Result = createArithmetic(Builder, Operation, Operand1, Operand2);
+        return Result;
+      };
+
+      Value *Overflow = nullptr;
+      auto GetOverflow = [&]() {
+        if (Overflow == nullptr) {
+          auto *OperandType = cast<IntegerType>(Operand1->getType());
+          revng_assert(Operand2->getType() == OperandType);
+          auto *FT = FunctionType::get(Builder.getInt1Ty(),
+                                       { OperandType, OperandType },
+                                       false);
+          OverflowFunctionKey Key = { Signedness,
+                                      Operation,
+                                      OperandType->getBitWidth() };
+          std::string Name = Key.name();
+          Overflow = Builder.CreateCall(OverflowPool.get(Name, FT, Name),
+                                        { Operand1, Operand2 });
+        }
+        return Overflow;
+      };
 
       for (User *U : llvm::make_early_inc_range(Call->users())) {
         revng_assert(isCallToTagged(U, FunctionTags::OpaqueExtractValue));
@@ -169,9 +216,9 @@ public:
         auto *Index = cast<ConstantInt>(ExtractValue->getArgOperand(1));
         Value *ReplaceWith = nullptr;
         if (Index->isZero()) {
-          ReplaceWith = Result;
+          ReplaceWith = GetResult();
         } else if (Index->isOne()) {
-          ReplaceWith = Overflow;
+          ReplaceWith = GetOverflow();
         } else {
           revng_abort();
         }
@@ -179,6 +226,11 @@ public:
         ExtractValue->replaceAllUsesWith(ReplaceWith);
         ExtractValue->eraseFromParent();
       }
+
+      // Nothing else uses the intrinsic, drop it right away instead of
+      // leaving it to dce
+      revng_assert(Call->use_empty());
+      Call->eraseFromParent();
     }
 
     return Changed;
@@ -33,13 +33,11 @@ public:
 class TernaryReductionImpl {
   llvm::IRBuilder<> Builder;
   OpaqueFunctionsPool<llvm::Type *> BooleanNotPool;
+  bool BooleanNotPoolInitialized = false;
 
 public:
   TernaryReductionImpl(llvm::Module &Module) :
-    Builder(Module.getContext()), BooleanNotPool(&Module, false) {
-
-    initBooleanNotPool(BooleanNotPool);
-  }
+    Builder(Module.getContext()), BooleanNotPool(&Module, false) {}
 
   llvm::Value *reduce(llvm::SelectInst &Select) {
     std::optional TrueBranch = unwrapBoolConstant(Select.getTrueValue());
@@ -77,6 +75,13 @@ private:
   }
 
   llvm::Value *booleanNot(llvm::Value *Value) {
+    // Most selects don't need a boolean_not, and preparing the pool walks the
+    // whole module.
+    if (not BooleanNotPoolInitialized) {
+      initBooleanNotPool(BooleanNotPool);
+      BooleanNotPoolInitialized = true;
+    }
+
     auto *BooleanNotFunction = BooleanNotPool.get(Value->getType(),
                                                   Builder.getIntNTy(1),
                                                   Value->getType(),
@@ -2,6 +2,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <array>
+
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/IRBuilder.h"
@@ -35,270 +37,346 @@ using TANP = TwosComplementArithmeticNormalizationPass;
 class UnaryMinusBuilder {
 
   OpaqueFunctionsPool<llvm::Type *> Pool;
+  bool PoolInitialized = false;
   llvm::IRBuilder<> Builder;
 
 public:
   UnaryMinusBuilder(llvm::Function &F) :
-    Pool(F.getParent(), false), Builder(F.getContext()) {
-    initUnaryMinusPool(Pool);
-  }
+    Pool(F.getParent(), false), Builder(F.getContext()) {}
 
   void SetInsertPoint(llvm::Instruction *I) { Builder.SetInsertPoint(I); }
 
   llvm::CallInst *operator()(llvm::Type *IntType, llvm::APInt Value) {
     revng_assert(llvm::isa<llvm::IntegerType>(IntType));
+    initPool();
     llvm::Function *Func = Pool.get(IntType, IntType, IntType, "unary_minus");
     auto ConstInt = llvm::ConstantInt::getSigned(IntType,
                                                  Value.abs().getLimitedValue());
     return Builder.CreateCall(Func, { ConstInt });
   }
+
+private:
+  // Initializing the pool scans the whole module, and most functions don't
+  // need any of these calls, so do it lazily. The same goes for the other
+  // builders below.
+  void initPool() {
+    if (not PoolInitialized) {
+      initUnaryMinusPool(Pool);
+      PoolInitialized = true;
+    }
+  }
 };
 
 class BinaryNotBuilder {
 
   OpaqueFunctionsPool<llvm::Type *> Pool;
+  bool PoolInitialized = false;
   llvm::IRBuilder<> Builder;
 
 public:
   BinaryNotBuilder(llvm::Function &F) :
-    Pool(F.getParent(), false), Builder(F.getContext()) {
-    initBinaryNotPool(Pool);
-  }
+    Pool(F.getParent(), false), Builder(F.getContext()) {}
 
   void SetInsertPoint(llvm::Instruction *I) { Builder.SetInsertPoint(I); }
 
   llvm::CallInst *operator()(llvm::Type *IntType, llvm::Value *Val) {
     revng_assert(isa<llvm::IntegerType>(IntType));
+    initPool();
     llvm::Function *Func = Pool.get(IntType, IntType, IntType, "binary_not");
     return Builder.CreateCall(Func, { Val });
   }
+
+private:
+  void initPool() {
+    if (not PoolInitialized) {
+      initBinaryNotPool(Pool);
+      PoolInitialized = true;
+    }
+  }
 };
 
 class BooleanNotBuilder {
 
   OpaqueFunctionsPool<llvm::Type *> Pool;
+  bool PoolInitialized = false;
   llvm::IRBuilder<> Builder;
 
 public:
   BooleanNotBuilder(llvm::Function &F) :
-    Pool(F.getParent(), false), Builder(F.getContext()) {
-    initBooleanNotPool(Pool);
-  }
+    Pool(F.getParent(), false), Builder(F.getContext()) {}
 
   void SetInsertPoint(llvm::Instruction *I) { Builder.SetInsertPoint(I); }
 
   llvm::CallInst *operator()(llvm::Type *IntType, llvm::Value *Val) {
     revng_assert(isa<llvm::IntegerType>(IntType));
+    initPool();
     llvm::Function *Func = Pool.get(IntType,
                                     Builder.getIntNTy(1),
                                     IntType,
                                     "boolean_not");
     return Builder.CreateCall(Func, { Val });
   }
+
+private:
+  void initPool() {
+    if (not PoolInitialized) {
+      initBooleanNotPool(Pool);
+      PoolInitialized = true;
+    }
+  }
+};
+
+namespace {
+
+/// The builders the rewrite rules create new instructions with
+struct RewriteBuilders {
+  UnaryMinusBuilder UnaryMinus;
+  BinaryNotBuilder BinaryNot;
+  BooleanNotBuilder BooleanNot;
+  llvm::IRBuilder<> Builder;
+
+  RewriteBuilders(llvm::Function &F) :
+    UnaryMinus(F), BinaryNot(F), BooleanNot(F), Builder(F.getContext()) {}
+
+  /// Build `LHS Opcode -Int`, or `-Int Opcode RHS` if \p ConstantIsLHS, with
+  /// the constant wrapped in a call to unary_minus
+  llvm::Value *withUnaryMinus(llvm::Instruction &I,
+                              llvm::Value *Val,
+                              const llvm::APInt &Int,
+                              bool ConstantIsLHS) {
+    using BinaryOps = llvm::Instruction::BinaryOps;
+    UnaryMinus.SetInsertPoint(&I);
+    llvm::CallInst *Minus = UnaryMinus(Val->getType(), Int);
+    Builder.SetInsertPoint(Minus->getNextNonDebugInstruction());
+    auto Opcode = static_cast<BinaryOps>(I.getOpcode());
+    if (ConstantIsLHS)
+      return Builder.CreateBinOp(Opcode, Minus, Val);
+    return Builder.CreateBinOp(Opcode, Val, Minus);
+  }
 };
 
+/// A rewrite rule returns the value replacing \p I, &I if it changed \p I in
+/// place, or nullptr if it doesn't apply
+using RewriteRule = llvm::Value *(*)(llvm::Instruction &I,
+                                     RewriteBuilders &B);
+
+} // namespace
+
+using namespace llvm::PatternMatch;
+
+/// Negative constants passed to isolated functions become unary minuses
+static llvm::Value *rewriteCall(llvm::Instruction &I, RewriteBuilders &B) {
+  auto *CallToIsolated = getCallToIsolatedFunction(&I);
+  if (not CallToIsolated)
+    return nullptr;
+
+  bool Changed = false;
+  for (llvm::Use &OperandUse : CallToIsolated->operands()) {
+    auto *ConstantOperand = dyn_cast<llvm::ConstantInt>(OperandUse.get());
+    if (not ConstantOperand or not ConstantOperand->isNegative())
+      continue;
+
+    B.UnaryMinus.SetInsertPoint(&I);
+    OperandUse.set(B.UnaryMinus(ConstantOperand->getType(),
+                                ConstantOperand->getValue()));
+    Changed = true;
+  }
+
+  return Changed ? &I : nullptr;
+}
+
+/// `x ^ -1` becomes `~x`
+static llvm::Value *rewriteXor(llvm::Instruction &I, RewriteBuilders &B) {
+  llvm::Value *Val = nullptr;
+  const llvm::APInt *Int = nullptr;
+  if (not match(&I, m_Xor(m_Value(Val), m_APInt(Int)))
+      and not match(&I, m_Xor(m_APInt(Int), m_Value(Val))))
+    return nullptr;
+
+  if (not Int->isAllOnesValue())
+    return nullptr;
+
+  B.BinaryNot.SetInsertPoint(&I);
+  return B.BinaryNot(I.getType(), Val);
+}
+
+/// `x + -c` becomes `x - c`, and `x - -c` becomes `x + c`
+static llvm::Value *rewriteAddSub(llvm::Instruction &I, RewriteBuilders &B) {
+  const llvm::APInt *Int = nullptr;
+  if (not match(I.getOperand(1), m_APInt(Int)) or not Int->isNegative())
+    return nullptr;
+
+  llvm::Value *Val = I.getOperand(0);
+  B.Builder.SetInsertPoint(&I);
+  auto *Negated = llvm::ConstantInt::get(I.getType(), ~(*Int) + 1);
+  if (I.getOpcode() == llvm::Instruction::Add)
+    return B.Builder.CreateSub(Val, Negated);
+  return B.Builder.CreateAdd(Val, Negated);
+}
+
+/// Negative factors become unary minuses
+static llvm::Value *rewriteMul(llvm::Instruction &I, RewriteBuilders &B) {
+  llvm::Value *Val = nullptr;
+  const llvm::APInt *Int = nullptr;
+  if (not match(&I, m_Mul(m_Value(Val), m_APInt(Int)))
+      and not match(&I, m_Mul(m_APInt(Int), m_Value(Val))))
+    return nullptr;
+
+  if (not Int->isNegative())
+    return nullptr;
+
+  // The product is commutative, keep the unary minus on the right
+  return B.withUnaryMinus(I, Val, *Int, /* ConstantIsLHS */ false);
+}
+
+/// Negative dividends and divisors become unary minuses
+static llvm::Value *rewriteDivRem(llvm::Instruction &I, RewriteBuilders &B) {
+  const llvm::APInt *Int = nullptr;
+  if (match(I.getOperand(1), m_APInt(Int)) and Int->isNegative())
+    return B.withUnaryMinus(I, I.getOperand(0), *Int, false);
+
+  if (match(I.getOperand(0), m_APInt(Int)) and Int->isNegative())
+    return B.withUnaryMinus(I, I.getOperand(1), *Int, true);
+
+  return nullptr;
+}
+
 using Predicate = llvm::ICmpInst::Predicate;
 
 static bool isGreater(Predicate P) {
   return llvm::ICmpInst::isGE(P) or llvm::ICmpInst::isGT(P);
 }
 
-bool TANP::runOnFunction(llvm::Function &F) {
+/// Comparisons of `x + c1` or `x - c1` against a constant move the constants
+/// to the right. Comparisons against negative constants use a unary minus,
+/// and `x == 0` becomes `!x`.
+static llvm::Value *rewriteICmp(llvm::Instruction &I, RewriteBuilders &B) {
   using namespace llvm;
-  using namespace PatternMatch;
 
-  UnaryMinusBuilder BuildUnaryMinus{ F };
-  BinaryNotBuilder BuildBinaryNot{ F };
-  BooleanNotBuilder BuildBooleanNot{ F };
-  llvm::IRBuilder<> Builder{ F.getContext() };
+  Predicate Pred;
+  Value *Val = nullptr;
+  const APInt *Int = nullptr;
+  if (not match(&I, m_ICmp(Pred, m_Value(Val), m_APInt(Int))))
+    return nullptr;
+
+  const auto IntType = Val->getType();
+  IRBuilder<> &Builder = B.Builder;
+
+  llvm::Value *Unknown = nullptr;
+  const APInt *RHS = nullptr;
+  if (match(Val, m_Add(m_Value(Unknown), m_APInt(RHS)))
+      or match(Val, m_Sub(m_Value(Unknown), m_APInt(RHS)))) {
+    // Compute the new RHS if we move the RHS to the right of the
+    // comparison operator, adjusting the old value of Int.
+    using llvm::Instruction::Add;
+    bool IsAdd = cast<llvm::Instruction>(Val)->getOpcode() == Add;
+    APInt NewRHS = IsAdd ? (*Int - *RHS) : (*Int + *RHS);
+    Builder.SetInsertPoint(I.getNextNonDebugInstruction());
+    Value *NewV = Builder.CreateICmp(Pred,
+                                     Unknown,
+                                     ConstantInt::get(IntType, NewRHS));
+
+    // If the predicate is relational, I is an inequality, meaning that it
+    // has a range of results, that wraps around, and we have to take care
+    // of that to avoid breaking semantics.
+    if (llvm::ICmpInst::isRelational(Pred)) {
+      unsigned BitWidth = RHS->getBitWidth();
+      bool IsSigned = llvm::ICmpInst::isSigned(Pred);
+      APInt Min = IsSigned ? APInt::getSignedMinValue(BitWidth) :
+                             /*Unsigned*/ APInt::getMinValue(BitWidth);
+      APInt Max = IsSigned ? APInt::getSignedMaxValue(BitWidth) :
+                             /*Unsigned*/ APInt::getMaxValue(BitWidth);
+      APInt MinPlusRHS = Min + *RHS;
+      APInt MaxMinusRHS = Max - *RHS;
+
+      // The limit for discriminating the two cases of solutions for the
+      // inequalities
+      APInt IntLimit = IsAdd ? MinPlusRHS : /*Sub*/ MaxMinusRHS;
+
+      // TODO: if Int and IntLimit have the same value we can avoid
+      // creating two inqualities.
+      // Basically we can ditch Int altogether and only emit expressions
+      // that depend on RHS and MinPlusRHS or MaxMinusRHS.
+      // When checked on tests though, this turned out to never happen so
+      // we haven't implemented this yet.
+
+      bool IsGreater = isGreater(Pred);
+      Predicate WrappingPredicate = IsGreater ?
+                                      (IsSigned ? Predicate::ICMP_SLT :
+                                                  Predicate::ICMP_ULT) :
+                                      /*IsLower*/
+                                      (IsSigned ? Predicate::ICMP_SGE :
+                                                  Predicate::ICMP_UGE);
+
+      // The value at which Unknown + RHS wraps back
+      APInt WrappingValue = IsAdd ? MaxMinusRHS : /*Sub*/ MinPlusRHS;
+      auto *WrapConst = llvm::ConstantInt::get(IntType, WrappingValue);
+      llvm::Value *WrappingComparison = Builder.CreateICmp(WrappingPredicate,
+                                                           Unknown,
+                                                           WrapConst);
+
+      bool IntIntersectsAfterWrap = IsSigned ? Int->slt(IntLimit) :
+                                               Int->ult(IntLimit);
+      if (IntIntersectsAfterWrap == IsGreater)
+        NewV = Builder.CreateOr(NewV, WrappingComparison);
+      else
+        NewV = Builder.CreateAnd(NewV, WrappingComparison);
+    }
 
-  bool Changed = false;
+    return NewV;
+  }
+
+  if (Int->isNegative()) {
+    B.UnaryMinus.SetInsertPoint(&I);
+    auto UnaryMinus = B.UnaryMinus(IntType, *Int);
+    Builder.SetInsertPoint(UnaryMinus->getNextNonDebugInstruction());
+    return Builder.CreateICmp(Pred, Val, UnaryMinus);
+  }
+
+  if (Pred == Predicate::ICMP_EQ and Int->isNullValue()) {
+    B.BooleanNot.SetInsertPoint(&I);
+    return B.BooleanNot(Val->getType(), Val);
+  }
 
-  SmallVector<Instruction *, 8> DeadInsts;
-  for (BasicBlock &BB : F) {
-    for (Instruction &I : BB) {
+  return nullptr;
+}
 
-      if (auto *CallToIsolated = getCallToIsolatedFunction(&I)) {
+/// The rule for each opcode. Each instruction is looked up here once, and
+/// only the rule for its opcode tries to match it.
+///
+/// To add a normalization, write its rule and register it here.
+static constexpr auto Rules = [] {
+  using llvm::Instruction;
+  std::array<RewriteRule, Instruction::OtherOpsEnd> Result{};
+  Result[Instruction::Call] = rewriteCall;
+  Result[Instruction::Xor] = rewriteXor;
+  Result[Instruction::Add] = rewriteAddSub;
+  Result[Instruction::Sub] = rewriteAddSub;
+  Result[Instruction::Mul] = rewriteMul;
+  Result[Instruction::SDiv] = rewriteDivRem;
+  Result[Instruction::SRem] = rewriteDivRem;
+  Result[Instruction::ICmp] = rewriteICmp;
+  return Result;
+}();
 
-        for (Use &OperandUse : CallToIsolated->operands()) {
+bool TANP::runOnFunction(llvm::Function &F) {
+  RewriteBuilders Builders{ F };
 
-          auto *ConstantOperand = dyn_cast<ConstantInt>(OperandUse.get());
-          if (not ConstantOperand)
-            continue;
+  bool Changed = false;
 
-          if (ConstantOperand->isNegative()) {
-            BuildUnaryMinus.SetInsertPoint(&I);
-            auto UnaryMinus = BuildUnaryMinus(ConstantOperand->getType(),
-                                              ConstantOperand->getValue());
-            OperandUse.set(UnaryMinus);
-          }
-        }
+  llvm::SmallVector<llvm::Instruction *, 8> DeadInsts;
+  for (llvm::BasicBlock &BB : F) {
+    for (llvm::Instruction &I : BB) {
+      RewriteRule Rule = Rules[I.getOpcode()];
+      if (Rule == nullptr)
         continue;
-      }
 
-      Value *NewV = nullptr;
-
-      Value *Val = nullptr;
-      const APInt *Int = nullptr;
-
-      if ((match(&I, m_Xor(m_Value(Val), m_APInt(Int)))
-           or match(&I, m_Xor(m_APInt(Int), m_Value(Val))))
-          and Int->isAllOnesValue()) {
-        BuildBinaryNot.SetInsertPoint(&I);
-        NewV = BuildBinaryNot(I.getType(), Val);
-
-      } else if (match(&I, m_Add(m_Value(Val), m_APInt(Int)))
-                 and Int->isNegative()) {
-        Builder.SetInsertPoint(&I);
-        NewV = Builder.CreateSub(Val,
-                                 ConstantInt::get(I.getType(), ~(*Int) + 1));
-      } else if (match(&I, m_Sub(m_Value(Val), m_APInt(Int)))
-                 and Int->isNegative()) {
-        Builder.SetInsertPoint(&I);
-        NewV = Builder.CreateAdd(Val,
-                                 ConstantInt::get(I.getType(), ~(*Int) + 1));
-      } else if ((match(&I, m_Mul(m_Value(Val), m_APInt(Int)))
-                  or match(&I, m_Mul(m_APInt(Int), m_Value(Val))))
-                 and Int->isNegative()) {
-        const auto IntType = Val->getType();
-
-        if (Int->isSignBitSet()
-            and Int->isSignedIntN(IntType->getIntegerBitWidth())) {
-          BuildUnaryMinus.SetInsertPoint(&I);
-          auto UnaryMinus = BuildUnaryMinus(Val->getType(), *Int);
-          Builder.SetInsertPoint(UnaryMinus->getNextNonDebugInstruction());
-          NewV = Builder.CreateMul(Val, UnaryMinus);
-        }
-
-      } else if (match(&I, m_SDiv(m_Value(Val), m_APInt(Int)))
-                 and Int->isNegative()) {
-
-        const auto IntType = Val->getType();
-
-        if (Int->isSignBitSet()
-            and Int->isSignedIntN(IntType->getIntegerBitWidth())) {
-          BuildUnaryMinus.SetInsertPoint(&I);
-          auto UnaryMinus = BuildUnaryMinus(Val->getType(), *Int);
-          Builder.SetInsertPoint(UnaryMinus->getNextNonDebugInstruction());
-          NewV = Builder.CreateSDiv(Val, UnaryMinus);
-        }
-
-      } else if (match(&I, m_SDiv(m_APInt(Int), m_Value(Val)))
-                 and Int->isNegative()) {
-
-        const auto IntType = Val->getType();
-
-        if (Int->isSignBitSet()
-            and Int->isSignedIntN(IntType->getIntegerBitWidth())) {
-          BuildUnaryMinus.SetInsertPoint(&I);
-          auto UnaryMinus = BuildUnaryMinus(Val->getType(), *Int);
-          Builder.SetInsertPoint(UnaryMinus->getNextNonDebugInstruction());
-          NewV = Builder.CreateSDiv(UnaryMinus, Val);
-        }
-
-      } else if (match(&I, m_SRem(m_Value(Val), m_APInt(Int)))
-                 and Int->isNegative()) {
-
-        const auto IntType = Val->getType();
-
-        if (Int->isSignBitSet()
-            and Int->isSignedIntN(IntType->getIntegerBitWidth())) {
-          BuildUnaryMinus.SetInsertPoint(&I);
-          auto UnaryMinus = BuildUnaryMinus(Val->getType(), *Int);
-          Builder.SetInsertPoint(UnaryMinus->getNextNonDebugInstruction());
-          NewV = Builder.CreateSRem(Val, UnaryMinus);
-        }
-      } else if (match(&I, m_SRem(m_APInt(Int), m_Value(Val)))
-                 and Int->isNegative()) {
-
-        const auto IntType = Val->getType();
-
-        if (Int->isSignBitSet()
-            and Int->isSignedIntN(IntType->getIntegerBitWidth())) {
-          BuildUnaryMinus.SetInsertPoint(&I);
-          auto UnaryMinus = BuildUnaryMinus(Val->getType(), *Int);
-          Builder.SetInsertPoint(UnaryMinus->getNextNonDebugInstruction());
-          NewV = Builder.CreateSRem(UnaryMinus, Val);
-        }
-
-      } else if (Predicate Pred;
-                 match(&I, m_ICmp(Pred, m_Value(Val), m_APInt(Int)))) {
-        const auto IntType = Val->getType();
-
-        llvm::Value *Unknown = nullptr;
-        const APInt *RHS = nullptr;
-        if (match(Val, m_Add(m_Value(Unknown), m_APInt(RHS)))
-            or match(Val, m_Sub(m_Value(Unknown), m_APInt(RHS)))) {
-          // Compute the new RHS if we move the RHS to the right of the
-          // comparison operator, adjusting the old value of Int.
-          using llvm::Instruction::Add;
-          bool IsAdd = cast<llvm::Instruction>(Val)->getOpcode() == Add;
-          APInt NewRHS = IsAdd ? (*Int - *RHS) : (*Int + *RHS);
-          Builder.SetInsertPoint(I.getNextNonDebugInstruction());
-          NewV = Builder.CreateICmp(Pred,
-                                    Unknown,
-                                    ConstantInt::get(IntType, NewRHS));
-
-          // If the predicate is relational, I is an inequality, meaning that it
-          // has a range of results, that wraps around, and we have to take care
-          // of that to avoid breaking semantics.
-          if (llvm::ICmpInst::isRelational(Pred)) {
-            unsigned BitWidth = RHS->getBitWidth();
-            bool IsSigned = llvm::ICmpInst::isSigned(Pred);
-            APInt Min = IsSigned ? APInt::getSignedMinValue(BitWidth) :
-                                   /*Unsigned*/ APInt::getMinValue(BitWidth);
-            APInt Max = IsSigned ? APInt::getSignedMaxValue(BitWidth) :
-                                   /*Unsigned*/ APInt::getMaxValue(BitWidth);
-            APInt MinPlusRHS = Min + *RHS;
-            APInt MaxMinusRHS = Max - *RHS;
-
-            // The limit for discriminating the two cases of solutions for the
-            // inequalities
-            APInt IntLimit = IsAdd ? MinPlusRHS : /*Sub*/ MaxMinusRHS;
-
-            // TODO: if Int and IntLimit have the same value we can avoid
-            // creating two inqualities.
-            // Basically we can ditch Int altogether and only emit expressions
-            // that depend on RHS and MinPlusRHS or MaxMinusRHS.
-            // When checked on tests though, this turned out to never happen so
-            // we haven't implemented this yet.
-
-            bool IsGreater = isGreater(Pred);
-            Predicate WrappingPredicate = IsGreater ?
-                                            (IsSigned ? Predicate::ICMP_SLT :
-                                                        Predicate::ICMP_ULT) :
-                                            /*IsLower*/
-                                            (IsSigned ? Predicate::ICMP_SGE :
-                                                        Predicate::ICMP_UGE);
-
-            // The value at which Unknown + RHS wraps back
-            APInt WrappingValue = IsAdd ? MaxMinusRHS : /*Sub*/ MinPlusRHS;
-            auto *WrapConst = llvm::ConstantInt::get(IntType, WrappingValue);
-            llvm::Value *WrappingComparison = Builder
-                                                .CreateICmp(WrappingPredicate,
-                                                            Unknown,
-                                                            WrapConst);
-
-            bool IntIntersectsAfterWrap = IsSigned ? Int->slt(IntLimit) :
-                                                     Int->ult(IntLimit);
-            if (IntIntersectsAfterWrap == IsGreater)
-              NewV = Builder.CreateOr(NewV, WrappingComparison);
-            else
-              NewV = Builder.CreateAnd(NewV, WrappingComparison);
-          }
-        } else if (Int->isNegative()) {
-          BuildUnaryMinus.SetInsertPoint(&I);
-          auto UnaryMinus = BuildUnaryMinus(IntType, *Int);
-          Builder.SetInsertPoint(UnaryMinus->getNextNonDebugInstruction());
-          NewV = Builder.CreateICmp(Pred, Val, UnaryMinus);
-        } else if (Pred == Predicate::ICMP_EQ and Int->isNullValue()) {
-          BuildBooleanNot.SetInsertPoint(&I);
-          NewV = BuildBooleanNot(Val->getType(), Val);
-        }
-      }
+      llvm::Value *NewV = Rule(I, Builders);
+      if (NewV == nullptr)
+        continue;
 
-      if (NewV) {
-        Changed = true;
+      Changed = true;
+      if (NewV != &I) {
         I.replaceAllUsesWith(NewV);
         DeadInsts.emplace_back(&I);
       }
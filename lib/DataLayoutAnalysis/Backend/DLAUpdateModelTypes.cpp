@@ -18,7 +18,9 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "revng/ADT/FilteredGraphTraits.h"
@@ -48,6 +50,13 @@ using llvm::isa;
 static Logger<> Log("dla-update-model-funcs");
 static Logger<> ModelLog("dla-dump-model-with-funcs");
 
+static llvm::cl::opt<unsigned>
+  DLABackendThreads("dla-backend-threads",
+                    llvm::cl::desc("Number of threads looking for the stack "
+                                   "frames of the functions in the DLA "
+                                   "backend"),
+                    llvm::cl::init(1));
+
 using model::PrimitiveTypeKind::Generic;
 using model::PrimitiveTypeKind::PointerOrNumber;
 
@@ -654,8 +663,32 @@ fillStructWithRecoveredDLATypeAtOffset(model::Binary &Model,
   }
 }
 
+/// Find the call to revng_stack_frame in \a LLVMFunc, if any.
+///
+/// This only reads the IR, so it can run concurrently on different functions.
+static const llvm::CallInst *
+findStackFrameCall(const llvm::Function &LLVMFunc) {
+  const llvm::CallInst *Result = nullptr;
+  for (const auto &I : llvm::instructions(LLVMFunc)) {
+
+    auto *Call = dyn_cast<llvm::CallInst>(&I);
+    if (not Call)
+      continue;
+
+    auto *Callee = Call->getCalledFunction();
+    if (not Callee or Callee->getName() != "revng_stack_frame")
+      continue;
+
+    revng_assert(not Result, "Multiple calls to revng_stack_frame");
+    Result = Call;
+  }
+
+  return Result;
+}
+
 static bool updateStackFrameType(model::Function &ModelFunc,
                                  const llvm::Function &LLVMFunc,
+                                 const llvm::CallInst *StackFrameCall,
                                  const TypeMapT &DLATypes,
                                  model::Binary &Model) {
   bool Updated = false;
@@ -668,20 +701,7 @@ static bool updateStackFrameType(model::Function &ModelFunc,
   if (not OldStackFrameStruct->Fields().empty())
     return Updated;
 
-  bool Found = false;
-  for (const auto &I : llvm::instructions(LLVMFunc)) {
-
-    auto *Call = dyn_cast<llvm::CallInst>(&I);
-    if (not Call)
-      continue;
-
-    auto *Callee = Call->getCalledFunction();
-    if (not Callee or Callee->getName() != "revng_stack_frame")
-      continue;
-
-    revng_assert(not Found, "Multiple calls to revng_stack_frame");
-    Found = true;
-
+  if (const llvm::CallInst *Call = StackFrameCall) {
     revng_log(Log, "Updating stack for " << LLVMFunc.getName());
     LoggerIndent Indent{ Log };
     revng_log(Log, "Was " << OldStackFrameStruct->ID());
@@ -721,11 +741,37 @@ bool dla::updateFuncSignatures(const llvm::Module &M,
 
   bool Updated = false;
 
-  for (const auto &LLVMFunc : M.functions()) {
-    // Update the function's prototype
-    model::Function *ModelFunc = llvmToModelFunction(*Model.get(), LLVMFunc);
-    if (not ModelFunc)
-      continue;
+  // Collect the functions to update, and look for their stack frames ahead of
+  // time. Scanning the instructions is the only part that grows with the size
+  // of the module and it only reads the IR, so it can be done in parallel.
+  // Everything that touches the model stays serial and in module order,
+  // because prototypes can be shared, and whoever upgrades them first wins.
+  std::vector<std::pair<const llvm::Function *, model::Function *>> Functions;
+  for (const auto &LLVMFunc : M.functions())
+    if (auto *ModelFunc = llvmToModelFunction(*Model.get(), LLVMFunc))
+      Functions.push_back({ &LLVMFunc, ModelFunc });
+
+  std::vector<const llvm::CallInst *> StackFrameCalls(Functions.size());
+  const auto FindStackFrame = [&Functions, &StackFrameCalls](size_t I) {
+    const auto &[LLVMFunc, ModelFunc] = Functions[I];
+    if (not ModelFunc->StackFrameType().empty())
+      StackFrameCalls[I] = findStackFrameCall(*LLVMFunc);
+  };
+
+  if (DLABackendThreads > 1) {
+    llvm::ThreadPool Pool(llvm::hardware_concurrency(DLABackendThreads));
+    for (size_t I = 0; I < Functions.size(); ++I)
+      Pool.async(FindStackFrame, I);
+    Pool.wait();
+  } else {
+    for (size_t I = 0; I < Functions.size(); ++I)
+      FindStackFrame(I);
+  }
+
+  for (const auto &[Entry, StackFrameCall] :
+       llvm::zip(Functions, StackFrameCalls)) {
+    const llvm::Function &LLVMFunc = *Entry.first;
+    model::Function *ModelFunc = Entry.second;
 
     TypePath WrappedPrototypePath = ModelFunc->prototype(*Model);
     using model::QualifiedType;
@@ -735,7 +781,11 @@ bool dla::updateFuncSignatures(const llvm::Module &M,
               "Updating prototype of function "
                 << LLVMFunc.getNameOrAsOperand());
     Updated |= updatePrototype(*Model, ModelPrototype, &LLVMFunc, TypeMap);
-    Updated |= updateStackFrameType(*ModelFunc, LLVMFunc, TypeMap, *Model);
+    Updated |= updateStackFrameType(*ModelFunc,
+                                    LLVMFunc,
+                                    StackFrameCall,
+                                    TypeMap,
+                                    *Model);
 
     // Update prototypes associated to indirect calls, if any are found
     for (const auto &Inst : LLVMFunc)
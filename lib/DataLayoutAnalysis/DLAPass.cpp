@@ -2,6 +2,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
 #include "revng/Model/LoadModelPass.h"
 #include "revng/Model/VerifyHelper.h"
 #include "revng/Pipeline/Context.h"
@@ -12,7 +16,9 @@
 
 #include "revng-c/DataLayoutAnalysis/DLALayouts.h"
 #include "revng-c/DataLayoutAnalysis/DLAPass.h"
+#include "revng-c/DataLayoutAnalysis/DLASnapshot.h"
 #include "revng-c/Pipes/Kinds.h"
+#include "revng-c/Support/Trace.h"
 
 #include "Backend/DLAMakeModelTypes.h"
 #include "Frontend/DLATypeSystemBuilder.h"
@@ -22,6 +28,65 @@ char DLAPass::ID = 0;
 
 static Logger<> BuilderLog("dla-builder-log");
 
+static llvm::cl::opt<std::string>
+  SnapshotPrefix("dla-snapshot-prefix",
+                 llvm::cl::desc("write binary snapshots of the DLA type "
+                                "system to <prefix>-initial.dlasnap and "
+                                "<prefix>-after-ME.dlasnap"),
+                 llvm::cl::value_desc("prefix"));
+
+static llvm::cl::opt<unsigned>
+  CheckpointAfter("dla-checkpoint-after",
+                  llvm::cl::desc("save the DLA type system to the file set "
+                                 "by --dla-checkpoint after this number of "
+                                 "middle-end steps (see dla-step-profile)"),
+                  llvm::cl::init(0));
+
+static llvm::cl::opt<std::string>
+  CheckpointPath("dla-checkpoint",
+                 llvm::cl::desc("file where --dla-checkpoint-after saves "
+                                "the DLA type system"),
+                 llvm::cl::value_desc("path"));
+
+static llvm::cl::opt<std::string>
+  ResumePath("dla-resume",
+             llvm::cl::desc("resume the DLA middle-end from a checkpoint "
+                            "saved with --dla-checkpoint on the same module"),
+             llvm::cl::value_desc("path"));
+
+static void writeSnapshot(const dla::LayoutTypeSystem &TS,
+                          const dla::LayoutTypePtrVect &Values,
+                          const std::string &Name,
+                          unsigned StepIndex = 0) {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Name, EC);
+  revng_check(not EC, ("Cannot open: " + Name).c_str());
+  dla::DLASnapshot::write(TS, Values, OS, StepIndex);
+}
+
+static dla::DLASnapshot readCheckpoint(const dla::LayoutTypePtrVect &Values) {
+  auto MaybeBuffer = llvm::MemoryBuffer::getFile(ResumePath);
+  revng_check(MaybeBuffer, ("Cannot open: " + ResumePath).c_str());
+
+  auto MaybeSnapshot = dla::DLASnapshot::read((*MaybeBuffer)->getBuffer());
+  if (not MaybeSnapshot)
+    revng_abort(llvm::toString(MaybeSnapshot.takeError()).c_str());
+
+  // The nodes of the checkpoint are bound back to the LayoutTypePtrs of the
+  // module through their IDs, make sure they still match
+  for (const dla::DLASnapshot::Value &V : MaybeSnapshot->Values) {
+    std::string Description;
+    if (V.NodeID < Values.size() and not Values[V.NodeID].isEmpty()) {
+      llvm::raw_string_ostream OS(Description);
+      Values[V.NodeID].print(OS);
+    }
+    revng_check(Description == V.Description,
+                "The DLA checkpoint was saved on a different module");
+  }
+
+  return std::move(*MaybeSnapshot);
+}
+
 using Register = llvm::RegisterPass<DLAPass>;
 static ::Register X("dla", "Data Layout Analysis Pass", false, false);
 
@@ -36,6 +101,7 @@ void DLAPass::getAnalysisUsage(llvm::AnalysisUsage &AU) const {
 bool DLAPass::runOnModule(llvm::Module &M) {
 
   llvm::Task T(3, "DLAPass::runOnModule");
+  trace::Scope Trace("dla", "DLAPass");
 
   T.advance("DLA Frontend");
 
@@ -46,79 +112,68 @@ bool DLAPass::runOnModule(llvm::Module &M) {
   dla::LayoutTypeSystem TS;
   dla::DLATypeSystemLLVMBuilder Builder{ TS, Cache };
   const model::Binary &Model = *ModelWrapper.getReadOnlyModel();
-  Builder.buildFromLLVMModule(M, this, Model);
+  {
+    trace::Scope FrontendTrace("dla", "DLA frontend");
+    Builder.buildFromLLVMModule(M, this, Model);
+  }
 
   if (BuilderLog.isEnabled())
     Builder.dumpValuesMapping("DLA-values-initial.csv");
+  if (not SnapshotPrefix.empty())
+    writeSnapshot(TS, Builder.getValues(), SnapshotPrefix + "-initial.dlasnap");
 
   // Middle-end Steps: manipulate nodes and edges of the DLATypeSystem graph
   T.advance("DLA Middleend");
   dla::StepManager SM;
   size_t PtrSize = getPointerSize(Model.Architecture());
+  dla::addDefaultSteps(SM, PtrSize);
+
+  if (CheckpointAfter > 0) {
+    revng_check(not CheckpointPath.empty(),
+                "--dla-checkpoint-after requires --dla-checkpoint");
+    revng_check(CheckpointAfter <= SM.getNumSteps(),
+                "--dla-checkpoint-after is past the last DLA step");
+    const auto Save = [&Builder](const dla::LayoutTypeSystem &TS,
+                                 unsigned StepIndex) {
+      writeSnapshot(TS, Builder.getValues(), CheckpointPath, StepIndex);
+    };
+    SM.setCheckpoint(CheckpointAfter, Save);
+  }
 
-  //
-  // Graph normalization phase
-  //
-  revng_check(SM.addStep<dla::RemoveInvalidPointers>(PtrSize));
-  revng_check(SM.addStep<dla::CollapseEqualitySCC>());
-  revng_check(SM.addStep<dla::CollapseInstanceAtOffset0SCC>());
-  revng_check(SM.addStep<dla::SimplifyInstanceAtOffset0>());
-  revng_check(SM.addStep<dla::PruneLayoutNodesWithoutLayout>());
-  revng_check(SM.addStep<dla::ComputeUpperMemberAccesses>());
-  revng_check(SM.addStep<dla::RemoveInvalidStrideEdges>());
-  revng_check(SM.addStep<dla::PruneLayoutNodesWithoutLayout>());
-  revng_check(SM.addStep<dla::ComputeUpperMemberAccesses>());
-  revng_check(SM.addStep<dla::DecomposeStridedEdges>());
-
-  //
-  // Graph optimization phase
-  //
-  revng_check(SM.addStep<dla::CollapseSingleChild>());
-  revng_check(SM.addStep<dla::DeduplicateFields>());
-  revng_check(SM.addStep<dla::MergePointeesOfPointerUnion>(PtrSize));
-  revng_check(SM.addStep<dla::MergePointerNodes>());
-  revng_check(SM.addStep<dla::CollapseInstanceAtOffset0SCC>());
-  revng_check(SM.addStep<dla::SimplifyInstanceAtOffset0>());
-  revng_check(SM.addStep<dla::PruneLayoutNodesWithoutLayout>());
-  revng_check(SM.addStep<dla::ComputeUpperMemberAccesses>());
-  revng_check(SM.addStep<dla::RemoveInvalidStrideEdges>());
-  revng_check(SM.addStep<dla::PruneLayoutNodesWithoutLayout>());
-  revng_check(SM.addStep<dla::ComputeUpperMemberAccesses>());
-
-  revng_check(SM.addStep<dla::MergePointerNodes>());
-  // CollapseSingleChild and DeduplicateFields run before
-  // CompactCompatibleArrays and ArrangeAccessesHierarchically, to allow them to
-  // produce better results
-  revng_check(SM.addStep<dla::CollapseSingleChild>());
-  revng_check(SM.addStep<dla::DeduplicateFields>());
-  revng_check(SM.addStep<dla::ArrangeAccessesHierarchically>());
-  revng_check(SM.addStep<dla::CompactCompatibleArrays>());
-  revng_check(SM.addStep<dla::PushDownPointers>());
-  // ArrangeAccessesHierarchically can move pointer edges around in some cases,
-  // so we want to run MergePointerNodes again afterwards.
-  revng_check(SM.addStep<dla::MergePointerNodes>());
-  // CollapseSingleChild and DeduplicateFields run again after
-  // CompactCompatibleArrays and ArrangeAccessesHierarchically, to allow them to
-  // improve the results even further.
-  revng_check(SM.addStep<dla::ResolveLeafUnions>());
-  revng_check(SM.addStep<dla::CollapseSingleChild>());
-  revng_check(SM.addStep<dla::DeduplicateFields>());
-  revng_check(SM.addStep<dla::ComputeNonInterferingComponents>());
-  SM.run(TS);
+  // When resuming, the front-end still has to run to rebuild the
+  // LayoutTypePtrs, but the graph it built is replaced by the checkpoint
+  dla::LayoutTypeSystem ResumedTS;
+  dla::LayoutTypeSystem *MiddleEndTS = &TS;
+  unsigned FirstStep = 0;
+  if (not ResumePath.empty()) {
+    dla::DLASnapshot Checkpoint = readCheckpoint(Builder.getValues());
+    Checkpoint.restore(ResumedTS);
+    MiddleEndTS = &ResumedTS;
+    FirstStep = Checkpoint.StepIndex;
+    revng_check(FirstStep <= SM.getNumSteps(),
+                "The DLA checkpoint is past the last DLA step");
+  }
+
+  SM.run(*MiddleEndTS, nullptr, FirstStep);
 
   // Compress the equivalence classes obtained after graph manipulation
-  dla::VectEqClasses &EqClasses = TS.getEqClasses();
+  dla::VectEqClasses &EqClasses = MiddleEndTS->getEqClasses();
   EqClasses.compress();
   dla::LayoutTypePtrVect Values = Builder.getValues();
 
-  if (BuilderLog.isEnabled())
+  // The mapping dump goes through the graph of the front-end
+  if (BuilderLog.isEnabled() and ResumePath.empty())
     Builder.dumpValuesMapping("DLA-values-after-ME.csv");
+  if (not SnapshotPrefix.empty())
+    writeSnapshot(*MiddleEndTS, Values, SnapshotPrefix + "-after-ME.dlasnap");
 
   T.advance("DLA Backend");
 
   // Generate model types
   auto &WritableModel = ModelWrapper.getWriteableModel();
-  auto ValueToTypeMap = dla::makeModelTypes(TS, Values, WritableModel);
+  auto ValueToTypeMap = dla::makeModelTypes(*MiddleEndTS,
+                                            Values,
+                                            WritableModel);
   bool Changed = false;
 
   Changed |= dla::updateFuncSignatures(M, WritableModel, ValueToTypeMap, Cache);
@@ -0,0 +1,331 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+/// A snapshot is the magic string followed by the index of the middle-end step
+/// after which it was taken (uint32_t), a flag (uint8_t) telling if the
+/// equivalence classes were compressed, the number of nodes (uint64_t) and by
+/// a record for each node. All the integers are little endian.
+///
+/// Each node record holds:
+/// * ID, Size (uint64_t), InterferingInfo, NonScalar (uint8_t);
+/// * a flag (uint8_t) telling if the node is removed, followed, if it isn't,
+///   by its equivalence class (uint64_t);
+/// * the length (uint32_t) of the description of its LayoutTypePtr followed
+///   by the description itself, 0 if the node has no LayoutTypePtr;
+/// * the number of successors (uint32_t), each of them made of Target
+///   (uint64_t) and Kind (uint8_t). Instance edges are followed by Offset
+///   (uint64_t), the number of levels of array (uint32_t), and the Stride and
+///   TripCount (uint64_t) of each level, with UINT64_MAX for unknown trip
+///   counts.
+///
+/// The node records are followed by the number of IDs ever assigned (uint64_t)
+/// and, for each of them, the same removed flag and equivalence class that the
+/// node records hold.
+
+#include <limits>
+#include <map>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/BinaryByteStream.h"
+#include "llvm/Support/BinaryStreamReader.h"
+#include "llvm/Support/EndianStream.h"
+
+#include "revng/Support/Assert.h"
+
+#include "revng-c/DataLayoutAnalysis/DLASnapshot.h"
+
+using namespace llvm;
+
+namespace dla {
+
+static constexpr StringRef Magic = "DLASNAP2";
+
+static constexpr uint64_t UnknownTripCount = std::numeric_limits<
+  uint64_t>::max();
+
+static std::optional<uint64_t> getEqClass(const LayoutTypeSystem &TS,
+                                          uint64_t ID) {
+  const VectEqClasses &EqClasses = TS.getEqClasses();
+
+  // Uncompressed
+  if (EqClasses.getNumClasses() == 0) {
+    if (EqClasses.isRemoved(ID))
+      return std::nullopt;
+    return EqClasses.findLeader(ID);
+  }
+
+  // Compressed
+  if (auto Class = EqClasses.getEqClassID(ID))
+    return *Class;
+
+  return std::nullopt;
+}
+
+static void writeEqClass(raw_ostream &OS, std::optional<uint64_t> EqClass) {
+  using support::endian::write;
+  write<uint8_t>(OS, EqClass.has_value(), support::little);
+  if (EqClass)
+    write<uint64_t>(OS, *EqClass, support::little);
+}
+
+static Error readEqClass(BinaryStreamReader &Reader,
+                         std::optional<uint64_t> &Result) {
+  uint8_t HasEqClass = 0;
+  if (Error E = Reader.readInteger(HasEqClass))
+    return E;
+
+  if (HasEqClass) {
+    uint64_t EqClass = 0;
+    if (Error E = Reader.readInteger(EqClass))
+      return E;
+    Result = EqClass;
+  }
+
+  return Error::success();
+}
+
+void DLASnapshot::write(const LayoutTypeSystem &TS,
+                        const LayoutTypePtrVect &Values,
+                        raw_ostream &OS,
+                        uint32_t StepIndex) {
+  using support::endian::write;
+  constexpr auto LE = support::little;
+
+  OS << Magic;
+  write<uint32_t>(OS, StepIndex, LE);
+  write<uint8_t>(OS, TS.getEqClasses().getNumClasses() != 0, LE);
+  write<uint64_t>(OS, TS.getNumLayouts(), LE);
+
+  SmallString<128> Description;
+  for (const LayoutTypeSystemNode *N : TS.getLayoutsRange()) {
+    write<uint64_t>(OS, N->ID, LE);
+    write<uint64_t>(OS, N->Size, LE);
+    write<uint8_t>(OS, N->InterferingInfo, LE);
+    write<uint8_t>(OS, N->NonScalar, LE);
+
+    writeEqClass(OS, getEqClass(TS, N->ID));
+
+    Description.clear();
+    if (N->ID < Values.size() and not Values[N->ID].isEmpty()) {
+      raw_svector_ostream DescriptionStream(Description);
+      Values[N->ID].print(DescriptionStream);
+    }
+    write<uint32_t>(OS, Description.size(), LE);
+    OS << Description;
+
+    write<uint32_t>(OS, N->Successors.size(), LE);
+    for (const auto &[Target, Tag] : N->Successors) {
+      write<uint64_t>(OS, Target->ID, LE);
+      write<uint8_t>(OS, Tag->getKind(), LE);
+      if (Tag->getKind() != TypeLinkTag::LK_Instance)
+        continue;
+
+      const OffsetExpression &OE = Tag->getOffsetExpr();
+      revng_assert(OE.Strides.size() == OE.TripCounts.size());
+      write<uint64_t>(OS, OE.Offset, LE);
+      write<uint32_t>(OS, OE.Strides.size(), LE);
+      for (const auto &[Stride, TripCount] :
+           llvm::zip(OE.Strides, OE.TripCounts)) {
+        write<uint64_t>(OS, Stride, LE);
+        write<uint64_t>(OS, TripCount.value_or(UnknownTripCount), LE);
+      }
+    }
+  }
+
+  write<uint64_t>(OS, TS.getNID(), LE);
+  for (uint64_t ID = 0; ID < TS.getNID(); ++ID)
+    writeEqClass(OS, getEqClass(TS, ID));
+}
+
+Expected<DLASnapshot> DLASnapshot::read(StringRef Buffer) {
+  if (not Buffer.startswith(Magic))
+    return createStringError(inconvertibleErrorCode(),
+                             "Not a DLA snapshot");
+
+  BinaryByteStream Stream(Buffer.drop_front(Magic.size()), support::little);
+  BinaryStreamReader Reader(Stream);
+  DLASnapshot Result;
+
+  uint8_t Compressed = 0;
+  uint64_t NumNodes = 0;
+  if (Error E = Reader.readInteger(Result.StepIndex))
+    return std::move(E);
+  if (Error E = Reader.readInteger(Compressed))
+    return std::move(E);
+  if (Error E = Reader.readInteger(NumNodes))
+    return std::move(E);
+  Result.Compressed = Compressed != 0;
+
+  // Every node record takes at least 27 bytes, don't trust larger counts
+  if (NumNodes > Reader.bytesRemaining() / 27)
+    return createStringError(inconvertibleErrorCode(),
+                             "Truncated DLA snapshot");
+  Result.Nodes.reserve(NumNodes);
+
+  for (uint64_t I = 0; I < NumNodes; ++I) {
+    Node &N = Result.Nodes.emplace_back();
+    uint8_t InterferingInfo = 0;
+    uint8_t NonScalar = 0;
+    if (Error E = Reader.readInteger(N.ID))
+      return std::move(E);
+    if (Error E = Reader.readInteger(N.Size))
+      return std::move(E);
+    if (Error E = Reader.readInteger(InterferingInfo))
+      return std::move(E);
+    if (Error E = Reader.readInteger(NonScalar))
+      return std::move(E);
+
+    if (InterferingInfo > AllChildrenAreNonInterfering)
+      return createStringError(inconvertibleErrorCode(),
+                               "Invalid InterferingInfo in DLA snapshot");
+    N.InterferingInfo = static_cast<InterferingChildrenInfo>(InterferingInfo);
+    N.NonScalar = NonScalar != 0;
+
+    if (Error E = readEqClass(Reader, N.EqClass))
+      return std::move(E);
+
+    uint32_t DescriptionSize = 0;
+    StringRef Description;
+    if (Error E = Reader.readInteger(DescriptionSize))
+      return std::move(E);
+    if (Error E = Reader.readFixedString(Description, DescriptionSize))
+      return std::move(E);
+    if (not Description.empty())
+      Result.Values.push_back({ N.ID, Description.str() });
+
+    uint32_t NumSuccessors = 0;
+    if (Error E = Reader.readInteger(NumSuccessors))
+      return std::move(E);
+
+    for (uint32_t S = 0; S < NumSuccessors; ++S) {
+      Edge &Succ = Result.Edges.emplace_back();
+      Succ.Source = N.ID;
+
+      uint8_t Kind = 0;
+      if (Error E = Reader.readInteger(Succ.Target))
+        return std::move(E);
+      if (Error E = Reader.readInteger(Kind))
+        return std::move(E);
+
+      if (Kind >= TypeLinkTag::LK_All)
+        return createStringError(inconvertibleErrorCode(),
+                                 "Invalid edge kind in DLA snapshot");
+      Succ.Kind = static_cast<TypeLinkTag::LinkKind>(Kind);
+      if (Succ.Kind != TypeLinkTag::LK_Instance)
+        continue;
+
+      uint32_t NumLevels = 0;
+      if (Error E = Reader.readInteger(Succ.OE.Offset))
+        return std::move(E);
+      if (Error E = Reader.readInteger(NumLevels))
+        return std::move(E);
+
+      for (uint32_t L = 0; L < NumLevels; ++L) {
+        uint64_t Stride = 0;
+        uint64_t TripCount = 0;
+        if (Error E = Reader.readInteger(Stride))
+          return std::move(E);
+        if (Error E = Reader.readInteger(TripCount))
+          return std::move(E);
+
+        Succ.OE.Strides.push_back(Stride);
+        if (TripCount == UnknownTripCount)
+          Succ.OE.TripCounts.push_back(std::nullopt);
+        else
+          Succ.OE.TripCounts.push_back(TripCount);
+      }
+    }
+  }
+
+  uint64_t NumIDs = 0;
+  if (Error E = Reader.readInteger(NumIDs))
+    return std::move(E);
+
+  // Every ID takes at least 1 byte
+  if (NumIDs > Reader.bytesRemaining())
+    return createStringError(inconvertibleErrorCode(),
+                             "Truncated DLA snapshot");
+  Result.EqClasses.resize(NumIDs);
+  for (std::optional<uint64_t> &EqClass : Result.EqClasses)
+    if (Error E = readEqClass(Reader, EqClass))
+      return std::move(E);
+
+  if (not Reader.empty())
+    return createStringError(inconvertibleErrorCode(),
+                             "Trailing data in DLA snapshot");
+
+  return Result;
+}
+
+void DLASnapshot::restore(LayoutTypeSystem &TS) const {
+  revng_check(not Compressed,
+              "Cannot restore a DLA snapshot with compressed equivalence "
+              "classes");
+  revng_assert(TS.getNID() == 0);
+
+  // Recreate all the IDs, so that they match the ones in the snapshot
+  using LTSN = LayoutTypeSystemNode;
+  SmallVector<LTSN *, 2> ByID = TS.createArtificialLayoutTypes(EqClasses
+                                                                 .size());
+
+  // Group the IDs by equivalence class, removed ones apart
+  std::map<uint64_t, SmallVector<LTSN *, 2>> Classes;
+  SmallVector<LTSN *, 2> Removed;
+  for (uint64_t ID = 0; ID < EqClasses.size(); ++ID) {
+    if (EqClasses[ID])
+      Classes[*EqClasses[ID]].push_back(ByID[ID]);
+    else
+      Removed.push_back(ByID[ID]);
+  }
+
+  // Merge each class into the only node that survives, which must go first
+  for (const Node &N : Nodes) {
+    revng_check(N.ID < ByID.size() and N.EqClass,
+                "Inconsistent DLA snapshot");
+    auto ClassIt = Classes.find(*N.EqClass);
+    revng_check(ClassIt != Classes.end(),
+                "Inconsistent DLA snapshot: two surviving nodes in the same "
+                "equivalence class, or an empty one");
+    SmallVector<LTSN *, 2> &Members = ClassIt->second;
+    auto It = llvm::find(Members, ByID[N.ID]);
+    revng_check(It != Members.end(), "Inconsistent DLA snapshot");
+    std::iter_swap(Members.begin(), It);
+    TS.mergeNodes(Members);
+    Classes.erase(ClassIt);
+  }
+  revng_check(Classes.empty(), "Inconsistent DLA snapshot");
+
+  for (LTSN *N : Removed)
+    TS.removeNode(N);
+
+  for (const Node &N : Nodes) {
+    LTSN *Restored = ByID[N.ID];
+    Restored->Size = N.Size;
+    Restored->InterferingInfo = N.InterferingInfo;
+    Restored->NonScalar = N.NonScalar;
+  }
+
+  for (const Edge &E : Edges) {
+    revng_check(E.Source < ByID.size() and E.Target < ByID.size(),
+                "Inconsistent DLA snapshot");
+    LTSN *Source = ByID[E.Source];
+    LTSN *Target = ByID[E.Target];
+    switch (E.Kind) {
+    case TypeLinkTag::LK_Equality:
+      TS.addEqualityLink(Source, Target);
+      break;
+    case TypeLinkTag::LK_Instance:
+      TS.addInstanceLink(Source, Target, OffsetExpression(E.OE));
+      break;
+    case TypeLinkTag::LK_Pointer:
+      TS.addPointerLink(Source, Target);
+      break;
+    default:
+      revng_abort();
+    }
+  }
+}
+
+} // end namespace dla
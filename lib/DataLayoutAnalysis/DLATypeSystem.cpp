@@ -4,10 +4,12 @@
 
 #include <algorithm>
 #include <string>
+#include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/Debug.h"
@@ -35,6 +37,10 @@ void *operator new(size_t, NodeAllocatorT &NodeAllocator) {
 
 namespace dla {
 
+trace::AllocationCounters NeighborsAllocations("dla",
+                                               "neighbors allocations",
+                                               "neighbors allocated bytes");
+
 void OffsetExpression::print(llvm::raw_ostream &OS) const {
   OS << "Off: " << Offset;
   auto NStrides = Strides.size();
@@ -206,6 +212,17 @@ void debug_function LayoutTypeSystem::dumpDotOnFile(const char *FName,
   DotFile << "}\n";
 }
 
+LayoutTypeSystem::VisitEpoch::VisitEpoch(const LayoutTypeSystem &TS) :
+  TS(TS) {
+  // Once the epochs wrap around, the stamps left by old visits could match
+  if (++TS.LastVisitEpoch == 0) {
+    for (LayoutTypeSystemNode *Node : TS.Layouts)
+      Node->VisitStamp = 0;
+    TS.LastVisitEpoch = 1;
+  }
+  Epoch = TS.LastVisitEpoch;
+}
+
 LayoutTypeSystemNode *LayoutTypeSystem::createArtificialLayoutType() {
   using LTSN = LayoutTypeSystemNode;
   LTSN *New = new (NodeAllocator) LayoutTypeSystemNode(NID);
@@ -225,69 +242,100 @@ LayoutTypeSystem::createArtificialLayoutTypes(unsigned N) {
   return Result;
 }
 
-static void fixPredSucc(LayoutTypeSystemNode *From,
+/// Rewire to \a Into all the links between the nodes in \a From and the rest
+/// of the graph, dropping the links among \a Into and the nodes in \a From.
+///
+/// The new links of \a Into are collected and deduplicated first, and then
+/// inserted in one go, so the links among the merged nodes are never added to
+/// \a Into just to be removed later.
+static void fixPredSucc(llvm::ArrayRef<LayoutTypeSystemNode *> From,
                         LayoutTypeSystemNode *Into) {
-
-  revng_assert(From != Into);
-
-  uint64_t FromID = From->ID;
+  using LTSN = LayoutTypeSystemNode;
   using IDBasedKey = std::pair<uint64_t, const TypeLinkTag *>;
 
-  // All the predecessors of all the successors of From are updated so that they
-  // point to Into
-  for (auto &[Successor, Tag] : From->Successors) {
-    auto It = Successor->Predecessors.lower_bound(IDBasedKey{ FromID,
-                                                              nullptr });
-    auto End = Successor->Predecessors.upper_bound(IDBasedKey{ FromID + 1,
-                                                               nullptr });
-    while (It != End) {
-      auto Next = std::next(It);
-      auto Extracted = Successor->Predecessors.extract(It);
-      revng_assert(Extracted);
-      Successor->Predecessors.insert({ Into, Extracted.value().second });
-      It = Next;
+  llvm::SmallPtrSet<const LTSN *, 8> Merged(From.begin(), From.end());
+  Merged.insert(Into);
+
+  const auto EraseLinksTo = [](LTSN::NeighborsSet &Neighbors, uint64_t ID) {
+    auto It = Neighbors.lower_bound(IDBasedKey{ ID, nullptr });
+    auto End = Neighbors.upper_bound(IDBasedKey{ ID + 1, nullptr });
+    Neighbors.erase(It, End);
+  };
+
+  std::vector<LTSN::Link> NewSuccessors;
+  std::vector<LTSN::Link> NewPredecessors;
+  for (LTSN *F : From) {
+    revng_assert(F != Into);
+
+    // All the predecessors of all the successors of F are updated so that they
+    // point to Into
+    for (const auto &[Successor, Tag] : F->Successors) {
+      if (Merged.contains(Successor))
+        continue;
+      EraseLinksTo(Successor->Predecessors, F->ID);
+      Successor->Predecessors.insert({ Into, Tag });
+      NewSuccessors.push_back({ Successor, Tag });
     }
-  }
 
-  // All the successors of all the predecessors of From are updated so that they
-  // point to Into
-  for (auto &[Predecessor, Tag] : From->Predecessors) {
-    auto It = Predecessor->Successors.lower_bound(IDBasedKey{ FromID,
-                                                              nullptr });
-    auto End = Predecessor->Successors.upper_bound(IDBasedKey{ FromID + 1,
-                                                               nullptr });
-    while (It != End) {
-      auto Next = std::next(It);
-      auto Extracted = Predecessor->Successors.extract(It);
-      revng_assert(Extracted);
-      Predecessor->Successors.insert({ Into, Extracted.value().second });
-      It = Next;
+    // All the successors of all the predecessors of F are updated so that they
+    // point to Into
+    for (const auto &[Predecessor, Tag] : F->Predecessors) {
+      if (Merged.contains(Predecessor))
+        continue;
+      EraseLinksTo(Predecessor->Successors, F->ID);
+      Predecessor->Successors.insert({ Into, Tag });
+      NewPredecessors.push_back({ Predecessor, Tag });
     }
-  }
 
-  // Merge all the predecessors and successors.
-  {
-    Into->Predecessors.insert(From->Predecessors.begin(),
-                              From->Predecessors.end());
-    Into->Successors.insert(From->Successors.begin(), From->Successors.end());
+    // Remove the links between Into and F
+    EraseLinksTo(Into->Successors, F->ID);
+    EraseLinksTo(Into->Predecessors, F->ID);
   }
 
-  // Remove self-references from predecessors and successors.
-  {
-    const auto RemoveSelfEdges = [FromID,
-                                  IntoID = Into->ID](auto &NeighborsSet) {
-      auto FromIt = NeighborsSet.lower_bound(IDBasedKey{ FromID, nullptr });
-      auto FromEnd = NeighborsSet.upper_bound(IDBasedKey{ FromID + 1,
-                                                          nullptr });
-      NeighborsSet.erase(FromIt, FromEnd);
-      auto IntoIt = NeighborsSet.lower_bound(IDBasedKey{ IntoID, nullptr });
-      auto IntoEnd = NeighborsSet.upper_bound(IDBasedKey{ IntoID + 1,
-                                                          nullptr });
-      NeighborsSet.erase(IntoIt, IntoEnd);
-    };
-    RemoveSelfEdges(Into->Predecessors);
-    RemoveSelfEdges(Into->Successors);
+  const auto InsertAll = [](LTSN::NeighborsSet &Neighbors,
+                            std::vector<LTSN::Link> &New) {
+    // Sorting first makes the insertions in the set cheaper, and drops the
+    // duplicates coming from different nodes in From
+    llvm::sort(New, Neighbors.value_comp());
+    New.erase(std::unique(New.begin(), New.end()), New.end());
+    Neighbors.insert(New.begin(), New.end());
+  };
+  InsertAll(Into->Successors, NewSuccessors);
+  InsertAll(Into->Predecessors, NewPredecessors);
+}
+
+LayoutTypeSystem::MemoryUsage LayoutTypeSystem::computeMemoryUsage() const {
+  // The color and the three pointers of each node of a red-black tree
+  constexpr size_t TreeNodeOverhead = 4 * sizeof(void *);
+  // The next pointer and the cached hash of each node of an unordered_set
+  constexpr size_t HashNodeOverhead = sizeof(void *) + sizeof(size_t);
+
+  MemoryUsage Result;
+  Result.Nodes = NodeAllocator.getTotalMemory();
+
+  size_t NumLinks = 0;
+  for (const LayoutTypeSystemNode *N : Layouts)
+    NumLinks += N->Successors.size() + N->Predecessors.size();
+  Result.Edges = NumLinks * (sizeof(LayoutTypeSystemNode::Link)
+                             + TreeNodeOverhead);
+  Result.Edges += Layouts.size() * (sizeof(LayoutTypeSystemNode *)
+                                    + TreeNodeOverhead);
+
+  Result.Tags = LinkTags.size() * (sizeof(TypeLinkTag) + HashNodeOverhead);
+  Result.Tags += LinkTags.bucket_count() * sizeof(void *);
+  for (const TypeLinkTag &Tag : LinkTags) {
+    if (Tag.getKind() != TypeLinkTag::LK_Instance)
+      continue;
+
+    // A single level of array is stored inline
+    const OffsetExpression &OE = Tag.getOffsetExpr();
+    if (OE.Strides.capacity() > 1)
+      Result.Tags += OE.Strides.capacity_in_bytes();
+    if (OE.TripCounts.capacity() > 1)
+      Result.Tags += OE.TripCounts.capacity_in_bytes();
   }
+
+  return Result;
 }
 
 static Logger<> MergeLog("dla-merge-nodes");
@@ -321,10 +369,12 @@ void LayoutTypeSystem::mergeNodes(llvm::ArrayRef<LayoutTypeSystemNode *>
     Into->NonScalar |= From->NonScalar;
 
     EqClasses.join(IntoID, From->ID);
+  }
 
-    fixPredSucc(From, Into);
+  fixPredSucc(ToMerge.drop_front(), Into);
 
-    // Remove From from Layouts
+  // Remove the merged nodes from Layouts
+  for (LayoutTypeSystemNode *From : llvm::drop_begin(ToMerge, 1)) {
     bool Erased = Layouts.erase(From);
     revng_assert(Erased);
     From->~LayoutTypeSystemNode();
@@ -583,7 +633,7 @@ bool LayoutTypeSystem::verifyDAG() const {
 
   // A graph is a DAG if and only if all its strongly connected components have
   // size 1
-  std::set<const LayoutTypeSystemNode *> Visited;
+  VisitEpoch Visited = startVisit();
   for (const auto &Node : llvm::nodes(this)) {
     revng_assert(Node != nullptr);
     if (Visited.contains(Node))
@@ -613,7 +663,7 @@ bool LayoutTypeSystem::verifyInstanceDAG() const {
 
   // A graph is a DAG if and only if all its strongly connected components have
   // size 1
-  std::set<const LayoutTypeSystemNode *> Visited;
+  VisitEpoch Visited = startVisit();
   for (const auto &Node : llvm::nodes(this)) {
     revng_assert(Node != nullptr);
     if (Visited.contains(Node))
@@ -642,7 +692,7 @@ bool LayoutTypeSystem::verifyPointerDAG() const {
 
   // A graph is a DAG if and only if all its strongly connected components have
   // size 1
-  std::set<const LayoutTypeSystemNode *> Visited;
+  VisitEpoch Visited = startVisit();
   for (const auto &Node : llvm::nodes(this)) {
     revng_assert(Node != nullptr);
     if (Visited.contains(Node))
@@ -685,7 +735,7 @@ bool LayoutTypeSystem::verifyInstanceAtOffset0DAG() const {
   if (not verifyConsistency())
     return false;
 
-  std::set<const LayoutTypeSystemNode *> Visited;
+  VisitEpoch Visited = startVisit();
   for (const auto &Node : llvm::nodes(this)) {
     revng_assert(Node != nullptr);
     if (Visited.contains(Node))
@@ -735,11 +785,20 @@ bool LayoutTypeSystem::verifyUnions() const {
 }
 
 unsigned VectEqClasses::growBy1() {
+  NextMember.push_back(NElems);
   ++NElems;
   grow(NElems);
   return NElems;
 }
 
+unsigned VectEqClasses::join(unsigned A, unsigned B) {
+  // Swapping the successors of two elements in different circular lists
+  // splices the two lists together.
+  if (findLeader(A) != findLeader(B))
+    std::swap(NextMember[A], NextMember[B]);
+  return llvm::IntEqClasses::join(A, B);
+}
+
 void VectEqClasses::remove(const unsigned A) {
   if (RemovedID)
     join(A, *RemovedID);
@@ -775,10 +834,16 @@ std::vector<unsigned>
 VectEqClasses::computeEqClass(const unsigned ElemID) const {
   std::vector<unsigned> EqClass;
 
-  for (unsigned OtherID = 0; OtherID < NElems; OtherID++)
-    if (haveSameEqClass(ElemID, OtherID))
-      EqClass.push_back(OtherID);
+  if (ElemID >= NElems)
+    return EqClass;
+
+  unsigned Member = ElemID;
+  do {
+    EqClass.push_back(Member);
+    Member = NextMember[Member];
+  } while (Member != ElemID);
 
+  llvm::sort(EqClass);
   return EqClass;
 }
 
@@ -2,6 +2,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
@@ -31,6 +33,12 @@ using TSBuilder = DLATypeSystemLLVMBuilder;
 
 bool TSBuilder::createInterproceduralTypes(llvm::Module &M,
                                            const model::Binary &Model) {
+  // The nodes of the formal arguments of each callee, filled the first time a
+  // call site passes each argument, so that the other call sites don't have
+  // to look them up in VisitedValues again
+  llvm::DenseMap<const Function *, SmallVector<LayoutTypeSystemNode *, 4>>
+    FormalArgNodes;
+
   for (const Function &F : M.functions()) {
 
     auto FTags = FunctionTags::TagsSet::from(&F);
@@ -170,6 +178,10 @@ bool TSBuilder::createInterproceduralTypes(llvm::Module &M,
           if (not Callee)
             continue;
 
+          auto &CalleeArgNodes = FormalArgNodes[Callee];
+          if (CalleeArgNodes.empty())
+            CalleeArgNodes.resize(Callee->arg_size(), nullptr);
+
           unsigned ArgNo = 0U;
           for (const Use &ArgUse : Call->args()) {
 
@@ -179,23 +191,26 @@ bool TSBuilder::createInterproceduralTypes(llvm::Module &M,
                          or isa<PointerType>(ActualArg->getType()));
             auto ActualTypes = getOrCreateLayoutTypes(*ActualArg);
 
-            // Create the layout for the formal arguments.
-            Value *FormalArg = Callee->getArg(ArgNo);
-            revng_assert(isa<IntegerType>(FormalArg->getType())
-                         or isa<PointerType>(FormalArg->getType()));
-            auto FormalTypes = getOrCreateLayoutTypes(*FormalArg);
-            revng_assert(1ULL == ActualTypes.size() == FormalTypes.size());
+            // Create the layout for the formal arguments. Formal arguments
+            // are integers or pointers, so they have a single node.
+            LayoutTypeSystemNode *&FormalNode = CalleeArgNodes[ArgNo];
+            if (FormalNode == nullptr) {
+              Value *FormalArg = Callee->getArg(ArgNo);
+              revng_assert(isa<IntegerType>(FormalArg->getType())
+                           or isa<PointerType>(FormalArg->getType()));
+              auto FormalTypes = getOrCreateLayoutTypes(*FormalArg);
+              revng_assert(FormalTypes.size() == 1ULL);
+              FormalNode = FormalTypes.front().first;
+            }
+            revng_assert(ActualTypes.size() == 1ULL);
 
-            auto FieldNum = FormalTypes.size();
             if (not isa<ConstantInt>(ActualArg)) {
-              for (auto FieldId = 0ULL; FieldId < FieldNum; ++FieldId) {
-                TS.addInstanceLink(ActualTypes[FieldId].first,
-                                   FormalTypes[FieldId].first,
-                                   OffsetExpression{});
-                auto *Placeholder = TS.createArtificialLayoutType();
-                Placeholder->Size = getPointerSize(Model.Architecture());
-                TS.addPointerLink(Placeholder, ActualTypes[FieldId].first);
-              }
+              TS.addInstanceLink(ActualTypes.front().first,
+                                 FormalNode,
+                                 OffsetExpression{});
+              auto *Placeholder = TS.createArtificialLayoutType();
+              Placeholder->Size = getPointerSize(Model.Architecture());
+              TS.addPointerLink(Placeholder, ActualTypes.front().first);
             }
             ++ArgNo;
           }
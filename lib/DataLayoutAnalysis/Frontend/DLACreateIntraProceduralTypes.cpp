@@ -2,8 +2,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <memory>
 #include <optional>
 #include <utility>
+#include <vector>
 
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/STLExtras.h"
@@ -18,6 +20,8 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ThreadPool.h"
 
 #include "revng/EarlyFunctionAnalysis/FunctionMetadataCache.h"
 #include "revng/Model/Architecture.h"
@@ -41,6 +45,13 @@ using namespace model::Architecture;
 using LayoutTypeSystemNode = dla::LayoutTypeSystemNode;
 using SCEVTypeMap = SCEVBaseAddressExplorer::SCEVTypeMap;
 
+static llvm::cl::opt<unsigned>
+  DLAFrontendThreads("dla-frontend-threads",
+                     llvm::cl::desc("Number of threads computing the "
+                                    "dominator trees of the isolated "
+                                    "functions in the DLA frontend"),
+                     llvm::cl::init(1));
+
 static int64_t getSCEVConstantSExtVal(const SCEV *S) {
   return cast<SCEVConstant>(S)->getAPInt().getSExtValue();
 }
@@ -54,10 +65,11 @@ private:
   const model::Binary &Model;
   Function *F;
   ScalarEvolution *SE;
-  llvm::DominatorTree DT;
-  llvm::PostDominatorTree PDT;
+  const llvm::DominatorTree *DT;
+  const llvm::PostDominatorTree *PDT;
 
   SCEVTypeMap SCEVToLayoutType;
+  SCEVBaseAddressExplorer Explorer;
   FunctionMetadataCache *Cache;
 
 protected:
@@ -173,9 +185,9 @@ protected:
         if (Count != nullptr and not Count->isZero()) {
           SmallVector<BasicBlock *, 4> ExitBlocks;
           L->getUniqueExitBlocks(ExitBlocks);
-          const auto IsDominatedByB = [&DT = this->DT,
+          const auto IsDominatedByB = [DT = this->DT,
                                        &B](const BasicBlock *OtherB) {
-            return DT.dominates(&B, OtherB);
+            return DT->dominates(&B, OtherB);
           };
           if (std::all_of(ExitBlocks.begin(),
                           ExitBlocks.end(),
@@ -187,7 +199,7 @@ protected:
             // loop-simplified form is SCEVBackedgeCount + 1, because in
             // loop-simplified form we only have one back edge.
             TripCount = Count->getAPInt().getSExtValue() + 1;
-          } else if (PDT.dominates(L->getHeader(), &B)) {
+          } else if (PDT->dominates(L->getHeader(), &B)) {
             // If the loop header postdominates B, B is executed the same
             // number of times as the only backedge
             TripCount = Count->getAPInt().getSExtValue();
@@ -215,10 +227,11 @@ protected:
       // TripCounts are held as 2 separate vectors in OffsetExpression.
       // Eventually we should change the code so that its a vector of structs
       // instead of two separate vectors.
-      llvm::SmallVector<std::pair<int64_t, std::optional<int64_t>>> Tmp;
+      using TripCountT = OffsetExpression::TripCountT;
+      llvm::SmallVector<std::pair<uint64_t, TripCountT>> Tmp;
       for (const auto &[S, TC] : llvm::zip(OE.Strides, OE.TripCounts))
         Tmp.push_back({ S, TC });
-      llvm::stable_sort(Tmp, llvm::on_first<std::greater<int64_t>>());
+      llvm::stable_sort(Tmp, llvm::on_first<std::greater<uint64_t>>());
       for (const auto &Group : llvm::enumerate(Tmp)) {
         OE.Strides[Group.index()] = Group.value().first;
         OE.TripCounts[Group.index()] = Group.value().second;
@@ -239,12 +252,16 @@ protected:
   }
 
 public:
-  void setupForProcessingFunction(ModulePass *MP, Function *TheF) {
+  void setupForProcessingFunction(ModulePass *MP,
+                                  Function *TheF,
+                                  const llvm::DominatorTree &TheDT,
+                                  const llvm::PostDominatorTree &ThePDT) {
     SE = &MP->getAnalysis<llvm::ScalarEvolutionWrapperPass>(*TheF).getSE();
     F = TheF;
-    DT.recalculate(*F);
-    PDT.recalculate(*F);
+    DT = &TheDT;
+    PDT = &ThePDT;
     SCEVToLayoutType.clear();
+    Explorer.clear();
   }
 
   bool getOrCreateSCEVTypes(DLATypeSystemLLVMBuilder &Builder) {
@@ -627,11 +644,9 @@ public:
       return AddedSomething;
 
     const SCEV *PtrSCEV = SE->getSCEV(PointerVal);
-    using Explorer = SCEVBaseAddressExplorer;
-    auto PossibleBaseAddresses = Explorer().findBases(SE,
-                                                      PtrSCEV,
-                                                      SCEVToLayoutType);
-    for (const SCEV *BaseAddrSCEV : PossibleBaseAddresses)
+    const SCEVTypeMap &M = SCEVToLayoutType;
+    const auto &Bases = Explorer.findBasesMemoized(SE, PtrSCEV, M);
+    for (const SCEV *BaseAddrSCEV : Bases)
       AddedSomething |= addInstanceLink(Builder, PointerVal, BaseAddrSCEV, B);
 
     return AddedSomething;
@@ -692,19 +707,79 @@ bool Builder::connectToFuncsWithSamePrototype(const llvm::CallInst *Call,
   return Changed;
 }
 
+namespace {
+
+/// Dominator and post-dominator trees of a function
+struct DominatorTrees {
+  llvm::DominatorTree DT;
+  llvm::PostDominatorTree PDT;
+
+  DominatorTrees(Function &F) : DT(F), PDT(F) {}
+};
+
+} // end anonymous namespace
+
+/// Compute the DominatorTrees of each function in \a Functions, in parallel
+/// if requested.
+///
+/// This only reads the IR and doesn't touch the LLVMContext, so it's safe to
+/// do concurrently. Everything else in the frontend is not: ScalarEvolution
+/// creates constants and types in the LLVMContext, and all the functions share
+/// the LayoutTypeSystem and the maps of the Builder.
+static std::vector<std::unique_ptr<DominatorTrees>>
+computeDominatorTrees(ArrayRef<Function *> Functions,
+                      std::optional<llvm::ThreadPool> &Pool) {
+  std::vector<std::unique_ptr<DominatorTrees>> Result(Functions.size());
+
+  if (not Pool.has_value()) {
+    for (const auto &[F, Trees] : llvm::zip(Functions, Result))
+      Trees = std::make_unique<DominatorTrees>(*F);
+    return Result;
+  }
+
+  for (const auto &[F, Trees] : llvm::zip(Functions, Result))
+    Pool->async([F = F, &Trees = Trees]() {
+      Trees = std::make_unique<DominatorTrees>(*F);
+    });
+  Pool->wait();
+
+  return Result;
+}
+
 bool Builder::createIntraproceduralTypes(llvm::Module &M,
                                          llvm::ModulePass *MP,
                                          const model::Binary &Model) {
   bool Changed = false;
   InstanceLinkAdder ILA(Model, *Cache);
 
+  std::vector<Function *> Isolated;
   for (Function &F : M.functions()) {
     auto FTags = FunctionTags::TagsSet::from(&F);
     if (F.isIntrinsic() or not FTags.contains(FunctionTags::Isolated))
       continue;
     revng_assert(not F.isVarArg());
+    Isolated.push_back(&F);
+  }
+
+  // The dominator trees are computed ahead of time, in batches, so that we
+  // don't keep the trees of the whole module alive at the same time.
+  std::optional<llvm::ThreadPool> Pool;
+  size_t BatchSize = 1;
+  if (DLAFrontendThreads > 1) {
+    Pool.emplace(llvm::hardware_concurrency(DLAFrontendThreads));
+    BatchSize = 8 * Pool->getThreadCount();
+  }
+
+  std::vector<std::unique_ptr<DominatorTrees>> Trees;
+  for (size_t I = 0; I < Isolated.size(); ++I) {
+    if (I % BatchSize == 0) {
+      ArrayRef<Function *> Batch = ArrayRef<Function *>(Isolated).slice(I);
+      Trees = computeDominatorTrees(Batch.take_front(BatchSize), Pool);
+    }
 
-    ILA.setupForProcessingFunction(MP, &F);
+    Function &F = *Isolated[I];
+    const DominatorTrees &FTrees = *Trees[I % BatchSize];
+    ILA.setupForProcessingFunction(MP, &F, FTrees.DT, FTrees.PDT);
     Changed |= ILA.getOrCreateSCEVTypes(*this);
 
     llvm::ReversePostOrderTraversal RPOT(&F.getEntryBlock());
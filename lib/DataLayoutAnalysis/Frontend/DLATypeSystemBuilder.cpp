@@ -2,6 +2,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/Argument.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instruction.h"
@@ -65,6 +66,32 @@ static void assertGetLayoutTypePreConditions(const Value *V, unsigned Id) {
                or cast<Function>(V)->getReturnType()->isStructTy());
 }
 
+std::optional<unsigned>
+DLATypeSystemLLVMBuilder::getSlot(const Value *V, unsigned Id, bool Create) {
+  // The slot of V itself comes first, followed by those of its fields
+  unsigned Offset = Id == LayoutTypePtr::fieldNumNone ? 0 : Id + 1;
+
+  auto [It, New] = FirstSlots.try_emplace(V, SlotValues.size());
+  if (New) {
+    if (not Create) {
+      FirstSlots.erase(It);
+      return std::nullopt;
+    }
+
+    SlotValues.push_back(LayoutTypePtr(V));
+    if (const auto *F = dyn_cast<Function>(V))
+      if (auto *StructTy = dyn_cast<StructType>(F->getReturnType()))
+        for (unsigned FieldId = 0; FieldId < StructTy->getNumElements();
+             ++FieldId)
+          SlotValues.push_back(LayoutTypePtr(V, FieldId));
+    SlotNodes.resize(SlotValues.size(), nullptr);
+  }
+
+  unsigned Slot = It->second + Offset;
+  revng_assert(Slot < SlotValues.size() and SlotValues[Slot].fieldNum() == Id);
+  return Slot;
+}
+
 LayoutTypeSystemNode *DLATypeSystemLLVMBuilder::getLayoutType(const Value *V,
                                                               unsigned Id) {
 
@@ -74,8 +101,9 @@ LayoutTypeSystemNode *DLATypeSystemLLVMBuilder::getLayoutType(const Value *V,
   // Check pre-conditions
   assertGetLayoutTypePreConditions(V, Id);
 
-  LayoutTypePtr Key(V, Id);
-  return VisitedValues.at(Key);
+  std::optional<unsigned> Slot = getSlot(V, Id, false);
+  revng_assert(Slot.has_value() and SlotNodes[*Slot] != nullptr);
+  return SlotNodes[*Slot];
 }
 
 std::pair<LayoutTypeSystemNode *, bool>
@@ -87,17 +115,12 @@ DLATypeSystemLLVMBuilder::getOrCreateLayoutType(const Value *V, unsigned Id) {
   // Check pre-conditions
   assertGetLayoutTypePreConditions(V, Id);
 
-  LayoutTypePtr Key(V, Id);
-  auto HintIt = VisitedValues.lower_bound(Key);
-  if (HintIt != VisitedValues.end()
-      and not VisitedValues.key_comp()(Key, HintIt->first)) {
-    return std::make_pair(HintIt->second, false);
-  }
-
-  LayoutTypeSystemNode *Res = TS.createArtificialLayoutType();
+  LayoutTypeSystemNode *&Node = SlotNodes[*getSlot(V, Id, true)];
+  if (Node != nullptr)
+    return std::make_pair(Node, false);
 
-  VisitedValues.emplace_hint(HintIt, Key, Res);
-  return std::make_pair(Res, true);
+  Node = TS.createArtificialLayoutType();
+  return std::make_pair(Node, true);
 }
 
 static void assertGetLayoutTypePreConditions(const Value &V) {
@@ -327,12 +350,12 @@ void DLATypeSystemLLVMBuilder::createValuesList() {
   // Can we prevent this?
   this->Values.resize(TS.getNID());
 
-  for (auto &MapIt : VisitedValues) {
-    LayoutTypePtr Ptr = MapIt.first;
-    unsigned NodeID = MapIt.second->ID;
+  for (const auto &[Ptr, Node] : llvm::zip(SlotValues, SlotNodes)) {
+    if (Node == nullptr)
+      continue;
 
-    revng_assert(NodeID < Values.size());
-    this->Values[NodeID] = Ptr;
+    revng_assert(Node->ID < Values.size());
+    this->Values[Node->ID] = Ptr;
   }
 }
 
@@ -392,6 +415,8 @@ void DLATypeSystemLLVMBuilder::buildFromLLVMModule(llvm::Module &M,
   createIntraproceduralTypes(M, MP, Model);
 
   createValuesList();
-  VisitedValues.clear();
+  FirstSlots.clear();
+  SlotValues = {};
+  SlotNodes = {};
   VisitedPrototypes.clear();
 }
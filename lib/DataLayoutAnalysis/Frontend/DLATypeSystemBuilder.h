@@ -4,6 +4,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <optional>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Pass.h"
 
 #include "revng/EarlyFunctionAnalysis/FunctionMetadataCache.h"
@@ -50,7 +54,6 @@ public:
 /// This class builds a DLA type system from an LLVM module
 class DLATypeSystemLLVMBuilder {
 public:
-  using VisitedMapT = std::map<LayoutTypePtr, LayoutTypeSystemNode *>;
   using PrototypesMapT = std::map<const model::Type *, FuncOrCallInst>;
 
 private:
@@ -64,8 +67,18 @@ private:
   /// corresponding Node
   LayoutTypePtrVect Values;
 
-  /// Reverse map between `llvm::Value`s and Nodes
-  VisitedMapT VisitedValues;
+  /// The `llvm::Value`s that have been looked up are numbered densely, in
+  /// order of appearance. Each of them gets a slot, plus one for each field
+  /// if it's a function returning a struct. This maps each `llvm::Value` to
+  /// its first slot.
+  llvm::DenseMap<const llvm::Value *, unsigned> FirstSlots;
+
+  /// The LayoutTypePtr each slot stands for
+  LayoutTypePtrVect SlotValues;
+
+  /// Reverse map between slots and Nodes, nullptr for the slots whose Node
+  /// has not been created
+  std::vector<LayoutTypeSystemNode *> SlotNodes;
   /// Associate each indirect call's prototype in the model with the
   /// first `llvm::CallInst` found with that prototype,
   PrototypesMapT VisitedPrototypes;
@@ -74,6 +87,11 @@ private:
   FunctionMetadataCache *Cache;
 
 private:
+  /// The slot of the LayoutTypePtr (\a V, \a Id), allocating the slots of
+  /// \a V if \a Create is true and it has none
+  std::optional<unsigned>
+  getSlot(const llvm::Value *V, unsigned Id, bool Create);
+
   LayoutTypeSystemNode *getLayoutType(const llvm::Value *V, unsigned Id);
 
   LayoutTypeSystemNode *getLayoutType(const llvm::Value *V) {
@@ -34,16 +34,24 @@ static bool isAlwaysAddress(const llvm::Value *V) {
   return false;
 }
 
-std::set<const llvm::SCEV *>
+SCEVBaseAddressExplorer::SCEVSet
 SCEVBaseAddressExplorer::findBases(llvm::ScalarEvolution *SE,
                                    const llvm::SCEV *Root,
                                    const SCEVTypeMap &M) {
-  std::set<const llvm::SCEV *> Result;
+  SCEVSet Result;
   Worklist.clear();
+  Visited.clear();
   Worklist.push_back(Root);
 
   while (not Worklist.empty()) {
     const llvm::SCEV *AddressCandidate = Worklist.pop_back_val();
+
+    // SCEVs are DAGs, and sub-expressions shared by many operands would be
+    // explored once for each path reaching them. Exploring them again always
+    // yields the same bases, so we can skip them.
+    if (not Visited.insert(AddressCandidate).second)
+      continue;
+
     const llvm::SCEV *AddrSCEV = nullptr;
     if (const auto *C = dyn_cast<llvm::SCEVConstant>(AddressCandidate)) {
       // Constants are considered addresses only in case they point to some
@@ -117,6 +125,19 @@ SCEVBaseAddressExplorer::findBases(llvm::ScalarEvolution *SE,
   return Result;
 }
 
+const SCEVBaseAddressExplorer::SCEVSet &
+SCEVBaseAddressExplorer::findBasesMemoized(llvm::ScalarEvolution *SE,
+                                           const llvm::SCEV *Root,
+                                           const SCEVTypeMap &M) {
+  auto [It, New] = Memo.try_emplace(Root);
+  MemoEntry &Entry = It->second;
+  if (New or Entry.MapSize != M.size()) {
+    Entry.Bases = findBases(SE, Root, M);
+    Entry.MapSize = M.size();
+  }
+  return Entry.Bases;
+}
+
 size_t
 SCEVBaseAddressExplorer::checkAddressOrTraverse(llvm::ScalarEvolution *SE,
                                                 const llvm::SCEV *S) {
@@ -7,6 +7,7 @@
 #include <map>
 #include <set>
 
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 
 namespace llvm {
@@ -24,8 +25,18 @@ class SCEVBaseAddressExplorer {
 public:
   using SCEVTypeMap = std::map<const llvm::SCEV *, dla::LayoutTypeSystemNode *>;
 
+  using SCEVSet = std::set<const llvm::SCEV *>;
+
 private:
   llvm::SmallVector<const llvm::SCEV *, 4> Worklist;
+  llvm::SmallPtrSet<const llvm::SCEV *, 8> Visited;
+
+  struct MemoEntry {
+    /// Size of the SCEVTypeMap when Bases were computed
+    size_t MapSize;
+    SCEVSet Bases;
+  };
+  std::map<const llvm::SCEV *, MemoEntry> Memo;
 
 public:
   SCEVBaseAddressExplorer() = default;
@@ -38,9 +49,21 @@ public:
   // If \M is not empty, all the SCEVs with an entry in \M are considered as
   // addresses, and the exploration of the operands does not traverse them, even
   // if the SCEV potentially has the expressive power to do it.
-  std::set<const llvm::SCEV *> findBases(llvm::ScalarEvolution *SE,
-                                         const llvm::SCEV *Root,
-                                         const SCEVTypeMap &M);
+  SCEVSet findBases(llvm::ScalarEvolution *SE,
+                    const llvm::SCEV *Root,
+                    const SCEVTypeMap &M);
+
+  /// Same as findBases, but reuses the results of previous calls.
+  //
+  // The results for a given \Root are recomputed only if \M has grown in the
+  // meantime. For this reason, between two calls to clear(), \M is only
+  // allowed to grow, and all the calls must refer to the same \M and \SE.
+  const SCEVSet &findBasesMemoized(llvm::ScalarEvolution *SE,
+                                   const llvm::SCEV *Root,
+                                   const SCEVTypeMap &M);
+
+  /// Drops all the memoized results
+  void clear() { Memo.clear(); }
 
 private:
   size_t checkAddressOrTraverse(llvm::ScalarEvolution *SE, const llvm::SCEV *S);
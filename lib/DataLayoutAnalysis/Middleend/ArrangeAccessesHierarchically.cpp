@@ -352,7 +352,7 @@ absorbVolatileChildren(LayoutTypeSystem &TS, LayoutTypeSystemNode *Parent) {
 }
 
 static void absorbVolatileChildren(LayoutTypeSystem &TS) {
-  std::set<const dla::LayoutTypeSystemNode *> Visited;
+  LayoutTypeSystem::VisitEpoch Visited = TS.startVisit();
   for (LayoutTypeSystemNode *Root : llvm::nodes(&TS)) {
 
     if (Visited.contains(Root))
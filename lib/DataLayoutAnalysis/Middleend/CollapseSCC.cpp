@@ -2,12 +2,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
-#include <set>
+#include <algorithm>
+#include <limits>
 #include <type_traits>
 #include <vector>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/GraphTraits.h"
-#include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/Support/Progress.h"
@@ -37,31 +38,119 @@ static bool sizeGreater(const LTSN *LHS, const LTSN *RHS) {
   return LHS->Size > RHS->Size;
 }
 
-template<typename NodeT>
-static bool collapseSCCs(LayoutTypeSystem &TS) {
+namespace {
+
+/// Snapshot of the edges of a LayoutTypeSystem in compressed sparse row form.
+///
+/// Nodes are identified by their index in Nodes, and the successors of the
+/// node with index I are Edges[EdgeBegin[I]], ..., Edges[EdgeBegin[I + 1] - 1].
+struct CompactGraph {
+  std::vector<LTSN *> Nodes;
+  std::vector<unsigned> EdgeBegin;
+  std::vector<unsigned> Edges;
+};
 
-  std::set<GraphNodeT> VisitedNodes;
+} // end anonymous namespace
 
-  using scc_t = std::vector<GraphNodeT>;
-  llvm::SmallVector<scc_t, 0> ToCollapse;
+/// Build a CompactGraph with the edges of \a TS visible through \a NodeT
+template<typename NodeT>
+static CompactGraph makeCompactGraph(LayoutTypeSystem &TS) {
+  CompactGraph Result;
 
-  // We cannot start just from the roots because we cannot exclude that there
-  // are loops without entries.
-  for (const auto &Node : llvm::nodes(&TS)) {
+  llvm::DenseMap<const LTSN *, unsigned> Index;
+  Index.reserve(TS.getNumLayouts());
+  Result.Nodes.reserve(TS.getNumLayouts());
+  for (LTSN *Node : llvm::nodes(&TS)) {
     revng_assert(Node != nullptr);
-    revng_log(LogVerbose, "## Analyzing SCCs from  " << Node);
-    if (VisitedNodes.contains(Node)) {
-      revng_log(LogVerbose, "## Was already visited");
+    Index[Node] = Result.Nodes.size();
+    Result.Nodes.push_back(Node);
+  }
+
+  Result.EdgeBegin.reserve(Result.Nodes.size() + 1);
+  for (LTSN *Node : Result.Nodes) {
+    Result.EdgeBegin.push_back(Result.Edges.size());
+    for (LTSN *Child : llvm::children<NodeT>(Node))
+      Result.Edges.push_back(Index.at(Child));
+  }
+  Result.EdgeBegin.push_back(Result.Edges.size());
+
+  return Result;
+}
+
+using scc_t = std::vector<GraphNodeT>;
+
+/// Find the SCCs of \a G with more than one node, with an iterative version of
+/// Tarjan's algorithm.
+///
+/// The DFS starts from each node in order, since we cannot start just from the
+/// roots: we cannot exclude that there are loops without entries.
+/// The SCCs, and the nodes in each of them, are in the same order in which
+/// llvm::scc_iterator would emit them.
+static llvm::SmallVector<scc_t, 0> findNonTrivialSCCs(const CompactGraph &G) {
+  constexpr unsigned NotVisited = 0;
+  constexpr unsigned Completed = std::numeric_limits<unsigned>::max();
+
+  llvm::SmallVector<scc_t, 0> Result;
+
+  const size_t NumNodes = G.Nodes.size();
+  std::vector<unsigned> VisitNumber(NumNodes, NotVisited);
+  std::vector<unsigned> MinVisited(NumNodes, NotVisited);
+  std::vector<unsigned> SCCStack;
+  unsigned NextVisitNumber = NotVisited;
+
+  struct DFSFrame {
+    unsigned Node;
+    unsigned NextEdge;
+  };
+  std::vector<DFSFrame> DFSStack;
+
+  const auto Visit = [&](unsigned Node) {
+    ++NextVisitNumber;
+    VisitNumber[Node] = NextVisitNumber;
+    MinVisited[Node] = NextVisitNumber;
+    SCCStack.push_back(Node);
+    DFSStack.push_back({ Node, G.EdgeBegin[Node] });
+  };
+
+  for (unsigned Root = 0; Root < NumNodes; ++Root) {
+    if (VisitNumber[Root] != NotVisited)
       continue;
-    }
 
-    llvm::scc_iterator<NodeT> I = llvm::scc_begin(NodeT(Node));
-    llvm::scc_iterator<NodeT> E = llvm::scc_end(NodeT(Node));
-    for (const auto &SCC : llvm::make_range(I, E)) {
-      revng_assert(not SCC.empty());
-      if (VisitedNodes.contains(SCC[0]))
+    Visit(Root);
+    while (not DFSStack.empty()) {
+      auto &[Node, NextEdge] = DFSStack.back();
+
+      // Visit the next child, if any
+      if (NextEdge != G.EdgeBegin[Node + 1]) {
+        unsigned Child = G.Edges[NextEdge];
+        ++NextEdge;
+        if (VisitNumber[Child] == NotVisited)
+          Visit(Child);
+        else
+          MinVisited[Node] = std::min(MinVisited[Node], VisitNumber[Child]);
         continue;
-      VisitedNodes.insert(SCC.begin(), SCC.end());
+      }
+
+      // All the children have been visited
+      unsigned Done = Node;
+      DFSStack.pop_back();
+      if (not DFSStack.empty()) {
+        unsigned Parent = DFSStack.back().Node;
+        MinVisited[Parent] = std::min(MinVisited[Parent], MinVisited[Done]);
+      }
+
+      if (MinVisited[Done] != VisitNumber[Done])
+        continue;
+
+      // Done is the root of an SCC, pop it from the stack
+      scc_t SCC;
+      unsigned Member = 0;
+      do {
+        Member = SCCStack.back();
+        SCCStack.pop_back();
+        VisitNumber[Member] = Completed;
+        SCC.push_back(G.Nodes[Member]);
+      } while (Member != Done);
 
       if (LogVerbose.isEnabled()) {
         revng_log(LogVerbose, "# SCC has " << SCC.size() << " elements:");
@@ -71,13 +160,20 @@ static bool collapseSCCs(LayoutTypeSystem &TS) {
         revng_log(LogVerbose, "# SCC End");
       }
 
-      // If the SCC is larger than just a single point we track all the nodes
-      // that compose it as EqualityVisitedNodes, and we then add the SCC to the
-      // set of SCC ToCollapse.
       if (SCC.size() > 1)
-        ToCollapse.push_back(SCC);
+        Result.push_back(std::move(SCC));
     }
   }
+
+  return Result;
+}
+
+template<typename NodeT>
+static bool collapseSCCs(LayoutTypeSystem &TS) {
+
+  // If the SCC is larger than just a single point we add it to the set of SCC
+  // ToCollapse.
+  auto ToCollapse = findNonTrivialSCCs(makeCompactGraph<NodeT>(TS));
   revng_log(LogVerbose, "## Collapsing " << ToCollapse.size() << " SCCs");
 
   for (scc_t &SCC : ToCollapse) {
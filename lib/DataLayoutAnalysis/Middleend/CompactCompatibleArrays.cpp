@@ -304,12 +304,21 @@ getEdgeToCompactWithCurrent(LayoutTypeSystemNode *Parent,
                                                           isNonStridedInstance;
   const uint64_t OuterStride = StridedEdges ? 0ULL : Current.Stride;
 
-  auto SiblingEdgeIt = GT::child_edge_begin(Parent);
-  auto SiblingEdgeNext = SiblingEdgeIt;
-  auto SiblingEdgeEnd = GT::child_edge_end(Parent);
-  for (; SiblingEdgeIt != SiblingEdgeEnd; SiblingEdgeIt = SiblingEdgeNext) {
+  // The scan below restarts from the first sibling every time Current grows.
+  // Collect upfront, in order, the siblings that are worth looking at, so that
+  // each restart does not have to go through all the children of Parent, nor
+  // to compute again their CompactedArrayInfo.
+  struct Candidate {
+    NeighborIterator EdgeIt;
+    CompactedArrayInfo Info;
+    bool Compacted = false;
+  };
+  SmallVector<Candidate, 8> Siblings;
 
-    SiblingEdgeNext = std::next(SiblingEdgeIt);
+  auto SiblingEdgeEnd = GT::child_edge_end(Parent);
+  for (auto SiblingEdgeIt = GT::child_edge_begin(Parent);
+       SiblingEdgeIt != SiblingEdgeEnd;
+       ++SiblingEdgeIt) {
 
     // If we have already compacted that, skip it.
     if (CompactedWithCurrent.count(SiblingEdgeIt) > 0)
@@ -327,6 +336,19 @@ getEdgeToCompactWithCurrent(LayoutTypeSystemNode *Parent,
     if (Sibling.Stride != Current.Stride)
       continue;
 
+    Siblings.push_back({ SiblingEdgeIt, Sibling });
+  }
+
+  size_t Next = 0;
+  for (size_t I = 0; I < Siblings.size(); I = Next) {
+
+    Next = I + 1;
+
+    if (Siblings[I].Compacted)
+      continue;
+
+    const CompactedArrayInfo &Sibling = Siblings[I].Info;
+
     // If the Sibling starts after the Current ends, they don't overlap
     // and we don't compact them.
     if (Sibling.StartOffset >= Current.EndOffset)
@@ -374,13 +396,14 @@ getEdgeToCompactWithCurrent(LayoutTypeSystemNode *Parent,
     // overlapping bytes, and we have to take them into consideration too.
     if (Best.StartOffset < Current.StartOffset
         or Best.EndOffset > Current.EndOffset)
-      SiblingEdgeNext = GT::child_edge_begin(Parent);
+      Next = 0;
 
     Current = Best;
 
     // Here we know that ArraySibling can be compacted with the current
     // array we're tracking.
-    CompactedWithCurrent.insert(SiblingEdgeIt);
+    Siblings[I].Compacted = true;
+    CompactedWithCurrent.insert(Siblings[I].EdgeIt);
   }
   return Current;
 }
@@ -391,7 +414,7 @@ bool CompactCompatibleArrays::runOnTypeSystem(LayoutTypeSystem &TS) {
   if (VerifyLog.isEnabled())
     revng_assert(TS.verifyDAG());
 
-  std::set<LayoutTypeSystemNode *> Visited;
+  LayoutTypeSystem::VisitEpoch Visited = TS.startVisit();
   for (LayoutTypeSystemNode *Root : llvm::nodes(&TS)) {
     if (not isRoot(Root))
       continue;
@@ -32,7 +32,7 @@ bool ComputeNonInterferingComponents::runOnTypeSystem(LayoutTypeSystem &TS) {
   bool Changed = false;
 
   // Helper set, to prevent visiting a node from multiple entry points.
-  std::set<const LTSN *> Visited;
+  LayoutTypeSystem::VisitEpoch Visited = TS.startVisit();
 
   for (LTSN *Root : llvm::nodes(&TS)) {
     revng_assert(Root != nullptr);
@@ -37,7 +37,7 @@ bool ComputeUpperMemberAccesses::runOnTypeSystem(LayoutTypeSystem &TS) {
   bool Changed = false;
 
   using LTSN = LayoutTypeSystemNode;
-  std::set<const LTSN *> Visited;
+  LayoutTypeSystem::VisitEpoch Visited = TS.startVisit();
   for (LTSN *Root : llvm::nodes(&TS)) {
     revng_log(Log, "Root ID: " << Root->ID);
     revng_assert(Root != nullptr);
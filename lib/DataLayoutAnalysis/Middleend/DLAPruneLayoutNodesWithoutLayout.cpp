@@ -30,7 +30,7 @@ bool PruneLayoutNodesWithoutLayout::runOnTypeSystem(LayoutTypeSystem &TS) {
   if (VerifyLog.isEnabled())
     revng_assert(TS.verifyDAG());
 
-  std::set<const LTSN *> Visited;
+  LayoutTypeSystem::VisitEpoch Visited = TS.startVisit();
   std::set<LTSN *> ToRemove;
 
   for (LTSN *Root : llvm::nodes(&TS)) {
@@ -2,11 +2,20 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <chrono>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/IntEqClasses.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Progress.h"
+#include "llvm/Support/WithColor.h"
 
 #include "revng/Support/Assert.h"
 #include "revng/Support/Debug.h"
 
+#include "revng-c/Support/Trace.h"
+
 #include "DLAStep.h"
 
 namespace dla {
@@ -70,6 +79,133 @@ static std::string getStepNameFromID(const void *ID) {
 
 static Logger<> DLAStepManagerLog("dla-step-manager");
 static Logger<> DLADumpDot("dla-step-dump-dot");
+static Logger<> DLAStepProfile("dla-step-profile");
+static Logger<> DLAMemoryLog("dla-memory");
+
+static llvm::cl::opt<unsigned>
+  MemoryLimitMiB("dla-memory-limit",
+                 llvm::cl::desc("memory, in MiB, that the DLA type system can "
+                                "take before the middle-end steps start "
+                                "trading precision for memory (0 means no "
+                                "limit)"),
+                 llvm::cl::init(0));
+
+/// Log the memory taken by \a TS and, if it's over the limit, mark it as
+/// memory constrained
+static void checkMemoryUsage(LayoutTypeSystem &TS, llvm::StringRef When) {
+  if (not DLAMemoryLog.isEnabled() and MemoryLimitMiB == 0)
+    return;
+
+  LayoutTypeSystem::MemoryUsage Usage = TS.computeMemoryUsage();
+  revng_log(DLAMemoryLog,
+            When << ": " << Usage.total() << " bytes (nodes: " << Usage.Nodes
+                 << ", edges: " << Usage.Edges << ", tags: " << Usage.Tags
+                 << ")");
+
+  const size_t Limit = static_cast<size_t>(MemoryLimitMiB) << 20;
+  if (Limit != 0 and Usage.total() > Limit and not TS.isMemoryConstrained()) {
+    llvm::WithColor::warning()
+      << "the DLA type system takes more than " << MemoryLimitMiB
+      << " MiB, the following steps will be less precise\n";
+    TS.setMemoryConstrained();
+  }
+}
+
+static size_t countEdges(const LayoutTypeSystem &TS) {
+  size_t Result = 0;
+  for (const LayoutTypeSystemNode *N : TS.getLayoutsRange())
+    Result += N->Successors.size();
+  return Result;
+}
+
+namespace {
+
+/// Measures a single execution of a Step, for the dla-step-profile report and
+/// the StepStatistics requested to StepManager::run
+class StepProfile {
+private:
+  using Clock = std::chrono::steady_clock;
+
+  const LayoutTypeSystem &TS;
+  std::vector<StepStatistics> *Statistics = nullptr;
+  size_t NodesBefore = 0;
+  size_t EdgesBefore = 0;
+  Clock::time_point Start;
+
+public:
+  StepProfile(const LayoutTypeSystem &TS,
+              std::vector<StepStatistics> *Statistics) :
+    TS(TS), Statistics(Statistics) {
+    if (isEnabled()) {
+      NodesBefore = TS.getNumLayouts();
+      EdgesBefore = countEdges(TS);
+    }
+    Start = Clock::now();
+  }
+
+  static void printHeader() {
+    revng_log(DLAStepProfile,
+              "index,step,skipped,changed,time_us,nodes_before,nodes_after,"
+              "edges_before,edges_after");
+  }
+
+  void print(unsigned Index,
+             const void *StepID,
+             bool Skipped,
+             bool Changed) const {
+    if (not isEnabled())
+      return;
+
+    using namespace std::chrono;
+    StepStatistics Result{
+      .Name = getStepNameFromID(StepID),
+      .Skipped = Skipped,
+      .Changed = Changed,
+      .Time = duration_cast<microseconds>(Clock::now() - Start),
+      .NodesBefore = NodesBefore,
+      .NodesAfter = TS.getNumLayouts(),
+      .EdgesBefore = EdgesBefore,
+      .EdgesAfter = countEdges(TS),
+    };
+
+    if (DLAStepProfile.isEnabled()) {
+      DLAStepProfile << Index << "," << Result.Name << "," << Skipped << ","
+                     << Changed << "," << Result.Time.count() << ","
+                     << NodesBefore << "," << Result.NodesAfter << ","
+                     << EdgesBefore << "," << Result.EdgesAfter << DoLog;
+    }
+
+    if (Statistics != nullptr)
+      Statistics->push_back(std::move(Result));
+  }
+
+private:
+  bool isEnabled() const {
+    return DLAStepProfile.isEnabled() or Statistics != nullptr;
+  }
+};
+
+} // end anonymous namespace
+
+/// Count the weakly connected components of \a TS
+///
+/// Steps can't run concurrently on different components: they all create
+/// nodes, merge nodes, and intern tags in the same LayoutTypeSystem, and the
+/// IDs of the new nodes determine the order of the neighbors, hence the results
+/// of the following steps. This is only used to log how much the graph is
+/// fragmented.
+static unsigned countComponents(const LayoutTypeSystem &TS) {
+  llvm::IntEqClasses Components(TS.getNID());
+  for (const LayoutTypeSystemNode *N : TS.getLayoutsRange())
+    for (const LayoutTypeSystemNode::Link &L : N->Successors)
+      Components.join(N->ID, L.first->ID);
+  Components.compress();
+
+  llvm::DenseSet<unsigned> Leaders;
+  for (const LayoutTypeSystemNode *N : TS.getLayoutsRange())
+    Leaders.insert(Components[N->ID]);
+  return Leaders.size();
+}
 
 [[nodiscard]] bool StepManager::addStep(std::unique_ptr<Step> S) {
   const void *StepID = S->getStepID();
@@ -117,18 +253,64 @@ static Logger<> DLADumpDot("dla-step-dump-dot");
   return true;
 }
 
-void StepManager::run(LayoutTypeSystem &TS) {
+void StepManager::run(LayoutTypeSystem &TS,
+                      std::vector<StepStatistics> *Statistics,
+                      unsigned FirstStep) {
   if (not hasValidSchedule())
     revng_abort("Cannot run a on LayoutTypeSystem: invalid schedule");
-  int x = 0;
+  revng_assert(FirstStep <= Schedule.size());
+  int x = FirstStep;
   if (DLADumpDot.isEnabled())
     TS.dumpDotOnFile("type-system-0.dot", true);
 
-  llvm::Task T{ Schedule.size(), "StepManager::run" };
-  for (auto &S : Schedule) {
-    T.advance(getStepNameFromID(S->getStepID()));
-    S->runOnTypeSystem(TS);
+  // Generation is bumped every time a Step might have changed TS. For each
+  // Step that is exact about its changes, UnchangedAt records the Generation in
+  // which it last ran without changing anything: running it again in the same
+  // Generation would be a no-op.
+  unsigned Generation = 0;
+  llvm::DenseMap<const void *, unsigned> UnchangedAt;
+
+  const auto MaybeCheckpoint = [&]() {
+    if (Checkpoint and static_cast<unsigned>(x) == CheckpointIndex)
+      Checkpoint(TS, x);
+  };
+
+  StepProfile::printHeader();
+  checkMemoryUsage(TS, "Before the DLA middle-end");
+
+  llvm::Task T{ Schedule.size() - FirstStep, "StepManager::run" };
+  for (auto &S : llvm::drop_begin(Schedule, FirstStep)) {
+    std::string StepName = getStepNameFromID(S->getStepID());
+    T.advance(StepName);
+    trace::Scope StepTrace("dla", "DLA step", StepName);
     ++x;
+
+    StepProfile Profile(TS, Statistics);
+    const void *StepID = S->getStepID();
+    bool IsExact = S->isExactAboutChanges();
+    if (IsExact) {
+      auto It = UnchangedAt.find(StepID);
+      if (It != UnchangedAt.end() and It->second == Generation) {
+        revng_log(DLAStepManagerLog,
+                  "Skipping " << getStepNameFromID(StepID)
+                              << ": nothing changed since its last run");
+        Profile.print(x, StepID, /* Skipped */ true, /* Changed */ false);
+        MaybeCheckpoint();
+        continue;
+      }
+    }
+
+    bool Changed = S->runOnTypeSystem(TS);
+    Profile.print(x, StepID, /* Skipped */ false, Changed);
+    if (Changed or not IsExact)
+      ++Generation;
+    else
+      UnchangedAt[StepID] = Generation;
+    revng_log(DLAStepManagerLog,
+              "After " << getStepNameFromID(S->getStepID()) << ": "
+                       << TS.getNumLayouts() << " nodes in "
+                       << countComponents(TS) << " components");
+    checkMemoryUsage(TS, "After " + getStepNameFromID(StepID));
     if (DLADumpDot.isEnabled()) {
       revng_log(DLADumpDot,
                 "Step " << getStepNameFromID(S->getStepID())
@@ -136,7 +318,59 @@ void StepManager::run(LayoutTypeSystem &TS) {
       std::string DotName = "type-system-" + std::to_string(x) + ".dot";
       TS.dumpDotOnFile(DotName.c_str(), true);
     }
+    MaybeCheckpoint();
   }
 }
 
+void addDefaultSteps(StepManager &SM, size_t PtrSize) {
+  //
+  // Graph normalization phase
+  //
+  revng_check(SM.addStep<RemoveInvalidPointers>(PtrSize));
+  revng_check(SM.addStep<CollapseEqualitySCC>());
+  revng_check(SM.addStep<CollapseInstanceAtOffset0SCC>());
+  revng_check(SM.addStep<SimplifyInstanceAtOffset0>());
+  revng_check(SM.addStep<PruneLayoutNodesWithoutLayout>());
+  revng_check(SM.addStep<ComputeUpperMemberAccesses>());
+  revng_check(SM.addStep<RemoveInvalidStrideEdges>());
+  revng_check(SM.addStep<PruneLayoutNodesWithoutLayout>());
+  revng_check(SM.addStep<ComputeUpperMemberAccesses>());
+  revng_check(SM.addStep<DecomposeStridedEdges>());
+
+  //
+  // Graph optimization phase
+  //
+  revng_check(SM.addStep<CollapseSingleChild>());
+  revng_check(SM.addStep<DeduplicateFields>());
+  revng_check(SM.addStep<MergePointeesOfPointerUnion>(PtrSize));
+  revng_check(SM.addStep<MergePointerNodes>());
+  revng_check(SM.addStep<CollapseInstanceAtOffset0SCC>());
+  revng_check(SM.addStep<SimplifyInstanceAtOffset0>());
+  revng_check(SM.addStep<PruneLayoutNodesWithoutLayout>());
+  revng_check(SM.addStep<ComputeUpperMemberAccesses>());
+  revng_check(SM.addStep<RemoveInvalidStrideEdges>());
+  revng_check(SM.addStep<PruneLayoutNodesWithoutLayout>());
+  revng_check(SM.addStep<ComputeUpperMemberAccesses>());
+
+  revng_check(SM.addStep<MergePointerNodes>());
+  // CollapseSingleChild and DeduplicateFields run before
+  // CompactCompatibleArrays and ArrangeAccessesHierarchically, to allow them to
+  // produce better results
+  revng_check(SM.addStep<CollapseSingleChild>());
+  revng_check(SM.addStep<DeduplicateFields>());
+  revng_check(SM.addStep<ArrangeAccessesHierarchically>());
+  revng_check(SM.addStep<CompactCompatibleArrays>());
+  revng_check(SM.addStep<PushDownPointers>());
+  // ArrangeAccessesHierarchically can move pointer edges around in some cases,
+  // so we want to run MergePointerNodes again afterwards.
+  revng_check(SM.addStep<MergePointerNodes>());
+  // CollapseSingleChild and DeduplicateFields run again after
+  // CompactCompatibleArrays and ArrangeAccessesHierarchically, to allow them to
+  // improve the results even further.
+  revng_check(SM.addStep<ResolveLeafUnions>());
+  revng_check(SM.addStep<CollapseSingleChild>());
+  revng_check(SM.addStep<DeduplicateFields>());
+  revng_check(SM.addStep<ComputeNonInterferingComponents>());
+}
+
 } // end namespace dla
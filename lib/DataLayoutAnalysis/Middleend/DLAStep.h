@@ -5,8 +5,13 @@
 //
 
 #include <algorithm>
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <string>
 #include <type_traits>
+#include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallPtrSet.h"
@@ -50,6 +55,13 @@ public:
   /// Runs the Step on TS, returns true if it has applied changes to TS.
   virtual bool runOnTypeSystem(LayoutTypeSystem &TS) = 0;
 
+  /// Returns true if runOnTypeSystem leaves TS untouched whenever it returns
+  /// false, without even creating temporary nodes.
+  ///
+  /// The StepManager uses this to skip Steps that would run again on a graph
+  /// that hasn't changed since the last time they left it untouched.
+  virtual bool isExactAboutChanges() const { return false; }
+
   IDSetConstRef getDependencies() const { return Dependencies; }
   IDSetConstRef getInvalidated() const { return Invalidated; }
 
@@ -124,6 +136,8 @@ public:
   virtual ~PruneLayoutNodesWithoutLayout() override = default;
 
   virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+
+  virtual bool isExactAboutChanges() const override { return true; }
 };
 
 /// dla::Step that merge pointer nodes pointing to the same layout
@@ -138,6 +152,8 @@ public:
   virtual ~MergePointerNodes() override = default;
 
   virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+
+  virtual bool isExactAboutChanges() const override { return true; }
 };
 
 /// dla::Step that takes all strided edges and decompose in edges with only one
@@ -153,6 +169,16 @@ public:
   virtual ~DecomposeStridedEdges() override = default;
 
   virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+
+  virtual bool isExactAboutChanges() const override { return true; }
+
+  /// Build a single-layered OffsetExpression covering all the elements of the
+  /// multi-layered \a OE, if all its strides are multiples of the innermost
+  /// one.
+  ///
+  /// If the levels aren't dense, e.g. strides 16 and 4 with 2 elements each,
+  /// the result also covers the gaps between them (here, offsets 8 and 12).
+  static std::optional<OffsetExpression> flatten(const OffsetExpression &OE);
 };
 
 /// dla::Step that computes and propagates information on accesses and type
@@ -178,6 +204,8 @@ public:
   virtual ~ComputeUpperMemberAccesses() override = default;
 
   virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+
+  virtual bool isExactAboutChanges() const override { return true; }
 };
 
 /// dla::Step that removes invalid stride edges
@@ -198,6 +226,8 @@ public:
   virtual ~RemoveInvalidStrideEdges() override = default;
 
   virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+
+  virtual bool isExactAboutChanges() const override { return true; }
 };
 
 /// dla::Step that merge pointee nodes of union of pointers
@@ -242,6 +272,8 @@ public:
   virtual ~CollapseSingleChild() override = default;
 
   virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+
+  virtual bool isExactAboutChanges() const override { return true; }
 };
 
 /// dla::Step that decompose the LayoutTypeSystem into components, each of which
@@ -278,6 +310,8 @@ public:
   virtual ~RemoveInvalidPointers() override = default;
 
   virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+
+  virtual bool isExactAboutChanges() const override { return true; }
 };
 
 /// dla::Step that tries to compact partly overlapping compatible arrays
@@ -334,6 +368,8 @@ public:
   virtual ~PushDownPointers() override = default;
 
   virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+
+  virtual bool isExactAboutChanges() const override { return true; }
 };
 
 /// dla::Step that resolves unions of primitive and pointer types
@@ -363,6 +399,8 @@ public:
   virtual ~DeduplicateFields() override = default;
 
   virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+
+  virtual bool isExactAboutChanges() const override { return true; }
 };
 
 inline DecomposeStridedEdges::DecomposeStridedEdges() :
@@ -391,6 +429,18 @@ bool intersect(const RangeT &R1, const RangeT &R2) {
   return intersect(R1.begin(), R1.end(), R2.begin(), R2.end());
 }
 
+/// What happened during a single execution of a Step by the StepManager
+struct StepStatistics {
+  std::string Name;
+  bool Skipped = false;
+  bool Changed = false;
+  std::chrono::microseconds Time{ 0 };
+  size_t NodesBefore = 0;
+  size_t NodesAfter = 0;
+  size_t EdgesBefore = 0;
+  size_t EdgesAfter = 0;
+};
+
 class StepManager {
 
 public:
@@ -408,6 +458,14 @@ public:
   using sched_const_iterator = decltype(Schedule)::const_iterator;
   using sched_const_range = llvm::iterator_range<sched_const_iterator>;
 
+  /// Called with the number of steps that have run so far
+  using CheckpointCallback = std::function<void(const LayoutTypeSystem &,
+                                                unsigned)>;
+
+private:
+  unsigned CheckpointIndex = 0;
+  CheckpointCallback Checkpoint;
+
 public:
   StepManager() : Schedule(), InsertedSteps(), InvalidatedSteps() {}
 
@@ -419,8 +477,22 @@ public:
     return addStep(std::make_unique<StepT>(std::forward<ArgsT &&>(Args)...));
   }
 
-  /// Runs the added steps
-  void run(LayoutTypeSystem &TS);
+  /// Runs the added steps, starting from the one at position \a FirstStep
+  ///
+  /// If \a Statistics is not null, one entry for each scheduled Step is
+  /// appended to it.
+  void run(LayoutTypeSystem &TS,
+           std::vector<StepStatistics> *Statistics = nullptr,
+           unsigned FirstStep = 0);
+
+  /// Call \a Callback on the LayoutTypeSystem right after the step at
+  /// position \a Index - 1 in the schedule has run, e.g. to save it and
+  /// resume from there later, passing \a Index as FirstStep to run.
+  void setCheckpoint(unsigned Index, CheckpointCallback Callback) {
+    revng_assert(Index > 0 and Index <= Schedule.size());
+    CheckpointIndex = Index;
+    Checkpoint = std::move(Callback);
+  }
 
   /// Drops all the scheduled steps
   void reset() {
@@ -444,4 +516,7 @@ public:
   }
 };
 
+/// Adds to \a SM the Steps that DLAPass runs, in the same order
+void addDefaultSteps(StepManager &SM, size_t PtrSize);
+
 } // end namespace dla
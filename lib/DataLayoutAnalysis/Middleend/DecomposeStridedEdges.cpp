@@ -2,11 +2,42 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <optional>
+
+#include "llvm/ADT/STLExtras.h"
+
 #include "DLAStep.h"
 #include "FieldSizeComputation.h"
 
 namespace dla {
 
+std::optional<OffsetExpression>
+DecomposeStridedEdges::flatten(const OffsetExpression &OE) {
+  uint64_t InnerStride = OE.Strides.back();
+  if (InnerStride == 0)
+    return std::nullopt;
+
+  bool KnownTripCount = true;
+  uint64_t LastElement = 0;
+  for (const auto &[Stride, TripCount] : llvm::zip(OE.Strides, OE.TripCounts)) {
+    if (Stride % InnerStride != 0)
+      return std::nullopt;
+
+    if (TripCount.has_value() and TripCount.value() > 0)
+      LastElement += (TripCount.value() - 1) * (Stride / InnerStride);
+    else
+      KnownTripCount = false;
+  }
+
+  OffsetExpression Result(OE.Offset);
+  Result.Strides.push_back(InnerStride);
+  if (KnownTripCount)
+    Result.TripCounts.push_back(LastElement + 1);
+  else
+    Result.TripCounts.push_back(std::nullopt);
+  return Result;
+}
+
 bool DecomposeStridedEdges::runOnTypeSystem(LayoutTypeSystem &TS) {
   if (VerifyLog.isEnabled())
     revng_assert(TS.verifyDAG());
@@ -35,6 +66,17 @@ bool DecomposeStridedEdges::runOnTypeSystem(LayoutTypeSystem &TS) {
 
       Changed = true;
 
+      // Creating a new node for each level of array can take lots of memory
+      // on big type systems. If memory is tight, turn the edge into a single
+      // flat array instead, when its levels allow it.
+      if (TS.isMemoryConstrained()) {
+        if (auto Flat = flatten(OffsetExpr)) {
+          TS.addInstanceLink(Parent, Child, std::move(*Flat));
+          TS.eraseEdge(Parent, EdgeIt);
+          continue;
+        }
+      }
+
       // Setup the chain of nodes across which we will build the new chain of
       // single-layered strided edges.
       llvm::SmallVector<LayoutTypeSystemNode *> NodeChain;
@@ -7,7 +7,9 @@
 #include <cstdint>
 #include <iterator>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/GraphTraits.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SetOperations.h"
@@ -79,8 +81,8 @@ static order cmpEdgeTags(const Tag *A, const Tag *B) {
   if (KindA == TypeLinkTag::LK_Pointer or KindB == TypeLinkTag::LK_Pointer)
     return KindA <=> KindB;
 
-  OffsetExpression OffA = A->getOffsetExpr();
-  OffsetExpression OffB = B->getOffsetExpr();
+  const OffsetExpression &OffA = A->getOffsetExpr();
+  const OffsetExpression &OffB = B->getOffsetExpr();
 
   const auto KindCmp = KindA <=> KindB;
   if (KindCmp != order::equal)
@@ -232,6 +234,35 @@ exploreAndCompare(const Link &Child1, const Link &Child2) {
   return { order::equal, VisitStack1, VisitStack2 };
 }
 
+/// Hash of what exploreAndCompare always compares when it starts from \p L:
+/// the tag of \p L, the size and the number of successors of its target, and
+/// the same two properties for each of the successors of the target.
+///
+/// Links that exploreAndCompare considers equal have the same hash, so links
+/// with different hashes don't need to be explored. This doesn't go deeper
+/// than the successors of the target, since exploreAndCompare stops when it
+/// reaches the same node from both sides, whatever the tags leading to it.
+static size_t hashShallowLink(const Link &L) {
+  const auto &[Node, Tag] = L;
+
+  llvm::hash_code TagHash = isPointerEdge(L) ?
+                              llvm::hash_value(Tag->getKind()) :
+                              TypeLinkTag::Hash{}(*Tag);
+
+  llvm::SmallVector<size_t, 8> SuccessorHashes;
+  for (const Link &Successor : Node->Successors)
+    SuccessorHashes.push_back(llvm::hash_combine(Successor.first->Size,
+                                                 Successor.first->Successors
+                                                   .size()));
+  llvm::sort(SuccessorHashes);
+
+  return llvm::hash_combine(TagHash,
+                            Node->Size,
+                            Node->Successors.size(),
+                            llvm::hash_combine_range(SuccessorHashes.begin(),
+                                                     SuccessorHashes.end()));
+}
+
 /// Check if two subtrees are equivalent, saving the visited nodes in the
 /// order in which they were compared.
 static std::tuple<bool, EdgeList, EdgeList>
@@ -390,6 +421,17 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
         OriginalFields.insert(L.first);
       }
 
+      // The hash of a link only depends on its target and on the successors
+      // of the target, which can only change when something gets merged.
+      // Compute it once per link until then.
+      llvm::DenseMap<Link, size_t> LinkHashes;
+      auto GetLinkHash = [&LinkHashes](const Link &L) {
+        auto [It, Inserted] = LinkHashes.try_emplace(L, 0);
+        if (Inserted)
+          It->second = hashShallowLink(L);
+        return It->second;
+      };
+
       bool NodeWithFieldsChanged = false;
       while (FieldsToCompare.size() > 0) {
         LTSN *CurChild = FieldsToCompare.pop_back_val();
@@ -417,6 +459,8 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
             continue;
           }
 
+          const size_t CurLinkHash = GetLinkHash(CurLink);
+
           // We want to compare CurChild with all the other nodes that we have
           // looked at in previous iterations, and try to merge it with one of
           // them.
@@ -445,6 +489,12 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
                 revng_log(Log, "skip pointer edge");
               }
 
+              // Only explore the subtrees that have a chance to be equivalent
+              if (GetLinkHash(NotMergedLink) != CurLinkHash) {
+                revng_log(Log, "Different hash!");
+                continue;
+              }
+
               auto [IsMerged,
                     Preserved,
                     Erased] = mergeIfTopologicallyEq(TS,
@@ -455,6 +505,7 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
                 continue;
               }
               revng_log(Log, "Edge merged!");
+              LinkHashes.clear();
 
               // If we merged something, there should be at least one preserved
               // node and one erased node
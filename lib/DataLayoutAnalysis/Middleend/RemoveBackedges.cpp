@@ -3,9 +3,11 @@
 //
 
 #include <compare>
+#include <iterator>
 #include <limits>
 #include <vector>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/ADT/EquivalenceClasses.h"
 #include "llvm/ADT/PostOrderIterator.h"
@@ -61,6 +63,43 @@ static bool hasNoSCCEdge(const LTSN *Node) {
   return isSCCRoot<SCC>(Node) and isSCCLeaf<SCC>(Node);
 };
 
+/// Mark in \a Result the nodes of \a TS that can't reach any loop made of
+/// mixed edges.
+///
+/// These are the nodes that are left once the sinks of the mixed graph are
+/// repeatedly removed, so they never close a loop in the visits looking for
+/// the backedges to remove, and those visits can skip them.
+template<SCCWithBackedgeHelper SCC>
+static void markNodesNotReachingMixedLoops(const LayoutTypeSystem &TS,
+                                           LayoutTypeSystem::VisitEpoch
+                                             &Result) {
+  using ConstMixedNodeT = EdgeFilteredGraph<const LTSN *, isMixedEdge<SCC>>;
+
+  llvm::DenseMap<const LTSN *, unsigned> PendingSuccessors;
+  llvm::SmallVector<const LTSN *, 16> Sinks;
+  for (const LTSN *N : llvm::nodes(&TS)) {
+    auto Children = llvm::children<ConstMixedNodeT>(N);
+    unsigned NumChildren = std::distance(Children.begin(), Children.end());
+    if (NumChildren == 0)
+      Sinks.push_back(N);
+    else
+      PendingSuccessors[N] = NumChildren;
+  }
+
+  while (not Sinks.empty()) {
+    const LTSN *Sink = Sinks.pop_back_val();
+    Result.insert(Sink);
+
+    using InverseMixed = llvm::Inverse<ConstMixedNodeT>;
+    for (const LTSN *Pred : llvm::children<InverseMixed>(Sink)) {
+      unsigned &Pending = PendingSuccessors[Pred];
+      revng_assert(Pending > 0);
+      if (--Pending == 0)
+        Sinks.push_back(Pred);
+    }
+  }
+}
+
 template<SCCWithBackedgeHelper SCC>
 static bool removeBackedgesFromSCC(LayoutTypeSystem &TS) {
   bool Changed = false;
@@ -68,7 +107,7 @@ static bool removeBackedgesFromSCC(LayoutTypeSystem &TS) {
     revng_assert(TS.verifyConsistency());
 
     // Verify that the graph is a DAG looking only at SCCNodeView
-    std::set<const LTSN *> Visited;
+    LayoutTypeSystem::VisitEpoch Visited = TS.startVisit();
     for (const auto &Node : llvm::nodes(&TS)) {
       revng_assert(Node != nullptr);
       if (Visited.contains(Node))
@@ -86,7 +125,7 @@ static bool removeBackedgesFromSCC(LayoutTypeSystem &TS) {
 
   revng_log(Log, "Removing Backedges From Loops");
 
-  llvm::Task T(2, "removeBackedgesFromSCC");
+  llvm::Task T(3, "removeBackedgesFromSCC");
   T.advance("Detect SCC Node View Components");
   // Assign each node to a Component, except for those that have no incoming nor
   // outgoing SCCNodeView edges. The goal is to identify the subsets of nodes
@@ -140,6 +179,14 @@ static bool removeBackedgesFromSCC(LayoutTypeSystem &TS) {
 
   using MixedNodeT = EdgeFilteredGraph<LTSN *, isMixedEdge<SCC>>;
 
+  // Removing edges can only make more nodes unable to reach mixed loops, so
+  // it's safe to compute this once, before removing anything. Without this,
+  // each visit from a root would walk again all the acyclic parts of the graph
+  // that the visits from the previous roots have already walked.
+  T.advance("Detect Nodes Not Reaching Mixed Loops");
+  LayoutTypeSystem::VisitEpoch NoMixedLoop = TS.startVisit();
+  markNodesNotReachingMixedLoops<SCC>(TS, NoMixedLoop);
+
   T.advance("Remove Backedges");
   for (const auto &Root : llvm::nodes(&TS)) {
     revng_assert(Root != nullptr);
@@ -151,6 +198,9 @@ static bool removeBackedgesFromSCC(LayoutTypeSystem &TS) {
     if (not isSCCRoot<SCC>(Root))
       continue;
 
+    if (NoMixedLoop.contains(Root))
+      continue;
+
     revng_log(Log, "# Looking for mixed loops from: " << Root->ID);
 
     struct EdgeInfo {
@@ -225,6 +275,14 @@ static bool removeBackedgesFromSCC(LayoutTypeSystem &TS) {
 
         revng_log(Log, "### Next child ID: " << NextChild->ID);
 
+        // No loop can be closed below NextChild. Visiting it would push and
+        // pop the same cross-component edges, leaving ToRemove untouched.
+        if (NoMixedLoop.contains(NextChild)) {
+          revng_log(Log, "Cannot reach mixed loops");
+          ++NextEdgeToVisit;
+          continue;
+        }
+
         // Check if the next children is in a component.
         // If it's not, leave the same component of the top of the stack, so
         // that we can identify the first edge that closes the crossing from one
@@ -330,7 +388,7 @@ static bool removeBackedgesFromSCC(LayoutTypeSystem &TS) {
 
     // Verify that the graph is a DAG looking both at SCCNodeView and
     // BackedgeNodeView
-    std::set<const LTSN *> Visited;
+    LayoutTypeSystem::VisitEpoch Visited = TS.startVisit();
     for (const auto &Node : llvm::nodes(&TS)) {
       revng_assert(Node != nullptr);
       if (Visited.contains(Node))
@@ -55,7 +55,7 @@ bool RemoveInvalidStrideEdges::runOnTypeSystem(LayoutTypeSystem &TS) {
   if (VerifyLog.isEnabled())
     revng_assert(TS.verifyDAG());
 
-  std::set<const LayoutTypeSystemNode *> Visited;
+  LayoutTypeSystem::VisitEpoch Visited = TS.startVisit();
   for (LayoutTypeSystemNode *Root : llvm::nodes(&TS)) {
 
     revng_log(Log, "Root ID: " << Root->ID);
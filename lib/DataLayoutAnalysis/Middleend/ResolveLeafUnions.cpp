@@ -233,9 +233,15 @@ bool ResolveLeafUnions::runOnTypeSystem(LayoutTypeSystem &TS) {
   bool Changed = false;
 
   for (LayoutTypeSystemNode *Node : llvm::nodes(&TS)) {
+    // Most nodes can't be unions of leaves at all, don't bother grouping their
+    // children
+    if (Node->Successors.size() < 2)
+      continue;
+
     auto LeafChildrenSets = getOverlappingLeafChildren(Node);
     for (auto &LeafChildrenSet : llvm::make_second_range(LeafChildrenSets))
-      Changed |= resolveUnion(TS, Node, LeafChildrenSet);
+      if (LeafChildrenSet.size() > 1)
+        Changed |= resolveUnion(TS, Node, LeafChildrenSet);
   }
 
   return Changed;
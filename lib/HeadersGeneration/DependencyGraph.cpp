@@ -37,13 +37,15 @@ static llvm::StringRef toString(TypeNode::Kind K) {
 
 void DependencyGraph::addNode(const model::Type *T) {
 
+  unsigned Index = TypeToNode.size();
+
   constexpr auto TypeName = TypeNode::Kind::TypeName;
-  auto *NameNode = GenericGraph::addNode(TypeNode{ T, TypeName });
-  TypeToNode[TypeKindPair{ T, TypeName }] = NameNode;
+  auto *NameNode = GenericGraph::addNode(TypeNode{ T, TypeName, Index });
 
   constexpr auto FullType = TypeNode::Kind::FullType;
-  auto *FullNode = GenericGraph::addNode(TypeNode{ T, FullType });
-  TypeToNode[TypeKindPair{ T, FullType }] = FullNode;
+  auto *FullNode = GenericGraph::addNode(TypeNode{ T, FullType, Index + 1 });
+
+  TypeToNode.insert(T, NameNode, FullNode);
 }
 
 std::string getNodeLabel(const TypeDependencyNode *N) {
@@ -4,11 +4,16 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <array>
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Support/DOTGraphTraits.h"
 #include "llvm/Support/GraphWriter.h"
 
 #include "revng/ADT/GenericGraph.h"
 #include "revng/Model/Type.h"
+#include "revng/Support/Assert.h"
 
 /// Represents a model::Type in the DependencyGraph
 struct TypeNode {
@@ -22,11 +27,44 @@ struct TypeNode {
     TypeName,
     FullType
   } K;
+
+  /// The position of the node in its DependencyGraph: the nodes of a graph
+  /// are numbered from 0, so that sets of them can be bit vectors
+  unsigned Index;
 };
 
 using TypeDependencyNode = BidirectionalNode<TypeNode>;
 using TypeKindPair = std::pair<const model::Type *, TypeNode::Kind>;
-using TypeToDependencyNodeMap = std::map<TypeKindPair, TypeDependencyNode *>;
+
+/// The two nodes of each model::Type, in a flat hash table keyed by the type
+/// alone, since the graph of a large model has millions of them
+class TypeToDependencyNodeMap {
+private:
+  using NodePair = std::array<TypeDependencyNode *, 2>;
+
+private:
+  llvm::DenseMap<const model::Type *, NodePair> Nodes;
+
+public:
+  void insert(const model::Type *T,
+              TypeDependencyNode *NameNode,
+              TypeDependencyNode *FullNode) {
+    static_assert(TypeNode::Kind::TypeName == 0);
+    static_assert(TypeNode::Kind::FullType == 1);
+    bool New = Nodes.try_emplace(T, NodePair{ NameNode, FullNode }).second;
+    revng_assert(New);
+  }
+
+  TypeDependencyNode *at(const TypeKindPair &Key) const {
+    auto It = Nodes.find(Key.first);
+    revng_assert(It != Nodes.end());
+    return It->second[Key.second];
+  }
+
+  /// The number of nodes, two for each type
+  size_t size() const { return 2 * Nodes.size(); }
+};
+
 using TypeVector = TrackingSortedVector<UpcastablePointer<model::Type>>;
 
 /// Represents the graph of dependencies among types
@@ -40,6 +78,28 @@ private:
   TypeToDependencyNodeMap TypeToNode;
 };
 
+/// A set of nodes of a DependencyGraph, with a bit for each of them. It can be
+/// used as the external storage of llvm::post_order_ext.
+class TypeDependencyNodeSet {
+private:
+  llvm::BitVector Bits;
+
+public:
+  explicit TypeDependencyNodeSet(const DependencyGraph &Graph) :
+    Bits(Graph.TypeNodes().size()) {}
+
+public:
+  std::pair<std::nullptr_t, bool> insert(const TypeDependencyNode *Node) {
+    bool New = not Bits.test(Node->Index);
+    Bits.set(Node->Index);
+    return { nullptr, New };
+  }
+
+  bool contains(const TypeDependencyNode *Node) const {
+    return Bits.test(Node->Index);
+  }
+};
+
 std::string getNodeLabel(const TypeDependencyNode *N);
 
 template<>
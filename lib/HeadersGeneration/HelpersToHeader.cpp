@@ -3,7 +3,10 @@
 //
 
 #include <functional>
+#include <string>
+#include <vector>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringRef.h"
@@ -35,11 +38,85 @@ using llvm::dyn_cast;
 
 static Logger<> Log{ "helpers-to-header" };
 
+namespace {
+
+/// Memoizes the parts of the header that only depend on LLVM types, which are
+/// shared by many helpers
+class HelperTypePrinter {
+private:
+  ptml::PTMLCBuilder &B;
+  llvm::DenseMap<const llvm::Type *, std::string> ScalarTypes;
+  llvm::DenseMap<const llvm::FunctionType *, bool> Printable;
+  llvm::DenseMap<const llvm::FunctionType *, std::string> Arguments;
+
+public:
+  HelperTypePrinter(ptml::PTMLCBuilder &B) : B(B) {}
+
+public:
+  const std::string &scalarType(const llvm::Type *T) {
+    auto [It, IsNew] = ScalarTypes.try_emplace(T);
+    if (IsNew)
+      It->second = getScalarCType(T, B);
+    return It->second;
+  }
+
+  /// Return false for helpers that have argument types or return types that
+  /// we don't know how to print (e.g. vector types, or struct types whose
+  /// fields are not only pointers or integers)
+  bool isPrintable(const llvm::FunctionType *FT) {
+    auto [It, IsNew] = Printable.try_emplace(FT);
+    if (IsNew)
+      It->second = not hasUnprintableArgsOrRetTypes(FT);
+    return It->second;
+  }
+
+  /// The parenthesized list of argument types of a prototype
+  const std::string &arguments(const llvm::FunctionType *FT) {
+    auto [It, IsNew] = Arguments.try_emplace(FT);
+    if (not IsNew)
+      return It->second;
+
+    std::string &Result = It->second;
+    if (FT->getNumParams() == 0) {
+      Result = "(" + B.tokenTag("void", ptml::c::tokens::Type) + ")";
+    } else {
+      const llvm::StringRef Open = "(";
+      const llvm::StringRef Comma = ", ";
+      llvm::StringRef Separator = Open;
+      for (llvm::Type *ArgType : FT->params()) {
+        Result += Separator;
+        Result += scalarType(ArgType);
+        Separator = Comma;
+      }
+      Result += ")";
+    }
+
+    return Result;
+  }
+
+private:
+  static bool hasUnprintableArgsOrRetTypes(const llvm::FunctionType *FT) {
+    const auto IsUnprintable = std::not_fn(isScalarCType);
+    auto *ReturnType = FT->getReturnType();
+    if (not isScalarCType(ReturnType)) {
+      if (auto *StructTy = dyn_cast<llvm::StructType>(ReturnType)) {
+        return llvm::any_of(StructTy->elements(), IsUnprintable);
+      }
+      return true;
+    }
+
+    return llvm::any_of(FT->params(), IsUnprintable);
+  }
+};
+
+} // namespace
+
 /// Print the declaration a C struct corresponding to an LLVM struct
 /// type.
 static void printDefinition(const llvm::StructType *S,
                             const llvm::Function &F,
                             ptml::PTMLIndentedOstream &Header,
+                            HelperTypePrinter &Types,
                             ptml::PTMLCBuilder &B) {
   Header << B.getKeyword(ptml::PTMLCBuilder::Keyword::Typedef) << " "
          << B.getKeyword(ptml::PTMLCBuilder::Keyword::Struct) << " "
@@ -49,7 +126,7 @@ static void printDefinition(const llvm::StructType *S,
     Scope Scope(Header, ptml::c::scopes::StructBody);
 
     for (const auto &Field : llvm::enumerate(S->elements())) {
-      Header << getReturnStructFieldType(&F, Field.index(), B) << " "
+      Header << Types.scalarType(Field.value()) << " "
              << getReturnStructFieldLocationDefinition(&F, Field.index(), B)
              << ";\n";
     }
@@ -61,101 +138,106 @@ static void printDefinition(const llvm::StructType *S,
 /// Print the prototype of a helper .
 static void printHelperPrototype(const llvm::Function *Func,
                                  ptml::PTMLIndentedOstream &Header,
+                                 HelperTypePrinter &Types,
                                  ptml::PTMLCBuilder &B) {
   Header << getReturnTypeLocationReference(Func, B) << " "
-         << getHelperFunctionLocationDefinition(Func, B);
-
-  if (Func->arg_empty()) {
-    Header << "(" + B.tokenTag("void", ptml::c::tokens::Type) + ");\n";
-  } else {
-    const llvm::StringRef Open = "(";
-    const llvm::StringRef Comma = ", ";
-    llvm::StringRef Separator = Open;
-    for (const auto &Arg : Func->args()) {
-      Header << Separator << getScalarCType(Arg.getType(), B);
-      Separator = Comma;
-    }
-    Header << ");\n";
-  }
+         << getHelperFunctionLocationDefinition(Func, B)
+         << Types.arguments(Func->getFunctionType()) << ";\n";
 }
 
-static bool hasUnprintableArgsOrRetTypes(const llvm::Function &F) {
-  const auto IsUnprintable = std::not_fn(isScalarCType);
-  auto *ReturnType = F.getReturnType();
-  if (not isScalarCType(ReturnType)) {
-    if (auto *StructTy = dyn_cast<llvm::StructType>(ReturnType)) {
-      return llvm::any_of(StructTy->elements(), IsUnprintable);
+static bool shouldBePrinted(const llvm::Function &F) {
+  // Skip non-helpers
+  bool IsHelper = FunctionTags::QEMU.isTagOf(&F)
+                  or FunctionTags::Helper.isTagOf(&F)
+                  or FunctionTags::OpaqueCSVValue.isTagOf(&F)
+                  or FunctionTags::Exceptional.isTagOf(&F) or F.isIntrinsic();
+  if (not IsHelper)
+    return false;
+
+  // Skip helpers that should never be printed:
+  // - because we expect them to never require emission and we wouldn't know
+  //   how to emit them (e.g. target-specific intrinsics)
+  // - because we want to actively avoid printing them even if they are
+  //   present, such as all LLVM's debug intrinsics
+  llvm::StringRef FName = F.getName();
+  return not F.isTargetIntrinsic() and not FName.startswith("llvm.dbg");
+}
+
+static void printHeader(llvm::ArrayRef<const llvm::Function *> Helpers,
+                        HelperTypePrinter &Types,
+                        ptml::PTMLCBuilder &B,
+                        llvm::raw_ostream &Out) {
+  auto Header = ptml::PTMLIndentedOstream(Out, DecompiledCCodeIndentation);
+  auto Scope = B.getTag(ptml::tags::Div).scope(Header);
+  Header << B.getPragmaOnce();
+  Header << B.getIncludeGuardBegin("REVNG_HELPERS_H");
+  Header << B.getIncludeAngle("stdint.h");
+  Header << B.getIncludeAngle("stdbool.h");
+  Header << B.getIncludeQuote("revng-primitive-types.h");
+  Header << "\n";
+
+  for (const llvm::Function *F : Helpers) {
+    if (Log.isEnabled()) {
+      auto LineCommentScope = helpers::LineComment(Header,
+                                                   B.isGenerateTagLessPTML());
+      Header << *F->getType();
     }
-    return true;
+
+    // Print the declaration of the return type, if it's not scalar
+    const auto *RetTy = F->getReturnType();
+    if (auto *RetStructTy = dyn_cast<llvm::StructType>(RetTy)) {
+      printDefinition(RetStructTy, *F, Header, Types, B);
+      Header << '\n';
+    }
+
+    for (auto &Arg : F->args()) {
+      revng_assert(Arg.getType()->isSingleValueType());
+    }
+
+    printHelperPrototype(F, Header, Types, B);
+    Header << '\n';
   }
 
-  return llvm::any_of(F.getFunctionType()->params(), IsUnprintable);
+  Header << B.getIncludeGuardEnd();
 }
 
-bool dumpHelpersToHeader(const llvm::Module &M, llvm::raw_ostream &Out) {
-  using PTMLCBuilder = ptml::PTMLCBuilder;
-  PTMLCBuilder B;
-  auto Header = ptml::PTMLIndentedOstream(Out, DecompiledCCodeIndentation);
-  {
-    auto Scope = B.getTag(ptml::tags::Div).scope(Header);
-    Header << B.getPragmaOnce();
-    Header << B.getIncludeAngle("stdint.h");
-    Header << B.getIncludeAngle("stdbool.h");
-    Header << B.getIncludeQuote("revng-primitive-types.h");
-    Header << "\n";
-
-    for (const llvm::Function &F : M.functions()) {
-
-      // Skip non-helpers
-      bool IsHelper = FunctionTags::QEMU.isTagOf(&F)
-                      or FunctionTags::Helper.isTagOf(&F)
-                      or FunctionTags::OpaqueCSVValue.isTagOf(&F)
-                      or FunctionTags::Exceptional.isTagOf(&F)
-                      or F.isIntrinsic();
-      if (not IsHelper)
-        continue;
-
-      // Skip helpers that should never be printed:
-      // - because we expect them to never require emission and we wouldn't know
-      //   how to emit them (e.g. target-specific intrinsics)
-      // - because we want to actively avoid printing them even if they are
-      //   present, such as all LLVM's debug intrinsics
-      llvm::StringRef FName = F.getName();
-      bool ShouldNotBePrinted = F.isTargetIntrinsic()
-                                or FName.startswith("llvm.dbg");
-      if (ShouldNotBePrinted)
-        continue;
-
-      // Skip helpers that have argument types or return types that we don't
-      // know how to print (e.g. vector types, or struct types whose fields are
-      // not only pointers or integers).
-      // These should never happen in revng-generated IR anyway, except for some
-      // leftover unused declarations of custom helpers that are never used
-      // (such as unknownPC)
-      if (hasUnprintableArgsOrRetTypes(F))
-        continue;
-
-      if (Log.isEnabled()) {
-        auto LineCommentScope = helpers::LineComment(Header,
-                                                     B.isGenerateTagLessPTML());
-        Header << *F.getType();
-      }
-
-      // Print the declaration of the return type, if it's not scalar
-      const auto *RetTy = F.getReturnType();
-      if (auto *RetStructTy = dyn_cast<llvm::StructType>(RetTy)) {
-        printDefinition(RetStructTy, F, Header, B);
-        Header << '\n';
-      }
+bool dumpHelpersToHeader(const llvm::Module &M,
+                         llvm::raw_ostream &Out,
+                         HelpersHeaderCache *Cache) {
+  ptml::PTMLCBuilder B;
+  HelperTypePrinter Types(B);
+
+  // Unprintable helpers should never happen in revng-generated IR anyway,
+  // except for some leftover unused declarations of custom helpers that are
+  // never used (such as unknownPC)
+  std::vector<const llvm::Function *> Helpers;
+  for (const llvm::Function &F : M.functions())
+    if (shouldBePrinted(F) and Types.isPrintable(F.getFunctionType()))
+      Helpers.push_back(&F);
+
+  if (Cache == nullptr) {
+    printHeader(Helpers, Types, B, Out);
+    return true;
+  }
 
-      for (auto &Arg : F.args()) {
-        revng_assert(Arg.getType()->isSingleValueType());
-      }
+  // The header only depends on the names and the types of the helpers, so
+  // there is no need to print it again if none of them changed
+  std::string Signature;
+  {
+    llvm::raw_string_ostream SignatureStream(Signature);
+    SignatureStream << Log.isEnabled() << '\n';
+    for (const llvm::Function *F : Helpers)
+      SignatureStream << F->getName() << ' ' << *F->getFunctionType() << '\n';
+  }
 
-      printHelperPrototype(&F, Header, B);
-      Header << '\n';
-    }
+  if (Signature != Cache->Signature) {
+    Cache->Header.clear();
+    llvm::raw_string_ostream HeaderStream(Cache->Header);
+    printHeader(Helpers, Types, B, HeaderStream);
+    HeaderStream.flush();
+    Cache->Signature = std::move(Signature);
   }
 
+  Out << Cache->Header;
   return true;
 }
@@ -29,7 +29,7 @@ void HelpersToHeader::run(const pipeline::ExecutionContext &Ctx,
   if (EC)
     revng_abort(EC.message().c_str());
 
-  dumpHelpersToHeader(IRContainer.getModule(), Header);
+  dumpHelpersToHeader(IRContainer.getModule(), Header, &PreviousRun);
 
   Header.flush();
   EC = Header.error();
@@ -2,6 +2,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <unordered_map>
 
 #include "llvm/ADT/DepthFirstIterator.h"
@@ -63,34 +64,42 @@ static void printSegmentsTypes(const model::Segment &Segment,
 
 /// Print all type definitions for the types in the model
 static void printTypeDefinitions(const model::Binary &Model,
-                                 const TypeInlineHelper &TheTypeInlineHelper,
+                                 const TypeInliningInfo &TypeInlining,
                                  ptml::PTMLIndentedOstream &Header,
                                  ptml::PTMLCBuilder &B,
                                  QualifiedTypeNameMap &AdditionalTypeNames,
                                  const ModelToHeaderOptions &Options) {
-  std::set<const model::Type *> StackTypes, EmptyInlineTypes;
-  if (not Options.DisableTypeInlining)
-    StackTypes = TheTypeInlineHelper.collectStackTypes(Model);
+  const TypeInlineHelper &TheTypeInlineHelper = TypeInlining.Helper;
+  std::set<const model::Type *> NoStackTypes, EmptyInlineTypes;
+  const auto &StackTypes = Options.DisableTypeInlining ?
+                             NoStackTypes :
+                             TypeInlining.StackTypes;
 
   DependencyGraph Dependencies = buildDependencyGraph(Model.Types());
   const auto &TypeNodes = Dependencies.TypeNodes();
   auto &ToInline = Options.DisableTypeInlining ?
                      EmptyInlineTypes :
                      TheTypeInlineHelper.getTypesToInline();
-  std::set<const TypeDependencyNode *> Defined;
+  TypeDependencyNodeSet Defined(Dependencies);
 
   for (const auto *Root : Dependencies.nodes()) {
+    // Roots whose post order has already been visited from another root
+    if (Defined.contains(Root))
+      continue;
+
     revng_log(Log, "======== PostOrder " << getNodeLabel(Root));
 
     for (const auto *Node : llvm::post_order_ext(Root, Defined)) {
-      revng_log(Log, "== visiting " << getNodeLabel(Node));
-      for (const auto *Child :
-           llvm::children<const TypeDependencyNode *>(Node)) {
-        revng_log(Log, "= child " << getNodeLabel(Child));
-        if (Defined.contains(Child))
-          revng_log(Log, "      DEFINED");
-        else
-          revng_log(Log, "      NOT DEFINED");
+      if (Log.isEnabled()) {
+        revng_log(Log, "== visiting " << getNodeLabel(Node));
+        for (const auto *Child :
+             llvm::children<const TypeDependencyNode *>(Node)) {
+          revng_log(Log, "= child " << getNodeLabel(Child));
+          if (Defined.contains(Child))
+            revng_log(Log, "      DEFINED");
+          else
+            revng_log(Log, "      NOT DEFINED");
+        }
       }
 
       if (StackTypes.contains(Node->T)) {
@@ -188,6 +197,24 @@ static void printTypeDefinitions(const model::Binary &Model,
   }
 }
 
+size_t estimateModelHeaderSize(const model::Binary &Model,
+                               const ModelToHeaderOptions &Options) {
+  // The average PTML emitted for each of them, rounded up
+  constexpr size_t BytesPerType = 512;
+  constexpr size_t BytesPerPrototype = 384;
+  constexpr size_t BytesPerSegment = 256;
+  constexpr size_t BytesOfPreamble = 4096;
+
+  size_t Types = Model.Types().size();
+  Types -= std::min<size_t>(Types, Options.TypesToOmit.size());
+  size_t Prototypes = Model.Functions().size()
+                      + Model.ImportedDynamicFunctions().size();
+  Prototypes -= std::min(Prototypes, Options.FunctionsToOmit.size());
+  return BytesOfPreamble + Types * BytesPerType
+         + Prototypes * BytesPerPrototype
+         + Model.Segments().size() * BytesPerSegment;
+}
+
 bool dumpModelToHeader(const model::Binary &Model,
                        llvm::raw_ostream &Out,
                        const ModelToHeaderOptions &Options) {
@@ -200,6 +227,7 @@ bool dumpModelToHeader(const model::Binary &Model,
     auto Scope = B.getTag(ptml::tags::Div).scope(Header);
 
     Header << B.getPragmaOnce();
+    Header << B.getIncludeGuardBegin("REVNG_TYPES_AND_GLOBALS_H");
     Header << "\n";
     Header << B.getIncludeAngle("stdint.h");
     Header << B.getIncludeAngle("stdbool.h");
@@ -226,10 +254,10 @@ bool dumpModelToHeader(const model::Binary &Model,
       Header << B.getLineComment("===============");
       Header << '\n';
       QualifiedTypeNameMap AdditionalTypeNames;
-      TypeInlineHelper TheTypeInlineHelper(Model);
+      auto TypeInlining = getTypeInliningInfo(Model);
 
       printTypeDefinitions(Model,
-                           TheTypeInlineHelper,
+                           *TypeInlining,
                            Header,
                            B,
                            AdditionalTypeNames,
@@ -306,10 +334,17 @@ bool dumpModelToHeader(const model::Binary &Model,
       Header << B.getLineComment("==== Segments ====");
       Header << B.getLineComment("==================");
       Header << '\n';
-      for (const model::Segment &Segment : Model.Segments())
+      for (const model::Segment &Segment : Model.Segments()) {
+        if (not Segment.Type().empty()
+            and Options.TypesToOmit.contains(Segment.Type().get()))
+          continue;
+
         printSegmentsTypes(Segment, Header, B);
+      }
       Header << '\n';
     }
+
+    Header << B.getIncludeGuardEnd();
   }
   return true;
 }
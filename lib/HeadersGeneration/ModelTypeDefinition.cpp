@@ -2,18 +2,32 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <optional>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
 #include "revng-c/Backend/DecompiledCCodeIndentation.h"
 #include "revng-c/HeadersGeneration/ModelToHeader.h"
 #include "revng-c/HeadersGeneration/ModelTypeDefinition.h"
+#include "revng-c/Support/ModelTypeIndex.h"
 #include "revng-c/TypeNames/ModelToPTMLTypeHelpers.h"
 
 static Logger<> Log{ "model-type-definition" };
 
-std::string dumpModelTypeDefinition(const model::Binary &Model,
-                                    model::Type::Key Key) {
-  std::string Result;
+static llvm::cl::opt<unsigned>
+  TypeDefinitionThreads("type-definition-threads",
+                        llvm::cl::desc("Number of threads emitting the "
+                                       "definitions of the model types"),
+                        llvm::cl::init(1));
 
-  const UpcastablePointer<model::Type> &UpcastableType = Model.Types().at(Key);
+static std::string dumpDefinition(const model::Binary &Model,
+                                  const model::Type &Type) {
+  std::string Result;
 
   llvm::raw_string_ostream Out(Result);
   ptml::PTMLIndentedOstream PTMLOut(Out, DecompiledCCodeIndentation, true);
@@ -23,7 +37,7 @@ std::string dumpModelTypeDefinition(const model::Binary &Model,
   const std::set<const model::Type *> TypesToInline;
 
   printDefinition(Log,
-                  *UpcastableType,
+                  Type,
                   PTMLOut,
                   B,
                   Model,
@@ -35,3 +49,62 @@ std::string dumpModelTypeDefinition(const model::Binary &Model,
 
   return Result;
 }
+
+std::string dumpModelTypeDefinition(const model::Binary &Model,
+                                    model::Type::Key Key) {
+  return dumpDefinition(Model, *Model.Types().at(Key));
+}
+
+uint64_t fingerprintModelTypeDefinition(const model::Binary &Model,
+                                        model::Type::Key Key) {
+  const UpcastablePointer<model::Type> &Type = Model.Types().at(Key);
+
+  std::string Buffer;
+  {
+    llvm::raw_string_ostream OS(Buffer);
+    OS << static_cast<unsigned>(Model.Architecture()) << "\n";
+    serialize(OS, Type);
+    for (const model::QualifiedType &QT : Type->edges())
+      serialize(OS, Model.Types().at(QT.UnqualifiedType().get()->key()));
+  }
+
+  return llvm::xxHash64(Buffer);
+}
+
+std::vector<std::string>
+dumpModelTypeDefinitions(const model::Binary &Model,
+                         llvm::ArrayRef<model::Type::Key> Keys) {
+  std::vector<std::string> Result(Keys.size());
+
+  // Looking a type up in Binary::Types is a binary search, building the index
+  // costs as much as a lookup for each type. Only build it if there are enough
+  // keys to make up for that.
+  std::optional<ModelTypeIndex> Index;
+  size_t TypesCount = Model.Types().size();
+  if (Keys.size() * llvm::Log2_64_Ceil(TypesCount + 1) > TypesCount)
+    Index.emplace(Model);
+
+  auto GetType = [&Model,
+                  &Index](const model::Type::Key &Key) -> const model::Type & {
+    if (Index)
+      return Index->at(Key);
+    return *Model.Types().at(Key);
+  };
+
+  // Each definition only reads the model, but logging from multiple threads
+  // would interleave the output
+  if (TypeDefinitionThreads <= 1 or Log.isEnabled()) {
+    for (const auto &[Key, Definition] : llvm::zip(Keys, Result))
+      Definition = dumpDefinition(Model, GetType(Key));
+    return Result;
+  }
+
+  llvm::ThreadPool Pool(llvm::hardware_concurrency(TypeDefinitionThreads));
+  for (const auto &[Key, Definition] : llvm::zip(Keys, Result))
+    Pool.async([&Model, &Type = GetType(Key), &Definition = Definition]() {
+      Definition = dumpDefinition(Model, Type);
+    });
+  Pool.wait();
+
+  return Result;
+}
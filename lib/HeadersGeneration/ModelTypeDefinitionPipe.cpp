@@ -2,6 +2,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <vector>
+
+#include "llvm/ADT/STLExtras.h"
+
 #include "revng/Model/Binary.h"
 #include "revng/Pipeline/AllRegistries.h"
 #include "revng/Pipes/Kinds.h"
@@ -28,11 +32,41 @@ void GenerateModelTypeDefinition::run(const ExecutionContext &Ctx,
                                       TypeTargetList &TargetList,
                                       Container &ModelTypesContainer) {
   const model::Binary &Model = *getModelFromContext(Ctx);
+
+  // Forget the types that are gone
+  const auto &Types = Model.Types();
+  std::erase_if(PreviousDefinitions, [&Types](const auto &Entry) {
+    return Types.find(Entry.first) == Types.end();
+  });
+
+  // Only print the requested types that are new, or changed since their
+  // definition was last printed. Those still in the container have not been
+  // invalidated since they were produced, there's no need to fingerprint them.
+  std::vector<Container::KeyType> Keys;
+  std::vector<uint64_t> Fingerprints;
+  std::vector<Container::KeyType> Invalidated;
   for (const pipeline::Target &Target : TargetList.getTargets()) {
-    Container::KeyType
-      Key = Container::keyFromString(Target.getPathComponents()[0]);
-    ModelTypesContainer[Key] = dumpModelTypeDefinition(Model, Key);
+    auto Key = Container::keyFromString(Target.getPathComponents()[0]);
+    if (ModelTypesContainer.find(Key) != ModelTypesContainer.end())
+      continue;
+
+    Invalidated.push_back(Key);
+    uint64_t Fingerprint = fingerprintModelTypeDefinition(Model, Key);
+    auto It = PreviousDefinitions.find(Key);
+    if (It == PreviousDefinitions.end()
+        or It->second.Fingerprint != Fingerprint) {
+      Keys.push_back(Key);
+      Fingerprints.push_back(Fingerprint);
+    }
   }
+
+  auto Definitions = dumpModelTypeDefinitions(Model, Keys);
+  for (auto &&[Key, Fingerprint, Definition] :
+       llvm::zip(Keys, Fingerprints, Definitions))
+    PreviousDefinitions[Key] = { Fingerprint, std::move(Definition) };
+
+  for (const Container::KeyType &Key : Invalidated)
+    ModelTypesContainer[Key] = PreviousDefinitions.at(Key).Definition;
 }
 
 void GenerateModelTypeDefinition::print(const Context &Ctx,
@@ -0,0 +1,136 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+#include <optional>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+#include "clang/Driver/Driver.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Tooling/Tooling.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/PathList.h"
+
+#include "revng-c/HeadersGeneration/PrecompileHeaders.h"
+
+using namespace llvm;
+
+static Logger<> Log{ "precompile-headers" };
+
+static constexpr std::string_view PCHInputFile = "revng-headers.h";
+
+static std::vector<std::string>
+getOptionsFromCFGFile(llvm::StringRef FilePath) {
+  std::vector<std::string> Result;
+
+  auto MaybeBuffer = llvm::MemoryBuffer::getFile(FilePath);
+  revng_assert(MaybeBuffer);
+
+  llvm::SmallVector<llvm::StringRef, 0> Lines;
+  MaybeBuffer->get()->getBuffer().split(Lines, '\n');
+  for (llvm::StringRef &Line : Lines) {
+    if (Line.size() > 0 and Line[0] == '-')
+      Result.push_back(Line.str());
+  }
+
+  return Result;
+}
+
+static std::optional<std::string> findHeaderFile(const std::string &File) {
+  auto MaybeHeaderPath = revng::ResourceFinder.findFile(File);
+  if (not MaybeHeaderPath)
+    return std::nullopt;
+  auto Index = (*MaybeHeaderPath).rfind('/');
+  if (Index == std::string::npos)
+    return std::nullopt;
+
+  return (*MaybeHeaderPath).substr(0, Index);
+}
+
+llvm::Expected<std::vector<std::string>> getDecompiledCCompilation() {
+  // Find compile flags to be applied to clang.
+  StringRef CompileFlagsPath = "share/revng-c/compile-flags.cfg";
+  auto MaybeCompileCFGPath = revng::ResourceFinder.findFile(CompileFlagsPath);
+  if (not MaybeCompileCFGPath) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Couldn't find compile-flags.cfg");
+  }
+
+  // Since the `--config` is just a clang Driver option, we need to parse it
+  // manually.
+  std::vector<std::string>
+    Compilation = getOptionsFromCFGFile(*MaybeCompileCFGPath);
+
+  SmallString<16> CompilerHeadersPath;
+  {
+    StringRef LLVMLibrary = getLibrariesFullPath().at("libLLVMSupport");
+    using namespace llvm::sys::path;
+    SmallString<16> ClangPath;
+    append(ClangPath, parent_path(parent_path(LLVMLibrary)));
+    append(ClangPath, Twine("bin"));
+    append(ClangPath, Twine("clang"));
+    CompilerHeadersPath = clang::driver::Driver::GetResourcesPath(ClangPath);
+    append(CompilerHeadersPath, Twine("include"));
+  }
+  Compilation.push_back("-I" + CompilerHeadersPath.str().str());
+
+  // Find revng-primitive-types.h and revng-attributes.h.
+  const char *PrimitivesHeader = "share/revng-c/include/"
+                                 "revng-primitive-types.h";
+  auto MaybePrimitiveHeaderPath = findHeaderFile(PrimitivesHeader);
+  if (not MaybePrimitiveHeaderPath) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Couldn't find revng-primitive-types.h");
+  }
+  Compilation.push_back("-I" + *MaybePrimitiveHeaderPath);
+
+  return Compilation;
+}
+
+/// Builds a precompiled header in \p OutputPath, regardless of the output file
+/// of the compiler invocation
+class GeneratePCHToFileAction : public clang::GeneratePCHAction {
+private:
+  std::string OutputPath;
+
+public:
+  GeneratePCHToFileAction(llvm::StringRef OutputPath) :
+    OutputPath(OutputPath.str()) {}
+
+public:
+  bool BeginInvocation(clang::CompilerInstance &CI) override {
+    CI.getFrontendOpts().OutputFile = OutputPath;
+    return GeneratePCHAction::BeginInvocation(CI);
+  }
+};
+
+llvm::Error precompileHeaders(llvm::ArrayRef<std::string> HeaderPaths,
+                              llvm::StringRef PCHPath,
+                              const std::vector<std::string> &Compilation) {
+  std::string Includes;
+  for (const std::string &Path : HeaderPaths) {
+    revng_log(Log, "Precompiling " << Path);
+    Includes += "#include \"" + Path + "\"\n";
+  }
+
+  std::vector<std::string> PCHCompilation(Compilation);
+  PCHCompilation.push_back("-xc-header");
+  auto Action = std::make_unique<GeneratePCHToFileAction>(PCHPath);
+  if (not clang::tooling::runToolOnCodeWithArgs(std::move(Action),
+                                                Includes,
+                                                PCHCompilation,
+                                                PCHInputFile)) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Unable to precompile the headers");
+  }
+
+  return llvm::Error::success();
+}
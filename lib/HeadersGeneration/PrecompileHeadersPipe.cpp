@@ -0,0 +1,123 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <vector>
+
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/WithColor.h"
+
+#include "revng/Model/Architecture.h"
+#include "revng/Pipeline/AllRegistries.h"
+#include "revng/Pipeline/RegisterContainerFactory.h"
+#include "revng/Pipes/ModelGlobal.h"
+#include "revng/Support/TemporaryFile.h"
+
+#include "revng-c/HeadersGeneration/PrecompileHeaders.h"
+#include "revng-c/HeadersGeneration/PrecompileHeadersPipe.h"
+#include "revng-c/Support/PTMLStripper.h"
+
+namespace revng::pipes {
+
+static pipeline::RegisterDefaultConstructibleContainer<
+  PrecompiledHeadersFileContainer>
+  Reg;
+
+/// Write the plain C version of the PTML header at \p Path to \p Plain
+static llvm::Error writePlainHeader(llvm::StringRef Path,
+                                    const TemporaryFile &Plain) {
+  auto MaybeBuffer = llvm::MemoryBuffer::getFile(Path);
+  if (not MaybeBuffer)
+    return llvm::errorCodeToError(MaybeBuffer.getError());
+
+  std::error_code EC;
+  llvm::raw_fd_ostream Header(Plain.path(), EC);
+  if (EC)
+    return llvm::errorCodeToError(EC);
+
+  Header << ptml::stripPTML((*MaybeBuffer)->getBuffer());
+  Header.flush();
+  EC = Header.error();
+  Header.clear_error();
+  return llvm::errorCodeToError(EC);
+}
+
+static llvm::Error
+precompile(const model::Binary &Model,
+           const ModelHeaderFileContainer &ModelHeaderFile,
+           const HelpersHeaderFileContainer &HelpersHeaderFile,
+           PrecompiledHeadersFileContainer &PCHFile) {
+  auto MaybeCompilation = getDecompiledCCompilation();
+  if (not MaybeCompilation)
+    return MaybeCompilation.takeError();
+  std::vector<std::string> Compilation = std::move(*MaybeCompilation);
+
+  // The PCH can only be used for the same target it was built for
+  auto PointerSize = model::Architecture::getPointerSize(Model.Architecture());
+  Compilation.push_back("-m" + std::to_string(PointerSize * 8));
+
+  // Don't make the PCH refer to the temporary plain headers on disk
+  Compilation.push_back("-fmodules-embed-all-files");
+
+  // Same order as the includes of the decompiled C code
+  std::vector<TemporaryFile> PlainHeaders;
+  std::vector<std::string> PlainHeaderPaths;
+  std::string InputPaths[] = { *ModelHeaderFile.path(),
+                               *HelpersHeaderFile.path() };
+  for (const std::string &Path : InputPaths) {
+    auto MaybePlain = TemporaryFile::make("precompile-headers", "h");
+    if (not MaybePlain)
+      return llvm::errorCodeToError(MaybePlain.getError());
+
+    if (auto Error = writePlainHeader(Path, *MaybePlain))
+      return Error;
+    PlainHeaderPaths.push_back(MaybePlain->path().str());
+    PlainHeaders.push_back(std::move(*MaybePlain));
+  }
+
+  // Only fill the container once clang succeeded, a partial PCH is useless
+  auto MaybePCH = TemporaryFile::make("precompile-headers", "h.pch");
+  if (not MaybePCH)
+    return llvm::errorCodeToError(MaybePCH.getError());
+
+  if (auto Error = precompileHeaders(PlainHeaderPaths,
+                                     MaybePCH->path(),
+                                     Compilation))
+    return Error;
+
+  std::error_code EC = llvm::sys::fs::copy_file(MaybePCH->path(),
+                                                PCHFile.getOrCreatePath());
+  return llvm::errorCodeToError(EC);
+}
+
+void PrecompileHeaders::run(const pipeline::ExecutionContext &Ctx,
+                            const ModelHeaderFileContainer &ModelHeaderFile,
+                            const HelpersHeaderFileContainer &HelpersHeaderFile,
+                            PrecompiledHeadersFileContainer &PCHFile) {
+  if (not ModelHeaderFile.exists() or not HelpersHeaderFile.exists())
+    return;
+
+  // The headers can always be parsed instead of the PCH: if it can't be
+  // built, report why and go on without it
+  const model::Binary &Model = *getModelFromContext(Ctx);
+  if (auto Error = precompile(Model,
+                              ModelHeaderFile,
+                              HelpersHeaderFile,
+                              PCHFile)) {
+    llvm::WithColor::warning()
+      << "couldn't precompile the headers: "
+      << llvm::toString(std::move(Error)) << "\n";
+  }
+}
+
+void PrecompileHeaders::print(const pipeline::Context &Ctx,
+                              llvm::raw_ostream &OS,
+                              llvm::ArrayRef<std::string> Names) const {
+  OS << "[CLI tools for pipes are deprecated]\n";
+}
+
+} // end namespace revng::pipes
+
+static pipeline::RegisterPipe<revng::pipes::PrecompileHeaders> Y;
@@ -2,6 +2,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+
 #include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/TextDiagnostic.h"
@@ -101,6 +104,12 @@ private:
   using RawLocation = std::pair<model::Register::Values, ModelType>;
   std::optional<llvm::SmallVector<RawLocation, 4>> MultiRegisterReturnValue;
 
+  // The IDs of the types of the model, by kind and name. Built by the first
+  // getTypeByNameOrID, then kept up to date by recordNewType and dropped by
+  // replaceEditedType.
+  using TypeIDsByNameMap = llvm::DenseMap<unsigned, llvm::StringMap<uint64_t>>;
+  std::optional<TypeIDsByNameMap> TypeIDsByName;
+
 public:
   explicit DeclVisitor(TupleTree<model::Binary> &Model,
                        ASTContext &Context,
@@ -151,6 +160,14 @@ private:
   std::optional<model::TypePath> getTypeByNameOrID(llvm::StringRef Name,
                                                    TypeKind::Values Kind);
 
+  void indexType(const model::Type &T);
+
+  // Add a new type to the model.
+  model::TypePath recordNewType(UpcastablePointer<model::Type> &&NewType);
+
+  // Replace the type being edited with a new type with the same ID.
+  void replaceEditedType(UpcastablePointer<model::Type> &&NewType);
+
   std::optional<model::QualifiedType>
   getModelTypeForClangType(const QualType &QT);
 
@@ -314,43 +331,56 @@ DeclVisitor::getOrCreatePrimitive(const BuiltinType *UnderlyingBuiltin,
   return std::nullopt;
 }
 
-std::optional<model::TypePath>
-DeclVisitor::getTypeByNameOrID(llvm::StringRef Name, TypeKind::Values Kind) {
-  const bool IsStruct = Kind == model::TypeKind::StructType;
-  const bool IsUnion = Kind == model::TypeKind::UnionType;
-  const bool IsEnum = Kind == model::TypeKind::EnumType;
-  const bool IsCABIFunction = Kind == model::TypeKind::CABIFunctionType;
-  const bool IsRawFunctionType = Kind == model::TypeKind::RawFunctionType;
-
-  // Find by name first.
-  for (auto &Type : Model->Types()) {
-    if (IsStruct and not llvm::isa<model::StructType>(Type.get()))
-      continue;
+void DeclVisitor::indexType(const model::Type &T) {
+  // In case of clashes, the type that comes first in the model wins
+  if (TypeIDsByName)
+    (*TypeIDsByName)[T.Kind()].try_emplace(T.CustomName(), T.ID());
+}
 
-    if (IsUnion and not llvm::isa<model::UnionType>(Type.get()))
-      continue;
+model::TypePath
+DeclVisitor::recordNewType(UpcastablePointer<model::Type> &&NewType) {
+  model::TypePath Result = Model->recordNewType(std::move(NewType));
+  indexType(*Result.get());
+  return Result;
+}
 
-    if (IsEnum and not llvm::isa<model::EnumType>(Type.get()))
-      continue;
+void DeclVisitor::replaceEditedType(UpcastablePointer<model::Type> &&NewType) {
+  // Remove old and add new type with the same ID.
+  llvm::erase_if(Model->Types(), [&](UpcastablePointer<model::Type> &P) {
+    return P.get()->ID() == (*Type)->ID();
+  });
+  Model->Types().insert(std::move(NewType));
 
-    if (IsCABIFunction and not llvm::isa<model::CABIFunctionType>(Type.get()))
-      continue;
+  // The name, or even the kind, of the edited type might have changed
+  TypeIDsByName.reset();
+}
 
-    if (IsRawFunctionType and not llvm::isa<model::RawFunctionType>(Type.get()))
-      continue;
+std::optional<model::TypePath>
+DeclVisitor::getTypeByNameOrID(llvm::StringRef Name, TypeKind::Values Kind) {
+  revng_assert(Kind == model::TypeKind::StructType
+               or Kind == model::TypeKind::UnionType
+               or Kind == model::TypeKind::EnumType
+               or Kind == model::TypeKind::CABIFunctionType
+               or Kind == model::TypeKind::RawFunctionType);
 
-    if (Type->CustomName() == Name)
-      return Model->getTypePath(Type.get());
+  // Find by name first.
+  if (not TypeIDsByName) {
+    TypeIDsByName.emplace();
+    for (const UpcastablePointer<model::Type> &T : Model->Types())
+      indexType(*T);
   }
 
+  const llvm::StringMap<uint64_t> &TypeIDs = (*TypeIDsByName)[Kind];
+  auto It = TypeIDs.find(Name);
+  if (It != TypeIDs.end())
+    return Model->getTypePath(model::Type::Key{ It->second, Kind });
+
   size_t LocationOfID = Name.rfind("_");
 
   if (LocationOfID != std::string::npos) {
-    std::string ID = std::string(Name.substr(LocationOfID + 1));
-    uint64_t TypeID;
-
-    std::istringstream TheStream(ID);
-    TheStream >> TypeID;
+    uint64_t TypeID = 0;
+    if (Name.substr(LocationOfID + 1).getAsInteger(10, TypeID))
+      return std::nullopt;
 
     auto KeyType = model::Type::Key{ TypeID, Kind };
 
@@ -770,7 +800,7 @@ bool DeclVisitor::VisitFunctionDecl(const clang::FunctionDecl *FD) {
 
   // TODO: remember/clone StackFrameType as well.
 
-  auto Prototype = Model->recordNewType(std::move(NewType));
+  auto Prototype = recordNewType(std::move(NewType));
   ModelFunction.Prototype() = Prototype;
 
   return true;
@@ -825,14 +855,9 @@ bool DeclVisitor::VisitTypedefDecl(const TypedefDecl *D) {
   setCustomName(*TheTypeTypeDef, D->getName());
 
   if (AnalysisOption == ImportFromCOption::EditType) {
-    // Remove old and add new type with the same ID.
-    llvm::erase_if(Model->Types(), [&](UpcastablePointer<model::Type> &P) {
-      return P.get()->ID() == (*Type)->ID();
-    });
-
-    Model->Types().insert(std::move(TypeTypedef));
+    replaceEditedType(std::move(TypeTypedef));
   } else {
-    Model->recordNewType(std::move(TypeTypedef));
+    recordNewType(std::move(TypeTypedef));
   }
 
   return true;
@@ -900,14 +925,9 @@ bool DeclVisitor::VisitFunctionPrototype(const FunctionProtoType *FP,
   }
 
   if (AnalysisOption == ImportFromCOption::EditType) {
-    // Remove old and add new type with the same ID.
-    llvm::erase_if(Model->Types(), [&](UpcastablePointer<model::Type> &P) {
-      return P.get()->ID() == (*Type)->ID();
-    });
-
-    Model->Types().insert(std::move(NewType));
+    replaceEditedType(std::move(NewType));
   } else {
-    Model->recordNewType(std::move(NewType));
+    recordNewType(std::move(NewType));
   }
 
   return true;
@@ -1020,11 +1040,7 @@ bool DeclVisitor::handleStructType(const clang::RecordDecl *RD) {
 
   switch (AnalysisOption) {
   case ImportFromCOption::EditType:
-    // Remove old and add new type with the same ID.
-    llvm::erase_if(Model->Types(), [&](UpcastablePointer<model::Type> &P) {
-      return P.get()->ID() == (*Type)->ID();
-    });
-    Model->Types().insert(std::move(NewType));
+    replaceEditedType(std::move(NewType));
     break;
 
   case ImportFromCOption::EditFunctionPrototype:
@@ -1032,7 +1048,7 @@ bool DeclVisitor::handleStructType(const clang::RecordDecl *RD) {
     break;
 
   case ImportFromCOption::AddType:
-    Model->recordNewType(std::move(NewType));
+    recordNewType(std::move(NewType));
     break;
   }
 
@@ -1075,13 +1091,9 @@ bool DeclVisitor::handleUnionType(const clang::RecordDecl *RD) {
   }
 
   if (AnalysisOption == ImportFromCOption::EditType) {
-    // Remove old and add new type with the same ID.
-    llvm::erase_if(Model->Types(), [&](UpcastablePointer<model::Type> &P) {
-      return P.get()->ID() == (*Type)->ID();
-    });
-    Model->Types().insert(std::move(NewType));
+    replaceEditedType(std::move(NewType));
   } else {
-    Model->recordNewType(std::move(NewType));
+    recordNewType(std::move(NewType));
   }
 
   return true;
@@ -1166,14 +1178,9 @@ bool DeclVisitor::VisitEnumDecl(const EnumDecl *D) {
   }
 
   if (AnalysisOption == ImportFromCOption::EditType) {
-    // Remove old and add new type with the same ID.
-    llvm::erase_if(Model->Types(), [&](UpcastablePointer<model::Type> &P) {
-      return P.get()->ID() == (*Type)->ID();
-    });
-
-    Model->Types().insert(std::move(NewType));
+    replaceEditedType(std::move(NewType));
   } else {
-    Model->recordNewType(std::move(NewType));
+    recordNewType(std::move(NewType));
   }
 
   return true;
@@ -5,15 +5,25 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <fstream>
+#include <mutex>
+#include <map>
+#include <optional>
 #include <string>
 #include <tuple>
 #include <vector>
 
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/ToolOutputFile.h"
 
-#include "clang/Driver/Driver.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendAction.h"
 #include "clang/Lex/PreprocessorOptions.h"
@@ -21,12 +31,15 @@
 #include "clang/Tooling/CommonOptionsParser.h"
 #include "clang/Tooling/Tooling.h"
 
+#include "revng/Model/Binary.h"
 #include "revng/Model/Type.h"
+#include "revng/Model/VerifyHelper.h"
 #include "revng/Pipeline/Context.h"
 #include "revng/Pipeline/Kind.h"
 #include "revng/Pipeline/Option.h"
 #include "revng/Pipeline/RegisterAnalysis.h"
 #include "revng/Pipes/ModelGlobal.h"
+#include "revng/Support/Debug.h"
 #include "revng/Support/PathList.h"
 #include "revng/Support/TemporaryFile.h"
 #include "revng/Support/YAMLTraits.h"
@@ -34,6 +47,7 @@
 
 #include "revng-c/Backend/DecompiledCCodeIndentation.h"
 #include "revng-c/HeadersGeneration/ModelToHeader.h"
+#include "revng-c/HeadersGeneration/PrecompileHeaders.h"
 
 #include "HeaderToModel.h"
 #include "ImportFromCAnalysis.h"
@@ -43,236 +57,541 @@ using namespace llvm;
 using namespace clang;
 using namespace clang::tooling;
 
-static constexpr std::string_view InputCFile = "revng-input.c";
-
-static std::vector<std::string>
-getOptionsFromCFGFile(llvm::StringRef FilePath) {
-  std::vector<std::string> Result;
+static Logger<> Log{ "import-from-c" };
 
-  auto MaybeBuffer = llvm::MemoryBuffer::getFile(FilePath);
-  revng_assert(MaybeBuffer);
-
-  llvm::SmallVector<llvm::StringRef, 0> Lines;
-  MaybeBuffer->get()->getBuffer().split(Lines, '\n');
-  for (llvm::StringRef &Line : Lines) {
-    if (Line.size() > 0 and Line[0] == '-')
-      Result.push_back(Line.str());
-  }
+static constexpr std::string_view InputCFile = "revng-input.c";
 
-  return Result;
+static llvm::cl::opt<bool> NarrowHeader("import-from-c-narrow-header",
+                                        llvm::cl::desc("Only emit the model "
+                                                       "types the C code to "
+                                                       "import refers to, "
+                                                       "and the types they "
+                                                       "depend on"),
+                                        llvm::cl::init(false));
+
+static llvm::cl::opt<bool> VerifyWholeModel("import-from-c-verify-whole-model",
+                                            llvm::cl::desc("Verify the whole "
+                                                           "model after an "
+                                                           "edit. When false, "
+                                                           "only verify what "
+                                                           "it affects, "
+                                                           "skipping the "
+                                                           "checks of the "
+                                                           "Binary itself, "
+                                                           "such as the "
+                                                           "uniqueness of "
+                                                           "names"),
+                                            llvm::cl::init(true));
+
+static bool isIdentifierHead(char C) {
+  return llvm::isAlpha(C) or C == '_';
 }
 
-static std::optional<std::string> findHeaderFile(const std::string &File) {
-  auto MaybeHeaderPath = revng::ResourceFinder.findFile(File);
-  if (not MaybeHeaderPath)
-    return std::nullopt;
-  auto Index = (*MaybeHeaderPath).rfind('/');
-  if (Index == std::string::npos)
-    return std::nullopt;
-
-  return (*MaybeHeaderPath).substr(0, Index);
+static bool isIdentifierBody(char C) {
+  return llvm::isAlnum(C) or C == '_';
 }
 
-struct ImportFromCAnalysis {
-  static constexpr auto Name = "import-from-c";
+/// Collect the types that \p CCode refers to by name, either directly or
+/// through one of their enum entries, along with all the types they depend on
+static llvm::SmallPtrSet<const model::Type *, 2>
+getTypesReferencedBy(llvm::StringRef CCode, const model::Binary &Model) {
+  llvm::StringMap<const model::Type *> TypesByName;
+  for (const UpcastablePointer<model::Type> &T : Model.Types()) {
+    TypesByName.try_emplace(T->name().str(), T.get());
+    if (auto *Enum = dyn_cast<model::EnumType>(T.get()))
+      for (const model::EnumEntry &Entry : Enum->Entries())
+        TypesByName.try_emplace(Enum->entryName(Entry), Enum);
+  }
 
-  constexpr static std::tuple Options = { pipeline::Option("location-to-edit",
-                                                           ""),
-                                          pipeline::Option("ccode", "") };
+  llvm::SmallPtrSet<const model::Type *, 2> Result;
+  llvm::SmallVector<const model::Type *, 16> Worklist;
+  auto Visit = [&Result, &Worklist](const model::Type *T) {
+    if (Result.insert(T).second)
+      Worklist.push_back(T);
+  };
+
+  // There's no need for a real lexer: spurious matches, e.g. in comments, only
+  // end up making the header bigger than necessary
+  while (true) {
+    size_t Start = CCode.find_if(isIdentifierHead);
+    if (Start == llvm::StringRef::npos)
+      break;
+
+    CCode = CCode.drop_front(Start);
+    llvm::StringRef Identifier = CCode.take_while(isIdentifierBody);
+    CCode = CCode.drop_front(Identifier.size());
+
+    auto It = TypesByName.find(Identifier);
+    if (It != TypesByName.end())
+      Visit(It->second);
+  }
 
-  std::vector<std::vector<pipeline::Kind *>> AcceptedKinds = {};
+  while (not Worklist.empty()) {
+    const model::Type *T = Worklist.pop_back_val();
+    for (const model::QualifiedType &QT : T->edges())
+      Visit(QT.UnqualifiedType().get());
+  }
 
-  llvm::Error run(pipeline::ExecutionContext &Ctx,
-                  std::string LocationToEdit,
-                  std::string CCode) {
-    enum ImportFromCOption TheOption;
-    auto &Model = revng::getWritableModelFromContext(Ctx);
+  return Result;
+}
 
-    // This will be used iff {Edit|Add}TypeFeature is used.
-    std::optional<model::Type *> TypeToEdit;
+/// A filtered model header, along with the precompiled version of it
+struct PrecompiledModelHeader {
+  std::string Text;
+  /// The PCH refers to the header, so it must outlive it unchanged
+  TemporaryFile Header;
+  TemporaryFile PCH;
+
+  PrecompiledModelHeader(std::string &&Text,
+                         TemporaryFile &&Header,
+                         TemporaryFile &&PCH) :
+    Text(std::move(Text)), Header(std::move(Header)), PCH(std::move(PCH)) {}
+};
 
-    // This will be used iff EditFunctionPrototypeFeature is used.
-    std::optional<model::Function> FunctionToBeEdited;
+/// Consecutive edits of the same type, or of types that the same types depend
+/// on, need the same filtered header: keep the last one precompiled, so that
+/// clang only has to parse the code of the user.
+static std::optional<PrecompiledModelHeader> LastPCH;
+static std::mutex PCHCacheMutex;
+
+static llvm::Expected<const PrecompiledModelHeader &>
+getPrecompiledModelHeader(std::string &&HeaderText,
+                          const std::vector<std::string> &Compilation) {
+  if (LastPCH.has_value() and LastPCH->Text == HeaderText) {
+    revng_log(Log, "Reusing the precompiled model header");
+    return *LastPCH;
+  }
 
-    if (LocationToEdit.empty()) {
-      // This is the default option of the analysis.
-      TheOption = ImportFromCOption::AddType;
-    } else {
-      if (auto L = pipeline::locationFromString(revng::ranks::Function,
-                                                LocationToEdit)) {
-        auto Key = std::get<0>(L->at(revng::ranks::Function));
-        auto Iterator = Model->Functions().find(Key);
-        if (Iterator == Model->Functions().end()) {
-          return llvm::createStringError(llvm::inconvertibleErrorCode(),
-                                         "Couldn't find the function "
-                                           + LocationToEdit);
-        }
-
-        FunctionToBeEdited = *Iterator;
-        TheOption = ImportFromCOption::EditFunctionPrototype;
-      } else if (auto L = pipeline::locationFromString(revng::ranks::Type,
-                                                       LocationToEdit)) {
-        auto Key = std::get<0>(L->at(revng::ranks::Type));
-        auto TypeKind = std::get<1>(L->at(revng::ranks::Type));
-
-        auto Iterator = Model->Types().find({ Key, TypeKind });
-        if (Iterator == Model->Types().end()) {
-          return llvm::createStringError(llvm::inconvertibleErrorCode(),
-                                         "Couldn't find the type "
-                                           + LocationToEdit);
-        }
-
-        TypeToEdit = Iterator->get();
-        TheOption = ImportFromCOption::EditType;
-      } else {
-        return llvm::createStringError(llvm::inconvertibleErrorCode(),
-                                       "Invalid location");
-      }
-    }
+  LastPCH.reset();
 
-    auto MaybeFilterModelPath = TemporaryFile::make("filtered-model-header-"
-                                                    "ptml",
-                                                    "h");
-    if (!MaybeFilterModelPath) {
-      std::error_code EC = MaybeFilterModelPath.getError();
+  auto MaybeHeader = TemporaryFile::make("filtered-model-header-ptml", "h");
+  auto MaybePCH = TemporaryFile::make("filtered-model-header-ptml", "h.pch");
+  for (auto *Maybe : { &MaybeHeader, &MaybePCH }) {
+    if (not *Maybe) {
+      std::error_code EC = Maybe->getError();
       return llvm::createStringError(EC,
                                      "Couldn't create temporary file: "
                                        + EC.message());
     }
+  }
 
-    TemporaryFile &FilterModelPath = MaybeFilterModelPath.get();
+  {
     std::error_code EC;
-    llvm::raw_fd_ostream Header(FilterModelPath.path(), EC);
+    llvm::raw_fd_ostream Header(MaybeHeader->path(), EC);
     if (EC) {
       return llvm::createStringError(EC,
                                      "Couldn't open file for "
                                      "filtered-model-header-ptml.h: "
                                        + EC.message());
     }
+    Header << HeaderText;
+  }
+
+  revng_log(Log, "Precompiling the model header " << MaybeHeader->path());
+  std::string HeaderPath = MaybeHeader->path().str();
+  if (auto Error = precompileHeaders({ HeaderPath },
+                                     MaybePCH->path(),
+                                     Compilation))
+    return std::move(Error);
+
+  LastPCH.emplace(std::move(HeaderText),
+                  std::move(*MaybeHeader),
+                  std::move(*MaybePCH));
+  return *LastPCH;
+}
 
-    ModelToHeaderOptions Options = {
-      .GeneratePlainC = true,
-      .DisableTypeInlining = true,
+/// Lets HeaderToModel change the model in place, undoing all the changes it
+/// can make unless commit() is called: adding new types, replacing the type
+/// being edited and changing the function being edited.
+///
+/// This is far cheaper than having HeaderToModel work on a copy of the whole
+/// model, just to be able to throw it away if something goes wrong.
+class ModelEditTransaction {
+private:
+  TupleTree<model::Binary> &Model;
+  /// The keys of all the types before the edit, sorted as Model->Types()
+  std::vector<model::Type::Key> OriginalTypes;
+  std::optional<UpcastablePointer<model::Type>> EditedType;
+  std::optional<model::Function> EditedFunction;
+  bool Committed = false;
+
+public:
+  ModelEditTransaction(TupleTree<model::Binary> &Model,
+                       const std::optional<model::Type *> &TypeToEdit,
+                       const std::optional<model::Function> &FunctionToEdit) :
+    Model(Model), EditedFunction(FunctionToEdit) {
+    OriginalTypes.reserve(Model->Types().size());
+    for (const UpcastablePointer<model::Type> &T : Model->Types())
+      OriginalTypes.push_back(T->key());
+
+    if (TypeToEdit.has_value())
+      EditedType = *Model->Types().find((*TypeToEdit)->key());
+  }
+
+  ~ModelEditTransaction() {
+    if (not Committed)
+      rollback();
+  }
+
+public:
+  /// A copy of the type being edited, unaffected by the edit
+  model::Type *editedType() {
+    revng_assert(EditedType.has_value());
+    return EditedType->get();
+  }
+
+  void commit() { Committed = true; }
+
+  /// Whether \p T has been added or replaced by the edit
+  bool isNewOrEdited(const model::Type &T) const {
+    if (EditedType.has_value() and T.ID() == (*EditedType)->ID())
+      return true;
+    return not std::binary_search(OriginalTypes.begin(),
+                                  OriginalTypes.end(),
+                                  T.key());
+  }
+
+  bool isEdited(const model::Function &F) const {
+    return EditedFunction.has_value() and F.Entry() == EditedFunction->Entry();
+  }
+
+private:
+  void rollback() {
+    auto IsNewOrEdited = [this](const UpcastablePointer<model::Type> &T) {
+      return isNewOrEdited(*T);
     };
+    llvm::erase_if(Model->Types(), IsNewOrEdited);
 
-    if (TheOption == ImportFromCOption::EditType) {
-      // For all the types other than functions and typedefs, generate forward
-      // declarations.
-      if (not isa<model::RawFunctionType>(*TypeToEdit)
-          and not isa<model::CABIFunctionType>(*TypeToEdit)
-          and not isa<model::TypedefType>(*TypeToEdit)) {
-        llvm::raw_string_ostream Stream(Options.PostIncludes);
-        ptml::PTMLCBuilder B(true);
-        ptml::PTMLIndentedOstream ThePTMLStream(Stream,
-                                                DecompiledCCodeIndentation,
-                                                true);
-        Stream << B.getLineComment("The type we are editing");
-        // The definition of this type will be at the end of the file.
-        printForwardDeclaration(**TypeToEdit, ThePTMLStream, B);
-        Stream << '\n';
-      }
+    if (EditedType.has_value())
+      Model->Types().insert(std::move(*EditedType));
 
-      // Find all types whose definition depends on the type we are editing.
-      Options.TypesToOmit = populateDependencies(*TypeToEdit, Model);
-    } else if (TheOption == ImportFromCOption::EditFunctionPrototype) {
-      Options.FunctionsToOmit.insert(FunctionToBeEdited->Entry());
-    } else {
-      revng_assert(TheOption == ImportFromCOption::AddType);
-      // We have nothing to ignore
+    if (EditedFunction.has_value())
+      Model->Functions()[EditedFunction->Entry()] = std::move(*EditedFunction);
+  }
+};
+
+/// Verify what the edit in \p Transaction can have broken: the new and edited
+/// types, all the types referring to them, directly or not, and the entities
+/// of the model using any of those. The rest of \p Model was valid before.
+///
+/// \note this does not cover the invariants of the Binary as a whole, such as
+///       the uniqueness of the names or the validity of the DefaultPrototype,
+///       hence it's only used with --import-from-c-verify-whole-model=false
+static bool verifyEdit(const model::Binary &Model,
+                       const ModelEditTransaction &Transaction,
+                       model::VerifyHelper &VH) {
+  SetVector<const model::Type *> Affected;
+  SmallVector<const model::Type *, 16> Worklist;
+  for (const UpcastablePointer<model::Type> &T : Model.Types())
+    if (Transaction.isNewOrEdited(*T))
+      Worklist.push_back(T.get());
+
+  if (not Worklist.empty()) {
+    std::map<const model::Type *, SmallVector<const model::Type *, 2>> Users;
+    for (const UpcastablePointer<model::Type> &T : Model.Types())
+      for (const model::QualifiedType &QT : T->edges())
+        Users[QT.UnqualifiedType().getConst()].push_back(T.get());
+
+    while (not Worklist.empty()) {
+      const model::Type *T = Worklist.pop_back_val();
+      if (not Affected.insert(T))
+        continue;
+
+      auto It = Users.find(T);
+      if (It != Users.end())
+        llvm::append_range(Worklist, It->second);
     }
+  }
 
-    dumpModelToHeader(*Model, Header, Options);
+  revng_log(Log, "Verifying " << Affected.size() << " types");
+  for (const model::Type *T : Affected)
+    if (not T->verify(VH))
+      return false;
 
-    Header.close();
+  auto IsAffected = [&Affected](const model::TypePath &Path) {
+    return not Path.empty() and Affected.count(Path.getConst()) != 0;
+  };
 
-    std::string FilteredHeader = std::string("#include \"")
-                                 + FilterModelPath.path().str()
-                                 + std::string("\"");
-    TupleTree<model::Binary> OutModel(Model);
+  for (const model::Function &F : Model.Functions())
+    if (Transaction.isEdited(F) or IsAffected(F.Prototype())
+        or IsAffected(F.StackFrameType()))
+      if (not F.verify(VH))
+        return false;
 
-    std::optional<revng::ParseCCodeError> Error;
-    std::unique_ptr<HeaderToModelAction> Action;
-
-    if (TheOption == ImportFromCOption::EditType) {
-      Action = std::make_unique<HeaderToModelEditTypeAction>(OutModel,
-                                                             Error,
-                                                             TypeToEdit);
-    } else if (TheOption == ImportFromCOption::EditFunctionPrototype) {
-      using EditFunctionPrototype = HeaderToModelEditFunctionAction;
-      Action = std::make_unique<EditFunctionPrototype>(OutModel,
-                                                       Error,
-                                                       FunctionToBeEdited);
-    } else {
-      Action = std::make_unique<HeaderToModelAddTypeAction>(OutModel, Error);
-    }
+  for (const model::DynamicFunction &F : Model.ImportedDynamicFunctions())
+    if (IsAffected(F.Prototype()) and not F.verify(VH))
+      return false;
+
+  for (const model::Segment &Segment : Model.Segments())
+    if (IsAffected(Segment.Type()) and not Segment.verify(VH))
+      return false;
+
+  return true;
+}
+
+/// Apply to \p Model the C code in \p CCode, either as the new definition of
+/// the type or of the prototype of the function at \p LocationToEdit or, if
+/// it's empty, as new types
+static llvm::Error importFromC(TupleTree<model::Binary> &Model,
+                               const std::string &LocationToEdit,
+                               const std::string &CCode) {
+  enum ImportFromCOption TheOption;
+
+  // This will be used iff {Edit|Add}TypeFeature is used.
+  std::optional<model::Type *> TypeToEdit;
+
+  // This will be used iff EditFunctionPrototypeFeature is used.
+  std::optional<model::Function> FunctionToBeEdited;
+
+  if (LocationToEdit.empty()) {
+    // This is the default option of the analysis.
+    TheOption = ImportFromCOption::AddType;
+  } else {
+    if (auto L = pipeline::locationFromString(revng::ranks::Function,
+                                              LocationToEdit)) {
+      auto Key = std::get<0>(L->at(revng::ranks::Function));
+      auto Iterator = Model->Functions().find(Key);
+      if (Iterator == Model->Functions().end()) {
+        return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                       "Couldn't find the function "
+                                         + LocationToEdit);
+      }
+
+      FunctionToBeEdited = *Iterator;
+      TheOption = ImportFromCOption::EditFunctionPrototype;
+    } else if (auto L = pipeline::locationFromString(revng::ranks::Type,
+                                                     LocationToEdit)) {
+      auto Key = std::get<0>(L->at(revng::ranks::Type));
+      auto TypeKind = std::get<1>(L->at(revng::ranks::Type));
+
+      auto Iterator = Model->Types().find({ Key, TypeKind });
+      if (Iterator == Model->Types().end()) {
+        return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                       "Couldn't find the type "
+                                         + LocationToEdit);
+      }
 
-    // Find compile flags to be applied to clang.
-    StringRef CompileFlagsPath = "share/revng-c/compile-flags.cfg";
-    auto MaybeCompileCFGPath = revng::ResourceFinder.findFile(CompileFlagsPath);
-    if (not MaybeCompileCFGPath) {
+      TypeToEdit = Iterator->get();
+      TheOption = ImportFromCOption::EditType;
+    } else {
       return llvm::createStringError(llvm::inconvertibleErrorCode(),
-                                     "Couldn't find compile-flags.cfg");
+                                     "Invalid location");
     }
+  }
 
-    // Since the `--config` is just a clang Driver option, we need to parse it
-    // manually.
-    auto FromCFGFile = getOptionsFromCFGFile(*MaybeCompileCFGPath);
-    std::vector<std::string> Compilation(FromCFGFile);
-    Compilation.push_back("-xc");
-
-    SmallString<16> CompilerHeadersPath;
-    {
-      StringRef LLVMLibrary = getLibrariesFullPath().at("libLLVMSupport");
-      using namespace llvm::sys::path;
-      SmallString<16> ClangPath;
-      append(ClangPath, parent_path(parent_path(LLVMLibrary)));
-      append(ClangPath, Twine("bin"));
-      append(ClangPath, Twine("clang"));
-      CompilerHeadersPath = clang::driver::Driver::GetResourcesPath(ClangPath);
-      append(CompilerHeadersPath, Twine("include"));
+  ModelToHeaderOptions Options = {
+    .GeneratePlainC = true,
+    .DisableTypeInlining = true,
+  };
+
+  if (TheOption == ImportFromCOption::EditType) {
+    // For all the types other than functions and typedefs, generate forward
+    // declarations.
+    if (not isa<model::RawFunctionType>(*TypeToEdit)
+        and not isa<model::CABIFunctionType>(*TypeToEdit)
+        and not isa<model::TypedefType>(*TypeToEdit)) {
+      llvm::raw_string_ostream Stream(Options.PostIncludes);
+      ptml::PTMLCBuilder B(true);
+      ptml::PTMLIndentedOstream ThePTMLStream(Stream,
+                                              DecompiledCCodeIndentation,
+                                              true);
+      Stream << B.getLineComment("The type we are editing");
+      // The definition of this type will be at the end of the file.
+      printForwardDeclaration(**TypeToEdit, ThePTMLStream, B);
+      Stream << '\n';
     }
-    Compilation.push_back("-I" + CompilerHeadersPath.str().str());
 
-    // Find revng-primitive-types.h and revng-attributes.h.
-    const char *PrimitivesHeader = "share/revng-c/include/"
-                                   "revng-primitive-types.h";
-    auto MaybePrimitiveHeaderPath = findHeaderFile(PrimitivesHeader);
-    if (not MaybePrimitiveHeaderPath) {
-      return llvm::createStringError(llvm::inconvertibleErrorCode(),
-                                     "Couldn't find revng-primitive-types.h");
-    }
-    Compilation.push_back("-I" + *MaybePrimitiveHeaderPath);
+    // Find all types whose definition depends on the type we are editing.
+    Options.TypesToOmit = populateDependencies(*TypeToEdit, Model);
+  } else if (TheOption == ImportFromCOption::EditFunctionPrototype) {
+    Options.FunctionsToOmit.insert(FunctionToBeEdited->Entry());
+  } else {
+    revng_assert(TheOption == ImportFromCOption::AddType);
+    // We have nothing to ignore
+  }
 
-    FilteredHeader += "\n";
-    FilteredHeader += CCode;
+  if (NarrowHeader) {
+    auto Referenced = getTypesReferencedBy(CCode, *Model);
+    for (const UpcastablePointer<model::Type> &T : Model->Types())
+      if (not Referenced.contains(T.get()))
+        Options.TypesToOmit.insert(T.get());
+  }
 
-    if (not clang::tooling::runToolOnCodeWithArgs(std::move(Action),
-                                                  FilteredHeader,
-                                                  Compilation,
-                                                  InputCFile)) {
-      return llvm::createStringError(llvm::inconvertibleErrorCode(),
-                                     "Unable to run clang");
-    }
+  std::string FilteredHeader;
+  FilteredHeader.reserve(estimateModelHeaderSize(*Model, Options));
+  {
+    llvm::raw_string_ostream Header(FilteredHeader);
+    dumpModelToHeader(*Model, Header, Options);
+  }
 
-    // Check if an error was reported by clang or revng during parsing of C
-    // code.
-    if (Error) {
-      return llvm::createStringError(llvm::inconvertibleErrorCode(),
-                                     (*Error).ErrorMessage);
+  // HeaderToModel works directly on Model: if anything goes wrong, the
+  // transaction restores it when going out of scope.
+  ModelEditTransaction Transaction(Model, TypeToEdit, FunctionToBeEdited);
+
+  std::optional<revng::ParseCCodeError> Error;
+  std::unique_ptr<HeaderToModelAction> Action;
+
+  // The original type is going to be replaced, give HeaderToModel a copy of
+  // it that stays alive in the meantime.
+  std::optional<model::Type *> TypeToReplace;
+
+  if (TheOption == ImportFromCOption::EditType) {
+    TypeToReplace = Transaction.editedType();
+    Action = std::make_unique<HeaderToModelEditTypeAction>(Model,
+                                                           Error,
+                                                           TypeToReplace);
+  } else if (TheOption == ImportFromCOption::EditFunctionPrototype) {
+    using EditFunctionPrototype = HeaderToModelEditFunctionAction;
+    Action = std::make_unique<EditFunctionPrototype>(Model,
+                                                     Error,
+                                                     FunctionToBeEdited);
+  } else {
+    Action = std::make_unique<HeaderToModelAddTypeAction>(Model, Error);
+  }
+
+  auto MaybeCompilation = getDecompiledCCompilation();
+  if (not MaybeCompilation)
+    return MaybeCompilation.takeError();
+  std::vector<std::string> Compilation = std::move(*MaybeCompilation);
+
+  // Only parse the code of the user, the rest of the model comes from the
+  // precompiled header. The leading newline keeps the line numbers in the
+  // diagnostics the same as when the header was included textually.
+  std::unique_lock<std::mutex> Lock(PCHCacheMutex);
+  llvm::Expected<const PrecompiledModelHeader &>
+    MaybePCH = getPrecompiledModelHeader(std::move(FilteredHeader),
+                                         Compilation);
+  if (not MaybePCH)
+    return MaybePCH.takeError();
+
+  Compilation.push_back("-include-pch");
+  Compilation.push_back(MaybePCH->PCH.path().str());
+  Compilation.push_back("-xc");
+
+  std::string Code = "\n" + CCode;
+  if (not clang::tooling::runToolOnCodeWithArgs(std::move(Action),
+                                                Code,
+                                                Compilation,
+                                                InputCFile)) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Unable to run clang");
+  }
+
+  // Check if an error was reported by clang or revng during parsing of C
+  // code.
+  if (Error) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   (*Error).ErrorMessage);
+  }
+
+  model::VerifyHelper VH(false);
+  bool Verified = VerifyWholeModel ? Model->verify(VH) :
+                                     verifyEdit(*Model, Transaction, VH);
+  if (not Verified) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "New model does not verify: "
+                                     + VH.getReason());
+  }
+
+  Transaction.commit();
+
+  return llvm::Error::success();
+}
+
+struct ImportFromCAnalysis {
+  static constexpr auto Name = "import-from-c";
+
+  constexpr static std::tuple Options = { pipeline::Option("location-to-edit",
+                                                           ""),
+                                          pipeline::Option("ccode", "") };
+
+  std::vector<std::vector<pipeline::Kind *>> AcceptedKinds = {};
+
+  llvm::Error run(pipeline::ExecutionContext &Ctx,
+                  std::string LocationToEdit,
+                  std::string CCode) {
+    auto &Model = revng::getWritableModelFromContext(Ctx);
+    return importFromC(Model, LocationToEdit, CCode);
+  }
+};
+
+pipeline::RegisterAnalysis<ImportFromCAnalysis> ImportFromCReg;
+
+struct ImportFromCDeclaration {
+  std::string LocationToEdit;
+  std::string CCode;
+};
+
+template<>
+struct llvm::yaml::MappingTraits<ImportFromCDeclaration> {
+  static void mapping(IO &TheIO, ImportFromCDeclaration &Declaration) {
+    TheIO.mapOptional("LocationToEdit", Declaration.LocationToEdit);
+    TheIO.mapRequired("CCode", Declaration.CCode);
+  }
+};
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(ImportFromCDeclaration)
+
+/// Same as import-from-c, but for many declarations at once, passed as a YAML
+/// list of LocationToEdit and CCode pairs.
+///
+/// The declarations are applied in order, since each of them can refer to
+/// what the previous ones declared. Consecutive new types are parsed by clang
+/// in one go, while each edit needs its own run, with its own filtered header.
+/// The model is only changed if all of them succeed.
+struct ImportFromCBatchAnalysis {
+  static constexpr auto Name = "import-from-c-batch";
+
+  constexpr static std::tuple Options = { pipeline::Option("declarations",
+                                                           "") };
+
+  std::vector<std::vector<pipeline::Kind *>> AcceptedKinds = {};
+
+  llvm::Error run(pipeline::ExecutionContext &Ctx, std::string Declarations) {
+    std::vector<ImportFromCDeclaration> Parsed;
+    llvm::yaml::Input YAMLInput(Declarations);
+    YAMLInput >> Parsed;
+    if (YAMLInput.error()) {
+      return llvm::createStringError(YAMLInput.error(),
+                                     "Couldn't parse the declarations");
     }
 
-    model::VerifyHelper VH(false);
-    if (not OutModel->verify(VH)) {
-      return llvm::createStringError(llvm::inconvertibleErrorCode(),
-                                     "New model does not verify: "
-                                       + VH.getReason());
+    auto &Model = revng::getWritableModelFromContext(Ctx);
+    TupleTree<model::Binary> OutModel(Model);
+
+    std::string NewTypes;
+    auto ImportNewTypes = [&OutModel, &NewTypes]() -> llvm::Error {
+      if (NewTypes.empty())
+        return llvm::Error::success();
+
+      llvm::Error Result = importFromC(OutModel, "", NewTypes);
+      NewTypes.clear();
+      return Result;
+    };
+
+    for (const ImportFromCDeclaration &Declaration : Parsed) {
+      if (Declaration.LocationToEdit.empty()) {
+        NewTypes += Declaration.CCode;
+        NewTypes += '\n';
+        continue;
+      }
+
+      if (auto Error = ImportNewTypes())
+        return Error;
+
+      if (auto Error = importFromC(OutModel,
+                                   Declaration.LocationToEdit,
+                                   Declaration.CCode))
+        return Error;
     }
 
-    // Replace the original Model with the OutModel that contains the changes.
+    if (auto Error = ImportNewTypes())
+      return Error;
+
     Model = OutModel;
 
     return llvm::Error::success();
   }
 };
 
-pipeline::RegisterAnalysis<ImportFromCAnalysis> ImportFromCReg;
+pipeline::RegisterAnalysis<ImportFromCBatchAnalysis> ImportFromCBatchReg;
@@ -53,7 +53,6 @@ template<typename T>
 using RPOT = llvm::ReversePostOrderTraversal<T>;
 
 using TypeVector = llvm::SmallVector<QualifiedType, 8>;
-using ModelTypesMap = std::map<const llvm::Value *, const model::QualifiedType>;
 
 /// Map each llvm::Argument of the given llvm::Function to its
 /// QualifiedType in the model.
@@ -165,12 +164,22 @@ static TypeVector getReturnTypes(FunctionMetadataCache &Cache,
                                  const llvm::CallInst *Call,
                                  const model::Function *ParentFunc,
                                  const Binary &Model,
-                                 const ModelTypesMap &TypeMap) {
+                                 const ModelTypesMap &TypeMap,
+                                 PrototypeReturnTypesMap &PrototypeTypes) {
   TypeVector ReturnTypes;
 
   if (Call->getType()->isVoidTy())
     return {};
 
+  // The types returned by isolated calls only depend on the prototype
+  if (isCallToIsolatedFunction(Call)) {
+    auto Prototype = Cache.getCallSitePrototype(Model, Call);
+    auto [It, New] = PrototypeTypes.try_emplace(Prototype.getConst());
+    if (New)
+      It->second = getStrongModelInfo(Cache, Call, Model);
+    return TypeVector(It->second.begin(), It->second.end());
+  }
+
   // Check if we already have strong model information for this call
   ReturnTypes = getStrongModelInfo(Cache, Call, Model);
 
@@ -254,13 +263,15 @@ static void handleCallInstruction(FunctionMetadataCache &Cache,
                                   const model::Function *ParentFunc,
                                   const Binary &Model,
                                   ModelTypesMap &TypeMap,
-                                  bool PointersOnly) {
+                                  bool PointersOnly,
+                                  PrototypeReturnTypesMap &PrototypeTypes) {
 
   TypeVector ReturnedQualTypes = getReturnTypes(Cache,
                                                 Call,
                                                 ParentFunc,
                                                 Model,
-                                                TypeMap);
+                                                TypeMap,
+                                                PrototypeTypes);
 
   if (ReturnedQualTypes.empty())
     return;
@@ -492,6 +503,7 @@ initModelTypesImpl(FunctionMetadataCache &Cache,
                    const Binary &Model,
                    bool PointersOnly,
                    ModelTypesMap &TypeMap,
+                   PrototypeReturnTypesMap &PrototypeTypes,
                    llvm::SmallPtrSet<const llvm::PHINode *, 8>
                      VisitedPHIs = {}) {
 
@@ -531,7 +543,13 @@ initModelTypesImpl(FunctionMetadataCache &Cache,
   // the binary or to special intrinsics used by the backend, so they need
   // to be handled separately
   if (auto *Call = dyn_cast<llvm::CallInst>(&I)) {
-    handleCallInstruction(Cache, Call, ModelF, Model, TypeMap, PointersOnly);
+    handleCallInstruction(Cache,
+                          Call,
+                          ModelF,
+                          Model,
+                          TypeMap,
+                          PointersOnly,
+                          PrototypeTypes);
     auto CallTypeIt = TypeMap.find(Call);
     std::optional<QualifiedType> CallType = std::nullopt;
     if (CallTypeIt != TypeMap.end())
@@ -668,6 +686,7 @@ initModelTypesImpl(FunctionMetadataCache &Cache,
                                                        Model,
                                                        PointersOnly,
                                                        TypeMap,
+                                                       PrototypeTypes,
                                                        VisitedPHIs);
           }
         }
@@ -701,6 +720,7 @@ initModelTypesImpl(FunctionMetadataCache &Cache,
                    const model::Function *ModelF,
                    const Binary &Model,
                    bool PointersOnly,
+                   PrototypeReturnTypesMap &PrototypeTypes,
                    llvm::SmallPtrSet<const llvm::PHINode *, 8>
                      VisitedPHIs = {}) {
 
@@ -720,6 +740,7 @@ initModelTypesImpl(FunctionMetadataCache &Cache,
                                                              Model,
                                                              PointersOnly,
                                                              TypeMap,
+                                                             PrototypeTypes,
                                                              VisitedPHIs);
       if (PointersOnly) {
         // Skip if it's not a pointer and we are only interested in pointers
@@ -745,5 +766,15 @@ ModelTypesMap initModelTypes(FunctionMetadataCache &Cache,
                              const model::Function *ModelF,
                              const Binary &Model,
                              bool PointersOnly) {
-  return initModelTypesImpl(Cache, F, ModelF, Model, PointersOnly);
+  PrototypeReturnTypesMap ReturnTypes;
+  return initModelTypesImpl(Cache, F, ModelF, Model, PointersOnly, ReturnTypes);
+}
+
+ModelTypesMap initModelTypes(FunctionMetadataCache &Cache,
+                             const llvm::Function &F,
+                             const model::Function *ModelF,
+                             const Binary &Model,
+                             bool PointersOnly,
+                             PrototypeReturnTypesMap &ReturnTypes) {
+  return initModelTypesImpl(Cache, F, ModelF, Model, PointersOnly, ReturnTypes);
 }
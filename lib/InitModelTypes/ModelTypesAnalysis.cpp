@@ -0,0 +1,54 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "revng/Model/IRHelpers.h"
+#include "revng/Model/LoadModelPass.h"
+#include "revng/Support/Assert.h"
+
+#include "revng-c/InitModelTypes/InitModelTypes.h"
+#include "revng-c/InitModelTypes/ModelTypesAnalysis.h"
+
+char ModelTypesAnalysis::ID = 0;
+
+using Register = llvm::RegisterPass<ModelTypesAnalysis>;
+static Register X("model-types",
+                  "Types associated to llvm::Values by initModelTypes",
+                  true,
+                  true);
+
+void ModelTypesAnalysis::getAnalysisUsage(llvm::AnalysisUsage &AU) const {
+  AU.addRequired<LoadModelWrapperPass>();
+  AU.addRequired<FunctionMetadataCachePass>();
+  AU.setPreservesAll();
+}
+
+bool ModelTypesAnalysis::runOnFunction(llvm::Function &F) {
+  this->F = &F;
+  Cache = &getAnalysis<FunctionMetadataCachePass>().get();
+  auto &ModelWrapper = getAnalysis<LoadModelWrapperPass>().get();
+  const model::Binary *NewModel = ModelWrapper.getReadOnlyModel().get();
+  if (NewModel != Model)
+    ReturnTypes.clear();
+  Model = NewModel;
+  releaseMemory();
+  return false;
+}
+
+const ModelTypesMap &ModelTypesAnalysis::getModelTypes(bool PointersOnly) {
+  revng_assert(F != nullptr);
+
+  std::optional<ModelTypesMap> &Result = PointersOnly ? PointerTypes :
+                                                        AllTypes;
+  if (not Result.has_value()) {
+    const model::Function *ModelF = llvmToModelFunction(*Model, *F);
+    Result = initModelTypes(*Cache,
+                            *F,
+                            ModelF,
+                            *Model,
+                            PointersOnly,
+                            ReturnTypes);
+  }
+
+  return *Result;
+}
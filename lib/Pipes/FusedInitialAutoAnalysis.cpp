@@ -0,0 +1,292 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+/// Analysis running detect-stack-size and analyze-data-layout, and all the
+/// steps in between, on a single in-memory copy of the module.
+///
+/// Going through the pipeline, each of the steps between the two analyses
+/// produces its own copy of module.ll, most of which are never requested
+/// again. On the first analysis of a binary, this copying is a large share of
+/// the total time.
+///
+/// The passes of each step are read from revng-c-pipelines.yml, so that the
+/// fused analysis can't drift from the steps it replaces.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/PassInfo.h"
+#include "llvm/PassRegistry.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include "revng/Lift/LoadBinaryPass.h"
+#include "revng/Model/LoadModelPass.h"
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/LLVMContainer.h"
+#include "revng/Pipeline/RegisterAnalysis.h"
+#include "revng/Pipes/FileContainer.h"
+#include "revng/Pipes/Kinds.h"
+#include "revng/Pipes/ModelGlobal.h"
+#include "revng/Support/Assert.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/PathList.h"
+
+#include "revng-c/DataLayoutAnalysis/DLAPass.h"
+#include "revng-c/Pipes/Kinds.h"
+#include "revng-c/Support/Trace.h"
+
+using namespace llvm;
+
+static Logger<> Log{ "fused-initial-auto-analysis" };
+
+namespace {
+
+/// The parts of revng-c-pipelines.yml we need to find out which passes each
+/// step runs
+struct PipeDeclaration {
+  std::string Type;
+  std::vector<std::string> Passes;
+};
+
+struct StepDeclaration {
+  std::string Name;
+  std::vector<PipeDeclaration> Pipes;
+};
+
+struct BranchDeclaration {
+  std::vector<StepDeclaration> Steps;
+};
+
+struct PipelineDeclaration {
+  std::vector<BranchDeclaration> Branches;
+};
+
+} // namespace
+
+template<>
+struct llvm::yaml::MappingTraits<PipeDeclaration> {
+  static void mapping(IO &TheIO, PipeDeclaration &Pipe) {
+    TheIO.mapRequired("Type", Pipe.Type);
+    TheIO.mapOptional("Passes", Pipe.Passes);
+  }
+};
+
+template<>
+struct llvm::yaml::MappingTraits<StepDeclaration> {
+  static void mapping(IO &TheIO, StepDeclaration &Step) {
+    TheIO.mapRequired("Name", Step.Name);
+    TheIO.mapOptional("Pipes", Step.Pipes);
+  }
+};
+
+template<>
+struct llvm::yaml::MappingTraits<BranchDeclaration> {
+  static void mapping(IO &TheIO, BranchDeclaration &Branch) {
+    TheIO.mapRequired("Steps", Branch.Steps);
+  }
+};
+
+template<>
+struct llvm::yaml::MappingTraits<PipelineDeclaration> {
+  static void mapping(IO &TheIO, PipelineDeclaration &Pipeline) {
+    TheIO.mapRequired("Branches", Pipeline.Branches);
+  }
+};
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(PipeDeclaration)
+LLVM_YAML_IS_SEQUENCE_VECTOR(StepDeclaration)
+LLVM_YAML_IS_SEQUENCE_VECTOR(BranchDeclaration)
+
+static constexpr const char *PipelinePath = "share/revng/pipelines/"
+                                            "revng-c-pipelines.yml";
+
+static void ignoreDiagnostic(const SMDiagnostic &, void *) {
+}
+
+/// Load the pipeline the steps we fuse come from, so that we run exactly the
+/// passes the pipeline does
+static Expected<PipelineDeclaration> loadPipeline() {
+  auto MaybePath = revng::ResourceFinder.findFile(PipelinePath);
+  if (not MaybePath) {
+    return createStringError(inconvertibleErrorCode(),
+                             "Couldn't find %s",
+                             PipelinePath);
+  }
+
+  auto BufferOrError = MemoryBuffer::getFile(*MaybePath);
+  if (not BufferOrError) {
+    return createStringError(BufferOrError.getError(),
+                             "Couldn't read %s",
+                             MaybePath->c_str());
+  }
+
+  // Only a few of the keys are mapped: don't warn about the others
+  PipelineDeclaration Pipeline;
+  yaml::Input YAMLInput((*BufferOrError)->getBuffer(),
+                        nullptr,
+                        ignoreDiagnostic);
+  YAMLInput.setAllowUnknownKeys(true);
+  YAMLInput >> Pipeline;
+  if (YAMLInput.error()) {
+    return createStringError(YAMLInput.error(),
+                             "Couldn't parse %s",
+                             MaybePath->c_str());
+  }
+
+  return Pipeline;
+}
+
+/// \return the passes of the only llvm-pipe of \p StepName
+static Expected<ArrayRef<std::string>>
+getStepPasses(const PipelineDeclaration &Pipeline, StringRef StepName) {
+  for (const BranchDeclaration &Branch : Pipeline.Branches) {
+    for (const StepDeclaration &Step : Branch.Steps) {
+      if (Step.Name != StepName)
+        continue;
+
+      if (Step.Pipes.size() != 1 or Step.Pipes[0].Type != "llvm-pipe") {
+        return createStringError(inconvertibleErrorCode(),
+                                 "fused-initial-auto-analysis expects %s to "
+                                 "be a single llvm-pipe",
+                                 StepName.str().c_str());
+      }
+
+      return ArrayRef<std::string>(Step.Pipes[0].Passes);
+    }
+  }
+
+  return createStringError(inconvertibleErrorCode(),
+                           "fused-initial-auto-analysis can't find step %s",
+                           StepName.str().c_str());
+}
+
+static Error addPasses(legacy::PassManager &Manager,
+                       ArrayRef<std::string> Names) {
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  for (const std::string &Name : Names) {
+    const PassInfo *Info = Registry.getPassInfo(Name);
+    if (Info == nullptr) {
+      return createStringError(inconvertibleErrorCode(),
+                               "fused-initial-auto-analysis: unknown pass %s",
+                               Name.c_str());
+    }
+    Manager.add(Info->createPass());
+  }
+
+  return Error::success();
+}
+
+class FusedInitialAutoAnalysis {
+public:
+  static constexpr auto Name = "fused-initial-auto-analysis";
+
+  std::vector<std::vector<pipeline::Kind *>> AcceptedKinds = {
+    { &revng::kinds::Binary },
+    { &revng::kinds::StackPointerPromoted }
+  };
+
+  llvm::Error run(pipeline::ExecutionContext &Ctx,
+                  const revng::pipes::BinaryFileContainer &SourceBinary,
+                  pipeline::LLVMContainer &Module) {
+    using namespace revng;
+
+    auto &Global = getWritableModelFromContext(Ctx);
+    if (Global->Architecture() == model::Architecture::Invalid) {
+      return createStringError(inconvertibleErrorCode(),
+                               "fused-initial-auto-analysis requires a valid"
+                               " Architecture");
+    }
+
+    if (not SourceBinary.exists()) {
+      return createStringError(inconvertibleErrorCode(),
+                               "fused-initial-auto-analysis requires the "
+                               "input binary");
+    }
+
+    auto MaybePipeline = loadPipeline();
+    if (not MaybePipeline)
+      return MaybePipeline.takeError();
+
+    auto MaybeSegregatePasses = getStepPasses(*MaybePipeline,
+                                              "segregate-stack-accesses");
+    if (not MaybeSegregatePasses)
+      return MaybeSegregatePasses.takeError();
+
+    auto MaybeLateOptimizePasses = getStepPasses(*MaybePipeline,
+                                                 "late-optimize");
+    if (not MaybeLateOptimizePasses)
+      return MaybeLateOptimizePasses.takeError();
+
+    auto BufferOrError = MemoryBuffer::getFileOrSTDIN(*SourceBinary.path());
+    if (not BufferOrError) {
+      return createStringError(BufferOrError.getError(),
+                               "fused-initial-auto-analysis can't read the "
+                               "input binary: %s",
+                               BufferOrError.getError().message().c_str());
+    }
+    std::unique_ptr<MemoryBuffer> Buffer = std::move(*BufferOrError);
+
+    // The container belongs to the detect-stack-size step, the later steps
+    // work on the only copy we make
+    std::unique_ptr<llvm::Module> M;
+    {
+      trace::Scope Trace("fused-initial-auto-analysis", "clone module");
+      M = CloneModule(Module.getModule());
+    }
+
+    // Each step gets its own pass manager, as it would in the pipeline, so
+    // that no analysis is reused across a change of the model
+    auto RunStep = [&](const char *Step, auto &&AddPasses) -> Error {
+      revng_log(Log, "Running " << Step);
+      trace::Scope Trace("fused-initial-auto-analysis", Step);
+      legacy::PassManager Manager;
+      Manager.add(new LoadModelWrapperPass(ModelWrapper(Global)));
+      if (Error E = AddPasses(Manager))
+        return E;
+      Manager.run(*M);
+      return Error::success();
+    };
+
+    auto DetectStackSize = [](legacy::PassManager &Manager) {
+      return addPasses(Manager, { "detect-stack-size" });
+    };
+    if (Error E = RunStep("detect-stack-size", DetectStackSize))
+      return E;
+
+    auto SegregateStackAccesses = [&](legacy::PassManager &Manager) {
+      return addPasses(Manager, *MaybeSegregatePasses);
+    };
+    if (Error E = RunStep("segregate-stack-accesses", SegregateStackAccesses))
+      return E;
+
+    auto LateOptimize = [&](legacy::PassManager &Manager) {
+      return addPasses(Manager, *MaybeLateOptimizePasses);
+    };
+    if (Error E = RunStep("late-optimize", LateOptimize))
+      return E;
+
+    auto MakeSegmentRef = [&Buffer](legacy::PassManager &Manager) {
+      Manager.add(new LoadBinaryWrapperPass(Buffer->getBuffer()));
+      return addPasses(Manager, { "make-segment-ref" });
+    };
+    if (Error E = RunStep("make-segment-ref", MakeSegmentRef))
+      return E;
+
+    auto AnalyzeDataLayout = [](legacy::PassManager &Manager) {
+      Manager.add(new DLAPass());
+      return Error::success();
+    };
+    return RunStep("analyze-data-layout", AnalyzeDataLayout);
+  }
+};
+
+static pipeline::RegisterAnalysis<FusedInitialAutoAnalysis> RegisterAnalysis;
@@ -2,6 +2,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Analysis/LazyValueInfo.h"
 #include "llvm/IR/ConstantRange.h"
 #include "llvm/IR/Instructions.h"
@@ -14,41 +16,51 @@
 
 using namespace llvm;
 
+void computeStackAccessBounds(LazyValueInfo &LVI, CallInst *Call) {
+  auto *FunctionType = Call->getFunctionType();
+  auto *DifferenceType = cast<IntegerType>(FunctionType->getParamType(1));
+  auto *Undef = UndefValue::get(DifferenceType);
+
+  // Identify lower bound of the lower bound
+  const auto &LowerBoundRange = LVI.getConstantRange(Call->getArgOperand(1),
+                                                     Call);
+  Value *LowerBound = nullptr;
+  if (not LowerBoundRange.isFullSet()) {
+    LowerBound = ConstantInt::get(DifferenceType, LowerBoundRange.getLower());
+  } else {
+    LowerBound = Undef;
+  }
+  Call->setArgOperand(1, LowerBound);
+
+  // Identify upper bound of the upper bound
+  const auto &UpperBoundRange = LVI.getConstantRange(Call->getArgOperand(2),
+                                                     Call);
+  Value *UpperBound = nullptr;
+  if (not UpperBoundRange.isFullSet()) {
+    UpperBound = ConstantInt::get(DifferenceType, UpperBoundRange.getUpper());
+  } else {
+    UpperBound = Undef;
+  }
+  Call->setArgOperand(2, UpperBound);
+}
+
 bool ComputeStackAccessesBoundsPass::runOnModule(Module &M) {
+  // Group the calls by function, so that each function gets its
+  // LazyValueInfo computed once, and queried for all of its calls in a row
+  MapVector<Function *, SmallVector<CallInst *, 8>> CallsByFunction;
   for (Function &StackOffsetFunction :
        FunctionTags::StackOffsetMarker.functions(&M)) {
-    auto *FunctionType = StackOffsetFunction.getFunctionType();
-    auto *DifferenceType = cast<IntegerType>(FunctionType->getParamType(1));
     for (CallBase *Call : callers(&StackOffsetFunction)) {
-      Function &F = *Call->getParent()->getParent();
-      LazyValueInfo &LVI = getAnalysis<LazyValueInfoWrapperPass>(F).getLVI();
-      auto *Undef = UndefValue::get(DifferenceType);
-
-      // Identify lower bound of the lower bound
-      const auto &LowerBoundRange = LVI.getConstantRange(Call->getArgOperand(1),
-                                                         cast<CallInst>(Call));
-      Value *LowerBound = nullptr;
-      if (not LowerBoundRange.isFullSet()) {
-        LowerBound = ConstantInt::get(DifferenceType,
-                                      LowerBoundRange.getLower());
-      } else {
-        LowerBound = Undef;
-      }
-      Call->setArgOperand(1, LowerBound);
-
-      // Identify upper bound of the upper bound
-      const auto &UpperBoundRange = LVI.getConstantRange(Call->getArgOperand(2),
-                                                         cast<CallInst>(Call));
-      Value *UpperBound = nullptr;
-      if (not UpperBoundRange.isFullSet()) {
-        UpperBound = ConstantInt::get(DifferenceType,
-                                      UpperBoundRange.getUpper());
-      } else {
-        UpperBound = Undef;
-      }
-      Call->setArgOperand(2, UpperBound);
+      Function *F = Call->getParent()->getParent();
+      CallsByFunction[F].push_back(cast<CallInst>(Call));
     }
   }
+
+  for (auto &[F, Calls] : CallsByFunction) {
+    LazyValueInfo &LVI = getAnalysis<LazyValueInfoWrapperPass>(*F).getLVI();
+    for (CallInst *Call : Calls)
+      computeStackAccessBounds(LVI, Call);
+  }
   return true;
 }
 
@@ -4,14 +4,16 @@
 
 #include <optional>
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ThreadPool.h"
 
 #include "revng/ABI/FunctionType/Layout.h"
 #include "revng/EarlyFunctionAnalysis/FunctionMetadataCache.h"
 #include "revng/Model/IRHelpers.h"
 #include "revng/Model/LoadModelPass.h"
 #include "revng/Model/QualifiedType.h"
-#include "revng/Model/VerifyHelper.h"
 #include "revng/Pipeline/Context.h"
 #include "revng/Pipeline/LLVMContainer.h"
 #include "revng/Pipeline/RegisterAnalysis.h"
@@ -97,14 +99,57 @@ public:
 
 namespace Architecture = model::Architecture;
 
+/// The stack accesses of a single function, as found scanning its IR
+struct StackAccesses {
+  UpperBoundCollector UpperBound;
+  LowerBoundCollector LowerBound;
+  /// Calls to stack_size_at_call_site
+  std::vector<CallInst *> CallSites;
+};
+
+/// Find the extremes of the stack accesses of \a F and its call sites.
+///
+/// This only reads the IR, so it can be run concurrently on different
+/// functions. For the same reason, it doesn't log anything.
+static StackAccesses scanStackAccesses(Function &F) {
+  StackAccesses Result;
+  for (llvm::BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      auto *Call = dyn_cast<CallInst>(&I);
+      if (Call == nullptr)
+        continue;
+
+      auto *CalledValue = skipCasts(Call->getCalledOperand());
+      auto *CalledFunction = dyn_cast<llvm::Function>(CalledValue);
+      if (CalledFunction == nullptr)
+        continue;
+
+      if (FunctionTags::StackOffsetMarker.isTagOf(CalledFunction)) {
+        // This is a call to a stack_offset function, let's record the offset
+        setBound(Result.LowerBound, Call->getArgOperand(1));
+        setBound(Result.UpperBound, Call->getArgOperand(2));
+      } else if (CalledFunction->getName() == "stack_size_at_call_site") {
+        Result.CallSites.push_back(Call);
+      }
+    }
+  }
+
+  return Result;
+}
+
+static cl::opt<unsigned>
+  DetectStackSizeThreads("detect-stack-size-threads",
+                         cl::desc("Number of threads scanning the stack "
+                                  "accesses of the isolated functions in "
+                                  "detect-stack-size"),
+                         cl::init(1));
+
 class DetectStackSize {
 private:
   TupleTree<model::Binary> &Binary;
   std::vector<FunctionStackInfo> FunctionsStackInfo;
   std::map<RawFunctionType *, UpperBoundCollector> FunctionTypeStackArguments;
   const size_t CallInstructionPushSize = 0;
-  /// Helper for fast model::Type size computation
-  model::VerifyHelper VH;
 
 public:
   DetectStackSize(TupleTree<model::Binary> &B) :
@@ -113,9 +158,29 @@ public:
 
 public:
   void run(FunctionMetadataCache &Cache, Module &M) {
-    // Collect information about the stack of each function
+    // Scan the IR of each function, possibly in parallel. Everything else
+    // goes through the model and the FunctionMetadataCache, and it's done
+    // serially afterwards.
+    std::vector<Function *> Functions;
     for (llvm::Function &F : FunctionTags::Isolated.functions(&M))
-      collectStackBounds(Cache, F);
+      Functions.push_back(&F);
+
+    std::vector<StackAccesses> Accesses(Functions.size());
+    if (DetectStackSizeThreads > 1) {
+      ThreadPool Pool(hardware_concurrency(DetectStackSizeThreads));
+      for (const auto &[F, FunctionAccesses] : zip(Functions, Accesses))
+        Pool.async([F = F, &FunctionAccesses = FunctionAccesses]() {
+          FunctionAccesses = scanStackAccesses(*F);
+        });
+      Pool.wait();
+    } else {
+      for (const auto &[F, FunctionAccesses] : zip(Functions, Accesses))
+        FunctionAccesses = scanStackAccesses(*F);
+    }
+
+    // Collect information about the stack of each function
+    for (const auto &[F, FunctionAccesses] : zip(Functions, Accesses))
+      collectStackBounds(Cache, *F, FunctionAccesses);
 
     // At this point we have populated two data structures:
     //
@@ -123,25 +188,51 @@ public:
     // * FunctionsStackInfo: we can use it to elect stack frame size
 
     // Elect stack arguments size for prototypes
-    for (auto &[Prototype, UpperBound] : FunctionTypeStackArguments)
-      electStackArgumentsSize(Prototype, UpperBound);
+    std::vector<RawFunctionType *> Prototypes;
+    std::vector<uint64_t> StackArgumentsSizes;
+    for (auto &[Prototype, UpperBound] : FunctionTypeStackArguments) {
+      if (auto Size = electStackArgumentsSize(Prototype, UpperBound)) {
+        Prototypes.push_back(Prototype);
+        StackArgumentsSizes.push_back(*Size);
+      }
+    }
+
+    auto StackArgumentsTypes = createEmptyStructs(StackArgumentsSizes);
+    for (const auto &[Prototype, Type] : zip(Prototypes, StackArgumentsTypes))
+      Prototype->StackArgumentsType() = Type;
 
     // Now all prototypes have a definitive stack arguments size, we can elect
     // stack frame size
-    for (FunctionStackInfo &FSI : FunctionsStackInfo)
-      electFunctionStackFrameSize(FSI);
+    std::vector<model::Function *> ModelFunctions;
+    std::vector<uint64_t> StackFrameSizes;
+    for (FunctionStackInfo &FSI : FunctionsStackInfo) {
+      if (auto Size = electFunctionStackFrameSize(FSI)) {
+        ModelFunctions.push_back(&FSI.Function);
+        StackFrameSizes.push_back(*Size);
+      }
+    }
+
+    auto StackFrameTypes = createEmptyStructs(StackFrameSizes);
+    for (const auto &[ModelFunction, Type] :
+         zip(ModelFunctions, StackFrameTypes))
+      ModelFunction->StackFrameType() = Type;
   }
 
 private:
-  void collectStackBounds(FunctionMetadataCache &Cache, Function &F);
-  void electStackArgumentsSize(RawFunctionType *Prototype,
-                               const UpperBoundCollector &Bound) const;
-  void electFunctionStackFrameSize(FunctionStackInfo &FSI);
+  void collectStackBounds(FunctionMetadataCache &Cache,
+                          Function &F,
+                          const StackAccesses &Accesses);
+  std::optional<uint64_t>
+  electStackArgumentsSize(RawFunctionType *Prototype,
+                          const UpperBoundCollector &Bound) const;
+  std::optional<uint64_t> electFunctionStackFrameSize(FunctionStackInfo &FSI);
+  std::vector<model::TypePath> createEmptyStructs(ArrayRef<uint64_t> Sizes);
   std::optional<uint64_t> handleCallSite(const CallSite &CallSite);
 };
 
 void DetectStackSize::collectStackBounds(FunctionMetadataCache &Cache,
-                                         Function &F) {
+                                         Function &F,
+                                         const StackAccesses &Accesses) {
 
   // Obtain model::Function corresponding to this llvm::Function
   MetaAddress Entry = getMetaAddressMetadata(&F, "revng.function.entry");
@@ -169,40 +260,24 @@ void DetectStackSize::collectStackBounds(FunctionMetadataCache &Cache,
 
   FunctionStackInfo FSI(ModelFunction);
 
-  // Go over all stack accesses and record the extremes
-  UpperBoundCollector UpperBound;
-  LowerBoundCollector LowerBound;
-  for (llvm::BasicBlock &BB : F) {
-    for (Instruction &I : BB) {
-      if (auto *Call = dyn_cast<CallInst>(&I)) {
-        auto *CalledValue = skipCasts(Call->getCalledOperand());
-        if (auto *CalledFunction = dyn_cast<llvm::Function>(CalledValue)) {
-          if (FunctionTags::StackOffsetMarker.isTagOf(CalledFunction)) {
-            revng_log(Log, "Considering stack offset marker " << getName(Call));
-            // This is a call to a stack_offset function, let's record the
-            // offset
-            setBound(LowerBound, Call->getArgOperand(1));
-            setBound(UpperBound, Call->getArgOperand(2));
-          } else if (CalledFunction->getName() == "stack_size_at_call_site") {
-            revng_log(Log, "Considering call site " << getName(Call));
-            auto &NewCallSite = FSI.CallSites.emplace_back();
-
-            // Try to get the stack offset
-            Value *StackOffsetArgument = Call->getArgOperand(0);
-            if (auto *Offset = dyn_cast<ConstantInt>(StackOffsetArgument))
-              NewCallSite.StackSize = Offset->getLimitedValue();
-
-            // Get the prototype
-            auto Proto = Cache.getCallSitePrototype(*Binary.get(),
-                                                    findAssociatedCall(Call),
-                                                    &ModelFunction);
-            NewCallSite.CallType = Proto.get()->key();
-          }
-        }
-      }
-    }
+  for (CallInst *Call : Accesses.CallSites) {
+    revng_log(Log, "Considering call site " << getName(Call));
+    auto &NewCallSite = FSI.CallSites.emplace_back();
+
+    // Try to get the stack offset
+    Value *StackOffsetArgument = Call->getArgOperand(0);
+    if (auto *Offset = dyn_cast<ConstantInt>(StackOffsetArgument))
+      NewCallSite.StackSize = Offset->getLimitedValue();
+
+    // Get the prototype
+    auto Proto = Cache.getCallSitePrototype(*Binary.get(),
+                                            findAssociatedCall(Call),
+                                            &ModelFunction);
+    NewCallSite.CallType = Proto.get()->key();
   }
 
+  const LowerBoundCollector &LowerBound = Accesses.LowerBound;
+  const UpperBoundCollector &UpperBound = Accesses.UpperBound;
   if (NeedsStackFrame) {
     if (LowerBound.hasValue()) {
       int64_t Size = -LowerBound.value().getLimitedValue();
@@ -223,8 +298,9 @@ void DetectStackSize::collectStackBounds(FunctionMetadataCache &Cache,
 }
 
 using DSSI = DetectStackSize;
-void DSSI::electStackArgumentsSize(RawFunctionType *Prototype,
-                                   const UpperBoundCollector &Bound) const {
+std::optional<uint64_t>
+DSSI::electStackArgumentsSize(RawFunctionType *Prototype,
+                              const UpperBoundCollector &Bound) const {
   revng_assert(Prototype->StackArgumentsType().empty());
   revng_assert(Bound.hasValue());
 
@@ -241,11 +317,14 @@ void DSSI::electStackArgumentsSize(RawFunctionType *Prototype,
     revng_log(Log,
               "electStackArgumentsSize for " << Prototype->ID() << ": "
                                              << Size);
-    Prototype->StackArgumentsType() = createEmptyStruct(*Binary.get(), Size);
+    return Size;
   }
+
+  return std::nullopt;
 }
 
-void DetectStackSize::electFunctionStackFrameSize(FunctionStackInfo &FSI) {
+std::optional<uint64_t>
+DetectStackSize::electFunctionStackFrameSize(FunctionStackInfo &FSI) {
   model::Function &ModelFunction = FSI.Function;
   revng_log(Log, "electFunctionStackFrameSize: " << ModelFunction.name().str());
   LoggerIndent<> Indent(Log);
@@ -276,9 +355,36 @@ void DetectStackSize::electFunctionStackFrameSize(FunctionStackInfo &FSI) {
 
   if (StackSize and isValidStackSize(*StackSize)) {
     revng_log(Log, "Final StackSize: " << *StackSize);
-    ModelFunction.StackFrameType() = createEmptyStruct(*Binary.get(),
-                                                       *StackSize);
+    return StackSize;
+  }
+
+  return std::nullopt;
+}
+
+/// Create an empty struct for each of \a Sizes.
+///
+/// The new types are inserted in the model all at once: inserting them one by
+/// one would shift the sorted vector of types each time, which is quadratic in
+/// the number of functions.
+std::vector<model::TypePath>
+DetectStackSize::createEmptyStructs(ArrayRef<uint64_t> Sizes) {
+  std::vector<const model::Type *> NewTypes;
+  {
+    auto Inserter = Binary->Types().batch_insert();
+    for (uint64_t Size : Sizes) {
+      auto NewType = model::makeType<model::StructType>();
+      cast<model::StructType>(NewType.get())->Size() = Size;
+      NewTypes.push_back(NewType.get());
+      Inserter.insert(std::move(NewType));
+    }
   }
+
+  std::vector<model::TypePath> Result;
+  Result.reserve(NewTypes.size());
+  for (const model::Type *NewType : NewTypes)
+    Result.push_back(Binary->getTypePath(NewType));
+
+  return Result;
 }
 
 std::optional<uint64_t>
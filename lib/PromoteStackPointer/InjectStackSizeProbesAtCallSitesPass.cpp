@@ -33,22 +33,27 @@ bool InjectStackSizeProbesAtCallSitesPass::runOnModule(llvm::Module &M) {
   for (Function &F : FunctionTags::Isolated.functions(&M)) {
     if (F.isDeclaration())
       continue;
-    setInsertPointToFirstNonAlloca(B, F);
 
+    // Collect the call sites first: leaf functions are left untouched
+    SmallVector<Instruction *, 8> CallSites;
+    for (BasicBlock &BB : F)
+      for (Instruction &I : BB)
+        if (isCallToIsolatedFunction(&I))
+          CallSites.push_back(&I);
+
+    if (CallSites.empty())
+      continue;
+
+    Changed = true;
+    setInsertPointToFirstNonAlloca(B, F);
     auto *SP0 = createLoad(B, SP);
 
-    for (BasicBlock &BB : F) {
-      for (Instruction &I : BB) {
-        if (isCallToIsolatedFunction(&I)) {
-          // We found a function call
-          Changed = true;
-          B.SetInsertPoint(&I);
-
-          // Inject a call to the marker. First argument is sp - sp0
-          auto *Call = B.CreateCall(SSACS, B.CreateSub(SP0, createLoad(B, SP)));
-          Call->copyMetadata(I);
-        }
-      }
+    for (Instruction *I : CallSites) {
+      B.SetInsertPoint(I);
+
+      // Inject a call to the marker. First argument is sp - sp0
+      auto *Call = B.CreateCall(SSACS, B.CreateSub(SP0, createLoad(B, SP)));
+      Call->copyMetadata(*I);
     }
   }
 
@@ -17,45 +17,31 @@ using namespace llvm;
 
 static Logger<> Log("instrument-stack-accesses");
 
-class InstrumentStackAccesses {
-private:
-  OpaqueFunctionsPool<Type *> StackOffsetPool;
-  CallInst *SP0 = nullptr;
-  Type *SPType = nullptr;
-
-public:
-  InstrumentStackAccesses(Module &M) : StackOffsetPool(&M, false) {
-    StackOffsetPool.addFnAttribute(Attribute::NoUnwind);
-    StackOffsetPool.addFnAttribute(Attribute::WillReturn);
-    StackOffsetPool.setMemoryEffects(MemoryEffects::inaccessibleMemOnly());
-    StackOffsetPool.setTags({ &FunctionTags::StackOffsetMarker });
-  }
+InstrumentStackAccesses::InstrumentStackAccesses(Module &M) :
+  StackOffsetPool(&M, false) {
+  StackOffsetPool.addFnAttribute(Attribute::NoUnwind);
+  StackOffsetPool.addFnAttribute(Attribute::WillReturn);
+  StackOffsetPool.setMemoryEffects(MemoryEffects::inaccessibleMemOnly());
+  StackOffsetPool.setTags({ &FunctionTags::StackOffsetMarker });
+}
 
-public:
-  void run(Function &F) {
-    revng_log(Log, "Instrumenting " << F.getName());
-    LoggerIndent<> Indent(Log);
+SmallVector<CallInst *, 16> InstrumentStackAccesses::run(Function &F) {
+  revng_log(Log, "Instrumenting " << F.getName());
+  LoggerIndent<> Indent(Log);
 
-    reset();
+  reset();
 
-    std::set<Instruction *> StackMemoryAccesses = findStackAccesses(F);
+  std::set<Instruction *> StackMemoryAccesses = findStackAccesses(F);
 
-    if (SP0 == nullptr)
-      return;
+  SmallVector<CallInst *, 16> Result;
+  if (SP0 == nullptr)
+    return Result;
 
-    for (Instruction *I : StackMemoryAccesses)
-      instrumentStackAccess(I);
-  }
+  for (Instruction *I : StackMemoryAccesses)
+    Result.push_back(instrumentStackAccess(I));
 
-private:
-  void reset() {
-    SP0 = nullptr;
-    SPType = nullptr;
-  }
-
-  std::set<Instruction *> findStackAccesses(Function &F);
-  void instrumentStackAccess(Instruction *I);
-};
+  return Result;
+}
 
 std::set<Instruction *>
 InstrumentStackAccesses::findStackAccesses(Function &F) {
@@ -111,7 +97,7 @@ InstrumentStackAccesses::findStackAccesses(Function &F) {
   return StackMemoryAccesses;
 }
 
-void InstrumentStackAccesses::instrumentStackAccess(Instruction *I) {
+CallInst *InstrumentStackAccesses::instrumentStackAccess(Instruction *I) {
   auto *Pointer = cast<Instruction>(getPointer(I));
 
   auto *IntegerPointer = cast<Instruction>(skipCasts(Pointer));
@@ -152,6 +138,8 @@ void InstrumentStackAccesses::instrumentStackAccess(Instruction *I) {
   } else {
     revng_abort();
   }
+
+  return ID;
 }
 
 bool InstrumentStackAccessesPass::runOnModule(Module &M) {
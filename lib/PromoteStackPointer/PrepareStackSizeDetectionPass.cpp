@@ -0,0 +1,86 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LazyValueInfo.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/PassInfo.h"
+#include "llvm/PassRegistry.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/FunctionTags.h"
+#include "revng/Support/IRHelpers.h"
+
+#include "revng-c/PromoteStackPointer/ComputeStackAccessesBoundsPass.h"
+#include "revng-c/PromoteStackPointer/InstrumentStackAccessesPass.h"
+#include "revng-c/PromoteStackPointer/PrepareStackSizeDetectionPass.h"
+#include "revng-c/PromoteStackPointer/RemoveStackAlignmentPass.h"
+#include "revng-c/Support/FunctionTags.h"
+
+using namespace llvm;
+
+// What used to run between instrument-stack-accesses and
+// compute-stack-accesses-bounds: instcombine folds the `x + -SP0` offsets,
+// so that LazyValueInfo can bound them
+static const char *const Simplifications[] = {
+  "instcombine",
+  "remove-extractvalues",
+};
+
+bool PrepareStackSizeDetectionPass::runOnModule(Module &M) {
+  // This only looks at the users of the calls to _init_local_sp
+  removeStackAlignment(M);
+
+  legacy::FunctionPassManager Simplify(&M);
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  for (const char *Name : Simplifications) {
+    const PassInfo *Info = Registry.getPassInfo(Name);
+    revng_check(Info != nullptr, "prepare-stack-size-detection: unknown pass");
+    Simplify.add(Info->createPass());
+  }
+  Simplify.doInitialization();
+
+  InstrumentStackAccesses Instrumenter(M);
+  for (Function &F : M) {
+    if (F.isDeclaration())
+      continue;
+
+    // Like the passes of the step used to, simplify all the functions, but
+    // only the isolated ones have their stack accesses instrumented
+    bool IsIsolated = FunctionTags::Isolated.isTagOf(&F);
+    bool HasMarkers = IsIsolated and not Instrumenter.run(F).empty();
+
+    Simplify.run(F);
+
+    if (not HasMarkers)
+      continue;
+
+    // instcombine might have replaced the markers, look for them again
+    SmallVector<CallInst *, 16> Markers;
+    for (Instruction &I : instructions(F))
+      if (auto *Call = dyn_cast<CallInst>(&I))
+        if (isCallToTagged(Call, FunctionTags::StackOffsetMarker))
+          Markers.push_back(Call);
+
+    LazyValueInfo &LVI = getAnalysis<LazyValueInfoWrapperPass>(F).getLVI();
+    for (CallInst *Call : Markers)
+      computeStackAccessBounds(LVI, Call);
+  }
+
+  Simplify.doFinalization();
+
+  return true;
+}
+
+void PrepareStackSizeDetectionPass::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<LazyValueInfoWrapperPass>();
+}
+
+char PrepareStackSizeDetectionPass::ID = 0;
+
+using RegisterPSSD = RegisterPass<PrepareStackSizeDetectionPass>;
+static RegisterPSSD R("prepare-stack-size-detection",
+                      "Prepare the functions for the stack size detection");
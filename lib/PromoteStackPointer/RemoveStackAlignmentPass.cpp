@@ -25,7 +25,7 @@ static bool isMask(Value *V, unsigned MaxMaskedBits) {
   return false;
 }
 
-bool RemoveStackAlignmentPass::runOnModule(Module &Module) {
+bool removeStackAlignment(Module &Module) {
   if (FunctionTags::Isolated.functions(&Module).empty())
     return false;
 
@@ -48,6 +48,10 @@ bool RemoveStackAlignmentPass::runOnModule(Module &Module) {
   return Result;
 }
 
+bool RemoveStackAlignmentPass::runOnModule(Module &Module) {
+  return removeStackAlignment(Module);
+}
+
 void RemoveStackAlignmentPass::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.setPreservesCFG();
 }
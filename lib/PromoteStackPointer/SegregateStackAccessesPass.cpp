@@ -2,19 +2,23 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <memory>
 #include <optional>
 #include <set>
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ThreadPool.h"
 
 #include "revng/ABI/FunctionType/Layout.h"
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
 #include "revng/EarlyFunctionAnalysis/FunctionMetadataCache.h"
 #include "revng/MFP/MFP.h"
-#include "revng/MFP/SetLattices.h"
 #include "revng/Model/IRHelpers.h"
 #include "revng/Model/LoadModelPass.h"
 #include "revng/Model/VerifyHelper.h"
@@ -36,6 +40,14 @@ using namespace llvm;
 
 static Logger<> Log("segregate-stack-accesses");
 
+static cl::opt<unsigned>
+  SegregateStackAccessesThreads("segregate-stack-accesses-threads",
+                                cl::desc("Number of threads analyzing the "
+                                         "stack usage of the isolated "
+                                         "functions in "
+                                         "segregate-stack-accesses"),
+                                cl::init(1));
+
 static Value *createAdd(IRBuilder<> &B, Value *V, uint64_t Addend) {
   return B.CreateAdd(V, ConstantInt::get(V->getType(), Addend));
 }
@@ -107,14 +119,6 @@ struct StoredByte {
   int64_t StackOffset = 0;
   llvm::StoreInst *Store = nullptr;
   unsigned StoreOffset = 0;
-
-  bool operator<(const StoredByte &Other) const {
-    auto ThisTuple = std::tie(StackOffset, Store, StoreOffset);
-    auto OtherTuple = std::tie(Other.StackOffset,
-                               Other.Store,
-                               Other.StoreOffset);
-    return ThisTuple < OtherTuple;
-  }
 };
 
 class StackAccessRedirector {
@@ -194,57 +198,175 @@ public:
   void dump() const debug_function { dump(dbg); }
 };
 
-using Lattice = std::set<StoredByte>;
+/// Numbering of all the bytes written on the stack by the stores of a
+/// function, along with the stack accesses of each basic block.
+///
+/// Each byte of each store gets a bit, the bytes of the same store being
+/// contiguous. This way the set of stored bytes reaching a program point is a
+/// BitVector and the transfer function doesn't need to look at the IR again.
+class StoredBytesIndex {
+public:
+  /// A clobbering call or a load/store at a known stack offset
+  struct Event {
+    bool IsCall = false;
+    int64_t StackOffset = 0;
+    unsigned Size = 0;
+    /// Bit of the first byte of the store, if this is a store
+    std::optional<unsigned> FirstBit;
+  };
 
-struct SegregateStackAccessesMFI : public SetUnionLattice<Lattice> {
-  using Label = llvm::BasicBlock *;
-  using GraphType = llvm::Function *;
+private:
+  std::vector<StoredByte> Bytes;
+  DenseMap<int64_t, SmallVector<unsigned, 2>> BitsAtOffset;
+  DenseMap<const BasicBlock *, SmallVector<Event, 4>> Events;
 
-  static LatticeElement applyTransferFunction(llvm::BasicBlock *BB,
-                                              const LatticeElement &Value) {
-    using namespace llvm;
-    revng_log(Log, "Analyzing block " << getName(BB));
-    LoggerIndent<> Indent(Log);
+public:
+  StoredBytesIndex(Function &F) {
+    for (BasicBlock &BB : F) {
+      for (Instruction &I : BB) {
+        if (isCallToIsolatedFunction(&I)) {
+          Events[&BB].push_back({ .IsCall = true });
+          continue;
+        }
 
-    LatticeElement StackBytes = Value;
+        if (not isa<LoadInst>(&I) and not isa<StoreInst>(&I))
+          continue;
+
+        auto MaybeStackOffset = getStackOffset(&I);
+        if (not MaybeStackOffset)
+          continue;
+
+        Event NewEvent{ .StackOffset = *MaybeStackOffset,
+                        .Size = getMemoryAccessSize(&I) };
+        if (auto *Store = dyn_cast<StoreInst>(&I)) {
+          NewEvent.FirstBit = Bytes.size();
+          for (unsigned Byte = 0; Byte < NewEvent.Size; ++Byte) {
+            int64_t StackOffset = NewEvent.StackOffset + Byte;
+            BitsAtOffset[StackOffset].push_back(Bytes.size());
+            Bytes.push_back({ StackOffset, Store, Byte });
+          }
+        }
 
-    for (Instruction &I : *BB) {
-      if (isCallToIsolatedFunction(&I)) {
-        StackBytes.clear();
-        continue;
+        Events[&BB].push_back(NewEvent);
       }
+    }
+  }
 
-      // If it's not a load/store, pointer is nullptr
-      if (not isa<LoadInst>(&I) and not isa<StoreInst>(&I))
-        continue;
+public:
+  size_t size() const { return Bytes.size(); }
 
-      revng_log(Log, "Analyzing instruction " << getName(&I));
-      LoggerIndent<> Indent(Log);
+  const StoredByte &byte(unsigned Bit) const { return Bytes[Bit]; }
 
-      // Get stack offset, if available
-      auto MaybeStartStackOffset = getStackOffset(&I);
-      if (not MaybeStartStackOffset)
+  ArrayRef<Event> events(const BasicBlock *BB) const {
+    auto It = Events.find(BB);
+    if (It == Events.end())
+      return {};
+    return It->second;
+  }
+
+  /// Forget all the stored bytes in [StackOffset, StackOffset + Size)
+  void kill(BitVector &StackBytes, int64_t StackOffset, unsigned Size) const {
+    for (unsigned I = 0; I < Size; ++I) {
+      auto It = BitsAtOffset.find(StackOffset + I);
+      if (It == BitsAtOffset.end())
         continue;
 
-      int64_t StartStackOffset = *MaybeStartStackOffset;
-      unsigned AccessSize = getMemoryAccessSize(&I);
-      int64_t EndStackOffset = StartStackOffset + AccessSize;
+      for (unsigned Bit : It->second)
+        StackBytes.reset(Bit);
+    }
+  }
+};
+
+struct SegregateStackAccessesMFI {
+  using Label = llvm::BasicBlock *;
+  using GraphType = llvm::Function *;
+  using LatticeElement = BitVector;
+
+  const StoredBytesIndex &Index;
+
+  LatticeElement combineValues(const LatticeElement &LHS,
+                               const LatticeElement &RHS) const {
+    LatticeElement Result = LHS;
+    Result |= RHS;
+    return Result;
+  }
+
+  bool isLessOrEqual(const LatticeElement &LHS,
+                     const LatticeElement &RHS) const {
+    // BitVector::test checks whether LHS has some bit that RHS doesn't
+    return not LHS.test(RHS);
+  }
+
+  LatticeElement applyTransferFunction(llvm::BasicBlock *BB,
+                                       const LatticeElement &Value) const {
+    LatticeElement StackBytes = Value;
+    StackBytes.resize(Index.size());
+
+    for (const StoredBytesIndex::Event &Event : Index.events(BB)) {
+      if (Event.IsCall) {
+        StackBytes.reset();
+        continue;
+      }
 
       // Erase all the existing entries
-      // TODO: use lower_bound instead of scanning everything
-      StackBytes.erase(StackBytes.lower_bound(StoredByte{ StartStackOffset }),
-                       StackBytes.upper_bound(StoredByte{ EndStackOffset }));
+      Index.kill(StackBytes, Event.StackOffset, Event.Size);
 
       // If it's a store, record all of its bytes
-      if (auto *Store = dyn_cast<StoreInst>(&I))
-        for (unsigned I = 0; I < AccessSize; ++I)
-          StackBytes.insert({ StartStackOffset + I, Store, I });
+      if (Event.FirstBit)
+        StackBytes.set(*Event.FirstBit, *Event.FirstBit + Event.Size);
     }
 
     return StackBytes;
   }
 };
 
+/// The stored bytes reaching the end of each block of a function
+struct StackUsage {
+  StoredBytesIndex Index;
+  std::map<BasicBlock *, MFP::MFPResult<BitVector>> AnalysisResult;
+
+  StackUsage(Function &F) : Index(F) {
+    using SSAMFI = SegregateStackAccessesMFI;
+    BasicBlock *Entry = &F.getEntryBlock();
+    AnalysisResult = MFP::getMaximalFixedPoint<SSAMFI>({ Index },
+                                                       &F,
+                                                       {},
+                                                       {},
+                                                       { Entry });
+  }
+
+  const BitVector &storedBytesAt(BasicBlock *BB) const {
+    return AnalysisResult.at(BB).OutValue;
+  }
+};
+
+/// Compute the StackUsage of each function in \a Functions, in parallel if
+/// requested. nullptr entries get a nullptr.
+///
+/// The analysis only reads the IR, so it's safe to run it concurrently on
+/// different functions, as long as nobody is changing the module meanwhile.
+static std::vector<std::unique_ptr<StackUsage>>
+computeStackUsages(ArrayRef<Function *> Functions,
+                   std::optional<ThreadPool> &Pool) {
+  std::vector<std::unique_ptr<StackUsage>> Result(Functions.size());
+  const auto Compute = [](Function *F, std::unique_ptr<StackUsage> &Usage) {
+    if (F != nullptr)
+      Usage = std::make_unique<StackUsage>(*F);
+  };
+
+  if (not Pool.has_value()) {
+    for (const auto &[F, Usage] : llvm::zip(Functions, Result))
+      Compute(F, Usage);
+    return Result;
+  }
+
+  for (const auto &[F, Usage] : llvm::zip(Functions, Result))
+    Pool->async([&Compute, F = F, &Usage = Usage]() { Compute(F, Usage); });
+  Pool->wait();
+
+  return Result;
+}
+
 struct SortByFunction {
   bool operator()(const Instruction *LHS, const Instruction *RHS) const {
     using std::make_pair;
@@ -253,10 +375,6 @@ struct SortByFunction {
 };
 
 class SegregateStackAccesses {
-private:
-  using MFIResult = std::map<BasicBlock *,
-                             MFP::MFPResult<std::set<StoredByte>>>;
-
 private:
   const model::Binary &Binary;
   Module &M;
@@ -354,9 +472,38 @@ public:
     upgradeDynamicFunctions();
     upgradeLocalFunctions();
 
+    // The stack usage is only needed to handle call sites: leaf functions and
+    // declarations don't need to be analyzed
+    SmallVector<Function *, 8> Functions;
+    SmallVector<Function *, 8> ToAnalyze;
     for (Function *Old : IsolatedFunctions) {
-      auto *F = OldToNew.at(Old);
-      segregateStackAccesses(*Cache, *F);
+      Function *F = OldToNew.at(Old);
+      bool HasCallSites = splitAtCallSites(*F);
+      Functions.push_back(F);
+      ToAnalyze.push_back(HasCallSites ? F : nullptr);
+    }
+
+    // Analyze the stack usage of the functions in parallel, in batches, and
+    // then rewrite them one by one. Rewriting a function doesn't affect the
+    // analysis of the others, but it changes the module, so it can't overlap
+    // with the analysis.
+    std::optional<ThreadPool> Pool;
+    size_t BatchSize = 1;
+    if (SegregateStackAccessesThreads > 1 and not Log.isEnabled()) {
+      Pool.emplace(hardware_concurrency(SegregateStackAccessesThreads));
+      BatchSize = 8 * Pool->getThreadCount();
+    }
+
+    std::vector<std::unique_ptr<StackUsage>> Usages;
+    for (size_t I = 0; I < Functions.size(); ++I) {
+      if (I % BatchSize == 0) {
+        ArrayRef<Function *> Batch = ArrayRef<Function *>(ToAnalyze).slice(I);
+        Usages = computeStackUsages(Batch.take_front(BatchSize), Pool);
+      }
+
+      Function *F = Functions[I];
+      if (not F->isDeclaration())
+        segregateStackAccesses(*Cache, *F, Usages[I % BatchSize].get());
       FunctionTags::StackAccessesSegregated.addTo(F);
     }
 
@@ -800,10 +947,32 @@ private:
     }
   }
 
-  void segregateStackAccesses(FunctionMetadataCache &Cache, Function &F) {
-    if (F.isDeclaration())
-      return;
+  /// Split basic blocks at call sites, in preparation of the analysis
+  ///
+  /// \return true if \a F has stack size probes at call sites to handle.
+  bool splitAtCallSites(Function &F) {
+    bool HasCallSites = false;
+    std::set<Instruction *> SplitPoints;
+    for (BasicBlock &BB : F) {
+      for (Instruction &I : BB) {
+        if (isCallToIsolatedFunction(&I))
+          SplitPoints.insert(&I);
+        else if (getCallTo(&I, SSACS) != nullptr)
+          HasCallSites = true;
+      }
+    }
 
+    for (Instruction *I : SplitPoints)
+      I->getParent()->splitBasicBlock(I);
+
+    return HasCallSites;
+  }
+
+  /// \param Usage the stack usage of \a F, nullptr if \a F has no call sites.
+  void segregateStackAccesses(FunctionMetadataCache &Cache,
+                              Function &F,
+                              const StackUsage *Usage) {
+    revng_assert(not F.isDeclaration());
     revng_assert(InitLocalSP != nullptr);
 
     setInsertPointToFirstNonAlloca(SABuilder, F);
@@ -822,41 +991,13 @@ private:
       Redirector = &It->second;
 
     //
-    // Analyze stack usage
+    // Handle a call to an isolated function
     //
-
-    // Analysis preparation: split basic blocks at call sites
-    {
-      std::set<Instruction *> SplitPoints;
+    if (Usage != nullptr)
       for (BasicBlock &BB : F)
         for (Instruction &I : BB)
-          if (isCallToIsolatedFunction(&I))
-            SplitPoints.insert(&I);
-      for (Instruction *I : SplitPoints)
-        I->getParent()->splitBasicBlock(I);
-    }
-
-    // Run the analysis
-    MFIResult AnalysisResult;
-    {
-      revng_log(Log, "Running SegregateStackAccessesMFI");
-      LoggerIndent<> Indent(Log);
-      using SSAMFI = SegregateStackAccessesMFI;
-      BasicBlock *Entry = &F.getEntryBlock();
-      AnalysisResult = MFP::getMaximalFixedPoint<SSAMFI>({},
-                                                         &F,
-                                                         {},
-                                                         {},
-                                                         { Entry });
-    }
-
-    //
-    // Handle a call to an isolated function
-    //
-    for (BasicBlock &BB : F)
-      for (Instruction &I : BB)
-        if (CallInst *SSACSCall = getCallTo(&I, SSACS))
-          handleCallSite(Cache, ModelFunction, AnalysisResult, SSACSCall);
+          if (CallInst *SSACSCall = getCallTo(&I, SSACS))
+            handleCallSite(Cache, ModelFunction, *Usage, SSACSCall);
 
     //
     // Handle memory access, possibly targeting stack arguments
@@ -892,7 +1033,7 @@ private:
 
   void handleCallSite(FunctionMetadataCache &Cache,
                       const model::Function &ModelFunction,
-                      MFIResult &AnalysisResult,
+                      const StackUsage &Usage,
                       CallInst *SSACSCall) {
     LoggerIndent<> Indent(Log);
 
@@ -957,7 +1098,7 @@ private:
       if (HasSPTAR) {
         // Inject the SPTAR in LLVMArgumentTypes
         revng_assert(Layout.Arguments.size() > 0);
-        uint64_t SPTARSize = *Layout.Arguments[0].Type.size();
+        uint64_t SPTARSize = *Layout.Arguments[0].Type.size(VH);
         LLVMArgumentTypes.push_back(B.getIntNTy(SPTARSize * 8));
       }
     }
@@ -968,7 +1109,7 @@ private:
     for (auto [LLVMType, ModelArgument] :
          llvm::zip(LLVMArgumentTypes, Layout.Arguments)) {
       model::QualifiedType ArgumentType = ModelArgument.Type;
-      uint64_t NewSize = *ArgumentType.size();
+      uint64_t NewSize = *ArgumentType.size(VH);
 
       switch (ModelArgument.Kind) {
 
@@ -1298,9 +1439,8 @@ private:
     };
     std::map<StoreInst *, StoreInfo> Stores;
     BasicBlock *BB = SSACSCall->getParent();
-    const std::set<StoredByte> &BlockFinalResult = AnalysisResult.at(BB)
-                                                     .OutValue;
-    for (const StoredByte &Byte : BlockFinalResult) {
+    for (unsigned Bit : Usage.storedBytesAt(BB).set_bits()) {
+      const StoredByte &Byte = Usage.Index.byte(Bit);
       StoreInfo &Info = Stores[Byte.Store];
       Info.Count += 1;
       Info.Offset = Byte.StackOffset - Byte.StoreOffset;
@@ -1453,7 +1593,7 @@ private:
 
   llvm::FunctionType &
   layoutToLLVMFunctionType(const abi::FunctionType::Layout &Layout,
-                           Type *OldReturnType) const {
+                           Type *OldReturnType) {
     // Process arguments
     using namespace abi::FunctionType;
     SmallVector<Type *> FunctionArguments;
@@ -1498,7 +1638,7 @@ private:
       // CABIFunctionType returning stuff through registers
       unsigned Bits = 0;
       for (const Layout::ReturnValue &ReturnValue : Layout.ReturnValues)
-        Bits += ReturnValue.Type.size().value() * 8;
+        Bits += ReturnValue.Type.size(VH).value() * 8;
       ReturnType = IntegerType::getIntNTy(OldReturnType->getContext(), Bits);
     } break;
 
@@ -6,8 +6,6 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/Transforms/Utils/Local.h"
 
-#include "revng/Support/OpaqueFunctionsPool.h"
-
 #include "revng-c/RemoveExtractValues/RemoveExtractValuesPass.h"
 #include "revng-c/Support/FunctionTags.h"
 
@@ -25,6 +23,17 @@ void RemoveExtractValues::getAnalysisUsage(llvm::AnalysisUsage &AU) const {
   AU.setPreservesAll();
 }
 
+bool RemoveExtractValues::doInitialization(llvm::Module &) {
+  // Don't trust anything left by a run that did not reach doFinalization
+  OpaqueEVPool.clear();
+  return false;
+}
+
+bool RemoveExtractValues::doFinalization(llvm::Module &) {
+  OpaqueEVPool.clear();
+  return false;
+}
+
 bool RemoveExtractValues::runOnFunction(llvm::Function &F) {
   using namespace llvm;
 
@@ -35,14 +44,14 @@ bool RemoveExtractValues::runOnFunction(llvm::Function &F) {
       if (auto *ExtractVal = llvm::dyn_cast<llvm::ExtractValueInst>(&I))
         ToReplace.push_back(ExtractVal);
 
+  // Most functions have no ExtractValues left after the first run of the pass,
+  // bail out before touching the pool
   if (ToReplace.empty())
     return false;
 
-  // Create a pool of functions with the same behavior: we will need a different
-  // function for each different struct
-  OpaqueFunctionsPool<TypePair> OpaqueEVPool(F.getParent(),
-                                             /* PurgeOnDestruction */ false);
-  initOpaqueEVPool(OpaqueEVPool, F.getParent());
+  // OpaqueEVPool holds a pool of functions with the same behavior: we will need
+  // a different function for each different struct
+  Module *M = F.getParent();
 
   llvm::LLVMContext &LLVMCtx = F.getContext();
   IRBuilder<> Builder(LLVMCtx);
@@ -60,7 +69,8 @@ bool RemoveExtractValues::runOnFunction(llvm::Function &F) {
     // Get or generate the function
     auto *EVFunctionType = getOpaqueEVFunctionType(I);
     const TypePair &Key = { I->getType(), I->getAggregateOperand()->getType() };
-    auto *ExtractValueFunction = OpaqueEVPool.get(Key,
+    auto *ExtractValueFunction = OpaqueEVPool.get(M,
+                                                  Key,
                                                   EVFunctionType,
                                                   "OpaqueExtractvalue");
 
@@ -2,9 +2,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <functional>
+#include <iterator>
 #include <optional>
+#include <vector>
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/InstIterator.h"
@@ -34,58 +40,133 @@ void MakeSegmentRefPass::getAnalysisUsage(llvm::AnalysisUsage &AU) const {
   AU.addRequired<LoadModelWrapperPass>();
 }
 
-static std::optional<std::pair<MetaAddress, uint64_t>>
-findLiteralInSegments(const model::Binary &Binary, uint64_t Literal) {
-  std::optional<std::pair<MetaAddress, uint64_t>> Result = std::nullopt;
-  auto Arch = toLLVMArchitecture(Binary.Architecture());
+namespace {
+
+/// The segments of the binary, sorted by start address, so that the one
+/// containing a given literal can be found with a binary search
+class SegmentIndex {
+private:
+  struct Entry {
+    uint64_t Start;
+    uint64_t End;
+    MetaAddress StartAddress;
+    uint64_t VirtualSize;
+  };
+
+  std::vector<Entry> Entries;
+
+  /// For each entry, the largest End of the entries preceding it. Only larger
+  /// than the Start of the entry if it overlaps with one of them.
+  std::vector<uint64_t> MaxEndBefore;
+
+public:
+  SegmentIndex(const model::Binary &Binary) {
+    Entries.reserve(Binary.Segments().size());
+    for (const model::Segment &Segment : Binary.Segments()) {
+      uint64_t Start = Segment.StartAddress().address();
+      Entries.push_back({ Start,
+                          Start + Segment.VirtualSize(),
+                          Segment.StartAddress(),
+                          Segment.VirtualSize() });
+    }
+
+    llvm::sort(Entries, [](const Entry &LHS, const Entry &RHS) {
+      return LHS.Start < RHS.Start;
+    });
 
-  for (const auto &Segment : Binary.Segments()) {
-    if (Segment.contains(MetaAddress::fromGeneric(Arch, Literal))) {
-      revng_assert(not Result.has_value());
-      Result = { { Segment.StartAddress(), Segment.VirtualSize() } };
+    MaxEndBefore.reserve(Entries.size());
+    uint64_t MaxEnd = 0;
+    for (const Entry &E : Entries) {
+      MaxEndBefore.push_back(MaxEnd);
+      MaxEnd = std::max(MaxEnd, E.End);
     }
   }
 
-  return Result;
-}
+public:
+  std::optional<std::pair<MetaAddress, uint64_t>>
+  find(uint64_t Literal) const {
+    auto StartsAfter = [](uint64_t L, const Entry &E) { return L < E.Start; };
+    auto It = llvm::upper_bound(Entries, Literal, StartsAfter);
+    if (It == Entries.begin())
+      return std::nullopt;
+
+    // Look for the last segment starting before Literal that contains it.
+    // Segments can overlap, in which case it might not be the last one
+    // starting before Literal.
+    size_t Index = std::prev(It) - Entries.begin();
+    while (Literal >= Entries[Index].End) {
+      if (MaxEndBefore[Index] <= Literal)
+        return std::nullopt;
+      --Index;
+    }
 
-static std::optional<llvm::StringRef>
-getStringLiteral(RawBinaryView &BinaryView,
-                 MetaAddress SegmentAddress,
-                 uint64_t SegmentVirtualSize,
-                 uint64_t StringOffsetInSegment) {
-  // If the segment is not read only it's not a string literal
-  const bool IsReadOnly = BinaryView.isReadOnly(SegmentAddress,
-                                                SegmentVirtualSize);
-  if (not IsReadOnly)
-    return std::nullopt;
+    // Each literal must belong to at most one segment
+    revng_assert(MaxEndBefore[Index] <= Literal);
 
-  MetaAddress StringAddress = SegmentAddress + StringOffsetInSegment;
-  uint64_t SegmentSizeFromString = SegmentVirtualSize - StringOffsetInSegment;
+    const Entry &Result = Entries[Index];
+    return { { Result.StartAddress, Result.VirtualSize } };
+  }
+};
+
+} // namespace
+
+namespace {
+
+/// Where string literals start in a read-only segment, i.e. runs of printable
+/// characters followed by a NUL terminator
+class StringLiteralMap {
+private:
+  llvm::StringRef Data;
+  llvm::BitVector Starts;
+
+public:
+  /// Find all the string literals in \p Data with a single backward scan: a
+  /// string literal starts at a printable character if a string literal starts
+  /// right after it, or at a NUL terminator, in which case it's empty
+  StringLiteralMap(llvm::StringRef Data) : Data(Data), Starts(Data.size()) {
+    bool NextIsStart = false;
+    for (size_t I = Data.size(); I > 0; --I) {
+      char C = Data[I - 1];
+      if (C == '\0')
+        NextIsStart = true;
+      else if (not llvm::isPrint(C) and not llvm::isSpace(C))
+        NextIsStart = false;
+
+      if (NextIsStart)
+        Starts.set(I - 1);
+    }
+  }
 
-  // If it's not there, it's not a string literal
-  auto DataOrNone = BinaryView.getStringByAddress(StringAddress,
-                                                  SegmentSizeFromString);
-  if (not DataOrNone.has_value())
-    return std::nullopt;
+public:
+  std::optional<llvm::StringRef> get(uint64_t Offset) const {
+    if (Offset >= Starts.size() or not Starts.test(Offset))
+      return std::nullopt;
 
-  llvm::StringRef StringView = DataOrNone.value();
+    llvm::StringRef String = Data.drop_front(Offset);
+    return String.take_front(String.find('\0'));
+  }
+};
 
-  // If it doesn't end with \0 it's not a string literal
-  auto NullTerminatorPos = StringView.find('\0');
-  if (NullTerminatorPos == llvm::StringLiteral::npos)
-    return std::nullopt;
+} // namespace
 
-  StringView = StringView.take_front(NullTerminatorPos);
+/// Build the StringLiteralMap of a segment, if it's read-only and its content
+/// is available
+static std::optional<StringLiteralMap>
+mapStringLiterals(RawBinaryView &BinaryView,
+                  MetaAddress SegmentAddress,
+                  uint64_t SegmentVirtualSize) {
+  // If the segment is not read only it has no string literals
+  const bool IsReadOnly = BinaryView.isReadOnly(SegmentAddress,
+                                                SegmentVirtualSize);
+  if (not IsReadOnly)
+    return std::nullopt;
 
-  // If some of the characters are not printable, is not a string literal
-  const auto IsPrintableInCString = [](const char C) {
-    return not llvm::isPrint(C) and not llvm::isSpace(C);
-  };
-  if (llvm::any_of(StringView, IsPrintableInCString))
+  auto DataOrNone = BinaryView.getStringByAddress(SegmentAddress,
+                                                  SegmentVirtualSize);
+  if (not DataOrNone.has_value())
     return std::nullopt;
 
-  return StringView;
+  return StringLiteralMap(*DataOrNone);
 }
 
 bool MakeSegmentRefPass::runOnModule(Module &M) {
@@ -105,6 +186,12 @@ bool MakeSegmentRefPass::runOnModule(Module &M) {
 
   RawBinaryView &BinaryView = getAnalysis<LoadBinaryWrapperPass>().get();
 
+  SegmentIndex Segments(*Model);
+
+  // Look for string literals in each segment only once, and only in those
+  // that are actually referenced
+  llvm::DenseMap<uint64_t, std::optional<StringLiteralMap>> StringLiterals;
+
   bool Changed = false;
   IRBuilder<> IRB(Context);
   llvm::Type *PtrSizedInteger = getPointerSizedInteger(Context, *Model);
@@ -130,8 +217,7 @@ bool MakeSegmentRefPass::runOnModule(Module &M) {
         if (ConstOp != nullptr and ConstOp->getBitWidth() == PointerSize) {
           uint64_t ConstantAddress = ConstOp->getZExtValue();
 
-          if (auto Segment = findLiteralInSegments(*Model, ConstantAddress);
-              Segment) {
+          if (auto Segment = Segments.find(ConstantAddress); Segment) {
             const auto &[StartAddress, VirtualSize] = *Segment;
             auto OffsetInSegment = ConstantAddress - StartAddress.address();
 
@@ -151,10 +237,16 @@ bool MakeSegmentRefPass::runOnModule(Module &M) {
             // Check if the Op is large as a pointer. If it isn't it can't be a
             // string literal.
             // See if we can find a string literal there.
-            auto OptString = getStringLiteral(BinaryView,
-                                              StartAddress,
-                                              VirtualSize,
-                                              OffsetInSegment);
+            auto [It, IsNew] = StringLiterals.try_emplace(StartAddress
+                                                            .address());
+            if (IsNew)
+              It->second = mapStringLiterals(BinaryView,
+                                             StartAddress,
+                                             VirtualSize);
+
+            std::optional<llvm::StringRef> OptString;
+            if (It->second.has_value())
+              OptString = It->second->get(OffsetInSegment);
 
             if (not UseIsComparison and OptString.has_value()) {
               auto Str = OptString.value();
@@ -5,6 +5,7 @@
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/Attributes.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Module.h"
 
 #include "revng/Model/LoadModelPass.h"
@@ -15,47 +16,42 @@
 #include "revng-c/Support/FunctionTags.h"
 #include "revng-c/Support/IRHelpers.h"
 
+#include "PromoteInitCSVToUndef.h"
+
 using namespace llvm;
 
+bool isUndefinableCSVInitialization(const CallInst *Call) {
+  const Function *Callee = Call->getCalledFunction();
+  const char *MDName = "revng.abi_register";
+  if (not Callee or not FunctionTags::OpaqueCSVValue.isTagOf(Callee)
+      or not Callee->hasMetadata(MDName))
+    return false;
+
+  using namespace model;
+  QuickMetadata QMD(Callee->getContext());
+  auto *Tuple = cast<MDTuple>(Callee->getMetadata(MDName));
+  auto RegisterName = QMD.extract<StringRef>(Tuple, 0);
+  auto Register = Register::fromName(RegisterName);
+  revng_check(Register != Register::Invalid);
+
+  auto Architecture = Register::getReferenceArchitecture(Register);
+  return Register != Architecture::getReturnAddressRegister(Architecture);
+}
+
 static bool
 undefPreservedRegistersInitialization(Function &F,
                                       const model::Function &ModelFunction,
                                       const model::Binary &Binary) {
   bool Changed = false;
-  QuickMetadata QMD(F.getParent()->getContext());
-
-  for (auto &BB : F) {
-    auto It = BB.begin();
-    auto End = BB.end();
-    while (It != End) {
-      auto Next = std::next(It);
-
-      if (auto *Call = dyn_cast<CallInst>(&*It)) {
-        auto *Callee = Call->getCalledFunction();
-
-        const char *MDName = "revng.abi_register";
-
-        if (Callee and FunctionTags::OpaqueCSVValue.isTagOf(Callee)
-            and Callee->hasMetadata(MDName)) {
-          using namespace model;
-          auto *Tuple = cast<MDTuple>(Callee->getMetadata(MDName));
-          auto RegisterName = QMD.extract<StringRef>(Tuple, 0);
-          auto Register = Register::fromName(RegisterName);
-          revng_check(Register != Register::Invalid);
-
-          auto Architecture = Register::getReferenceArchitecture(Register);
-
-          using namespace Architecture;
-          if (Register != getReturnAddressRegister(Architecture)) {
-            Call->replaceAllUsesWith(llvm::UndefValue::get(Call->getType()));
-            Call->eraseFromParent();
-            Changed = true;
-          }
-        }
-      }
-
-      It = Next;
-    }
+
+  for (Instruction &I : llvm::make_early_inc_range(instructions(F))) {
+    auto *Call = dyn_cast<CallInst>(&I);
+    if (Call == nullptr or not isUndefinableCSVInitialization(Call))
+      continue;
+
+    Call->replaceAllUsesWith(llvm::UndefValue::get(Call->getType()));
+    Call->eraseFromParent();
+    Changed = true;
   }
 
   return Changed;
@@ -0,0 +1,13 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+namespace llvm {
+class CallInst;
+} // namespace llvm
+
+/// Return true if \p Call reads the initial value of a CSV of a register that
+/// is not the return address, which can be replaced by undef.
+bool isUndefinableCSVInitialization(const llvm::CallInst *Call);
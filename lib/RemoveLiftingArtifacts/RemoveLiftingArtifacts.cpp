@@ -5,8 +5,11 @@
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/Attributes.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Transforms/Utils/Local.h"
 
 #include "revng/Model/LoadModelPass.h"
 #include "revng/Pipeline/RegisterLLVMPass.h"
@@ -16,130 +19,118 @@
 #include "revng-c/Support/FunctionTags.h"
 #include "revng-c/Support/IRHelpers.h"
 
-using namespace llvm;
-
-static bool removeCallsToArtifacts(Function &F) {
-  // Remove calls to `newpc` in the current function.
-  SmallVector<Instruction *, 8> ToErase;
-  for (BasicBlock &BB : F) {
-    for (Instruction &I : BB) {
-      if (auto *C = dyn_cast<CallInst>(&I))
-        if (auto *Callee = getCallee(C)) {
-          // Remove calls to newpc and Exceptional functions
-          // TODO: we also remove calls to set_PlainMetaAddress since emitting C
-          //       structs is currently unsupported by the backend. We should
-          //       eventually find a better solution.
-          if (Callee->getName() == "newpc"
-              or Callee->getName() == "set_PlainMetaAddress"
-              or FunctionTags::Exceptional.isTagOf(Callee)) {
-            ToErase.push_back(C);
-          }
-        }
+#include "PromoteInitCSVToUndef.h"
 
-      // Remove LLVM debug intrisics
-      if (auto *Dbg = dyn_cast<DbgInfoIntrinsic>(&I))
-        ToErase.push_back(Dbg);
-    }
-  }
+using namespace llvm;
 
-  bool Changed = not ToErase.empty();
-  for (Instruction *I : ToErase)
-    eraseFromParent(I);
+static bool isArtifactCall(const CallInst *C) {
+  auto *Callee = getCallee(C);
+  if (Callee == nullptr)
+    return false;
 
-  return Changed;
+  // Remove calls to newpc and Exceptional functions
+  // TODO: we also remove calls to set_PlainMetaAddress since emitting C
+  //       structs is currently unsupported by the backend. We should
+  //       eventually find a better solution.
+  return Callee->getName() == "newpc"
+         or Callee->getName() == "set_PlainMetaAddress"
+         or FunctionTags::Exceptional.isTagOf(Callee);
 }
 
-static bool removeStoresToCPULoopExiting(Function &F) {
-  // Retrieve the global variable `cpu_loop_exiting`
-  Module *M = F.getParent();
-  GlobalVariable *CpuLoop = M->getGlobalVariable("cpu_loop_exiting");
+/// removeLiftingArtifacts only knows how to rewrite loads and stores of
+/// `cpu_loop_exiting` in isolated functions
+static void checkCPULoopExitingUses(Module &M) {
+  GlobalVariable *CpuLoop = M.getGlobalVariable("cpu_loop_exiting");
+  if (CpuLoop == nullptr)
+    return;
 
-  // Remove in bulk all the users of the global variable.
-  SmallVector<LoadInst *, 8> Loads;
-  SmallVector<StoreInst *, 8> Stores;
   for (User *U : CpuLoop->users()) {
-    Instruction *I = cast<Instruction>(U);
-
-    // Check only translated functions.
-    if (I->getParent()->getParent() != &F)
+    auto *I = cast<Instruction>(U);
+    if (not FunctionTags::Isolated.isTagOf(I->getFunction()))
       continue;
 
-    if (auto *Store = dyn_cast<StoreInst>(U))
-      Stores.push_back(Store);
-    else if (auto *Load = dyn_cast<LoadInst>(U))
-      Loads.push_back(Load);
-    else
+    auto *Store = dyn_cast<StoreInst>(I);
+    bool IsStoreTo = Store != nullptr
+                     and Store->getPointerOperand() == CpuLoop;
+    if (not isa<LoadInst>(I) and not IsStoreTo)
       revng_abort("Unexpected use of cpu_loop_exiting");
   }
-
-  bool Changed = not Loads.empty() or not Stores.empty();
-
-  // Remove in bulk all the store found before.
-  for (Instruction *I : Stores)
-    eraseFromParent(I);
-
-  for (LoadInst *L : Loads) {
-    // Replace all uses of loads with "false"
-    L->replaceAllUsesWith(Constant::getNullValue(L->getType()));
-    eraseFromParent(L);
-  }
-
-  return Changed;
 }
 
-static bool makeEnvNull(Function &F) {
-
+/// Remove all the lifting artifacts from \p F in a single walk over its
+/// instructions:
+///
+/// * calls to newpc, to Exceptional functions and to debug intrinsics are
+///   erased;
+/// * stores to `cpu_loop_exiting` are erased, loads from it become false;
+/// * loads from `env` become null;
+/// * reads of the initial value of CSVs become undef, except for the
+///   return address (see promote-init-csv-to-undef);
+///
+/// and then erase all the instructions that were, or became, trivially dead.
+static bool removeLiftingArtifacts(Function &F) {
   Module *M = F.getParent();
+  GlobalVariable *CpuLoop = M->getGlobalVariable("cpu_loop_exiting");
   GlobalVariable *Env = M->getGlobalVariable("env",
                                              /* AllowInternal */ true);
 
-  if (Env == nullptr)
-    return false;
-
-  SmallPtrSet<LoadInst *, 8> LoadsFromEnvInF;
-  for (Use &EnvUse : Env->uses()) {
-
-    if (auto *I = dyn_cast<Instruction>(EnvUse.getUser())) {
-
-      if (I->getFunction() != &F)
+  bool Changed = false;
+  SmallVector<WeakTrackingVH, 32> MaybeDead;
+
+  // The operands of the erased instructions might have no other user
+  auto Erase = [&](Instruction &I) {
+    for (Use &Operand : I.operands())
+      if (auto *OperandInstruction = dyn_cast<Instruction>(Operand.get()))
+        MaybeDead.push_back(OperandInstruction);
+    eraseFromParent(&I);
+    Changed = true;
+  };
+
+  auto Replace = [&](Instruction &I, Value *With) {
+    I.replaceAllUsesWith(With);
+    Erase(I);
+  };
+
+  for (Instruction &I : llvm::make_early_inc_range(instructions(F))) {
+    if (auto *Load = dyn_cast<LoadInst>(&I)) {
+      Value *Pointer = Load->getPointerOperand();
+      if (Pointer == CpuLoop) {
+        Replace(I, Constant::getNullValue(I.getType()));
         continue;
+      }
 
-      // At this point, all uses of env in a function should be loads
-      LoadsFromEnvInF.insert(cast<LoadInst>(I));
-
-    } else if (auto *CE = dyn_cast<ConstantExpr>(EnvUse.getUser())) {
-
-      if (not CE->isCast())
+      // env is also loaded through casts of its address
+      if (Env != nullptr and Pointer->stripPointerCasts() == Env) {
+        Replace(I, Constant::getNullValue(I.getType()));
         continue;
+      }
+    } else if (auto *Store = dyn_cast<StoreInst>(&I)) {
+      if (Store->getPointerOperand() == CpuLoop) {
+        Erase(I);
+        continue;
+      }
+    } else if (isa<DbgInfoIntrinsic>(&I)) {
+      Erase(I);
+      continue;
+    } else if (auto *Call = dyn_cast<CallInst>(&I)) {
+      if (isArtifactCall(Call)) {
+        Erase(I);
+        continue;
+      }
 
-      for (Use &CEUse : CE->uses()) {
-        if (auto *I = dyn_cast<Instruction>(CEUse.getUser())) {
-
-          if (I->getFunction() != &F)
-            continue;
-
-          // At this point, all uses of env in a function should be loads
-          LoadsFromEnvInF.insert(cast<LoadInst>(I));
-        }
+      if (isUndefinableCSVInitialization(Call)) {
+        Replace(I, UndefValue::get(I.getType()));
+        continue;
       }
     }
-  }
 
-  bool Changed = not LoadsFromEnvInF.empty();
-
-  for (LoadInst *L : LoadsFromEnvInF) {
-    Type *LoadType = L->getType();
-    auto *Null = Constant::getNullValue(LoadType);
-    L->replaceAllUsesWith(Null);
+    if (isInstructionTriviallyDead(&I))
+      MaybeDead.push_back(&I);
   }
 
-  return Changed;
-}
+  if (RecursivelyDeleteTriviallyDeadInstructionsPermissive(MaybeDead))
+    Changed = true;
 
-static bool removeLiftingArtifacts(Function &F) {
-  bool Changed = removeCallsToArtifacts(F);
-  Changed |= removeStoresToCPULoopExiting(F);
-  Changed |= makeEnvNull(F);
   return Changed;
 }
 
@@ -150,6 +141,8 @@ public:
   RemoveLiftingArtifacts() : ModulePass(ID) {}
 
   bool runOnModule(Module &M) override {
+    checkCPULoopExitingUses(M);
+
     bool Changed = false;
     for (Function &F : M) {
       if (FunctionTags::Isolated.isTagOf(&F)) {
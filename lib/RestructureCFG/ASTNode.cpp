@@ -13,6 +13,8 @@
 
 #include "revng-c/RestructureCFG/ASTNode.h"
 
+#include "GHASTNodePool.h"
+
 using namespace llvm;
 
 void IfNode::updateCondExprPtr(ExprNodeMap &Map) {
@@ -180,6 +182,68 @@ bool SequenceNode::nodeIsEqual(const ASTNode *Node) const {
   return true;
 }
 
+// #### Structural hashes ####
+
+llvm::hash_code ASTStructuralHashes::get(const ASTNode *Node) {
+  revng_assert(Node != nullptr);
+
+  if (auto It = Hashes.find(Node); It != Hashes.end())
+    return It->second;
+
+  llvm::hash_code Result = llvm::hash_value(Node->getKind());
+  switch (Node->getKind()) {
+  case ASTNode::NK_Code:
+  case ASTNode::NK_If: {
+    Result = llvm::hash_combine(Result, Node->getOriginalBB());
+  } break;
+
+  case ASTNode::NK_Break:
+  case ASTNode::NK_Continue:
+  case ASTNode::NK_SwitchBreak: {
+    // All the nodes of these kinds are equal to each other
+  } break;
+
+  case ASTNode::NK_Scs: {
+    auto *Scs = llvm::cast<ScsNode>(Node);
+    if (Scs->hasBody())
+      Result = llvm::hash_combine(Result, get(Scs->getBody()));
+  } break;
+
+  case ASTNode::NK_Set: {
+    auto *Set = llvm::cast<SetNode>(Node);
+    Result = llvm::hash_combine(Result, Set->getStateVariableValue());
+  } break;
+
+  case ASTNode::NK_List: {
+    auto *Sequence = llvm::cast<SequenceNode>(Node);
+    Result = llvm::hash_combine(Result, Sequence->length());
+    for (SequenceNode::links_container::size_type I = 0;
+         I < Sequence->length();
+         ++I)
+      Result = llvm::hash_combine(Result, get(Sequence->getNodeN(I)));
+  } break;
+
+  case ASTNode::NK_Switch: {
+    auto *Switch = llvm::cast<SwitchNode>(Node);
+    Result = llvm::hash_combine(Result, Switch->getOriginalBB());
+    for (const auto &[Labels, Case] : Switch->cases_const_range()) {
+      // Labels are compared as sets, so combine them in an order-independent
+      // way.
+      uint64_t LabelsHash = 0;
+      for (uint64_t Label : Labels)
+        LabelsHash += llvm::hash_value(Label);
+      Result = llvm::hash_combine(Result, LabelsHash, get(Case));
+    }
+  } break;
+
+  default:
+    revng_abort("AST node type not expected");
+  }
+
+  Hashes[Node] = Result;
+  return Result;
+}
+
 // #### Dump methods ####
 
 void CodeNode::dump(llvm::raw_fd_ostream &ASTFile) {
@@ -444,6 +508,14 @@ void ASTNode::dumpSuccessor(llvm::raw_fd_ostream &ASTFile) {
   }
 }
 
+void *ASTNode::operator new(size_t Size) {
+  return GHASTNodePool::allocate(Size);
+}
+
+void ASTNode::operator delete(void *Pointer, size_t Size) {
+  GHASTNodePool::deallocate(Pointer, Size);
+}
+
 void ASTNode::deleteASTNode(ASTNode *A) {
   switch (A->getKind()) {
   case NodeKind::NK_Code:
@@ -12,72 +12,20 @@
 #include "revng-c/RestructureCFG/ASTNodeUtils.h"
 #include "revng-c/RestructureCFG/ASTTree.h"
 
-/// Visit the node and all its children recursively, checking if a loop
-/// variable is needed.
-static RecursiveCoroutine<bool> needsLoopVarImpl(const ASTNode *N) {
-  if (N == nullptr)
-    rc_return false;
-
-  auto Kind = N->getKind();
-  switch (Kind) {
-
-  case ASTNode::NodeKind::NK_Break:
-  case ASTNode::NodeKind::NK_SwitchBreak:
-  case ASTNode::NodeKind::NK_Continue:
-  case ASTNode::NodeKind::NK_Code:
-    rc_return false;
-    break;
-
-  case ASTNode::NodeKind::NK_If: {
-    const IfNode *If = llvm::cast<IfNode>(N);
-
-    if (nullptr != If->getThen())
-      if (rc_recur needsLoopVarImpl(If->getThen()))
-        rc_return true;
-
-    if (If->hasElse())
-      if (rc_recur needsLoopVarImpl(If->getElse()))
-        rc_return true;
-
-    rc_return false;
-  } break;
-
-  case ASTNode::NodeKind::NK_Scs: {
-    const ScsNode *LoopBody = llvm::cast<ScsNode>(N);
-    rc_return rc_recur needsLoopVarImpl(LoopBody->getBody());
-  } break;
-
-  case ASTNode::NodeKind::NK_List: {
-    const SequenceNode *Seq = llvm::cast<SequenceNode>(N);
-    for (ASTNode *Child : Seq->nodes())
-      if (rc_recur needsLoopVarImpl(Child))
-        rc_return true;
+#include "GHASTVisit.h"
 
-    rc_return false;
-  } break;
-
-  case ASTNode::NodeKind::NK_Switch: {
-    const SwitchNode *Switch = llvm::cast<SwitchNode>(N);
-    llvm::Value *SwitchVar = Switch->getCondition();
-
-    if (not SwitchVar)
-      rc_return true;
-
-    for (const auto &[Labels, CaseNode] : Switch->cases_const_range())
-      if (rc_recur needsLoopVarImpl(CaseNode))
-        rc_return true;
-
-    rc_return false;
-  } break;
+bool needsLoopVar(const ASTNode *N) {
+  if (N == nullptr)
+    return false;
 
-  case ASTNode::NodeKind::NK_Set: {
-    rc_return true;
-  } break;
-  }
-}
+  // A loop variable is needed to set the state, or to dispatch on it
+  return anyGHASTNode(N, [](const ASTNode *Node) {
+    if (llvm::isa<SetNode>(Node))
+      return true;
 
-bool needsLoopVar(const ASTNode *N) {
-  return needsLoopVarImpl(N);
+    auto *Switch = llvm::dyn_cast<SwitchNode>(Node);
+    return Switch != nullptr and Switch->getCondition() == nullptr;
+  });
 }
 
 using UniqueExpr = ASTTree::expr_unique_ptr;
@@ -17,6 +17,10 @@ using namespace llvm;
 using ASTNodeMap = std::map<ASTNode *, ASTNode *>;
 using ExprNodeMap = std::map<ExprNode *, ExprNode *>;
 
+trace::AllocationCounters ASTAllocations("restructure",
+                                         "AST node list allocations",
+                                         "AST node list allocated bytes");
+
 // Helper to obtain a unique incremental counter (to give name to sequence
 // nodes).
 static int Counter = 1;
@@ -71,6 +75,15 @@ ASTNode *ASTTree::addASTNode(ast_unique_ptr &&ASTObject) {
 void ASTTree::removeASTNode(ASTNode *Node) {
   revng_log(CombLogger, "Removing AST node named: " << Node->getName() << "\n");
 
+  // The memory of removed nodes is recycled for new nodes, so we must not keep
+  // any reference to them around.
+  if (auto It = ASTBBMap.find(Node); It != ASTBBMap.end()) {
+    auto BBIt = BBASTMap.find(It->second);
+    if (BBIt != BBASTMap.end() and BBIt->second == Node)
+      BBASTMap.erase(BBIt);
+    ASTBBMap.erase(It);
+  }
+
   bool Removed = false;
   for (auto It = ASTNodeList.begin(); It != ASTNodeList.end(); It++) {
     if ((*It).get() == Node) {
@@ -6,6 +6,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/Path.h"
@@ -26,6 +29,7 @@
 #include "revng-c/Support/DecompilationHelpers.h"
 
 #include "FallThroughScopeAnalysis.h"
+#include "GHASTVisit.h"
 #include "InlineDispatcherSwitch.h"
 #include "PromoteCallNoReturn.h"
 #include "SimplifyCompareNode.h"
@@ -79,48 +83,39 @@ openFunctionFile(const StringRef DirectoryPath,
 static unsigned ShortCircuitCounter = 0;
 static unsigned TrivialShortCircuitCounter = 0;
 
-static RecursiveCoroutine<bool> hasSideEffects(ExprNode *Expr) {
-  switch (Expr->getKind()) {
+static bool hasSideEffects(ExprNode *Expr) {
+  return anyGHASTNode(Expr, [](ExprNode *E) {
+    switch (E->getKind()) {
 
-  case ExprNode::NodeKind::NK_Atomic: {
-    auto *Atomic = llvm::cast<AtomicNode>(Expr);
-    llvm::BasicBlock *BB = Atomic->getConditionalBasicBlock();
-    for (llvm::Instruction &I : *BB) {
+    case ExprNode::NodeKind::NK_Atomic: {
+      auto *Atomic = llvm::cast<AtomicNode>(E);
+      llvm::BasicBlock *BB = Atomic->getConditionalBasicBlock();
+      for (llvm::Instruction &I : *BB) {
 
-      if (I.getType()->isVoidTy() and hasSideEffects(I)) {
-        // For Instructions with void type, the MarkAssignment pass cannot
-        // properly wrap them in calls to AssignmentMarker, so we need to
-        // explicitly ask if they have side effects.
-        rc_return true;
-      } else {
-        revng_assert(not isCallToTagged(&I, FunctionTags::Assign),
-                     "call to assign should have matched void+hasSideEffects");
+        if (I.getType()->isVoidTy() and hasSideEffects(I)) {
+          // For Instructions with void type, the MarkAssignment pass cannot
+          // properly wrap them in calls to AssignmentMarker, so we need to
+          // explicitly ask if they have side effects.
+          return true;
+        } else {
+          revng_assert(not isCallToTagged(&I, FunctionTags::Assign),
+                       "call to assign should have matched "
+                       "void+hasSideEffects");
+        }
       }
+      return false;
     }
-    rc_return false;
-  } break;
-
-  case ExprNode::NodeKind::NK_Not: {
-    auto *Not = llvm::cast<NotNode>(Expr);
-    rc_return rc_recur hasSideEffects(Not->getNegatedNode());
-  } break;
 
-  case ExprNode::NodeKind::NK_And: {
-    auto *And = llvm::cast<AndNode>(Expr);
-    const auto [LHS, RHS] = And->getInternalNodes();
-    rc_return rc_recur hasSideEffects(LHS) or rc_recur hasSideEffects(RHS);
-  } break;
+    // The side effects are in the operands, which are visited anyway
+    case ExprNode::NodeKind::NK_Not:
+    case ExprNode::NodeKind::NK_And:
+    case ExprNode::NodeKind::NK_Or:
+      return false;
 
-  case ExprNode::NodeKind::NK_Or: {
-    auto *Or = llvm::cast<OrNode>(Expr);
-    const auto [LHS, RHS] = Or->getInternalNodes();
-    rc_return rc_recur hasSideEffects(LHS) or rc_recur hasSideEffects(RHS);
-  } break;
-
-  default:
-    revng_abort();
-  }
-  rc_return true;
+    default:
+      revng_abort();
+    }
+  });
 }
 
 static bool hasSideEffects(IfNode *If) {
@@ -131,20 +126,24 @@ static bool hasSideEffects(IfNode *If) {
 
 using UniqueExpr = ASTTree::expr_unique_ptr;
 
-// Helper function to simplify short-circuit IFs
-static void simplifyShortCircuit(ASTNode *RootNode, ASTTree &AST) {
+// Helper function to simplify short-circuit IFs.
+// This only changes the branches and the conditions of IfNodes, so it never
+// needs to invalidate \p Hashes.
+static void simplifyShortCircuit(ASTNode *RootNode,
+                                 ASTTree &AST,
+                                 ASTStructuralHashes &Hashes) {
 
   if (auto *Sequence = llvm::dyn_cast<SequenceNode>(RootNode)) {
     for (ASTNode *Node : Sequence->nodes()) {
-      simplifyShortCircuit(Node, AST);
+      simplifyShortCircuit(Node, AST, Hashes);
     }
 
   } else if (auto *Scs = llvm::dyn_cast<ScsNode>(RootNode)) {
-    simplifyShortCircuit(Scs->getBody(), AST);
+    simplifyShortCircuit(Scs->getBody(), AST, Hashes);
   } else if (auto *Switch = llvm::dyn_cast<SwitchNode>(RootNode)) {
 
     for (auto &LabelCasePair : Switch->cases())
-      simplifyShortCircuit(LabelCasePair.second, AST);
+      simplifyShortCircuit(LabelCasePair.second, AST, Hashes);
 
   } else if (auto *If = llvm::dyn_cast<IfNode>(RootNode)) {
     if (If->hasBothBranches()) {
@@ -153,7 +152,7 @@ static void simplifyShortCircuit(ASTNode *RootNode, ASTTree &AST) {
         // TODO: Refactor this with some kind of iterator
         if (NestedIf->getThen() != nullptr) {
 
-          if (If->getElse()->isEqual(NestedIf->getThen())
+          if (Hashes.isEqual(If->getElse(), NestedIf->getThen())
               and not hasSideEffects(NestedIf)) {
             if (BeautifyLogger.isEnabled()) {
               BeautifyLogger << "Candidate for short-circuit reduction found:";
@@ -183,12 +182,12 @@ static void simplifyShortCircuit(ASTNode *RootNode, ASTTree &AST) {
             ShortCircuitCounter += 1;
 
             // Recursive call.
-            simplifyShortCircuit(If, AST);
+            simplifyShortCircuit(If, AST, Hashes);
           }
         }
 
         if (NestedIf->getElse() != nullptr) {
-          if (If->getElse()->isEqual(NestedIf->getElse())
+          if (Hashes.isEqual(If->getElse(), NestedIf->getElse())
               and not hasSideEffects(NestedIf)) {
             if (BeautifyLogger.isEnabled()) {
               BeautifyLogger << "Candidate for short-circuit reduction found:";
@@ -217,7 +216,7 @@ static void simplifyShortCircuit(ASTNode *RootNode, ASTTree &AST) {
             // Increment counter
             ShortCircuitCounter += 1;
 
-            simplifyShortCircuit(If, AST);
+            simplifyShortCircuit(If, AST, Hashes);
           }
         }
       }
@@ -226,7 +225,7 @@ static void simplifyShortCircuit(ASTNode *RootNode, ASTTree &AST) {
       if (auto NestedIf = llvm::dyn_cast_or_null<IfNode>(If->getElse())) {
         // TODO: Refactor this with some kind of iterator
         if (NestedIf->getThen() != nullptr) {
-          if (If->getThen()->isEqual(NestedIf->getThen())
+          if (Hashes.isEqual(If->getThen(), NestedIf->getThen())
               and not hasSideEffects(NestedIf)) {
             if (BeautifyLogger.isEnabled()) {
               BeautifyLogger << "Candidate for short-circuit reduction found:";
@@ -258,12 +257,12 @@ static void simplifyShortCircuit(ASTNode *RootNode, ASTTree &AST) {
             // Increment counter
             ShortCircuitCounter += 1;
 
-            simplifyShortCircuit(If, AST);
+            simplifyShortCircuit(If, AST, Hashes);
           }
         }
 
         if (NestedIf->getElse() != nullptr) {
-          if (If->getThen()->isEqual(NestedIf->getElse())
+          if (Hashes.isEqual(If->getThen(), NestedIf->getElse())
               and not hasSideEffects(NestedIf)) {
             if (BeautifyLogger.isEnabled()) {
               BeautifyLogger << "Candidate for short-circuit reduction found:";
@@ -291,16 +290,16 @@ static void simplifyShortCircuit(ASTNode *RootNode, ASTTree &AST) {
             // Increment counter
             ShortCircuitCounter += 1;
 
-            simplifyShortCircuit(If, AST);
+            simplifyShortCircuit(If, AST, Hashes);
           }
         }
       }
     }
 
     if (If->hasThen())
-      simplifyShortCircuit(If->getThen(), AST);
+      simplifyShortCircuit(If->getThen(), AST, Hashes);
     if (If->hasElse())
-      simplifyShortCircuit(If->getElse(), AST);
+      simplifyShortCircuit(If->getElse(), AST, Hashes);
   }
 }
 
@@ -671,17 +670,33 @@ protected:
 // subtree. In the future, we might considering using something closer to the
 // definition of the cyclomatic Complexity itself, cfr.
 // https://www.sonarsource.com/resources/white-papers/cognitive-complexity.html
+using NodeWeightMap = llvm::DenseMap<const ASTNode *, unsigned>;
+
+static RecursiveCoroutine<unsigned>
+computeCumulativeNodeWeight(ASTNode *Node, NodeWeightMap &NodeWeight);
+
+/// The weight of the subtree rooted in \p Node, computed the first time it's
+/// asked for and then kept in \p NodeWeight
 static RecursiveCoroutine<unsigned>
-computeCumulativeNodeWeight(ASTNode *Node,
-                            std::map<const ASTNode *, unsigned> &NodeWeight) {
+getNodeWeight(ASTNode *Node, NodeWeightMap &NodeWeight) {
+  auto It = NodeWeight.find(Node);
+  if (It != NodeWeight.end())
+    rc_return It->second;
+
+  unsigned Weight = rc_recur computeCumulativeNodeWeight(Node, NodeWeight);
+  NodeWeight[Node] = Weight;
+  rc_return Weight;
+}
+
+static RecursiveCoroutine<unsigned>
+computeCumulativeNodeWeight(ASTNode *Node, NodeWeightMap &NodeWeight) {
   switch (Node->getKind()) {
   case ASTNode::NK_List: {
     SequenceNode *Seq = llvm::cast<SequenceNode>(Node);
 
     unsigned Accum = 0;
     for (ASTNode *N : Seq->nodes()) {
-      unsigned NWeight = rc_recur computeCumulativeNodeWeight(N, NodeWeight);
-      NodeWeight[N] = NWeight;
+      unsigned NWeight = rc_recur getNodeWeight(N, NodeWeight);
 
       // Accumulate the weight of all the nodes in the sequence, in order to
       // compute the weight of the sequence itself.
@@ -693,9 +708,7 @@ computeCumulativeNodeWeight(ASTNode *Node,
     ScsNode *Loop = llvm::cast<ScsNode>(Node);
     if (Loop->hasBody()) {
       ASTNode *Body = Loop->getBody();
-      unsigned BodyWeight = rc_recur computeCumulativeNodeWeight(Body,
-                                                                 NodeWeight);
-      NodeWeight[Body] = BodyWeight;
+      unsigned BodyWeight = rc_recur getNodeWeight(Body, NodeWeight);
       rc_return BodyWeight + 1;
     } else {
       rc_return 1;
@@ -708,13 +721,11 @@ computeCumulativeNodeWeight(ASTNode *Node,
     unsigned ElseWeight = 0;
     if (If->hasThen()) {
       ASTNode *Then = If->getThen();
-      ThenWeight = rc_recur computeCumulativeNodeWeight(Then, NodeWeight);
-      NodeWeight[Then] = ThenWeight;
+      ThenWeight = rc_recur getNodeWeight(Then, NodeWeight);
     }
     if (If->hasElse()) {
       ASTNode *Else = If->getElse();
-      ElseWeight = rc_recur computeCumulativeNodeWeight(Else, NodeWeight);
-      NodeWeight[Else] = ElseWeight;
+      ElseWeight = rc_recur getNodeWeight(Else, NodeWeight);
     }
     rc_return ThenWeight + ElseWeight + 1;
   } break;
@@ -724,9 +735,7 @@ computeCumulativeNodeWeight(ASTNode *Node,
     unsigned SwitchWeight = 0;
     for (auto &LabelCasePair : Switch->cases()) {
       ASTNode *Case = LabelCasePair.second;
-      unsigned CaseWeight = rc_recur computeCumulativeNodeWeight(Case,
-                                                                 NodeWeight);
-      NodeWeight[Case] = CaseWeight;
+      unsigned CaseWeight = rc_recur getNodeWeight(Case, NodeWeight);
       SwitchWeight += CaseWeight;
     }
     rc_return SwitchWeight + 1;
@@ -776,11 +785,26 @@ computeCumulativeNodeWeight(ASTNode *Node,
   rc_return 0;
 }
 
+/// \p NewSequence, holding \p If and the branch promoted out of it, takes the
+/// place of \p If, and the same weight. \p If lost a branch, so its weight, if
+/// it has already been computed, is no longer valid.
+static void moveNodeWeight(NodeWeightMap &NodeWeight,
+                           const IfNode *If,
+                           const SequenceNode *NewSequence) {
+  auto It = NodeWeight.find(If);
+  if (It == NodeWeight.end())
+    return;
+
+  unsigned Weight = It->second;
+  NodeWeight.erase(It);
+  NodeWeight[NewSequence] = Weight;
+}
+
 static RecursiveCoroutine<ASTNode *>
 promoteNoFallthrough(ASTTree &AST,
                      ASTNode *Node,
                      FallThroughScopeTypeMap &FallThroughScopeMap,
-                     std::map<const ASTNode *, unsigned> &NodeWeight) {
+                     NodeWeightMap &NodeWeight) {
   // Visit the current node.
   switch (Node->getKind()) {
   case ASTNode::NK_List: {
@@ -851,7 +875,9 @@ promoteNoFallthrough(ASTTree &AST,
       if (not fallsThrough(FallThroughScopeMap.at(Then))
           and not fallsThrough(FallThroughScopeMap.at(Else))) {
 
-        if (NodeWeight.at(Then) >= NodeWeight.at(Else)) {
+        unsigned ThenWeight = rc_recur getNodeWeight(Then, NodeWeight);
+        unsigned ElseWeight = rc_recur getNodeWeight(Else, NodeWeight);
+        if (ThenWeight >= ElseWeight) {
           // If the previous criterion did not match, we use the weight
           // criterion to decide which branch should be promoted
           PromoteThen = true;
@@ -877,7 +903,7 @@ promoteNoFallthrough(ASTTree &AST,
         // newly created `SequenceNode`. We also need to assign the `weight`
         // attribute for the same reason.
         FallThroughScopeMap[NewSequence] = FallThroughScopeMap.at(If);
-        NodeWeight[NewSequence] = NodeWeight[If];
+        moveNodeWeight(NodeWeight, If, NewSequence);
         NewSequence->addNode(Else);
 
         rc_return NewSequence;
@@ -893,7 +919,7 @@ promoteNoFallthrough(ASTTree &AST,
         // We need to assign a state for the `fallthrough` attribute of the
         // newly created `SequenceNode`.
         FallThroughScopeMap[NewSequence] = FallThroughScopeMap.at(If);
-        NodeWeight[NewSequence] = NodeWeight[If];
+        moveNodeWeight(NodeWeight, If, NewSequence);
         NewSequence->addNode(Then);
 
         rc_return NewSequence;
@@ -931,21 +957,19 @@ promoteNoFallthrough(ASTTree &AST,
   rc_return Node;
 }
 
-static ASTNode *promoteNoFallthroughIf(const model::Binary &Model,
+static ASTNode *promoteNoFallthroughIf(NoReturnCallees &Callees,
                                        ASTNode *RootNode,
                                        ASTTree &AST) {
 
   // Perform the computation of fallthrough scopes type
   FallThroughScopeTypeMap
-    FallThroughScopeMap = computeFallThroughScope(Model, RootNode);
+    FallThroughScopeMap = computeFallThroughScope(Callees, RootNode);
 
   // In this map, we store the weight of the AST starting from a node and
-  // going down.
-  std::map<const ASTNode *, unsigned> NodeWeight;
-
-  // Run the analysis which computes the AST weight of the nodes on the tree.
-  unsigned RootWeight = computeCumulativeNodeWeight(RootNode, NodeWeight);
-  NodeWeight[RootNode] = RootWeight;
+  // going down. The weights are only needed for the `if`s with two
+  // nofallthrough branches, hence they are computed on demand, and each
+  // subtree is visited at most once.
+  NodeWeightMap NodeWeight;
 
   // Run the fallthrough promotion.
   RootNode = promoteNoFallthrough(AST,
@@ -962,7 +986,20 @@ static ASTNode *promoteNoFallthroughIf(const model::Binary &Model,
   return RootNode;
 }
 
-void beautifyAST(const model::Binary &Model, Function &F, ASTTree &CombedAST) {
+/// Returns true if \p AST owns at least a node of kind \p Kind.
+///
+/// This also considers nodes that are no longer reachable from the root, so
+/// it's only suitable for skipping passes that would certainly have nothing to
+/// do, without having to visit the whole tree.
+static bool containsNodeKind(ASTTree &AST, ASTNode::NodeKind Kind) {
+  return llvm::any_of(AST.nodes(),
+                      [Kind](ASTNode *N) { return N->getKind() == Kind; });
+}
+
+void beautifyAST(const model::Binary &Model,
+                 Function &F,
+                 ASTTree &CombedAST,
+                 BeautifyStatistics *Statistics) {
 
   // If the --short-circuit-metrics-output-dir=dir argument was passed from
   // command line, we need to print the statistics for the short circuit metrics
@@ -976,6 +1013,10 @@ void beautifyAST(const model::Binary &Model, Function &F, ASTTree &CombedAST) {
 
   ASTNode *RootNode = CombedAST.getRoot();
 
+  // Both the fallthrough promotions below run the fallthrough analysis, let
+  // them share the `noreturn` status of the callees
+  NoReturnCallees Callees(Model);
+
   // AST dumper helper
   GHASTDumper Dumper(BeautifyLogger, F, CombedAST, "beautify");
 
@@ -983,7 +1024,10 @@ void beautifyAST(const model::Binary &Model, Function &F, ASTTree &CombedAST) {
 
   // Simplify short-circuit nodes.
   revng_log(BeautifyLogger, "Performing short-circuit simplification\n");
-  simplifyShortCircuit(RootNode, CombedAST);
+  {
+    ASTStructuralHashes Hashes;
+    simplifyShortCircuit(RootNode, CombedAST, Hashes);
+  }
   Dumper.log("after-short-circuit");
 
   // Flip IFs with empty then branches.
@@ -1015,30 +1059,42 @@ void beautifyAST(const model::Binary &Model, Function &F, ASTTree &CombedAST) {
   RootNode = matchSwitch(CombedAST, RootNode);
   Dumper.log("after-switch-match");
 
-  // Match dowhile.
-  revng_log(BeautifyLogger, "Matching do-while\n");
-  matchDoWhile(RootNode, CombedAST);
-  Dumper.log("after-match-do-while");
+  // Beautification never introduces new loops, so there's no point in looking
+  // for ways to improve them if there were none to begin with.
+  bool HasLoops = containsNodeKind(CombedAST, ASTNode::NK_Scs);
 
-  // Match while.
-  revng_log(BeautifyLogger, "Matching while\n");
-  matchWhile(RootNode, CombedAST);
-  Dumper.log("after-match-while");
+  if (HasLoops) {
+    // Match dowhile.
+    revng_log(BeautifyLogger, "Matching do-while\n");
+    matchDoWhile(RootNode, CombedAST);
+    Dumper.log("after-match-do-while");
+
+    // Match while.
+    revng_log(BeautifyLogger, "Matching while\n");
+    matchWhile(RootNode, CombedAST);
+    Dumper.log("after-match-while");
+  }
 
   // Perform the dispatcher `switch` inlining
   revng_log(BeautifyLogger, "Performing dispatcher switch inlining\n");
   RootNode = inlineDispatcherSwitch(CombedAST, RootNode);
   Dumper.log("after-dispatcher-switch-inlining");
 
-  // Perform the simplification of `switch` with two entries in a `if`
-  revng_log(BeautifyLogger, "Performing the dual switch simplification\n");
-  RootNode = simplifyDualSwitch(CombedAST, RootNode);
-  Dumper.log("after-dual-switch-simplify");
-
-  // Fix loop breaks from within switches
-  revng_log(BeautifyLogger, "Fixing loop breaks inside switches\n");
-  SwitchBreaksFixer().run(RootNode, CombedAST);
-  Dumper.log("after-fix-switch-breaks");
+  // From now on no new switch is introduced, so we can skip the passes that
+  // only look at switches if there are none.
+  if (containsNodeKind(CombedAST, ASTNode::NK_Switch)) {
+    // Perform the simplification of `switch` with two entries in a `if`
+    revng_log(BeautifyLogger, "Performing the dual switch simplification\n");
+    RootNode = simplifyDualSwitch(CombedAST, RootNode);
+    Dumper.log("after-dual-switch-simplify");
+
+    // Fix loop breaks from within switches
+    if (HasLoops) {
+      revng_log(BeautifyLogger, "Fixing loop breaks inside switches\n");
+      SwitchBreaksFixer().run(RootNode, CombedAST);
+      Dumper.log("after-fix-switch-breaks");
+    }
+  }
 
   // Remove empty sequences.
   revng_log(BeautifyLogger, "Removing empty sequence nodes\n");
@@ -1047,7 +1103,7 @@ void beautifyAST(const model::Binary &Model, Function &F, ASTTree &CombedAST) {
 
   // Remove unnecessary scopes under the fallthrough analysis.
   revng_log(BeautifyLogger, "Analyzing fallthrough scopes\n");
-  RootNode = promoteNoFallthroughIf(Model, RootNode, CombedAST);
+  RootNode = promoteNoFallthroughIf(Callees, RootNode, CombedAST);
   Dumper.log("after-fallthrough-scope-analysis");
 
   // Flip IFs with empty then branches.
@@ -1060,7 +1116,7 @@ void beautifyAST(const model::Binary &Model, Function &F, ASTTree &CombedAST) {
 
   // Run the `promoteCallNoReturn` analysis.
   revng_log(BeautifyLogger, "Perform the CallNoReturn promotion\n");
-  RootNode = promoteCallNoReturn(Model, CombedAST, RootNode);
+  RootNode = promoteCallNoReturn(Callees, CombedAST, RootNode);
   Dumper.log("after-callnoreturn-promotion");
 
   // Perform the double `not` simplification (`not` on the GHAST and `not` in
@@ -1077,9 +1133,11 @@ void beautifyAST(const model::Binary &Model, Function &F, ASTTree &CombedAST) {
   Dumper.log("after-compare-node-simplify");
 
   // Remove useless continues.
-  revng_log(BeautifyLogger, "Removing useless continue nodes\n");
-  simplifyImplicitContinue(CombedAST);
-  Dumper.log("after-continue-removal");
+  if (HasLoops) {
+    revng_log(BeautifyLogger, "Removing useless continue nodes\n");
+    simplifyImplicitContinue(CombedAST);
+    Dumper.log("after-continue-removal");
+  }
 
   // Perform the simplification of the implicit `return`, i.e., a `return` of
   // type `void`, which lies on a path followed by no other statements.
@@ -1093,4 +1151,26 @@ void beautifyAST(const model::Binary &Model, Function &F, ASTTree &CombedAST) {
                      << F.getName().data() << "," << ShortCircuitCounter << ","
                      << TrivialShortCircuitCounter << "\n";
   }
+
+  if (Statistics != nullptr) {
+    Statistics->ShortCircuits = ShortCircuitCounter;
+    Statistics->TrivialShortCircuits = TrivialShortCircuitCounter;
+  }
+}
+
+uint64_t hashBeautifyModelDependencies(const model::Binary &Model,
+                                       const Function &F) {
+  // The same calls the fallthrough analysis looks at
+  NoReturnCallees Callees(Model);
+  llvm::hash_code Result = llvm::hash_value(0);
+  for (const Instruction &I : instructions(F)) {
+    const CallInst *Call = getCallToTagged(&I, FunctionTags::Isolated);
+    if (Call == nullptr)
+      Call = getCallToTagged(&I, FunctionTags::DynamicFunction);
+
+    if (Call != nullptr)
+      Result = llvm::hash_combine(Result, Callees.isCallToNoReturn(Call));
+  }
+
+  return Result;
 }
@@ -6,6 +6,16 @@
 
 #include "revng-c/RestructureCFG/ExprNode.h"
 
+#include "GHASTNodePool.h"
+
+void *ExprNode::operator new(size_t Size) {
+  return GHASTNodePool::allocate(Size);
+}
+
+void ExprNode::operator delete(void *Pointer, size_t Size) {
+  GHASTNodePool::deallocate(Pointer, Size);
+}
+
 void ExprNode::deleteExprNode(ExprNode *E) {
   switch (E->getKind()) {
   case NodeKind::NK_ValueCompare:
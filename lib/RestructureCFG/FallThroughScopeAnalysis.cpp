@@ -38,6 +38,30 @@ bool isNoReturn(const ModelFunctionOrDynamic &F) {
   return F.Attributes().contains(NoReturn);
 }
 
+bool NoReturnCallees::isCallToNoReturn(const CallInst *Call) {
+  const Function *Callee = Call->getCalledFunction();
+  if (auto It = Cache.find(Callee); It != Cache.end())
+    return It->second;
+
+  bool Result = false;
+  if (FunctionTags::Isolated.isTagOf(Callee)) {
+    // The called function may be an isolated function. In this case we use the
+    // `llvmToModelFunction` helper in order to retrieve the corresponding
+    // `model::Function` to check for the `NoReturn` attribute.
+    Result = isNoReturn(*llvmToModelFunction(Model, *Callee));
+  } else if (FunctionTags::DynamicFunction.isTagOf(Callee)) {
+    // The called function may be a dynamic function. In this case, we use the
+    // name of the dyamic symbol in order to retrieve the
+    // `model::DynamicFunction` and check for the `NoReturn` attribute.
+    llvm::StringRef SymbolName = Callee->getName()
+                                   .drop_front(strlen("dynamic_"));
+    Result = isNoReturn(getDynamicFunction(Model, SymbolName));
+  }
+
+  Cache[Callee] = Result;
+  return Result;
+}
+
 bool fallsThrough(FallThroughScopeType Element) {
   return Element == FallThroughScopeType::FallThrough;
 }
@@ -58,7 +82,7 @@ static FallThroughScopeType combineTypes(FallThroughScopeType First,
 }
 
 static RecursiveCoroutine<FallThroughScopeType>
-fallThroughScopeImpl(const model::Binary &Model,
+fallThroughScopeImpl(NoReturnCallees &Callees,
                      ASTNode *Node,
                      FallThroughScopeTypeMap &ResultMap) {
   switch (Node->getKind()) {
@@ -73,7 +97,7 @@ fallThroughScopeImpl(const model::Binary &Model,
     // transformation could exist.
     for (ASTNode *N : Seq->nodes()) {
       FallThroughScopeType NFallThrough = rc_recur
-        fallThroughScopeImpl(Model, N, ResultMap);
+        fallThroughScopeImpl(Callees, N, ResultMap);
       ResultMap[N] = NFallThrough;
     }
 
@@ -89,7 +113,7 @@ fallThroughScopeImpl(const model::Binary &Model,
     if (Loop->hasBody()) {
       ASTNode *Body = Loop->getBody();
       FallThroughScopeType BFallThrough = rc_recur
-        fallThroughScopeImpl(Model, Body, ResultMap);
+        fallThroughScopeImpl(Callees, Body, ResultMap);
       ResultMap[Body] = BFallThrough;
       rc_return BFallThrough;
     } else {
@@ -103,14 +127,14 @@ fallThroughScopeImpl(const model::Binary &Model,
     FallThroughScopeType ThenFallThrough = FallThroughScopeType::FallThrough;
     if (If->hasThen()) {
       ASTNode *Then = If->getThen();
-      ThenFallThrough = rc_recur fallThroughScopeImpl(Model, Then, ResultMap);
+      ThenFallThrough = rc_recur fallThroughScopeImpl(Callees, Then, ResultMap);
       ResultMap[Then] = ThenFallThrough;
     }
 
     FallThroughScopeType ElseFallThrough = FallThroughScopeType::FallThrough;
     if (If->hasElse()) {
       ASTNode *Else = If->getElse();
-      ElseFallThrough = rc_recur fallThroughScopeImpl(Model, Else, ResultMap);
+      ElseFallThrough = rc_recur fallThroughScopeImpl(Callees, Else, ResultMap);
       ResultMap[Else] = ElseFallThrough;
     }
 
@@ -128,7 +152,7 @@ fallThroughScopeImpl(const model::Binary &Model,
     for (auto &LabelCasePair : Switch->cases()) {
       ASTNode *Case = LabelCasePair.second;
       FallThroughScopeType CaseFallThrough = rc_recur
-        fallThroughScopeImpl(Model, Case, ResultMap);
+        fallThroughScopeImpl(Callees, Case, ResultMap);
       ResultMap[Case] = CaseFallThrough;
 
       // We need to special case the first iteration over the `case`s, so that
@@ -181,36 +205,13 @@ fallThroughScopeImpl(const model::Binary &Model,
       //       assumption
       if (Instruction *PrevI = UnreachableI->getPrevNode()) {
 
-        if (const CallInst *Call = getCallToTagged(PrevI,
-                                                   FunctionTags::Isolated)) {
-
-          // The called function may be an isolated function. In this case we
-          // use the `llvmToModelFunction` helper in order to retrieve the
-          // corresponding `model::Function` to check for the `NoReturn`
-          // attribute.
-          const Function *CalleeFunction = Call->getCalledFunction();
-          const model::Function
-            *CalleeFunctionModel = llvmToModelFunction(Model, *CalleeFunction);
-          if (isNoReturn(*CalleeFunctionModel)) {
-            ResultMap[Code] = FallThroughScopeType::CallNoReturn;
-            rc_return FallThroughScopeType::CallNoReturn;
-          }
-        } else if (const CallInst
-                     *Call = getCallToTagged(PrevI,
-                                             FunctionTags::DynamicFunction)) {
-
-          // The called function may be a dynamic function. In this case, we use
-          // the name of the dyamic symbol in order to retrieve the
-          // `model::DynamicFunction` and check for the `NoReturn` attribute.
-          const Function *CalleeFunction = Call->getCalledFunction();
-          llvm::StringRef SymbolName = CalleeFunction->getName()
-                                         .drop_front(strlen("dynamic_"));
-          const model::DynamicFunction
-            &CalleeFunctionModel = getDynamicFunction(Model, SymbolName);
-          if (isNoReturn(CalleeFunctionModel)) {
-            ResultMap[Code] = FallThroughScopeType::CallNoReturn;
-            rc_return FallThroughScopeType::CallNoReturn;
-          }
+        const CallInst *Call = getCallToTagged(PrevI, FunctionTags::Isolated);
+        if (Call == nullptr)
+          Call = getCallToTagged(PrevI, FunctionTags::DynamicFunction);
+
+        if (Call != nullptr and Callees.isCallToNoReturn(Call)) {
+          ResultMap[Code] = FallThroughScopeType::CallNoReturn;
+          rc_return FallThroughScopeType::CallNoReturn;
         }
       }
     }
@@ -236,10 +237,10 @@ fallThroughScopeImpl(const model::Binary &Model,
   rc_return FallThroughScopeType::FallThrough;
 }
 
-FallThroughScopeTypeMap computeFallThroughScope(const model::Binary &Model,
+FallThroughScopeTypeMap computeFallThroughScope(NoReturnCallees &Callees,
                                                 ASTNode *RootNode) {
   FallThroughScopeTypeMap ResultMap;
-  FallThroughScopeType Result = fallThroughScopeImpl(Model,
+  FallThroughScopeType Result = fallThroughScopeImpl(Callees,
                                                      RootNode,
                                                      ResultMap);
   ResultMap[RootNode] = Result;
@@ -4,12 +4,19 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/DenseMap.h"
+
 #include "revng/Model/IRHelpers.h"
 
 // Forward declarations
 class ASTNode;
 class ASTTree;
 
+namespace llvm {
+class CallInst;
+class Function;
+} // namespace llvm
+
 // This `enum class` is used to represent the fallthrough type
 enum class FallThroughScopeType {
   FallThrough,
@@ -28,5 +35,25 @@ using FallThroughScopeTypeMap = std::map<const ASTNode *, FallThroughScopeType>;
 
 bool fallsThrough(FallThroughScopeType Element);
 
+/// Whether the isolated and dynamic functions called by the IR are `noreturn`
+/// according to the model.
+///
+/// The answer for each callee is looked up in the model only once, so that
+/// running the fallthrough analysis several times on the same function does not
+/// resolve the same callees over and over again.
+class NoReturnCallees {
+private:
+  const model::Binary &Model;
+  llvm::DenseMap<const llvm::Function *, bool> Cache;
+
+public:
+  explicit NoReturnCallees(const model::Binary &Model) : Model(Model) {}
+
+public:
+  /// \return true if \p Call calls an isolated or dynamic function that is
+  ///         `noreturn`
+  bool isCallToNoReturn(const llvm::CallInst *Call);
+};
+
 extern FallThroughScopeTypeMap
-computeFallThroughScope(const model::Binary &Model, ASTNode *RootNode);
+computeFallThroughScope(NoReturnCallees &Callees, ASTNode *RootNode);
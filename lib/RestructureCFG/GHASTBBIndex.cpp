@@ -0,0 +1,170 @@
+/// \file GHASTBBIndex.cpp
+/// Index of the GHAST nodes covering each BasicBlock
+///
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/STLExtras.h"
+
+#include "revng/ADT/RecursiveCoroutine.h"
+
+#include "revng-c/RestructureCFG/ASTNode.h"
+#include "revng-c/RestructureCFG/ASTTree.h"
+#include "revng-c/RestructureCFG/ExprNode.h"
+#include "revng-c/RestructureCFG/GHASTBBIndex.h"
+
+namespace {
+
+class GHASTBBIndexBuilder {
+private:
+  using MapType = llvm::DenseMap<const llvm::BasicBlock *,
+                                 GHASTBBIndex::NodeList>;
+
+private:
+  MapType &CoveringNodes;
+  bool &NeedsLoopStateVar;
+
+public:
+  GHASTBBIndexBuilder(MapType &CoveringNodes, bool &NeedsLoopStateVar) :
+    CoveringNodes(CoveringNodes), NeedsLoopStateVar(NeedsLoopStateVar) {}
+
+public:
+  RecursiveCoroutine<void> visit(const ASTNode *Node) {
+    switch (Node->getKind()) {
+    case ASTNode::NK_List: {
+      auto *Seq = llvm::cast<SequenceNode>(Node);
+
+      // A `SequenceNode` should not have an associated `BasicBlock`
+      revng_assert(Seq->getOriginalBB() == nullptr);
+
+      // Recursively visit on each element of the `SequenceNode`
+      for (ASTNode *Child : Seq->nodes()) {
+        rc_recur visit(Child);
+      }
+    } break;
+    case ASTNode::NK_Scs: {
+      auto *Scs = llvm::cast<ScsNode>(Node);
+
+      // An `ScsNode` should not have an associated `BasicBlock`
+      revng_assert(Scs->getOriginalBB() == nullptr);
+
+      // Inspect the related condition containing the `IfNode` associated to the
+      // execution of the loop
+      if (not Scs->isWhileTrue()) {
+        IfNode *If = Scs->getRelatedCondition();
+        rc_recur visitExpr(If->getCondExpr(), Scs);
+      }
+
+      if (Scs->hasBody()) {
+        rc_recur visit(Scs->getBody());
+      }
+    } break;
+    case ASTNode::NK_If: {
+      auto *If = llvm::cast<IfNode>(Node);
+
+      // Add the original `BB` in the `ResultMap`
+      record(If->getOriginalBB(), If);
+
+      rc_recur visitExpr(If->getCondExpr(), If);
+
+      if (If->hasThen()) {
+        rc_recur visit(If->getThen());
+      }
+      if (If->hasElse()) {
+        rc_recur visit(If->getElse());
+      }
+    } break;
+    case ASTNode::NK_Switch: {
+      auto *Switch = llvm::cast<SwitchNode>(Node);
+
+      // Add the original `BB` in the `ResultMap`
+      record(Switch->getOriginalBB(), Switch);
+
+      // A switch without a condition is a dispatcher on the loop state
+      // variable
+      if (Switch->getCondition() == nullptr)
+        NeedsLoopStateVar = true;
+
+      for (auto &LabelCasePair : Switch->cases_const_range()) {
+        ASTNode *Case = LabelCasePair.second;
+        rc_recur visit(Case);
+      }
+    } break;
+    case ASTNode::NK_Code: {
+
+      // Add the original `BB` in the `ResultMap`
+      auto *Code = llvm::cast<CodeNode>(Node);
+      record(Code->getOriginalBB(), Code);
+    } break;
+    case ASTNode::NK_Continue: {
+      auto *Continue = llvm::cast<ContinueNode>(Node);
+
+      // A `ContinueNode` should not have an associated `BasicBlock`
+      revng_assert(Continue->getOriginalBB() == nullptr);
+
+      if (Continue->hasComputation()) {
+        auto *If = llvm::cast<IfNode>(Continue->getComputationIfNode());
+        rc_recur visitExpr(If->getCondExpr(), Continue);
+      }
+    } break;
+    case ASTNode::NK_Set:
+      NeedsLoopStateVar = true;
+      [[fallthrough]];
+    case ASTNode::NK_SwitchBreak:
+    case ASTNode::NK_Break: {
+
+      // These nodes should not have an associated `BasicBlock`
+      revng_assert(Node->getOriginalBB() == nullptr);
+    } break;
+    default:
+      revng_unreachable();
+    }
+
+    rc_return;
+  }
+
+private:
+  RecursiveCoroutine<void> visitExpr(ExprNode *Expr, const ASTNode *Node) {
+    switch (Expr->getKind()) {
+    case ExprNode::NodeKind::NK_ValueCompare:
+    case ExprNode::NodeKind::NK_LoopStateCompare: {
+      // There is no associated `BasicBlock`
+    } break;
+    case ExprNode::NodeKind::NK_Atomic: {
+      auto *Atomic = llvm::cast<AtomicNode>(Expr);
+      record(Atomic->getConditionalBasicBlock(), Node);
+    } break;
+    case ExprNode::NodeKind::NK_Not: {
+      auto *Not = llvm::cast<NotNode>(Expr);
+      rc_recur visitExpr(Not->getNegatedNode(), Node);
+    } break;
+    case ExprNode::NodeKind::NK_And:
+    case ExprNode::NodeKind::NK_Or: {
+      auto *Binary = llvm::cast<BinaryNode>(Expr);
+      const auto &[LHS, RHS] = Binary->getInternalNodes();
+      rc_recur visitExpr(LHS, Node);
+      rc_recur visitExpr(RHS, Node);
+    } break;
+    default:
+      revng_unreachable();
+    }
+
+    rc_return;
+  }
+
+  void record(const llvm::BasicBlock *BB, const ASTNode *Node) {
+    // The same node can cover a block more than once, e.g. through the
+    // condition of an `IfNode` and its original `BasicBlock`
+    auto &Nodes = CoveringNodes[BB];
+    if (not llvm::is_contained(Nodes, Node))
+      Nodes.push_back(Node);
+  }
+};
+
+} // namespace
+
+GHASTBBIndex::GHASTBBIndex(const ASTTree &GHAST) {
+  GHASTBBIndexBuilder(CoveringNodes, NeedsLoopStateVar).visit(GHAST.getRoot());
+}
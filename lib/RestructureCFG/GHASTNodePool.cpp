@@ -0,0 +1,120 @@
+/// \file GHASTNodePool.cpp
+/// Pooled allocation for the nodes of GHASTs
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstddef>
+#include <mutex>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Allocator.h"
+
+#include "revng/Support/Assert.h"
+
+#include "GHASTNodePool.h"
+
+namespace {
+
+class NodePool;
+
+/// Put in front of each node, so that it can be handed back to the pool it
+/// comes from, even if it's deleted on another thread
+struct alignas(std::max_align_t) NodeHeader {
+  NodePool *Owner = nullptr;
+};
+
+class NodePool {
+private:
+  /// Only contended when nodes are deleted on another thread than the one
+  /// that created them
+  std::mutex Mutex;
+  llvm::BumpPtrAllocator Allocator;
+
+  /// For each node size, the deleted nodes whose memory can be recycled
+  llvm::SmallDenseMap<size_t, llvm::SmallVector<NodeHeader *, 0>, 16>
+    FreeLists;
+
+  /// The number of nodes allocated and not deleted yet
+  size_t LiveNodes = 0;
+
+  /// True if the thread owning this pool terminated
+  bool Orphaned = false;
+
+public:
+  void *allocate(size_t Size) {
+    std::lock_guard Lock(Mutex);
+    ++LiveNodes;
+
+    NodeHeader *Header = nullptr;
+    auto &FreeList = FreeLists[Size];
+    if (not FreeList.empty()) {
+      Header = FreeList.pop_back_val();
+    } else {
+      void *Memory = Allocator.Allocate(sizeof(NodeHeader) + Size,
+                                        alignof(NodeHeader));
+      Header = new (Memory) NodeHeader{ this };
+    }
+
+    return Header + 1;
+  }
+
+  /// \return true if this pool has to be deleted
+  bool deallocate(NodeHeader *Header, size_t Size) {
+    std::lock_guard Lock(Mutex);
+    revng_assert(LiveNodes > 0);
+    --LiveNodes;
+
+    // Once all the GHASTs are gone, give the memory back to the system
+    if (LiveNodes == 0) {
+      FreeLists.clear();
+      Allocator.Reset();
+      return Orphaned;
+    }
+
+    FreeLists[Size].push_back(Header);
+    return false;
+  }
+
+  /// Called when the thread owning this pool terminates
+  ///
+  /// \return true if this pool has to be deleted
+  bool orphan() {
+    std::lock_guard Lock(Mutex);
+    Orphaned = true;
+    return LiveNodes == 0;
+  }
+};
+
+/// Each thread allocates nodes out of its own pool. Pools outlive their thread
+/// as long as some of their nodes are alive.
+class ThreadPoolHolder {
+public:
+  NodePool *Pool = new NodePool;
+
+public:
+  ~ThreadPoolHolder() {
+    if (Pool->orphan())
+      delete Pool;
+  }
+};
+
+} // namespace
+
+static NodePool &getPool() {
+  static thread_local ThreadPoolHolder Holder;
+  return *Holder.Pool;
+}
+
+void *GHASTNodePool::allocate(size_t Size) {
+  return getPool().allocate(Size);
+}
+
+void GHASTNodePool::deallocate(void *Pointer, size_t Size) {
+  NodeHeader *Header = static_cast<NodeHeader *>(Pointer) - 1;
+  NodePool *Owner = Header->Owner;
+  if (Owner->deallocate(Header, Size))
+    delete Owner;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstddef>
+
+/// Memory for the ASTNodes and ExprNodes of GHASTs.
+///
+/// Each thread has a pool of its own, so that threads building GHASTs don't
+/// contend for it. Memory is obtained from the system in large slabs and, once
+/// a node is deleted, it's recycled for new nodes of the same size. This way
+/// building or tearing down a GHAST doesn't hit the system allocator once per
+/// node. Once all the nodes of a pool have been deleted, i.e. all the GHASTs
+/// built on a thread are gone, its slabs are given back to the system.
+namespace GHASTNodePool {
+
+void *allocate(size_t Size);
+
+void deallocate(void *Pointer, size_t Size);
+
+} // namespace GHASTNodePool
@@ -0,0 +1,64 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Support/Casting.h"
+
+#include "revng/ADT/RecursiveCoroutine.h"
+#include "revng/Support/Assert.h"
+
+#include "revng-c/RestructureCFG/ASTNode.h"
+
+/// Visit \p Node and all the nodes it contains in post order, replacing each
+/// of them with what \p Rewrite returns for it.
+///
+/// \p Rewrite is called on a node after all its children have been rewritten,
+/// and returns the node taking its place: the node itself, a new node, or
+/// nullptr to drop it. Elements of a `SequenceNode` replaced by nullptr are
+/// removed from the sequence.
+///
+/// Several local simplifications that can run in any order with respect to
+/// each other can share a single traversal by dispatching on the node kind
+/// inside the same \p Rewrite.
+template<typename RewriteT>
+inline RecursiveCoroutine<ASTNode *>
+rewriteBottomUp(ASTNode *Node, RewriteT &Rewrite) {
+  switch (Node->getKind()) {
+  case ASTNode::NK_List: {
+    auto *Seq = llvm::cast<SequenceNode>(Node);
+    for (ASTNode *&N : Seq->nodes())
+      N = rc_recur rewriteBottomUp(N, Rewrite);
+    Seq->removeNode(nullptr);
+  } break;
+  case ASTNode::NK_Scs: {
+    auto *Scs = llvm::cast<ScsNode>(Node);
+    if (Scs->hasBody())
+      Scs->setBody(rc_recur rewriteBottomUp(Scs->getBody(), Rewrite));
+  } break;
+  case ASTNode::NK_If: {
+    auto *If = llvm::cast<IfNode>(Node);
+    if (If->hasThen())
+      If->setThen(rc_recur rewriteBottomUp(If->getThen(), Rewrite));
+    if (If->hasElse())
+      If->setElse(rc_recur rewriteBottomUp(If->getElse(), Rewrite));
+  } break;
+  case ASTNode::NK_Switch: {
+    auto *Switch = llvm::cast<SwitchNode>(Node);
+    for (auto &LabelCasePair : Switch->cases())
+      LabelCasePair.second = rc_recur rewriteBottomUp(LabelCasePair.second,
+                                                      Rewrite);
+  } break;
+  case ASTNode::NK_Code:
+  case ASTNode::NK_Set:
+  case ASTNode::NK_SwitchBreak:
+  case ASTNode::NK_Continue:
+  case ASTNode::NK_Break:
+    break;
+  default:
+    revng_unreachable();
+  }
+
+  rc_return Rewrite(Node);
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <type_traits>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Casting.h"
+
+#include "revng/Support/Assert.h"
+
+#include "revng-c/RestructureCFG/ASTNode.h"
+#include "revng-c/RestructureCFG/ExprNode.h"
+
+/// The nodes directly contained in a GHAST node, or in a condition
+/// expression, in the order they are visited. `child` can return nullptr for
+/// an absent child, e.g. the `else` of an `IfNode` without one.
+template<typename NodeT>
+struct GHASTChildren;
+
+template<>
+struct GHASTChildren<ASTNode> {
+  static size_t count(const ASTNode *Node) {
+    switch (Node->getKind()) {
+    case ASTNode::NK_List:
+      return llvm::cast<SequenceNode>(Node)->length();
+    case ASTNode::NK_Scs:
+      return 1;
+    case ASTNode::NK_If:
+      return 2;
+    case ASTNode::NK_Switch:
+      return llvm::size(llvm::cast<SwitchNode>(Node)->cases_const_range());
+    case ASTNode::NK_Code:
+    case ASTNode::NK_Set:
+    case ASTNode::NK_SwitchBreak:
+    case ASTNode::NK_Continue:
+    case ASTNode::NK_Break:
+      return 0;
+    default:
+      revng_unreachable();
+    }
+  }
+
+  static const ASTNode *child(const ASTNode *Node, size_t Index) {
+    switch (Node->getKind()) {
+    case ASTNode::NK_List:
+      return *(llvm::cast<SequenceNode>(Node)->nodes().begin() + Index);
+    case ASTNode::NK_Scs:
+      return llvm::cast<ScsNode>(Node)->getBody();
+    case ASTNode::NK_If: {
+      auto *If = llvm::cast<IfNode>(Node);
+      if (Index == 0)
+        return If->hasThen() ? If->getThen() : nullptr;
+      return If->hasElse() ? If->getElse() : nullptr;
+    }
+    case ASTNode::NK_Switch: {
+      auto Cases = llvm::cast<SwitchNode>(Node)->cases_const_range();
+      return (Cases.begin() + Index)->second;
+    }
+    default:
+      revng_unreachable();
+    }
+  }
+};
+
+template<>
+struct GHASTChildren<ExprNode> {
+  static size_t count(const ExprNode *Node) {
+    switch (Node->getKind()) {
+    case ExprNode::NodeKind::NK_Not:
+      return 1;
+    case ExprNode::NodeKind::NK_And:
+    case ExprNode::NodeKind::NK_Or:
+      return 2;
+    default:
+      return 0;
+    }
+  }
+
+  static const ExprNode *child(const ExprNode *Node, size_t Index) {
+    if (auto *Not = llvm::dyn_cast<NotNode>(Node))
+      return Not->getNegatedNode();
+
+    const auto [LHS, RHS] = llvm::cast<BinaryNode>(Node)->getInternalNodes();
+    return Index == 0 ? LHS : RHS;
+  }
+};
+
+/// What the pre order callback of visitGHAST wants to happen next
+enum class VisitAction {
+  Continue,
+  /// Don't visit the children of the node, but still call the post order
+  /// callback on it
+  SkipChildren,
+  /// End the whole visit right away
+  Stop
+};
+
+/// Visit \p Root and all the nodes it contains, depth first, calling \p Pre
+/// on each node before its children and \p Post after them.
+///
+/// Unlike a recursive visit, this keeps the nodes to come back to on an
+/// explicit stack, which doesn't allocate until the tree gets deeper than its
+/// inline capacity, hence it's the one to use on the hot paths.
+///
+/// Returns false if the visit has been stopped by \p Pre.
+template<typename NodeT, typename PreT, typename PostT>
+inline bool visitGHAST(NodeT *Root, PreT &&Pre, PostT &&Post) {
+  using Children = GHASTChildren<std::remove_const_t<NodeT>>;
+
+  struct Frame {
+    NodeT *Node;
+    size_t NextChild;
+    size_t ChildCount;
+  };
+  llvm::SmallVector<Frame, 32> Stack;
+
+  auto Enter = [&](NodeT *Node) {
+    switch (Pre(Node)) {
+    case VisitAction::Continue:
+      Stack.push_back({ Node, 0, Children::count(Node) });
+      return true;
+    case VisitAction::SkipChildren:
+      Post(Node);
+      return true;
+    case VisitAction::Stop:
+      return false;
+    }
+    revng_abort();
+  };
+
+  if (not Enter(Root))
+    return false;
+
+  while (not Stack.empty()) {
+    Frame &Top = Stack.back();
+    if (Top.NextChild == Top.ChildCount) {
+      NodeT *Node = Top.Node;
+      Stack.pop_back();
+      Post(Node);
+      continue;
+    }
+
+    // The children are reached through their const parent, but they are
+    // exactly as const as the root
+    auto *Child = const_cast<NodeT *>(Children::child(Top.Node,
+                                                      Top.NextChild++));
+    if (Child != nullptr and not Enter(Child))
+      return false;
+  }
+
+  return true;
+}
+
+/// Visit \p Root and all the nodes it contains in pre order
+template<typename NodeT, typename PreT>
+inline bool visitGHAST(NodeT *Root, PreT &&Pre) {
+  return visitGHAST(Root, Pre, [](NodeT *) {});
+}
+
+/// Whether \p Predicate holds for \p Root or for any of the nodes it contains
+template<typename NodeT, typename PredicateT>
+inline bool anyGHASTNode(NodeT *Root, PredicateT &&Predicate) {
+  return not visitGHAST(Root, [&Predicate](NodeT *Node) {
+    return Predicate(Node) ? VisitAction::Stop : VisitAction::Continue;
+  });
+}
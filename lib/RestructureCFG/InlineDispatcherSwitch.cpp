@@ -9,6 +9,7 @@
 
 #include <algorithm>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SetOperations.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
@@ -25,6 +26,7 @@
 #include "revng-c/Support/FunctionTags.h"
 
 #include "FallThroughScopeAnalysis.h"
+#include "GHASTVisit.h"
 #include "InlineDispatcherSwitch.h"
 
 using namespace llvm;
@@ -37,6 +39,15 @@ using LoopDispatcherMap = std::map<SwitchNode *, std::pair<ScsNode *, bool>>;
 using NodeSet = llvm::SmallSet<SetNode *, 1>;
 using SetNodeCounterMap = std::map<uint64_t, NodeSet>;
 
+// The `SetNode`s of each loop, by state variable value. They are computed the
+// first time a dispatcher of the loop is processed, and kept up to date while
+// its cases are inlined, so that the other dispatchers of the same loop (the
+// weaved ones) do not have to scan its body again.
+using LoopSetNodesMap = std::map<ScsNode *, SetNodeCounterMap>;
+
+// The body to inline in place of each `SetNode`, `nullptr` to remove it
+using SetInliningMap = llvm::SmallDenseMap<SetNode *, ASTNode *, 8>;
+
 static RecursiveCoroutine<void>
 countSetNodeInLoop(ASTNode *Node, SetNodeCounterMap &CounterMap) {
   switch (Node->getKind()) {
@@ -98,11 +109,11 @@ countSetNodeInLoop(ASTNode *Node, SetNodeCounterMap &CounterMap) {
   rc_return;
 }
 
-static RecursiveCoroutine<ASTNode *> addToDispatcherSet(ASTTree &AST,
-                                                        ASTNode *Node,
-                                                        ASTNode *InlinedBody,
-                                                        ASTNode *InlinedSet,
-                                                        bool RemoveSetNode) {
+static RecursiveCoroutine<ASTNode *>
+addToDispatcherSet(ASTTree &AST,
+                   ASTNode *Node,
+                   const SetInliningMap &Inlinings,
+                   bool RemoveSetNode) {
   switch (Node->getKind()) {
   case ASTNode::NK_List: {
     SequenceNode *Seq = llvm::cast<SequenceNode>(Node);
@@ -110,11 +121,7 @@ static RecursiveCoroutine<ASTNode *> addToDispatcherSet(ASTTree &AST,
     // In place of a sequence node, we need just to inspect all the nodes in the
     // sequence
     for (ASTNode *&N : Seq->nodes()) {
-      N = rc_recur addToDispatcherSet(AST,
-                                      N,
-                                      InlinedBody,
-                                      InlinedSet,
-                                      RemoveSetNode);
+      N = rc_recur addToDispatcherSet(AST, N, Inlinings, RemoveSetNode);
     }
 
     // When a inlining inserts a `SwitchBreak` node, this is removed, so we need
@@ -133,8 +140,7 @@ static RecursiveCoroutine<ASTNode *> addToDispatcherSet(ASTTree &AST,
       ASTNode *Then = If->getThen();
       ASTNode *NewThen = rc_recur addToDispatcherSet(AST,
                                                      Then,
-                                                     InlinedBody,
-                                                     InlinedSet,
+                                                     Inlinings,
                                                      RemoveSetNode);
       If->setThen(NewThen);
     }
@@ -142,8 +148,7 @@ static RecursiveCoroutine<ASTNode *> addToDispatcherSet(ASTTree &AST,
       ASTNode *Else = If->getElse();
       ASTNode *NewElse = rc_recur addToDispatcherSet(AST,
                                                      Else,
-                                                     InlinedBody,
-                                                     InlinedSet,
+                                                     Inlinings,
                                                      RemoveSetNode);
       If->setElse(NewElse);
     }
@@ -158,8 +163,7 @@ static RecursiveCoroutine<ASTNode *> addToDispatcherSet(ASTTree &AST,
       auto &LabelCasePair = Group.value();
       LabelCasePair.second = rc_recur addToDispatcherSet(AST,
                                                          LabelCasePair.second,
-                                                         InlinedBody,
-                                                         InlinedSet,
+                                                         Inlinings,
                                                          RemoveSetNode);
 
       if (LabelCasePair.second == nullptr) {
@@ -177,8 +181,9 @@ static RecursiveCoroutine<ASTNode *> addToDispatcherSet(ASTTree &AST,
   case ASTNode::NK_Set: {
     auto *Set = llvm::cast<SetNode>(Node);
 
-    // We have reached the `SetNode` marked for the inlining
-    if (Set == InlinedSet) {
+    // We have reached a `SetNode` marked for the inlining
+    if (auto It = Inlinings.find(Set); It != Inlinings.end()) {
+      ASTNode *InlinedBody = It->second;
 
       // The `SwitchBreakNode` should not reach this point, but handled in the
       // previous branch
@@ -321,70 +326,8 @@ static LoopDispatcherMap computeLoopDispatcher(ASTTree &AST) {
   return ResultMap;
 }
 
-static RecursiveCoroutine<bool> containsSet(ASTNode *Node) {
-  switch (Node->getKind()) {
-  case ASTNode::NK_List: {
-    SequenceNode *Seq = llvm::cast<SequenceNode>(Node);
-
-    bool HasSet = false;
-    for (ASTNode *N : Seq->nodes()) {
-      HasSet = HasSet or rc_recur containsSet(N);
-    }
-    rc_return HasSet;
-  } break;
-  case ASTNode::NK_Scs: {
-    ScsNode *Loop = llvm::cast<ScsNode>(Node);
-
-    if (Loop->hasBody()) {
-      ASTNode *Body = Loop->getBody();
-      rc_return containsSet(Body);
-    } else {
-      rc_return false;
-    }
-  } break;
-  case ASTNode::NK_If: {
-    IfNode *If = llvm::cast<IfNode>(Node);
-
-    bool HasSet = false;
-    // Inspect the `then` and `else` branches
-    if (If->hasThen()) {
-      ASTNode *Then = If->getThen();
-      HasSet = HasSet or rc_recur containsSet(Then);
-    }
-    if (If->hasElse()) {
-      ASTNode *Else = If->getElse();
-      HasSet = HasSet or rc_recur containsSet(Else);
-    }
-
-    rc_return HasSet;
-  } break;
-  case ASTNode::NK_Switch: {
-    auto *Switch = llvm::cast<SwitchNode>(Node);
-
-    bool HasSet = false;
-    // First of all, we recursively process the `case` nodes contained in the
-    // `switch` in order to process the inner portion of the AST
-    for (auto &LabelCasePair : Switch->cases()) {
-      HasSet = HasSet or rc_recur containsSet(LabelCasePair.second);
-    }
-
-    rc_return HasSet;
-  } break;
-  case ASTNode::NK_Set: {
-    rc_return true;
-  } break;
-
-  case ASTNode::NK_Code:
-  case ASTNode::NK_SwitchBreak:
-  case ASTNode::NK_Continue:
-  case ASTNode::NK_Break: {
-    rc_return false;
-  } break;
-  default:
-    revng_unreachable();
-  }
-
-  revng_abort();
+static bool containsSet(ASTNode *Node) {
+  return anyGHASTNode(Node, [](ASTNode *N) { return llvm::isa<SetNode>(N); });
 }
 
 static void processNestedWeavedSwitches(SwitchNode *Switch) {
@@ -455,7 +398,8 @@ static void processNestedWeavedSwitches(SwitchNode *Switch) {
 static RecursiveCoroutine<ASTNode *>
 inlineDispatcherSwitchImpl(ASTTree &AST,
                            ASTNode *Node,
-                           const LoopDispatcherMap &LoopDispatcherMap) {
+                           const LoopDispatcherMap &LoopDispatcherMap,
+                           LoopSetNodesMap &LoopSetNodes) {
   switch (Node->getKind()) {
   case ASTNode::NK_List: {
     SequenceNode *Seq = llvm::cast<SequenceNode>(Node);
@@ -463,7 +407,10 @@ inlineDispatcherSwitchImpl(ASTTree &AST,
     // In place of a sequence node, we need just to inspect all the nodes in the
     // sequence
     for (ASTNode *&N : Seq->nodes()) {
-      N = rc_recur inlineDispatcherSwitchImpl(AST, N, LoopDispatcherMap);
+      N = rc_recur inlineDispatcherSwitchImpl(AST,
+                                              N,
+                                              LoopDispatcherMap,
+                                              LoopSetNodes);
     }
 
     // In this beautify, it may be that a dispatcher switch is completely
@@ -481,7 +428,8 @@ inlineDispatcherSwitchImpl(ASTTree &AST,
       ASTNode *Body = Scs->getBody();
       ASTNode *NewBody = rc_recur inlineDispatcherSwitchImpl(AST,
                                                              Body,
-                                                             LoopDispatcherMap);
+                                                             LoopDispatcherMap,
+                                                             LoopSetNodes);
       Scs->setBody(NewBody);
     }
 
@@ -494,14 +442,16 @@ inlineDispatcherSwitchImpl(ASTTree &AST,
       ASTNode *Then = If->getThen();
       ASTNode *NewThen = rc_recur inlineDispatcherSwitchImpl(AST,
                                                              Then,
-                                                             LoopDispatcherMap);
+                                                             LoopDispatcherMap,
+                                                             LoopSetNodes);
       If->setThen(NewThen);
     }
     if (If->hasElse()) {
       ASTNode *Else = If->getElse();
       ASTNode *NewElse = rc_recur inlineDispatcherSwitchImpl(AST,
                                                              Else,
-                                                             LoopDispatcherMap);
+                                                             LoopDispatcherMap,
+                                                             LoopSetNodes);
       If->setElse(NewElse);
     }
   } break;
@@ -514,7 +464,8 @@ inlineDispatcherSwitchImpl(ASTTree &AST,
       LabelCasePair
         .second = rc_recur inlineDispatcherSwitchImpl(AST,
                                                       LabelCasePair.second,
-                                                      LoopDispatcherMap);
+                                                      LoopDispatcherMap,
+                                                      LoopSetNodes);
     }
 
     // Execute the promotion routine only for dispatcher switches
@@ -525,10 +476,12 @@ inlineDispatcherSwitchImpl(ASTTree &AST,
       // Process the nested weaved switches, if present in the current `Switch`
       processNestedWeavedSwitches(Switch);
 
-      // Precompute how many `SetNode`s are present in the related `Scs`
+      // Retrieve the `SetNode`s present in the related `Scs`
       auto &[RelatedLoop, RemoveSetNode] = LoopDispatcherMap.at(Switch);
-      SetNodeCounterMap SetCounterMap;
-      countSetNodeInLoop(RelatedLoop->getBody(), SetCounterMap);
+      auto [SetsIt, New] = LoopSetNodes.try_emplace(RelatedLoop);
+      SetNodeCounterMap &SetCounterMap = SetsIt->second;
+      if (New)
+        countSetNodeInLoop(RelatedLoop->getBody(), SetCounterMap);
 
       // The inlining routine should proceed as follows:
       // 1) In the first phase, we iterate through all the cases, and try to
@@ -539,6 +492,9 @@ inlineDispatcherSwitchImpl(ASTTree &AST,
       // 2) Additionally, if in the previous step, we were able to inline all
       //    the cases of the switch, we can additionally remove entirely the
       //    dispatcher switch.
+      // All the inlinings are collected first, and then performed with a
+      // single visit of the body of the loop.
+      SetInliningMap Inlinings;
       std::set<size_t> ToRemoveCaseIndex;
       for (auto &Group : llvm::enumerate(Switch->cases())) {
         unsigned Index = Group.index();
@@ -555,13 +511,8 @@ inlineDispatcherSwitchImpl(ASTTree &AST,
             // node, we can remove it, by virtually inlining a `nullptr` in the
             // place of all the corresponding `SetNode`s (we can do it multiple
             // times since we are not duplicating code here)
-            for (SetNode *Set : Sets) {
-              addToDispatcherSet(AST,
-                                 RelatedLoop->getBody(),
-                                 nullptr,
-                                 Set,
-                                 RemoveSetNode);
-            }
+            for (SetNode *Set : Sets)
+              Inlinings[Set] = nullptr;
             ToRemoveCaseIndex.insert(Index);
           } else if (Sets.size() == 1
                      and (not needsLoopVar(RelatedLoop)
@@ -576,16 +527,28 @@ inlineDispatcherSwitchImpl(ASTTree &AST,
             // inline does not contain any `SetNode`. In that case indeed, we
             // would be moving a `SetNode` from a scope to another one, which is
             // not semantics preserving.
-            addToDispatcherSet(AST,
-                               RelatedLoop->getBody(),
-                               Case,
-                               *Sets.begin(),
-                               RemoveSetNode);
+            Inlinings[*Sets.begin()] = Case;
             ToRemoveCaseIndex.insert(Index);
           }
         }
       }
 
+      if (not Inlinings.empty()) {
+        addToDispatcherSet(AST,
+                           RelatedLoop->getBody(),
+                           Inlinings,
+                           RemoveSetNode);
+
+        // Keep the `SetNode`s of the loop up to date: the inlined ones may
+        // have been removed, and the inlined bodies may contain new ones
+        for (const auto &[Set, InlinedBody] : Inlinings) {
+          if (RemoveSetNode)
+            SetCounterMap.at(Set->getStateVariableValue()).erase(Set);
+          if (InlinedBody != nullptr)
+            countSetNodeInLoop(InlinedBody, SetCounterMap);
+        }
+      }
+
       // We remove the cases from the last to the first (we avoid invalidating
       // the elements in the underlying `llvm::SmallVector`)
       for (auto ToRemoveCase : llvm::reverse(ToRemoveCaseIndex)) {
@@ -618,7 +581,11 @@ ASTNode *inlineDispatcherSwitch(ASTTree &AST, ASTNode *RootNode) {
   // Compute the loop -> dispatcher switch correspondence
   LoopDispatcherMap LoopDispatcherMap = computeLoopDispatcher(AST);
 
-  RootNode = inlineDispatcherSwitchImpl(AST, RootNode, LoopDispatcherMap);
+  LoopSetNodesMap LoopSetNodes;
+  RootNode = inlineDispatcherSwitchImpl(AST,
+                                        RootNode,
+                                        LoopDispatcherMap,
+                                        LoopSetNodes);
 
   // Update the root field of the AST
   AST.setRoot(RootNode);
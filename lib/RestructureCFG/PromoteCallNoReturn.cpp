@@ -177,13 +177,13 @@ promoteCallNoReturnImpl(ASTTree &AST,
   rc_return Node;
 }
 
-ASTNode *promoteCallNoReturn(const model::Binary &Model,
+ASTNode *promoteCallNoReturn(NoReturnCallees &Callees,
                              ASTTree &AST,
                              ASTNode *RootNode) {
 
   // Perform the computation of fallthrough scopes type
   FallThroughScopeTypeMap
-    FallThroughScopeMap = computeFallThroughScope(Model, RootNode);
+    FallThroughScopeMap = computeFallThroughScope(Callees, RootNode);
 
   // Run the `PromoteCallNoReturn` transformation
   RootNode = promoteCallNoReturnImpl(AST, RootNode, FallThroughScopeMap);
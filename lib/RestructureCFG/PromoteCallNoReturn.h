@@ -10,6 +10,6 @@
 class ASTNode;
 class ASTTree;
 
-extern ASTNode *promoteCallNoReturn(const model::Binary &Model,
+extern ASTNode *promoteCallNoReturn(NoReturnCallees &Callees,
                                     ASTTree &AST,
                                     ASTNode *RootNode);
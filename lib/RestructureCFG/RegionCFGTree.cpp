@@ -10,7 +10,9 @@
 // Explicit instantiation for the `RegionCFG` template class.
 template class RegionCFG<llvm::BasicBlock *>;
 
-unsigned DuplicationCounter = 0;
+std::atomic<unsigned> DuplicationCounter = 0;
 
-unsigned UntangleTentativeCounter = 0;
-unsigned UntanglePerformedCounter = 0;
+std::atomic<unsigned> UntangleTentativeCounter = 0;
+std::atomic<unsigned> UntanglePerformedCounter = 0;
+
+std::atomic<unsigned> InflatedNodesCounter = 0;
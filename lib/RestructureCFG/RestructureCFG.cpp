@@ -2,12 +2,18 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
 #include <iterator>
 #include <limits>
+#include <numeric>
+#include <queue>
 #include <sstream>
 #include <utility>
 
 #include "llvm/ADT/BreadthFirstIterator.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallPtrSet.h"
@@ -17,6 +23,7 @@
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/GenericDomTreeConstruction.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_os_ostream.h"
 
 #include "revng/Support/Debug.h"
@@ -57,21 +64,39 @@ using MetaRegionBBVect = std::vector<MetaRegionBB>;
 using MetaRegionBBPtrVect = std::vector<MetaRegionBB *>;
 using BackedgeMetaRegionMap = std::map<EdgeDescriptor, MetaRegionBB *>;
 
-static bool mergeSCSStep(MetaRegionBBVect &MetaRegions) {
-  for (auto RegionIt1 = MetaRegions.begin(); RegionIt1 != MetaRegions.end();
-       RegionIt1++) {
-    for (auto RegionIt2 = std::next(RegionIt1); RegionIt2 != MetaRegions.end();
-         RegionIt2++) {
-      bool Intersects = (*RegionIt1).intersectsWith(*RegionIt2);
-      bool IsIncluded = (*RegionIt1).isSubSet(*RegionIt2);
-      bool IsIncludedReverse = (*RegionIt2).isSubSet(*RegionIt1);
-      bool AreEquivalent = (*RegionIt1).nodesEquality(*RegionIt2);
+/// Identifies the nodes of a MetaRegion while merging them: the stamp of a
+/// MetaRegion changes every time other nodes are merged into it.
+using Stamp = unsigned;
+
+static bool
+mergeSCSStep(MetaRegionBBVect &MetaRegions,
+             std::vector<Stamp> &Stamps,
+             Stamp &NextStamp,
+             llvm::DenseSet<std::pair<Stamp, Stamp>> &Unmergeable) {
+  for (size_t I = 0; I < MetaRegions.size(); ++I) {
+    for (size_t J = I + 1; J < MetaRegions.size(); ++J) {
+      // Whether two regions have to be merged only depends on their nodes, so
+      // there's no need to look again at a pair that hasn't changed since the
+      // last time we found it doesn't need merging.
+      if (Unmergeable.contains({ Stamps[I], Stamps[J] }))
+        continue;
+
+      MetaRegionBB &Region1 = MetaRegions[I];
+      MetaRegionBB &Region2 = MetaRegions[J];
+      bool Intersects = Region1.intersectsWith(Region2);
+      bool IsIncluded = Region1.isSubSet(Region2);
+      bool IsIncludedReverse = Region2.isSubSet(Region1);
+      bool AreEquivalent = Region1.nodesEquality(Region2);
       if (Intersects
           and (((!IsIncluded) and (!IsIncludedReverse)) or AreEquivalent)) {
-        (*RegionIt1).mergeWith(*RegionIt2);
-        MetaRegions.erase(RegionIt2);
+        Region1.mergeWith(Region2);
+        MetaRegions.erase(std::next(MetaRegions.begin(), J));
+        Stamps.erase(std::next(Stamps.begin(), J));
+        Stamps[I] = NextStamp++;
         return true;
       }
+
+      Unmergeable.insert({ Stamps[I], Stamps[J] });
     }
   }
 
@@ -79,9 +104,14 @@ static bool mergeSCSStep(MetaRegionBBVect &MetaRegions) {
 }
 
 static void simplifySCS(MetaRegionBBVect &MetaRegions) {
+  std::vector<Stamp> Stamps(MetaRegions.size());
+  std::iota(Stamps.begin(), Stamps.end(), 0);
+  Stamp NextStamp = MetaRegions.size();
+  llvm::DenseSet<std::pair<Stamp, Stamp>> Unmergeable;
+
   bool Changes = true;
   while (Changes) {
-    Changes = mergeSCSStep(MetaRegions);
+    Changes = mergeSCSStep(MetaRegions, Stamps, NextStamp, Unmergeable);
   }
 }
 
@@ -222,30 +252,33 @@ static void computeParents(MetaRegionBBVect &MetaRegions) {
 }
 
 static MetaRegionBBPtrVect applyPartialOrder(MetaRegionBBVect &V) {
-  MetaRegionBBPtrVect OrderedVector;
-  std::set<MetaRegionBB *> Processed;
-
-  while (V.size() != Processed.size()) {
-    for (auto RegionIt1 = V.begin(); RegionIt1 != V.end(); RegionIt1++) {
-      if (!Processed.contains(&*RegionIt1)) {
-        bool FoundParent = false;
-        for (auto RegionIt2 = V.begin(); RegionIt2 != V.end(); RegionIt2++) {
-          if ((RegionIt1 != RegionIt2) and !Processed.contains(&*RegionIt2)) {
-            if ((*RegionIt1).getParent() == &*RegionIt2) {
-              FoundParent = true;
-              break;
-            }
-          }
-        }
+  // We repeatedly pick the first region (in the order of V) whose parent has
+  // already been picked, so we keep the candidates in a min-heap of indexes.
+  // Regions become candidates as soon as their parent is picked.
+  llvm::DenseMap<MetaRegionBB *, size_t> Indexes;
+  for (size_t I = 0; I < V.size(); ++I)
+    Indexes[&V[I]] = I;
+
+  std::vector<llvm::SmallVector<size_t, 4>> Children(V.size());
+  std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>>
+    Candidates;
+  for (size_t I = 0; I < V.size(); ++I) {
+    auto ParentIt = Indexes.find(V[I].getParent());
+    if (ParentIt == Indexes.end())
+      Candidates.push(I);
+    else
+      Children[ParentIt->second].push_back(I);
+  }
 
-        if (FoundParent == false) {
-          OrderedVector.push_back(&*RegionIt1);
-          Processed.insert(&*RegionIt1);
-          break;
-        }
-      }
-    }
+  MetaRegionBBPtrVect OrderedVector;
+  while (not Candidates.empty()) {
+    size_t Index = Candidates.top();
+    Candidates.pop();
+    OrderedVector.push_back(&V[Index]);
+    for (size_t Child : Children[Index])
+      Candidates.push(Child);
   }
+  revng_assert(OrderedVector.size() == V.size());
 
   std::reverse(OrderedVector.begin(), OrderedVector.end());
   return OrderedVector;
@@ -293,23 +326,25 @@ createMetaRegions(const llvm::SmallDenseSet<EdgeDescriptor> &Backedges) {
   for (auto &Region : Regions) {
     BasicBlockNodeBB *Head = Region.first;
     std::set<BasicBlockNodeBB *> &Nodes = Region.second;
-    std::set<BasicBlockNodeBB *> AdditionalNodes;
-    std::set<BasicBlockNodeBB *> OldNodes;
-    do {
-      OldNodes = Nodes;
-      for (BasicBlockNodeBB *Node : Nodes) {
-        if ((Node != Head) and (AdditionalSCSNodes.contains(Node))) {
-          CombLogger << "Adding additional nodes for region with head: ";
-          CombLogger << Head->getNameStr();
-          CombLogger << " and relative to node: ";
-          CombLogger << Node->getNameStr() << "\n";
-          AdditionalNodes.insert(AdditionalSCSNodes[Node].begin(),
-                                 AdditionalSCSNodes[Node].end());
-        }
-      }
-      Nodes.insert(AdditionalNodes.begin(), AdditionalNodes.end());
-      AdditionalNodes.clear();
-    } while (Nodes != OldNodes);
+
+    // Compute the closure with a worklist, each node is inspected only once.
+    std::vector<BasicBlockNodeBB *> WorkList(Nodes.begin(), Nodes.end());
+    while (not WorkList.empty()) {
+      BasicBlockNodeBB *Node = WorkList.back();
+      WorkList.pop_back();
+
+      auto AdditionalIt = AdditionalSCSNodes.find(Node);
+      if (Node == Head or AdditionalIt == AdditionalSCSNodes.end())
+        continue;
+
+      CombLogger << "Adding additional nodes for region with head: ";
+      CombLogger << Head->getNameStr();
+      CombLogger << " and relative to node: ";
+      CombLogger << Node->getNameStr() << "\n";
+      for (BasicBlockNodeBB *Additional : AdditionalIt->second)
+        if (Nodes.insert(Additional).second)
+          WorkList.push_back(Additional);
+    }
   }
 
   MetaRegionBBVect MetaRegions;
@@ -327,6 +362,73 @@ static cl::opt<std::string> MetricsOutputPath("restructure-metrics-output-dir",
                                               value_desc("restructure-dir"),
                                               cat(MainCategory));
 
+static opt<unsigned> RestructureThreads("restructure-threads",
+                                        desc("Number of threads combing the "
+                                             "regions of a single function"),
+                                        init(1),
+                                        cat(MainCategory));
+
+static opt<unsigned> MaxDuplicationFactor("restructure-max-duplication-factor",
+                                          desc("Abandon the restructuring of "
+                                               "a function if the comb of one "
+                                               "of its regions duplicates more "
+                                               "than this many times its "
+                                               "nodes (0 means no limit)"),
+                                          init(0),
+                                          cat(MainCategory));
+
+uint64_t hashRestructureOptions() {
+  return llvm::hash_combine(MaxDuplicationFactor.getValue());
+}
+
+/// Comb all the regions reachable from \p RootCFG, including \p RootCFG
+/// itself, in parallel if -restructure-threads allows it.
+///
+/// The comb of a region only depends on the untangle weights of the regions it
+/// contains as collapsed nodes. When combing serially, top-down, those weights
+/// are computed on the regions before they are combed themselves. We freeze
+/// them upfront, after which every region can be combed independently, and
+/// the result is the same as the one of the serial algorithm.
+///
+/// \return false if the comb of any region exceeded the duplication ceiling.
+static bool combRegions(RegionCFG<BasicBlock *> &RootCFG) {
+  using RegionCFGBB = RegionCFG<BasicBlock *>;
+
+  // Collect all the regions reachable through collapsed nodes, top-down.
+  std::vector<RegionCFGBB *> ToComb = { &RootCFG };
+  SmallPtrSet<RegionCFGBB *, 8> Visited = { &RootCFG };
+  for (size_t I = 0; I < ToComb.size(); ++I)
+    for (BasicBlockNodeBB *Node : ToComb[I]->nodes())
+      if (Node->isCollapsed())
+        if (RegionCFGBB *Collapsed = Node->getCollapsedCFG();
+            Visited.insert(Collapsed).second)
+          ToComb.push_back(Collapsed);
+
+  auto Comb = [](RegionCFGBB &Region) {
+    return combRegion(Region, MaxDuplicationFactor * Region.size());
+  };
+
+  if (RestructureThreads <= 1 or CombLogger.isEnabled() or ToComb.size() < 2)
+    return llvm::all_of(ToComb, [&](RegionCFGBB *R) { return Comb(*R); });
+
+  // Freeze the weights of all the collapsed regions. The weight of the root
+  // region is never used, and it's computed after its comb, as usual.
+  for (RegionCFGBB *Region : llvm::drop_begin(ToComb))
+    Region->computeUntangleWeight();
+
+  std::atomic<bool> Abandoned = false;
+  ThreadPool Pool(hardware_concurrency(RestructureThreads));
+  for (RegionCFGBB *Region : ToComb) {
+    Pool.async([&Abandoned, &Comb, Region]() {
+      if (not Abandoned and not Comb(*Region))
+        Abandoned = true;
+    });
+  }
+  Pool.wait();
+
+  return not Abandoned;
+}
+
 static void LogMetaRegions(const MetaRegionBBPtrVect &MetaRegions,
                            const std::string &HeaderMsg) {
   if (CombLogger.isEnabled()) {
@@ -458,13 +560,133 @@ static MetaRegionBB *computePredecessorsParent(MetaRegionBBPtrVect &MetaRegions,
   return mostNestedRegion(PredecessorMetaRegions);
 }
 
-bool restructureCFG(Function &F, ASTTree &AST) {
+/// \return true if \p Graph has no cycles and all of its nodes are reachable
+///         from the entry. Such a graph has no SCS to collapse, restructuring
+///         it boils down to the comb, which has nothing to duplicate when the
+///         graph is made of structured if/else, and to the AST generation.
+static bool isAcyclic(RegionCFG<BasicBlock *> &Graph) {
+  BasicBlockNodeBB *Entry = &Graph.getEntryNode();
+  for (BasicBlockNodeBB *Node : Graph.nodes())
+    if (Node != Entry and Node->predecessor_size() == 0)
+      return false;
+
+  return Graph.isDAG();
+}
+
+/// Comb \p RootCFG, whose SCSs have already been collapsed, and the regions it
+/// contains, then build the AST of \p F out of them.
+static bool combAndGenerateAst(Function &F,
+                               RegionCFG<BasicBlock *> &RootCFG,
+                               ASTTree &AST,
+                               RestructureCFGStatistics *Statistics) {
+  // Collect statistics
+  unsigned InitialWeight = 0;
+  if (MetricsOutputPath.getNumOccurrences() or Statistics != nullptr) {
+    revng_assert(MetricsOutputPath.getNumOccurrences() <= 1);
+    // Compute the initial weight of the CFG.
+    for (BasicBlockNodeBB *BBNode : RootCFG.nodes()) {
+      InitialWeight += BBNode->getWeight();
+    }
+  }
+
+  const auto FillStatistics = [&]() {
+    if (Statistics == nullptr)
+      return;
+
+    Statistics->InflatedNodes = InflatedNodesCounter;
+    Statistics->Duplications = DuplicationCounter;
+    Statistics->UntangleTentatives = UntangleTentativeCounter;
+    Statistics->UntanglesPerformed = UntanglePerformedCounter;
+    Statistics->InitialWeight = InitialWeight;
+  };
+
+  // Comb all the regions before generating the AST. If that's too expensive,
+  // give up: the caller will have to deal with the unstructured function.
+  if (not combRegions(RootCFG)) {
+    FillStatistics();
+    if (Statistics != nullptr)
+      Statistics->DuplicationCeilingExceeded = true;
+    return false;
+  }
+
+  // Invoke the AST generation for the root region.
+  std::map<RegionCFG<llvm::BasicBlock *> *, ASTTree> CollapsedMap;
+  generateAst(RootCFG, AST, CollapsedMap);
+
+  // Scorporated this part which was previously inside the `generateAst` to
+  // avoid having it run twice or more (it was run inside the recursive step
+  // of the `generateAst`, and then another time for the final root AST, which
+  // now is directly the entire AST, since there's no flattening anymore).
+  normalize(AST, F);
+
+  FillStatistics();
+
+  // Serialize the collected metrics in the outputfile.
+  if (MetricsOutputPath.getNumOccurrences()) {
+    // Compute the increase in weight, on the AST
+    unsigned FinalWeight = 0;
+    for (ASTNode *N : AST.nodes()) {
+      switch (N->getKind()) {
+      case ASTNode::NK_Scs:
+      case ASTNode::NK_If:
+      case ASTNode::NK_Switch: {
+        // Control-flow nodes emit single constructs, so we just increase the
+        // weight by one.
+        // Control-flow nodes would also have nested scopes (then-else for if,
+        // cases for switch, loop body for scs). However, those nodes are
+        // visited separately, and will be accounted for later.
+        ++FinalWeight;
+      } break;
+      case ASTNode::NK_Set:
+      case ASTNode::NK_Break:
+      case ASTNode::NK_SwitchBreak:
+      case ASTNode::NK_Continue: {
+        // These AST Nodes are emitted as single instructions.
+        // Just increase the weight by one.
+        ++FinalWeight;
+      } break;
+      case ASTNode::NK_List: {
+        // Sequence nodes are just scopes, they don't have a real weight.
+        // Their weight is just sum of the weights of the nodes they contain,
+        // that will be visited nevertheless.
+      } break;
+      case ASTNode::NK_Code: {
+        auto *BB = cast<CodeNode>(N)->getOriginalBB();
+        revng_assert(BB);
+        FinalWeight += WeightTraits<llvm::BasicBlock *>::getWeight(BB);
+      } break;
+      default:
+        revng_abort("unexpected AST node");
+      }
+    }
+
+    float Increase = float(FinalWeight) / float(InitialWeight);
+
+    std::ofstream Output;
+    const char *FunctionName = F.getName().data();
+    std::ostream &OutputStream = pathToStream(MetricsOutputPath + "/"
+                                                + FunctionName,
+                                              Output);
+    OutputStream << "function,"
+                    "duplications,percentage,tuntangle,puntangle,iweight\n";
+    OutputStream << F.getName().data() << "," << DuplicationCounter << ","
+                 << Increase << "," << UntangleTentativeCounter << ","
+                 << UntanglePerformedCounter << "," << InitialWeight << "\n";
+  }
+
+  return true;
+}
+
+bool restructureCFG(Function &F,
+                    ASTTree &AST,
+                    RestructureCFGStatistics *Statistics) {
   revng_log(CombLogger, "restructuring Function: " << F.getName());
   revng_log(CombLogger, "Num basic blocks: " << F.size());
 
   DuplicationCounter = 0;
   UntangleTentativeCounter = 0;
   UntanglePerformedCounter = 0;
+  InflatedNodesCounter = 0;
 
   // Skip non-isolated functions
   auto FTags = FunctionTags::TagsSet::from(&F);
@@ -486,6 +708,13 @@ bool restructureCFG(Function &F, ASTTree &AST) {
     RootCFG.dumpCFGOnFile(F.getName().str(), "restructure", "initial-state");
   }
 
+  // Without loops there are no backedges, hence no MetaRegion: skip straight
+  // to the comb and to the AST generation.
+  if (isAcyclic(RootCFG)) {
+    revng_log(CombLogger, "The CFG is acyclic");
+    return combAndGenerateAst(F, RootCFG, AST, Statistics);
+  }
+
   // Identify SCS regions.
   llvm::SmallDenseSet<EdgeDescriptor>
     Backedges = getBackedges(&RootCFG.getEntryNode()).takeSet();
@@ -1357,78 +1586,5 @@ bool restructureCFG(Function &F, ASTTree &AST) {
   // Check that the root region is acyclic at this point.
   revng_assert(RootCFG.isDAG());
 
-  // Collect statistics
-  unsigned InitialWeight = 0;
-  if (MetricsOutputPath.getNumOccurrences()) {
-    revng_assert(MetricsOutputPath.getNumOccurrences() == 1);
-    // Compute the initial weight of the CFG.
-    for (BasicBlockNodeBB *BBNode : RootCFG.nodes()) {
-      InitialWeight += BBNode->getWeight();
-    }
-  }
-
-  // Invoke the AST generation for the root region.
-  std::map<RegionCFG<llvm::BasicBlock *> *, ASTTree> CollapsedMap;
-  generateAst(RootCFG, AST, CollapsedMap);
-
-  // Scorporated this part which was previously inside the `generateAst` to
-  // avoid having it run twice or more (it was run inside the recursive step
-  // of the `generateAst`, and then another time for the final root AST, which
-  // now is directly the entire AST, since there's no flattening anymore).
-  normalize(AST, F);
-
-  // Serialize the collected metrics in the outputfile.
-  if (MetricsOutputPath.getNumOccurrences()) {
-    // Compute the increase in weight, on the AST
-    unsigned FinalWeight = 0;
-    for (ASTNode *N : AST.nodes()) {
-      switch (N->getKind()) {
-      case ASTNode::NK_Scs:
-      case ASTNode::NK_If:
-      case ASTNode::NK_Switch: {
-        // Control-flow nodes emit single constructs, so we just increase the
-        // weight by one.
-        // Control-flow nodes would also have nested scopes (then-else for if,
-        // cases for switch, loop body for scs). However, those nodes are
-        // visited separately, and will be accounted for later.
-        ++FinalWeight;
-      } break;
-      case ASTNode::NK_Set:
-      case ASTNode::NK_Break:
-      case ASTNode::NK_SwitchBreak:
-      case ASTNode::NK_Continue: {
-        // These AST Nodes are emitted as single instructions.
-        // Just increase the weight by one.
-        ++FinalWeight;
-      } break;
-      case ASTNode::NK_List: {
-        // Sequence nodes are just scopes, they don't have a real weight.
-        // Their weight is just sum of the weights of the nodes they contain,
-        // that will be visited nevertheless.
-      } break;
-      case ASTNode::NK_Code: {
-        auto *BB = cast<CodeNode>(N)->getOriginalBB();
-        revng_assert(BB);
-        FinalWeight += WeightTraits<llvm::BasicBlock *>::getWeight(BB);
-      } break;
-      default:
-        revng_abort("unexpected AST node");
-      }
-    }
-
-    float Increase = float(FinalWeight) / float(InitialWeight);
-
-    std::ofstream Output;
-    const char *FunctionName = F.getName().data();
-    std::ostream &OutputStream = pathToStream(MetricsOutputPath + "/"
-                                                + FunctionName,
-                                              Output);
-    OutputStream << "function,"
-                    "duplications,percentage,tuntangle,puntangle,iweight\n";
-    OutputStream << F.getName().data() << "," << DuplicationCounter << ","
-                 << Increase << "," << UntangleTentativeCounter << ","
-                 << UntanglePerformedCounter << "," << InitialWeight << "\n";
-  }
-
-  return false;
+  return combAndGenerateAst(F, RootCFG, AST, Statistics);
 }
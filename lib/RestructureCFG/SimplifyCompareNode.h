@@ -8,5 +8,4 @@
 class ASTNode;
 class ASTTree;
 
-extern RecursiveCoroutine<ASTNode *> simplifyCompareNode(ASTTree &AST,
-                                                         ASTNode *RootNode);
+extern ASTNode *simplifyCompareNode(ASTTree &AST, ASTNode *RootNode);
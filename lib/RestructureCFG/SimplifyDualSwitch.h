@@ -8,5 +8,4 @@
 class ASTNode;
 class ASTTree;
 
-extern RecursiveCoroutine<ASTNode *> simplifyDualSwitch(ASTTree &AST,
-                                                        ASTNode *RootNode);
+extern ASTNode *simplifyDualSwitch(ASTTree &AST, ASTNode *RootNode);
@@ -0,0 +1,107 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+/// Pass running the early optimization sequence on each function, skipping the
+/// functions that are already at its fixed point.
+
+#include <optional>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/PassInfo.h"
+#include "llvm/PassRegistry.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/Debug.h"
+
+#include "revng-c/Support/FunctionFingerprint.h"
+
+using namespace llvm;
+
+static Logger<> Log{ "early-optimize" };
+
+static const char *const Sequence[] = {
+  "dce",
+  "remove-extractvalues",
+  "simplify-cfg-with-hoist-and-sink",
+  "dse",
+  "instcombine",
+  "remove-extractvalues",
+  "sroa",
+  "instsimplify",
+  "jump-threading",
+  "licm",
+  "unreachableblockelim",
+  "instcombine",
+  "remove-extractvalues",
+  "early-cse",
+  "simplify-cfg-with-hoist-and-sink",
+  "type-shrinking",
+  "early-cse",
+  "instsimplify",
+  "gvn",
+  "instsimplify",
+  "dse",
+  "dce",
+};
+
+/// Name of the fingerprint recorded on a function right after it went through
+/// the early optimization sequence
+static constexpr const char *FingerprintName = "early-optimize";
+
+static void addPasses(legacy::FunctionPassManager &Manager,
+                      ArrayRef<const char *> Names) {
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  for (const char *Name : Names) {
+    const PassInfo *Info = Registry.getPassInfo(Name);
+    revng_check(Info != nullptr, "early-optimize: unknown pass");
+    Manager.add(Info->createPass());
+  }
+}
+
+struct EarlyOptimizePass : public ModulePass {
+public:
+  static char ID;
+
+  EarlyOptimizePass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override {
+    legacy::FunctionPassManager Manager(&M);
+    addPasses(Manager, Sequence);
+    Manager.doInitialization();
+
+    unsigned Skipped = 0;
+    for (Function &F : M) {
+      if (F.isDeclaration())
+        continue;
+
+      // A function that is still the way we left it cannot improve further
+      auto Recorded = getRecordedFingerprint(F, FingerprintName);
+      if (Recorded and *Recorded == hashFunctionIR(F)) {
+        ++Skipped;
+        continue;
+      }
+
+      Manager.run(F);
+      recordFingerprint(F, FingerprintName, hashFunctionIR(F));
+    }
+
+    Manager.doFinalization();
+
+    revng_log(Log, "Skipped " << Skipped << " functions");
+
+    return true;
+  }
+};
+
+char EarlyOptimizePass::ID = 0;
+
+using Register = RegisterPass<EarlyOptimizePass>;
+static Register R("early-optimize",
+                  "Run the early optimization sequence on the functions that "
+                  "changed since they last went through it",
+                  false,
+                  false);
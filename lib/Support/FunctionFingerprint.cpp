@@ -0,0 +1,215 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <string>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/IR/Attributes.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include "revng/Support/Assert.h"
+
+#include "revng-c/Support/FunctionFingerprint.h"
+#include "revng-c/Support/IRHelpers.h"
+
+using namespace llvm;
+
+namespace {
+
+class IRHasher {
+private:
+  raw_string_ostream &OS;
+  DenseMap<const Value *, unsigned> LocalIDs;
+
+public:
+  IRHasher(raw_string_ostream &OS) : OS(OS) {}
+
+public:
+  void hash(const Function &F) {
+    for (const Argument &Arg : F.args())
+      LocalIDs[&Arg] = LocalIDs.size();
+
+    for (const BasicBlock &BB : F) {
+      LocalIDs[&BB] = LocalIDs.size();
+      for (const Instruction &I : BB)
+        LocalIDs[&I] = LocalIDs.size();
+    }
+
+    // The C code depends on whether parentheses have been made explicit
+    if (F.getMetadata(ExplicitParenthesesMDName))
+      OS << "explicit-parentheses\n";
+
+    hashAttributes(F.getAttributes());
+
+    for (const auto &I : instructions(F)) {
+      OS << LocalIDs.at(&I) << " = " << I.getOpcodeName() << " ";
+      I.getType()->print(OS);
+
+      // nsw, nuw, exact and the fast-math flags
+      OS << " " << I.getRawSubclassOptionalData();
+
+      if (auto *Cmp = dyn_cast<CmpInst>(&I))
+        OS << " " << CmpInst::getPredicateName(Cmp->getPredicate());
+
+      for (const Use &Op : I.operands()) {
+        OS << " ";
+        hashOperand(Op.get());
+      }
+
+      // Passes such as SimplifyCFG look at the attributes of the callees, e.g.
+      // noreturn and nounwind, which live out of the body of F
+      if (auto *Call = dyn_cast<CallBase>(&I)) {
+        hashAttributes(Call->getAttributes());
+        if (const Function *Callee = Call->getCalledFunction())
+          hashAttributes(Callee->getAttributes());
+      }
+
+      OS << "\n";
+    }
+  }
+
+private:
+  void hashAttributes(const AttributeList &Attributes) {
+    OS << " [";
+    for (unsigned Index : Attributes.indexes()) {
+      AttributeSet Set = Attributes.getAttributes(Index);
+      OS << Index << ":" << Set.getAsString() << ";";
+    }
+    OS << "]";
+  }
+
+  void hashOperand(const Value *V) {
+    if (auto It = LocalIDs.find(V); It != LocalIDs.end()) {
+      OS << "%" << It->second;
+      return;
+    }
+
+    if (auto *G = dyn_cast<GlobalValue>(V)) {
+      if (G->hasName()) {
+        OS << "@" << G->getName();
+        return;
+      }
+
+      // Unnamed globals are numbered by the module, look at their content
+      auto *Var = dyn_cast<GlobalVariable>(G);
+      if (Var != nullptr and Var->hasInitializer()) {
+        hashConstant(Var->getInitializer());
+        return;
+      }
+
+      revng_abort("Unexpected unnamed global value");
+    }
+
+    if (auto *C = dyn_cast<Constant>(V)) {
+      hashConstant(C);
+      return;
+    }
+
+    if (auto *MD = dyn_cast<MetadataAsValue>(V)) {
+      hashMetadata(MD->getMetadata());
+      return;
+    }
+
+    // Inline asm
+    V->printAsOperand(OS, /* PrintType */ true);
+  }
+
+  void hashConstant(const Constant *C) {
+    if (auto *CDS = dyn_cast<ConstantDataSequential>(C);
+        CDS != nullptr and CDS->isString()) {
+      OS << "c\"" << CDS->getRawDataValues() << "\"";
+      return;
+    }
+
+    // Expressions and aggregates can refer to unnamed globals, which would be
+    // printed with their module-wide number
+    if (auto *CE = dyn_cast<ConstantExpr>(C)) {
+      OS << CE->getOpcodeName() << "(";
+      for (const Use &Op : CE->operands()) {
+        hashOperand(Op.get());
+        OS << ",";
+      }
+      OS << ")";
+      return;
+    }
+
+    if (isa<ConstantAggregate>(C)) {
+      C->getType()->print(OS);
+      OS << "{";
+      for (const Use &Op : C->operands()) {
+        hashOperand(Op.get());
+        OS << ",";
+      }
+      OS << "}";
+      return;
+    }
+
+    C->printAsOperand(OS, /* PrintType */ true);
+  }
+
+  /// Metadata are printed with a module-wide numbering, and only the operands
+  /// of the instructions are hashed, so recur in their content
+  void hashMetadata(const Metadata *MD) {
+    if (MD == nullptr) {
+      OS << "null";
+    } else if (auto *String = dyn_cast<MDString>(MD)) {
+      OS << "!\"" << String->getString() << "\"";
+    } else if (auto *Value = dyn_cast<ValueAsMetadata>(MD)) {
+      hashOperand(Value->getValue());
+    } else if (auto *Node = dyn_cast<MDNode>(MD)) {
+      OS << "!{";
+      for (const MDOperand &Op : Node->operands()) {
+        hashMetadata(Op.get());
+        OS << ",";
+      }
+      OS << "}";
+    } else {
+      revng_abort("Unexpected metadata");
+    }
+  }
+};
+
+} // namespace
+
+static StringRef getMDName(StringRef Name, SmallVectorImpl<char> &Buffer) {
+  return (Twine(FingerprintMDPrefix) + Name).toStringRef(Buffer);
+}
+
+uint64_t hashFunctionIR(const Function &F) {
+  std::string Buffer;
+  {
+    raw_string_ostream OS(Buffer);
+    IRHasher Hasher(OS);
+    Hasher.hash(F);
+  }
+  return xxHash64(Buffer);
+}
+
+std::optional<uint64_t> getRecordedFingerprint(const Function &F,
+                                               StringRef Name) {
+  SmallString<64> Buffer;
+  MDNode *Node = F.getMetadata(getMDName(Name, Buffer));
+  if (Node == nullptr)
+    return std::nullopt;
+
+  auto *Value = mdconst::extract<ConstantInt>(Node->getOperand(0));
+  return Value->getZExtValue();
+}
+
+void recordFingerprint(Function &F, StringRef Name, uint64_t Fingerprint) {
+  LLVMContext &Context = F.getContext();
+  auto *Value = ConstantInt::get(Type::getInt64Ty(Context), Fingerprint);
+  SmallString<64> Buffer;
+  F.setMetadata(getMDName(Name, Buffer),
+                MDTuple::get(Context, { ConstantAsMetadata::get(Value) }));
+}
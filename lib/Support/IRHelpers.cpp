@@ -172,12 +172,9 @@ bool hasSegmentKeyMetadata(const llvm::Function &F) {
 std::pair<MetaAddress, uint64_t>
 extractSegmentKeyFromMetadata(const llvm::Function &F) {
   using namespace llvm;
-  revng_assert(hasSegmentKeyMetadata(F));
 
-  auto &Ctx = F.getContext();
-
-  auto SegmentRefMDKind = Ctx.getMDKindID(SegmentRefMDName);
-  auto *Node = F.getMetadata(SegmentRefMDKind);
+  auto *Node = F.getMetadata(SegmentRefMDName);
+  revng_assert(Node != nullptr);
 
   auto *SAMD = cast<MDString>(Node->getOperand(0));
   MetaAddress StartAddress = MetaAddress::fromString(SAMD->getString());
@@ -225,12 +222,9 @@ bool hasStringLiteralMetadata(const llvm::Function &F) {
 std::tuple<MetaAddress, uint64_t, uint64_t, uint64_t>
 extractStringLiteralFromMetadata(const llvm::Function &F) {
   using namespace llvm;
-  revng_assert(hasStringLiteralMetadata(F));
 
-  auto &Ctx = F.getContext();
-
-  auto StringLiteralMDKind = Ctx.getMDKindID(StringLiteralMDName);
-  auto *Node = F.getMetadata(StringLiteralMDKind);
+  auto *Node = F.getMetadata(StringLiteralMDName);
+  revng_assert(Node != nullptr);
 
   auto *SAMD = cast<ConstantAsMetadata>(Node->getOperand(0))->getValue();
   auto *SAConstant = cast<Constant>(SAMD);
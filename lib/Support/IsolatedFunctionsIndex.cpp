@@ -0,0 +1,118 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/FunctionTags.h"
+#include "revng/Support/IRHelpers.h"
+
+#include "revng-c/Support/IsolatedFunctionsIndex.h"
+
+using namespace llvm;
+
+static constexpr const char *IndexMDName = "revng.isolated-functions";
+
+static void materialize(Function &F) {
+  if (not F.isMaterializable())
+    return;
+
+  if (Error E = F.materialize())
+    revng_abort(toString(std::move(E)).c_str());
+}
+
+void writeIsolatedFunctionsIndex(Module &M) {
+  if (NamedMDNode *Previous = M.getNamedMetadata(IndexMDName))
+    M.eraseNamedMetadata(Previous);
+
+  LLVMContext &Context = M.getContext();
+  NamedMDNode *Index = M.getOrInsertNamedMetadata(IndexMDName);
+  for (Function &F : FunctionTags::Isolated.functions(&M)) {
+    if (F.empty())
+      continue;
+
+    MetaAddress Entry = getMetaAddressMetadata(&F, "revng.function.entry");
+    Metadata *Operands[] = { ConstantAsMetadata::get(&F),
+                             MDString::get(Context, Entry.toString()) };
+    Index->addOperand(MDTuple::get(Context, Operands));
+  }
+}
+
+std::map<MetaAddress, Function *> readIsolatedFunctionsIndex(Module &M) {
+  if (Error E = M.materializeMetadata())
+    revng_abort(toString(std::move(E)).c_str());
+
+  std::map<MetaAddress, Function *> Result;
+  NamedMDNode *Index = M.getNamedMetadata(IndexMDName);
+  if (Index == nullptr)
+    return Result;
+
+  for (const MDNode *Entry : Index->operands()) {
+    // Functions deleted after the index was written leave a null operand
+    auto *F = mdconst::extract_or_null<Function>(Entry->getOperand(0));
+    if (F == nullptr)
+      continue;
+
+    auto *Address = cast<MDString>(Entry->getOperand(1));
+    Result[MetaAddress::fromString(Address->getString())] = F;
+  }
+
+  return Result;
+}
+
+void materializeWithCallees(Function &F) {
+  materialize(F);
+  for (Instruction &I : instructions(F))
+    if (auto *Call = dyn_cast<CallInst>(&I))
+      if (Function *Callee = Call->getCalledFunction())
+        materialize(*Callee);
+}
+
+std::unique_ptr<Module> loadModuleLazily(StringRef Path, LLVMContext &Context) {
+  SMDiagnostic Error;
+  std::unique_ptr<Module> Result = getLazyIRFileModule(Path, Error, Context);
+  if (Result == nullptr) {
+    Error.print("loadModuleLazily", errs());
+    revng_abort("Could not load the module");
+  }
+  return Result;
+}
+
+namespace {
+
+struct IndexIsolatedFunctionsPass : public ModulePass {
+public:
+  static char ID;
+
+  IndexIsolatedFunctionsPass() : ModulePass(ID) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
+  bool runOnModule(Module &M) override {
+    writeIsolatedFunctionsIndex(M);
+    return true;
+  }
+};
+
+} // namespace
+
+char IndexIsolatedFunctionsPass::ID = 0;
+
+using Register = RegisterPass<IndexIsolatedFunctionsPass>;
+static Register R("index-isolated-functions",
+                  "Record the entry address of the isolated functions in a "
+                  "named metadata, so that they can be found without loading "
+                  "the module entirely",
+                  false,
+                  false);
@@ -2,18 +2,23 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <optional>
 #include <utility>
 
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/GlobalValue.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
 #include "llvm/IR/Value.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include "revng/ABI/FunctionType/Layout.h"
 #include "revng/ADT/RecursiveCoroutine.h"
@@ -205,21 +210,101 @@ const model::QualifiedType llvmIntToModelType(const llvm::Type *LLVMType,
   return ModelType;
 }
 
+// Model types are referenced from the IR through strings in the form
+//
+//     <TypeKind>-<ID>[,C|,P<PointerSize>|,A<ElementCount>]...
+//
+// i.e. the key of the unqualified type followed by the qualifiers, from the
+// outermost to the innermost one. This is much smaller than the YAML
+// serialization of the QualifiedType and it doesn't need a YAML parser, which
+// is still used for strings starting with a YAML document marker, i.e.
+// serialized by older versions.
+
+namespace {
+
+/// The result of parsing a string referencing a model type, which does not
+/// depend on the model it will be resolved against
+struct ParsedTypeReference {
+  std::optional<model::Type::Key> Key;
+
+  /// If Key is set, only the qualifiers are meaningful, otherwise this is the
+  /// type parsed from YAML, not yet bound to a model
+  QualifiedType Type;
+};
+
+} // namespace
+
+static ParsedTypeReference parseTypeReference(llvm::StringRef String) {
+  ParsedTypeReference Result;
+
+  if (String.startswith("---")) {
+    // Try to parse the string as a qualified type (aborts on failure)
+    llvm::yaml::Input YAMLInput(String);
+    YAMLInput >> Result.Type;
+    std::error_code EC = YAMLInput.error();
+    if (EC)
+      revng_abort("Could not deserialize the ModelGEP base type");
+    return Result;
+  }
+
+  auto [KeyString, QualifiersString] = String.split(',');
+  auto [KindName, IDString] = KeyString.rsplit('-');
+  auto Kind = model::TypeKind::fromName(KindName);
+  uint64_t ID = 0;
+  if (Kind == model::TypeKind::Invalid or IDString.getAsInteger(10, ID))
+    revng_abort("Could not deserialize the ModelGEP base type");
+  Result.Key = model::Type::Key{ ID, Kind };
+
+  llvm::SmallVector<llvm::StringRef, 4> Qualifiers;
+  if (not QualifiersString.empty())
+    QualifiersString.split(Qualifiers, ',');
+
+  for (llvm::StringRef Qualifier : Qualifiers) {
+    uint64_t Size = 0;
+    bool HasSize = not Qualifier.drop_front().getAsInteger(10, Size);
+    if (Qualifier == "C")
+      Result.Type.Qualifiers().push_back(model::Qualifier::createConst());
+    else if (Qualifier.startswith("P") and HasSize)
+      Result.Type.Qualifiers().push_back(model::Qualifier::createPointer(Size));
+    else if (Qualifier.startswith("A") and HasSize)
+      Result.Type.Qualifiers().push_back(model::Qualifier::createArray(Size));
+    else
+      revng_abort("Could not deserialize the ModelGEP base type");
+  }
+
+  return Result;
+}
+
 QualifiedType deserializeFromLLVMString(llvm::Value *V,
                                         const model::Binary &Model) {
   // Try to get a string out of the llvm::Value
   llvm::StringRef BaseTypeString = extractFromConstantStringPtr(V);
 
-  // Try to parse the string as a qualified type (aborts on failure)
-  QualifiedType ParsedType;
-  {
-    llvm::yaml::Input YAMLInput(BaseTypeString);
-    YAMLInput >> ParsedType;
-    std::error_code EC = YAMLInput.error();
-    if (EC)
-      revng_abort("Could not deserialize the ModelGEP base type");
+  // The same few strings are deserialized over and over. The result of the
+  // parsing only depends on the string, since the reference to the type is
+  // only bound to a model afterwards, so it can be shared among all the models.
+  // The cache is emptied whenever a string from another module shows up, so
+  // that it's bounded by the strings in a single module.
+  static thread_local llvm::StringMap<ParsedTypeReference> Parsed;
+  static thread_local const llvm::Module *ParsedModule = nullptr;
+  const llvm::Module *M = nullptr;
+  if (auto *G = llvm::dyn_cast<llvm::GlobalValue>(V->stripPointerCasts()))
+    M = G->getParent();
+  if (M != ParsedModule) {
+    Parsed.clear();
+    ParsedModule = M;
   }
-  ParsedType.UnqualifiedType().setRoot(&Model);
+
+  auto [It, New] = Parsed.try_emplace(BaseTypeString);
+  if (New)
+    It->second = parseTypeReference(BaseTypeString);
+
+  const ParsedTypeReference &Reference = It->second;
+  QualifiedType ParsedType = Reference.Type;
+  if (Reference.Key.has_value())
+    ParsedType.UnqualifiedType() = Model.getTypePath(*Reference.Key);
+  else
+    ParsedType.UnqualifiedType().setRoot(&Model);
   revng_assert(ParsedType.UnqualifiedType().isValid());
 
   return ParsedType;
@@ -227,12 +312,30 @@ QualifiedType deserializeFromLLVMString(llvm::Value *V,
 
 llvm::Constant *serializeToLLVMString(const model::QualifiedType &QT,
                                       llvm::Module &M) {
-  // Create a string containing a serialization of the model type
+  const model::Type *Unqualified = QT.UnqualifiedType().get();
+  revng_assert(Unqualified != nullptr);
+
   std::string SerializedQT;
   {
     llvm::raw_string_ostream StringStream(SerializedQT);
-    llvm::yaml::Output YAMLOutput(StringStream);
-    YAMLOutput << const_cast<model::QualifiedType &>(QT);
+    StringStream << model::TypeKind::getName(Unqualified->Kind()) << "-"
+                 << Unqualified->ID();
+
+    for (const model::Qualifier &Q : QT.Qualifiers()) {
+      switch (Q.Kind()) {
+      case model::QualifierKind::Const:
+        StringStream << ",C";
+        break;
+      case model::QualifierKind::Pointer:
+        StringStream << ",P" << Q.Size();
+        break;
+      case model::QualifierKind::Array:
+        StringStream << ",A" << Q.Size();
+        break;
+      default:
+        revng_abort();
+      }
+    }
   }
 
   // Build a constant global string containing the serialized type
@@ -475,7 +578,8 @@ getStrongModelInfo(FunctionMetadataCache &Cache,
       } else if (FTags.contains(FunctionTags::SegmentRef)) {
         const auto &[StartAddress,
                      VirtualSize] = extractSegmentKeyFromMetadata(*CalledFunc);
-        auto Segment = Model.Segments().at({ StartAddress, VirtualSize });
+        const auto &Segment = Model.Segments().at({ StartAddress,
+                                                    VirtualSize });
         if (not Segment.Type().empty())
           ReturnTypes.push_back(model::QualifiedType{ Segment.Type(), {} });
 
@@ -679,3 +783,9 @@ getExpectedModelType(FunctionMetadataCache &Cache,
 
   return {};
 }
+
+void prefillFunctionMetadata(FunctionMetadataCache &Cache,
+                             llvm::ArrayRef<const llvm::Function *> Functions) {
+  for (const llvm::Function *F : Functions)
+    Cache.getFunctionMetadata(F);
+}
@@ -0,0 +1,13 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "revng-c/Support/ModelTypeIndex.h"
+
+ModelTypeIndex::ModelTypeIndex(const model::Binary &Model) {
+  Types.reserve(Model.Types().size());
+  for (const UpcastablePointer<model::Type> &Type : Model.Types()) {
+    bool New = Types.try_emplace(toIndexKey(Type->key()), Type.get()).second;
+    revng_assert(New);
+  }
+}
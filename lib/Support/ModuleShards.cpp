@@ -0,0 +1,124 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/FunctionTags.h"
+
+#include "revng-c/Support/ModuleShards.h"
+
+using namespace llvm;
+
+/// Erase the declarations and the global variables that nothing uses anymore.
+/// Erasing a global variable can make unused what its initializer refers to,
+/// hence the fixed point.
+static void pruneUnusedGlobals(Module &M) {
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+
+    for (GlobalVariable &G : make_early_inc_range(M.globals())) {
+      G.removeDeadConstantUsers();
+      if (G.use_empty()) {
+        G.eraseFromParent();
+        Changed = true;
+      }
+    }
+
+    for (Function &F : make_early_inc_range(M.functions())) {
+      if (not F.isDeclaration())
+        continue;
+
+      F.removeDeadConstantUsers();
+      if (F.use_empty()) {
+        F.eraseFromParent();
+        Changed = true;
+      }
+    }
+  }
+}
+
+std::vector<std::unique_ptr<Module>>
+splitIsolatedFunctions(const Module &M, unsigned ShardCount) {
+  revng_assert(ShardCount > 0);
+
+  std::vector<const Function *> Isolated;
+  for (const Function &F : M)
+    if (FunctionTags::Isolated.isTagOf(&F) and not F.isDeclaration())
+      Isolated.push_back(&F);
+
+  // Assign the largest functions first, each one to the smallest shard so far
+  llvm::stable_sort(Isolated, [](const Function *LHS, const Function *RHS) {
+    return LHS->getInstructionCount() > RHS->getInstructionCount();
+  });
+
+  std::vector<DenseSet<const Function *>> Assigned(ShardCount);
+  std::vector<uint64_t> Sizes(ShardCount, 0);
+  for (const Function *F : Isolated) {
+    auto Smallest = std::min_element(Sizes.begin(), Sizes.end());
+    *Smallest += F->getInstructionCount();
+    Assigned[Smallest - Sizes.begin()].insert(F);
+  }
+
+  std::vector<std::unique_ptr<Module>> Result;
+  for (const DenseSet<const Function *> &Functions : Assigned) {
+    // Global variables keep their initializers, the other functions become
+    // declarations
+    const auto ShouldClone = [&Functions](const GlobalValue *GV) {
+      if (auto *F = dyn_cast<Function>(GV))
+        return Functions.contains(F);
+      return true;
+    };
+
+    ValueToValueMapTy VMap;
+    std::unique_ptr<Module> Shard = CloneModule(M, VMap, ShouldClone);
+    pruneUnusedGlobals(*Shard);
+    Result.push_back(std::move(Shard));
+  }
+
+  return Result;
+}
+
+void mergeShard(Module &M, const Module &Shard) {
+  revng_assert(&M.getContext() == &Shard.getContext());
+
+  ValueToValueMapTy VMap;
+  for (const GlobalValue &GV : Shard.global_values()) {
+    revng_assert(GV.hasName(), "Cannot merge back unnamed global values");
+    GlobalValue *Target = M.getNamedValue(GV.getName());
+    revng_assert(Target != nullptr);
+    VMap[&GV] = Target;
+  }
+
+  for (const Function &F : Shard) {
+    if (F.isDeclaration())
+      continue;
+
+    auto *Target = cast<Function>(VMap[&F]);
+
+    // deleteBody resets the linkage
+    GlobalValue::LinkageTypes Linkage = Target->getLinkage();
+    Target->deleteBody();
+
+    auto TargetArgument = Target->arg_begin();
+    for (const Argument &Argument : F.args())
+      VMap[&Argument] = &*TargetArgument++;
+
+    SmallVector<ReturnInst *, 8> Returns;
+    CloneFunctionInto(Target,
+                      &F,
+                      VMap,
+                      CloneFunctionChangeType::DifferentModule,
+                      Returns);
+    Target->setLinkage(Linkage);
+  }
+}
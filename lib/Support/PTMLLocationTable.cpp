@@ -0,0 +1,233 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/MathExtras.h"
+
+#include "revng/PTML/Constants.h"
+#include "revng/Support/Assert.h"
+
+#include "revng-c/Support/PTMLLocationTable.h"
+#include "revng-c/Support/PTMLStripper.h"
+
+using namespace llvm;
+
+namespace ptml {
+
+namespace {
+
+class PTMLSplitter {
+private:
+  using Record = LocationTable::Record;
+
+  struct OpenTag {
+    Record R;
+    bool HasLocations = false;
+  };
+
+private:
+  StringRef Input;
+  size_t Position = 0;
+  LocationTable &Result;
+  StringMap<uint32_t> StringIndices;
+  std::vector<OpenTag> Stack;
+
+public:
+  PTMLSplitter(StringRef Input, LocationTable &Result) :
+    Input(Input), Result(Result) {}
+
+public:
+  void run() {
+    Result.Text.reserve(Input.size());
+
+    while (Position < Input.size()) {
+      char C = Input[Position];
+      if (C == '<')
+        parseTag();
+      else if (C == '&')
+        Result.Text += parseEntity();
+      else
+        Result.Text += Input[Position++];
+    }
+
+    revng_check(Stack.empty(), "Unterminated PTML tag");
+
+    llvm::stable_sort(Result.Records, [](const Record &LHS, const Record &RHS) {
+      if (LHS.Begin != RHS.Begin)
+        return LHS.Begin < RHS.Begin;
+      return LHS.End > RHS.End;
+    });
+  }
+
+private:
+  void parseTag() {
+    revng_assert(Input[Position] == '<');
+    ++Position;
+
+    if (consume('/')) {
+      skipUntil('>');
+      revng_check(not Stack.empty(), "Unbalanced PTML closing tag");
+      closeTag(Stack.back());
+      Stack.pop_back();
+      return;
+    }
+
+    // Skip the tag name
+    while (Position < Input.size() and not isSpace(Input[Position])
+           and Input[Position] != '>' and Input[Position] != '/')
+      ++Position;
+
+    OpenTag Tag;
+    Tag.R.Begin = Result.Text.size();
+
+    while (true) {
+      while (Position < Input.size() and isSpace(Input[Position]))
+        ++Position;
+
+      if (consume('>')) {
+        Stack.push_back(std::move(Tag));
+        return;
+      }
+
+      if (consume('/')) {
+        revng_check(consume('>'), "Invalid PTML tag");
+        closeTag(Tag);
+        return;
+      }
+
+      revng_check(Position < Input.size(), "Unterminated PTML tag");
+
+      size_t NameStart = Position;
+      skipUntil('=');
+      StringRef Name = Input.slice(NameStart, Position - 1).trim();
+      revng_check(consume('"'), "Invalid PTML attribute");
+      size_t ValueStart = Position;
+      skipUntil('"');
+      std::string Value = unescape(Input.slice(ValueStart, Position - 1));
+
+      if (Name == attributes::LocationDefinition) {
+        Tag.R.Definition = intern(Value);
+        Tag.HasLocations = true;
+      } else if (Name == attributes::LocationReferences) {
+        Tag.R.References = intern(Value);
+        Tag.HasLocations = true;
+      } else if (Name == attributes::ActionContextLocation) {
+        Tag.R.ActionContextLocation = intern(Value);
+        Tag.HasLocations = true;
+      } else if (Name == attributes::AllowedActions) {
+        Tag.R.AllowedActions = intern(Value);
+        Tag.HasLocations = true;
+      }
+    }
+  }
+
+  void closeTag(OpenTag &Tag) {
+    if (not Tag.HasLocations)
+      return;
+
+    Tag.R.End = Result.Text.size();
+    Result.Records.push_back(Tag.R);
+  }
+
+  char parseEntity() {
+    revng_assert(Input[Position] == '&');
+    size_t End = Input.find(';', Position);
+    revng_check(End != StringRef::npos, "Unterminated PTML entity");
+    StringRef Entity = Input.slice(Position + 1, End);
+    Position = End + 1;
+    return decodeEntity(Entity);
+  }
+
+  static std::string unescape(StringRef Escaped) {
+    std::string Result;
+    Result.reserve(Escaped.size());
+    while (not Escaped.empty()) {
+      auto [Before, After] = Escaped.split('&');
+      Result += Before;
+      if (Before.size() == Escaped.size())
+        break;
+
+      size_t End = After.find(';');
+      revng_check(End != StringRef::npos, "Unterminated PTML entity");
+      Result += decodeEntity(After.take_front(End));
+      Escaped = After.drop_front(End + 1);
+    }
+    return Result;
+  }
+
+  uint32_t intern(const std::string &Value) {
+    auto [It, IsNew] = StringIndices.try_emplace(Value, Result.Strings.size());
+    if (IsNew)
+      Result.Strings.push_back(Value);
+    return It->second;
+  }
+
+  bool consume(char C) {
+    if (Position < Input.size() and Input[Position] == C) {
+      ++Position;
+      return true;
+    }
+    return false;
+  }
+
+  /// Move past the next occurrence of \p C
+  void skipUntil(char C) {
+    size_t Found = Input.find(C, Position);
+    revng_check(Found != StringRef::npos, "Unterminated PTML tag");
+    Position = Found + 1;
+  }
+
+  static bool isSpace(char C) {
+    return C == ' ' or C == '\t' or C == '\n' or C == '\r';
+  }
+};
+
+} // namespace
+
+LocationTable LocationTable::fromPTML(StringRef PTML) {
+  revng_check(PTML.size() <= UINT32_MAX);
+  LocationTable Result;
+  PTMLSplitter(PTML, Result).run();
+  return Result;
+}
+
+void LocationTable::serialize(raw_ostream &OS) const {
+  using support::endian::write;
+  auto Write32 = [&OS](uint32_t Value) {
+    write<uint32_t>(OS, Value, support::little);
+  };
+
+  OS << "PTMLLOC1";
+  Write32(Text.size());
+  Write32(Records.size());
+  Write32(Strings.size());
+
+  // Keep the integers following the text aligned
+  OS << Text;
+  OS.write_zeros(alignTo(Text.size(), sizeof(uint32_t)) - Text.size());
+
+  for (const Record &R : Records) {
+    Write32(R.Begin);
+    Write32(R.End);
+    Write32(R.Definition);
+    Write32(R.References);
+    Write32(R.ActionContextLocation);
+    Write32(R.AllowedActions);
+  }
+
+  uint32_t Offset = 0;
+  Write32(Offset);
+  for (const std::string &String : Strings) {
+    Offset += String.size();
+    Write32(Offset);
+  }
+
+  for (const std::string &String : Strings)
+    OS << String;
+}
+
+} // namespace ptml
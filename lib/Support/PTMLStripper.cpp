@@ -0,0 +1,130 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <cstring>
+
+#include "revng/Support/Assert.h"
+
+#include "revng-c/Support/PTMLStripper.h"
+
+using namespace llvm;
+
+namespace ptml {
+
+/// Longer entities are not valid PTML, give up on them instead of buffering
+/// the rest of the input
+static constexpr size_t MaxEntitySize = 16;
+
+char decodeEntity(StringRef Entity) {
+  if (Entity == "amp")
+    return '&';
+  if (Entity == "lt")
+    return '<';
+  if (Entity == "gt")
+    return '>';
+  if (Entity == "quot")
+    return '"';
+  if (Entity == "apos")
+    return '\'';
+
+  uint32_t CodePoint = 0;
+  bool Failed = true;
+  if (Entity.consume_front("#x") or Entity.consume_front("#X"))
+    Failed = Entity.getAsInteger(16, CodePoint);
+  else if (Entity.consume_front("#"))
+    Failed = Entity.getAsInteger(10, CodePoint);
+  revng_check(not Failed and CodePoint < 0x80, "Unsupported PTML entity");
+
+  return static_cast<char>(CodePoint);
+}
+
+/// Return the first occurrence of \p C in [\p From, \p End), or \p End.
+/// memchr is vectorized by the C library, which is what keeps the stripper
+/// close to memory bandwidth on the long runs of text between tags.
+static const char *find(const char *From, const char *End, char C) {
+  const void *Found = std::memchr(From, C, End - From);
+  return Found != nullptr ? static_cast<const char *>(Found) : End;
+}
+
+void PTMLStripper::write(StringRef Chunk) {
+  const char *Cursor = Chunk.begin();
+  const char *End = Chunk.end();
+
+  // The next '<' and '&' in the chunk, looked up again only once passed, so
+  // that the chunk is scanned once for each of them
+  const char *NextTag = nullptr;
+  const char *NextEntity = nullptr;
+
+  while (Cursor != End) {
+    switch (State) {
+    case Text: {
+      if (NextTag == nullptr or NextTag < Cursor)
+        NextTag = find(Cursor, End, '<');
+      if (NextEntity == nullptr or NextEntity < Cursor)
+        NextEntity = find(Cursor, End, '&');
+
+      const char *Stop = std::min(NextTag, NextEntity);
+      OS.write(Cursor, Stop - Cursor);
+      Cursor = Stop;
+      if (Cursor != End) {
+        State = *Cursor == '<' ? Tag : Entity;
+        ++Cursor;
+      }
+    } break;
+
+    case Tag: {
+      // Attribute values are quoted, and may contain '>'
+      const char *Close = find(Cursor, End, '>');
+      const char *Quote = find(Cursor, Close, '"');
+      if (Quote != Close) {
+        State = AttributeValue;
+        Cursor = Quote + 1;
+      } else if (Close != End) {
+        State = Text;
+        Cursor = Close + 1;
+      } else {
+        Cursor = End;
+      }
+    } break;
+
+    case AttributeValue: {
+      const char *Quote = find(Cursor, End, '"');
+      if (Quote != End) {
+        State = Tag;
+        Cursor = Quote + 1;
+      } else {
+        Cursor = End;
+      }
+    } break;
+
+    case Entity: {
+      size_t Room = MaxEntitySize - PendingEntity.size();
+      const char *Limit = Cursor + std::min<size_t>(Room, End - Cursor);
+      const char *Semicolon = find(Cursor, Limit, ';');
+      PendingEntity.append(Cursor, Semicolon);
+      revng_check(PendingEntity.size() < MaxEntitySize, "Invalid PTML entity");
+
+      if (Semicolon != Limit) {
+        OS << decodeEntity(PendingEntity);
+        PendingEntity.clear();
+        State = Text;
+        Cursor = Semicolon + 1;
+      } else {
+        Cursor = Limit;
+      }
+    } break;
+
+    default:
+      revng_abort();
+    }
+  }
+}
+
+void PTMLStripper::finish() {
+  revng_check(State != Entity, "Unterminated PTML entity");
+  revng_check(State == Text, "Unterminated PTML tag");
+}
+
+} // namespace ptml
@@ -0,0 +1,182 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+/// Pass collecting, for each LLVM pass run by the revng-c pipeline steps, the
+/// instruction count changes, peak memory and wall time.
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <sys/resource.h>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/DiagnosticHandler.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassTimingInfo.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Assert.h"
+
+using namespace llvm;
+
+static cl::opt<std::string> PassProfilePrefix("pass-profile",
+                                              cl::desc("profile the LLVM "
+                                                       "passes of the revng-c "
+                                                       "pipeline steps, "
+                                                       "writing "
+                                                       "<prefix>.csv and "
+                                                       "<prefix>.timing.txt"),
+                                              cl::value_desc("prefix"));
+
+namespace {
+
+/// Collects the size-info remarks that the legacy pass manager emits after
+/// each pass that changed the instruction count of the module, forwarding
+/// all the other diagnostics to the handler it replaced.
+///
+/// The profile is written when the LLVMContext, which owns the handler, is
+/// destroyed.
+class PassProfileHandler : public DiagnosticHandler {
+private:
+  struct PassProfile {
+    unsigned Changes = 0;
+    int64_t InstructionsDelta = 0;
+    uint64_t LastInstructionCount = 0;
+    long PeakRSSKiB = 0;
+  };
+
+private:
+  std::unique_ptr<DiagnosticHandler> Previous;
+  std::map<std::string, PassProfile> Passes;
+
+public:
+  PassProfileHandler(std::unique_ptr<DiagnosticHandler> &&Previous) :
+    Previous(std::move(Previous)) {}
+
+  ~PassProfileHandler() override { write(); }
+
+public:
+  bool handleDiagnostics(const DiagnosticInfo &DI) override {
+    // Drop the per-function size-info remarks, the module-wide ones are
+    // enough
+    using Remark = OptimizationRemarkAnalysis;
+    if (auto *SizeInfo = dyn_cast<Remark>(&DI);
+        SizeInfo != nullptr and SizeInfo->getPassName() == "size-info") {
+      if (SizeInfo->getRemarkName() == "IRSizeChange")
+        record(*SizeInfo);
+      return true;
+    }
+
+    return Previous->handleDiagnostics(DI);
+  }
+
+  bool isAnalysisRemarkEnabled(StringRef PassName) const override {
+    return PassName == "size-info"
+           or Previous->isAnalysisRemarkEnabled(PassName);
+  }
+
+  bool isMissedOptRemarkEnabled(StringRef PassName) const override {
+    return Previous->isMissedOptRemarkEnabled(PassName);
+  }
+
+  bool isPassedOptRemarkEnabled(StringRef PassName) const override {
+    return Previous->isPassedOptRemarkEnabled(PassName);
+  }
+
+  bool isAnyRemarkEnabled() const override { return true; }
+
+private:
+  void record(const OptimizationRemarkAnalysis &Remark) {
+    std::string Pass;
+    int64_t Before = 0;
+    int64_t After = 0;
+    for (const DiagnosticInfoOptimizationBase::Argument &Arg :
+         Remark.getArgs()) {
+      if (Arg.Key == "Pass")
+        Pass = Arg.Val;
+      else if (Arg.Key == "IRInstrsBefore")
+        revng_check(not StringRef(Arg.Val).getAsInteger(10, Before));
+      else if (Arg.Key == "IRInstrsAfter")
+        revng_check(not StringRef(Arg.Val).getAsInteger(10, After));
+    }
+
+    struct rusage Usage;
+    revng_check(getrusage(RUSAGE_SELF, &Usage) == 0);
+
+    PassProfile &Profile = Passes[Pass];
+    ++Profile.Changes;
+    Profile.InstructionsDelta += After - Before;
+    Profile.LastInstructionCount = After;
+    Profile.PeakRSSKiB = std::max(Profile.PeakRSSKiB, Usage.ru_maxrss);
+  }
+
+  void write() const {
+    std::error_code EC;
+    raw_fd_ostream CSV(PassProfilePrefix + ".csv", EC);
+    revng_check(not EC, "Could not open the pass profile");
+
+    CSV << "pass,changes,instructions_delta,instructions_after_last_change,"
+           "peak_rss_kib\n";
+    for (const auto &[Name, Profile] : Passes)
+      CSV << '"' << Name << "\"," << Profile.Changes << ","
+          << Profile.InstructionsDelta << "," << Profile.LastInstructionCount
+          << "," << Profile.PeakRSSKiB << "\n";
+
+    // The pass timers are global: take the report here, otherwise it would be
+    // printed on stderr at shutdown
+    raw_fd_ostream Timing(PassProfilePrefix + ".timing.txt", EC);
+    revng_check(not EC, "Could not open the pass timing profile");
+    reportAndResetTimings(&Timing);
+  }
+};
+
+struct CollectPassProfilePass : public ModulePass {
+public:
+  static char ID;
+
+  CollectPassProfilePass() : ModulePass(ID) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
+  bool runOnModule(Module &M) override {
+    if (PassProfilePrefix.empty())
+      return false;
+
+    // Every llvm-pipe starts with this pass, but the handler has to be
+    // installed only once per LLVMContext
+    static const DiagnosticHandler *Installed = nullptr;
+    LLVMContext &Context = M.getContext();
+    if (Context.getDiagHandlerPtr() == Installed)
+      return false;
+
+    // The legacy pass manager checks whether to time each pass right before
+    // running it, so this affects the passes after this one
+    TimePassesIsEnabled = true;
+
+    auto Handler = std::make_unique<PassProfileHandler>(
+      Context.getDiagnosticHandler());
+    Installed = Handler.get();
+    Context.setDiagnosticHandler(std::move(Handler));
+
+    return false;
+  }
+};
+
+} // namespace
+
+char CollectPassProfilePass::ID = 0;
+
+using Register = RegisterPass<CollectPassProfilePass>;
+static Register R("collect-pass-profile",
+                  "Profile the LLVM passes that follow, if --pass-profile is "
+                  "set",
+                  false,
+                  false);
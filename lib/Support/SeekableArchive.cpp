@@ -0,0 +1,167 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/BinaryByteStream.h"
+#include "llvm/Support/BinaryStreamReader.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/EndianStream.h"
+
+#include "revng/Support/Assert.h"
+
+#include "revng-c/Support/SeekableArchive.h"
+
+using namespace llvm;
+
+namespace revng {
+
+static constexpr StringRef Magic = "RVNGPAK1";
+
+using MemberPair = std::pair<std::string, StringRef>;
+
+Error SeekableArchive::write(ArrayRef<MemberPair> Members,
+                             int Level,
+                             raw_ostream &OS) {
+  using support::endian::write;
+  constexpr auto LE = support::little;
+
+  bool Compress = Level != 0 and zlib::isAvailable();
+  CodecKind Codec = Compress ? Zlib : Store;
+
+  SmallVector<const MemberPair *, 16> Sorted;
+  for (const MemberPair &Member : Members)
+    Sorted.push_back(&Member);
+  llvm::sort(Sorted, [](const MemberPair *LHS, const MemberPair *RHS) {
+    return LHS->first < RHS->first;
+  });
+  revng_assert(std::adjacent_find(Sorted.begin(),
+                                  Sorted.end(),
+                                  [](const MemberPair *LHS,
+                                     const MemberPair *RHS) {
+                                    return LHS->first == RHS->first;
+                                  })
+               == Sorted.end());
+
+  // Compress everything first, the index needs the compressed sizes
+  std::vector<SmallVector<char, 0>> Compressed(Compress ? Sorted.size() : 0);
+  for (size_t I = 0; I < Compressed.size(); ++I)
+    if (Error E = zlib::compress(Sorted[I]->second, Compressed[I], Level))
+      return E;
+
+  OS << Magic;
+  write<uint8_t>(OS, Codec, LE);
+  write<uint32_t>(OS, Sorted.size(), LE);
+
+  uint64_t Offset = 0;
+  for (size_t I = 0; I < Sorted.size(); ++I) {
+    const auto &[Name, Content] = *Sorted[I];
+    uint64_t CompressedSize = Compress ? Compressed[I].size() : Content.size();
+    write<uint32_t>(OS, Name.size(), LE);
+    OS << Name;
+    write<uint64_t>(OS, Offset, LE);
+    write<uint64_t>(OS, CompressedSize, LE);
+    write<uint64_t>(OS, Content.size(), LE);
+    Offset += CompressedSize;
+  }
+
+  for (size_t I = 0; I < Sorted.size(); ++I) {
+    if (Compress)
+      OS << StringRef(Compressed[I].data(), Compressed[I].size());
+    else
+      OS << Sorted[I]->second;
+  }
+
+  return Error::success();
+}
+
+Expected<SeekableArchive> SeekableArchive::open(StringRef Buffer) {
+  if (not Buffer.startswith(Magic))
+    return createStringError(inconvertibleErrorCode(),
+                             "Not a seekable archive");
+
+  BinaryByteStream Stream(Buffer.drop_front(Magic.size()), support::little);
+  BinaryStreamReader Reader(Stream);
+  SeekableArchive Result;
+
+  uint8_t Codec = 0;
+  uint32_t MemberCount = 0;
+  if (Error E = Reader.readInteger(Codec))
+    return std::move(E);
+  if (Error E = Reader.readInteger(MemberCount))
+    return std::move(E);
+
+  if (Codec > Zlib)
+    return createStringError(inconvertibleErrorCode(),
+                             "Unknown codec in seekable archive");
+  Result.Codec = static_cast<CodecKind>(Codec);
+
+  // Every index entry takes at least 28 bytes, don't trust larger counts
+  if (MemberCount > Reader.bytesRemaining() / 28)
+    return createStringError(inconvertibleErrorCode(),
+                             "Truncated seekable archive");
+  Result.Index.reserve(MemberCount);
+
+  for (uint32_t I = 0; I < MemberCount; ++I) {
+    Entry &Member = Result.Index.emplace_back();
+    uint32_t NameSize = 0;
+    if (Error E = Reader.readInteger(NameSize))
+      return std::move(E);
+    if (Error E = Reader.readFixedString(Member.Name, NameSize))
+      return std::move(E);
+    if (Error E = Reader.readInteger(Member.Offset))
+      return std::move(E);
+    if (Error E = Reader.readInteger(Member.CompressedSize))
+      return std::move(E);
+    if (Error E = Reader.readInteger(Member.Size))
+      return std::move(E);
+
+    if (I > 0 and Result.Index[I - 1].Name >= Member.Name)
+      return createStringError(inconvertibleErrorCode(),
+                               "Unsorted seekable archive index");
+  }
+
+  Result.Data = Buffer.take_back(Reader.bytesRemaining());
+  for (const Entry &Member : Result.Index)
+    if (Member.Offset > Result.Data.size()
+        or Member.CompressedSize > Result.Data.size() - Member.Offset)
+      return createStringError(inconvertibleErrorCode(),
+                               "Truncated seekable archive");
+
+  return Result;
+}
+
+const SeekableArchive::Entry *SeekableArchive::find(StringRef Name) const {
+  auto It = llvm::partition_point(Index, [Name](const Entry &Member) {
+    return Member.Name < Name;
+  });
+  if (It == Index.end() or It->Name != Name)
+    return nullptr;
+  return &*It;
+}
+
+Expected<std::string> SeekableArchive::extract(const Entry &Member) const {
+  StringRef Bytes = Data.substr(Member.Offset, Member.CompressedSize);
+  if (Codec == Store)
+    return Bytes.str();
+
+  SmallVector<char, 0> Uncompressed;
+  if (Error E = zlib::uncompress(Bytes, Uncompressed, Member.Size))
+    return std::move(E);
+  return std::string(Uncompressed.data(), Uncompressed.size());
+}
+
+Expected<std::string> SeekableArchive::extract(StringRef Name) const {
+  if (const Entry *Member = find(Name))
+    return extract(*Member);
+
+  return createStringError(inconvertibleErrorCode(),
+                           Twine("No member ") + Name
+                             + " in seekable archive");
+}
+
+} // namespace revng
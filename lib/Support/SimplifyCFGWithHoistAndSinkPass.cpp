@@ -3,31 +3,68 @@
 //
 
 #include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Transforms/Scalar/SimplifyCFG.h"
 
+#include "revng-c/Support/FunctionFingerprint.h"
+
 using namespace llvm;
 
+static cl::opt<unsigned> HoistAndSinkMaxBlocks("simplify-cfg-hoist-and-sink-"
+                                               "max-blocks",
+                                               cl::desc("functions with more "
+                                                        "basic blocks than "
+                                                        "this are simplified "
+                                                        "without hoisting and "
+                                                        "sinking common "
+                                                        "instructions, 0 "
+                                                        "means no limit"),
+                                               cl::init(0));
+
+/// Name of the fingerprint recorded on a function right after it has been
+/// simplified. SimplifyCFG iterates to a fixed point, running it again on an
+/// unchanged function is a no-op.
+static constexpr const char *FingerprintName = "simplify-cfg-with-hoist-and-"
+                                               "sink";
+
 class SimplifyCFGWithHoistAndSinkPass : public FunctionPass {
 public:
   static char ID;
-  SimplifyCFGWithHoistAndSinkPass() : FunctionPass(ID) {}
+
+private:
+  PassBuilder PB;
+
+  /// Registering all the function analyses is not cheap, do it once for all
+  /// the functions
+  FunctionAnalysisManager FAM;
+
+public:
+  SimplifyCFGWithHoistAndSinkPass() : FunctionPass(ID) {
+    PB.registerFunctionAnalyses(FAM);
+  }
 
   void getAnalysisUsage(AnalysisUsage &AU) const override {}
 
   bool runOnFunction(Function &F) override {
-    FunctionPassManager FPM;
-    FPM.addPass(SimplifyCFGPass(SimplifyCFGOptions()
-                                  .convertSwitchRangeToICmp(true)
-                                  .hoistCommonInsts(true)
-                                  .sinkCommonInsts(true)));
+    auto Recorded = getRecordedFingerprint(F, FingerprintName);
+    if (Recorded and *Recorded == hashFunctionIR(F))
+      return false;
 
-    FunctionAnalysisManager FAM;
+    // Looking for common instructions to hoist and sink is super-linear in the
+    // size of the function
+    bool HoistAndSink = HoistAndSinkMaxBlocks == 0
+                        or F.size() <= HoistAndSinkMaxBlocks;
+    SimplifyCFGPass Simplify(SimplifyCFGOptions()
+                               .convertSwitchRangeToICmp(true)
+                               .hoistCommonInsts(HoistAndSink)
+                               .sinkCommonInsts(HoistAndSink));
+    PreservedAnalyses Preserved = Simplify.run(F, FAM);
 
-    PassBuilder PB;
-    PB.registerFunctionAnalyses(FAM);
+    // The results refer to this function, don't keep them around
+    FAM.clear(F, F.getName());
 
-    FPM.run(F, FAM);
-    return true;
+    recordFingerprint(F, FingerprintName, hashFunctionIR(F));
+    return not Preserved.areAllPreserved();
   }
 };
 
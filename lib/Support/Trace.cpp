@@ -0,0 +1,148 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Assert.h"
+
+#include "revng-c/Support/Trace.h"
+
+using namespace llvm;
+
+namespace trace {
+
+bool detail::Enabled = false;
+
+static cl::opt<std::string> TraceOutput("trace-output",
+                                        cl::desc("write a Chrome trace of the "
+                                                 "revng-c timers and counters "
+                                                 "to this path"),
+                                        cl::value_desc("path"),
+                                        cl::callback([](const std::string &S) {
+                                          detail::Enabled = not S.empty();
+                                        }));
+
+namespace {
+
+struct Event {
+  const char *Category = nullptr;
+  const char *Name = nullptr;
+  std::string Detail;
+  uint64_t Start = 0;
+  uint64_t Duration = 0;
+  uint32_t Thread = 0;
+};
+
+/// Collects the events and writes them out when the process exits
+class TraceWriter {
+private:
+  std::mutex Lock;
+  std::vector<Event> Events;
+  std::vector<const Counter *> Counters;
+
+public:
+  ~TraceWriter() {
+    if (detail::Enabled)
+      write();
+  }
+
+public:
+  void record(Event &&E) {
+    std::scoped_lock Guard(Lock);
+    Events.push_back(std::move(E));
+  }
+
+  void registerCounter(const Counter *C) {
+    std::scoped_lock Guard(Lock);
+    Counters.push_back(C);
+  }
+
+private:
+  void write() {
+    std::error_code EC;
+    raw_fd_ostream OS(TraceOutput, EC);
+    revng_check(not EC, "Could not open the trace output");
+
+    uint64_t End = detail::now();
+    json::OStream J(OS);
+    J.object([&] {
+      J.attributeArray("traceEvents", [&] {
+        for (const Event &E : Events) {
+          J.object([&] {
+            J.attribute("cat", E.Category);
+            J.attribute("name", E.Name);
+            J.attribute("ph", "X");
+            J.attribute("pid", 0);
+            J.attribute("tid", E.Thread);
+            J.attribute("ts", E.Start);
+            J.attribute("dur", E.Duration);
+            if (not E.Detail.empty())
+              J.attributeObject("args",
+                                [&] { J.attribute("detail", E.Detail); });
+          });
+        }
+
+        for (const Counter *C : Counters) {
+          J.object([&] {
+            J.attribute("cat", C->category());
+            J.attribute("name", C->name());
+            J.attribute("ph", "C");
+            J.attribute("pid", 0);
+            J.attribute("ts", End);
+            J.attributeObject("args",
+                              [&] { J.attribute("value", C->value()); });
+          });
+        }
+      });
+      J.attribute("displayTimeUnit", "ms");
+    });
+  }
+};
+
+} // namespace
+
+static const auto Epoch = std::chrono::steady_clock::now();
+
+/// Declared after TraceOutput, so that it's destroyed, and written, before it
+static TraceWriter Writer;
+
+uint64_t detail::now() {
+  using namespace std::chrono;
+  auto Elapsed = steady_clock::now() - Epoch;
+  return duration_cast<microseconds>(Elapsed).count();
+}
+
+/// Small, stable identifiers for the threads, in order of first event
+static uint32_t currentThread() {
+  static std::atomic<uint32_t> NextThread = 0;
+  thread_local uint32_t Thread = NextThread++;
+  return Thread;
+}
+
+void detail::recordScope(const char *Category,
+                         const char *Name,
+                         std::string &&Detail,
+                         uint64_t Start,
+                         uint64_t End) {
+  Writer.record({ .Category = Category,
+                  .Name = Name,
+                  .Detail = std::move(Detail),
+                  .Start = Start,
+                  .Duration = End - Start,
+                  .Thread = currentThread() });
+}
+
+void Counter::registerCounter() {
+  // Two threads might get here at the same time, only one registers it
+  if (not Registered.exchange(true))
+    Writer.registerCounter(this);
+}
+
+} // namespace trace
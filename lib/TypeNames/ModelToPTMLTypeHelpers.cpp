@@ -2,12 +2,16 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstdint>
+#include <limits>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
-#include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/ADT/GraphTraits.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Twine.h"
@@ -39,11 +43,22 @@ using Node = TypeInlineHelper::Node;
 using StackTypesMap = std::unordered_map<const model::Function *,
                                          std::set<const model::Type *>>;
 
+static Logger<> InliningLog{ "type-inlining" };
+
 TypeInlineHelper::TypeInlineHelper(const model::Binary &Model) {
   // Create graph that represents type system.
   TypeGraph = buildTypeGraph(Model);
   TypeToNumOfRefs = calculateNumOfOccurences(Model);
   TypesToInline = findTypesToInline(Model, TypeGraph);
+
+  // Each type to inline is referenced exactly once, so the types to inline
+  // form a forest hanging from the types they are inlined in.
+  for (const model::Type *T : TypesToInline) {
+    Node *TypeNode = TypeGraph.TypeToNode.at(T);
+    revng_assert(TypeNode->predecessorCount() == 1);
+    const model::Type *Parent = (*TypeNode->predecessors().begin())->data().T;
+    InlinedChildren[Parent].push_back(T);
+  }
 }
 
 const GraphInfo &TypeInlineHelper::getTypeGraph() const {
@@ -56,9 +71,113 @@ const TypeToNumOfRefsMap &TypeInlineHelper::getTypeToNumOfRefs() const {
   return TypeToNumOfRefs;
 }
 
+/// Assign to each type the index of its strongly connected component in the
+/// type graph, with an iterative version of Tarjan's algorithm.
+static std::unordered_map<const model::Type *, unsigned>
+computeSCCIndices(const GraphInfo &TypeGraph) {
+  constexpr unsigned NotVisited = 0;
+  constexpr unsigned Completed = std::numeric_limits<unsigned>::max();
+
+  // Compact the graph, so that the visit works on indices
+  std::vector<const model::Type *> Types;
+  std::unordered_map<const Node *, unsigned> Index;
+  Types.reserve(TypeGraph.TypeToNode.size());
+  Index.reserve(TypeGraph.TypeToNode.size());
+  for (const auto &[T, N] : TypeGraph.TypeToNode) {
+    Index[N] = Types.size();
+    Types.push_back(T);
+  }
+
+  std::vector<unsigned> EdgeBegin;
+  std::vector<unsigned> Edges;
+  EdgeBegin.reserve(Types.size() + 1);
+  for (const model::Type *T : Types) {
+    EdgeBegin.push_back(Edges.size());
+    for (Node *Child : llvm::children<Node *>(TypeGraph.TypeToNode.at(T)))
+      Edges.push_back(Index.at(Child));
+  }
+  EdgeBegin.push_back(Edges.size());
+
+  std::unordered_map<const model::Type *, unsigned> Result;
+  Result.reserve(Types.size());
+
+  const size_t NumNodes = Types.size();
+  std::vector<unsigned> VisitNumber(NumNodes, NotVisited);
+  std::vector<unsigned> MinVisited(NumNodes, NotVisited);
+  std::vector<unsigned> SCCStack;
+  unsigned NextVisitNumber = NotVisited;
+  unsigned NextSCC = 0;
+
+  struct DFSFrame {
+    unsigned Node;
+    unsigned NextEdge;
+  };
+  std::vector<DFSFrame> DFSStack;
+
+  const auto Visit = [&](unsigned Node) {
+    ++NextVisitNumber;
+    VisitNumber[Node] = NextVisitNumber;
+    MinVisited[Node] = NextVisitNumber;
+    SCCStack.push_back(Node);
+    DFSStack.push_back({ Node, EdgeBegin[Node] });
+  };
+
+  for (unsigned Root = 0; Root < NumNodes; ++Root) {
+    if (VisitNumber[Root] != NotVisited)
+      continue;
+
+    Visit(Root);
+    while (not DFSStack.empty()) {
+      auto &[Node, NextEdge] = DFSStack.back();
+
+      // Visit the next child, if any
+      if (NextEdge != EdgeBegin[Node + 1]) {
+        unsigned Child = Edges[NextEdge];
+        ++NextEdge;
+        if (VisitNumber[Child] == NotVisited)
+          Visit(Child);
+        else
+          MinVisited[Node] = std::min(MinVisited[Node], VisitNumber[Child]);
+        continue;
+      }
+
+      // All the children have been visited
+      unsigned Done = Node;
+      DFSStack.pop_back();
+      if (not DFSStack.empty()) {
+        unsigned Parent = DFSStack.back().Node;
+        MinVisited[Parent] = std::min(MinVisited[Parent], MinVisited[Done]);
+      }
+
+      if (MinVisited[Done] != VisitNumber[Done])
+        continue;
+
+      // Done is the root of an SCC, pop it from the stack
+      unsigned Member = 0;
+      do {
+        Member = SCCStack.back();
+        SCCStack.pop_back();
+        VisitNumber[Member] = Completed;
+        Result[Types[Member]] = NextSCC;
+      } while (Member != Done);
+      ++NextSCC;
+    }
+  }
+
+  return Result;
+}
+
 /// Collect candidates for emitting inline types.
 TypeSet TypeInlineHelper::findTypesToInline(const model::Binary &Model,
                                             const GraphInfo &TypeGraph) {
+  // A type that has an edge towards DependantType is reachable from it iff
+  // they are in the same SCC
+  const auto SCCIndices = computeSCCIndices(TypeGraph);
+  const auto InSameSCC = [&SCCIndices](const model::Type *LHS,
+                                       const model::Type *RHS) {
+    return SCCIndices.at(LHS) == SCCIndices.at(RHS);
+  };
+
   std::unordered_map<const model::Type *, uint64_t> Candidates;
   std::set<const model::Type *> ShouldIgnore;
 
@@ -92,7 +211,7 @@ TypeSet TypeInlineHelper::findTypesToInline(const model::Binary &Model,
         // pointing to itself.
         if (QT.isPointer() or T.get()->key() == DependantType->key()) {
           ShouldIgnore.insert(DependantType);
-        } else if (isReachableFromRootType(T.get(), DependantType, TypeGraph)) {
+        } else if (InSameSCC(T.get(), DependantType)) {
           // Or the type could point to itself on a nested level.
           ShouldIgnore.insert(T.get());
           ShouldIgnore.insert(DependantType);
@@ -191,6 +310,74 @@ TypeSet TypeInlineHelper::collectStackTypes(const model::Binary &Model) const {
   return Result;
 }
 
+TypeInliningInfo::TypeInliningInfo(const model::Binary &Model) :
+  Helper(Model),
+  StackTypesPerFunction(Helper.findStackTypesPerFunction(Model)) {
+  for (const auto &[Function, Types] : StackTypesPerFunction)
+    StackTypes.insert(Types.begin(), Types.end());
+}
+
+/// Everything TypeInlineHelper looks at, i.e. the types, their edges and the
+/// stack frame types of functions.
+///
+/// The results point into the model, so they can only be reused if every type
+/// and function they can refer to is still there, at the same address, with
+/// the same content. These are compared exactly, rather than through a hash,
+/// so that a different model allocated where an old one used to be can't be
+/// mistaken for it.
+using TypeInliningInputs = std::vector<uintptr_t>;
+
+static TypeInliningInputs getTypeInliningInputs(const model::Binary &Model) {
+  TypeInliningInputs Result;
+  auto Append = [&Result](const void *Pointer) {
+    Result.push_back(reinterpret_cast<uintptr_t>(Pointer));
+  };
+
+  Result.push_back(Model.Types().size());
+  for (const UpcastablePointer<model::Type> &T : Model.Types()) {
+    Append(T.get());
+    Result.push_back(T->ID());
+    Result.push_back(static_cast<uintptr_t>(T->Kind()));
+    for (const model::QualifiedType &QT : T->edges()) {
+      Append(QT.UnqualifiedType().getConst());
+      Result.push_back(QT.isPointer());
+      Result.push_back(QT.Qualifiers().size());
+    }
+
+    // Separate the edges of different types
+    Append(nullptr);
+  }
+
+  Result.push_back(Model.Functions().size());
+  for (const model::Function &Function : Model.Functions()) {
+    Append(&Function);
+    if (Function.StackFrameType().empty())
+      Append(nullptr);
+    else
+      Append(Function.StackFrameType().getConst());
+  }
+
+  return Result;
+}
+
+std::shared_ptr<const TypeInliningInfo>
+getTypeInliningInfo(const model::Binary &Model) {
+  static std::mutex Mutex;
+  static TypeInliningInputs LastInputs;
+  static std::shared_ptr<const TypeInliningInfo> Last;
+
+  TypeInliningInputs Inputs = getTypeInliningInputs(Model);
+
+  std::lock_guard Lock(Mutex);
+  if (Last == nullptr or LastInputs != Inputs) {
+    revng_log(InliningLog, "Computing type inlining information");
+    Last = std::make_shared<const TypeInliningInfo>(Model);
+    LastInputs = std::move(Inputs);
+  }
+
+  return Last;
+}
+
 bool declarationIsDefinition(const model::Type *T) {
   return not llvm::isa<model::StructType>(T)
          and not llvm::isa<model::UnionType>(T)
@@ -674,70 +861,22 @@ bool isCandidateForInline(const model::Type *T) {
          or llvm::isa<model::EnumType>(T);
 }
 
-bool TypeInlineHelper::isReachableFromRootType(const model::Type *Type,
-                                               const model::Type *RootType,
-                                               const GraphInfo &TypeGraph) {
-  auto TheTypeToNode = TypeGraph.TypeToNode;
-
-  // Visit all the nodes reachable from RootType.
-  llvm::df_iterator_default_set<Node *> Visited;
-  for ([[maybe_unused]] Node *N :
-       depth_first_ext(TheTypeToNode.at(RootType), Visited))
-    ;
-
-  return Visited.contains(TheTypeToNode.at(Type));
-}
-
-using UPtrTy = UpcastablePointer<model::Type>;
-TypeSet TypeInlineHelper::getNestedTypesToInline(const model::Type *RootType,
-                                                 const UPtrTy &NestedTy) const {
-  model::Type *CurrentTy = NestedTy.get();
-  TypeSet Result;
-  do {
-    Result.insert(CurrentTy);
-    auto
-      ParentNode = TypeGraph.TypeToNode.at(CurrentTy)->predecessors().begin();
-    if ((*ParentNode)->data().T == RootType) {
-      return Result;
-    } else if (TypesToInline.contains((*ParentNode)->data().T)) {
-      CurrentTy = (*ParentNode)->data().T;
-    } else {
-      return {};
-    }
-  } while (CurrentTy);
-
-  return {};
-}
-
 TypeSet
 TypeInlineHelper::getTypesToInlineInTypeTy(const model::Binary &Model,
                                            const model::Type *RootType) const {
+  // The types to inline in RootType are its descendants in the forest of the
+  // types to inline
   TypeSet Result;
-  auto TheTypeToNode = TypeGraph.TypeToNode;
-
-  // Visit all the nodes reachable from RootType.
-  llvm::df_iterator_default_set<Node *> Visited;
-  for ([[maybe_unused]] Node *N :
-       depth_first_ext(TheTypeToNode.at(RootType), Visited))
-    ;
-
-  for (auto &Type : Model.Types()) {
-    if (Visited.contains(TheTypeToNode.at(Type.get()))
-        and TypesToInline.contains(Type.get())
-        and TheTypeToNode.at(Type.get())->predecessorCount() == 1) {
-      auto ParentNode = TheTypeToNode.at(Type.get())->predecessors().begin();
-      // In the case the parent is stack type itself, just insert the type.
-      if ((*ParentNode)->data().T == RootType) {
-        Result.insert(Type.get());
-      } else if (TypesToInline.contains((*ParentNode)->data().T)) {
-        // In the case the parent type is not the type RootType itself, make
-        // sure that the parent is inlinable into the type RootType. NOTE: This
-        // goes as further as possible in opposite direction in order to find
-        // all types that we should inline into the type RootType.
-        auto NestedTypesToInline = getNestedTypesToInline(RootType, Type);
-        Result.merge(NestedTypesToInline);
-      }
-    }
+  llvm::SmallVector<const model::Type *, 8> Worklist = { RootType };
+  while (not Worklist.empty()) {
+    const model::Type *T = Worklist.pop_back_val();
+    auto It = InlinedChildren.find(T);
+    if (It == InlinedChildren.end())
+      continue;
+
+    for (const model::Type *Child : It->second)
+      if (Result.insert(Child).second)
+        Worklist.push_back(Child);
   }
 
   return Result;
@@ -68,6 +68,9 @@ template<bool IsDefinition, ModelFunction FunctionType>
 static std::string getArgumentLocation(llvm::StringRef ArgumentName,
                                        const FunctionType &F,
                                        ptml::PTMLCBuilder &B) {
+  if (B.isGenerateTagLessPTML())
+    return ArgumentName.str();
+
   return B.getTag(ptml::tags::Span, ArgumentName)
     .addAttribute(attributes::Token, tokens::FunctionParameter)
     .addAttribute(B.getLocationAttribute(IsDefinition),
@@ -98,6 +101,9 @@ template<bool IsDefinition>
 static std::string getVariableLocation(llvm::StringRef VariableName,
                                        const model::Function &F,
                                        ptml::PTMLCBuilder &B) {
+  if (B.isGenerateTagLessPTML())
+    return VariableName.str();
+
   return B.getTag(ptml::tags::Span, VariableName)
     .addAttribute(attributes::Token, tokens::Variable)
     .addAttribute(B.getLocationAttribute(IsDefinition),
@@ -2,6 +2,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/DenseSet.h"
+
 #include "mlir/IR/RegionGraphTraits.h"
 
 #include "revng/Support/GraphAlgorithms.h"
@@ -81,6 +83,130 @@ mlir::LogicalResult mlir::clift::LoopOp::verifyRegions() {
   }
 }
 
+//===----------------------------------------------------------------------===//
+// Code for clift::ContinueOp and clift::BreakOp.
+//===----------------------------------------------------------------------===//
+
+/// Whether \p Op is nested in one of \p TargetOps, which does not need to be
+/// its parent, looking no further than the closest `clift.loop` or function
+template<typename... TargetOps>
+static bool isNestedInStatement(mlir::Operation *Op) {
+  for (mlir::Operation *Parent = Op->getParentOp(); Parent != nullptr;
+       Parent = Parent->getParentOp()) {
+    if (mlir::isa<TargetOps...>(Parent))
+      return true;
+    if (mlir::isa<mlir::clift::LoopOp, mlir::clift::FunctionOp>(Parent))
+      return false;
+  }
+  return false;
+}
+
+mlir::LogicalResult mlir::clift::ContinueOp::verify() {
+  using namespace mlir::clift;
+
+  // In a `clift.loop` the continue is one of the terminators of its CFG, hence
+  // it must be right in its region
+  if (mlir::isa<LoopOp>(getOperation()->getParentOp()))
+    return mlir::success();
+
+  if (isNestedInStatement<WhileOp, DoWhileOp>(getOperation()))
+    return mlir::success();
+
+  emitOpError(getOperationName() + " must be in a "
+              + LoopOp::getOperationName() + ", or nested in a "
+              + WhileOp::getOperationName() + " or a "
+              + DoWhileOp::getOperationName() + ".");
+  return mlir::failure();
+}
+
+mlir::LogicalResult mlir::clift::BreakOp::verify() {
+  using namespace mlir::clift;
+
+  if (isNestedInStatement<WhileOp, DoWhileOp, SwitchOp>(getOperation()))
+    return mlir::success();
+
+  emitOpError(getOperationName() + " must be nested in a "
+              + WhileOp::getOperationName() + ", a "
+              + DoWhileOp::getOperationName() + " or a "
+              + SwitchOp::getOperationName() + ".");
+  return mlir::failure();
+}
+
+//===----------------------------------------------------------------------===//
+// Code for the structured statements.
+//===----------------------------------------------------------------------===//
+
+/// Verify that \p Region of \p Op, called \p Name, is an expression region:
+/// a single block computing a value and ending with a `clift.yield` of it
+static mlir::LogicalResult verifyExpressionRegion(mlir::Operation *Op,
+                                                  mlir::Region &Region,
+                                                  llvm::StringRef Name) {
+  if (Region.hasOneBlock() and not Region.front().empty()
+      and mlir::isa<mlir::clift::YieldOp>(Region.front().back()))
+    return mlir::success();
+
+  Op->emitOpError("the " + Name + " region must be a single block ending "
+                  + "with a " + mlir::clift::YieldOp::getOperationName()
+                  + ".");
+  return mlir::failure();
+}
+
+mlir::LogicalResult mlir::clift::ExpressionStatementOp::verifyRegions() {
+  return verifyExpressionRegion(*this, getExpression(), "expression");
+}
+
+mlir::LogicalResult mlir::clift::IfOp::verifyRegions() {
+  return verifyExpressionRegion(*this, getCondition(), "condition");
+}
+
+mlir::LogicalResult mlir::clift::SwitchOp::verify() {
+  mlir::ArrayAttr CaseValues = getCaseValues();
+  if (CaseValues.size() != getCases().size()) {
+    emitOpError(getOperationName() + " must have a list of labels for each "
+                + "case.");
+    return mlir::failure();
+  }
+
+  llvm::DenseSet<int64_t> Labels;
+  for (mlir::Attribute Case : CaseValues) {
+    auto CaseLabels = Case.cast<mlir::DenseI64ArrayAttr>().asArrayRef();
+    if (CaseLabels.empty()) {
+      emitOpError(getOperationName() + " cases must have at least a label.");
+      return mlir::failure();
+    }
+
+    for (int64_t Label : CaseLabels) {
+      if (not Labels.insert(Label).second) {
+        emitOpError(getOperationName() + " has label " + llvm::Twine(Label)
+                    + " in more than one case.");
+        return mlir::failure();
+      }
+    }
+  }
+
+  return mlir::success();
+}
+
+mlir::LogicalResult mlir::clift::SwitchOp::verifyRegions() {
+  return verifyExpressionRegion(*this, getCondition(), "condition");
+}
+
+mlir::LogicalResult mlir::clift::WhileOp::verifyRegions() {
+  return verifyExpressionRegion(*this, getCondition(), "condition");
+}
+
+mlir::LogicalResult mlir::clift::DoWhileOp::verifyRegions() {
+  return verifyExpressionRegion(*this, getCondition(), "condition");
+}
+
+mlir::LogicalResult mlir::clift::ReturnOp::verifyRegions() {
+  // Returning from a function returning `void`
+  if (getValue().empty())
+    return mlir::success();
+
+  return verifyExpressionRegion(*this, getValue(), "value");
+}
+
 //===-----------------------------------------------------------------========//
 // Code for clift::ModuleOp.
 //===----------------------------------------------------------------------===//
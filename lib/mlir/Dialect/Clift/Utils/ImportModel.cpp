@@ -0,0 +1,243 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/ScopeExit.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/ADT/TypeSwitch.h"
+
+#include "revng/Support/Assert.h"
+
+#include "revng-c/TypeNames/ModelTypeNames.h"
+#include "revng-c/mlir/Dialect/Clift/Utils/ImportModel.h"
+
+using namespace mlir::clift;
+
+ModelTypeImporter::ModelTypeImporter(mlir::MLIRContext *Context,
+                                     const model::Binary &Model) :
+  Context(Context), Model(Model) {
+  for (const UpcastablePointer<model::Type> &Type : Model.Types())
+    UsedIDs.insert(Type->ID());
+}
+
+void ModelTypeImporter::importAllTypes() {
+  Cache.reserve(Model.Types().size());
+  for (const UpcastablePointer<model::Type> &Type : Model.Types())
+    get(*Type);
+}
+
+ValueType ModelTypeImporter::get(const model::Type &Type) {
+  if (auto It = Cache.find(Type.ID()); It != Cache.end())
+    return It->second;
+
+  ValueType Result = translate(Type);
+  Cache[Type.ID()] = Result;
+  return Result;
+}
+
+ValueType ModelTypeImporter::get(const model::QualifiedType &Type) {
+  ValueType Result = get(*Type.UnqualifiedType().get());
+
+  // Qualifiers are listed from the outermost to the innermost
+  for (const model::Qualifier &Q : llvm::reverse(Type.Qualifiers())) {
+    auto False = mlir::BoolAttr::get(Context, false);
+    switch (Q.Kind()) {
+    case model::QualifierKind::Const:
+      Result = makeConst(Result);
+      break;
+
+    case model::QualifierKind::Pointer:
+      Result = PointerType::get(Context, Result, Q.Size(), False);
+      break;
+
+    case model::QualifierKind::Array:
+      Result = ArrayType::get(Context, Result, Q.Size(), False);
+      break;
+
+    default:
+      revng_abort();
+    }
+  }
+
+  return Result;
+}
+
+ValueType ModelTypeImporter::translate(const model::Type &Type) {
+  if (auto *Primitive = llvm::dyn_cast<model::PrimitiveType>(&Type)) {
+    auto Kind = static_cast<PrimitiveKind>(Primitive->PrimitiveKind());
+    return PrimitiveType::get(Context,
+                              Kind,
+                              Primitive->Size(),
+                              mlir::BoolAttr::get(Context, false));
+  }
+
+  return DefinedType::get(Context,
+                          translateDefinition(Type),
+                          mlir::BoolAttr::get(Context, false));
+}
+
+TypeDefinition ModelTypeImporter::translateDefinition(const model::Type &Type) {
+  uint64_t ID = Type.ID();
+  std::string Name = Type.name().str().str();
+  auto False = mlir::BoolAttr::get(Context, false);
+
+  // Structs and unions are mutable: register them before translating their
+  // fields, so that the fields can refer to them
+  if (auto *Struct = llvm::dyn_cast<model::StructType>(&Type)) {
+    auto Result = StructType::get(Context, ID);
+    Cache[ID] = DefinedType::get(Context, Result, False);
+
+    llvm::SmallVector<FieldAttr, 8> Fields;
+    for (const model::StructField &Field : Struct->Fields())
+      Fields.push_back(FieldAttr::get(Context,
+                                      Field.Offset(),
+                                      get(Field.Type()),
+                                      Field.name().str()));
+
+    Result.setBody(Name, Struct->Size(), Fields);
+    return Result;
+  }
+
+  if (auto *Union = llvm::dyn_cast<model::UnionType>(&Type)) {
+    auto Result = UnionType::get(Context, ID);
+    Cache[ID] = DefinedType::get(Context, Result, False);
+
+    llvm::SmallVector<FieldAttr, 8> Fields;
+    for (const model::UnionField &Field : Union->Fields())
+      Fields.push_back(FieldAttr::get(Context,
+                                      0,
+                                      get(Field.Type()),
+                                      Field.name().str()));
+
+    Result.setBody(Name, Fields);
+    return Result;
+  }
+
+  // Any other cycle would lead to an infinitely large type
+  bool New = InProgress.insert(ID).second;
+  revng_check(New, "Recursive model type not going through a struct or union");
+  auto Guard = llvm::make_scope_exit([this, ID]() { InProgress.erase(ID); });
+
+  switch (Type.Kind()) {
+  case model::TypeKind::EnumType: {
+    auto &Enum = llvm::cast<model::EnumType>(Type);
+    llvm::SmallVector<EnumFieldAttr, 8> Entries;
+    for (const model::EnumEntry &Entry : Enum.Entries())
+      Entries.push_back(EnumFieldAttr::get(Context,
+                                           Entry.Value(),
+                                           Enum.entryName(Entry)));
+
+    return EnumAttr::get(Context,
+                         ID,
+                         Name,
+                         get(Enum.UnderlyingType()),
+                         Entries);
+  }
+
+  case model::TypeKind::TypedefType: {
+    auto &Typedef = llvm::cast<model::TypedefType>(Type);
+    return TypedefAttr::get(Context, ID, Name, get(Typedef.UnderlyingType()));
+  }
+
+  case model::TypeKind::CABIFunctionType: {
+    auto &Function = llvm::cast<model::CABIFunctionType>(Type);
+    llvm::SmallVector<FunctionArgumentAttr, 8> Arguments;
+    for (const model::Argument &Argument : Function.Arguments())
+      Arguments.push_back(FunctionArgumentAttr::get(Context,
+                                                    get(Argument.Type()),
+                                                    Argument.name().str()));
+
+    return FunctionAttr::get(Context,
+                             ID,
+                             Name,
+                             get(Function.ReturnType()),
+                             Arguments);
+  }
+
+  case model::TypeKind::RawFunctionType: {
+    auto &Function = llvm::cast<model::RawFunctionType>(Type);
+    llvm::SmallVector<FunctionArgumentAttr, 8> Arguments;
+    for (const model::NamedTypedRegister &Argument : Function.Arguments())
+      Arguments.push_back(FunctionArgumentAttr::get(Context,
+                                                    get(Argument.Type()),
+                                                    Argument.name().str()));
+
+    if (not Function.StackArgumentsType().empty()) {
+      model::QualifiedType StackArguments{ Function.StackArgumentsType(), {} };
+      Arguments.push_back(FunctionArgumentAttr::get(Context,
+                                                    get(StackArguments),
+                                                    "_stack_arguments"));
+    }
+
+    return FunctionAttr::get(Context,
+                             ID,
+                             Name,
+                             getReturnType(Function),
+                             Arguments);
+  }
+
+  default:
+    revng_abort("Unexpected model type kind");
+  }
+}
+
+ValueType ModelTypeImporter::makeConst(ValueType Type) {
+  auto True = mlir::BoolAttr::get(Context, true);
+  return llvm::TypeSwitch<mlir::Type, ValueType>(Type)
+    .Case([&](PrimitiveType T) {
+      return PrimitiveType::get(Context, T.getKind(), T.getSize(), True);
+    })
+    .Case([&](PointerType T) {
+      return PointerType::get(Context,
+                              T.getPointeeType(),
+                              T.getPointerSize(),
+                              True);
+    })
+    .Case([&](ArrayType T) {
+      return ArrayType::get(Context,
+                            T.getElementType(),
+                            T.getElementsCount(),
+                            True);
+    })
+    .Case([&](DefinedType T) {
+      return DefinedType::get(Context, T.getElementType(), True);
+    })
+    .Default([](mlir::Type) -> ValueType { revng_abort(); });
+}
+
+ValueType
+ModelTypeImporter::getReturnType(const model::RawFunctionType &Function) {
+  const auto &ReturnValues = Function.ReturnValues();
+  if (ReturnValues.empty())
+    return PrimitiveType::getVoid(Context, 0);
+
+  if (ReturnValues.size() == 1)
+    return get(ReturnValues.begin()->Type());
+
+  // Multiple return values are wrapped in an artificial struct, the same one
+  // the C backend emits
+  using namespace ArtificialTypes;
+  llvm::SmallVector<FieldAttr, 4> Fields;
+  uint64_t Offset = 0;
+  for (const model::NamedTypedRegister &Value : ReturnValues) {
+    std::string FieldName = RetFieldPrefix + std::to_string(Fields.size());
+    Fields.push_back(FieldAttr::get(Context,
+                                    Offset,
+                                    get(Value.Type()),
+                                    FieldName));
+    Offset += *Value.Type().size();
+  }
+
+  std::string Name = (llvm::Twine(RetStructPrefix) + Function.name()).str();
+  auto Result = StructType::get(Context, getFreshID(), Name, Offset, Fields);
+  return DefinedType::get(Context, Result, mlir::BoolAttr::get(Context, false));
+}
+
+uint64_t ModelTypeImporter::getFreshID() {
+  while (UsedIDs.contains(NextFreeID))
+    ++NextFreeID;
+
+  UsedIDs.insert(NextFreeID);
+  return NextFreeID++;
+}
@@ -1,11 +1,19 @@
 //
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
+#include <memory>
 #include <string>
 
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
 
+#include "mlir/Bytecode/BytecodeWriter.h"
 #include "mlir/Dialect/DLTI/DLTI.h"
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
 #include "mlir/IR/BuiltinAttributes.h"
@@ -14,6 +22,8 @@
 #include "mlir/IR/Location.h"
 #include "mlir/IR/MLIRContext.h"
 #include "mlir/IR/Operation.h"
+#include "mlir/IR/SymbolTable.h"
+#include "mlir/IR/Verifier.h"
 #include "mlir/Target/LLVMIR/Dialect/All.h"
 #include "mlir/Target/LLVMIR/Import.h"
 
@@ -26,9 +36,12 @@
 
 namespace revng::pipes {
 
-static constexpr char MLIRModuleMime[] = "text/mlir";
+/// The module is stored in MLIR bytecode, which is much smaller and faster to
+/// write and to parse than textual MLIR. clift-opt can read it as is, and
+/// print it back as text.
+static constexpr char MLIRModuleMime[] = "application/x.mlir+bytecode";
 static constexpr char MLIRModuleName[] = "mlir-module";
-static constexpr char MLIRModuleSuffix[] = ".mlir";
+static constexpr char MLIRModuleSuffix[] = ".mlirbc";
 using MLIRFileContainer = FileContainer<&kinds::MLIRLLVMModule,
                                         MLIRModuleName,
                                         MLIRModuleMime,
@@ -36,6 +49,105 @@ using MLIRFileContainer = FileContainer<&kinds::MLIRLLVMModule,
 
 static pipeline::RegisterDefaultConstructibleContainer<MLIRFileContainer> X;
 
+/// Declares the globals referenced by a function being cloned in a different
+/// module, as they're met
+class DeclarationMaterializer : public llvm::ValueMaterializer {
+private:
+  llvm::Module &Destination;
+
+public:
+  DeclarationMaterializer(llvm::Module &Destination) :
+    Destination(Destination) {}
+
+  llvm::Value *materialize(llvm::Value *V) override {
+    auto *GV = llvm::dyn_cast<llvm::GlobalValue>(V);
+    if (GV == nullptr)
+      return nullptr;
+
+    using llvm::GlobalValue;
+    llvm::Type *ValueType = GV->getValueType();
+    if (auto *FT = llvm::dyn_cast<llvm::FunctionType>(ValueType)) {
+      auto *Result = llvm::Function::Create(FT,
+                                            GlobalValue::ExternalLinkage,
+                                            GV->getName(),
+                                            Destination);
+      if (auto *F = llvm::dyn_cast<llvm::Function>(GV)) {
+        Result->setCallingConv(F->getCallingConv());
+        Result->setAttributes(F->getAttributes());
+      }
+      return Result;
+    }
+
+    return new llvm::GlobalVariable(Destination,
+                                    ValueType,
+                                    false,
+                                    GlobalValue::ExternalLinkage,
+                                    nullptr,
+                                    GV->getName());
+  }
+};
+
+/// Clone \p F in a new module, along with declarations for all the globals it
+/// refers to
+static std::unique_ptr<llvm::Module> extractFunction(const llvm::Function &F) {
+  const llvm::Module &Source = *F.getParent();
+  auto Result = std::make_unique<llvm::Module>(Source.getModuleIdentifier(),
+                                               Source.getContext());
+  Result->setDataLayout(Source.getDataLayout());
+  Result->setTargetTriple(Source.getTargetTriple());
+
+  auto *NewF = llvm::Function::Create(F.getFunctionType(),
+                                      F.getLinkage(),
+                                      F.getName(),
+                                      *Result);
+
+  llvm::ValueToValueMapTy Map;
+  Map[&F] = NewF;
+  for (const auto &[Argument, NewArgument] : llvm::zip(F.args(),
+                                                       NewF->args())) {
+    NewArgument.setName(Argument.getName());
+    Map[&Argument] = &NewArgument;
+  }
+
+  DeclarationMaterializer Materializer(*Result);
+  llvm::SmallVector<llvm::ReturnInst *, 8> Returns;
+  llvm::CloneFunctionInto(NewF,
+                          &F,
+                          Map,
+                          llvm::CloneFunctionChangeType::DifferentModule,
+                          Returns,
+                          "",
+                          nullptr,
+                          nullptr,
+                          &Materializer);
+
+  return Result;
+}
+
+/// Move the content of \p From into \p To. Symbols already in \p To are
+/// only replaced by definitions, everything else in \p From is dropped.
+static void mergeModules(mlir::ModuleOp To,
+                         llvm::StringMap<mlir::Operation *> &Symbols,
+                         mlir::ModuleOp From) {
+  for (mlir::Operation &Op : llvm::make_early_inc_range(*From.getBody())) {
+    auto Symbol = llvm::dyn_cast<mlir::SymbolOpInterface>(&Op);
+    if (not Symbol)
+      continue;
+
+    auto [It, IsNew] = Symbols.try_emplace(Symbol.getName(), &Op);
+    if (IsNew) {
+      Op.moveBefore(To.getBody(), To.getBody()->end());
+    } else if (not Symbol.isDeclaration()) {
+      auto Existing = llvm::cast<mlir::SymbolOpInterface>(It->second);
+      if (Existing.isDeclaration()) {
+        Op.moveBefore(It->second);
+        It->second->erase();
+        It->second = &Op;
+      }
+    }
+  }
+}
+
 class ImportLLVMToMLIRPipe {
 public:
   static constexpr auto Name = "import-llvm-to-mlir";
@@ -65,26 +177,48 @@ public:
     Context.appendDialectRegistry(Registry);
     Context.loadAllAvailableDialects();
 
-    // Let's do the MLIR import on a cloned Module, so we can save the old one
-    // untouched.
+    // The translation consumes the module it's given, so it has to work on
+    // copies. Rather than cloning the whole module at once, first import all
+    // the globals, along with the declarations of all the functions, and then
+    // import one function at a time, so that at most one function is copied
+    // at any given time.
+    const llvm::Module &M = IRContainer.getModule();
+    auto IsNotFunction = [](const llvm::GlobalValue *GV) {
+      return not llvm::isa<llvm::Function>(GV);
+    };
     llvm::ValueToValueMapTy Map;
-    auto ClonedModule = llvm::CloneModule(IRContainer.getModule(), Map);
+    auto Globals = llvm::CloneModule(M, Map, IsNotFunction);
 
     // Import LLVM Dialect.
-    auto ModuleOp = translateLLVMIRToModule(std::move(ClonedModule), &Context);
+    auto ModuleOp = translateLLVMIRToModule(std::move(Globals), &Context);
+    revng_check(ModuleOp);
+
+    llvm::StringMap<mlir::Operation *> Symbols;
+    for (mlir::Operation &Op : *ModuleOp->getBody())
+      if (auto Symbol = llvm::dyn_cast<mlir::SymbolOpInterface>(&Op))
+        Symbols[Symbol.getName()] = &Op;
+
+    for (const llvm::Function &F : M) {
+      if (F.isDeclaration())
+        continue;
+
+      auto FunctionOp = translateLLVMIRToModule(extractFunction(F), &Context);
+      revng_check(FunctionOp);
+      mergeModules(*ModuleOp, Symbols, *FunctionOp);
+    }
 
-    revng_check(ModuleOp->verify().succeeded());
+    revng_check(mlir::succeeded(mlir::verify(*ModuleOp)));
     std::error_code EC;
     llvm::raw_fd_ostream OS(DecompiledFunctionsContainer.getOrCreatePath(), EC);
     revng_check(not EC);
-    ModuleOp->print(OS, mlir::OpPrintingFlags().enableDebugInfo());
+    revng_check(mlir::succeeded(mlir::writeBytecodeToFile(*ModuleOp, OS)));
   }
 
   void print(const pipeline::Context &Ctx,
              llvm::raw_ostream &OS,
              llvm::ArrayRef<std::string> ContainerNames) const {
-    OS << "mlir-translate -import-llvm -mlir-print-debuginfo module.ll -o "
-          "module.mlir\n";
+    OS << "mlir-translate -import-llvm -mlir-print-debuginfo module.ll"
+          " | mlir-opt -emit-bytecode -o module.mlirbc\n";
   }
 };
 
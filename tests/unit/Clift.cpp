@@ -6,6 +6,8 @@
 //
 
 #include <cstdlib>
+#include <thread>
+#include <vector>
 
 #define BOOST_TEST_MODULE Clift
 bool init_unit_test();
@@ -201,4 +203,31 @@ BOOST_AUTO_TEST_CASE(CanWalkPointerTypes) {
   BOOST_TEST(Count == 1);
 }
 
+BOOST_AUTO_TEST_CASE(StructBodiesCanBeSetConcurrently) {
+  auto Int = PrimitiveType::get(&context,
+                                mlir::clift::PrimitiveKind::GenericKind,
+                                4,
+                                mlir::BoolAttr::get(&context, false));
+  auto Field = FieldAttr::get(&context, 0, Int, "field");
+
+  // Every thread sets the same bodies: all of them must succeed and agree
+  constexpr uint64_t TypeCount = 1000;
+  std::vector<std::thread> Threads;
+  for (unsigned I = 0; I < 4; ++I) {
+    Threads.emplace_back([&]() {
+      for (uint64_t ID = 0; ID < TypeCount; ++ID)
+        StructType::get(&context, ID, "s", 4, { Field });
+    });
+  }
+  for (std::thread &Thread : Threads)
+    Thread.join();
+
+  for (uint64_t ID = 0; ID < TypeCount; ++ID) {
+    auto Struct = StructType::get(&context, ID);
+    BOOST_TEST(Struct.isDefinition());
+    BOOST_TEST(Struct.getName() == "s");
+    BOOST_TEST(Struct.getFields().size() == 1);
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -10,10 +10,13 @@ bool init_unit_test();
 #include "boost/test/unit_test.hpp"
 
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include "revng/Support/Assert.h"
 #include "revng/UnitTestHelpers/UnitTestHelpers.h"
 
+#include "revng-c/DataLayoutAnalysis/DLASnapshot.h"
+
 #include "lib/DataLayoutAnalysis/Middleend/DLAStep.h"
 
 namespace dla {
@@ -232,3 +235,60 @@ BOOST_AUTO_TEST_CASE(SimpleInvalidate) {
   BOOST_TEST(SM.getNumSteps() == 5);
   BOOST_TEST(SM.hasValidSchedule());
 }
+
+static std::string takeSnapshot(const LayoutTypeSystem &TS,
+                                unsigned StepIndex = 0) {
+  std::string Result;
+  llvm::raw_string_ostream OS(Result);
+  DLASnapshot::write(TS, {}, OS, StepIndex);
+  return OS.str();
+}
+
+static void buildTypeSystem(LayoutTypeSystem &TS) {
+  auto *Root = TS.createArtificialLayoutType();
+  auto *Equal = TS.createArtificialLayoutType();
+  TS.addEqualityLink(Root, Equal);
+
+  for (uint64_t Offset : { 0, 8, 16 }) {
+    auto *Field = TS.createArtificialLayoutType();
+    Field->Size = 8;
+    TS.addInstanceLink(Offset == 8 ? Equal : Root,
+                       Field,
+                       OffsetExpression(Offset));
+  }
+
+  auto *Pointee = TS.createArtificialLayoutType();
+  Pointee->Size = 4;
+  TS.addPointerLink(Root, Pointee);
+}
+
+BOOST_AUTO_TEST_CASE(ResumeFromCheckpoint) {
+  constexpr unsigned CheckpointAfter = 3;
+
+  LayoutTypeSystem TS;
+  buildTypeSystem(TS);
+
+  StepManager SM;
+  addDefaultSteps(SM, 8);
+  std::string Checkpoint;
+  SM.setCheckpoint(CheckpointAfter,
+                   [&Checkpoint](const LayoutTypeSystem &TS, unsigned Index) {
+                     Checkpoint = takeSnapshot(TS, Index);
+                   });
+  SM.run(TS);
+  BOOST_TEST(not Checkpoint.empty());
+
+  auto MaybeSnapshot = DLASnapshot::read(Checkpoint);
+  revng_check(static_cast<bool>(MaybeSnapshot));
+  BOOST_TEST(MaybeSnapshot->StepIndex == CheckpointAfter);
+
+  LayoutTypeSystem ResumedTS;
+  MaybeSnapshot->restore(ResumedTS);
+  BOOST_TEST(takeSnapshot(ResumedTS, CheckpointAfter) == Checkpoint);
+
+  StepManager ResumedSM;
+  addDefaultSteps(ResumedSM, 8);
+  ResumedSM.run(ResumedTS, nullptr, MaybeSnapshot->StepIndex);
+
+  BOOST_TEST(takeSnapshot(ResumedTS) == takeSnapshot(TS));
+}
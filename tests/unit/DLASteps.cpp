@@ -584,6 +584,112 @@ BOOST_AUTO_TEST_CASE(ComputeNonInterferingComponents_basic) {
   revng_check(not Eq.isRemoved(PtrNode->ID));
 }
 
+// ----------------- DecomposeStridedEdges --------------
+
+static OffsetExpression
+makeOffsetExpr(uint64_t Offset,
+               ArrayRef<uint64_t> Strides,
+               ArrayRef<OffsetExpression::TripCountT> TripCounts) {
+  OffsetExpression OE(Offset);
+  OE.Strides.append(Strides.begin(), Strides.end());
+  OE.TripCounts.append(TripCounts.begin(), TripCounts.end());
+  return OE;
+}
+
+/// Test flattening OffsetExpressions with dense and non-dense levels
+BOOST_AUTO_TEST_CASE(DecomposeStridedEdges_flatten) {
+  using TripCountT = OffsetExpression::TripCountT;
+
+  // int A[3][3] is the same as int A[9]
+  auto Dense = DecomposeStridedEdges::flatten(makeOffsetExpr(8,
+                                                             { 12, 4 },
+                                                             { 3, 3 }));
+  revng_check(Dense.has_value());
+  revng_check(Dense->Offset == 8);
+  revng_check(Dense->Strides.size() == 1 and Dense->Strides[0] == 4);
+  revng_check(Dense->TripCounts.size() == 1);
+  revng_check(Dense->TripCounts[0].value() == 9);
+
+  // The elements are at 0, 4, 16 and 20: the flat array covers the gap too
+  auto NonDense = DecomposeStridedEdges::flatten(makeOffsetExpr(0,
+                                                                { 16, 4 },
+                                                                { 2, 2 }));
+  revng_check(NonDense.has_value());
+  revng_check(NonDense->Strides.size() == 1 and NonDense->Strides[0] == 4);
+  revng_check(NonDense->TripCounts[0].value() == 6);
+
+  // An unknown trip count on any level is unknown on the flat array
+  auto Unknown = DecomposeStridedEdges::flatten(makeOffsetExpr(0,
+                                                               { 16, 4 },
+                                                               { TripCountT(),
+                                                                 2 }));
+  revng_check(Unknown.has_value());
+  revng_check(not Unknown->TripCounts[0].has_value());
+
+  // 6 is not a multiple of 4, there's no flat array with the same elements
+  revng_check(not DecomposeStridedEdges::flatten(makeOffsetExpr(0,
+                                                                { 6, 4 },
+                                                                { 2, 2 })));
+}
+
+/// Build a Root with a single child at offset 8, through a two-level strided
+/// edge, then decompose it
+static LTSN *decomposeTwoLevelEdge(LayoutTypeSystem &TS, bool Constrained) {
+  VerifyLog.enable();
+
+  LTSN *Root = createRoot(TS);
+  LTSN *Child = createRoot(TS, 4U);
+  TS.addInstanceLink(Root, Child, makeOffsetExpr(8, { 16, 4 }, { 2, 2 }));
+
+  if (Constrained)
+    TS.setMemoryConstrained();
+
+  dla::StepManager SM;
+  revng_check(SM.addStep<CollapseEqualitySCC>());
+  revng_check(SM.addStep<CollapseInstanceAtOffset0SCC>());
+  revng_check(SM.addStep<PruneLayoutNodesWithoutLayout>());
+  revng_check(SM.addStep<ComputeUpperMemberAccesses>());
+  revng_check(SM.addStep<DecomposeStridedEdges>());
+  SM.run(TS);
+
+  return Root;
+}
+
+/// Without memory constraints, each level gets its own node
+BOOST_AUTO_TEST_CASE(DecomposeStridedEdges_basic) {
+  dla::LayoutTypeSystem TS;
+  LTSN *Root = decomposeTwoLevelEdge(TS, false);
+
+  revng_check(TS.getNumLayouts() == 3);
+  revng_check(Root->Successors.size() == 1);
+  const auto &[Outer, OuterTag] = *Root->Successors.begin();
+  revng_check(OuterTag->getOffsetExpr().Offset == 8);
+  revng_check(OuterTag->getOffsetExpr().Strides[0] == 16);
+  revng_check(Outer->Size == 8);
+
+  revng_check(Outer->Successors.size() == 1);
+  const auto &[Inner, InnerTag] = *Outer->Successors.begin();
+  revng_check(InnerTag->getOffsetExpr().Offset == 0);
+  revng_check(InnerTag->getOffsetExpr().Strides[0] == 4);
+  revng_check(Inner->Size == 4);
+}
+
+/// With memory constraints, the edge becomes a single flat array, which
+/// over-approximates the non-dense levels
+BOOST_AUTO_TEST_CASE(DecomposeStridedEdges_memoryConstrained) {
+  dla::LayoutTypeSystem TS;
+  LTSN *Root = decomposeTwoLevelEdge(TS, true);
+
+  revng_check(TS.getNumLayouts() == 2);
+  revng_check(Root->Successors.size() == 1);
+  const auto &[Child, Tag] = *Root->Successors.begin();
+  const OffsetExpression &OE = Tag->getOffsetExpr();
+  revng_check(Child->Size == 4);
+  revng_check(OE.Offset == 8);
+  revng_check(OE.Strides.size() == 1 and OE.Strides[0] == 4);
+  revng_check(OE.TripCounts.size() == 1 and OE.TripCounts[0].value() == 6);
+}
+
 // ----------------- Deduplicate Union Fields --------------
 
 BOOST_AUTO_TEST_CASE(DeduplicateFields_basic) {
@@ -807,3 +913,64 @@ BOOST_AUTO_TEST_CASE(DeduplicateFields_commonNodeAsymmetricCollapse) {
   checkNode(TS, NodeC, 10, AllChildrenAreNonInterfering, { 3 });
   checkNode(TS, NodeA1, 8, AllChildrenAreNonInterfering, { 4, 5, 6, 7 });
 }
+
+BOOST_AUTO_TEST_CASE(VectEqClasses_computeEqClass) {
+  VectEqClasses Eq;
+  for (unsigned I = 0; I < 6; ++I)
+    Eq.growBy1();
+
+  Eq.join(4, 1);
+  Eq.join(2, 4);
+  Eq.join(1, 2);
+  Eq.join(3, 5);
+
+  using IDVector = std::vector<unsigned>;
+  revng_check(Eq.computeEqClass(0) == IDVector{ 0 });
+  revng_check(Eq.computeEqClass(4) == (IDVector{ 1, 2, 4 }));
+  revng_check(Eq.computeEqClass(5) == (IDVector{ 3, 5 }));
+
+  Eq.remove(3);
+  Eq.remove(0);
+  revng_check(Eq.computeEqClass(5) == (IDVector{ 0, 3, 5 }));
+
+  Eq.compress();
+  revng_check(Eq.computeEqClass(1) == (IDVector{ 1, 2, 4 }));
+}
+
+BOOST_AUTO_TEST_CASE(LayoutTypeSystem_mergeNodes) {
+  LayoutTypeSystem TS;
+  LTSN *Into = createRoot(TS, 8);
+  LTSN *A = createRoot(TS, 8);
+  LTSN *B = createRoot(TS, 4);
+  LTSN *Parent = createRoot(TS);
+  LTSN *Pointee = createRoot(TS, 4);
+
+  // Links among the merged nodes
+  TS.addInstanceLink(Into, A, OffsetExpression{});
+  TS.addPointerLink(A, B);
+
+  // Links with the rest of the graph, both A and B point to Pointee
+  TS.addInstanceLink(Parent, A, OffsetExpression(8));
+  TS.addInstanceLink(Parent, B, OffsetExpression(16));
+  TS.addPointerLink(A, Pointee);
+  TS.addPointerLink(B, Pointee);
+
+  TS.mergeNodes({ Into, A, B });
+  revng_check(TS.verifyConsistency());
+  revng_check(TS.getNumLayouts() == 3);
+  revng_check(Into->Size == 8);
+
+  // The links among the merged nodes are gone, the duplicated pointer link
+  // is kept only once
+  revng_check(Into->Successors.size() == 1);
+  revng_check(Into->Successors.begin()->first == Pointee);
+  revng_check(Into->Predecessors.size() == 2);
+  for (const auto &[Pred, Tag] : Into->Predecessors)
+    revng_check(Pred == Parent);
+  revng_check(Parent->Successors.size() == 2);
+  revng_check(Pointee->Predecessors.size() == 1);
+
+  const dla::VectEqClasses &Eq = TS.getEqClasses();
+  using IDVector = std::vector<unsigned>;
+  revng_check(Eq.computeEqClass(Into->ID) == (IDVector{ 0, 1, 2 }));
+}
@@ -0,0 +1,54 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#define BOOST_TEST_MODULE FunctionFingerprint
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/Model/Binary.h"
+#include "revng/Support/Assert.h"
+
+#include "lib/Backend/FunctionFingerprint.h"
+
+using namespace llvm;
+
+/// Add to \p Model a struct with a single field of type \p FieldType
+static model::TypePath
+addStruct(model::Binary &Model, const model::QualifiedType &FieldType) {
+  auto NewType = model::makeType<model::StructType>();
+  auto *Struct = cast<model::StructType>(NewType.get());
+  Struct->Fields()[0].Type() = FieldType;
+  Struct->Size() = *FieldType.size();
+  return Model.recordNewType(std::move(NewType));
+}
+
+static model::StructType *getStruct(const model::TypePath &Path) {
+  return cast<model::StructType>(Path.get());
+}
+
+BOOST_AUTO_TEST_CASE(EditNestedType) {
+  model::Binary Model;
+  auto Int32 = Model.getPrimitiveType(model::PrimitiveTypeKind::Signed, 4);
+
+  // struct Outer { struct Inner { int32_t Field; } Field; };
+  model::TypePath Inner = addStruct(Model, model::QualifiedType(Int32, {}));
+  model::TypePath Outer = addStruct(Model, model::QualifiedType(Inner, {}));
+
+  // An unrelated type
+  model::TypePath Other = addStruct(Model, model::QualifiedType(Int32, {}));
+
+  // The function only refers to Outer directly
+  const model::Type *Roots[] = { Outer.getConst() };
+  uint64_t Initial = hashReachableTypes(Model, Roots);
+  revng_check(Initial == hashReachableTypes(Model, Roots));
+
+  // Editing the nested type changes the hash
+  getStruct(Inner)->Fields().at(0).CustomName() = "renamed";
+  uint64_t AfterNestedEdit = hashReachableTypes(Model, Roots);
+  revng_check(AfterNestedEdit != Initial);
+
+  // Editing a type that can't be reached does not
+  getStruct(Other)->Fields().at(0).CustomName() = "renamed";
+  revng_check(AfterNestedEdit == hashReachableTypes(Model, Roots));
+}
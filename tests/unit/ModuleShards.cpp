@@ -0,0 +1,127 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+
+#define BOOST_TEST_MODULE ModuleShards
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/FunctionTags.h"
+
+#include "revng-c/Support/ModuleShards.h"
+
+using namespace llvm;
+
+static const char *Source = R"LLVM(
+@used = global i64 0
+@unused = global i64 0
+
+declare i64 @helper(i64)
+declare void @unrelated()
+
+define i64 @small(i64 %x) {
+  %r = call i64 @helper(i64 %x)
+  ret i64 %r
+}
+
+define i64 @large(i64 %x) {
+  %a = load i64, i64* @used
+  %b = add i64 %a, %x
+  %c = mul i64 %b, %b
+  %d = add i64 %c, 1
+  ret i64 %d
+}
+
+define i64 @medium(i64 %x) {
+  %a = add i64 %x, 1
+  %b = add i64 %a, 2
+  ret i64 %b
+}
+
+define void @not_isolated() {
+  call void @unrelated()
+  ret void
+}
+)LLVM";
+
+static std::unique_ptr<Module> parse(LLVMContext &Context) {
+  SMDiagnostic Error;
+  std::unique_ptr<Module> M = parseAssemblyString(Source, Error, Context);
+  revng_check(M != nullptr);
+  for (const char *Name : { "small", "large", "medium" })
+    FunctionTags::Isolated.addTo(M->getFunction(Name));
+  return M;
+}
+
+BOOST_AUTO_TEST_CASE(ShardsOnlyHoldWhatTheyUse) {
+  LLVMContext Context;
+  std::unique_ptr<Module> M = parse(Context);
+
+  auto Shards = splitIsolatedFunctions(*M, 2);
+  BOOST_TEST(Shards.size() == 2U);
+
+  // The largest function gets a shard on its own
+  const Module &First = *Shards[0];
+  BOOST_TEST(not First.getFunction("large")->isDeclaration());
+  BOOST_TEST(First.getFunction("small") == nullptr);
+  BOOST_TEST(First.getFunction("helper") == nullptr);
+  BOOST_TEST(First.getNamedGlobal("used") != nullptr);
+  BOOST_TEST(First.getNamedGlobal("unused") == nullptr);
+
+  const Module &Second = *Shards[1];
+  BOOST_TEST(not Second.getFunction("small")->isDeclaration());
+  BOOST_TEST(not Second.getFunction("medium")->isDeclaration());
+  BOOST_TEST(Second.getFunction("helper")->isDeclaration());
+  BOOST_TEST(Second.getFunction("large") == nullptr);
+  BOOST_TEST(Second.getFunction("not_isolated") == nullptr);
+  BOOST_TEST(Second.getFunction("unrelated") == nullptr);
+  BOOST_TEST(Second.getNamedGlobal("used") == nullptr);
+
+  for (const auto &Shard : Shards)
+    BOOST_TEST(not verifyModule(*Shard, &errs()));
+
+  // The original module is untouched
+  BOOST_TEST(M->getNamedGlobal("unused") != nullptr);
+  BOOST_TEST(not M->getFunction("not_isolated")->isDeclaration());
+}
+
+BOOST_AUTO_TEST_CASE(MergingBringsBackTheBodies) {
+  LLVMContext Context;
+  std::unique_ptr<Module> M = parse(Context);
+
+  auto Shards = splitIsolatedFunctions(*M, 2);
+
+  // Change the body of large in its shard
+  Function *Large = Shards[0]->getFunction("large");
+  auto *Return = cast<ReturnInst>(Large->getEntryBlock().getTerminator());
+  Return->setOperand(0, Large->getArg(0));
+
+  for (const auto &Shard : Shards)
+    mergeShard(*M, *Shard);
+
+  BOOST_TEST(not verifyModule(*M, &errs()));
+
+  Function *MergedLarge = M->getFunction("large");
+  BOOST_TEST(FunctionTags::Isolated.isTagOf(MergedLarge));
+  auto *MergedReturn = cast<ReturnInst>(MergedLarge->getEntryBlock()
+                                          .getTerminator());
+  BOOST_TEST(MergedReturn->getReturnValue() == MergedLarge->getArg(0));
+
+  // References to global values point back to the original module
+  auto *Load = cast<LoadInst>(&*MergedLarge->getEntryBlock().begin());
+  BOOST_TEST(Load->getPointerOperand() == M->getNamedGlobal("used"));
+
+  Function *MergedSmall = M->getFunction("small");
+  auto *Call = cast<CallInst>(&*MergedSmall->getEntryBlock().begin());
+  BOOST_TEST(Call->getCalledFunction() == M->getFunction("helper"));
+}
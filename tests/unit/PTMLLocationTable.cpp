@@ -0,0 +1,76 @@
+/// \file PTMLLocationTable.cpp
+/// Tests for ptml::LocationTable
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#define BOOST_TEST_MODULE PTMLLocationTable
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/Support/Endian.h"
+
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+#include "revng-c/Support/PTMLLocationTable.h"
+
+using Record = ptml::LocationTable::Record;
+static constexpr uint32_t None = ptml::LocationTable::NoString;
+
+BOOST_AUTO_TEST_CASE(PlainText) {
+  auto Table = ptml::LocationTable::fromPTML("int x = a &lt;&lt; 1;");
+  BOOST_TEST(Table.Text == "int x = a << 1;");
+  BOOST_TEST(Table.Records.empty());
+  BOOST_TEST(Table.Strings.empty());
+}
+
+BOOST_AUTO_TEST_CASE(NestedLocations) {
+  const char *PTML = R"(<div data-scope="body">)"
+                     R"(<span data-token="type" )"
+                     R"(data-location-definition="/t/1" )"
+                     R"(data-action-context-location="/t/1">)"
+                     R"(<span data-location-references="/f/&quot;a&quot;">)"
+                     R"(foo</span>_t</span> x;</div>)";
+  auto Table = ptml::LocationTable::fromPTML(PTML);
+  BOOST_TEST(Table.Text == "foo_t x;");
+  BOOST_TEST(Table.Strings.size() == 2U);
+  BOOST_TEST(Table.Strings[0] == "/t/1");
+  BOOST_TEST(Table.Strings[1] == "/f/\"a\"");
+
+  // The outer range comes first
+  BOOST_TEST(Table.Records.size() == 2U);
+  bool OuterMatches = Table.Records[0] == Record{ 0, 5, 0, None, 0, None };
+  BOOST_TEST(OuterMatches);
+  bool InnerMatches = Table.Records[1] == Record{ 0, 3, None, 1, None, None };
+  BOOST_TEST(InnerMatches);
+}
+
+BOOST_AUTO_TEST_CASE(DefinitionAndReferences) {
+  const char *PTML = R"(<span data-location-definition="/f/1" )"
+                     R"(data-location-references="/t/2">f</span>)";
+  auto Table = ptml::LocationTable::fromPTML(PTML);
+  BOOST_TEST(Table.Records.size() == 1U);
+  bool Matches = Table.Records[0] == Record{ 0, 1, 0, 1, None, None };
+  BOOST_TEST(Matches);
+}
+
+BOOST_AUTO_TEST_CASE(Serialize) {
+  auto Table = ptml::LocationTable::fromPTML(R"(<span data-location-)"
+                                             R"(references="/s/x">x</span>)");
+  std::string Serialized;
+  llvm::raw_string_ostream OS(Serialized);
+  Table.serialize(OS);
+  OS.flush();
+
+  // Magic, 3 sizes, 1 byte of text padded to 4, 1 record, 2 offsets, 4 bytes
+  // of strings
+  BOOST_TEST(Serialized.size() == 8U + 3 * 4 + 4 + 6 * 4 + 2 * 4 + 4);
+  BOOST_TEST(llvm::StringRef(Serialized).startswith("PTMLLOC1"));
+  BOOST_TEST(llvm::StringRef(Serialized).endswith("/s/x"));
+
+  // The record is aligned, and refers to the only string
+  BOOST_TEST(Serialized.substr(8 + 3 * 4 + 1, 3) == std::string(3, '\0'));
+  const char *FirstRecord = Serialized.data() + 8 + 3 * 4 + 4;
+  BOOST_TEST(llvm::support::endian::read32le(FirstRecord + 3 * 4) == 0U);
+}
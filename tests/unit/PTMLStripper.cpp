@@ -0,0 +1,43 @@
+/// \file PTMLStripper.cpp
+/// Tests for ptml::PTMLStripper
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#define BOOST_TEST_MODULE PTMLStripper
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+#include "revng-c/Support/PTMLLocationTable.h"
+#include "revng-c/Support/PTMLStripper.h"
+
+static const char *PTML = R"(<div data-scope="body">)"
+                          R"(<span data-token="type" )"
+                          R"(data-location-definition="/t/1&amp;2">)"
+                          R"(int</span> x = a &lt;&lt; 1&#59;)"
+                          R"(<span data-attr=">"/></div>)";
+
+BOOST_AUTO_TEST_CASE(WholeInput) {
+  BOOST_TEST(ptml::stripPTML(PTML) == "int x = a << 1;");
+}
+
+BOOST_AUTO_TEST_CASE(MatchesLocationTable) {
+  BOOST_TEST(ptml::stripPTML(PTML) == ptml::LocationTable::fromPTML(PTML).Text);
+}
+
+BOOST_AUTO_TEST_CASE(SplitAnywhere) {
+  llvm::StringRef Input(PTML);
+  for (size_t Split = 0; Split <= Input.size(); ++Split) {
+    std::string Result;
+    llvm::raw_string_ostream OS(Result);
+    ptml::PTMLStripper Stripper(OS);
+    Stripper.write(Input.take_front(Split));
+    Stripper.write(Input.drop_front(Split));
+    Stripper.finish();
+    OS.flush();
+    BOOST_TEST(Result == "int x = a << 1;");
+  }
+}
@@ -0,0 +1,185 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+
+#define BOOST_TEST_MODULE RestructureCFG
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include "revng/Support/Assert.h"
+
+#include "revng-c/RestructureCFG/ASTNode.h"
+#include "revng-c/RestructureCFG/ASTTree.h"
+#include "revng-c/RestructureCFG/RestructureCFG.h"
+#include "revng-c/Support/FunctionTags.h"
+
+using namespace llvm;
+
+static const char *ModuleText = R"LLVM(
+define void @single_path(i32 %x) {
+entry:
+  br label %middle
+
+middle:
+  br label %exit
+
+exit:
+  ret void
+}
+
+define void @diamond(i1 %a) {
+entry:
+  br i1 %a, label %then, label %else
+
+then:
+  br label %exit
+
+else:
+  br label %exit
+
+exit:
+  ret void
+}
+
+define void @join_without_branch(i1 %a) {
+entry:
+  br i1 %a, label %then, label %exit
+
+then:
+  br label %exit
+
+exit:
+  ret void
+}
+
+define void @nested_diamond(i1 %a, i1 %b) {
+entry:
+  br i1 %a, label %then, label %else
+
+then:
+  br i1 %b, label %inner_then, label %inner_else
+
+inner_then:
+  br label %inner_exit
+
+inner_else:
+  br label %inner_exit
+
+inner_exit:
+  br label %exit
+
+else:
+  br label %exit
+
+exit:
+  ret void
+}
+
+define void @early_return(i1 %a) {
+entry:
+  br i1 %a, label %early, label %late
+
+early:
+  ret void
+
+late:
+  ret void
+}
+
+define void @loop(i1 %a) {
+entry:
+  br label %header
+
+header:
+  br i1 %a, label %header, label %exit
+
+exit:
+  ret void
+}
+)LLVM";
+
+namespace {
+
+struct RestructuredFunction {
+  LLVMContext Context;
+  std::unique_ptr<llvm::Module> M;
+  ASTTree GHAST;
+
+  explicit RestructuredFunction(StringRef Name) {
+    SMDiagnostic Error;
+    M = parseAssemblyString(ModuleText, Error, Context);
+    revng_check(M);
+
+    Function *F = M->getFunction(Name);
+    revng_check(F != nullptr);
+    FunctionTags::Isolated.addTo(F);
+
+    // restructureCFG can add blocks, look at the ones we started with
+    SmallVector<const BasicBlock *, 4> Original;
+    for (const BasicBlock &BB : *F)
+      Original.push_back(&BB);
+
+    revng_check(restructureCFG(*F, GHAST));
+
+    // No basic block can be lost along the way
+    for (const BasicBlock *BB : Original) {
+      auto HasBB = [BB](const auto &Node) { return Node->getBB() == BB; };
+      revng_check(any_of(GHAST.nodes(), HasBB));
+    }
+  }
+
+  size_t count(ASTNode::NodeKind Kind) {
+    return count_if(GHAST.nodes(), [Kind](const auto &Node) {
+      return Node->getKind() == Kind;
+    });
+  }
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(SinglePath) {
+  RestructuredFunction R("single_path");
+  revng_check(R.count(ASTNode::NK_If) == 0);
+  revng_check(R.count(ASTNode::NK_Scs) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(Diamond) {
+  RestructuredFunction R("diamond");
+  revng_check(R.count(ASTNode::NK_If) == 1);
+  revng_check(R.count(ASTNode::NK_Scs) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(JoinWithoutBranch) {
+  // The exit has two predecessors, so this is not a single path even though
+  // one of them branches straight to it
+  RestructuredFunction R("join_without_branch");
+  revng_check(R.count(ASTNode::NK_If) == 1);
+  revng_check(R.count(ASTNode::NK_Scs) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(NestedDiamond) {
+  RestructuredFunction R("nested_diamond");
+  revng_check(R.count(ASTNode::NK_If) == 2);
+  revng_check(R.count(ASTNode::NK_Scs) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(EarlyReturn) {
+  RestructuredFunction R("early_return");
+  revng_check(R.count(ASTNode::NK_If) == 1);
+  revng_check(R.count(ASTNode::NK_Scs) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(Loop) {
+  RestructuredFunction R("loop");
+  revng_check(R.count(ASTNode::NK_Scs) == 1);
+}
@@ -0,0 +1,155 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+
+#define BOOST_TEST_MODULE RestructuredGHAST
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include "revng/Model/Binary.h"
+#include "revng/Support/Assert.h"
+
+#include "revng-c/RestructureCFG/ASTTree.h"
+#include "revng-c/RestructureCFG/BeautifyGHAST.h"
+#include "revng-c/RestructureCFG/ExprNode.h"
+#include "revng-c/RestructureCFG/RestructureCFG.h"
+#include "revng-c/Support/FunctionFingerprint.h"
+#include "revng-c/Support/FunctionTags.h"
+
+#include "lib/Backend/RestructuredGHAST.h"
+
+using namespace llvm;
+
+static const char *ModuleText = R"LLVM(
+define void @f(i1 %a, i1 %b, i32 %x) {
+entry:
+  br i1 %a, label %loop, label %other
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %next, %latch ]
+  switch i32 %x, label %latch [
+    i32 1, label %one
+    i32 2, label %two
+  ]
+
+one:
+  br label %latch
+
+two:
+  br i1 %b, label %exit, label %latch
+
+latch:
+  %next = add i32 %i, 1
+  %continue = icmp ult i32 %next, 16
+  br i1 %continue, label %loop, label %exit
+
+other:
+  br i1 %b, label %exit, label %one_more
+
+one_more:
+  br label %exit
+
+exit:
+  ret void
+}
+)LLVM";
+
+static ASTTree restructureAndBeautify(const model::Binary &Model, Function &F) {
+  ASTTree GHAST;
+  revng_check(restructureCFG(F, GHAST));
+  beautifyAST(Model, F, GHAST);
+  return GHAST;
+}
+
+static const ExprNode *getExpr(const ASTTree::expr_unique_ptr &Pointer) {
+  return Pointer.get();
+}
+
+/// Check \p Reused and \p Fresh are the same GHAST, referring to the same
+/// basic blocks and values
+static void checkSameGHAST(ASTTree &Reused, ASTTree &Fresh) {
+  revng_check(Reused.size() == Fresh.size());
+  revng_check(Reused.getRoot()->isEqual(Fresh.getRoot()));
+
+  // isEqual does not look at the conditions, check every slot
+  for (const auto &[R, F] : zip(Reused.nodes(), Fresh.nodes())) {
+    revng_check(R->getKind() == F->getKind());
+    revng_check(R->getBB() == F->getBB());
+    if (auto *RSwitch = dyn_cast<SwitchNode>(R))
+      revng_check(RSwitch->getCondition()
+                  == cast<SwitchNode>(F)->getCondition());
+  }
+
+  auto ReusedExprs = map_range(Reused.expressions(), getExpr);
+  auto FreshExprs = map_range(Fresh.expressions(), getExpr);
+  revng_check(size(ReusedExprs) == size(FreshExprs));
+  for (const auto &[R, F] : zip(ReusedExprs, FreshExprs)) {
+    revng_check(R->getKind() == F->getKind());
+    if (auto *RCompare = dyn_cast<ValueCompareNode>(R)) {
+      auto *FCompare = cast<ValueCompareNode>(F);
+      revng_check(RCompare->getBasicBlock() == FCompare->getBasicBlock());
+    } else if (auto *RAtomic = dyn_cast<AtomicNode>(R)) {
+      auto *FAtomic = cast<AtomicNode>(F);
+      revng_check(RAtomic->getConditionalBasicBlock()
+                  == FAtomic->getConditionalBasicBlock());
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ReuseAfterTypeRename) {
+  LLVMContext Context;
+  SMDiagnostic Error;
+  std::unique_ptr<llvm::Module> M = parseAssemblyString(ModuleText,
+                                                         Error,
+                                                         Context);
+  revng_check(M);
+
+  // The next run gets a new copy of the module
+  std::unique_ptr<llvm::Module> NextM = CloneModule(*M);
+
+  Function *F = M->getFunction("f");
+  Function *NextF = NextM->getFunction("f");
+  FunctionTags::Isolated.addTo(F);
+  FunctionTags::Isolated.addTo(NextF);
+
+  model::Binary Model;
+  auto Typedef = model::makeType<model::TypedefType>();
+  auto *TheTypedef = cast<model::TypedefType>(Typedef.get());
+  auto Int32 = Model.getPrimitiveType(model::PrimitiveTypeKind::Signed, 4);
+  TheTypedef->UnderlyingType() = model::QualifiedType(Int32, {});
+  TheTypedef->CustomName() = "before";
+  model::TypePath Path = Model.recordNewType(std::move(Typedef));
+
+  // First run
+  ASTTree GHAST = restructureAndBeautify(Model, *F);
+  uint64_t BeautifyModelHash = hashBeautifyModelDependencies(Model, *F);
+  auto Captured = RestructuredGHAST::capture(std::move(GHAST),
+                                             *F,
+                                             BeautifyModelHash);
+  revng_check(Captured);
+
+  // The original function is gone by the time the GHAST is reused
+  M.reset();
+
+  // The rename does not affect the control flow
+  cast<model::TypedefType>(Path.get())->CustomName() = "after";
+
+  // Next run: the GHAST must be reused, and be exactly what a fresh run
+  // produces
+  ASTTree Fresh = restructureAndBeautify(Model, *NextF);
+  revng_check(Captured->matches(hashFunctionIR(*NextF),
+                                hashBeautifyModelDependencies(Model, *NextF)));
+  ASTTree Reused = std::move(*Captured).takeFor(*NextF);
+
+  checkSameGHAST(Reused, Fresh);
+}
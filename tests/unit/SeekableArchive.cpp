@@ -0,0 +1,83 @@
+/// \file SeekableArchive.cpp
+/// Tests for revng::SeekableArchive
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#define BOOST_TEST_MODULE SeekableArchive
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/Support/Compression.h"
+
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+#include "revng-c/Support/SeekableArchive.h"
+
+using revng::SeekableArchive;
+
+static std::string pack(int Level) {
+  std::string Bar(4096, 'b');
+  std::vector<std::pair<std::string, llvm::StringRef>> Members = {
+    { "foo.c.ptml", "int foo(void) { return 1; }" },
+    { "bar.c.ptml", Bar },
+    { "empty.c.ptml", "" },
+  };
+
+  std::string Buffer;
+  llvm::raw_string_ostream OS(Buffer);
+  llvm::cantFail(SeekableArchive::write(Members, Level, OS));
+  OS.flush();
+  return Buffer;
+}
+
+static void checkMembers(const SeekableArchive &Archive) {
+  auto Entries = Archive.entries();
+  BOOST_TEST(Entries.size() == 3U);
+  BOOST_TEST(Entries[0].Name == "bar.c.ptml");
+  BOOST_TEST(Entries[1].Name == "empty.c.ptml");
+  BOOST_TEST(Entries[2].Name == "foo.c.ptml");
+
+  BOOST_TEST(llvm::cantFail(Archive.extract("foo.c.ptml"))
+             == "int foo(void) { return 1; }");
+  BOOST_TEST(llvm::cantFail(Archive.extract("bar.c.ptml"))
+             == std::string(4096, 'b'));
+  BOOST_TEST(llvm::cantFail(Archive.extract("empty.c.ptml")).empty());
+
+  const SeekableArchive::Entry *Foo = Archive.find("foo.c.ptml");
+  BOOST_TEST(Foo == &Entries[2]);
+  BOOST_TEST(Foo->Size == 27U);
+  BOOST_TEST(Archive.find("baz.c.ptml") == nullptr);
+
+  auto Missing = Archive.extract("baz.c.ptml");
+  BOOST_TEST(not static_cast<bool>(Missing));
+  llvm::consumeError(Missing.takeError());
+}
+
+BOOST_AUTO_TEST_CASE(Stored) {
+  std::string Buffer = pack(0);
+  SeekableArchive Archive = llvm::cantFail(SeekableArchive::open(Buffer));
+  BOOST_TEST(Archive.codec() == SeekableArchive::Store);
+  checkMembers(Archive);
+}
+
+BOOST_AUTO_TEST_CASE(Compressed) {
+  if (not llvm::zlib::isAvailable())
+    return;
+
+  std::string Buffer = pack(llvm::zlib::BestSpeedCompression);
+  BOOST_TEST(Buffer.size() < 4096U);
+
+  SeekableArchive Archive = llvm::cantFail(SeekableArchive::open(Buffer));
+  BOOST_TEST(Archive.codec() == SeekableArchive::Zlib);
+  checkMembers(Archive);
+}
+
+BOOST_AUTO_TEST_CASE(Truncated) {
+  std::string Buffer = pack(0);
+  Buffer.resize(Buffer.size() - 1);
+  auto Archive = SeekableArchive::open(Buffer);
+  BOOST_TEST(not static_cast<bool>(Archive));
+  llvm::consumeError(Archive.takeError());
+}
@@ -2,7 +2,7 @@
 ; This file is distributed under the MIT License. See LICENSE.md for details.
 ;
 
-; RUN: %revngopt %s -S --dla -o - | revng model dump | revng model compare %s.yml -
+; RUN: %budget --time 10 --rss 1024 -- %revngopt %s -S --dla -o - | revng model dump | revng model compare %s.yml -
 ; This file is meant to be used to test that the DLA is able to merge the
 ; recovered type information with an already existing model.
 ; In particular, in this file all functions and indirect calls share the same
@@ -5,6 +5,8 @@
 # flake8: noqa: F821
 # type: ignore
 
+import sys
+
 import lit.formats
 
 config.name = "revng-c"
@@ -13,3 +15,9 @@ config.suffixes = [".ll"]
 config.test_source_root = os.path.dirname(__file__)
 config.test_exec_root = config.my_obj_root
 config.substitutions.append(("%revngopt", "revng --prefix=" + config.my_obj_root + " opt "))
+
+# %budget runs a command recording its time and peak RSS, see perf_budget.py
+sys.path.insert(0, os.path.dirname(__file__))
+from perf_budget import budget_substitution  # noqa: E402
+
+config.substitutions.append(budget_substitution(config, lit_config))
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+#
+# This file is distributed under the MIT License. See LICENSE.md for details.
+#
+
+# Run a command of a lit test, record how long it took and its peak RSS, and,
+# in performance mode, fail if it went over its budget.
+#
+# Used through the %budget substitution, which lit.cfg.py gets from
+# budget_substitution:
+#
+#   RUN: %budget --time 5 --rss 512 -- %revngopt %s --dla -o /dev/null
+
+import argparse
+import json
+import os
+import resource
+import subprocess
+import sys
+import time
+
+
+def budget_substitution(config, lit_config):
+    """Return the %budget substitution, recording the measurements of the
+    suite in <suite>-perf-results.jsonl. With --param perf=1, commands going
+    over their budget times perf-margin fail."""
+    perf_results = os.path.join(config.my_obj_root, config.name + "-perf-results.jsonl")
+    if os.path.exists(perf_results):
+        os.remove(perf_results)
+
+    command = [
+        sys.executable,
+        os.path.abspath(__file__),
+        "--name",
+        "%s",
+        "--margin",
+        lit_config.params.get("perf-margin", "1.5"),
+        "--record",
+        perf_results,
+    ]
+    if lit_config.params.get("perf", "0") == "1":
+        command.append("--enforce")
+
+    return ("%budget", " ".join(command))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Run a command within a budget")
+    parser.add_argument("--name", required=True, help="name of the test")
+    parser.add_argument("--time", type=float, help="budget in seconds")
+    parser.add_argument("--rss", type=float, help="budget in MiB")
+    parser.add_argument(
+        "--margin",
+        type=float,
+        default=1.0,
+        help="how many times over the budget a command can go",
+    )
+    parser.add_argument("--record", help="append the measurements to this file")
+    parser.add_argument("--enforce", action="store_true", help="fail over budget")
+    parser.add_argument("command", nargs=argparse.REMAINDER)
+    args = parser.parse_args()
+
+    command = args.command
+    if command[:1] == ["--"]:
+        command = command[1:]
+    if not command:
+        parser.error("missing command")
+
+    start = time.monotonic()
+    result = subprocess.run(command)
+    elapsed = time.monotonic() - start
+
+    # ru_maxrss is in KiB on Linux, and it's the peak of the largest child
+    rss = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss / 1024
+
+    if args.record:
+        with open(args.record, "a") as record:
+            measurement = {
+                "test": args.name,
+                "command": command[0],
+                "time": round(elapsed, 3),
+                "rss": round(rss, 1),
+                "time-budget": args.time,
+                "rss-budget": args.rss,
+            }
+            record.write(json.dumps(measurement) + "\n")
+
+    if result.returncode != 0:
+        return result.returncode
+
+    over_budget = []
+    if args.time is not None and elapsed > args.time * args.margin:
+        over_budget.append(f"took {elapsed:.2f}s, budget is {args.time}s")
+    if args.rss is not None and rss > args.rss * args.margin:
+        over_budget.append(f"peak RSS {rss:.0f}MiB, budget is {args.rss}MiB")
+
+    for message in over_budget:
+        sys.stderr.write(f"{args.name}: {message} (margin {args.margin}x)\n")
+
+    if args.enforce and over_budget:
+        return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,45 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+// RUN: diff <(revng clift-opt %s -o -) <(revng clift-opt %s -o - | revng clift-opt -o -)
+!int32_t = !clift.primitive<SignedKind 4>
+module {
+  %0 = clift.undef !int32_t
+  clift.if {
+    clift.yield %0 !int32_t
+  } {
+    clift.expr {
+      clift.yield %0 !int32_t
+    }
+  } else {
+    clift.switch {
+      clift.yield %0 !int32_t
+    } [array<i64: 0, 1>, array<i64: 2>] {
+      clift.break
+    }, {
+      clift.expr {
+        clift.yield %0 !int32_t
+      }
+    } default {
+      clift.break
+    }
+  }
+  clift.while {
+    clift.yield %0 !int32_t
+  } {
+    clift.do_while {
+      clift.if {
+        clift.yield %0 !int32_t
+      } {
+        clift.continue
+      }
+      clift.if {
+        clift.yield %0 !int32_t
+      } {
+        clift.break
+      }
+    } while {
+      clift.yield %0 !int32_t
+    }
+  }
+}
@@ -0,0 +1,92 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+// RUN: revng clift-opt %s --split-input-file --verify-diagnostics
+
+!int32_t = !clift.primitive<SignedKind 4>
+module {
+  %0 = clift.undef !int32_t
+  clift.switch {
+    clift.yield %0 !int32_t
+  } [array<i64: 0>] {
+    // expected-error @+1 {{must be in a clift.loop, or nested in a clift.while or a clift.do_while}}
+    clift.continue
+  }
+}
+
+// -----
+
+!int32_t = !clift.primitive<SignedKind 4>
+module {
+  %0 = clift.undef !int32_t
+  clift.if {
+    clift.yield %0 !int32_t
+  } {
+    // expected-error @+1 {{must be nested in a clift.while, a clift.do_while or a clift.switch}}
+    clift.break
+  }
+}
+
+// -----
+
+!int32_t = !clift.primitive<SignedKind 4>
+module {
+  %0 = clift.undef !int32_t
+  // Labels for two cases, but only one case region
+  // expected-error @+1 {{must have a list of labels for each case}}
+  clift.switch {
+    clift.yield %0 !int32_t
+  } [array<i64: 0>, array<i64: 1>] {
+    clift.break
+  }
+}
+
+// -----
+
+!int32_t = !clift.primitive<SignedKind 4>
+module {
+  %0 = clift.undef !int32_t
+  // expected-error @+1 {{cases must have at least a label}}
+  clift.switch {
+    clift.yield %0 !int32_t
+  } [array<i64>] {
+    clift.break
+  }
+}
+
+// -----
+
+!int32_t = !clift.primitive<SignedKind 4>
+module {
+  %0 = clift.undef !int32_t
+  // expected-error @+1 {{has label 1 in more than one case}}
+  clift.switch {
+    clift.yield %0 !int32_t
+  } [array<i64: 0, 1>, array<i64: 1>] {
+    clift.break
+  }, {
+    clift.break
+  }
+}
+
+// -----
+
+!int32_t = !clift.primitive<SignedKind 4>
+module {
+  // expected-error @+1 {{the expression region must be a single block ending with a clift.yield}}
+  clift.expr {
+    %0 = clift.undef !int32_t
+  }
+}
+
+// -----
+
+!int32_t = !clift.primitive<SignedKind 4>
+module {
+  // expected-error @+1 {{the condition region must be a single block ending with a clift.yield}}
+  clift.while {
+    %0 = clift.undef !int32_t
+  } {
+    clift.break
+  }
+}
@@ -0,0 +1,161 @@
+/// \file Main.cpp
+/// Benchmark for parsing, verifying and running passes over Clift modules
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <chrono>
+#include <string>
+#include <sys/resource.h>
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/MLIRContext.h"
+#include "mlir/IR/Verifier.h"
+#include "mlir/InitAllDialects.h"
+#include "mlir/InitAllPasses.h"
+#include "mlir/Parser/Parser.h"
+#include "mlir/Pass/PassManager.h"
+#include "mlir/Pass/PassRegistry.h"
+#include "mlir/Support/Timing.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/InitRevng.h"
+
+#include "revng-c/mlir/Dialect/Clift/IR/Clift.h"
+
+using namespace llvm;
+
+static cl::OptionCategory BenchCategory("revng-clift-bench options");
+
+static cl::list<std::string> InputFiles(cl::Positional,
+                                        cl::desc("<input Clift modules>"),
+                                        cl::OneOrMore,
+                                        cl::cat(BenchCategory));
+
+static cl::opt<std::string> Pipeline("passes",
+                                     cl::desc("Textual pass pipeline to run "
+                                              "on each module, e.g. "
+                                              "\"builtin.module(canonicalize)"
+                                              "\""),
+                                     cl::init("builtin.module(canonicalize)"),
+                                     cl::cat(BenchCategory));
+
+static cl::opt<unsigned> Repetitions("repeat",
+                                     cl::desc("Number of times each module is "
+                                              "benchmarked"),
+                                     cl::init(1),
+                                     cl::cat(BenchCategory));
+
+static cl::opt<bool> PassTiming("pass-timing",
+                                cl::desc("Print the MLIR per-pass timing "
+                                         "report on stderr"),
+                                cl::cat(BenchCategory));
+
+static cl::opt<bool> PassStatistics("pass-statistics",
+                                    cl::desc("Print the MLIR pass statistics "
+                                             "on stderr"),
+                                    cl::cat(BenchCategory));
+
+static cl::opt<std::string> OutputPath("o",
+                                       cl::desc("CSV output file"),
+                                       cl::value_desc("path"),
+                                       cl::init("-"),
+                                       cl::cat(BenchCategory));
+
+static long peakRSSKiB() {
+  struct rusage Usage;
+  revng_check(getrusage(RUSAGE_SELF, &Usage) == 0);
+  return Usage.ru_maxrss;
+}
+
+template<typename T>
+static auto elapsedSince(T Start) {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now() - Start).count();
+}
+
+static void benchmark(mlir::MLIRContext &Context,
+                      mlir::TimingScope &Timing,
+                      StringRef Path,
+                      raw_ostream &Output) {
+  using namespace std::chrono;
+
+  long InitialRSS = peakRSSKiB();
+
+  // Parse without verifying, the verifier is measured on its own below
+  auto Start = steady_clock::now();
+  mlir::ParserConfig Config(&Context, /* verifyAfterParse */ false);
+  auto Module = mlir::parseSourceFile<mlir::ModuleOp>(Path, Config);
+  revng_check(Module, "Could not parse the input module");
+  auto Parse = elapsedSince(Start);
+
+  size_t Operations = 0;
+  Module->walk([&Operations](mlir::Operation *) { ++Operations; });
+
+  Start = steady_clock::now();
+  revng_check(mlir::succeeded(mlir::verify(*Module)), "Invalid input module");
+  auto Verify = elapsedSince(Start);
+
+  // The pass manager keeps a reference to the timing scope
+  mlir::TimingScope ModuleTiming;
+  mlir::PassManager Manager(&Context);
+  Manager.enableVerifier(false);
+  if (PassTiming) {
+    ModuleTiming = Timing.nest(Path);
+    Manager.enableTiming(ModuleTiming);
+  }
+  if (PassStatistics)
+    Manager.enableStatistics();
+
+  std::string Error;
+  raw_string_ostream ErrorStream(Error);
+  if (mlir::failed(mlir::parsePassPipeline(Pipeline, Manager, ErrorStream)))
+    revng_abort(ErrorStream.str().c_str());
+
+  Start = steady_clock::now();
+  revng_check(mlir::succeeded(Manager.run(*Module)), "The pipeline failed");
+  auto Passes = elapsedSince(Start);
+
+  Start = steady_clock::now();
+  revng_check(mlir::succeeded(mlir::verify(*Module)), "Invalid output module");
+  auto VerifyAfter = elapsedSince(Start);
+
+  Output << Path << "," << Operations << "," << Parse << "," << Verify << ","
+         << Passes << "," << VerifyAfter << "," << (peakRSSKiB() - InitialRSS)
+         << "\n";
+}
+
+int main(int Argc, char *Argv[]) {
+  mlir::registerAllPasses();
+
+  revng::InitRevng X(Argc, Argv, "Benchmark Clift modules", {});
+
+  mlir::DialectRegistry Registry;
+  mlir::registerAllDialects(Registry);
+  Registry.insert<mlir::clift::CliftDialect>();
+
+  mlir::MLIRContext Context(Registry);
+  Context.loadAllAvailableDialects();
+
+  std::error_code EC;
+  raw_fd_ostream Output(OutputPath, EC);
+  revng_check(not EC, "Could not open the output file");
+
+  Output << "module,operations,parse_us,verify_us,passes_us,"
+            "verify_after_passes_us,peak_rss_increase_kib\n";
+
+  // The report is printed on stderr when the manager goes out of scope
+  mlir::DefaultTimingManager TimingManager;
+  TimingManager.setEnabled(PassTiming);
+  mlir::TimingScope Timing = TimingManager.getRootScope();
+
+  for (unsigned I = 0; I < Repetitions; ++I)
+    for (const std::string &Path : InputFiles)
+      benchmark(Context, Timing, Path, Output);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,241 @@
+/// \file Main.cpp
+/// Benchmark for the throughput of decompile() over canonicalized IR.
+///
+///     revng-decompile-bench --model model.yml module.ll --repetitions=5
+///
+/// runs the backend (restructureCFG, beautifyAST, the variable declaration
+/// placement and the C emission) on all the isolated functions of each input,
+/// on a fresh copy of the IR for each repetition. Parsing is not measured.
+///
+/// For each repetition, it prints the number of functions and bytes of C
+/// emitted per second and the heap allocations per function. The time taken by
+/// each stage on each function can be collected, on the same runs, with
+/// --decompile-telemetry-output.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/EarlyFunctionAnalysis/FunctionMetadataCache.h"
+#include "revng/Model/Binary.h"
+#include "revng/Support/Assert.h"
+#include "revng/Support/InitRevng.h"
+#include "revng/Support/MetaAddress.h"
+
+#include "revng-c/Backend/DecompileFunction.h"
+
+using namespace llvm;
+
+static cl::OptionCategory BenchCategory("revng-decompile-bench options");
+
+static cl::list<std::string> InputFiles(cl::Positional,
+                                        cl::desc("<input IR files>"),
+                                        cl::OneOrMore,
+                                        cl::cat(BenchCategory));
+
+static cl::opt<std::string> ModelPath("model",
+                                      cl::desc("Model of the input IR files"),
+                                      cl::value_desc("path"),
+                                      cl::Required,
+                                      cl::cat(BenchCategory));
+
+static cl::opt<unsigned> Repetitions("repetitions",
+                                     cl::desc("Number of times each input is "
+                                              "decompiled"),
+                                     cl::init(3),
+                                     cl::cat(BenchCategory));
+
+static cl::opt<bool> PerFunction("per-function",
+                                 cl::desc("Print a line for each function "
+                                          "too"),
+                                 cl::cat(BenchCategory));
+
+static cl::opt<std::string> OutputPath("o",
+                                       cl::desc("CSV output file"),
+                                       cl::value_desc("path"),
+                                       cl::init("-"),
+                                       cl::cat(BenchCategory));
+
+namespace {
+
+/// Heap allocations performed by the threads using this slot so far
+struct alignas(64) AllocationCounter {
+  std::atomic<uint64_t> Count = 0;
+};
+
+} // namespace
+
+/// Each thread counts its allocations in its own slot, so that threads don't
+/// contend on the counters and the calling thread can tell its allocations
+/// apart from the ones of the workers. Threads past the last slot share the
+/// slots, which still gives correct totals.
+static constexpr unsigned SlotCount = 256;
+static AllocationCounter Slots[SlotCount];
+static std::atomic<unsigned> NextSlot = 0;
+
+static AllocationCounter &getThreadCounter() {
+  // Trivially destructible and allocation-free, so that it can be used from
+  // operator new at any point of the life of the thread
+  static thread_local unsigned Slot = NextSlot.fetch_add(1) % SlotCount;
+  return Slots[Slot];
+}
+
+/// Heap allocations performed by the calling thread so far
+static uint64_t threadAllocations() {
+  return getThreadCounter().Count.load(std::memory_order_relaxed);
+}
+
+/// Heap allocations performed by the process so far
+static uint64_t totalAllocations() {
+  uint64_t Result = 0;
+  for (const AllocationCounter &Counter : Slots)
+    Result += Counter.Count.load(std::memory_order_relaxed);
+  return Result;
+}
+
+void *operator new(size_t Size) {
+  getThreadCounter().Count.fetch_add(1, std::memory_order_relaxed);
+  if (Size == 0)
+    Size = 1;
+
+  while (true) {
+    if (void *Result = std::malloc(Size))
+      return Result;
+
+    std::new_handler Handler = std::get_new_handler();
+    if (Handler == nullptr)
+      throw std::bad_alloc();
+    Handler();
+  }
+}
+
+void operator delete(void *Pointer) noexcept {
+  std::free(Pointer);
+}
+
+void operator delete(void *Pointer, size_t) noexcept {
+  std::free(Pointer);
+}
+
+namespace {
+
+struct Counters {
+  uint64_t Functions = 0;
+  uint64_t Bytes = 0;
+  uint64_t Allocations = 0;
+  std::chrono::microseconds Time{ 0 };
+
+  void print(raw_ostream &OS) const {
+    double Seconds = std::max<double>(Time.count(), 1) / 1e6;
+    double PerFunction = Functions != 0 ? double(Allocations) / Functions : 0;
+    OS << Functions << "," << Bytes << "," << Time.count() << ","
+       << format("%.1f", Functions / Seconds) << ","
+       << format("%.0f", Bytes / Seconds) << ","
+       << format("%.1f", PerFunction) << "\n";
+  }
+};
+
+} // namespace
+
+static Counters benchmark(const std::string &Path,
+                          unsigned Repetition,
+                          const MemoryBuffer &IR,
+                          const model::Binary &Model,
+                          raw_ostream &Output) {
+  using namespace std::chrono;
+
+  LLVMContext Context;
+  SMDiagnostic Error;
+  std::unique_ptr<Module> M = parseIR(IR.getMemBufferRef(), Error, Context);
+  if (M == nullptr) {
+    Error.print(Path.c_str(), errs());
+    revng_abort("Could not parse the input");
+  }
+
+  FunctionMetadataCache Cache;
+  Counters Total;
+
+  // Functions are handed out as soon as they are emitted, what happened since
+  // the previous one is what it took to decompile this one. Only the
+  // allocations of this thread are charged to each function: with
+  // -decompile-threads the ones of the workers emitting C code only show up in
+  // the totals, since each worker may be busy with any function of the window.
+  uint64_t AllocationsBefore = totalAllocations();
+  auto Start = steady_clock::now();
+  auto Last = Start;
+  uint64_t LastAllocations = threadAllocations();
+  auto OnDecompiled = [&](const MetaAddress &Entry, std::string &&CCode) {
+    auto Now = steady_clock::now();
+    uint64_t NowAllocations = threadAllocations();
+    ++Total.Functions;
+    Total.Bytes += CCode.size();
+
+    if (PerFunction) {
+      Counters Function;
+      Function.Functions = 1;
+      Function.Bytes = CCode.size();
+      Function.Allocations = NowAllocations - LastAllocations;
+      Function.Time = duration_cast<microseconds>(Now - Last);
+      Output << Path << "," << Repetition << "," << Entry.toString() << ",";
+      Function.print(Output);
+    }
+
+    CCode.clear();
+    CCode.shrink_to_fit();
+    Last = steady_clock::now();
+    LastAllocations = threadAllocations();
+  };
+
+  decompile(Cache, *M, Model, OnDecompiled);
+
+  Total.Time = duration_cast<microseconds>(steady_clock::now() - Start);
+  Total.Allocations = totalAllocations() - AllocationsBefore;
+  return Total;
+}
+
+int main(int Argc, char *Argv[]) {
+  revng::InitRevng X(Argc, Argv, "Benchmark the decompiler backend", {});
+
+  auto MaybeModel = TupleTree<model::Binary>::fromFile(ModelPath);
+  revng_check(MaybeModel, "Could not load the model");
+  TupleTree<model::Binary> Model = std::move(*MaybeModel);
+
+  std::error_code EC;
+  raw_fd_ostream Output(OutputPath, EC);
+  revng_check(not EC, "Could not open the output file");
+
+  Output << "input,repetition,function,functions,bytes,time_us,"
+            "functions_per_second,bytes_per_second,allocations_per_function\n";
+
+  for (const std::string &Path : InputFiles) {
+    auto MaybeIR = MemoryBuffer::getFile(Path);
+    if (not MaybeIR) {
+      errs() << "Cannot open " << Path << ": " << MaybeIR.getError().message()
+             << "\n";
+      return EXIT_FAILURE;
+    }
+
+    for (unsigned Repetition = 0; Repetition < Repetitions; ++Repetition) {
+      Counters Total = benchmark(Path, Repetition, **MaybeIR, *Model, Output);
+      Output << Path << "," << Repetition << ",all,";
+      Total.print(Output);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
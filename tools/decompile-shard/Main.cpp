@@ -0,0 +1,202 @@
+/// \file Main.cpp
+/// Worker and coordinator for decompiling a binary split across machines.
+///
+/// The coordinator splits module.ll with revng-shard-module and sends each
+/// shard, along with the model, to a worker. Each worker runs:
+///
+///     revng-decompile-shard --model model.yml shard.bc \
+///       --passes=<the passes of the steps after the split> -o fragment.tar.gz
+///
+/// which decompiles the isolated functions in its shard. Back on the
+/// coordinator:
+///
+///     revng-decompile-shard --merge=fragment0.tar.gz,... -o decompiled.tar.gz
+///
+/// collects the fragments in a single decompiled.tar.gz. With --functions, a
+/// worker only parses and decompiles the requested functions. Isolated functions
+/// are decompiled independently of each other, which is what makes this
+/// possible.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/PassInfo.h"
+#include "llvm/PassRegistry.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/EarlyFunctionAnalysis/FunctionMetadataCache.h"
+#include "revng/Model/Binary.h"
+#include "revng/Model/LoadModelPass.h"
+#include "revng/Support/Assert.h"
+#include "revng/Support/InitRevng.h"
+#include "revng/Support/MetaAddress.h"
+
+#include "revng-c/Backend/DecompileFunction.h"
+#include "revng-c/Backend/DecompilePipe.h"
+#include "revng-c/Support/IsolatedFunctionsIndex.h"
+
+using namespace llvm;
+
+using revng::pipes::DecompileStringMap;
+
+static cl::OptionCategory ShardCategory("revng-decompile-shard options");
+
+static cl::opt<std::string> InputPath(cl::Positional,
+                                      cl::desc("<input shard>"),
+                                      cl::cat(ShardCategory));
+
+static cl::opt<std::string> ModelPath("model",
+                                      cl::desc("Model of the binary the shard "
+                                               "comes from"),
+                                      cl::value_desc("path"),
+                                      cl::cat(ShardCategory));
+
+static cl::list<std::string> Passes("passes",
+                                    cl::desc("Passes to run on the shard "
+                                             "before decompiling it"),
+                                    cl::CommaSeparated,
+                                    cl::cat(ShardCategory));
+
+static cl::list<std::string> OnlyFunctions("functions",
+                                           cl::desc("Entry addresses of the "
+                                                    "only functions to "
+                                                    "decompile. The shard is "
+                                                    "loaded lazily, and only "
+                                                    "they and their callees "
+                                                    "are parsed"),
+                                           cl::CommaSeparated,
+                                           cl::cat(ShardCategory));
+
+static cl::list<std::string> Priority("priority",
+                                      cl::desc("Entry addresses of the "
+                                               "functions to decompile first, "
+                                               "along with those close to "
+                                               "them in the call graph. "
+                                               "Requires --functions"),
+                                      cl::CommaSeparated,
+                                      cl::cat(ShardCategory));
+
+static cl::list<std::string> MergePaths("merge",
+                                        cl::desc("Decompiled fragments to "
+                                                 "merge, instead of "
+                                                 "decompiling a shard"),
+                                        cl::CommaSeparated,
+                                        cl::cat(ShardCategory));
+
+static cl::opt<std::string> OutputPath("o",
+                                       cl::desc("Output decompiled.tar.gz"),
+                                       cl::value_desc("path"),
+                                       cl::Required,
+                                       cl::cat(ShardCategory));
+
+static constexpr const char *ContainerName = "decompiled.tar.gz";
+
+static void check(Error E) {
+  if (E) {
+    errs() << toString(std::move(E)) << "\n";
+    revng_abort();
+  }
+}
+
+static void merge() {
+  DecompileStringMap Result(ContainerName);
+  std::set<MetaAddress> Seen;
+
+  for (const std::string &Path : MergePaths) {
+    DecompileStringMap Fragment(ContainerName);
+    check(Fragment.loadFromDisk(Path));
+
+    for (const auto &[Entry, CCode] : Fragment) {
+      // Each isolated function belongs to exactly one shard
+      revng_check(Seen.insert(Entry).second,
+                  "Function decompiled in more than one fragment");
+      Result.insert_or_assign(Entry, CCode);
+    }
+  }
+
+  check(Result.storeToDisk(OutputPath));
+}
+
+static void decompileShard(const char *Argv0) {
+  revng_check(not InputPath.empty(), "No input shard");
+  revng_check(not ModelPath.empty(), "No model");
+
+  auto MaybeModel = TupleTree<model::Binary>::fromFile(ModelPath);
+  revng_check(MaybeModel, "Could not load the model");
+  TupleTree<model::Binary> Model = std::move(*MaybeModel);
+
+  LLVMContext Context;
+  DecompileStringMap Fragment(ContainerName);
+  FunctionMetadataCache Cache;
+  auto Insert = [&Fragment](const MetaAddress &Entry, std::string &&CCode) {
+    Fragment.insert_or_assign(Entry, std::move(CCode));
+  };
+
+  if (not OnlyFunctions.empty()) {
+    // Passes would materialize the whole module
+    revng_check(Passes.empty(), "--functions and --passes are exclusive");
+
+    std::set<MetaAddress> Entries;
+    for (const std::string &Entry : OnlyFunctions)
+      Entries.insert(MetaAddress::fromString(Entry));
+
+    std::vector<MetaAddress> First;
+    for (const std::string &Entry : Priority)
+      First.push_back(MetaAddress::fromString(Entry));
+
+    std::unique_ptr<Module> Shard = loadModuleLazily(InputPath, Context);
+    decompile(Cache, *Shard, *Model, Entries, Insert, nullptr, First);
+    check(Fragment.storeToDisk(OutputPath));
+    return;
+  }
+
+  revng_check(Priority.empty(), "--priority requires --functions");
+
+  SMDiagnostic Error;
+  std::unique_ptr<Module> Shard = parseIRFile(InputPath, Error, Context);
+  if (Shard == nullptr) {
+    Error.print(Argv0, errs());
+    revng_abort("Could not load the shard");
+  }
+
+  if (not Passes.empty()) {
+    legacy::PassManager Manager;
+    Manager.add(new LoadModelWrapperPass(ModelWrapper(Model)));
+
+    PassRegistry &Registry = *PassRegistry::getPassRegistry();
+    for (const std::string &Name : Passes) {
+      const PassInfo *Info = Registry.getPassInfo(Name);
+      revng_check(Info != nullptr, "Unknown pass");
+      Manager.add(Info->createPass());
+    }
+
+    Manager.run(*Shard);
+  }
+
+  decompile(Cache, *Shard, *Model, Insert);
+  check(Fragment.storeToDisk(OutputPath));
+}
+
+int main(int Argc, char *Argv[]) {
+  revng::InitRevng X(Argc, Argv, "Decompile a shard of a binary", {});
+
+  if (MergePaths.empty())
+    decompileShard(Argv[0]);
+  else
+    merge();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+/// \file Main.cpp
+/// Read functions out of the decompiled.pack produced by pack-decompiled.
+///
+///     revng-decompiled-pack decompiled.pack --functions=0x1000:Code_x86_64
+///
+/// prints a single C file with the requested functions only. The pack is
+/// mapped in memory and only the requested functions are decompressed, no
+/// matter how large the binary is.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+#include <set>
+#include <string>
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/InitRevng.h"
+#include "revng/Support/MetaAddress.h"
+
+#include "revng-c/Backend/DecompileToSingleFile.h"
+#include "revng-c/Support/PTMLC.h"
+#include "revng-c/Support/SeekableArchive.h"
+
+using namespace llvm;
+
+static cl::OptionCategory PackCategory("revng-decompiled-pack options");
+
+static cl::opt<std::string> InputPath(cl::Positional,
+                                      cl::desc("<decompiled.pack>"),
+                                      cl::Required,
+                                      cl::cat(PackCategory));
+
+static cl::list<std::string> Functions("functions",
+                                       cl::desc("Entry addresses of the "
+                                                "functions to print, all of "
+                                                "them if none is given"),
+                                       cl::CommaSeparated,
+                                       cl::cat(PackCategory));
+
+static cl::opt<bool> List("list",
+                          cl::desc("List the members of the pack with their "
+                                   "sizes, instead of printing them"),
+                          cl::cat(PackCategory));
+
+static cl::opt<std::string> OutputPath("o",
+                                       cl::desc("Output file"),
+                                       cl::value_desc("path"),
+                                       cl::init("-"),
+                                       cl::cat(PackCategory));
+
+int main(int Argc, char *Argv[]) {
+  revng::InitRevng X(Argc, Argv, "Read functions out of decompiled.pack", {});
+
+  auto MaybeBuffer = MemoryBuffer::getFile(InputPath,
+                                           /* IsText */ false,
+                                           /* RequiresNullTerminator */ false);
+  if (not MaybeBuffer) {
+    errs() << "Cannot open " << InputPath << ": "
+           << MaybeBuffer.getError().message() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  auto MaybeArchive = revng::SeekableArchive::open((*MaybeBuffer)->getBuffer());
+  if (not MaybeArchive) {
+    errs() << toString(MaybeArchive.takeError()) << "\n";
+    return EXIT_FAILURE;
+  }
+
+  std::error_code EC;
+  ToolOutputFile Output(OutputPath, EC, sys::fs::OF_None);
+  if (EC) {
+    errs() << "Cannot open " << OutputPath << ": " << EC.message() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  if (List) {
+    for (const revng::SeekableArchive::Entry &Member : MaybeArchive->entries())
+      Output.os() << Member.Name << "," << Member.Size << ","
+                  << Member.CompressedSize << "\n";
+  } else {
+    std::set<MetaAddress> Targets;
+    for (const std::string &Entry : Functions) {
+      MetaAddress Address = MetaAddress::fromString(Entry);
+      revng_check(Address.isValid(), "Invalid function address");
+      Targets.insert(Address);
+    }
+
+    ptml::PTMLCBuilder B;
+    if (Error E = printSingleCFile(Output.os(), B, *MaybeArchive, Targets)) {
+      // Keep what could be printed, but report the members that were skipped
+      errs() << toString(std::move(E)) << "\n";
+      Output.keep();
+      return EXIT_FAILURE;
+    }
+  }
+
+  Output.keep();
+  return EXIT_SUCCESS;
+}
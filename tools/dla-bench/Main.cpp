@@ -0,0 +1,262 @@
+/// \file Main.cpp
+/// Benchmark for the DLA middle-end over synthetic type systems
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/InitRevng.h"
+
+#include "revng-c/DataLayoutAnalysis/DLATypeSystem.h"
+
+#include "lib/DataLayoutAnalysis/Middleend/DLAStep.h"
+
+using namespace llvm;
+using namespace dla;
+
+using LTSN = LayoutTypeSystemNode;
+
+static cl::OptionCategory BenchCategory("revng-dla-bench options");
+
+static cl::list<unsigned> NodeCounts("nodes",
+                                     cl::desc("Number of nodes of the "
+                                              "synthetic type systems to "
+                                              "generate"),
+                                     cl::CommaSeparated,
+                                     cl::cat(BenchCategory));
+
+static cl::opt<unsigned> EdgesPerNode("edges-per-node",
+                                      cl::desc("Number of edges generated "
+                                               "for each node"),
+                                      cl::init(2),
+                                      cl::cat(BenchCategory));
+
+static cl::opt<unsigned> InstanceWeight("instance-weight",
+                                        cl::desc("Relative frequency of "
+                                                 "instance edges at non-zero "
+                                                 "offsets"),
+                                        cl::init(4),
+                                        cl::cat(BenchCategory));
+
+static cl::opt<unsigned> Offset0Weight("offset0-weight",
+                                       cl::desc("Relative frequency of "
+                                                "instance edges at offset 0, "
+                                                "i.e. inheritance-like "
+                                                "edges"),
+                                       cl::init(1),
+                                       cl::cat(BenchCategory));
+
+static cl::opt<unsigned> PointerWeight("pointer-weight",
+                                       cl::desc("Relative frequency of "
+                                                "pointer edges"),
+                                       cl::init(2),
+                                       cl::cat(BenchCategory));
+
+static cl::opt<unsigned> EqualityWeight("equality-weight",
+                                        cl::desc("Relative frequency of "
+                                                 "equality edges"),
+                                        cl::init(1),
+                                        cl::cat(BenchCategory));
+
+static cl::opt<unsigned> StrideDepth("stride-depth",
+                                     cl::desc("Maximum number of strides of "
+                                              "the instance edges"),
+                                     cl::init(2),
+                                     cl::cat(BenchCategory));
+
+static cl::opt<unsigned> StridedPercent("strided-percent",
+                                        cl::desc("Percentage of instance "
+                                                 "edges that have strides"),
+                                        cl::init(25),
+                                        cl::cat(BenchCategory));
+
+static cl::opt<unsigned> PointerSize("pointer-size",
+                                     cl::desc("Size of pointers, in bytes"),
+                                     cl::init(8),
+                                     cl::cat(BenchCategory));
+
+static cl::opt<uint64_t> Seed("seed",
+                              cl::desc("Seed of the synthetic type systems "
+                                       "generator"),
+                              cl::init(1),
+                              cl::cat(BenchCategory));
+
+static cl::opt<std::string> OutputPath("o",
+                                       cl::desc("CSV output file"),
+                                       cl::value_desc("path"),
+                                       cl::init("-"),
+                                       cl::cat(BenchCategory));
+
+namespace {
+
+/// Builds random type systems shaped like the ones built by the DLA frontend
+///
+/// Instance edges always go from an older node to a newer one, so that they
+/// never form cycles that the frontend couldn't produce. Pointer and equality
+/// edges can connect any pair of nodes.
+class SyntheticTypeSystemBuilder {
+private:
+  std::mt19937_64 Generator;
+  std::discrete_distribution<unsigned> EdgeKind;
+
+  enum EdgeKindT {
+    Instance,
+    Offset0,
+    Pointer,
+    Equality,
+  };
+
+public:
+  SyntheticTypeSystemBuilder(uint64_t Seed) :
+    Generator(Seed),
+    EdgeKind({ static_cast<double>(InstanceWeight),
+               static_cast<double>(Offset0Weight),
+               static_cast<double>(PointerWeight),
+               static_cast<double>(EqualityWeight) }) {}
+
+public:
+  void build(LayoutTypeSystem &TS, unsigned NumNodes) {
+    revng_check(NumNodes >= 2);
+
+    std::vector<LTSN *> Nodes;
+    Nodes.reserve(NumNodes);
+    for (unsigned I = 0; I < NumNodes; ++I) {
+      LTSN *N = TS.createArtificialLayoutType();
+      // Half of the nodes are accessed directly, the others only get a size
+      // from their children
+      N->Size = coin(50) ? (1ULL << uniform(0, 3)) : 0;
+      Nodes.push_back(N);
+    }
+
+    for (unsigned I = 1; I < NumNodes; ++I) {
+      LTSN *N = Nodes[I];
+      for (unsigned E = 0; E < EdgesPerNode; ++E) {
+        LTSN *Older = Nodes[uniform(0, I - 1)];
+        switch (EdgeKind(Generator)) {
+        case Instance:
+          TS.addInstanceLink(Older, N, offsetExpression(N));
+          break;
+
+        case Offset0:
+          TS.addInstanceLink(Older, N, OffsetExpression{});
+          break;
+
+        case Pointer:
+          N->Size = PointerSize;
+          TS.addPointerLink(N, Nodes[uniform(0, NumNodes - 1)]);
+          break;
+
+        case Equality:
+          TS.addEqualityLink(Older, N);
+          break;
+
+        default:
+          revng_abort();
+        }
+      }
+    }
+  }
+
+private:
+  uint64_t uniform(uint64_t Min, uint64_t Max) {
+    return std::uniform_int_distribution<uint64_t>(Min, Max)(Generator);
+  }
+
+  bool coin(unsigned Percent) { return uniform(0, 99) < Percent; }
+
+  OffsetExpression offsetExpression(const LTSN *Child) {
+    OffsetExpression Result(8 * uniform(1, 8));
+    if (StrideDepth == 0 or not coin(StridedPercent))
+      return Result;
+
+    // Strides go from the outermost to the innermost, so build them in
+    // reverse, each one large enough to hold the previous level.
+    uint64_t Inner = std::max<uint64_t>(Child->Size, 8);
+    unsigned Depth = uniform(1, StrideDepth);
+    llvm::SmallVector<uint64_t, 4> Strides;
+    using TripCountT = OffsetExpression::TripCountT;
+    llvm::SmallVector<TripCountT, 4> TripCounts;
+    for (unsigned Level = 0; Level < Depth; ++Level) {
+      uint64_t TripCount = uniform(2, 8);
+      Strides.push_back(Inner);
+      TripCounts.push_back(coin(75) ? TripCountT(TripCount) : TripCountT());
+      Inner *= TripCount;
+    }
+
+    Result.Strides.assign(Strides.rbegin(), Strides.rend());
+    Result.TripCounts.assign(TripCounts.rbegin(), TripCounts.rend());
+    return Result;
+  }
+};
+
+} // namespace
+
+static size_t countEdges(const LayoutTypeSystem &TS) {
+  size_t Result = 0;
+  for (const LTSN *N : TS.getLayoutsRange())
+    Result += N->Successors.size();
+  return Result;
+}
+
+static void benchmark(unsigned NumNodes, raw_ostream &Output) {
+  using namespace std::chrono;
+
+  LayoutTypeSystem TS;
+  SyntheticTypeSystemBuilder Builder(Seed);
+  Builder.build(TS, NumNodes);
+
+  std::string Name = "synthetic_" + std::to_string(NumNodes) + "_"
+                     + std::to_string(Seed);
+  size_t Nodes = TS.getNumLayouts();
+  size_t Edges = countEdges(TS);
+
+  StepManager SM;
+  addDefaultSteps(SM, PointerSize);
+
+  std::vector<StepStatistics> Statistics;
+  auto Start = steady_clock::now();
+  SM.run(TS, &Statistics);
+  auto Total = duration_cast<microseconds>(steady_clock::now() - Start);
+
+  for (const auto &[Index, S] : llvm::enumerate(Statistics)) {
+    Output << Name << "," << Nodes << "," << Edges << "," << (Index + 1) << ","
+           << S.Name << "," << S.Skipped << "," << S.Changed << ","
+           << S.Time.count() << "," << S.NodesBefore << "," << S.NodesAfter
+           << "," << S.EdgesBefore << "," << S.EdgesAfter << "\n";
+  }
+
+  // The whole schedule, as run by DLAPass, is reported with index 0
+  Output << Name << "," << Nodes << "," << Edges << ",0,schedule,0,"
+         << llvm::any_of(Statistics, [](const auto &S) { return S.Changed; })
+         << "," << Total.count() << "," << Nodes << "," << TS.getNumLayouts()
+         << "," << Edges << "," << countEdges(TS) << "\n";
+}
+
+int main(int Argc, char *Argv[]) {
+  revng::InitRevng X(Argc, Argv, "Benchmark the DLA middle-end", {});
+
+  std::error_code EC;
+  raw_fd_ostream Output(OutputPath, EC);
+  revng_check(not EC, "Could not open the output file");
+
+  Output << "graph,nodes,edges,index,step,skipped,changed,time_us,"
+            "nodes_before,nodes_after,edges_before,edges_after\n";
+
+  for (unsigned NumNodes : NodeCounts)
+    benchmark(NumNodes, Output);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,163 @@
+/// \file Main.cpp
+/// Inspect the DLA type system snapshots written with --dla-snapshot-prefix
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/InitRevng.h"
+
+#include "revng-c/DataLayoutAnalysis/DLASnapshot.h"
+
+#include "lib/DataLayoutAnalysis/Middleend/DLAStep.h"
+
+using namespace llvm;
+using namespace dla;
+
+static cl::OptionCategory SnapshotCategory("revng-dla-snapshot options");
+
+static cl::opt<std::string> InputPath(cl::Positional,
+                                      cl::desc("<snapshot>"),
+                                      cl::Required,
+                                      cl::cat(SnapshotCategory));
+
+static cl::opt<uint64_t> NodeID("node",
+                                cl::desc("Print the edges and the value of "
+                                         "the node with this ID"),
+                                cl::cat(SnapshotCategory));
+
+static cl::opt<bool> RunSteps("run-steps",
+                              cl::desc("Restore the snapshot and run the "
+                                       "DLA middle-end steps that had not "
+                                       "run yet on it"),
+                              cl::cat(SnapshotCategory));
+
+static cl::opt<unsigned> PointerSize("pointer-size",
+                                     cl::desc("Pointer size of the binary "
+                                              "the snapshot comes from, for "
+                                              "--run-steps"),
+                                     cl::init(8),
+                                     cl::cat(SnapshotCategory));
+
+static void runSteps(const DLASnapshot &Snapshot) {
+  LayoutTypeSystem TS;
+  Snapshot.restore(TS);
+
+  StepManager SM;
+  addDefaultSteps(SM, PointerSize);
+  revng_check(Snapshot.StepIndex <= SM.getNumSteps(),
+              "The snapshot is past the last DLA step");
+
+  std::vector<StepStatistics> Statistics;
+  SM.run(TS, &Statistics, Snapshot.StepIndex);
+
+  outs() << "index,step,skipped,changed,time_us,nodes_after,edges_after\n";
+  unsigned Index = Snapshot.StepIndex;
+  for (const StepStatistics &S : Statistics)
+    outs() << ++Index << "," << S.Name << "," << S.Skipped << "," << S.Changed
+           << "," << S.Time.count() << "," << S.NodesAfter << ","
+           << S.EdgesAfter << "\n";
+}
+
+static void printEdge(const DLASnapshot::Edge &E) {
+  outs() << "  " << E.Source << " -> " << E.Target << " "
+         << TypeLinkTag::toString(E.Kind);
+  if (E.Kind == TypeLinkTag::LK_Instance) {
+    outs() << " offset " << E.OE.Offset;
+    for (const auto &[Stride, TripCount] : zip(E.OE.Strides, E.OE.TripCounts)) {
+      outs() << " [stride " << Stride << ", trip count ";
+      if (TripCount.has_value())
+        outs() << TripCount.value();
+      else
+        outs() << "unknown";
+      outs() << "]";
+    }
+  }
+  outs() << "\n";
+}
+
+static void printNode(const DLASnapshot &Snapshot, uint64_t ID) {
+  auto It = llvm::find_if(Snapshot.Nodes, [ID](const DLASnapshot::Node &N) {
+    return N.ID == ID;
+  });
+  revng_check(It != Snapshot.Nodes.end(), "No node with the given ID");
+
+  outs() << "node " << It->ID << ": size " << It->Size;
+  if (It->NonScalar)
+    outs() << ", non-scalar";
+  if (It->EqClass)
+    outs() << ", class " << *It->EqClass;
+  else
+    outs() << ", removed";
+  outs() << "\n";
+
+  for (const DLASnapshot::Value &V : Snapshot.Values)
+    if (V.NodeID == ID)
+      outs() << "  value " << V.Description << "\n";
+
+  for (const DLASnapshot::Edge &E : Snapshot.Edges)
+    if (E.Source == ID or E.Target == ID)
+      printEdge(E);
+}
+
+int main(int Argc, char *Argv[]) {
+  revng::InitRevng X(Argc, Argv, "Inspect a DLA snapshot", {});
+
+  auto MaybeBuffer = MemoryBuffer::getFile(InputPath);
+  revng_check(MaybeBuffer, "Could not open the snapshot");
+
+  Expected<DLASnapshot> MaybeSnapshot = DLASnapshot::read((*MaybeBuffer)
+                                                            ->getBuffer());
+  if (not MaybeSnapshot) {
+    errs() << toString(MaybeSnapshot.takeError()) << "\n";
+    return 1;
+  }
+  const DLASnapshot &Snapshot = *MaybeSnapshot;
+
+  if (RunSteps) {
+    runSteps(Snapshot);
+    return 0;
+  }
+
+  if (NodeID.getNumOccurrences() > 0) {
+    printNode(Snapshot, NodeID);
+    return 0;
+  }
+
+  uint64_t Removed = 0;
+  std::map<uint64_t, uint64_t> ClassSizes;
+  for (const DLASnapshot::Node &N : Snapshot.Nodes) {
+    if (N.EqClass)
+      ++ClassSizes[*N.EqClass];
+    else
+      ++Removed;
+  }
+
+  std::array<uint64_t, TypeLinkTag::LK_All> EdgesByKind{};
+  for (const DLASnapshot::Edge &E : Snapshot.Edges)
+    ++EdgesByKind[E.Kind];
+
+  outs() << "nodes: " << Snapshot.Nodes.size() << "\n";
+  outs() << "removed nodes: " << Removed << "\n";
+  outs() << "equivalence classes: " << ClassSizes.size() << "\n";
+  outs() << "values: " << Snapshot.Values.size() << "\n";
+  outs() << "edges: " << Snapshot.Edges.size() << "\n";
+  for (unsigned K = 0; K < TypeLinkTag::LK_All; ++K) {
+    auto Kind = static_cast<TypeLinkTag::LinkKind>(K);
+    outs() << "  " << TypeLinkTag::toString(Kind) << ": " << EdgesByKind[K]
+           << "\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,283 @@
+/// \file Main.cpp
+/// Benchmark for restructureCFG and beautifyAST over real and synthetic CFGs
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Model/Binary.h"
+#include "revng/Support/Assert.h"
+#include "revng/Support/FunctionTags.h"
+#include "revng/Support/InitRevng.h"
+
+#include "revng-c/RestructureCFG/ASTTree.h"
+#include "revng-c/RestructureCFG/BeautifyGHAST.h"
+#include "revng-c/RestructureCFG/RestructureCFG.h"
+
+using namespace llvm;
+
+static cl::OptionCategory BenchCategory("revng-restructure-bench options");
+
+static cl::list<std::string> InputFiles(cl::Positional,
+                                        cl::desc("<input IR files>"),
+                                        cl::cat(BenchCategory));
+
+static cl::opt<bool> AllFunctions("all-functions",
+                                  cl::desc("Benchmark all the functions with "
+                                           "a body, not only the isolated "
+                                           "ones"),
+                                  cl::cat(BenchCategory));
+
+static cl::opt<std::string> ModelPath("model",
+                                      cl::desc("Model of the input IR files"),
+                                      cl::value_desc("path"),
+                                      cl::cat(BenchCategory));
+
+static cl::list<unsigned> SyntheticSizes("synthetic-size",
+                                         cl::desc("Size of the synthetic "
+                                                  "CFGs to generate for each "
+                                                  "shape"),
+                                         cl::CommaSeparated,
+                                         cl::cat(BenchCategory));
+
+static cl::opt<std::string> OutputPath("o",
+                                       cl::desc("CSV output file"),
+                                       cl::value_desc("path"),
+                                       cl::init("-"),
+                                       cl::cat(BenchCategory));
+
+namespace {
+
+/// Builds synthetic functions with shapes that are known to stress the comb and
+/// the beautifier
+class SyntheticCFGBuilder {
+private:
+  Module &M;
+  GlobalVariable *Sink = nullptr;
+  Function *F = nullptr;
+
+public:
+  SyntheticCFGBuilder(Module &M) : M(M) {
+    auto *Int32 = Type::getInt32Ty(M.getContext());
+    Sink = new GlobalVariable(M,
+                              Int32,
+                              false,
+                              GlobalValue::ExternalLinkage,
+                              nullptr,
+                              "sink");
+  }
+
+public:
+  /// N loops, each nested in the previous one, with a multi-level continue
+  /// from the innermost body to the outermost latch
+  void deepNesting(unsigned N) {
+    revng_check(N >= 1);
+    BasicBlock *Entry = startFunction("deep_nesting_" + std::to_string(N));
+    BasicBlock *Return = createBlock("return");
+    ReturnInst::Create(M.getContext(), Return);
+
+    std::vector<BasicBlock *> Headers;
+    std::vector<BasicBlock *> Latches;
+    for (unsigned I = 0; I < N; ++I) {
+      Headers.push_back(createBlock("header_" + std::to_string(I)));
+      Latches.push_back(createBlock("latch_" + std::to_string(I)));
+    }
+    BasicBlock *Body = createBlock("body");
+
+    BranchInst::Create(Headers.front(), Entry);
+    for (unsigned I = 0; I < N; ++I) {
+      BasicBlock *Exit = I == 0 ? Return : Latches[I - 1];
+      BasicBlock *Inner = I + 1 == N ? Body : Headers[I + 1];
+      BranchInst::Create(Inner, Exit, condition(I), Headers[I]);
+      BranchInst::Create(Headers[I], Exit, condition(N + I), Latches[I]);
+    }
+    BranchInst::Create(Latches.back(), Latches.front(), condition(2 * N), Body);
+  }
+
+  /// A switch with N cases, each of which may fall through into the next one
+  void wideSwitch(unsigned N) {
+    BasicBlock *Entry = startFunction("wide_switch_" + std::to_string(N));
+    BasicBlock *Merge = createBlock("merge");
+    ReturnInst::Create(M.getContext(), Merge);
+
+    std::vector<BasicBlock *> Cases;
+    for (unsigned I = 0; I < N; ++I)
+      Cases.push_back(createBlock("case_" + std::to_string(I)));
+
+    auto *Switch = SwitchInst::Create(argument(), Merge, N, Entry);
+    for (unsigned I = 0; I < N; ++I) {
+      Switch->addCase(constant(I), Cases[I]);
+      if (I + 1 == N)
+        BranchInst::Create(Merge, Cases[I]);
+      else
+        BranchInst::Create(Cases[I + 1], Merge, condition(N + I), Cases[I]);
+    }
+  }
+
+  /// N nodes connected by a web of conditional edges, with a cycle that can be
+  /// entered from two different nodes
+  void irreducibleMesh(unsigned N) {
+    revng_check(N >= 2);
+    BasicBlock *Entry = startFunction("irreducible_mesh_" + std::to_string(N));
+    BasicBlock *Return = createBlock("return");
+    ReturnInst::Create(M.getContext(), Return);
+
+    std::vector<BasicBlock *> Nodes;
+    for (unsigned I = 0; I < N; ++I)
+      Nodes.push_back(createBlock("node_" + std::to_string(I)));
+
+    BranchInst::Create(Nodes.front(), Nodes[N / 2], condition(0), Entry);
+    for (unsigned I = 0; I < N; ++I) {
+      BasicBlock *Next = Nodes[(I + 1) % N];
+      BasicBlock *Other = I % 5 == 0 ? Return : Nodes[(I * 7 + 3) % N];
+      BranchInst::Create(Next, Other, condition(I + 1), Nodes[I]);
+    }
+  }
+
+private:
+  BasicBlock *startFunction(const std::string &Name) {
+    auto &C = M.getContext();
+    auto *FTy = FunctionType::get(Type::getVoidTy(C),
+                                  { Type::getInt32Ty(C) },
+                                  false);
+    F = Function::Create(FTy, GlobalValue::ExternalLinkage, Name, M);
+    FunctionTags::Isolated.addTo(F);
+    return createBlock("entry");
+  }
+
+  /// Create a basic block containing some code, so that it has a weight
+  BasicBlock *createBlock(const std::string &Name) {
+    auto *BB = BasicBlock::Create(M.getContext(), Name, F);
+    IRBuilder<> Builder(BB);
+    Builder.CreateStore(argument(), Sink, true);
+    return BB;
+  }
+
+  Value *argument() const { return F->getArg(0); }
+
+  ConstantInt *constant(unsigned N) const {
+    return ConstantInt::get(Type::getInt32Ty(M.getContext()), N);
+  }
+
+  Value *condition(unsigned N) {
+    // Put the condition in the entry block, so that it doesn't change the
+    // weight of the other blocks.
+    IRBuilder<> Builder(&F->getEntryBlock(), F->getEntryBlock().begin());
+    return Builder.CreateICmpEQ(argument(), constant(N));
+  }
+};
+
+} // namespace
+
+static long peakRSSKiB() {
+  struct rusage Usage;
+  revng_check(getrusage(RUSAGE_SELF, &Usage) == 0);
+  return Usage.ru_maxrss;
+}
+
+static void benchmark(const model::Binary &Model,
+                      Function &F,
+                      raw_ostream &Output) {
+  using namespace std::chrono;
+
+  size_t BasicBlocks = F.size();
+  long InitialRSS = peakRSSKiB();
+
+  ASTTree GHAST;
+  RestructureCFGStatistics Statistics;
+  auto Start = steady_clock::now();
+  restructureCFG(F, GHAST, &Statistics);
+  auto Restructure = duration_cast<microseconds>(steady_clock::now() - Start);
+  size_t GHASTNodes = GHAST.size();
+
+  // Beautify whatever the decompiler would beautify: only functions whose
+  // restructuring has been abandoned are emitted without a GHAST.
+  bool Restructured = not Statistics.DuplicationCeilingExceeded;
+  BeautifyStatistics Beautification;
+  microseconds Beautify{ 0 };
+  if (Restructured) {
+    Start = steady_clock::now();
+    beautifyAST(Model, F, GHAST, &Beautification);
+    Beautify = duration_cast<microseconds>(steady_clock::now() - Start);
+  }
+
+  Output << F.getName() << "," << BasicBlocks << "," << Restructured << ","
+         << Restructure.count() << "," << Beautify.count() << ","
+         << GHASTNodes << "," << GHAST.size() << ","
+         << Statistics.InflatedNodes << "," << Statistics.Duplications << ","
+         << Beautification.ShortCircuits << ","
+         << Beautification.TrivialShortCircuits << ","
+         << (peakRSSKiB() - InitialRSS) << "\n";
+}
+
+int main(int Argc, char *Argv[]) {
+  revng::InitRevng X(Argc, Argv, "Benchmark the restructuring", {});
+
+  TupleTree<model::Binary> Model;
+  if (not ModelPath.empty()) {
+    auto MaybeModel = TupleTree<model::Binary>::fromFile(ModelPath);
+    revng_check(MaybeModel, "Could not load the model");
+    Model = std::move(*MaybeModel);
+  }
+
+  std::error_code EC;
+  raw_fd_ostream Output(OutputPath, EC);
+  revng_check(not EC, "Could not open the output file");
+
+  Output << "function,basic_blocks,restructured,restructure_us,beautify_us,"
+            "ghast_nodes,beautified_ghast_nodes,inflated_regioncfg_nodes,"
+            "duplications,short_circuits,trivial_short_circuits,"
+            "peak_rss_increase_kib\n";
+
+  LLVMContext Context;
+  std::vector<std::unique_ptr<Module>> Modules;
+
+  for (const std::string &Path : InputFiles) {
+    SMDiagnostic Error;
+    Modules.push_back(parseIRFile(Path, Error, Context));
+    if (Modules.back() == nullptr) {
+      Error.print(Argv[0], errs());
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (not SyntheticSizes.empty()) {
+    auto Synthetic = std::make_unique<Module>("synthetic", Context);
+    SyntheticCFGBuilder Builder(*Synthetic);
+    for (unsigned Size : SyntheticSizes) {
+      Builder.deepNesting(Size);
+      Builder.wideSwitch(Size);
+      Builder.irreducibleMesh(Size);
+    }
+    Modules.push_back(std::move(Synthetic));
+  }
+
+  for (std::unique_ptr<Module> &M : Modules) {
+    for (Function &F : *M) {
+      if (F.isDeclaration())
+        continue;
+
+      if (AllFunctions)
+        FunctionTags::Isolated.addTo(&F);
+
+      if (FunctionTags::Isolated.isTagOf(&F))
+        benchmark(*Model, F, Output);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
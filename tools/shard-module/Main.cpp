@@ -0,0 +1,92 @@
+/// \file Main.cpp
+/// Split the isolated functions of a module in shards, and merge them back
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+#include <string>
+
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/InitRevng.h"
+
+#include "revng-c/Support/ModuleShards.h"
+
+using namespace llvm;
+
+static cl::OptionCategory ShardCategory("revng-shard-module options");
+
+static cl::opt<std::string> InputPath(cl::Positional,
+                                      cl::desc("<input module>"),
+                                      cl::Required,
+                                      cl::cat(ShardCategory));
+
+static cl::opt<unsigned> ShardCount("shards",
+                                    cl::desc("Number of shards to split the "
+                                             "isolated functions in"),
+                                    cl::init(1),
+                                    cl::cat(ShardCategory));
+
+static cl::list<std::string> MergePaths("merge",
+                                        cl::desc("Shards to merge back in the "
+                                                 "input module, instead of "
+                                                 "splitting it"),
+                                        cl::CommaSeparated,
+                                        cl::cat(ShardCategory));
+
+static cl::opt<std::string> OutputPath("o",
+                                       cl::desc("Output module when merging, "
+                                                "prefix of the <prefix>.<N>.bc "
+                                                "shards when splitting"),
+                                       cl::value_desc("path"),
+                                       cl::Required,
+                                       cl::cat(ShardCategory));
+
+static std::unique_ptr<Module>
+load(const char *Argv0, StringRef Path, LLVMContext &Context) {
+  SMDiagnostic Error;
+  std::unique_ptr<Module> Result = parseIRFile(Path, Error, Context);
+  if (Result == nullptr) {
+    Error.print(Argv0, errs());
+    revng_abort("Could not load the module");
+  }
+  return Result;
+}
+
+static void write(const Module &M, StringRef Path) {
+  revng_check(not verifyModule(M, &errs()), "Invalid module");
+  std::error_code EC;
+  raw_fd_ostream Output(Path, EC);
+  revng_check(not EC, "Could not open the output file");
+  WriteBitcodeToFile(M, Output);
+}
+
+int main(int Argc, char *Argv[]) {
+  revng::InitRevng X(Argc, Argv, "Split modules in shards", {});
+
+  LLVMContext Context;
+  std::unique_ptr<Module> M = load(Argv[0], InputPath, Context);
+
+  if (not MergePaths.empty()) {
+    for (const std::string &Path : MergePaths)
+      mergeShard(*M, *load(Argv[0], Path, Context));
+    write(*M, OutputPath);
+    return EXIT_SUCCESS;
+  }
+
+  auto Shards = splitIsolatedFunctions(*M, ShardCount);
+  for (size_t I = 0; I < Shards.size(); ++I)
+    write(*Shards[I], OutputPath + "." + std::to_string(I) + ".bc");
+
+  return EXIT_SUCCESS;
+}